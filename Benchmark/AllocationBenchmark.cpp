@@ -0,0 +1,108 @@
+#include "Benchmark.h"
+#include "../Src/DGP/PointCloud3D.h"
+#include "../Src/DGP/Mesh3D.h"
+#include "../Src/Common/ToolKit.h"
+#include <stdio.h>
+
+namespace MagicBenchmark
+{
+    static void PrintResult(const char* name, int elementNum, double loadTime, double freeTime)
+    {
+        printf("%-28s %10d  load: %8.4fs  free: %8.4fs\n", name, elementNum, loadTime, freeTime);
+    }
+
+    static MagicMath::Vector3 GetPosition(int index)
+    {
+        return MagicMath::Vector3(index % 1024, (index / 1024) % 1024, index / (1024 * 1024));
+    }
+
+    static bool PrintCheck(const char* name, bool isPassed)
+    {
+        printf("%-28s %s\n", name, isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+
+    bool RunAllocationBenchmark(int elementNum)
+    {
+        printf("Allocation benchmark\n");
+        bool isPassed = true;
+        //Point3D: one new and one delete per point
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            std::vector<MagicDGP::Point3D* > pointList;
+            for (int i = 0; i < elementNum; i++)
+            {
+                MagicDGP::Point3D* pPoint = new MagicDGP::Point3D(GetPosition(i));
+                pPoint->SetId(i);
+                pointList.push_back(pPoint);
+            }
+            double loadTime = MagicCore::ToolKit::GetTime() - timeStart;
+            timeStart = MagicCore::ToolKit::GetTime();
+            for (int i = 0; i < elementNum; i++)
+            {
+                delete pointList.at(i);
+            }
+            std::vector<MagicDGP::Point3D* >().swap(pointList);
+            PrintResult("Point3D new/delete", elementNum, loadTime, MagicCore::ToolKit::GetTime() - timeStart);
+        }
+        //Point3D: Point3DSet pool
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Point3DSet* pPointSet = new MagicDGP::Point3DSet;
+            for (int i = 0; i < elementNum; i++)
+            {
+                pPointSet->InsertPoint(GetPosition(i));
+            }
+            double loadTime = MagicCore::ToolKit::GetTime() - timeStart;
+            //Pooled points keep their insertion order
+            bool isPoolPassed = (pPointSet->GetPointNumber() == elementNum);
+            for (int i = 0; isPoolPassed && i < elementNum; i++)
+            {
+                isPoolPassed = (pPointSet->GetPoint(i)->GetPosition() == GetPosition(i));
+            }
+            timeStart = MagicCore::ToolKit::GetTime();
+            delete pPointSet;
+            PrintResult("Point3DSet pool", elementNum, loadTime, MagicCore::ToolKit::GetTime() - timeStart);
+            isPassed = PrintCheck("Point3DSet pool result", isPoolPassed) && isPassed;
+        }
+        //Vertex3D: one new and one delete per vertex
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            std::vector<MagicDGP::Vertex3D* > vertList;
+            for (int i = 0; i < elementNum; i++)
+            {
+                MagicDGP::Vertex3D* pVert = new MagicDGP::Vertex3D(GetPosition(i));
+                pVert->SetId(i);
+                vertList.push_back(pVert);
+            }
+            double loadTime = MagicCore::ToolKit::GetTime() - timeStart;
+            timeStart = MagicCore::ToolKit::GetTime();
+            for (int i = 0; i < elementNum; i++)
+            {
+                delete vertList.at(i);
+            }
+            std::vector<MagicDGP::Vertex3D* >().swap(vertList);
+            PrintResult("Vertex3D new/delete", elementNum, loadTime, MagicCore::ToolKit::GetTime() - timeStart);
+        }
+        //Vertex3D: LightMesh3D pool
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::LightMesh3D* pMesh = new MagicDGP::LightMesh3D;
+            for (int i = 0; i < elementNum; i++)
+            {
+                pMesh->InsertVertex(GetPosition(i));
+            }
+            double loadTime = MagicCore::ToolKit::GetTime() - timeStart;
+            bool isPoolPassed = (pMesh->GetVertexNumber() == elementNum);
+            for (int i = 0; isPoolPassed && i < elementNum; i++)
+            {
+                isPoolPassed = (pMesh->GetPosition(i) == GetPosition(i));
+            }
+            timeStart = MagicCore::ToolKit::GetTime();
+            delete pMesh;
+            PrintResult("LightMesh3D pool", elementNum, loadTime, MagicCore::ToolKit::GetTime() - timeStart);
+            isPassed = PrintCheck("LightMesh3D pool result", isPoolPassed) && isPassed;
+        }
+        return isPassed;
+    }
+}
@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include "../Src/DGP/PointArchive.h"
+#include "../Src/DGP/Parser.h"
+#include "../Src/Common/ToolKit.h"
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+
+namespace MagicBenchmark
+{
+    static long long GetFileSize(const std::string& fileName)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            return 0;
+        }
+        fseek(pFile, 0, SEEK_END);
+        long long fileSize = ftell(pFile);
+        fclose(pFile);
+        return fileSize;
+    }
+
+    static void PrintArchiveResult(const char* name, int pointNum, double time, long long fileSize)
+    {
+        printf("%-20s %8.1fM points  time: %8.4fs  size: %10.2fMB  %6.2f bytes/point\n", name, pointNum / 1.0e6, time,
+            fileSize / 1048576.0, double(fileSize) / pointNum);
+    }
+
+    static MagicMath::Vector3 GetMaxDifference(const MagicMath::Vector3& pos0, const MagicMath::Vector3& pos1)
+    {
+        return MagicMath::Vector3(fabs(pos0[0] - pos1[0]), fabs(pos0[1] - pos1[1]), fabs(pos0[2] - pos1[2]));
+    }
+
+    //OBJ points are in the saved order and exact. Archive points are in Morton order, each one is matched to its grid
+    //point, the position error is at most one quantization step per axis and the normal error at most 4 octahedral steps
+    static bool CheckArchiveResult(const MagicDGP::Point3DSet* pPointSet, const MagicDGP::Point3DSet* pLoadedSet, bool isArchive,
+        int positionBits, int normalBits)
+    {
+        int pointNum = pPointSet->GetPointNumber();
+        if (pLoadedSet == NULL || pLoadedSet->GetPointNumber() != pointNum)
+        {
+            printf("check failed: point numbers differ\n");
+            return false;
+        }
+        MagicMath::Vector3 bboxMin = pPointSet->GetPoint(0)->GetPosition();
+        MagicMath::Vector3 bboxMax = bboxMin;
+        for (int pid = 1; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+            for (int k = 0; k < 3; k++)
+            {
+                bboxMin[k] = pos[k] < bboxMin[k] ? pos[k] : bboxMin[k];
+                bboxMax[k] = pos[k] > bboxMax[k] ? pos[k] : bboxMax[k];
+            }
+        }
+        MagicMath::Vector3 positionStep(0, 0, 0);
+        double normalStep = 0;
+        if (isArchive)
+        {
+            positionStep = (bboxMax - bboxMin) / double((1 << positionBits) - 1);
+            normalStep = 2.0 / double((1 << normalBits) - 1);
+        }
+        MagicMath::Vector3 maxPositionError(0, 0, 0);
+        double maxNormalError = 0;
+        std::vector<bool> matchList(pointNum, false);
+        for (int lid = 0; lid < pointNum; lid++)
+        {
+            MagicMath::Vector3 pos = pLoadedSet->GetPoint(lid)->GetPosition();
+            int pid = lid;
+            if (isArchive)
+            {
+                pid = int(floor(pos[1] / 0.0005 + 0.5)) * 2000 + int(floor(pos[0] / 0.0005 + 0.5));
+                if (pid < 0 || pid >= pointNum || matchList.at(pid))
+                {
+                    printf("check failed: point %d has no grid point\n", lid);
+                    return false;
+                }
+                matchList.at(pid) = true;
+            }
+            MagicMath::Vector3 posError = GetMaxDifference(pos, pPointSet->GetPoint(pid)->GetPosition());
+            for (int k = 0; k < 3; k++)
+            {
+                maxPositionError[k] = posError[k] > maxPositionError[k] ? posError[k] : maxPositionError[k];
+            }
+            double norError = (pLoadedSet->GetPoint(lid)->GetNormal() - pPointSet->GetPoint(pid)->GetNormal()).Length();
+            maxNormalError = norError > maxNormalError ? norError : maxNormalError;
+        }
+        printf("max error: position %g %g %g  normal %g\n", maxPositionError[0], maxPositionError[1], maxPositionError[2], maxNormalError);
+        return maxPositionError[0] <= positionStep[0] && maxPositionError[1] <= positionStep[1] && maxPositionError[2] <= positionStep[2]
+            && maxNormalError <= normalStep * 4;
+    }
+
+    bool RunArchiveBenchmark(int elementNum)
+    {
+        printf("Archive benchmark\n");
+        MagicDGP::Point3DSet pointSet;
+        for (int pid = 0; pid < elementNum; pid++)
+        {
+            double u = (pid % 2000) * 0.0005;
+            double v = (pid / 2000) * 0.0005;
+            MagicMath::Vector3 pos(u, v, 0.1 * sin(u * 10.0) * cos(v * 10.0));
+            MagicMath::Vector3 nor(-cos(u * 10.0) * cos(v * 10.0), sin(u * 10.0) * sin(v * 10.0), 1.0);
+            nor.Normalise();
+            pointSet.InsertPoint(pos, nor);
+        }
+        pointSet.SetHasNormal(true);
+        const int positionBits = 16;
+        const int normalBits = 12;
+        MagicDGP::Parser::SetExportPrecision(0);
+        MagicDGP::Parser::SetArchiveBits(positionBits, normalBits);
+        const char* fileNames[] = {"MagicBenchmark_archive.obj", "MagicBenchmark_archive.m3c"};
+        bool isPassed = true;
+        for (int fid = 0; fid < 2; fid++)
+        {
+            std::string fileName = fileNames[fid];
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Parser::ExportPointSet(fileName, &pointSet);
+            double exportTime = MagicCore::ToolKit::GetTime() - timeStart;
+            long long fileSize = GetFileSize(fileName);
+            PrintArchiveResult(fid == 0 ? "OBJ export" : "M3C export", elementNum, exportTime, fileSize);
+            timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Point3DSet* pPointSet = MagicDGP::Parser::ParsePointSet(fileName);
+            double importTime = MagicCore::ToolKit::GetTime() - timeStart;
+            PrintArchiveResult(fid == 0 ? "OBJ import" : "M3C import", pPointSet == NULL ? 0 : pPointSet->GetPointNumber(), importTime, fileSize);
+            bool isFilePassed = CheckArchiveResult(&pointSet, pPointSet, fid == 1, positionBits, normalBits);
+            printf("%-20s %s\n", fid == 0 ? "OBJ result" : "M3C result", isFilePassed ? "passed" : "FAILED");
+            isPassed = isFilePassed && isPassed;
+            delete pPointSet;
+            remove(fileName.c_str());
+        }
+        return isPassed;
+    }
+}
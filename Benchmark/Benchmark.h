@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+
+namespace MagicBenchmark
+{
+    //Create and release Point3D/Vertex3D one by one with new/delete, and through the ObjectPool of their containers.
+    //Returns false if a check failed
+    bool RunAllocationBenchmark(int elementNum);
+    //Read a generated OBJ file of about elementNum vertices, report MB/s, check the parsed grid and the OBJ/PLY/M3D/STL
+    //round trips. Returns false if a check failed
+    bool RunParserBenchmark(int elementNum);
+    //Export a point set of elementNum points with normals as OBJ, report MB/s, check the re-imported points.
+    //Returns false if a check failed
+    bool RunExportBenchmark(int elementNum);
+    //Read a PLY file of elementNum points whole and in chunks, and voxel downsample it from the stream.
+    //Returns false if a check failed
+    bool RunStreamBenchmark(int elementNum);
+    //Export and import a point set of elementNum points with normals as OBJ and as compressed archive, report sizes,
+    //check the archive error against its quantization step. Returns false if a check failed
+    bool RunArchiveBenchmark(int elementNum);
+    //Convert generated depth frames to point set files serially and through DepthFramePipeline.
+    //Returns false if a check failed
+    bool RunDepthBenchmark(int elementNum);
+    //Dispatch elementNum / 4 empty tasks through a single queue pool and through MagicCore::ThreadPool.
+    //Returns false if a check failed
+    bool RunThreadPoolBenchmark(int elementNum);
+    //Run Mesh3D normal and curvature kernels and the kNN search of about elementNum vertices with 1 thread and with
+    //all processors. Returns false if a check failed
+    bool RunParallelBenchmark(int elementNum);
+    //Convert a mesh of about elementNum vertices to HalfEdgeMesh3D and back, check its one rings, boundary flags
+    //and normals against Mesh3D. Returns false if a check failed
+    bool RunHalfEdgeBenchmark(int elementNum);
+    //Time the DGP kernels on synthetic data of elementNum / 20 points (at least 2000) and on inputFileName if it is not empty,
+    //write time, throughput and peak memory of each kernel to resultFileName as JSON. Returns false if a check failed
+    bool RunKernelBenchmark(int elementNum, const std::string& resultFileName, const std::string& inputFileName);
+}
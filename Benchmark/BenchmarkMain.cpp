@@ -0,0 +1,76 @@
+#include "Benchmark.h"
+#include "../Src/Common/AsyncLog.h"
+#include "../Src/Common/Profiler.h"
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+//Usage: MagicBenchmark [benchmark name | all] [element number]
+//      MagicBenchmark kernel [element number] [result json] [point set file]
+//MAGIC_PROFILE_TRACE=trace.json exports the profile zones of the run
+//The exit code is 1 if a benchmark result check failed
+int main(int argc, char* argv[])
+{
+    std::string benchName = argc > 1 ? argv[1] : "all";
+    int elementNum = argc > 2 ? atoi(argv[2]) : 2000000;
+    if (elementNum <= 0)
+    {
+        printf("invalid element number: %s\n", argv[2]);
+        return 1;
+    }
+    const char* traceFileName = getenv("MAGIC_PROFILE_TRACE");
+    bool isProfiling = (traceFileName != NULL && traceFileName[0] != '\0');
+    MagicCore::SetProfileEnabled(isProfiling);
+    bool runAll = (benchName == "all");
+    bool isPassed = true;
+    if (runAll || benchName == "allocation")
+    {
+        isPassed = MagicBenchmark::RunAllocationBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "parser")
+    {
+        isPassed = MagicBenchmark::RunParserBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "export")
+    {
+        isPassed = MagicBenchmark::RunExportBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "stream")
+    {
+        isPassed = MagicBenchmark::RunStreamBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "archive")
+    {
+        isPassed = MagicBenchmark::RunArchiveBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "depth")
+    {
+        isPassed = MagicBenchmark::RunDepthBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "threadpool")
+    {
+        isPassed = MagicBenchmark::RunThreadPoolBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "parallel")
+    {
+        isPassed = MagicBenchmark::RunParallelBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "halfedge")
+    {
+        isPassed = MagicBenchmark::RunHalfEdgeBenchmark(elementNum) && isPassed;
+    }
+    if (runAll || benchName == "kernel")
+    {
+        std::string resultFileName = (!runAll && argc > 3) ? argv[3] : "MagicBenchmark_kernel.json";
+        std::string inputFileName = (!runAll && argc > 4) ? argv[4] : "";
+        isPassed = MagicBenchmark::RunKernelBenchmark(elementNum, resultFileName, inputFileName) && isPassed;
+    }
+    if (isProfiling)
+    {
+        MagicCore::LogProfileStatistics();
+        MagicCore::ExportProfileTrace(traceFileName);
+    }
+    MagicCore::StopAsyncLog();
+
+    return isPassed ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#include "Benchmark.h"
+#include "SyntheticData.h"
+#include "../Src/DGP/DepthFramePipeline.h"
+#include "../Src/DGP/Parser.h"
+#include "../Src/Common/ToolKit.h"
+#include <stdio.h>
+#include <math.h>
+#include <sstream>
+#include <vector>
+
+namespace MagicBenchmark
+{
+    static void PrintDepthResult(const char* name, int frameNum, double time)
+    {
+        printf("%-28s %6d frames  time: %8.4fs  %8.2f frames/s\n", name, frameNum, time, frameNum / time);
+    }
+
+    static std::string GetFrameFileName(const std::string& filePrefix, int frameId, const std::string& extension)
+    {
+        std::stringstream ss;
+        ss << filePrefix << frameId << "." << extension;
+        return ss.str();
+    }
+
+    //Point number and coordinate sum of an exported frame, the sum is -1 if the file can not be read
+    static double GetFrameCoordinateSum(const std::string& fileName, int& pointNum)
+    {
+        MagicDGP::Point3DSet* pPointSet = MagicDGP::Parser::ParsePointSet(fileName);
+        pointNum = 0;
+        if (pPointSet == NULL)
+        {
+            return -1;
+        }
+        double coordSum = 0;
+        pointNum = pPointSet->GetPointNumber();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+            coordSum += fabs(pos[0]) + fabs(pos[1]) + fabs(pos[2]);
+        }
+        delete pPointSet;
+        return coordSum;
+    }
+
+    bool RunDepthBenchmark(int elementNum)
+    {
+        printf("Depth benchmark\n");
+        int frameNum = elementNum / 65536 > 4 ? elementNum / 65536 : 4;
+        std::string filePrefix = "MagicBenchmark_depth";
+        std::string extension = "m3c";
+        MagicDGP::DepthRangeLimit range;
+        int serialNum = 0;
+        {
+            //The loop ReconstructionApp::ExportPointSet used before the pipeline
+            GeneratedDepthSource source(frameNum);
+            MagicDGP::DepthFrame frame;
+            double timeStart = MagicCore::ToolKit::GetTime();
+            while (source.ReadFrame(frame))
+            {
+                MagicDGP::Point3DSet* pPointSet = MagicDGP::DepthFrameConverter::ToPointSet(frame, source.GetXZFactor(), source.GetYZFactor(), range);
+                MagicDGP::Parser::ExportPointSet(GetFrameFileName(filePrefix, frame.mFrameId, extension), pPointSet);
+                delete pPointSet;
+                serialNum++;
+            }
+            PrintDepthResult("serial", serialNum, MagicCore::ToolKit::GetTime() - timeStart);
+        }
+        //Both write the same archives of the same frames
+        std::vector<int> pointNumList(frameNum, 0);
+        std::vector<double> coordSumList(frameNum, 0);
+        for (int fid = 0; fid < frameNum; fid++)
+        {
+            coordSumList.at(fid) = GetFrameCoordinateSum(GetFrameFileName(filePrefix, fid, extension), pointNumList.at(fid));
+            remove(GetFrameFileName(filePrefix, fid, extension).c_str());
+        }
+        int exportNum = 0;
+        {
+            GeneratedDepthSource source(frameNum);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::DepthFramePipeline pipeline;
+            exportNum = pipeline.Run(&source, range, filePrefix, extension);
+            PrintDepthResult("pipeline", exportNum, MagicCore::ToolKit::GetTime() - timeStart);
+        }
+        bool isPassed = (serialNum == frameNum && exportNum == frameNum);
+        for (int fid = 0; fid < frameNum; fid++)
+        {
+            std::string fileName = GetFrameFileName(filePrefix, fid, extension);
+            int pointNum = 0;
+            double coordSum = GetFrameCoordinateSum(fileName, pointNum);
+            if (coordSum < 0 || pointNum == 0 || pointNum != pointNumList.at(fid) || coordSum != coordSumList.at(fid))
+            {
+                printf("check failed: frame %d\n", fid);
+                isPassed = false;
+            }
+            remove(fileName.c_str());
+        }
+        printf("%-28s %s\n", "pipeline result", isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+}
@@ -0,0 +1,124 @@
+#include "Benchmark.h"
+#include "../Src/DGP/Parser.h"
+#include "../Src/Common/ToolKit.h"
+#include <fstream>
+#include <stdio.h>
+#include <math.h>
+
+namespace MagicBenchmark
+{
+    static double GetFileSize(const std::string& fileName)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            return 0;
+        }
+        fseek(pFile, 0, SEEK_END);
+        double fileSize = ftell(pFile);
+        fclose(pFile);
+        return fileSize;
+    }
+
+    static void PrintExportResult(const char* name, const std::string& fileName, double time)
+    {
+        double fileSize = GetFileSize(fileName);
+        printf("%-28s %8.1fMB  time: %8.4fs  %8.1fMB/s\n", name, fileSize / 1048576.0, time, fileSize / 1048576.0 / time);
+        remove(fileName.c_str());
+    }
+
+    //Points read back from fileName equal the exported ones, within relativeError of each coordinate
+    static bool CheckExportResult(const char* name, const std::string& fileName, const MagicDGP::Point3DSet* pPC, double relativeError)
+    {
+        MagicDGP::Point3DSet* pParsedPC = MagicDGP::Parser::ParsePointSet(fileName);
+        bool isPassed = (pParsedPC != NULL && pParsedPC->GetPointNumber() == pPC->GetPointNumber());
+        for (int pid = 0; isPassed && pid < pPC->GetPointNumber(); pid++)
+        {
+            MagicMath::Vector3 pos = pPC->GetPoint(pid)->GetPosition();
+            MagicMath::Vector3 nor = pPC->GetPoint(pid)->GetNormal();
+            MagicMath::Vector3 parsedPos = pParsedPC->GetPoint(pid)->GetPosition();
+            MagicMath::Vector3 parsedNor = pParsedPC->GetPoint(pid)->GetNormal();
+            for (int k = 0; k < 3; k++)
+            {
+                if (fabs(parsedPos[k] - pos[k]) > fabs(pos[k]) * relativeError || fabs(parsedNor[k] - nor[k]) > fabs(nor[k]) * relativeError)
+                {
+                    printf("check failed: point %d\n", pid);
+                    isPassed = false;
+                    break;
+                }
+            }
+        }
+        delete pParsedPC;
+        printf("%-28s %s\n", name, isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+
+    //The std::ofstream and std::endl loop which Parser used before BufferedWriter
+    static void ExportPointSetByLine(const std::string& fileName, const MagicDGP::Point3DSet* pPC)
+    {
+        std::ofstream fout(fileName.c_str());
+        int pcNum = pPC->GetPointNumber();
+        for (int i = 0; i < pcNum; i++)
+        {
+            const MagicDGP::Point3D* pPoint = pPC->GetPoint(i);
+            MagicMath::Vector3 pos = pPoint->GetPosition();
+            MagicMath::Vector3 nor = pPoint->GetNormal();
+            fout << "v " << pos[0] << " " << pos[1] << " " << pos[2] << std::endl;
+            fout << "vn " << nor[0] << " " << nor[1] << " " << nor[2] << std::endl;
+        }
+        fout.close();
+    }
+
+    //Shortest text reads back to the same double, 6 significant digits are within half a unit of the last digit
+    bool RunExportBenchmark(int elementNum)
+    {
+        printf("Export benchmark\n");
+        const double sixDigitError = 5.0e-6;
+        bool isPassed = true;
+        MagicDGP::Point3DSet pointSet;
+        for (int pid = 0; pid < elementNum; pid++)
+        {
+            double angle = pid * 0.001;
+            MagicMath::Vector3 pos(cos(angle) * (1.0 + pid * 1e-6), sin(angle) * (1.0 + pid * 1e-6), pid * 1e-5);
+            MagicMath::Vector3 nor(cos(angle), sin(angle), 0);
+            pointSet.InsertPoint(pos, nor);
+        }
+        pointSet.SetHasNormal(true);
+        std::string fileName = "MagicBenchmark_export.obj";
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            ExportPointSetByLine(fileName, &pointSet);
+            double time = MagicCore::ToolKit::GetTime() - timeStart;
+            isPassed = CheckExportResult("OBJ ofstream/endl result", fileName, &pointSet, sixDigitError) && isPassed;
+            PrintExportResult("OBJ ofstream/endl", fileName, time);
+        }
+        {
+            MagicDGP::Parser::SetExportPrecision(0);
+            MagicDGP::Parser::SetBackgroundExport(false);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Parser::ExportPointSet(fileName, &pointSet);
+            double time = MagicCore::ToolKit::GetTime() - timeStart;
+            isPassed = CheckExportResult("OBJ buffered shortest result", fileName, &pointSet, 0) && isPassed;
+            PrintExportResult("OBJ buffered shortest", fileName, time);
+        }
+        {
+            MagicDGP::Parser::SetExportPrecision(6);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Parser::ExportPointSet(fileName, &pointSet);
+            double time = MagicCore::ToolKit::GetTime() - timeStart;
+            isPassed = CheckExportResult("OBJ buffered 6 digits result", fileName, &pointSet, sixDigitError) && isPassed;
+            PrintExportResult("OBJ buffered 6 digits", fileName, time);
+        }
+        {
+            MagicDGP::Parser::SetBackgroundExport(true);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Parser::ExportPointSet(fileName, &pointSet);
+            double time = MagicCore::ToolKit::GetTime() - timeStart;
+            isPassed = CheckExportResult("OBJ background 6 digits result", fileName, &pointSet, sixDigitError) && isPassed;
+            PrintExportResult("OBJ background 6 digits", fileName, time);
+        }
+        MagicDGP::Parser::SetExportPrecision(0);
+        MagicDGP::Parser::SetBackgroundExport(false);
+        return isPassed;
+    }
+}
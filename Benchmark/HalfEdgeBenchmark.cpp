@@ -0,0 +1,133 @@
+#include "Benchmark.h"
+#include "SyntheticData.h"
+#include "../Src/DGP/Mesh3D.h"
+#include "../Src/DGP/HalfEdgeMesh3D.h"
+#include "../Src/Common/Parallel.h"
+#include "../Src/Common/ToolKit.h"
+#include <stdio.h>
+#include <math.h>
+
+namespace MagicBenchmark
+{
+    static int GetElementId(const MagicDGP::Edge3D* pEdge)
+    {
+        return pEdge == NULL ? -1 : pEdge->GetId();
+    }
+
+    static int GetElementId(const MagicDGP::Face3D* pFace)
+    {
+        return pFace == NULL ? -1 : pFace->GetId();
+    }
+
+    static int GetElementId(const MagicDGP::Vertex3D* pVert)
+    {
+        return pVert == NULL ? -1 : pVert->GetId();
+    }
+
+    //One rings, boundary flags and normals of halfEdgeMesh are the ones of pMesh
+    static bool CheckHalfEdgeMesh(const MagicDGP::Mesh3D* pMesh, const MagicDGP::HalfEdgeMesh3D* pHalfEdgeMesh)
+    {
+        int vertNum = pMesh->GetVertexNumber();
+        if (pHalfEdgeMesh->GetVertexNumber() != vertNum || pHalfEdgeMesh->GetEdgeNumber() != pMesh->GetEdgeNumber() || 
+            pHalfEdgeMesh->GetFaceNumber() != pMesh->GetFaceNumber())
+        {
+            printf("check failed: element numbers differ\n");
+            return false;
+        }
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            const MagicDGP::Vertex3D* pVert = pMesh->GetVertex(vid);
+            if (pHalfEdgeMesh->IsBoundaryVertex(vid) != (pVert->GetBoundaryType() == MagicDGP::BT_Boundary))
+            {
+                printf("check failed: boundary flag of vertex %d\n", vid);
+                return false;
+            }
+            const MagicDGP::Edge3D* pEdge = pVert->GetEdge();
+            MagicDGP::HalfEdgeMesh3D::OneRingIterator ring = pHalfEdgeMesh->GetOneRing(vid);
+            while (pEdge != NULL && !ring.IsDone())
+            {
+                if (ring.GetEdge() != pEdge->GetId() || ring.GetVertex() != pEdge->GetVertex()->GetId())
+                {
+                    break;
+                }
+                ring.Next();
+                pEdge = pEdge->GetPair()->GetNext();
+                if (pEdge == pVert->GetEdge())
+                {
+                    pEdge = NULL;
+                }
+            }
+            if (pEdge != NULL || !ring.IsDone())
+            {
+                printf("check failed: one ring of vertex %d\n", vid);
+                return false;
+            }
+            if ((pHalfEdgeMesh->GetNormal(vid) - pVert->GetNormal()).Length() > 1.0e-12)
+            {
+                printf("check failed: normal of vertex %d\n", vid);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //Every edge of pMeshCopy links the same ids as in pMesh
+    static bool CheckMeshTopology(const MagicDGP::Mesh3D* pMesh, const MagicDGP::Mesh3D* pMeshCopy)
+    {
+        int edgeNum = pMesh->GetEdgeNumber();
+        if (pMeshCopy->GetEdgeNumber() != edgeNum || pMeshCopy->GetVertexNumber() != pMesh->GetVertexNumber())
+        {
+            printf("check failed: element numbers of the converted Mesh3D differ\n");
+            return false;
+        }
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            const MagicDGP::Edge3D* pEdge = pMesh->GetEdge(eid);
+            const MagicDGP::Edge3D* pEdgeCopy = pMeshCopy->GetEdge(eid);
+            if (GetElementId(pEdge->GetVertex()) != GetElementId(pEdgeCopy->GetVertex()) || 
+                GetElementId(pEdge->GetNext()) != GetElementId(pEdgeCopy->GetNext()) || 
+                GetElementId(pEdge->GetPre()) != GetElementId(pEdgeCopy->GetPre()) || 
+                GetElementId(pEdge->GetPair()) != GetElementId(pEdgeCopy->GetPair()) || 
+                GetElementId(pEdge->GetFace()) != GetElementId(pEdgeCopy->GetFace()))
+            {
+                printf("check failed: edge %d of the converted Mesh3D\n", eid);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool RunHalfEdgeBenchmark(int elementNum)
+    {
+        printf("HalfEdge benchmark\n");
+        int resolution = int(sqrt(double(elementNum)));
+        resolution = resolution > 16 ? resolution : 16;
+        MagicDGP::Mesh3D* pMesh = GenerateWaveMesh(resolution);
+        printf("%d vertices\n", pMesh->GetVertexNumber());
+
+        double timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::HalfEdgeMesh3D* pHalfEdgeMesh = MagicDGP::HalfEdgeMesh3D::CreateFromMesh3D(pMesh);
+        printf("%-28s %8.4fs\n", "HalfEdgeMesh3D from Mesh3D", MagicCore::ToolKit::GetTime() - timeStart);
+
+        //Both normals on one thread, they walk the same one rings
+        MagicCore::SetParallelThreadNumber(1);
+        timeStart = MagicCore::ToolKit::GetTime();
+        pMesh->UpdateNormal();
+        printf("%-28s %8.4fs\n", "Mesh3D::UpdateNormal", MagicCore::ToolKit::GetTime() - timeStart);
+        MagicCore::SetParallelThreadNumber(0);
+        timeStart = MagicCore::ToolKit::GetTime();
+        pHalfEdgeMesh->UpdateNormal();
+        printf("%-28s %8.4fs\n", "HalfEdgeMesh3D::UpdateNormal", MagicCore::ToolKit::GetTime() - timeStart);
+
+        timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::Mesh3D* pMeshCopy = pHalfEdgeMesh->CreateMesh3D();
+        printf("%-28s %8.4fs\n", "Mesh3D from HalfEdgeMesh3D", MagicCore::ToolKit::GetTime() - timeStart);
+
+        bool isPassed = CheckHalfEdgeMesh(pMesh, pHalfEdgeMesh) && CheckMeshTopology(pMesh, pMeshCopy);
+        printf("%-28s %s\n", "HalfEdgeMesh3D topology", isPassed ? "passed" : "FAILED");
+        delete pMeshCopy;
+        delete pHalfEdgeMesh;
+        delete pMesh;
+        return isPassed;
+    }
+}
@@ -0,0 +1,452 @@
+#include "Benchmark.h"
+#include "SyntheticData.h"
+#include "../Src/DGP/Parser.h"
+#include "../Src/DGP/Consolidation.h"
+#include "../Src/DGP/Sampling.h"
+#include "../Src/DGP/Registration.h"
+#include "../Src/DGP/SignedDistanceFunction.h"
+#include "../Src/DGP/PrimitiveDetection.h"
+#include "../Src/DGP/Relief.h"
+#include "../Src/DGP/Curvature.h"
+#include "../Src/DGP/MeshReconstruction.h"
+#include "../Src/Common/Parallel.h"
+#include "../Src/Common/Profiler.h"
+#include <stdio.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+namespace MagicBenchmark
+{
+    //On Linux the peak is reset before each kernel, on Windows it is the peak of the process so far
+    static void ResetPeakMemory()
+    {
+#ifndef _WIN32
+        FILE* pFile = fopen("/proc/self/clear_refs", "w");
+        if (pFile != NULL)
+        {
+            fputs("5", pFile);
+            fclose(pFile);
+        }
+#endif
+    }
+
+    //Peak resident set size in bytes
+    static long long GetPeakMemory()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return (long long)counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        long long peakMemory = 0;
+        FILE* pFile = fopen("/proc/self/status", "r");
+        if (pFile != NULL)
+        {
+            char line[256];
+            while (fgets(line, sizeof(line), pFile) != NULL)
+            {
+                long long peakKB = 0;
+                if (sscanf(line, "VmHWM: %lld kB", &peakKB) == 1)
+                {
+                    peakMemory = peakKB * 1024;
+                    break;
+                }
+            }
+            fclose(pFile);
+        }
+        return peakMemory;
+#endif
+    }
+
+    static std::string EscapeJson(const std::string& text)
+    {
+        std::string escapedText;
+        for (std::string::const_iterator itr = text.begin(); itr != text.end(); ++itr)
+        {
+            if (*itr == '"' || *itr == '\\')
+            {
+                escapedText += '\\';
+            }
+            escapedText += *itr;
+        }
+        return escapedText;
+    }
+
+    struct KernelResult
+    {
+        std::string mName;
+        std::string mDataset;
+        int mElementNum;
+        double mTime;
+        long long mPeakMemory;
+    };
+
+    //Times one kernel between Start and Stop and keeps the result for the JSON file
+    class KernelRecorder
+    {
+    public:
+        KernelRecorder() :
+            mResultList(),
+            mStartTime(0),
+            mIsPassed(true)
+        {
+        }
+
+        void Start()
+        {
+            ResetPeakMemory();
+            mStartTime = MagicCore::GetProfileTime();
+        }
+
+        void Stop(const std::string& name, const std::string& dataset, int elementNum)
+        {
+            KernelResult result;
+            result.mTime = (MagicCore::GetProfileTime() - mStartTime) * 1.0e-9;
+            result.mPeakMemory = GetPeakMemory();
+            result.mName = name;
+            result.mDataset = dataset;
+            result.mElementNum = elementNum;
+            mResultList.push_back(result);
+            printf("%-46s %-12s %9d elements  time: %8.4fs  %12.1f elements/s  peak: %8.1fMB\n", name.c_str(), dataset.c_str(),
+                elementNum, result.mTime, elementNum / result.mTime, result.mPeakMemory / 1048576.0);
+        }
+
+        //A failed check is printed and fails the run
+        void Check(bool isPassed, const std::string& name, const std::string& dataset)
+        {
+            if (!isPassed)
+            {
+                printf("%-46s %-12s check FAILED\n", name.c_str(), dataset.c_str());
+                mIsPassed = false;
+            }
+        }
+
+        bool IsPassed() const
+        {
+            return mIsPassed;
+        }
+
+        bool ExportJson(const std::string& fileName, int elementNum, int threadNum) const
+        {
+            FILE* pFile = fopen(fileName.c_str(), "w");
+            if (pFile == NULL)
+            {
+                printf("cannot open %s\n", fileName.c_str());
+                return false;
+            }
+            fprintf(pFile, "{\n  \"benchmark\": \"kernel\",\n  \"elementNumber\": %d,\n  \"threadNumber\": %d,\n  \"passed\": %s,\n  \"kernels\": [", 
+                elementNum, threadNum, mIsPassed ? "true" : "false");
+            for (int rid = 0; rid < int(mResultList.size()); rid++)
+            {
+                const KernelResult& result = mResultList.at(rid);
+                fprintf(pFile, "%s\n    {\"name\": \"%s\", \"dataset\": \"%s\", \"elements\": %d, \"time\": %.6f, \"throughput\": %.1f, \"peakRSS\": %lld}",
+                    rid == 0 ? "" : ",", EscapeJson(result.mName).c_str(), EscapeJson(result.mDataset).c_str(), result.mElementNum,
+                    result.mTime, result.mElementNum / result.mTime, result.mPeakMemory);
+            }
+            fprintf(pFile, "\n  ]\n}\n");
+            fclose(pFile);
+            return true;
+        }
+
+    private:
+        std::vector<KernelResult> mResultList;
+        long long mStartTime;
+        bool mIsPassed;
+    };
+
+    static MagicDGP::Point3DSet* CopyPointSet(const MagicDGP::Point3DSet* pPointSet)
+    {
+        MagicDGP::Point3DSet* pCopy = new MagicDGP::Point3DSet;
+        int pointNum = pPointSet->GetPointNumber();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            const MagicDGP::Point3D* pPoint = pPointSet->GetPoint(pid);
+            pCopy->InsertPoint(pPoint->GetPosition(), pPoint->GetNormal());
+        }
+        pCopy->SetHasNormal(pPointSet->HasNormal());
+        return pCopy;
+    }
+
+    //WLOP and the bounding box read the cached box and density, as after loading in PointShopApp
+    static void PreparePointSet(MagicDGP::Point3DSet* pPointSet)
+    {
+        pPointSet->CalculateBBox();
+        pPointSet->CalculateDensity();
+    }
+
+    //Rotated by 2 degrees around z and moved by 1% of the bounding box
+    static MagicDGP::Point3DSet* CreateMovedPointSet(const MagicDGP::Point3DSet* pPointSet)
+    {
+        MagicMath::Vector3 bboxMin, bboxMax;
+        pPointSet->GetBBox(bboxMin, bboxMax);
+        double offset = (bboxMax - bboxMin).Length() * 0.01;
+        double angle = 2.0 * 3.14159265358979323846 / 180.0;
+        MagicMath::HomoMatrix4 transform;
+        transform.Unit();
+        transform.SetValue(0, 0, cos(angle));
+        transform.SetValue(0, 1, -sin(angle));
+        transform.SetValue(1, 0, sin(angle));
+        transform.SetValue(1, 1, cos(angle));
+        transform.SetValue(0, 3, offset);
+        MagicDGP::Point3DSet* pMoved = new MagicDGP::Point3DSet;
+        int pointNum = pPointSet->GetPointNumber();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            const MagicDGP::Point3D* pPoint = pPointSet->GetPoint(pid);
+            pMoved->InsertPoint(transform.TransformPoint(pPoint->GetPosition()), transform.RotateVector(pPoint->GetNormal()));
+        }
+        pMoved->SetHasNormal(pPointSet->HasNormal());
+        return pMoved;
+    }
+
+    static void RunParserKernel(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        std::string fileName = "MagicBenchmark_kernel.obj";
+        MagicDGP::Parser::ExportPointSet(fileName, pPointSet);
+        recorder.Start();
+        MagicDGP::Point3DSet* pParsed = MagicDGP::Parser::ParsePointSet(fileName);
+        recorder.Stop("Parser::ParsePointSet", dataset, pPointSet->GetPointNumber());
+        delete pParsed;
+        remove(fileName.c_str());
+    }
+
+    static void RunNormalKernel(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        MagicDGP::Point3DSet* pCopy = CopyPointSet(pPointSet);
+        recorder.Start();
+        MagicDGP::Consolidation::CalPointSetNormal(pCopy);
+        recorder.Stop("Consolidation::CalPointSetNormal", dataset, pCopy->GetPointNumber());
+        delete pCopy;
+    }
+
+    //LightPoint3DSet indexes its float positions in place, the second call reuses the cached index
+    static void RunDensityKernel(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        MagicDGP::Point3DSet* pCopy = CopyPointSet(pPointSet);
+        recorder.Start();
+        pCopy->CalculateDensity();
+        recorder.Stop("Point3DSet::CalculateDensity", dataset, pCopy->GetPointNumber());
+        MagicDGP::LightPoint3DSet* pLightSet = MagicDGP::LightPoint3DSet::CreateFromPoint3DSet(pPointSet);
+        recorder.Start();
+        pLightSet->CalculateDensity();
+        recorder.Stop("LightPoint3DSet::CalculateDensity", dataset, pLightSet->GetPointNumber());
+        double density = pLightSet->GetDensity();
+        recorder.Start();
+        pLightSet->CalculateDensity();
+        recorder.Stop("LightPoint3DSet::CalculateDensity cached", dataset, pLightSet->GetPointNumber());
+        //Both search the same float positions, but each builds its own randomized kd-trees
+        double refDensity = pCopy->GetDensity();
+        recorder.Check(fabs(density - refDensity) <= 0.01 * refDensity && pLightSet->GetDensity() == density, 
+            "LightPoint3DSet::CalculateDensity", dataset);
+        delete pLightSet;
+        delete pCopy;
+    }
+
+    static void RunOutlierKernel(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        MagicDGP::Point3DSet* pCopy = CopyPointSet(pPointSet);
+        recorder.Start();
+        MagicDGP::Point3DSet* pInlier = MagicDGP::Consolidation::RemovePointSetOutlier(pCopy, 0.05);
+        recorder.Stop("Consolidation::RemovePointSetOutlier", dataset, pCopy->GetPointNumber());
+        delete pInlier;
+        delete pCopy;
+    }
+
+    static void RunSamplingKernels(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        int pointNum = pPointSet->GetPointNumber();
+        int sampleNum = pointNum / 10 > 1 ? pointNum / 10 : 1;
+        recorder.Start();
+        MagicDGP::Point3DSet* pWLOPSample = MagicDGP::Sampling::PointSetWLOPSampling(pPointSet, sampleNum);
+        recorder.Stop("Sampling::PointSetWLOPSampling", dataset, pointNum);
+        delete pWLOPSample;
+
+        //Farthest point sampling is samples x points
+        MagicDGP::Point3DSet* pCopy = CopyPointSet(pPointSet);
+        sampleNum = sampleNum < 1000 ? sampleNum : 1000;
+        recorder.Start();
+        MagicDGP::Point3DSet* pUniformSample = MagicDGP::Sampling::PointSetUniformSampling(pCopy, sampleNum);
+        recorder.Stop("Sampling::PointSetUniformSampling", dataset, pointNum);
+        delete pUniformSample;
+        delete pCopy;
+    }
+
+    static void RunICPKernel(const MagicDGP::Point3DSet* pRef, MagicDGP::Point3DSet* pOrigin, const std::string& dataset, KernelRecorder& recorder)
+    {
+        MagicMath::HomoMatrix4 transInit, transRes;
+        transInit.Unit();
+        MagicDGP::Registration registration;
+        recorder.Start();
+        registration.ICPRegistrate(pRef, pOrigin, &transInit, &transRes);
+        recorder.Stop("Registration::ICPRegistrate", dataset, pRef->GetPointNumber() + pOrigin->GetPointNumber());
+    }
+
+    static void RunPoissonKernel(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        if (!MagicDGP::MeshReconstruction::IsScreenPoissonAvailable())
+        {
+            printf("%-46s %-12s skipped, built without PoissonRecon\n", "MeshReconstruction::ScreenPoisson", dataset.c_str());
+            return;
+        }
+        recorder.Start();
+        MagicDGP::LightMesh3D* pMesh = MagicDGP::MeshReconstruction::ScreenPoissonReconstruction(pPointSet);
+        recorder.Stop("MeshReconstruction::ScreenPoisson", dataset, pPointSet->GetPointNumber());
+        delete pMesh;
+    }
+
+    static void RunPointSetKernels(const MagicDGP::Point3DSet* pPointSet, const std::string& dataset, KernelRecorder& recorder)
+    {
+        RunParserKernel(pPointSet, dataset, recorder);
+        RunNormalKernel(pPointSet, dataset, recorder);
+        RunDensityKernel(pPointSet, dataset, recorder);
+        RunOutlierKernel(pPointSet, dataset, recorder);
+        RunSamplingKernels(pPointSet, dataset, recorder);
+        RunPoissonKernel(pPointSet, dataset, recorder);
+    }
+
+    //Frames of GeneratedDepthSource: ICP between the first two frames and SDF fusion of all of them
+    static void RunDepthKernels(int frameNum, KernelRecorder& recorder)
+    {
+        GeneratedDepthSource source(frameNum);
+        MagicDGP::DepthRangeLimit range;
+        std::vector<MagicDGP::Point3DSet*> frameList;
+        MagicDGP::DepthFrame frame;
+        int pixelNum = 0;
+        recorder.Start();
+        while (source.ReadFrame(frame))
+        {
+            frameList.push_back(MagicDGP::DepthFrameConverter::ToPointSet(frame, source.GetXZFactor(), source.GetYZFactor(), range));
+            pixelNum += frame.mResolutionX * frame.mResolutionY;
+        }
+        recorder.Stop("DepthFrameConverter::ToPointSet", "depth frames", pixelNum);
+
+        if (frameList.size() > 1)
+        {
+            RunICPKernel(frameList.at(0), frameList.at(1), "depth frames", recorder);
+        }
+
+        //The box of ReconstructionApp at a lower resolution
+        MagicDGP::SignedDistanceFunction sdf(128, 128, 128, range.mLeft, range.mRight, range.mDown, range.mTop, range.mBack, range.mFront);
+        MagicMath::HomoMatrix4 transform;
+        transform.Unit();
+        int fusedNum = 0;
+        recorder.Start();
+        for (int fid = 0; fid < int(frameList.size()); fid++)
+        {
+            if (fid == 0)
+            {
+                sdf.UpdateFineSDF(frameList.at(fid), &transform);
+            }
+            else
+            {
+                sdf.UpdateSDF(frameList.at(fid), &transform);
+            }
+            fusedNum += frameList.at(fid)->GetPointNumber();
+        }
+        recorder.Stop("SignedDistanceFunction::UpdateSDF", "depth frames", fusedNum);
+        recorder.Start();
+        MagicDGP::Point3DSet* pFused = sdf.ExtractFinePointCloud();
+        recorder.Stop("SignedDistanceFunction::ExtractFinePointCloud", "depth frames", 128 * 128 * 128);
+        delete pFused;
+        for (std::vector<MagicDGP::Point3DSet*>::iterator itr = frameList.begin(); itr != frameList.end(); ++itr)
+        {
+            delete (*itr);
+        }
+    }
+
+    static void RunMeshKernels(int vertNum, KernelRecorder& recorder)
+    {
+        int resolution = int(sqrt(double(vertNum)));
+        resolution = resolution > 16 ? resolution : 16;
+        MagicDGP::Mesh3D* pWaveMesh = GenerateWaveMesh(resolution);
+        std::vector<double> curvList;
+        recorder.Start();
+        MagicDGP::Curvature::CalGaussianCurvature(pWaveMesh, curvList);
+        recorder.Stop("Curvature::CalGaussianCurvature", "wave mesh", pWaveMesh->GetVertexNumber());
+        recorder.Start();
+        MagicDGP::Curvature::CalMeanCurvature(pWaveMesh, curvList);
+        recorder.Stop("Curvature::CalMeanCurvature", "wave mesh", pWaveMesh->GetVertexNumber());
+        delete pWaveMesh;
+
+        //Candidates are only sampled with more than 500 vertices off the feature lines
+        MagicDGP::Mesh3D* pPrimitiveMesh = GeneratePrimitiveMesh(resolution);
+        std::vector<int> primitiveList;
+        recorder.Start();
+        MagicDGP::PrimitiveDetection::Primitive2DDetection(pPrimitiveMesh, primitiveList);
+        recorder.Stop("PrimitiveDetection::Primitive2DDetection", "CAD part", pPrimitiveMesh->GetVertexNumber());
+        delete pPrimitiveMesh;
+
+        int reliefResolution = int(sqrt(vertNum / 4.0));
+        reliefResolution = reliefResolution > 16 ? reliefResolution : 16;
+        std::vector<double> heightField;
+        GenerateHeightField(reliefResolution, reliefResolution, heightField);
+        recorder.Start();
+        //The resolution of the relief is the cell number, heights are at the cell corners
+        MagicDGP::LightMesh3D* pRelief = MagicDGP::ReliefGeneration::PlaneReliefFromHeightField(heightField, reliefResolution - 1, reliefResolution - 1);
+        recorder.Stop("ReliefGeneration::PlaneReliefFromHeightField", "height field", reliefResolution * reliefResolution);
+        delete pRelief;
+    }
+
+    bool RunKernelBenchmark(int elementNum, const std::string& resultFileName, const std::string& inputFileName)
+    {
+        printf("Kernel benchmark\n");
+        int pointNum = elementNum / 20 > 2000 ? elementNum / 20 : 2000;
+        int threadNum = MagicCore::GetParallelThreadNumber();
+        printf("%d points, %d threads\n", pointNum, threadNum);
+        KernelRecorder recorder;
+
+        MagicDGP::Point3DSet* pSphere = GenerateSpherePointSet(pointNum, 0.002, 1);
+        PreparePointSet(pSphere);
+        RunPointSetKernels(pSphere, "sphere", recorder);
+        MagicDGP::Point3DSet* pMovedSphere = CreateMovedPointSet(pSphere);
+        RunICPKernel(pSphere, pMovedSphere, "sphere", recorder);
+        delete pMovedSphere;
+        delete pSphere;
+
+        MagicDGP::Point3DSet* pPlane = GeneratePlanePointSet(pointNum, 0.002, 0.05, 2);
+        RunNormalKernel(pPlane, "noisy plane", recorder);
+        RunOutlierKernel(pPlane, "noisy plane", recorder);
+        delete pPlane;
+
+        RunDepthKernels(4, recorder);
+        RunMeshKernels(pointNum, recorder);
+
+        if (!inputFileName.empty())
+        {
+            MagicDGP::Point3DSet* pInput = MagicDGP::Parser::ParsePointSet(inputFileName);
+            if (pInput == NULL || pInput->GetPointNumber() == 0)
+            {
+                printf("cannot read %s\n", inputFileName.c_str());
+            }
+            else
+            {
+                if (!pInput->HasNormal())
+                {
+                    MagicDGP::Consolidation::CalPointSetNormal(pInput);
+                }
+                PreparePointSet(pInput);
+                RunPointSetKernels(pInput, inputFileName, recorder);
+                MagicDGP::Point3DSet* pMovedInput = CreateMovedPointSet(pInput);
+                RunICPKernel(pInput, pMovedInput, inputFileName, recorder);
+                delete pMovedInput;
+            }
+            delete pInput;
+        }
+
+        if (recorder.ExportJson(resultFileName, elementNum, threadNum))
+        {
+            printf("results: %s\n", resultFileName.c_str());
+        }
+        return recorder.IsPassed();
+    }
+}
@@ -0,0 +1,158 @@
+#include "Benchmark.h"
+#include "SyntheticData.h"
+#include "../Src/DGP/Mesh3D.h"
+#include "../Src/DGP/Curvature.h"
+#include "../Src/DGP/SpatialIndex.h"
+#include "../Src/Common/Parallel.h"
+#include "../Src/Common/ToolKit.h"
+#include <stdio.h>
+#include <math.h>
+
+namespace MagicBenchmark
+{
+    static void PrintParallelResult(const char* name, int threadNum, double serialTime, double time, double maxDiff)
+    {
+        printf("%-28s %3d threads  serial: %8.4fs  parallel: %8.4fs  speedup: %5.2f  max diff: %g\n",
+            name, threadNum, serialTime, time, serialTime / time, maxDiff);
+    }
+
+    static double MaxDifference(const std::vector<double>& valueList0, const std::vector<double>& valueList1)
+    {
+        double maxDiff = 0;
+        for (int vid = 0; vid < int(valueList0.size()); vid++)
+        {
+            double diff = fabs(valueList0.at(vid) - valueList1.at(vid));
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+        return maxDiff;
+    }
+
+    static double SumArea(const std::vector<double>& areaList)
+    {
+        return MagicCore::ParallelReduce(0, int(areaList.size()), 0.0,
+            [&](int startIndex, int endIndex, double sum) -> double
+        {
+            for (int fid = startIndex; fid < endIndex; fid++)
+            {
+                sum += areaList.at(fid);
+            }
+            return sum;
+        }, [](double leftSum, double rightSum) -> double { return leftSum + rightSum; });
+    }
+
+    static bool PrintCheck(const char* name, bool isPassed)
+    {
+        printf("%-28s %s\n", name, isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+
+    //Every vertex is computed on its own, so the parallel results equal the serial ones exactly
+    bool RunParallelBenchmark(int elementNum)
+    {
+        printf("Parallel benchmark\n");
+        int resolution = int(sqrt(double(elementNum)));
+        resolution = resolution > 16 ? resolution : 16;
+        MagicDGP::Mesh3D* pMesh = GenerateWaveMesh(resolution);
+        int vertNum = pMesh->GetVertexNumber();
+        MagicCore::SetParallelThreadNumber(0);
+        int threadNum = MagicCore::GetParallelThreadNumber();
+        printf("%d vertices\n", vertNum);
+
+        //Mesh3D::UpdateNormal
+        MagicCore::SetParallelThreadNumber(1);
+        double timeStart = MagicCore::ToolKit::GetTime();
+        pMesh->UpdateNormal();
+        double serialTime = MagicCore::ToolKit::GetTime() - timeStart;
+        std::vector<MagicMath::Vector3> serialNormList(vertNum);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            serialNormList.at(vid) = pMesh->GetVertex(vid)->GetNormal();
+        }
+        MagicCore::SetParallelThreadNumber(0);
+        timeStart = MagicCore::ToolKit::GetTime();
+        pMesh->UpdateNormal();
+        double parallelTime = MagicCore::ToolKit::GetTime() - timeStart;
+        double maxDiff = 0;
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            double diff = (pMesh->GetVertex(vid)->GetNormal() - serialNormList.at(vid)).Length();
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+        PrintParallelResult("Mesh3D::UpdateNormal", threadNum, serialTime, parallelTime, maxDiff);
+        bool isPassed = PrintCheck("Mesh3D::UpdateNormal result", maxDiff == 0);
+
+        //Curvature
+        std::vector<double> serialCurvList, curvList;
+        MagicCore::SetParallelThreadNumber(1);
+        timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::Curvature::CalGaussianCurvature(pMesh, serialCurvList);
+        serialTime = MagicCore::ToolKit::GetTime() - timeStart;
+        MagicCore::SetParallelThreadNumber(0);
+        timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::Curvature::CalGaussianCurvature(pMesh, curvList);
+        parallelTime = MagicCore::ToolKit::GetTime() - timeStart;
+        maxDiff = (serialCurvList.size() == vertNum && curvList.size() == vertNum) ? MaxDifference(serialCurvList, curvList) : -1;
+        PrintParallelResult("CalGaussianCurvature", threadNum, serialTime, parallelTime, maxDiff);
+        isPassed = PrintCheck("CalGaussianCurvature result", maxDiff == 0) && isPassed;
+
+        MagicCore::SetParallelThreadNumber(1);
+        timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::Curvature::CalMeanCurvature(pMesh, serialCurvList);
+        serialTime = MagicCore::ToolKit::GetTime() - timeStart;
+        MagicCore::SetParallelThreadNumber(0);
+        timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::Curvature::CalMeanCurvature(pMesh, curvList);
+        parallelTime = MagicCore::ToolKit::GetTime() - timeStart;
+        maxDiff = (serialCurvList.size() == vertNum && curvList.size() == vertNum) ? MaxDifference(serialCurvList, curvList) : -1;
+        PrintParallelResult("CalMeanCurvature", threadNum, serialTime, parallelTime, maxDiff);
+        isPassed = PrintCheck("CalMeanCurvature result", maxDiff == 0) && isPassed;
+
+        //kNN of every vertex, queries are split between the threads
+        std::vector<MagicMath::Vector3> posList(vertNum);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            posList.at(vid) = pMesh->GetVertex(vid)->GetPosition();
+        }
+        MagicDGP::SpatialIndex spatialIndex;
+        spatialIndex.Build(posList);
+        const int nn = 9;
+        std::vector<int> serialIndexList, indexList;
+        std::vector<float> serialDistList, distList;
+        MagicCore::SetParallelThreadNumber(1);
+        timeStart = MagicCore::ToolKit::GetTime();
+        spatialIndex.KnnSearchSelf(nn, serialIndexList, serialDistList);
+        serialTime = MagicCore::ToolKit::GetTime() - timeStart;
+        MagicCore::SetParallelThreadNumber(0);
+        timeStart = MagicCore::ToolKit::GetTime();
+        spatialIndex.KnnSearchSelf(nn, indexList, distList);
+        parallelTime = MagicCore::ToolKit::GetTime() - timeStart;
+        int diffNum = 0;
+        for (int nid = 0; nid < int(indexList.size()) && nid < int(serialIndexList.size()); nid++)
+        {
+            if (indexList.at(nid) != serialIndexList.at(nid) || distList.at(nid) != serialDistList.at(nid))
+            {
+                diffNum++;
+            }
+        }
+        PrintParallelResult("SpatialIndex::KnnSearchSelf", threadNum, serialTime, parallelTime, diffNum);
+        isPassed = PrintCheck("KnnSearchSelf result", serialIndexList.size() == vertNum * nn && indexList == serialIndexList
+            && distList == serialDistList) && isPassed;
+
+        //ParallelReduce joins chunk sums in index order, the sum is the same in every run with the same thread number.
+        //Chunks follow the thread number, so the serial sum differs by rounding only
+        std::vector<double> areaList(pMesh->GetFaceNumber());
+        for (int fid = 0; fid < int(areaList.size()); fid++)
+        {
+            areaList.at(fid) = pMesh->GetFace(fid)->GetArea();
+        }
+        MagicCore::SetParallelThreadNumber(1);
+        double serialAreaSum = SumArea(areaList);
+        MagicCore::SetParallelThreadNumber(0);
+        double areaSum = SumArea(areaList);
+        printf("%-28s %.12f\n", "ParallelReduce area sum", areaSum);
+        isPassed = PrintCheck("ParallelReduce result", fabs(areaSum - serialAreaSum) <= 1.0e-12 * serialAreaSum
+            && areaSum == SumArea(areaList)) && isPassed;
+        delete pMesh;
+        return isPassed;
+    }
+}
@@ -0,0 +1,464 @@
+#include "Benchmark.h"
+#include "../Src/DGP/ObjReader.h"
+#include "../Src/DGP/StlReader.h"
+#include "../Src/DGP/Parser.h"
+#include "../Src/DGP/SnapshotFile.h"
+#include "../Src/Common/ToolKit.h"
+#include <fstream>
+#include <map>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+namespace MagicBenchmark
+{
+    static void PrintResult(const char* name, double fileSize, double time)
+    {
+        printf("%-28s %8.1fMB  time: %8.4fs  %8.1fMB/s\n", name, fileSize / 1048576.0, time, fileSize / 1048576.0 / time);
+    }
+
+    static bool PrintCheck(const char* name, bool isPassed)
+    {
+        printf("%-28s %s\n", name, isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+
+    //Grid of the generated files, resolution * resolution vertices and 2 triangles per quad
+    static int GetGridResolution(int vertNum)
+    {
+        return int(sqrt(double(vertNum))) + 1;
+    }
+
+    static MagicMath::Vector3 GetGridPosition(int x, int y)
+    {
+        return MagicMath::Vector3(x * 0.001, y * 0.001, sin(x * 0.01) * cos(y * 0.01));
+    }
+
+    static double GetMaxDifference(const MagicMath::Vector3& pos0, const MagicMath::Vector3& pos1)
+    {
+        double maxDiff = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            double diff = fabs(pos0[k] - pos1[k]);
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+        return maxDiff;
+    }
+
+    //Grid mesh with about vertNum vertices
+    static double WriteGridObj(const std::string& fileName, int vertNum)
+    {
+        int resolution = GetGridResolution(vertNum);
+        FILE* pFile = fopen(fileName.c_str(), "wb");
+        if (pFile == NULL)
+        {
+            return 0;
+        }
+        for (int y = 0; y < resolution; y++)
+        {
+            for (int x = 0; x < resolution; x++)
+            {
+                MagicMath::Vector3 pos = GetGridPosition(x, y);
+                fprintf(pFile, "v %f %f %f\n", pos[0], pos[1], pos[2]);
+            }
+        }
+        for (int y = 0; y < resolution - 1; y++)
+        {
+            for (int x = 0; x < resolution - 1; x++)
+            {
+                int vid = y * resolution + x + 1;
+                fprintf(pFile, "f %d %d %d\n", vid, vid + 1, vid + resolution + 1);
+                fprintf(pFile, "f %d %d %d\n", vid, vid + resolution + 1, vid + resolution);
+            }
+        }
+        double fileSize = ftell(pFile);
+        fclose(pFile);
+        return fileSize;
+    }
+
+    //Binary STL triangle soup of the same grid
+    static double WriteGridStl(const std::string& fileName, int vertNum)
+    {
+        int resolution = GetGridResolution(vertNum);
+        FILE* pFile = fopen(fileName.c_str(), "wb");
+        if (pFile == NULL)
+        {
+            return 0;
+        }
+        char header[80];
+        memset(header, 0, sizeof(header));
+        fwrite(header, sizeof(header), 1, pFile);
+        unsigned int faceNum = (resolution - 1) * (resolution - 1) * 2;
+        fwrite(&faceNum, sizeof(faceNum), 1, pFile);
+        float record[12];
+        unsigned short attr = 0;
+        for (int y = 0; y < resolution - 1; y++)
+        {
+            for (int x = 0; x < resolution - 1; x++)
+            {
+                int quad[4][2] = {{x, y}, {x + 1, y}, {x + 1, y + 1}, {x, y + 1}};
+                int triangle[2][3] = {{0, 1, 2}, {0, 2, 3}};
+                for (int tid = 0; tid < 2; tid++)
+                {
+                    record[0] = 0;
+                    record[1] = 0;
+                    record[2] = 1;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        MagicMath::Vector3 pos = GetGridPosition(quad[triangle[tid][k]][0], quad[triangle[tid][k]][1]);
+                        record[3 + k * 3] = float(pos[0]);
+                        record[4 + k * 3] = float(pos[1]);
+                        record[5 + k * 3] = float(pos[2]);
+                    }
+                    fwrite(record, sizeof(record), 1, pFile);
+                    fwrite(&attr, sizeof(attr), 1, pFile);
+                }
+            }
+        }
+        double fileSize = ftell(pFile);
+        fclose(pFile);
+        return fileSize;
+    }
+
+    //Positions of the OBJ grid are written with 6 decimals
+    static bool CheckObjGrid(const std::vector<MagicMath::Vector3>& posList, const std::vector<int>& indexList, int resolution)
+    {
+        if (posList.size() != resolution * resolution || indexList.size() != (resolution - 1) * (resolution - 1) * 6)
+        {
+            printf("check failed: OBJ element numbers %d %d\n", int(posList.size()), int(indexList.size()));
+            return false;
+        }
+        for (int vid = 0; vid < posList.size(); vid++)
+        {
+            if (GetMaxDifference(posList.at(vid), GetGridPosition(vid % resolution, vid / resolution)) > 1.0e-6)
+            {
+                printf("check failed: OBJ position %d\n", vid);
+                return false;
+            }
+        }
+        for (int y = 0; y < resolution - 1; y++)
+        {
+            for (int x = 0; x < resolution - 1; x++)
+            {
+                int vid = y * resolution + x;
+                int triangle[6] = {vid, vid + 1, vid + resolution + 1, vid, vid + resolution + 1, vid + resolution};
+                int fid = (y * (resolution - 1) + x) * 2;
+                for (int k = 0; k < 6; k++)
+                {
+                    if (indexList.at(fid * 3 + k) != triangle[k])
+                    {
+                        printf("check failed: OBJ triangle %d\n", fid + k / 3);
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    //Welded STL vertices are in the order of first occurrence, so the triangles are checked against the float grid
+    static bool CheckStlGrid(const std::vector<MagicMath::Vector3>& posList, const std::vector<int>& indexList, int resolution)
+    {
+        if (posList.size() != resolution * resolution || indexList.size() != (resolution - 1) * (resolution - 1) * 6)
+        {
+            printf("check failed: STL element numbers %d %d\n", int(posList.size()), int(indexList.size()));
+            return false;
+        }
+        for (int y = 0; y < resolution - 1; y++)
+        {
+            for (int x = 0; x < resolution - 1; x++)
+            {
+                int quad[4][2] = {{x, y}, {x + 1, y}, {x + 1, y + 1}, {x, y + 1}};
+                int triangle[6] = {0, 1, 2, 0, 2, 3};
+                int fid = (y * (resolution - 1) + x) * 2;
+                for (int k = 0; k < 6; k++)
+                {
+                    MagicMath::Vector3 pos = GetGridPosition(quad[triangle[k]][0], quad[triangle[k]][1]);
+                    MagicMath::Vector3 floatPos = MagicMath::Vector3(float(pos[0]), float(pos[1]), float(pos[2]));
+                    int vid = indexList.at(fid * 3 + k);
+                    if (vid < 0 || vid >= posList.size() || GetMaxDifference(posList.at(vid), floatPos) > 0)
+                    {
+                        printf("check failed: STL triangle %d\n", fid + k / 3);
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    //The per float fread and std::map weld which Parser used before StlReader
+    static int ReadStlByMap(const std::string& fileName)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            return 0;
+        }
+        int faceNum;
+        fseek(pFile, 80, SEEK_SET);
+        fread(&faceNum, sizeof(int), 1, pFile);
+        std::map<MagicMath::Vector3, int> vertPosMap;
+        std::vector<int> indexList;
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            float xx, yy, zz;
+            fread(&xx, sizeof(xx), 1, pFile);
+            fread(&yy, sizeof(yy), 1, pFile);
+            fread(&zz, sizeof(zz), 1, pFile);
+            for (int vid = 0; vid < 3; vid++)
+            {
+                fread(&xx, sizeof(xx), 1, pFile);
+                fread(&yy, sizeof(yy), 1, pFile);
+                fread(&zz, sizeof(zz), 1, pFile);
+                std::pair<std::map<MagicMath::Vector3, int>::iterator, bool> mapRes
+                    = vertPosMap.insert(std::pair<MagicMath::Vector3, int>(MagicMath::Vector3(xx, yy, zz), vertPosMap.size()));
+                indexList.push_back(mapRes.first->second);
+            }
+            unsigned short attr;
+            fread(&attr, sizeof(unsigned short), 1, pFile);
+        }
+        fclose(pFile);
+        return vertPosMap.size();
+    }
+
+    //The getline and strtok loop which Parser used before ObjReader
+    static int ReadObjByLine(const std::string& fileName)
+    {
+        std::ifstream fin(fileName.c_str());
+        const int maxSize = 512;
+        char pLine[maxSize];
+        std::vector<MagicMath::Vector3> posList;
+        std::vector<int> indexList;
+        while (fin.getline(pLine, maxSize))
+        {
+            if (pLine[0] == 'v' && pLine[1] == ' ')
+            {
+                char* tok = strtok(pLine, " ");
+                MagicMath::Vector3 pos;
+                for (int i = 0; i < 3; i++)
+                {
+                    tok = strtok(NULL, " ");
+                    pos[i] = (double)atof(tok);
+                }
+                posList.push_back(pos);
+            }
+            else if (pLine[0] == 'f' && pLine[1] == ' ')
+            {
+                char* tok = strtok(pLine, " ");
+                for (int i = 0; i < 3; i++)
+                {
+                    tok = strtok(NULL, " ");
+                    indexList.push_back((int)strtol(tok, NULL, 10) - 1);
+                }
+            }
+        }
+        return posList.size();
+    }
+
+    //Parsed mesh has the same faces, and positions equal to the exported ones, rounded to float if isFloat
+    static bool CheckRoundTrip(const MagicDGP::LightMesh3D* pMesh, const MagicDGP::LightMesh3D* pParsedMesh, bool isFloat)
+    {
+        if (pParsedMesh == NULL || pParsedMesh->GetVertexNumber() != pMesh->GetVertexNumber()
+            || pParsedMesh->GetFaceNumber() != pMesh->GetFaceNumber())
+        {
+            printf("check failed: element numbers differ\n");
+            return false;
+        }
+        for (int vid = 0; vid < pMesh->GetVertexNumber(); vid++)
+        {
+            MagicMath::Vector3 pos = pMesh->GetPosition(vid);
+            if (isFloat)
+            {
+                pos = MagicMath::Vector3(float(pos[0]), float(pos[1]), float(pos[2]));
+            }
+            if (GetMaxDifference(pParsedMesh->GetPosition(vid), pos) > 0)
+            {
+                printf("check failed: position %d\n", vid);
+                return false;
+            }
+        }
+        for (int fid = 0; fid < pMesh->GetFaceNumber(); fid++)
+        {
+            MagicDGP::FaceIndex faceIdx = pMesh->GetFace(fid);
+            MagicDGP::FaceIndex parsedFaceIdx = pParsedMesh->GetFace(fid);
+            for (int k = 0; k < 3; k++)
+            {
+                if (parsedFaceIdx.mIndex[k] != faceIdx.mIndex[k])
+                {
+                    printf("check failed: face %d\n", fid);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    //Export and parse again, the time of both is reported
+    static bool RunRoundTrip(const char* name, const std::string& fileName, const MagicDGP::LightMesh3D* pMesh, bool isFloat)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::Parser::ExportLightMesh3D(fileName, pMesh);
+        double exportTime = MagicCore::ToolKit::GetTime() - timeStart;
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            printf("can not write %s\n", fileName.c_str());
+            return false;
+        }
+        fseek(pFile, 0, SEEK_END);
+        double fileSize = ftell(pFile);
+        fclose(pFile);
+        timeStart = MagicCore::ToolKit::GetTime();
+        MagicDGP::LightMesh3D* pParsedMesh = MagicDGP::Parser::ParseLightMesh3D(fileName);
+        double parseTime = MagicCore::ToolKit::GetTime() - timeStart;
+        printf("%-28s %8.1fMB  export: %8.4fs  parse: %8.4fs  total: %8.4fs\n", name, fileSize / 1048576.0,
+            exportTime, parseTime, exportTime + parseTime);
+        bool isPassed = CheckRoundTrip(pMesh, pParsedMesh, isFloat);
+        delete pParsedMesh;
+        remove(fileName.c_str());
+        return isPassed;
+    }
+
+    bool RunParserBenchmark(int elementNum)
+    {
+        printf("Parser benchmark\n");
+        std::string fileName = "MagicBenchmark_temp.obj";
+        double fileSize = WriteGridObj(fileName, elementNum);
+        if (fileSize == 0)
+        {
+            printf("can not write %s\n", fileName.c_str());
+            return false;
+        }
+        int resolution = GetGridResolution(elementNum);
+        int vertNum = resolution * resolution;
+        int faceNum = (resolution - 1) * (resolution - 1) * 2;
+        bool isObjPassed = true;
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            int readNum = ReadObjByLine(fileName);
+            PrintResult("OBJ getline/strtok", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isObjPassed = (readNum == vertNum) && isObjPassed;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::ObjReader objReader;
+            objReader.Read(fileName);
+            PrintResult("OBJ ObjReader", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isObjPassed = CheckObjGrid(objReader.GetPositionList(), objReader.GetIndexList(), resolution) && isObjPassed;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Mesh3D* pMesh = MagicDGP::Parser::ParseMesh3D(fileName);
+            PrintResult("OBJ Parser::ParseMesh3D", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isObjPassed = (pMesh != NULL && pMesh->GetVertexNumber() == vertNum && pMesh->GetFaceNumber() == faceNum) && isObjPassed;
+            delete pMesh;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::LightMesh3D* pMesh = MagicDGP::Parser::ParseLightMesh3D(fileName);
+            PrintResult("OBJ Parser::ParseLightMesh3D", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isObjPassed = (pMesh != NULL && pMesh->GetVertexNumber() == vertNum && pMesh->GetFaceNumber() == faceNum) && isObjPassed;
+            delete pMesh;
+        }
+        bool isPassed = PrintCheck("OBJ parse result", isObjPassed);
+        {
+            //Text is written with the shortest round trip digits, PLY positions are float
+            MagicDGP::LightMesh3D* pMesh = MagicDGP::Parser::ParseLightMesh3D(fileName);
+            isPassed = PrintCheck("OBJ round trip result", RunRoundTrip("OBJ round trip", "MagicBenchmark_trip.obj", pMesh, false)) && isPassed;
+            isPassed = PrintCheck("PLY round trip result", RunRoundTrip("PLY round trip", "MagicBenchmark_trip.ply", pMesh, true)) && isPassed;
+            isPassed = PrintCheck("M3D round trip result", RunRoundTrip("M3D round trip", "MagicBenchmark_trip.m3d", pMesh, false)) && isPassed;
+            delete pMesh;
+        }
+        {
+            //Half edge snapshot against rebuilding the connectivity from OBJ
+            MagicDGP::Mesh3D* pMesh = MagicDGP::Parser::ParseMesh3D(fileName);
+            std::string snapshotName = "MagicBenchmark_temp.m3d";
+            MagicDGP::Parser::ExportMesh3D(snapshotName, pMesh);
+            delete pMesh;
+            FILE* pFile = fopen(snapshotName.c_str(), "rb");
+            double snapshotSize = 0;
+            if (pFile != NULL)
+            {
+                fseek(pFile, 0, SEEK_END);
+                snapshotSize = ftell(pFile);
+                fclose(pFile);
+            }
+            double timeStart = MagicCore::ToolKit::GetTime();
+            pMesh = MagicDGP::Parser::ParseMesh3D(snapshotName);
+            PrintResult("M3D Parser::ParseMesh3D", snapshotSize, MagicCore::ToolKit::GetTime() - timeStart);
+            bool isSnapshotPassed = (pMesh != NULL && pMesh->GetVertexNumber() == vertNum && pMesh->GetFaceNumber() == faceNum);
+            delete pMesh;
+            //Mapped view without pool objects, every face and its positions are touched once
+            timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::MappedSnapshot snapshot;
+            double coordSum = 0;
+            if (snapshot.Open(snapshotName))
+            {
+                int faceNum = snapshot.GetFaceNumber();
+                for (int fid = 0; fid < faceNum; fid++)
+                {
+                    MagicDGP::FaceIndex faceIdx = snapshot.GetFace(fid);
+                    coordSum += snapshot.GetPosition(faceIdx.mIndex[0])[0];
+                }
+            }
+            PrintResult("M3D MappedSnapshot", snapshotSize, MagicCore::ToolKit::GetTime() - timeStart);
+            //The view is checked against the grid, every x coordinate comes from the OBJ text
+            isSnapshotPassed = (snapshot.IsOpen() && snapshot.GetVertexNumber() == vertNum && snapshot.GetFaceNumber() == faceNum
+                && coordSum > 0) && isSnapshotPassed;
+            for (int vid = 0; isSnapshotPassed && vid < vertNum; vid++)
+            {
+                if (GetMaxDifference(snapshot.GetPosition(vid), GetGridPosition(vid % resolution, vid / resolution)) > 1.0e-6)
+                {
+                    printf("check failed: snapshot position %d\n", vid);
+                    isSnapshotPassed = false;
+                }
+            }
+            snapshot.Close();
+            isPassed = PrintCheck("M3D snapshot result", isSnapshotPassed) && isPassed;
+            remove(snapshotName.c_str());
+        }
+        remove(fileName.c_str());
+
+        fileName = "MagicBenchmark_temp.stl";
+        fileSize = WriteGridStl(fileName, elementNum);
+        if (fileSize == 0)
+        {
+            printf("can not write %s\n", fileName.c_str());
+            return false;
+        }
+        bool isStlPassed = true;
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            int readNum = ReadStlByMap(fileName);
+            PrintResult("STL fread/map", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isStlPassed = (readNum == vertNum) && isStlPassed;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::StlReader stlReader;
+            stlReader.Read(fileName);
+            PrintResult("STL StlReader", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isStlPassed = (stlReader.GetDegenerateNumber() == 0
+                && CheckStlGrid(stlReader.GetPositionList(), stlReader.GetIndexList(), resolution)) && isStlPassed;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Mesh3D* pMesh = MagicDGP::Parser::ParseMesh3D(fileName);
+            PrintResult("STL Parser::ParseMesh3D", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isStlPassed = (pMesh != NULL && pMesh->GetVertexNumber() == vertNum && pMesh->GetFaceNumber() == faceNum) && isStlPassed;
+            delete pMesh;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::LightMesh3D* pMesh = MagicDGP::Parser::ParseLightMesh3D(fileName);
+            PrintResult("STL Parser::ParseLightMesh3D", fileSize, MagicCore::ToolKit::GetTime() - timeStart);
+            isStlPassed = (pMesh != NULL && pMesh->GetVertexNumber() == vertNum && pMesh->GetFaceNumber() == faceNum) && isStlPassed;
+            delete pMesh;
+        }
+        isPassed = PrintCheck("STL weld result", isStlPassed) && isPassed;
+        remove(fileName.c_str());
+        return isPassed;
+    }
+}
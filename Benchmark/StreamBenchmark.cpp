@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+#include "../Src/DGP/PointStream.h"
+#include "../Src/DGP/StreamConsolidation.h"
+#include "../Src/DGP/Parser.h"
+#include "../Src/Common/ToolKit.h"
+#include <set>
+#include <stdio.h>
+#include <math.h>
+
+namespace MagicBenchmark
+{
+    static void PrintStreamResult(const char* name, long long pointNum, double time)
+    {
+        printf("%-28s %8.1fM points  time: %8.4fs  %8.2fM points/s\n", name, pointNum / 1.0e6, time, pointNum / 1.0e6 / time);
+    }
+
+    //Positions of the generated spiral as the float PLY stores them
+    static MagicMath::Vector3 GetStreamPosition(int pid)
+    {
+        double angle = pid * 0.001;
+        return MagicMath::Vector3(float(cos(angle) * (1.0 + pid * 1e-6)), float(sin(angle) * (1.0 + pid * 1e-6)), float(pid * 1e-5));
+    }
+
+    static bool PrintCheck(const char* name, bool isPassed)
+    {
+        printf("%-28s %s\n", name, isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+
+    bool RunStreamBenchmark(int elementNum)
+    {
+        printf("Stream benchmark\n");
+        std::string fileName = "MagicBenchmark_stream.ply";
+        {
+            MagicDGP::PointStreamWriter writer;
+            if (!writer.Open(fileName, true, false))
+            {
+                printf("can not write %s\n", fileName.c_str());
+                return false;
+            }
+            for (int pid = 0; pid < elementNum; pid++)
+            {
+                double angle = pid * 0.001;
+                MagicMath::Vector3 pos(cos(angle) * (1.0 + pid * 1e-6), sin(angle) * (1.0 + pid * 1e-6), pid * 1e-5);
+                writer.WritePoint(pos, MagicMath::Vector3(cos(angle), sin(angle), 0), MagicMath::Vector3(0, 0, 0));
+            }
+            if (!writer.Close())
+            {
+                printf("can not write %s\n", fileName.c_str());
+                remove(fileName.c_str());
+                return false;
+            }
+        }
+        bool isPassed = true;
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Point3DSet* pPointSet = MagicDGP::Parser::ParsePointSet(fileName);
+            long long pointNum = (pPointSet == NULL) ? 0 : pPointSet->GetPointNumber();
+            PrintStreamResult("PLY whole file", pointNum, MagicCore::ToolKit::GetTime() - timeStart);
+            bool isWholePassed = (pointNum == elementNum);
+            for (int pid = 0; isWholePassed && pid < elementNum; pid++)
+            {
+                isWholePassed = (pPointSet->GetPoint(pid)->GetPosition() == GetStreamPosition(pid));
+            }
+            delete pPointSet;
+            isPassed = PrintCheck("PLY whole file result", isWholePassed) && isPassed;
+        }
+        {
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::PointStreamReader reader;
+            MagicDGP::PointChunk chunk;
+            long long pointNum = 0;
+            bool isChunkPassed = reader.Open(fileName);
+            if (isChunkPassed)
+            {
+                while (reader.ReadChunk(chunk))
+                {
+                    //Chunks come in file order
+                    for (int cid = 0; isChunkPassed && cid < chunk.mPositionList.size(); cid++)
+                    {
+                        isChunkPassed = (pointNum + cid < elementNum && chunk.mPositionList[cid] == GetStreamPosition(int(pointNum + cid)));
+                    }
+                    pointNum += chunk.mPositionList.size();
+                }
+            }
+            PrintStreamResult("PLY chunks", pointNum, MagicCore::ToolKit::GetTime() - timeStart);
+            isChunkPassed = (isChunkPassed && !reader.IsFailed() && pointNum == elementNum);
+            isPassed = PrintCheck("PLY chunks result", isChunkPassed) && isPassed;
+        }
+        {
+            double voxelSize = 0.01;
+            double timeStart = MagicCore::ToolKit::GetTime();
+            MagicDGP::Point3DSet* pPointSet = MagicDGP::StreamConsolidation::VoxelDownsample(fileName, voxelSize);
+            double time = MagicCore::ToolKit::GetTime() - timeStart;
+            printf("voxel downsample to %d points\n", pPointSet == NULL ? 0 : pPointSet->GetPointNumber());
+            PrintStreamResult("PLY voxel downsample", elementNum, time);
+            //One point per occupied voxel
+            std::set<MagicMath::Vector3> voxelSet;
+            for (int pid = 0; pid < elementNum; pid++)
+            {
+                MagicMath::Vector3 pos = GetStreamPosition(pid);
+                voxelSet.insert(MagicMath::Vector3(floor(pos[0] / voxelSize), floor(pos[1] / voxelSize), floor(pos[2] / voxelSize)));
+            }
+            isPassed = PrintCheck("PLY voxel downsample result", pPointSet != NULL && pPointSet->GetPointNumber() == voxelSet.size()) && isPassed;
+            delete pPointSet;
+        }
+        remove(fileName.c_str());
+        return isPassed;
+    }
+}
@@ -0,0 +1,261 @@
+#include "SyntheticData.h"
+#include <math.h>
+#include <algorithm>
+
+namespace MagicBenchmark
+{
+    static const double SyntheticPi = 3.14159265358979323846;
+
+    SyntheticRandom::SyntheticRandom(unsigned int seed) :
+        mState(seed * 6364136223846793005ULL + 1442695040888963407ULL)
+    {
+    }
+
+    double SyntheticRandom::Uniform()
+    {
+        mState = mState * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (mState >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double SyntheticRandom::Gaussian()
+    {
+        double u0 = 1.0 - Uniform();
+        double u1 = Uniform();
+        return sqrt(-2.0 * log(u0)) * cos(2.0 * SyntheticPi * u1);
+    }
+
+    //Fibonacci lattice, the points are spread evenly without a seam
+    MagicDGP::Point3DSet* GenerateSpherePointSet(int pointNum, double noise, unsigned int seed)
+    {
+        SyntheticRandom random(seed);
+        MagicDGP::Point3DSet* pPointSet = new MagicDGP::Point3DSet;
+        double goldenAngle = SyntheticPi * (3.0 - sqrt(5.0));
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            double z = 1.0 - (2.0 * pid + 1.0) / pointNum;
+            double radius = sqrt(1.0 - z * z);
+            double angle = goldenAngle * pid;
+            MagicMath::Vector3 nor(radius * cos(angle), radius * sin(angle), z);
+            double offset = noise > 0 ? noise * random.Gaussian() : 0;
+            pPointSet->InsertPoint(nor * (1.0 + offset), nor);
+        }
+        pPointSet->SetHasNormal(true);
+        return pPointSet;
+    }
+
+    MagicDGP::Point3DSet* GeneratePlanePointSet(int pointNum, double noise, double outlierProportion, unsigned int seed)
+    {
+        SyntheticRandom random(seed);
+        MagicDGP::Point3DSet* pPointSet = new MagicDGP::Point3DSet;
+        MagicMath::Vector3 nor(0, 0, 1);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            double x = random.Uniform();
+            double y = random.Uniform();
+            double z = 0;
+            if (random.Uniform() < outlierProportion)
+            {
+                z = random.Uniform() - 0.5;
+            }
+            else if (noise > 0)
+            {
+                z = noise * random.Gaussian();
+            }
+            pPointSet->InsertPoint(MagicMath::Vector3(x, y, z), nor);
+        }
+        pPointSet->SetHasNormal(true);
+        return pPointSet;
+    }
+
+    MagicDGP::Mesh3D* GenerateWaveMesh(int resolution)
+    {
+        std::vector<MagicMath::Vector3> posList;
+        posList.reserve(resolution * resolution);
+        for (int y = 0; y < resolution; y++)
+        {
+            for (int x = 0; x < resolution; x++)
+            {
+                double z = 0.05 * sin(x * 0.1) * cos(y * 0.1);
+                posList.push_back(MagicMath::Vector3(double(x) / resolution, double(y) / resolution, z));
+            }
+        }
+        std::vector<int> indexList;
+        indexList.reserve((resolution - 1) * (resolution - 1) * 6);
+        for (int y = 0; y < resolution - 1; y++)
+        {
+            for (int x = 0; x < resolution - 1; x++)
+            {
+                int index = y * resolution + x;
+                indexList.push_back(index);
+                indexList.push_back(index + 1);
+                indexList.push_back(index + resolution + 1);
+                indexList.push_back(index);
+                indexList.push_back(index + resolution + 1);
+                indexList.push_back(index + resolution);
+            }
+        }
+        MagicDGP::Mesh3D* pMesh = new MagicDGP::Mesh3D;
+        pMesh->BuildFromIndexedTriangles(posList, indexList);
+        pMesh->UpdateBoundaryFlag();
+        pMesh->CalculateFaceArea();
+        return pMesh;
+    }
+
+    //Triangles between two rings of ringSize vertices
+    static void ConnectRings(int ringStart0, int ringStart1, int ringSize, bool isFlipped, std::vector<int>& indexList)
+    {
+        for (int rid = 0; rid < ringSize; rid++)
+        {
+            int index00 = ringStart0 + rid;
+            int index01 = ringStart0 + (rid + 1) % ringSize;
+            int index10 = ringStart1 + rid;
+            int index11 = ringStart1 + (rid + 1) % ringSize;
+            int triangle[6] = {index00, index01, index11, index00, index11, index10};
+            if (isFlipped)
+            {
+                std::swap(triangle[1], triangle[2]);
+                std::swap(triangle[4], triangle[5]);
+            }
+            indexList.insert(indexList.end(), triangle, triangle + 6);
+        }
+    }
+
+    //Triangles from a ring to its center vertex
+    static void CloseRing(int ringStart, int ringSize, int centerIndex, bool isFlipped, std::vector<int>& indexList)
+    {
+        for (int rid = 0; rid < ringSize; rid++)
+        {
+            int index0 = ringStart + rid;
+            int index1 = ringStart + (rid + 1) % ringSize;
+            indexList.push_back(index0);
+            indexList.push_back(isFlipped ? centerIndex : index1);
+            indexList.push_back(isFlipped ? index1 : centerIndex);
+        }
+    }
+
+    MagicDGP::Mesh3D* GeneratePrimitiveMesh(int resolution)
+    {
+        int ringSize = resolution > 8 ? resolution : 8;
+        int heightNum = ringSize * 2 / 3;
+        int capNum = heightNum / 2 > 2 ? heightNum / 2 : 2;
+        double height = 2.0;
+        std::vector<MagicMath::Vector3> posList;
+        std::vector<int> indexList;
+        //Cylinder
+        for (int hid = 0; hid <= heightNum; hid++)
+        {
+            for (int rid = 0; rid < ringSize; rid++)
+            {
+                double angle = 2.0 * SyntheticPi * rid / ringSize;
+                posList.push_back(MagicMath::Vector3(cos(angle), sin(angle), height * hid / heightNum));
+            }
+            if (hid > 0)
+            {
+                ConnectRings((hid - 1) * ringSize, hid * ringSize, ringSize, false, indexList);
+            }
+        }
+        //Plane cap
+        int lastRingStart = 0;
+        for (int cid = 1; cid < capNum; cid++)
+        {
+            int ringStart = int(posList.size());
+            double radius = 1.0 - double(cid) / capNum;
+            for (int rid = 0; rid < ringSize; rid++)
+            {
+                double angle = 2.0 * SyntheticPi * rid / ringSize;
+                posList.push_back(MagicMath::Vector3(radius * cos(angle), radius * sin(angle), 0));
+            }
+            ConnectRings(lastRingStart, ringStart, ringSize, true, indexList);
+            lastRingStart = ringStart;
+        }
+        posList.push_back(MagicMath::Vector3(0, 0, 0));
+        CloseRing(lastRingStart, ringSize, int(posList.size()) - 1, true, indexList);
+        //Sphere cap
+        lastRingStart = heightNum * ringSize;
+        for (int cid = 1; cid < capNum; cid++)
+        {
+            int ringStart = int(posList.size());
+            double latitude = SyntheticPi / 2 * cid / capNum;
+            for (int rid = 0; rid < ringSize; rid++)
+            {
+                double angle = 2.0 * SyntheticPi * rid / ringSize;
+                posList.push_back(MagicMath::Vector3(cos(latitude) * cos(angle), cos(latitude) * sin(angle), height + sin(latitude)));
+            }
+            ConnectRings(lastRingStart, ringStart, ringSize, false, indexList);
+            lastRingStart = ringStart;
+        }
+        posList.push_back(MagicMath::Vector3(0, 0, height + 1));
+        CloseRing(lastRingStart, ringSize, int(posList.size()) - 1, false, indexList);
+
+        MagicDGP::Mesh3D* pMesh = new MagicDGP::Mesh3D;
+        pMesh->BuildFromIndexedTriangles(posList, indexList);
+        pMesh->UpdateBoundaryFlag();
+        pMesh->CalculateFaceArea();
+        pMesh->UpdateNormal();
+        return pMesh;
+    }
+
+    void GenerateHeightField(int resX, int resY, std::vector<double>& heightField)
+    {
+        heightField.resize(resX * resY);
+        for (int y = 0; y < resY; y++)
+        {
+            for (int x = 0; x < resX; x++)
+            {
+                double u = double(x) / resX;
+                double v = double(y) / resY;
+                double bump = exp(-((u - 0.3) * (u - 0.3) + (v - 0.6) * (v - 0.6)) * 40.0) * 20.0 +
+                    exp(-((u - 0.7) * (u - 0.7) + (v - 0.3) * (v - 0.3)) * 80.0) * 10.0;
+                heightField.at(y * resX + x) = 50.0 * u + bump + sin(u * 40.0) * cos(v * 40.0);
+            }
+        }
+    }
+
+    GeneratedDepthSource::GeneratedDepthSource(int frameNum) :
+        mFrameNumber(frameNum),
+        mFrameCurrent(0)
+    {
+    }
+
+    bool GeneratedDepthSource::ReadFrame(MagicDGP::DepthFrame& frame)
+    {
+        if (mFrameCurrent >= mFrameNumber)
+        {
+            return false;
+        }
+        const int resolutionX = 640;
+        const int resolutionY = 480;
+        frame.mFrameId = mFrameCurrent;
+        frame.mResolutionX = resolutionX;
+        frame.mResolutionY = resolutionY;
+        frame.mDepthList.resize(resolutionX * resolutionY);
+        double centerX = 320 + 100 * sin(mFrameCurrent * 0.1);
+        for (int y = 0; y < resolutionY; y++)
+        {
+            for (int x = 0; x < resolutionX; x++)
+            {
+                double depth = 1800 + 40 * sin(x * 0.05) * cos(y * 0.05);
+                double dx = x - centerX;
+                double dy = y - 240.0;
+                double dist2 = dx * dx + dy * dy;
+                if (dist2 < 120.0 * 120.0)
+                {
+                    depth = 900 - sqrt(120.0 * 120.0 - dist2) * 2;
+                }
+                frame.mDepthList[y * resolutionX + x] = (x % 97 == 0) ? 0 : (unsigned short)depth;
+            }
+        }
+        mFrameCurrent++;
+        return true;
+    }
+
+    double GeneratedDepthSource::GetXZFactor() const
+    {
+        return 1.1147; //58 degree
+    }
+
+    double GeneratedDepthSource::GetYZFactor() const
+    {
+        return 0.8336; //45 degree
+    }
+}
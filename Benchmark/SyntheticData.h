@@ -0,0 +1,49 @@
+#pragma once
+#include "../Src/DGP/PointCloud3D.h"
+#include "../Src/DGP/Mesh3D.h"
+#include "../Src/DGP/DepthFramePipeline.h"
+#include <vector>
+
+//Deterministic inputs of the benchmarks, the same arguments give the same data on every platform
+namespace MagicBenchmark
+{
+    //Linear congruential generator, rand() differs between C runtimes
+    class SyntheticRandom
+    {
+    public:
+        SyntheticRandom(unsigned int seed);
+        //[0, 1)
+        double Uniform();
+        //Mean 0, deviation 1
+        double Gaussian();
+
+    private:
+        unsigned long long mState;
+    };
+
+    //Unit sphere with outward normals, positions are moved along the normal by noise * Gaussian
+    MagicDGP::Point3DSet* GenerateSpherePointSet(int pointNum, double noise, unsigned int seed);
+    //Unit square in the xy plane, outlierProportion of the points are spread in the unit cube
+    MagicDGP::Point3DSet* GeneratePlanePointSet(int pointNum, double noise, double outlierProportion, unsigned int seed);
+    //Wavy height field of resolution x resolution vertices
+    MagicDGP::Mesh3D* GenerateWaveMesh(int resolution);
+    //CAD like part: a cylinder with a plane cap at the bottom and a sphere cap at the top,
+    //about resolution * resolution vertices
+    MagicDGP::Mesh3D* GeneratePrimitiveMesh(int resolution);
+    //Bumps on a slope, resX * resY heights
+    void GenerateHeightField(int resX, int resY, std::vector<double>& heightField);
+
+    //A wavy wall with a sphere in front of it, the sphere moves with the frame
+    class GeneratedDepthSource : public MagicDGP::DepthFrameSource
+    {
+    public:
+        GeneratedDepthSource(int frameNum);
+        virtual bool ReadFrame(MagicDGP::DepthFrame& frame);
+        virtual double GetXZFactor() const;
+        virtual double GetYZFactor() const;
+
+    private:
+        int mFrameNumber;
+        int mFrameCurrent;
+    };
+}
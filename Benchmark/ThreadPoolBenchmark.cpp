@@ -0,0 +1,205 @@
+#include "Benchmark.h"
+#include "../Src/Common/ThreadPool.h"
+#include "../Src/Common/ToolKit.h"
+#include <stdio.h>
+#include <list>
+#include <atomic>
+
+namespace MagicBenchmark
+{
+    //The design of MagicCore::ThreadPool before work stealing: one task list under one mutex.
+    //The old pool also wrote a DebugLog line for every task, that is left out here.
+    class SingleQueuePool
+    {
+    public:
+        SingleQueuePool(int threadCount) :
+            mTaskList(),
+            mMutex(),
+            mGetTaskCV(),
+            mFinishTaskCV(),
+            mTaskLeftCount(0),
+            mThreadList()
+        {
+            for (int tid = 0; tid < threadCount; tid++)
+            {
+                mThreadList.push_back(std::thread(&SingleQueuePool::Run, this));
+            }
+        }
+
+        ~SingleQueuePool()
+        {
+            for (int tid = 0; tid < int(mThreadList.size()); tid++)
+            {
+                InsertTask(new MagicCore::ITask(MagicCore::TP_Exit));
+            }
+            for (int tid = 0; tid < int(mThreadList.size()); tid++)
+            {
+                mThreadList.at(tid).join();
+            }
+        }
+
+        void InsertTask(MagicCore::ITask* pTask)
+        {
+            MagicCore::ScopedLock scopedLock(mMutex);
+            mTaskList.push_back(pTask);
+            mTaskLeftCount++;
+            mGetTaskCV.WakeSingle();
+        }
+
+        void WaitUntilAllDone()
+        {
+            MagicCore::ScopedLock scopedLock(mMutex);
+            while (mTaskLeftCount > 0)
+            {
+                mFinishTaskCV.Sleep(mMutex);
+            }
+        }
+
+    private:
+        void Run()
+        {
+            while (true)
+            {
+                MagicCore::ITask* pTask = NULL;
+                {
+                    MagicCore::ScopedLock scopedLock(mMutex);
+                    while (mTaskList.empty())
+                    {
+                        mGetTaskCV.Sleep(mMutex);
+                    }
+                    pTask = mTaskList.front();
+                    mTaskList.pop_front();
+                }
+                bool isExit = (pTask->GetType() == MagicCore::TP_Exit);
+                pTask->Run();
+                pTask->OnComplete();
+                {
+                    MagicCore::ScopedLock scopedLock(mMutex);
+                    mTaskLeftCount--;
+                    mFinishTaskCV.WakeSingle();
+                }
+                if (isExit)
+                {
+                    break;
+                }
+            }
+        }
+
+    private:
+        std::list<MagicCore::ITask*> mTaskList;
+        MagicCore::Mutex mMutex;
+        MagicCore::ConditionVariable mGetTaskCV;
+        MagicCore::ConditionVariable mFinishTaskCV;
+        int mTaskLeftCount;
+        std::vector<std::thread> mThreadList;
+    };
+
+    //Only counts that it ran
+    class EmptyTask : public MagicCore::ITask
+    {
+    public:
+        EmptyTask(std::atomic<int>* pRunCount) :
+            mpRunCount(pRunCount)
+        {
+        }
+
+        virtual void Run()
+        {
+            (*mpRunCount)++;
+        }
+
+    private:
+        std::atomic<int>* mpRunCount;
+    };
+
+    //Inserts its children from a worker, they go to the deque of that worker
+    class ForkTask : public MagicCore::ITask
+    {
+    public:
+        ForkTask(MagicCore::ThreadPool* pThreadPool, int childNum, std::atomic<int>* pRunCount) :
+            mpThreadPool(pThreadPool),
+            mChildNum(childNum),
+            mpRunCount(pRunCount)
+        {
+        }
+
+        virtual void Run()
+        {
+            MagicCore::WaitGroup group;
+            for (int cid = 0; cid < mChildNum; cid++)
+            {
+                mpThreadPool->InsertTask(new EmptyTask(mpRunCount), &group);
+            }
+            mpThreadPool->Wait(group);
+        }
+
+    private:
+        MagicCore::ThreadPool* mpThreadPool;
+        int mChildNum;
+        std::atomic<int>* mpRunCount;
+    };
+
+    static void PrintDispatchResult(const char* name, int taskNum, double time)
+    {
+        printf("%-28s %8d tasks  time: %8.4fs  %8.1f ns/task\n", name, taskNum, time, time * 1.0e9 / taskNum);
+    }
+
+    //Every task ran exactly once when the wait returned
+    static bool CheckDispatchResult(const char* name, int taskNum, int runCount)
+    {
+        if (runCount != taskNum)
+        {
+            printf("check failed: %s ran %d of %d tasks\n", name, runCount, taskNum);
+            return false;
+        }
+        return true;
+    }
+
+    bool RunThreadPoolBenchmark(int elementNum)
+    {
+        printf("ThreadPool benchmark\n");
+        int threadCount = MagicCore::GetNumberOfProcessors();
+        int taskNum = elementNum / 4 > 1000 ? elementNum / 4 : 1000;
+        bool isPassed = true;
+        {
+            SingleQueuePool threadPool(threadCount);
+            std::atomic<int> runCount(0);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            for (int tid = 0; tid < taskNum; tid++)
+            {
+                threadPool.InsertTask(new EmptyTask(&runCount));
+            }
+            threadPool.WaitUntilAllDone();
+            PrintDispatchResult("single queue", taskNum, MagicCore::ToolKit::GetTime() - timeStart);
+            isPassed = CheckDispatchResult("single queue", taskNum, runCount) && isPassed;
+        }
+        {
+            MagicCore::ThreadPool threadPool(threadCount);
+            std::atomic<int> runCount(0);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            for (int tid = 0; tid < taskNum; tid++)
+            {
+                threadPool.InsertTask(new EmptyTask(&runCount));
+            }
+            threadPool.WaitUntilAllDone();
+            PrintDispatchResult("work stealing", taskNum, MagicCore::ToolKit::GetTime() - timeStart);
+            isPassed = CheckDispatchResult("work stealing", taskNum, runCount) && isPassed;
+        }
+        {
+            MagicCore::ThreadPool threadPool(threadCount);
+            int forkNum = threadCount * 4;
+            int childNum = taskNum / forkNum;
+            std::atomic<int> runCount(0);
+            double timeStart = MagicCore::ToolKit::GetTime();
+            for (int fid = 0; fid < forkNum; fid++)
+            {
+                threadPool.InsertTask(new ForkTask(&threadPool, childNum, &runCount));
+            }
+            threadPool.WaitUntilAllDone();
+            PrintDispatchResult("work stealing nested", forkNum * childNum, MagicCore::ToolKit::GetTime() - timeStart);
+            isPassed = CheckDispatchResult("work stealing nested", forkNum * childNum, runCount) && isPassed;
+        }
+        printf("%-28s %s\n", "dispatch result", isPassed ? "passed" : "FAILED");
+        return isPassed;
+    }
+}
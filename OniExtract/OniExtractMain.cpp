@@ -0,0 +1,35 @@
+#include "../Src/DGP/OniFrameSource.h"
+#include "../Src/DGP/DepthFramePipeline.h"
+#include "../Src/Common/AsyncLog.h"
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+//Converts the depth frames of an ONI recording to point set files without the GUI.
+//Usage: OniExtract record.oni outputPrefix [extension] [frame start] [frame end] [worker number]
+//Frame i is written to outputPrefix + i + "." + extension, the extension is m3c by default.
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: OniExtract record.oni outputPrefix [extension] [frame start] [frame end] [worker number]\n");
+        return 1;
+    }
+    std::string extension = argc > 3 ? argv[3] : "m3c";
+    MagicDGP::OniFrameSource frameSource;
+    if (!frameSource.Open(argv[1]))
+    {
+        printf("can not open %s\n", argv[1]);
+        return 1;
+    }
+    int frameStart = argc > 4 ? atoi(argv[4]) : 0;
+    int frameEnd = argc > 5 ? atoi(argv[5]) : frameSource.GetFrameNumber();
+    int workerNum = argc > 6 ? atoi(argv[6]) : 0;
+    frameSource.SetFrameRange(frameStart, frameEnd);
+    MagicDGP::DepthFramePipeline pipeline(workerNum);
+    int exportNum = pipeline.Run(&frameSource, MagicDGP::DepthRangeLimit(), argv[2], extension);
+    printf("%d frames exported\n", exportNum);
+    MagicCore::StopAsyncLog();
+
+    return 0;
+}
@@ -178,17 +178,17 @@ namespace MagicApp
             fi.mIndex[2] = 3;
             mpBackboardMesh->InsertFace(fi);
             mpBackboardMesh->UpdateNormal();
-            mpBackboardMesh->GetVertex(0)->SetTexCord(MagicMath::Vector3(0, 1, 0));
-            mpBackboardMesh->GetVertex(1)->SetTexCord(MagicMath::Vector3(1, 1, 0));
-            mpBackboardMesh->GetVertex(2)->SetTexCord(MagicMath::Vector3(1, 0, 0));
-            mpBackboardMesh->GetVertex(3)->SetTexCord(MagicMath::Vector3(0, 0, 0));
+            mpBackboardMesh->SetTexCord(0, MagicMath::Vector3(0, 1, 0));
+            mpBackboardMesh->SetTexCord(1, MagicMath::Vector3(1, 1, 0));
+            mpBackboardMesh->SetTexCord(2, MagicMath::Vector3(1, 0, 0));
+            mpBackboardMesh->SetTexCord(3, MagicMath::Vector3(0, 0, 0));
         }
         else
         {
-            mpBackboardMesh->GetVertex(0)->SetPosition(MagicMath::Vector3(-boardHalfWidth, -boardHalfHeight, -mBackboardDepth));
-            mpBackboardMesh->GetVertex(1)->SetPosition(MagicMath::Vector3(boardHalfWidth, -boardHalfHeight, -mBackboardDepth));
-            mpBackboardMesh->GetVertex(2)->SetPosition(MagicMath::Vector3(boardHalfWidth, boardHalfHeight, -mBackboardDepth));
-            mpBackboardMesh->GetVertex(3)->SetPosition(MagicMath::Vector3(-boardHalfWidth, boardHalfHeight, -mBackboardDepth));
+            mpBackboardMesh->SetPosition(0, MagicMath::Vector3(-boardHalfWidth, -boardHalfHeight, -mBackboardDepth));
+            mpBackboardMesh->SetPosition(1, MagicMath::Vector3(boardHalfWidth, -boardHalfHeight, -mBackboardDepth));
+            mpBackboardMesh->SetPosition(2, MagicMath::Vector3(boardHalfWidth, boardHalfHeight, -mBackboardDepth));
+            mpBackboardMesh->SetPosition(3, MagicMath::Vector3(-boardHalfWidth, boardHalfHeight, -mBackboardDepth));
         }
         MagicCore::RenderSystem::GetSingleton()->RenderLightMesh3DWithTexture("BackBoard", "VCMat", mpBackboardMesh);
     }
@@ -107,7 +107,7 @@ namespace MagicApp
             for (std::vector<int>::iterator piIter = pickIndex.begin(); piIter != pickIndex.end(); ++piIter)
             {
                 mPickIndexSet.insert(*piIter);
-                mpLightMesh->GetVertex(*piIter)->SetColor(pickColor);
+                mpLightMesh->SetColor(*piIter, pickColor);
             }
             UpdateMeshRendering();
         }
@@ -189,7 +189,7 @@ namespace MagicApp
     bool MeshShopApp::OpenMesh(int& vertNum)
     {
         std::string fileName;
-        char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0OFF Files(*.off)\0*.off\0";
+        char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0OFF Files(*.off)\0*.off\0PLY Files(*.ply)\0*.ply\0M3D Files(*.m3d)\0*.m3d\0";
         if (MagicCore::ToolKit::FileOpenDlg(fileName, filterName))
         {
             MagicDGP::LightMesh3D* pLightMesh = MagicDGP::Parser::ParseLightMesh3D(fileName);
@@ -197,7 +197,7 @@ namespace MagicApp
             {
                 if (pLightMesh->GetVertexNumber() > 0)
                 {
-                    mDefaultColor = pLightMesh->GetVertex(0)->GetColor();
+                    mDefaultColor = pLightMesh->GetColor(0);
                 }
                 vertNum = pLightMesh->GetVertexNumber();
                 pLightMesh->UnifyPosition(2.0);
@@ -229,7 +229,7 @@ namespace MagicApp
         if (mpLightMesh != NULL)
         {
             std::string fileName;
-            char filterName[] = "Support format(*.obj, *.stl, *.off)\0*.*\0";
+            char filterName[] = "Support format(*.obj, *.stl, *.off, *.ply, *.m3d)\0*.*\0";
             if (MagicCore::ToolKit::FileSaveDlg(fileName, filterName))
             {
                 MagicDGP::Parser::ExportLightMesh3D(fileName, mpLightMesh);
@@ -270,8 +270,8 @@ namespace MagicApp
             int randNum = rand();
             randNum = randNum % (2 * maxNum) - maxNum;
             double scale = double(randNum) / maxNum * epsilon;
-            MagicMath::Vector3 newPos = mpLightMesh->GetVertex(vid)->GetPosition() + mpLightMesh->GetVertex(vid)->GetNormal() * scale;
-            mpLightMesh->GetVertex(vid)->SetPosition(newPos);
+            MagicMath::Vector3 newPos = mpLightMesh->GetPosition(vid) + mpLightMesh->GetNormal(vid) * scale;
+            mpLightMesh->SetPosition(vid, newPos);
         }
         mpLightMesh->UpdateNormal();
         UpdateMeshRendering();
@@ -291,7 +291,7 @@ namespace MagicApp
     {
         for (std::set<int>::iterator pickItr = mPickIndexSet.begin(); pickItr != mPickIndexSet.end(); pickItr++)
         {
-            mpLightMesh->GetVertex(*pickItr)->SetColor(mDefaultColor);
+            mpLightMesh->SetColor(*pickItr, mDefaultColor);
         }
         mPickIndexSet.clear();
         UpdateMeshRendering();
@@ -301,28 +301,29 @@ namespace MagicApp
     {
         if (mpLightMesh != NULL && mPickIndexSet.size() > 0)
         {
+            int vertNum = mpLightMesh->GetVertexNumber();
+            std::vector<bool> validFlag(vertNum, true);
             for (std::set<int>::iterator pickItr = mPickIndexSet.begin(); pickItr != mPickIndexSet.end(); ++pickItr)
             {
-                mpLightMesh->GetVertex(*pickItr)->SetValid(false);
+                validFlag.at(*pickItr) = false;
             }
             //Update to new mesh
             MagicDGP::LightMesh3D* pNewMesh = new MagicDGP::LightMesh3D;
-            int vertNum = mpLightMesh->GetVertexNumber();
             std::vector<bool> visitFlag(vertNum, 0);
             std::map<int, int> vertIndexMap;
             int faceNum = mpLightMesh->GetFaceNumber();
             for (int fid = 0; fid < faceNum; fid++)
             {
                 MagicDGP::FaceIndex faceIdx = mpLightMesh->GetFace(fid);
-                if (mpLightMesh->GetVertex(faceIdx.mIndex[0])->IsValid() == false)
+                if (validFlag.at(faceIdx.mIndex[0]) == false)
                 {
                     continue;
                 }
-                if (mpLightMesh->GetVertex(faceIdx.mIndex[1])->IsValid() == false)
+                if (validFlag.at(faceIdx.mIndex[1]) == false)
                 {
                     continue;
                 }
-                if (mpLightMesh->GetVertex(faceIdx.mIndex[2])->IsValid() == false)
+                if (validFlag.at(faceIdx.mIndex[2]) == false)
                 {
                     continue;
                 }
@@ -336,7 +337,7 @@ namespace MagicApp
                     else
                     {
                         visitFlag.at(faceIdx.mIndex[k]) = true;
-                        newFaceIdx.mIndex[k] = pNewMesh->InsertVertex(mpLightMesh->GetVertex(faceIdx.mIndex[k])->GetPosition())->GetId();
+                        newFaceIdx.mIndex[k] = pNewMesh->InsertVertex(mpLightMesh->GetPosition(faceIdx.mIndex[k]));
                         vertIndexMap[faceIdx.mIndex[k]] = newFaceIdx.mIndex[k];
                     }
                 }
@@ -414,8 +415,7 @@ namespace MagicApp
             {
                 MagicMath::Vector3 pos(x / 512.0, y / 512.0, 0);
                 pos[2] = (img.getColourAt(x, y, 0))[1];
-                MagicDGP::Point3D* pPoint = new MagicDGP::Point3D(pos);
-                pPS->InsertPoint(pPoint);
+                pPS->InsertPoint(pos);
             }
         }
         MagicDGP::Parser::ExportPointSet("depth.obj", pPS);
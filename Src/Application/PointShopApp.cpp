@@ -16,12 +16,17 @@ namespace MagicApp
     PointShopApp::PointShopApp() :
         mpPointSet(NULL),
         mMouseMode(MM_View),
-        mPickIgnoreBack(true)
+        mPickIgnoreBack(true),
+        mpReconstructionGraph(NULL),
+        mpReconstructionPointSet(NULL),
+        mpPoissonTask(NULL),
+        mReconstructionProgress(0)
     {
     }
 
     PointShopApp::~PointShopApp()
     {
+        ClearReconstruction();
         if (mpPointSet != NULL)
         {
             delete mpPointSet;
@@ -41,11 +46,13 @@ namespace MagicApp
 
     bool PointShopApp::Update(float timeElapsed)
     {
+        UpdateReconstruction();
         return true;
     }
 
     bool PointShopApp::Exit(void)
     {
+        ClearReconstruction();
         ShutdownScene();
         mUI.Shutdown();
         return true;
@@ -127,13 +134,18 @@ namespace MagicApp
         {
             DeleteSelcetPoints();
         }
+        else if (arg.key == OIS::KC_ESCAPE && mpReconstructionGraph != NULL)
+        {
+            InfoLog << "Cancel reconstruction" << std::endl;
+            mpReconstructionGraph->Cancel();
+        }
         return true;
     }
 
     bool PointShopApp::OpenPointSet(bool& hasNormal, int& pointNum)
     {
         std::string fileName;
-        char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0OFF Files(*.off)\0*.off\0";
+        char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0OFF Files(*.off)\0*.off\0PLY Files(*.ply)\0*.ply\0M3D Files(*.m3d)\0*.m3d\0M3C Files(*.m3c)\0*.m3c\0";
         if (MagicCore::ToolKit::FileOpenDlg(fileName, filterName))
         {
             MagicDGP::Point3DSet* pPointSet = MagicDGP::Parser::ParsePointSet(fileName);
@@ -173,7 +185,7 @@ namespace MagicApp
         if (mpPointSet != NULL)
         {
             std::string fileName;
-            char filterName[] = "Support format(*.obj, *.off, *.ply)\0*.*\0";
+            char filterName[] = "Support format(*.obj, *.off, *.ply, *.m3d, *.m3c)\0*.*\0";
             if (MagicCore::ToolKit::FileSaveDlg(fileName, filterName))
             {
                 MagicDGP::Parser::ExportPointSet(fileName, mpPointSet);
@@ -259,11 +271,89 @@ namespace MagicApp
 
     void PointShopApp::Reconstruction()
     {
-        mpPointSet->CalculateBBox();
-        mpPointSet->CalculateDensity();
-        MagicDGP::LightMesh3D* pNewMesh = MagicDGP::MeshReconstruction::ScreenPoissonReconstruction(mpPointSet);
-        if (pNewMesh != NULL)
+        if (mpPointSet == NULL)
+        {
+            return;
+        }
+        if (mpReconstructionGraph != NULL)
+        {
+            InfoLog << "Reconstruction is running, Esc cancels it" << std::endl;
+            return;
+        }
+        //The point set can be edited meanwhile, the tasks work on a copy
+        mpReconstructionPointSet = new MagicDGP::Point3DSet;
+        int pointNum = mpPointSet->GetPointNumber();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            const MagicDGP::Point3D* pPoint = mpPointSet->GetPoint(pid);
+            mpReconstructionPointSet->InsertPoint(pPoint->GetPosition(), pPoint->GetNormal());
+        }
+        mpReconstructionPointSet->SetHasNormal(mpPointSet->HasNormal());
+        MagicDGP::Point3DSet* pPointSet = mpReconstructionPointSet;
+
+        //normal -> Poisson, normals are only estimated if the point set has none
+        mpReconstructionGraph = new MagicCore::TaskGraph;
+        MagicCore::GraphTask* pNormalTask = mpReconstructionGraph->AddTask<bool>("CalPointSetNormal",
+            [pPointSet](MagicCore::GraphTask& task, bool& result) -> bool
         {
+            if (!pPointSet->HasNormal())
+            {
+                MagicDGP::Consolidation::CalPointSetNormal(pPointSet);
+                pPointSet->SetHasNormal(true);
+            }
+            result = true;
+            return true;
+        });
+        mpPoissonTask = mpReconstructionGraph->AddTask<MagicDGP::LightMesh3D*>("ScreenPoisson",
+            [pPointSet](MagicCore::GraphTask& task, MagicDGP::LightMesh3D*& pMesh) -> bool
+        {
+            pPointSet->CalculateBBox();
+            pPointSet->CalculateDensity();
+            if (task.IsCancelled())
+            {
+                return false;
+            }
+            pMesh = MagicDGP::MeshReconstruction::ScreenPoissonReconstruction(pPointSet);
+            return pMesh != NULL;
+        });
+        mpPoissonTask->DependOn(pNormalTask);
+        mReconstructionProgress = 0;
+        mpReconstructionGraph->Submit();
+    }
+
+    void PointShopApp::UpdateReconstruction()
+    {
+        if (mpReconstructionGraph == NULL)
+        {
+            return;
+        }
+        if (!mpReconstructionGraph->IsFinished())
+        {
+            int progress = int(mpReconstructionGraph->GetProgress() * 10) * 10;
+            if (progress != mReconstructionProgress)
+            {
+                mReconstructionProgress = progress;
+                InfoLog << "Reconstruction: " << progress << "%" << std::endl;
+            }
+            return;
+        }
+        MagicDGP::LightMesh3D* pNewMesh = NULL;
+        if (mpReconstructionGraph->IsSucceeded() && !mpReconstructionGraph->IsCancelled())
+        {
+            pNewMesh = mpPoissonTask->GetResult();
+        }
+        else
+        {
+            InfoLog << "Reconstruction stopped" << std::endl;
+        }
+        if (pNewMesh == NULL)
+        {
+            ClearReconstruction();
+        }
+        else
+        {
+            mpPoissonTask = NULL;
+            ClearReconstruction();
             MagicCore::AppManager::GetSingleton()->EnterApp(new MeshShopApp, "MeshShopApp");
             MeshShopApp* pMSApp = dynamic_cast<MeshShopApp* >(MagicCore::AppManager::GetSingleton()->GetApp("MeshShopApp"));
             if (pMSApp != NULL)
@@ -277,6 +367,28 @@ namespace MagicApp
         }
     }
 
+    void PointShopApp::ClearReconstruction()
+    {
+        if (mpReconstructionGraph != NULL)
+        {
+            mpReconstructionGraph->Cancel();
+            mpReconstructionGraph->Wait();
+            //A mesh which is not handed to MeshShopApp
+            if (mpPoissonTask != NULL && mpPoissonTask->GetResult() != NULL)
+            {
+                delete mpPoissonTask->GetResult();
+            }
+            delete mpReconstructionGraph;
+            mpReconstructionGraph = NULL;
+        }
+        mpPoissonTask = NULL;
+        if (mpReconstructionPointSet != NULL)
+        {
+            delete mpReconstructionPointSet;
+            mpReconstructionPointSet = NULL;
+        }
+    }
+
     void PointShopApp::AddNoise()
     {
         int pointNum = mpPointSet->GetPointNumber();
@@ -372,8 +484,7 @@ namespace MagicApp
                 MagicDGP::Point3D* pPoint = mpPointSet->GetPoint(pid);
                 if (pPoint->IsValid() == true)
                 {
-                    MagicDGP::Point3D* pNewPoint = new MagicDGP::Point3D(pPoint->GetPosition(), pPoint->GetNormal());
-                    pNewPointSet->InsertPoint(pNewPoint);
+                    pNewPointSet->InsertPoint(pPoint->GetPosition(), pPoint->GetNormal());
                 }
             }
             pNewPointSet->UnifyPosition(2);
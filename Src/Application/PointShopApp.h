@@ -4,6 +4,8 @@
 #include "../DGP/ViewTool.h"
 #include "../DGP/PickPointTool.h"
 #include "../DGP/PointCloud3D.h"
+#include "../DGP/Mesh3D.h"
+#include "../Common/TaskGraph.h"
 
 namespace MagicApp
 {
@@ -52,6 +54,8 @@ namespace MagicApp
         void ShutdownScene(void);
         void UpdatePointSetRendering();
         void ClearSceneData();
+        void UpdateReconstruction();
+        void ClearReconstruction();
 
     private:
         PointShopAppUI mUI;
@@ -63,5 +67,10 @@ namespace MagicApp
         MagicMath::Vector3 mDefaultColor;
         std::set<int> mPickIndexSet;
         std::vector<std::vector<int> > mRiemannianGraph;
+        //Reconstruction runs on a copy of the point set in the background, Update polls it
+        MagicCore::TaskGraph* mpReconstructionGraph;
+        MagicDGP::Point3DSet* mpReconstructionPointSet;
+        MagicCore::ResultGraphTask<MagicDGP::LightMesh3D*>* mpPoissonTask;
+        int mReconstructionProgress;
     };
 }
\ No newline at end of file
@@ -10,85 +10,71 @@
 #include "../DGP/Sampling.h"
 #include "../DGP/PickPointTool.h"
 #include "Math/HomoMatrix4.h"
-#include "../Common/ThreadPool.h"
+#include "../Common/Parallel.h"
 
 namespace
 {
-    class NormalDeviationTask : public MagicCore::ITask
+    //Average angle between the normal of a vertex and the normals of its neighbors, for vertices [startIndex, endIndex)
+    void CalVertexNormalDeviation(MagicDGP::Mesh3D* pMesh, int startIndex, int endIndex, std::vector<double>& normDeviation)
     {
-    public:
-        NormalDeviationTask(int taskId, int taskCount, MagicDGP::Mesh3D* pMesh, std::vector<double>& normDeviation) : 
-            mTaskId(taskId),
-            mTaskCount(taskCount),
-            mpMesh(pMesh),
-            mNormDeviation(normDeviation)
+        for (int vid = startIndex; vid < endIndex; vid++)
         {
-        }
-
-        virtual void Run()
-        {
-            DebugLog << "NormalDeviationTask::Run" << std::endl;
-            int vertNum = mpMesh->GetVertexNumber();
-            for (int vid = mTaskId; vid < vertNum; vid += mTaskCount)
+            std::vector<int> neighborList;
+            neighborList.reserve(10);
+            MagicDGP::Vertex3D* pVert = pMesh->GetVertex(vid);
+            MagicDGP::Edge3D* pEdge = pVert->GetEdge();
+            do
             {
-                std::vector<int> neighborList;
-                neighborList.reserve(10);
-                MagicDGP::Vertex3D* pVert = mpMesh->GetVertex(vid);
-                MagicDGP::Edge3D* pEdge = pVert->GetEdge();
-                do
-                {
-                    if (pEdge == NULL)
-                    {
-                        break;
-                    }
-                    neighborList.push_back(pEdge->GetVertex()->GetId());
-                    pEdge = pEdge->GetPair()->GetNext();
-                } while (pEdge != pVert->GetEdge());
-
-                MagicMath::Vector3 normal = mpMesh->GetVertex(vid)->GetNormal();
-                double nDev = 0;
-                for (std::vector<int>::iterator neigItr = neighborList.begin(); neigItr != neighborList.end(); ++neigItr)
-                {
-                    double cosA = normal * (mpMesh->GetVertex(*neigItr)->GetNormal());
-                    cosA = cosA > 1 ? 1 : (cosA < -1 ? -1 : cosA);
-                    nDev += acos(cosA);
-                }
-                if (neighborList.size() > 0)
+                if (pEdge == NULL)
                 {
-                    nDev /= neighborList.size();
+                    break;
                 }
-                mNormDeviation.at(vid) = nDev;
-            }
-        }
+                neighborList.push_back(pEdge->GetVertex()->GetId());
+                pEdge = pEdge->GetPair()->GetNext();
+            } while (pEdge != pVert->GetEdge());
 
-        ~NormalDeviationTask()
-        {
+            MagicMath::Vector3 normal = pMesh->GetVertex(vid)->GetNormal();
+            double nDev = 0;
+            for (std::vector<int>::iterator neigItr = neighborList.begin(); neigItr != neighborList.end(); ++neigItr)
+            {
+                //nDev += (normal - (pMesh->GetVertex(*neigItr)->GetNormal())).Length();
+                double cosA = normal * (pMesh->GetVertex(*neigItr)->GetNormal());
+                cosA = cosA > 1 ? 1 : (cosA < -1 ? -1 : cosA);
+                nDev += acos(cosA);
+            }
+            if (neighborList.size() > 0)
+            {
+                nDev /= neighborList.size();
+            }
+            normDeviation.at(vid) = nDev;
         }
-
-    private:
-        int mTaskId;
-        int mTaskCount;
-        MagicDGP::Mesh3D* mpMesh;
-        std::vector<double>& mNormDeviation;
-    };
-
+    }
 }
 
 namespace MagicApp
 {
     PrimitiveDetectionApp::PrimitiveDetectionApp() : 
         mpMesh(NULL),
-        mIsPickingMode(false)
+        mpDetectionContext(NULL),
+        mIsPickingMode(false),
+        mpDetectionGraph(NULL),
+        mpDetectionTask(NULL)
     {
     }
 
     PrimitiveDetectionApp::~PrimitiveDetectionApp()
     {
+        ClearDetection();
         if (mpMesh != NULL)
         {
             delete mpMesh;
             mpMesh = NULL;
         }
+        if (mpDetectionContext != NULL)
+        {
+            delete mpDetectionContext;
+            mpDetectionContext = NULL;
+        }
     }
 
     bool PrimitiveDetectionApp::Enter(void)
@@ -101,6 +87,7 @@ namespace MagicApp
 
     bool PrimitiveDetectionApp::Update(float timeElapsed)
     {
+        UpdateDetection();
         return true;
     }
 
@@ -152,7 +139,7 @@ namespace MagicApp
     {
         if (mIsPickingMode)
         {
-            if (mpMesh != NULL)
+            if (IsMeshEditable())
             {
                 MagicMath::Vector2 mousePos(arg.state.X.abs * 2.0 / MagicCore::RenderSystem::GetSingleton()->GetRenderWindow()->getWidth() - 1.0, 
                     1.0 - arg.state.Y.abs * 2.0 / MagicCore::RenderSystem::GetSingleton()->GetRenderWindow()->getHeight());
@@ -183,27 +170,32 @@ namespace MagicApp
         {
             MagicCore::RenderSystem::GetSingleton()->GetMainCamera()->setPolygonMode(Ogre::PolygonMode::PM_SOLID);
         }
-        else if (arg.key == OIS::KC_G && mpMesh != NULL)
+        else if (arg.key == OIS::KC_G && IsMeshEditable())
         {
             CalMeshCurvature();
         }
-        else if (arg.key == OIS::KC_S && mpMesh != NULL)
+        else if (arg.key == OIS::KC_S && IsMeshEditable())
         {
             FilterMesh3D();
         }
-        else if (arg.key == OIS::KC_N && mpMesh != NULL)
+        else if (arg.key == OIS::KC_N && IsMeshEditable())
         {
             CalNormalDeviation();
             //CalNormalDeviationByMT();
         }
-        else if (arg.key == OIS::KC_A && mpMesh != NULL)
+        else if (arg.key == OIS::KC_A && IsMeshEditable())
         {
             SampleVertex();
         }
-        else if (arg.key == OIS::KC_P && mpMesh != NULL)
+        else if (arg.key == OIS::KC_P && IsMeshEditable())
         {
             mIsPickingMode = !mIsPickingMode;
         }
+        else if (arg.key == OIS::KC_ESCAPE && mpDetectionGraph != NULL)
+        {
+            InfoLog << "Cancel primitive detection" << std::endl;
+            mpDetectionGraph->Cancel();
+        }
         return true;
     }
 
@@ -224,11 +216,17 @@ namespace MagicApp
         Ogre::SceneManager* pSceneMgr = MagicCore::RenderSystem::GetSingleton()->GetSceneManager();
         pSceneMgr->setAmbientLight(Ogre::ColourValue::Black);
         pSceneMgr->destroyLight("SimpleLight");
+        ClearDetection();
         if (mpMesh != NULL)
         {
             delete mpMesh;
             mpMesh = NULL;
         }
+        if (mpDetectionContext != NULL)
+        {
+            delete mpDetectionContext;
+            mpDetectionContext = NULL;
+        }
         MagicCore::RenderSystem::GetSingleton()->HideRenderingObject("Mesh3D");
         MagicCore::RenderSystem::GetSingleton()->HideRenderingObject("Primitive");
         if (MagicCore::RenderSystem::GetSingleton()->GetSceneManager()->hasSceneNode("ModelNode"))
@@ -239,6 +237,11 @@ namespace MagicApp
 
     bool PrimitiveDetectionApp::ImportMesh3D()
     {
+        if (mpDetectionGraph != NULL)
+        {
+            InfoLog << "Primitive detection is running" << std::endl;
+            return false;
+        }
         std::string fileName;
         char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0";
         if (MagicCore::ToolKit::FileOpenDlg(fileName, filterName))
@@ -253,6 +256,12 @@ namespace MagicApp
                     delete mpMesh;
                 }
                 mpMesh = pMesh;
+                //The selection data of the old mesh is not valid any more
+                if (mpDetectionContext != NULL)
+                {
+                    delete mpDetectionContext;
+                }
+                mpDetectionContext = new MagicDGP::PrimitiveDetectionContext;
                 MagicCore::RenderSystem::GetSingleton()->RenderMesh3D("Mesh3D", "MyCookTorrance", mpMesh);
                 MagicCore::RenderSystem::GetSingleton()->HideRenderingObject("Primitive");
                 return true;
@@ -270,17 +279,71 @@ namespace MagicApp
 
     void PrimitiveDetectionApp::RansacPrimitiveDetection()
     {
-        std::vector<int> res;
-        MagicDGP::PrimitiveDetection::Primitive2DDetectionEnhance(mpMesh, res);
-        //MagicDGP::PrimitiveDetection::Primitive2DDetectionByScore(mpMesh, res);
-        int vertNum = mpMesh->GetVertexNumber();
-        for (int i = 0; i < vertNum; i++)
+        if (mpMesh == NULL)
         {
-            float cv = res.at(i) * 0.2f;
-            MagicMath::Vector3 color = MagicCore::ToolKit::ColorCoding(cv);
-            mpMesh->GetVertex(i)->SetColor(color);
+            return;
         }
-        MagicCore::RenderSystem::GetSingleton()->RenderMesh3D("Mesh3D", "MyCookTorrance", mpMesh);
+        if (mpDetectionGraph != NULL)
+        {
+            InfoLog << "Primitive detection is running, Esc cancels it" << std::endl;
+            return;
+        }
+        MagicDGP::Mesh3D* pMesh = mpMesh;
+        mpDetectionGraph = new MagicCore::TaskGraph;
+        mpDetectionTask = mpDetectionGraph->AddTask<std::vector<int> >("Primitive2DDetection",
+            [pMesh](MagicCore::GraphTask& task, std::vector<int>& res) -> bool
+        {
+            MagicDGP::PrimitiveDetectionContext context;
+            context.mpCancelToken = task.GetCancelToken();
+            MagicDGP::PrimitiveDetection::Primitive2DDetectionEnhance(pMesh, res, &context);
+            //MagicDGP::PrimitiveDetection::Primitive2DDetectionByScore(pMesh, res);
+            return !task.IsCancelled() && int(res.size()) == pMesh->GetVertexNumber();
+        });
+        mpDetectionGraph->Submit();
+        InfoLog << "Primitive detection started" << std::endl;
+    }
+
+    void PrimitiveDetectionApp::UpdateDetection()
+    {
+        if (mpDetectionGraph == NULL || !mpDetectionGraph->IsFinished())
+        {
+            return;
+        }
+        if (mpDetectionGraph->IsSucceeded())
+        {
+            const std::vector<int>& res = mpDetectionTask->GetResult();
+            int vertNum = mpMesh->GetVertexNumber();
+            for (int i = 0; i < vertNum; i++)
+            {
+                float cv = res.at(i) * 0.2f;
+                MagicMath::Vector3 color = MagicCore::ToolKit::ColorCoding(cv);
+                mpMesh->GetVertex(i)->SetColor(color);
+            }
+            MagicCore::RenderSystem::GetSingleton()->RenderMesh3D("Mesh3D", "MyCookTorrance", mpMesh);
+        }
+        else
+        {
+            InfoLog << "Primitive detection stopped" << std::endl;
+        }
+        ClearDetection();
+    }
+
+    //A running detection is cancelled and stops after its current iteration
+    void PrimitiveDetectionApp::ClearDetection()
+    {
+        if (mpDetectionGraph != NULL)
+        {
+            mpDetectionGraph->Cancel();
+            mpDetectionGraph->Wait();
+            delete mpDetectionGraph;
+            mpDetectionGraph = NULL;
+        }
+        mpDetectionTask = NULL;
+    }
+
+    bool PrimitiveDetectionApp::IsMeshEditable() const
+    {
+        return mpMesh != NULL && mpDetectionGraph == NULL;
     }
 
     void PrimitiveDetectionApp::PrimitiveSelection(int sampleId)
@@ -288,7 +351,7 @@ namespace MagicApp
         int vertNum = mpMesh->GetVertexNumber();
         std::vector<int> res;
         //MagicDGP::ShapeCandidate* pCand = MagicDGP::PrimitiveDetection::Primitive2DSelectionByVertex(mpMesh, sampleId, res);
-        MagicDGP::ShapeCandidate* pCand = MagicDGP::PrimitiveDetection::Primitive2DSelectionByVertexSampling(mpMesh, sampleId, res);
+        MagicDGP::ShapeCandidate* pCand = MagicDGP::PrimitiveDetection::Primitive2DSelectionByVertexSampling(mpMesh, sampleId, res, mpDetectionContext);
         if (pCand != NULL)
         {
             for (int i = 0; i < vertNum; i++)
@@ -582,7 +645,7 @@ namespace MagicApp
 
     void PrimitiveDetectionApp::CalNormalDeviation()
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         //mpMesh->CalculateFaceArea();
         //mpMesh->UpdateBoundaryFlag();
         //int vertNum = mpMesh->GetVertexNumber();
@@ -608,41 +671,17 @@ namespace MagicApp
         //}
         int vertNum = mpMesh->GetVertexNumber();
         std::vector<double> norDev(vertNum);
-        for (int vid = 0; vid < vertNum; vid++)
+        MagicCore::ParallelFor(0, vertNum, [&](int startIndex, int endIndex)
         {
-            std::vector<int> neighborList;
-            neighborList.reserve(10);
-            MagicDGP::Vertex3D* pVert = mpMesh->GetVertex(vid);
-            MagicDGP::Edge3D* pEdge = pVert->GetEdge();
-            do
+            CalVertexNormalDeviation(mpMesh, startIndex, endIndex, norDev);
+            for (int vid = startIndex; vid < endIndex; vid++)
             {
-                if (pEdge == NULL)
-                {
-                    break;
-                }
-                neighborList.push_back(pEdge->GetVertex()->GetId());
-                pEdge = pEdge->GetPair()->GetNext();
-            } while (pEdge != pVert->GetEdge());
-
-            MagicMath::Vector3 normal = mpMesh->GetVertex(vid)->GetNormal();
-            double nDev = 0;
-            for (std::vector<int>::iterator neigItr = neighborList.begin(); neigItr != neighborList.end(); ++neigItr)
-            {
-                //nDev += (normal - (mpMesh->GetVertex(*neigItr)->GetNormal())).Length();
-                double cosA = normal * (mpMesh->GetVertex(*neigItr)->GetNormal());
-                cosA = cosA > 1 ? 1 : (cosA < -1 ? -1 : cosA);
-                nDev += acos(cosA);
-            }
-            if (neighborList.size() > 0)
-            {
-                nDev /= neighborList.size();
+                double nDev = norDev.at(vid) * 10 + 0.2;
+                //DebugLog << "nDev: " << nDev << std::endl;
+                MagicMath::Vector3 color = MagicCore::ToolKit::ColorCoding(nDev);
+                mpMesh->GetVertex(vid)->SetColor(color);
             }
-            norDev.at(vid) = nDev;
-            nDev = nDev * 10 + 0.2;
-            //DebugLog << "nDev: " << nDev << std::endl;
-            MagicMath::Vector3 color = MagicCore::ToolKit::ColorCoding(nDev);
-            mpMesh->GetVertex(vid)->SetColor(color);
-        }
+        });
         //std::vector<MagicMath::Vector3> norGrad;
         //CalScaleGradient(norDev, norGrad, mpMesh);
         //static int smoothNum = 1;
@@ -746,18 +785,14 @@ namespace MagicApp
 
     void PrimitiveDetectionApp::CalNormalDeviationByMT()
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         int vertNum = mpMesh->GetVertexNumber();
         std::vector<double> norDev(vertNum);
-        int threadCount = MagicCore::GetNumberOfProcessors();
-        DebugLog << "Processor number: " << threadCount << std::endl;
-        MagicCore::ThreadPool threadPool(threadCount);
-        for (int tid = 0; tid < threadCount; tid++)
+        DebugLog << "Thread number: " << MagicCore::GetParallelThreadNumber() << std::endl;
+        MagicCore::ParallelFor(0, vertNum, [&](int startIndex, int endIndex)
         {
-            NormalDeviationTask* pTask = new NormalDeviationTask(tid, threadCount, mpMesh, norDev);
-            threadPool.InsertTask(pTask);
-        }
-        threadPool.WaitUntilAllDone();
+            CalVertexNormalDeviation(mpMesh, startIndex, endIndex, norDev);
+        });
         DebugLog << "Finish multi-thread normal deviation" << std::endl;
         double scale = 10;
         for (int vid = 0; vid < vertNum; vid++)
@@ -4,6 +4,7 @@
 #include "PrimitiveDetectionAppUI.h"
 #include "../DGP/Mesh3D.h"
 #include "../DGP/PrimitiveDetection.h"
+#include "../Common/TaskGraph.h"
 
 namespace MagicApp
 {
@@ -36,12 +37,20 @@ namespace MagicApp
     private:
         void SetupScene(void);
         void ShutdownScene(void);
+        void UpdateDetection();
+        void ClearDetection();
+        //The mesh is not touched while detection runs on it
+        bool IsMeshEditable() const;
 
     private:
         PrimitiveDetectionAppUI mUI;
         MagicDGP::ViewTool mViewTool;
         MagicDGP::Mesh3D* mpMesh;
+        MagicDGP::PrimitiveDetectionContext* mpDetectionContext;
         bool mIsPickingMode;
+        //Detection runs in the background, Update polls it
+        MagicCore::TaskGraph* mpDetectionGraph;
+        MagicCore::ResultGraphTask<std::vector<int> >* mpDetectionTask;
     };
 
 }
@@ -3,11 +3,13 @@
 #include "Tool/LogSystem.h"
 #include "../Common/RenderSystem.h"
 #include "../Common/ToolKit.h"
+#include "../Common/Profiler.h"
 #include "../DGP/Registration.h"
 #include "../DGP/SignedDistanceFunction.h"
 #include "../DGP/Parser.h"
 #include "../DGP/MeshReconstruction.h"
 #include "../DGP/Sampling.h"
+#include "../DGP/OniFrameSource.h"
 #include "../Common/AppManager.h"
 #include "PointShopApp.h"
 //#include "../Common/MagicOgre.h"
@@ -26,7 +28,8 @@ namespace MagicApp
         mFrameStartIndex(0),
         mFrameEndIndex(0),
         mFrameCurrent(0),
-        mIsNeedRangeLimitCaculation(false)
+        mIsNeedRangeLimitCaculation(false),
+        mRecordFileName()
     {
     }
 
@@ -335,6 +338,7 @@ namespace MagicApp
             }
             mDepthStream.start();
             mIsScannerDisplaying = true;
+            mRecordFileName = fileName;
             //mIsNeedRangeLimitCaculation = true;
             openni::PlaybackControl* pPC = mDevice.getPlaybackControl();
             mFrameStartIndex = 0;
@@ -423,21 +427,23 @@ namespace MagicApp
 
     void ReconstructionApp::ExportPointSet(void)
     {
-        std::string path = "../../Media/FaceData/PointSet/f";
-        for (int frameId = mFrameStartIndex; frameId < mFrameEndIndex; frameId++)
+        //The pipeline reads the record on its own device, the playback of mDevice is not touched.
+        //Frames stay lossless OBJ, OniExtract can write the quantized m3c archive instead.
+        MagicDGP::OniFrameSource frameSource;
+        if (!frameSource.Open(mRecordFileName))
         {
-            std::stringstream ss;
-            ss << path << frameId << ".obj";
-            std::string fileName;
-            ss >> fileName;
-            MagicDGP::Point3DSet* pPointSet = GetPointSetFromRecord(frameId);
-            MagicDGP::Parser::ExportPointSet(fileName, pPointSet);
-            delete pPointSet;
+            return;
         }
+        frameSource.SetFrameRange(mFrameStartIndex, mFrameEndIndex);
+        MagicDGP::DepthFramePipeline pipeline;
+        pipeline.Run(&frameSource, GetRangeLimit(), "../../Media/FaceData/PointSet/f", "obj");
     }
 
+    //Not a TaskGraph pipeline: every frame seeks the OpenNI playback of the app and the loop renders the
+    //fused cloud and the progress bar itself, so it stays on the UI thread
     void ReconstructionApp::PointSetRegistration()
     {
+        PROFILE_ZONE("Reconstruction::PointSetRegistration");
         DebugLog << "Coarse Limit: " << mLeftLimit << " " << mRightLimit << " " << mDownLimit << " " << mTopLimit << 
              " " << mFrontLimit << " " << mBackLimit << std::endl;
         mIsScannerDisplaying = false;
@@ -459,17 +465,18 @@ namespace MagicApp
         MagicCore::RenderSystem::GetSingleton()->Update();
         for (int frameIndex = mFrameStartIndex + 1; frameIndex <= mFrameEndIndex; frameIndex++)
         {
-            float timeStart = MagicCore::ToolKit::GetTime();
+            PROFILE_ZONE("Reconstruction::FusionFrame");
+            double timeStart = MagicCore::ToolKit::GetTime();
             mUI.SetProgressBarPosition(frameIndex - mFrameStartIndex);
             DebugLog << "Fusion Point Set: " << frameIndex << " -------------------------------"<< std::endl;
             MagicDGP::Point3DSet* pNewPC = GetPointSetFromRecord(frameIndex);//
             MagicMath::HomoMatrix4 newTrans;//
             DebugLog << "    Get " << pNewPC->GetPointNumber() << " PointSetFromRecord: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
-            float timeRegistrate = MagicCore::ToolKit::GetTime();
+            double timeRegistrate = MagicCore::ToolKit::GetTime();
             MagicDGP::Registration registrate;
             registrate.ICPRegistrateEnhance(pPointSet, pNewPC, &lastTrans, &newTrans, mDepthStream);//
             DebugLog << "    Fusion: ICP Registration: " << MagicCore::ToolKit::GetTime() - timeRegistrate << std::endl;
-            float timeUpdateSDF = MagicCore::ToolKit::GetTime();
+            double timeUpdateSDF = MagicCore::ToolKit::GetTime();
             MagicMath::HomoMatrix4 newTransInv = newTrans.Inverse();//
             sdf.UpdateSDF(pNewPC, &newTransInv);//
             DebugLog << "    Fusion: Update SDF: " << MagicCore::ToolKit::GetTime() - timeUpdateSDF << std::endl;
@@ -477,7 +484,7 @@ namespace MagicApp
             delete pPointSet;
             delete pNewPC;
             pNewPC = NULL;
-            float timeExtract = MagicCore::ToolKit::GetTime();
+            double timeExtract = MagicCore::ToolKit::GetTime();
             pPointSet = sdf.ExtractFinePointCloud();//
             DebugLog << "    Fusion: Extract Point Set: " << MagicCore::ToolKit::GetTime() - timeExtract << std::endl;
             MagicCore::RenderSystem::GetSingleton()->RenderPoint3DSet("ScannerDepth", "MyCookTorrancePoint", pPointSet);
@@ -501,6 +508,18 @@ namespace MagicApp
         DebugLog << "ReconstructionApp::PointSetRegistrationEnhance: End" << std::endl;
     }
 
+    MagicDGP::DepthRangeLimit ReconstructionApp::GetRangeLimit() const
+    {
+        MagicDGP::DepthRangeLimit range;
+        range.mLeft = mLeftLimit;
+        range.mRight = mRightLimit;
+        range.mTop = mTopLimit;
+        range.mDown = mDownLimit;
+        range.mFront = mFrontLimit;
+        range.mBack = mBackLimit;
+        return range;
+    }
+
     MagicDGP::Point3DSet* ReconstructionApp::GetPointSetFromRecord(int frameId)
     {
         DebugLog << "ReconstructionApp::GetPointSetFromRecord " << frameId << std::endl;
@@ -519,165 +538,15 @@ namespace MagicApp
 
         if (depthFrame.isValid())
         {
+            MagicDGP::DepthFrame frame;
+            frame.mFrameId = frameId;
+            frame.mResolutionX = depthFrame.getVideoMode().getResolutionX();
+            frame.mResolutionY = depthFrame.getVideoMode().getResolutionY();
             const openni::DepthPixel* pDepth = (const openni::DepthPixel*)depthFrame.getData();
-            int resolutionX = depthFrame.getVideoMode().getResolutionX();
-            int resolutionY = depthFrame.getVideoMode().getResolutionY();
-            std::vector<MagicMath::Vector3> posList;
-            for(int y = 0; y < resolutionY; y++)  
-            {  
-                for(int x = 0; x < resolutionX; x++)  
-                {
-                    openni::DepthPixel depth = pDepth[y * resolutionX + x]; 
-                    float rx, ry, rz;
-                    openni::CoordinateConverter::convertDepthToWorld(mDepthStream, 
-                        x, y, depth, &rx, &ry, &rz);
-                    MagicMath::Vector3 pos(-rx, ry, -rz);
-                    posList.push_back(pos);
-                }
-            }
-            //Smooth
-            std::vector<MagicMath::Vector3> smoothPosList;
-            float depthThre = 100;
-            for (int y = 0; y < resolutionY; y++)
-            {
-                for (int x = 0; x < resolutionX ; x++)
-                {
-                    MagicMath::Vector3 pos = posList.at(y * resolutionX + x);
-                    if ((y == 0) || (y == resolutionY - 1) || (x == 0) || (x == resolutionX - 1))
-                    {
-                        smoothPosList.push_back(pos);
-                        continue;
-                    }
-                    if (pos[0] < mLeftLimit || pos[0] > mRightLimit ||
-                        pos[1] < mDownLimit || pos[1] > mTopLimit ||
-                        pos[2] > mFrontLimit || pos[2] < mBackLimit)
-                    {
-                        smoothPosList.push_back(pos);
-                        continue;
-                    }
-                    if (pos.Length() < 1.0e-15)
-                    {
-                        smoothPosList.push_back(pos);
-                        continue;
-                    }
-                    std::vector<MagicMath::Vector3> neighbotPos;
-                    MagicMath::Vector3 pos1 = posList.at(y * resolutionX + x - 1);
-                    if (pos1.Length() > 1.0e-15)
-                    {
-                        if (fabs(pos[2] - pos1[2]) < depthThre)
-                        {
-                            neighbotPos.push_back(pos1);
-                        }
-                        else
-                        {
-                            smoothPosList.push_back(MagicMath::Vector3(0, 0, 0));
-                            continue;
-                        }
-                    }
-                    MagicMath::Vector3 pos2 = posList.at(y * resolutionX + x + 1);
-                    if (pos2.Length() > 1.0e-15)
-                    {
-                        if (fabs(pos[2] - pos2[2]) < depthThre)
-                        {
-                            neighbotPos.push_back(pos2);
-                        }
-                        else
-                        {
-                            smoothPosList.push_back(MagicMath::Vector3(0, 0, 0));
-                            continue;
-                        }
-                    }
-                    MagicMath::Vector3 pos3 = posList.at((y - 1) * resolutionX + x);
-                    if (pos3.Length() > 1.0e-15)
-                    {
-                        if (fabs(pos[2] - pos3[2]) < depthThre)
-                        {
-                            neighbotPos.push_back(pos3);
-                        }
-                        else
-                        {
-                            smoothPosList.push_back(MagicMath::Vector3(0, 0, 0));
-                            continue;
-                        }
-                    }
-                    MagicMath::Vector3 pos4 = posList.at((y + 1) * resolutionX + x);
-                    if (pos4.Length() > 1.0e-15)
-                    {
-                        if (fabs(pos[2] - pos4[2]) < depthThre)
-                        {
-                            neighbotPos.push_back(pos4);
-                        }
-                        else
-                        {
-                            smoothPosList.push_back(MagicMath::Vector3(0, 0, 0));
-                            continue;
-                        }
-                    }
-                    if (neighbotPos.size() == 0)
-                    {
-                        smoothPosList.push_back(pos);
-                    }
-                    else
-                    {
-                        MagicMath::Vector3 avgPos(0, 0, 0);
-                        for (int i = 0; i < neighbotPos.size(); i++)
-                        {
-                            avgPos += neighbotPos.at(i);
-                        }
-                        avgPos /= neighbotPos.size();
-                        smoothPosList.push_back( (pos + avgPos) / 2);
-                    }
-                }
-            }
-            posList = smoothPosList;
-            //
-            std::vector<MagicMath::Vector3> norList;
-            for (int y = 0; y < resolutionY; y++)
-            {
-                for (int x = 0; x < resolutionX; x++)
-                {
-                    if ((y == 0) || (y == resolutionY - 1) || (x == 0) || (x == resolutionX - 1))
-                    {
-                        norList.push_back(MagicMath::Vector3(0, 0, 1));
-                        continue;
-                    }
-                    MagicMath::Vector3 pos = posList.at(y * resolutionX + x);
-                    if (pos[0] < mLeftLimit || pos[0] > mRightLimit ||
-                        pos[1] < mDownLimit || pos[1] > mTopLimit ||
-                        pos[2] > mFrontLimit || pos[2] < mBackLimit)
-                    {
-                        norList.push_back(MagicMath::Vector3(0, 0, 1));
-                        continue;
-                    }
-                    MagicMath::Vector3 dirX = posList.at(y * resolutionX + x + 1) - posList.at(y * resolutionX + x - 1);
-                    MagicMath::Vector3 dirY = posList.at((y + 1) * resolutionX + x) - posList.at((y - 1) * resolutionX + x);
-                    MagicMath::Vector3 nor = dirX.CrossProduct(dirY);
-                    double len = nor.Normalise();
-                    if (len > 1.0e-15)
-                    {
-                        norList.push_back(nor);
-                    }
-                    else
-                    {
-                        norList.push_back(MagicMath::Vector3(0, 0, 1));
-                    }
-                }
-            }
-            MagicDGP::Point3DSet* pPS = new MagicDGP::Point3DSet;
-            int pointNum = posList.size();
-            for (int i = 0; i < pointNum; i++)
-            {
-                MagicMath::Vector3 pos = posList.at(i);
-                if (pos[0] < mLeftLimit || pos[0] > mRightLimit ||
-                    pos[1] < mDownLimit || pos[1] > mTopLimit ||
-                    pos[2] > mFrontLimit || pos[2] < mBackLimit)
-                {
-                    continue;
-                }
-                MagicDGP::Point3D* pNewPoint = new MagicDGP::Point3D(pos, norList.at(i));
-                pPS->InsertPoint(pNewPoint);
-            }
-            return pPS;
+            frame.mDepthList.assign(pDepth, pDepth + frame.mResolutionX * frame.mResolutionY);
+            double xzFactor = tan(mDepthStream.getHorizontalFieldOfView() / 2) * 2;
+            double yzFactor = tan(mDepthStream.getVerticalFieldOfView() / 2) * 2;
+            return MagicDGP::DepthFrameConverter::ToPointSet(frame, xzFactor, yzFactor, GetRangeLimit());
         }
         else
         {
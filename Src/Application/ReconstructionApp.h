@@ -5,6 +5,7 @@
 #include "../DGP/PointCloud3D.h"
 #include "../DGP/Mesh3D.h"
 #include "../DGP/ViewTool.h"
+#include "../DGP/DepthFramePipeline.h"
 
 namespace MagicApp
 {
@@ -40,6 +41,7 @@ namespace MagicApp
         void ReleaseDevice();
         void UpdateScannerDisplay();
         void CoarseRangeLimitCalculation(const std::vector<MagicMath::Vector3>& posList);
+        MagicDGP::DepthRangeLimit GetRangeLimit() const;
         MagicDGP::Point3DSet* GetPointSetFromRecord(int frameId);
 
     private:
@@ -52,6 +54,7 @@ namespace MagicApp
         float mLeftLimit, mRightLimit, mTopLimit, mDownLimit, mFrontLimit, mBackLimit;
         int mFrameStartIndex, mFrameEndIndex, mFrameCurrent;
         bool mIsNeedRangeLimitCaculation;
+        std::string mRecordFileName;
     };
 
 }
\ No newline at end of file
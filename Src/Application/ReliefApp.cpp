@@ -120,7 +120,7 @@ namespace MagicApp
     bool ReliefApp::ImportMesh3D()
     {
         std::string fileName;
-        char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0OFF Files(*.off)\0*.off\0";
+        char filterName[] = "OBJ Files(*.obj)\0*.obj\0STL Files(*.stl)\0*.stl\0OFF Files(*.off)\0*.off\0PLY Files(*.ply)\0*.ply\0M3D Files(*.m3d)\0*.m3d\0";
         if (MagicCore::ToolKit::FileOpenDlg(fileName, filterName))
         {
             MagicDGP::LightMesh3D* pLightMesh = MagicDGP::Parser::ParseLightMesh3D(fileName);
@@ -204,7 +204,7 @@ namespace MagicApp
         if (mpLightMesh != NULL)
         {
             std::string fileName;
-            char filterName[] = "Support format(*.obj, *.stl, *.off)\0*.*\0";
+            char filterName[] = "Support format(*.obj, *.stl, *.off, *.ply, *.m3d)\0*.*\0";
             if (MagicCore::ToolKit::FileSaveDlg(fileName, filterName))
             {
                 MagicDGP::Parser::ExportLightMesh3D(fileName, mpLightMesh);
@@ -336,9 +336,8 @@ namespace MagicApp
                 unsigned char* pixel = mDisplayImage.ptr(hid, wid);
                 MagicMath::Vector3 pos(pixel[2], pixel[1], pixel[0]);
                 MagicMath::Vector3 color(pixel[2] / 255.0, pixel[1] / 255.0, pixel[0] / 255.0);
-                MagicDGP::Point3D* pPoint = new MagicDGP::Point3D(pos);
+                MagicDGP::Point3D* pPoint = mpPointSet->InsertPoint(pos);
                 pPoint->SetColor(color);
-                mpPointSet->InsertPoint(pPoint);
             }
         }
         mpPointSet->UnifyPosition(2.0);
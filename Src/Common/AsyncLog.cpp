@@ -0,0 +1,411 @@
+#include "AsyncLog.h"
+#include "ThreadPool.h"
+#include "Tool/LogSystem.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+
+#ifdef _MSC_VER
+#define MAGIC_THREAD_LOCAL __declspec(thread)
+#define snprintf _snprintf
+#else
+#define MAGIC_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+    //Lines per ring buffer, a power of two
+    const unsigned int AsyncLogRingSize = 1024;
+    //The background thread writes the queued lines at least this often
+    const int AsyncLogFlushMilliseconds = 50;
+
+    struct AsyncLogRecord
+    {
+        int mLevel;
+        char mText[MagicCore::AsyncLogLineSize];
+    };
+
+    //Ring buffer of one thread. The owning thread pushes and the flushing thread pops, so the indices are the
+    //only shared state.
+    class AsyncLogRing
+    {
+    public:
+        AsyncLogRing() :
+            mRecordList(AsyncLogRingSize),
+            mWriteIndex(0),
+            mReadIndex(0),
+            mIsOwned(false)
+        {
+        }
+
+        bool Push(int level, const char* text, int length)
+        {
+            unsigned int writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+            if (writeIndex - mReadIndex.load(std::memory_order_acquire) >= AsyncLogRingSize)
+            {
+                return false;
+            }
+            AsyncLogRecord& record = mRecordList[writeIndex & (AsyncLogRingSize - 1)];
+            record.mLevel = level;
+            memcpy(record.mText, text, length);
+            record.mText[length] = '\0';
+            mWriteIndex.store(writeIndex + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(AsyncLogRecord& record)
+        {
+            unsigned int readIndex = mReadIndex.load(std::memory_order_relaxed);
+            if (readIndex == mWriteIndex.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            record = mRecordList[readIndex & (AsyncLogRingSize - 1)];
+            mReadIndex.store(readIndex + 1, std::memory_order_release);
+            return true;
+        }
+
+        //A thread takes a ring which no other thread owns
+        bool TryOwn()
+        {
+            bool isOwned = false;
+            return mIsOwned.compare_exchange_strong(isOwned, true);
+        }
+
+        void Release()
+        {
+            mIsOwned = false;
+        }
+
+    private:
+        std::vector<AsyncLogRecord> mRecordList;
+        std::atomic<unsigned int> mWriteIndex;
+        std::atomic<unsigned int> mReadIndex;
+        std::atomic<bool> mIsOwned;
+    };
+
+    class AsyncLogger
+    {
+    public:
+        AsyncLogger() :
+            mRingList(),
+            mRingMutex(),
+            mFlushMutex(),
+            mpFlushThread(NULL),
+            mIsFlushThreadRunning(false),
+            mThreadMutex(),
+            mThreadCV(),
+            mIsExit(false),
+            mDroppedNum(0),
+            mReportedDroppedNum(0)
+        {
+        }
+
+        //The ring of the calling thread, a released ring is taken before a new one is created
+        AsyncLogRing* AcquireRing()
+        {
+            MagicCore::ScopedLock lock(mRingMutex);
+            for (std::vector<AsyncLogRing*>::iterator itr = mRingList.begin(); itr != mRingList.end(); ++itr)
+            {
+                if ((*itr)->TryOwn())
+                {
+                    return *itr;
+                }
+            }
+            AsyncLogRing* pRing = new AsyncLogRing;
+            pRing->TryOwn();
+            mRingList.push_back(pRing);
+            return pRing;
+        }
+
+        void Push(AsyncLogRing* pRing, int level, const char* text, int length)
+        {
+            if (!mIsFlushThreadRunning.load())
+            {
+                StartFlushThread();
+            }
+            if (!pRing->Push(level, text, length))
+            {
+                mDroppedNum++;
+            }
+        }
+
+        void Flush()
+        {
+            std::vector<AsyncLogRing*> ringList;
+            {
+                MagicCore::ScopedLock lock(mRingMutex);
+                ringList = mRingList;
+            }
+            //A ring has one reader
+            MagicCore::ScopedLock lock(mFlushMutex);
+            AsyncLogRecord record;
+            for (std::vector<AsyncLogRing*>::iterator itr = ringList.begin(); itr != ringList.end(); ++itr)
+            {
+                while ((*itr)->Pop(record))
+                {
+                    WriteRecord(record);
+                }
+            }
+            int droppedNum = mDroppedNum.load();
+            if (droppedNum != mReportedDroppedNum)
+            {
+                WarnLog << "AsyncLog: " << droppedNum - mReportedDroppedNum << " lines dropped" << std::endl;
+                mReportedDroppedNum = droppedNum;
+            }
+        }
+
+        void Stop()
+        {
+            StopFlushThread();
+            Flush();
+        }
+
+        int GetDroppedNumber() const
+        {
+            return mDroppedNum.load();
+        }
+
+        //Nothing is written here, the log system can be destroyed before this global.
+        //StopAsyncLog writes the queued lines before the program ends.
+        ~AsyncLogger()
+        {
+            StopFlushThread();
+            for (std::vector<AsyncLogRing*>::iterator itr = mRingList.begin(); itr != mRingList.end(); ++itr)
+            {
+                delete (*itr);
+            }
+            mRingList.clear();
+        }
+
+    private:
+        void StartFlushThread()
+        {
+            MagicCore::ScopedLock lock(mThreadMutex);
+            if (mpFlushThread == NULL && !mIsExit)
+            {
+                mpFlushThread = new std::thread(&AsyncLogger::FlushRun, this);
+                mIsFlushThreadRunning = true;
+            }
+        }
+
+        //Joins the flush thread without writing the queued lines
+        void StopFlushThread()
+        {
+            std::thread* pFlushThread = NULL;
+            {
+                MagicCore::ScopedLock lock(mThreadMutex);
+                pFlushThread = mpFlushThread;
+                mpFlushThread = NULL;
+                mIsFlushThreadRunning = false;
+                mIsExit = true;
+            }
+            mThreadCV.WakeAll();
+            if (pFlushThread != NULL)
+            {
+                pFlushThread->join();
+                delete pFlushThread;
+            }
+            {
+                MagicCore::ScopedLock lock(mThreadMutex);
+                mIsExit = false;
+            }
+        }
+
+        void FlushRun()
+        {
+            while (true)
+            {
+                {
+                    MagicCore::ScopedLock lock(mThreadMutex);
+                    if (!mIsExit)
+                    {
+                        mThreadCV.SleepFor(mThreadMutex, AsyncLogFlushMilliseconds);
+                    }
+                    if (mIsExit)
+                    {
+                        break;
+                    }
+                }
+                Flush();
+            }
+        }
+
+        void WriteRecord(const AsyncLogRecord& record)
+        {
+            switch (record.mLevel)
+            {
+            case MagicCore::ALL_Debug:
+                DebugLog << record.mText << std::endl;
+                break;
+            case MagicCore::ALL_Info:
+                InfoLog << record.mText << std::endl;
+                break;
+            case MagicCore::ALL_Warn:
+                WarnLog << record.mText << std::endl;
+                break;
+            default:
+                ErrorLog << record.mText << std::endl;
+                break;
+            }
+        }
+
+    private:
+        std::vector<AsyncLogRing*> mRingList;
+        MagicCore::Mutex mRingMutex;
+        MagicCore::Mutex mFlushMutex;
+        std::thread* mpFlushThread;
+        std::atomic<bool> mIsFlushThreadRunning;
+        MagicCore::Mutex mThreadMutex;
+        MagicCore::ConditionVariable mThreadCV;
+        bool mIsExit;
+        std::atomic<int> mDroppedNum;
+        int mReportedDroppedNum;
+    };
+
+    AsyncLogger gAsyncLogger;
+    MAGIC_THREAD_LOCAL AsyncLogRing* tlpAsyncLogRing = NULL;
+}
+
+namespace MagicCore
+{
+    AsyncLogLine::AsyncLogLine(AsyncLogLevel level) :
+        mLevel(level),
+        mLength(0)
+    {
+    }
+
+    void AsyncLogLine::Append(const char* text, int length)
+    {
+        int freeLength = AsyncLogLineSize - 1 - mLength;
+        length = length < freeLength ? length : freeLength;
+        if (length > 0)
+        {
+            memcpy(mText + mLength, text, length);
+            mLength += length;
+        }
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (const char* text)
+    {
+        Append(text, int(strlen(text)));
+        return *this;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (const std::string& text)
+    {
+        Append(text.c_str(), int(text.size()));
+        return *this;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (char value)
+    {
+        Append(&value, 1);
+        return *this;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (int value)
+    {
+        return (*this) << (long long)value;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (unsigned int value)
+    {
+        return (*this) << (unsigned long long)value;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (long value)
+    {
+        return (*this) << (long long)value;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (unsigned long value)
+    {
+        return (*this) << (unsigned long long)value;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (long long value)
+    {
+        char buffer[32];
+        int length = snprintf(buffer, sizeof(buffer), "%lld", value);
+        Append(buffer, length);
+        return *this;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (unsigned long long value)
+    {
+        char buffer[32];
+        int length = snprintf(buffer, sizeof(buffer), "%llu", value);
+        Append(buffer, length);
+        return *this;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (double value)
+    {
+        char buffer[32];
+        int length = snprintf(buffer, sizeof(buffer), "%g", value);
+        Append(buffer, length);
+        return *this;
+    }
+
+    AsyncLogLine& AsyncLogLine::operator << (std::ostream& (*manipulator)(std::ostream&))
+    {
+        return *this;
+    }
+
+    AsyncLogLine::~AsyncLogLine()
+    {
+        if (tlpAsyncLogRing == NULL)
+        {
+            tlpAsyncLogRing = gAsyncLogger.AcquireRing();
+        }
+        gAsyncLogger.Push(tlpAsyncLogRing, mLevel, mText, mLength);
+    }
+
+    AsyncLogSite::AsyncLogSite(int burstNum, int intervalNum) :
+        mCount(0),
+        mBurstNum(burstNum),
+        mIntervalNum(intervalNum)
+    {
+    }
+
+    bool AsyncLogSite::Pass()
+    {
+        int count = ++mCount;
+        if (count <= mBurstNum)
+        {
+            return true;
+        }
+        return mIntervalNum > 0 && (count - mBurstNum) % mIntervalNum == 0;
+    }
+
+    int AsyncLogSite::GetCount() const
+    {
+        return mCount.load();
+    }
+
+    void FlushAsyncLog()
+    {
+        gAsyncLogger.Flush();
+    }
+
+    void StopAsyncLog()
+    {
+        gAsyncLogger.Stop();
+    }
+
+    void ReleaseAsyncLogThread()
+    {
+        if (tlpAsyncLogRing != NULL)
+        {
+            tlpAsyncLogRing->Release();
+            tlpAsyncLogRing = NULL;
+        }
+    }
+
+    int GetAsyncLogDroppedNumber()
+    {
+        return gAsyncLogger.GetDroppedNumber();
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <atomic>
+
+//Compile time log level, the async log lines below it are compiled out
+#define MAGIC_LOG_LEVEL_DEBUG 0
+#define MAGIC_LOG_LEVEL_INFO  1
+#define MAGIC_LOG_LEVEL_WARN  2
+#define MAGIC_LOG_LEVEL_ERROR 3
+#define MAGIC_LOG_LEVEL_NONE  4
+
+#ifndef MAGIC_LOG_LEVEL
+#ifdef _DEBUG
+#define MAGIC_LOG_LEVEL MAGIC_LOG_LEVEL_DEBUG
+#else
+#define MAGIC_LOG_LEVEL MAGIC_LOG_LEVEL_INFO
+#endif
+#endif
+
+namespace MagicCore
+{
+    enum AsyncLogLevel
+    {
+        ALL_Debug = MAGIC_LOG_LEVEL_DEBUG,
+        ALL_Info = MAGIC_LOG_LEVEL_INFO,
+        ALL_Warn = MAGIC_LOG_LEVEL_WARN,
+        ALL_Error = MAGIC_LOG_LEVEL_ERROR
+    };
+
+    //Longer lines are cut
+    const int AsyncLogLineSize = 240;
+
+    //One log line. It is formatted in the line and queued to the ring buffer of the calling thread on destruction,
+    //a background thread writes it to the log system. A full ring drops the line instead of blocking.
+    class AsyncLogLine
+    {
+    public:
+        AsyncLogLine(AsyncLogLevel level);
+        AsyncLogLine& operator << (const char* text);
+        AsyncLogLine& operator << (const std::string& text);
+        AsyncLogLine& operator << (char value);
+        AsyncLogLine& operator << (int value);
+        AsyncLogLine& operator << (unsigned int value);
+        AsyncLogLine& operator << (long value);
+        AsyncLogLine& operator << (unsigned long value);
+        AsyncLogLine& operator << (long long value);
+        AsyncLogLine& operator << (unsigned long long value);
+        AsyncLogLine& operator << (double value);
+        //std::endl, a line always ends with the statement
+        AsyncLogLine& operator << (std::ostream& (*manipulator)(std::ostream&));
+        ~AsyncLogLine();
+
+    private:
+        AsyncLogLine(const AsyncLogLine&);
+        AsyncLogLine& operator = (const AsyncLogLine&);
+
+        void Append(const char* text, int length);
+
+    private:
+        AsyncLogLevel mLevel;
+        int mLength;
+        char mText[AsyncLogLineSize];
+    };
+
+    //Rate limit of a log site: the first burstNum lines pass, then one of every intervalNum lines.
+    //Declare it at namespace scope, its initialization is not thread safe as a function static.
+    class AsyncLogSite
+    {
+    public:
+        AsyncLogSite(int burstNum, int intervalNum);
+        bool Pass();
+        int GetCount() const;
+
+    private:
+        std::atomic<int> mCount;
+        int mBurstNum;
+        int mIntervalNum;
+    };
+
+    //Writes the queued lines of all threads now. Lines are written in order per thread.
+    void FlushAsyncLog();
+    //Flushes and stops the background thread, it starts again with the next line
+    void StopAsyncLog();
+    //The calling thread ends, its ring buffer can be taken by a new thread
+    void ReleaseAsyncLogThread();
+    //Lines dropped because a ring buffer was full
+    int  GetAsyncLogDroppedNumber();
+}
+
+#define MAGIC_ASYNC_LOG(level) if (int(level) < MAGIC_LOG_LEVEL) {} else MagicCore::AsyncLogLine(level)
+#define MAGIC_ASYNC_LOG_SITE(level, site) if (int(level) < MAGIC_LOG_LEVEL || !(site).Pass()) {} else MagicCore::AsyncLogLine(level)
+
+//For kernels and worker threads: AsyncDebugLog << "value: " << value << std::endl;
+#define AsyncDebugLog MAGIC_ASYNC_LOG(MagicCore::ALL_Debug)
+#define AsyncInfoLog  MAGIC_ASYNC_LOG(MagicCore::ALL_Info)
+#define AsyncWarnLog  MAGIC_ASYNC_LOG(MagicCore::ALL_Warn)
+#define AsyncErrorLog MAGIC_ASYNC_LOG(MagicCore::ALL_Error)
+
+//Rate limited by an AsyncLogSite: AsyncDebugLogSite(gSmallNormalSite) << "small normal" << std::endl;
+#define AsyncDebugLogSite(site) MAGIC_ASYNC_LOG_SITE(MagicCore::ALL_Debug, site)
+#define AsyncInfoLogSite(site)  MAGIC_ASYNC_LOG_SITE(MagicCore::ALL_Info, site)
+#define AsyncWarnLogSite(site)  MAGIC_ASYNC_LOG_SITE(MagicCore::ALL_Warn, site)
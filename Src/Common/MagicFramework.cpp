@@ -6,13 +6,17 @@
 #include "ResourceManager.h"
 #include "AppManager.h"
 #include "GUISystem.h"
+#include "AsyncLog.h"
+#include "Profiler.h"
 #include "Tool/LogSystem.h"
+#include <stdlib.h>
 
 namespace MagicCore
 {
     MagicFramework::MagicFramework() :
         mTimeAccumulate(0.f),
-        mRenderDeltaTime(0.025f)
+        mRenderDeltaTime(0.025f),
+        mProfileTraceFile()
     {
     }
 
@@ -23,6 +27,13 @@ namespace MagicCore
     void MagicFramework::Init()
     {
         InfoLog << "MagicFramework init" << std::endl;
+        //MAGIC_PROFILE_TRACE=trace.json records the profile zones of the session and exports them on exit
+        const char* traceFileName = getenv("MAGIC_PROFILE_TRACE");
+        if (traceFileName != NULL && traceFileName[0] != '\0')
+        {
+            mProfileTraceFile = traceFileName;
+            SetProfileEnabled(true);
+        }
         RenderSystem::GetSingleton()->Init();
         ResourceManager::Init();
         GUISystem::GetSingleton()->Init(RenderSystem::GetSingleton()->GetRenderWindow(), RenderSystem::GetSingleton()->GetSceneManager(), "MyGUIResource");
@@ -33,14 +44,21 @@ namespace MagicCore
     void MagicFramework::Run()
     {
         InfoLog << "MagicFramework run" << std::endl;
-        float timeLastFrame = ToolKit::GetTime();
+        double timeLastFrame = ToolKit::GetTime();
         while (Running())
         {
-            float timeCurrentFrame = ToolKit::GetTime();
-            float timeSinceLastFrame = timeCurrentFrame - timeLastFrame;
+            double timeCurrentFrame = ToolKit::GetTime();
+            float timeSinceLastFrame = float(timeCurrentFrame - timeLastFrame);
             timeLastFrame = timeCurrentFrame;
             Update(timeSinceLastFrame);
         }
+        if (!mProfileTraceFile.empty())
+        {
+            LogProfileStatistics();
+            ExportProfileTrace(mProfileTraceFile);
+        }
+        //Lines still queued by the kernels
+        StopAsyncLog();
     }
 
     void MagicFramework::Update(float timeElapsed)
@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 
 namespace MagicCore
 {
@@ -18,5 +19,6 @@ namespace MagicCore
     private:
         float mTimeAccumulate;
         float mRenderDeltaTime;
+        std::string mProfileTraceFile;
     };
 }
@@ -0,0 +1,89 @@
+#include "Parallel.h"
+#include "Tool/LogSystem.h"
+
+namespace
+{
+    int gParallelThreadNumber = 0;
+    //Created on first use and rebuilt when the thread number changes, its threads sleep while no loop runs
+    MagicCore::ThreadPool* gpParallelThreadPool = NULL;
+    std::mutex gParallelMutex;
+    int gParallelPoolUserNumber = 0;
+    //Chunks per thread when the caller gives no grain size, so a slow chunk does not keep the others waiting
+    const int DefaultChunkPerThread = 4;
+}
+
+namespace MagicCore
+{
+    bool SetParallelThreadNumber(int threadNum)
+    {
+        std::lock_guard<std::mutex> lock(gParallelMutex);
+        if (threadNum < 0)
+        {
+            threadNum = 0;
+        }
+        if (threadNum != gParallelThreadNumber)
+        {
+            if (gParallelPoolUserNumber > 0)
+            {
+                WarnLog << "SetParallelThreadNumber: task graphs are running, thread number is not changed" << std::endl;
+                return false;
+            }
+            gParallelThreadNumber = threadNum;
+            delete gpParallelThreadPool;
+            gpParallelThreadPool = NULL;
+        }
+        return true;
+    }
+
+    int GetParallelThreadNumber()
+    {
+        std::lock_guard<std::mutex> lock(gParallelMutex);
+        return gParallelThreadNumber > 0 ? gParallelThreadNumber : GetNumberOfProcessors();
+    }
+
+    ThreadPool* GetParallelThreadPool()
+    {
+        std::lock_guard<std::mutex> lock(gParallelMutex);
+        int threadNum = gParallelThreadNumber > 0 ? gParallelThreadNumber : GetNumberOfProcessors();
+        if (threadNum < 2)
+        {
+            return NULL;
+        }
+        if (gpParallelThreadPool == NULL)
+        {
+            gpParallelThreadPool = new ThreadPool(threadNum);
+        }
+        return gpParallelThreadPool;
+    }
+
+    void BeginParallelPoolUse()
+    {
+        std::lock_guard<std::mutex> lock(gParallelMutex);
+        gParallelPoolUserNumber++;
+    }
+
+    void EndParallelPoolUse()
+    {
+        std::lock_guard<std::mutex> lock(gParallelMutex);
+        gParallelPoolUserNumber--;
+    }
+
+    int GetParallelChunkNumber(int indexNum, int grainSize)
+    {
+        int threadNum = GetParallelThreadNumber();
+        if (threadNum < 2 || indexNum < 2)
+        {
+            return 1;
+        }
+        int chunkNum = 0;
+        if (grainSize > 0)
+        {
+            chunkNum = indexNum / grainSize + (indexNum % grainSize > 0 ? 1 : 0);
+        }
+        else
+        {
+            chunkNum = threadNum * DefaultChunkPerThread;
+        }
+        return chunkNum < indexNum ? chunkNum : indexNum;
+    }
+}
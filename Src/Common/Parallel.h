@@ -0,0 +1,130 @@
+#pragma once
+#include "ThreadPool.h"
+#include <vector>
+
+namespace MagicCore
+{
+    //Thread number of the parallel helpers and of the parallel DGP kernels, 0 means the processor number.
+    //With 1 every loop runs in the calling thread in index order, so results equal the serial code.
+    //Not to be changed while a parallel loop runs. Returns false and keeps the number while a pool user is active.
+    bool SetParallelThreadNumber(int threadNum);
+    int  GetParallelThreadNumber();
+    //Pool shared by ParallelFor and ParallelReduce, NULL if the thread number is 1
+    ThreadPool* GetParallelThreadPool();
+    //Users which run parallel loops from their own threads, as a submitted TaskGraph. The pool is not rebuilt
+    //between Begin and End.
+    void BeginParallelPoolUse();
+    void EndParallelPoolUse();
+    //Chunks of [0, indexNum): at most grainSize indices each, so grainSize 1 gives a chunk per index.
+    //grainSize 0 gives about 4 chunks per thread.
+    int  GetParallelChunkNumber(int indexNum, int grainSize);
+
+    template <class Body>
+    class ParallelForTask : public ITask
+    {
+    public:
+        ParallelForTask(const Body* pBody, int startIndex, int endIndex) :
+            mpBody(pBody),
+            mStartIndex(startIndex),
+            mEndIndex(endIndex)
+        {
+        }
+
+        virtual void Run()
+        {
+            (*mpBody)(mStartIndex, mEndIndex);
+        }
+
+    private:
+        const Body* mpBody;
+        int mStartIndex;
+        int mEndIndex;
+    };
+
+    template <class T, class Body>
+    class ParallelReduceTask : public ResultTask<T>
+    {
+    public:
+        ParallelReduceTask(const Body* pBody, int startIndex, int endIndex, const T& identity) :
+            mpBody(pBody),
+            mStartIndex(startIndex),
+            mEndIndex(endIndex),
+            mIdentity(identity)
+        {
+        }
+
+        virtual void Run()
+        {
+            this->mResult = (*mpBody)(mStartIndex, mEndIndex, mIdentity);
+        }
+
+    private:
+        const Body* mpBody;
+        int mStartIndex;
+        int mEndIndex;
+        T mIdentity;
+    };
+
+    //body(rangeStart, rangeEnd) is called on disjoint ranges covering [startIndex, endIndex), from several threads.
+    //It can be called in a task of the pool, the waiting thread runs other chunks.
+    template <class Body>
+    void ParallelFor(int startIndex, int endIndex, const Body& body, int grainSize = 0)
+    {
+        int indexNum = endIndex - startIndex;
+        if (indexNum <= 0)
+        {
+            return;
+        }
+        int chunkNum = GetParallelChunkNumber(indexNum, grainSize);
+        ThreadPool* pThreadPool = chunkNum > 1 ? GetParallelThreadPool() : NULL;
+        if (pThreadPool == NULL)
+        {
+            body(startIndex, endIndex);
+            return;
+        }
+        WaitGroup group;
+        for (int cid = 0; cid < chunkNum; cid++)
+        {
+            int rangeStart = startIndex + int((long long)indexNum * cid / chunkNum);
+            int rangeEnd = startIndex + int((long long)indexNum * (cid + 1) / chunkNum);
+            pThreadPool->InsertTask(new ParallelForTask<Body>(&body, rangeStart, rangeEnd), &group);
+        }
+        pThreadPool->Wait(group);
+    }
+
+    //body(rangeStart, rangeEnd, value) returns value combined with the range. Chunk results are joined in index
+    //order by join(left, right), so the result only depends on the chunk number, not on the thread timing.
+    template <class T, class Body, class Join>
+    T ParallelReduce(int startIndex, int endIndex, const T& identity, const Body& body, const Join& join, int grainSize = 0)
+    {
+        int indexNum = endIndex - startIndex;
+        if (indexNum <= 0)
+        {
+            return identity;
+        }
+        int chunkNum = GetParallelChunkNumber(indexNum, grainSize);
+        ThreadPool* pThreadPool = chunkNum > 1 ? GetParallelThreadPool() : NULL;
+        if (pThreadPool == NULL)
+        {
+            return body(startIndex, endIndex, identity);
+        }
+        WaitGroup group;
+        std::vector<ParallelReduceTask<T, Body>* > taskList(chunkNum);
+        for (int cid = 0; cid < chunkNum; cid++)
+        {
+            int rangeStart = startIndex + int((long long)indexNum * cid / chunkNum);
+            int rangeEnd = startIndex + int((long long)indexNum * (cid + 1) / chunkNum);
+            taskList.at(cid) = new ParallelReduceTask<T, Body>(&body, rangeStart, rangeEnd, identity);
+            pThreadPool->InsertTask(taskList.at(cid), &group);
+        }
+        pThreadPool->Wait(group);
+        T result = taskList.at(0)->GetResult();
+        delete taskList.at(0);
+        for (int cid = 1; cid < chunkNum; cid++)
+        {
+            result = join(result, taskList.at(cid)->GetResult());
+            delete taskList.at(cid);
+        }
+        return result;
+    }
+}
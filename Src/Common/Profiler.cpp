@@ -0,0 +1,448 @@
+#include "Profiler.h"
+#include "Tool/LogSystem.h"
+#include <stdio.h>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <chrono>
+#include <pthread.h>
+#endif
+
+#ifdef _MSC_VER
+#define MAGIC_THREAD_LOCAL __declspec(thread)
+#else
+#define MAGIC_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+    //Zones per thread buffer, later zones of the thread are dropped until ClearProfile
+    const int ProfileBufferSize = 1 << 18;
+
+#ifdef _WIN32
+    //The steady_clock of VS2012 is the system clock of milliseconds resolution
+    long long QueryProfileCounter()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+    }
+
+    long long QueryProfileFrequency()
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }
+
+    const long long gProfileFrequency = QueryProfileFrequency();
+    const long long gProfileStartCounter = QueryProfileCounter();
+#else
+    const std::chrono::steady_clock::time_point gProfileStartTime = std::chrono::steady_clock::now();
+#endif
+
+    struct ProfileEvent
+    {
+        const char* mpName;
+        long long mStartTime;
+        long long mEndTime;
+        int mDepth;
+    };
+
+    //Zones of one thread. The owning thread pushes, the lock is only contended while the zones are read.
+    class ProfileBuffer
+    {
+    public:
+        ProfileBuffer(int threadId) :
+            mThreadId(threadId),
+            mEventList(),
+            mMutex()
+        {
+        }
+
+        bool Push(const ProfileEvent& event)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (int(mEventList.size()) >= ProfileBufferSize)
+            {
+                return false;
+            }
+            mEventList.push_back(event);
+            return true;
+        }
+
+        void CopyEvents(std::vector<ProfileEvent>& eventList)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            eventList = mEventList;
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mEventList.clear();
+        }
+
+        int GetThreadId() const
+        {
+            return mThreadId;
+        }
+
+    private:
+        int mThreadId;
+        std::vector<ProfileEvent> mEventList;
+        std::mutex mMutex;
+    };
+
+#ifdef _WIN32
+    void WINAPI ReleaseProfileBuffer(void* pBuffer);
+#else
+    void ReleaseProfileBuffer(void* pBuffer);
+#endif
+    std::atomic<bool> gIsProfilerAlive(false);
+
+    class Profiler
+    {
+    public:
+        Profiler() :
+            mBufferList(),
+            mFreeBufferList(),
+            mBufferMutex(),
+            mIsEnabled(false),
+            mDroppedNum(0)
+        {
+            //The thread exit callback returns the buffer of the thread
+#ifdef _WIN32
+            mThreadKey = FlsAlloc(ReleaseProfileBuffer);
+#else
+            pthread_key_create(&mThreadKey, ReleaseProfileBuffer);
+#endif
+            gIsProfilerAlive = true;
+        }
+
+        //A buffer per running thread. The buffer of an ended thread keeps its zones for export and is reused
+        //by the next thread, so the buffer number is bounded by the number of threads running at once.
+        ProfileBuffer* AcquireBuffer()
+        {
+            ProfileBuffer* pBuffer = NULL;
+            {
+                std::lock_guard<std::mutex> lock(mBufferMutex);
+                if (mFreeBufferList.empty())
+                {
+                    pBuffer = new ProfileBuffer(int(mBufferList.size()));
+                    mBufferList.push_back(pBuffer);
+                }
+                else
+                {
+                    pBuffer = mFreeBufferList.back();
+                    mFreeBufferList.pop_back();
+                }
+            }
+#ifdef _WIN32
+            FlsSetValue(mThreadKey, pBuffer);
+#else
+            pthread_setspecific(mThreadKey, pBuffer);
+#endif
+            return pBuffer;
+        }
+
+        void ReleaseBuffer(ProfileBuffer* pBuffer)
+        {
+            std::lock_guard<std::mutex> lock(mBufferMutex);
+            mFreeBufferList.push_back(pBuffer);
+        }
+
+        void Push(ProfileBuffer* pBuffer, const ProfileEvent& event)
+        {
+            if (!pBuffer->Push(event))
+            {
+                mDroppedNum++;
+            }
+        }
+
+        std::vector<ProfileBuffer*> GetBufferList()
+        {
+            std::lock_guard<std::mutex> lock(mBufferMutex);
+            return mBufferList;
+        }
+
+        void Clear()
+        {
+            std::vector<ProfileBuffer*> bufferList = GetBufferList();
+            for (std::vector<ProfileBuffer*>::iterator itr = bufferList.begin(); itr != bufferList.end(); ++itr)
+            {
+                (*itr)->Clear();
+            }
+            mDroppedNum = 0;
+        }
+
+        void SetEnabled(bool enabled)
+        {
+            mIsEnabled = enabled;
+        }
+
+        bool IsEnabled() const
+        {
+            return mIsEnabled.load(std::memory_order_relaxed);
+        }
+
+        int GetDroppedNumber() const
+        {
+            return mDroppedNum.load();
+        }
+
+        ~Profiler()
+        {
+            gIsProfilerAlive = false;
+            for (std::vector<ProfileBuffer*>::iterator itr = mBufferList.begin(); itr != mBufferList.end(); ++itr)
+            {
+                delete (*itr);
+            }
+            mBufferList.clear();
+            mFreeBufferList.clear();
+        }
+
+    private:
+        std::vector<ProfileBuffer*> mBufferList;
+        std::vector<ProfileBuffer*> mFreeBufferList;
+        std::mutex mBufferMutex;
+        std::atomic<bool> mIsEnabled;
+        std::atomic<int> mDroppedNum;
+#ifdef _WIN32
+        DWORD mThreadKey;
+#else
+        pthread_key_t mThreadKey;
+#endif
+    };
+
+    Profiler gProfiler;
+    MAGIC_THREAD_LOCAL ProfileBuffer* tlpProfileBuffer = NULL;
+    MAGIC_THREAD_LOCAL int tlProfileDepth = 0;
+
+    //Threads which end after the profiler is destroyed at exit leave their buffer
+#ifdef _WIN32
+    void WINAPI ReleaseProfileBuffer(void* pBuffer)
+#else
+    void ReleaseProfileBuffer(void* pBuffer)
+#endif
+    {
+        if (pBuffer != NULL && gIsProfilerAlive)
+        {
+            gProfiler.ReleaseBuffer(static_cast<ProfileBuffer*>(pBuffer));
+        }
+    }
+
+    //JSON string content
+    std::string EscapeTraceName(const char* name)
+    {
+        std::string escapedName;
+        for (const char* pChar = name; *pChar != '\0'; pChar++)
+        {
+            if (*pChar == '"' || *pChar == '\\')
+            {
+                escapedName += '\\';
+                escapedName += *pChar;
+            }
+            else if ((unsigned char)(*pChar) < 0x20)
+            {
+                escapedName += ' ';
+            }
+            else
+            {
+                escapedName += *pChar;
+            }
+        }
+        return escapedName;
+    }
+
+    //Trace times are microseconds
+    void WriteTraceTime(FILE* pFile, long long time)
+    {
+        fprintf(pFile, "%lld.%03lld", time / 1000, time % 1000);
+    }
+}
+
+namespace MagicCore
+{
+    long long GetProfileTime()
+    {
+#ifdef _WIN32
+        long long counter = QueryProfileCounter() - gProfileStartCounter;
+        return counter / gProfileFrequency * 1000000000LL + counter % gProfileFrequency * 1000000000LL / gProfileFrequency;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gProfileStartTime).count();
+#endif
+    }
+
+    ProfileZone::ProfileZone(const char* name) :
+        mpName(name),
+        mStartTime(0),
+        mIsRecording(gProfiler.IsEnabled())
+    {
+        if (mIsRecording)
+        {
+            tlProfileDepth++;
+            mStartTime = GetProfileTime();
+        }
+    }
+
+    ProfileZone::~ProfileZone()
+    {
+        if (mIsRecording)
+        {
+            ProfileEvent event;
+            event.mEndTime = GetProfileTime();
+            event.mpName = mpName;
+            event.mStartTime = mStartTime;
+            event.mDepth = --tlProfileDepth;
+            if (tlpProfileBuffer == NULL)
+            {
+                tlpProfileBuffer = gProfiler.AcquireBuffer();
+            }
+            gProfiler.Push(tlpProfileBuffer, event);
+        }
+    }
+
+    void SetProfileEnabled(bool enabled)
+    {
+        gProfiler.SetEnabled(enabled);
+    }
+
+    bool IsProfileEnabled()
+    {
+        return gProfiler.IsEnabled();
+    }
+
+    void ClearProfile()
+    {
+        gProfiler.Clear();
+    }
+
+    void GetProfileStatistics(std::vector<ProfileStatistic>& statList)
+    {
+        std::map<std::string, ProfileStatistic> statMap;
+        std::vector<ProfileBuffer*> bufferList = gProfiler.GetBufferList();
+        std::vector<ProfileEvent> eventList;
+        for (std::vector<ProfileBuffer*>::iterator itr = bufferList.begin(); itr != bufferList.end(); ++itr)
+        {
+            (*itr)->CopyEvents(eventList);
+            //A zone is pushed after its nested zones, childTimeList[depth] sums the closed zones of depth
+            //whose parent is still open
+            std::vector<long long> childTimeList;
+            for (std::vector<ProfileEvent>::iterator eventItr = eventList.begin(); eventItr != eventList.end(); ++eventItr)
+            {
+                int depth = eventItr->mDepth;
+                if (int(childTimeList.size()) < depth + 2)
+                {
+                    childTimeList.resize(depth + 2, 0);
+                }
+                long long time = eventItr->mEndTime - eventItr->mStartTime;
+                long long selfTime = time - childTimeList.at(depth + 1);
+                childTimeList.at(depth + 1) = 0;
+                childTimeList.at(depth) += time;
+
+                std::map<std::string, ProfileStatistic>::iterator statItr = statMap.find(eventItr->mpName);
+                if (statItr == statMap.end())
+                {
+                    ProfileStatistic stat;
+                    stat.mName = eventItr->mpName;
+                    stat.mCount = 1;
+                    stat.mTotalTime = time;
+                    stat.mSelfTime = selfTime;
+                    stat.mMinTime = time;
+                    stat.mMaxTime = time;
+                    statMap[stat.mName] = stat;
+                }
+                else
+                {
+                    ProfileStatistic& stat = statItr->second;
+                    stat.mCount++;
+                    stat.mTotalTime += time;
+                    stat.mSelfTime += selfTime;
+                    stat.mMinTime = time < stat.mMinTime ? time : stat.mMinTime;
+                    stat.mMaxTime = time > stat.mMaxTime ? time : stat.mMaxTime;
+                }
+            }
+        }
+        statList.clear();
+        statList.reserve(statMap.size());
+        for (std::map<std::string, ProfileStatistic>::iterator itr = statMap.begin(); itr != statMap.end(); ++itr)
+        {
+            statList.push_back(itr->second);
+        }
+        std::stable_sort(statList.begin(), statList.end(), [](const ProfileStatistic& stat0, const ProfileStatistic& stat1)
+        {
+            return stat0.mTotalTime > stat1.mTotalTime;
+        });
+    }
+
+    void LogProfileStatistics()
+    {
+        std::vector<ProfileStatistic> statList;
+        GetProfileStatistics(statList);
+        InfoLog << "Profile: zone count total(ms) self(ms) average(ms) min(ms) max(ms)" << std::endl;
+        for (std::vector<ProfileStatistic>::iterator itr = statList.begin(); itr != statList.end(); ++itr)
+        {
+            InfoLog << "    " << itr->mName << " " << itr->mCount << " " << itr->mTotalTime * 1.0e-6 << " "
+                << itr->mSelfTime * 1.0e-6 << " " << itr->mTotalTime * 1.0e-6 / itr->mCount << " "
+                << itr->mMinTime * 1.0e-6 << " " << itr->mMaxTime * 1.0e-6 << std::endl;
+        }
+        int droppedNum = gProfiler.GetDroppedNumber();
+        if (droppedNum > 0)
+        {
+            WarnLog << "Profile: " << droppedNum << " zones dropped" << std::endl;
+        }
+    }
+
+    bool ExportProfileTrace(const std::string& fileName)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "w");
+        if (pFile == NULL)
+        {
+            WarnLog << "ExportProfileTrace: cannot open " << fileName << std::endl;
+            return false;
+        }
+        fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        bool isFirstEvent = true;
+        std::vector<ProfileBuffer*> bufferList = gProfiler.GetBufferList();
+        std::vector<ProfileEvent> eventList;
+        for (std::vector<ProfileBuffer*>::iterator itr = bufferList.begin(); itr != bufferList.end(); ++itr)
+        {
+            (*itr)->CopyEvents(eventList);
+            if (eventList.empty())
+            {
+                continue;
+            }
+            int threadId = (*itr)->GetThreadId();
+            fprintf(pFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}",
+                isFirstEvent ? "" : ",", threadId, threadId);
+            isFirstEvent = false;
+            for (std::vector<ProfileEvent>::iterator eventItr = eventList.begin(); eventItr != eventList.end(); ++eventItr)
+            {
+                fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"MagicWorld\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":",
+                    EscapeTraceName(eventItr->mpName).c_str(), threadId);
+                WriteTraceTime(pFile, eventItr->mStartTime);
+                fprintf(pFile, ",\"dur\":");
+                WriteTraceTime(pFile, eventItr->mEndTime - eventItr->mStartTime);
+                fprintf(pFile, "}");
+            }
+        }
+        fprintf(pFile, "\n]}\n");
+        bool isSucceeded = (ferror(pFile) == 0);
+        fclose(pFile);
+        if (!isSucceeded)
+        {
+            WarnLog << "ExportProfileTrace: write failed " << fileName << std::endl;
+        }
+        return isSucceeded;
+    }
+
+    int GetProfileDroppedNumber()
+    {
+        return gProfiler.GetDroppedNumber();
+    }
+}
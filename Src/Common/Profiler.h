@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//Compile time switch, PROFILE_ZONE is compiled out with MAGIC_PROFILE 0
+#ifndef MAGIC_PROFILE
+#define MAGIC_PROFILE 1
+#endif
+
+namespace MagicCore
+{
+    //Nanoseconds of a monotonic clock since the process start, thread safe
+    long long GetProfileTime();
+
+    //Scoped timing of a block. The zone is recorded to the buffer of the calling thread on destruction,
+    //zones of a thread nest by scope. The name is kept as pointer, use a string literal.
+    class ProfileZone
+    {
+    public:
+        ProfileZone(const char* name);
+        ~ProfileZone();
+
+    private:
+        ProfileZone(const ProfileZone&);
+        ProfileZone& operator = (const ProfileZone&);
+
+    private:
+        const char* mpName;
+        long long mStartTime;
+        bool mIsRecording;
+    };
+
+    //Times in nanoseconds. Self time excludes the nested zones of the same thread.
+    struct ProfileStatistic
+    {
+        std::string mName;
+        int mCount;
+        long long mTotalTime;
+        long long mSelfTime;
+        long long mMinTime;
+        long long mMaxTime;
+    };
+
+    //Zones are recorded while enabled, it is disabled by default
+    void SetProfileEnabled(bool enabled);
+    bool IsProfileEnabled();
+    //Drops the recorded zones of all threads
+    void ClearProfile();
+    //One statistic per zone name over all threads, by total time descending
+    void GetProfileStatistics(std::vector<ProfileStatistic>& statList);
+    //Writes the statistics to InfoLog
+    void LogProfileStatistics();
+    //Chrome trace event JSON, it opens in chrome://tracing and ui.perfetto.dev
+    //Threads are numbered by buffer, the buffer of an ended thread is continued by a later thread
+    bool ExportProfileTrace(const std::string& fileName);
+    //Zones dropped because a thread buffer was full
+    int  GetProfileDroppedNumber();
+}
+
+#define MAGIC_PROFILE_JOIN_NAME(name, line) name##line
+#define MAGIC_PROFILE_ZONE_NAME(name, line) MAGIC_PROFILE_JOIN_NAME(name, line)
+
+//PROFILE_ZONE("ICP::Correspondence"); times the rest of the enclosing block
+#if MAGIC_PROFILE
+#define PROFILE_ZONE(name) MagicCore::ProfileZone MAGIC_PROFILE_ZONE_NAME(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -346,10 +346,9 @@ namespace MagicCore
         int vertNum = pMesh->GetVertexNumber();
         for (int i = 0; i < vertNum; i++)
         {
-            const MagicDGP::Vertex3D* pVert = pMesh->GetVertex(i);
-            MagicMath::Vector3 pos = pVert->GetPosition();
-            MagicMath::Vector3 nor = pVert->GetNormal();
-            MagicMath::Vector3 color = pVert->GetColor();
+            MagicMath::Vector3 pos = pMesh->GetPosition(i);
+            MagicMath::Vector3 nor = pMesh->GetNormal(i);
+            MagicMath::Vector3 color = pMesh->GetColor(i);
             pMObj->position(pos[0], pos[1], pos[2]);
             pMObj->normal(nor[0], nor[1], nor[2]);
             pMObj->colour(color[0], color[1], color[2]);
@@ -388,10 +387,9 @@ namespace MagicCore
         int vertNum = pMesh->GetVertexNumber();
         for (int i = 0; i < vertNum; i++)
         {
-            const MagicDGP::Vertex3D* pVert = pMesh->GetVertex(i);
-            MagicMath::Vector3 pos = pVert->GetPosition();
-            MagicMath::Vector3 nor = pVert->GetNormal();
-            MagicMath::Vector3 texCord = pVert->GetTexCord();
+            MagicMath::Vector3 pos = pMesh->GetPosition(i);
+            MagicMath::Vector3 nor = pMesh->GetNormal(i);
+            MagicMath::Vector3 texCord = pMesh->GetTexCord(i);
             pMObj->position(pos[0], pos[1], pos[2]);
             pMObj->normal(nor[0], nor[1], nor[2]);
             pMObj->textureCoord(texCord[0], texCord[1]);
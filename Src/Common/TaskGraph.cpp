@@ -0,0 +1,285 @@
+#include "TaskGraph.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include "Tool/LogSystem.h"
+
+namespace MagicCore
+{
+    CancelToken::CancelToken() :
+        mIsCancelled(false)
+    {
+    }
+
+    CancelToken::~CancelToken()
+    {
+    }
+
+    void CancelToken::Cancel()
+    {
+        mIsCancelled = true;
+    }
+
+    bool CancelToken::IsCancelled() const
+    {
+        return mIsCancelled.load();
+    }
+
+    void CancelToken::Reset()
+    {
+        mIsCancelled = false;
+    }
+
+    GraphTask::GraphTask(const std::string& name) :
+        mName(name),
+        mDependencyList(),
+        mSuccessorList(),
+        mWaitingCount(0),
+        mState(GTS_Waiting),
+        mProgress(0),
+        mpCancelToken(NULL)
+    {
+    }
+
+    GraphTask::~GraphTask()
+    {
+    }
+
+    void GraphTask::DependOn(GraphTask* pTask)
+    {
+        mDependencyList.push_back(pTask);
+        pTask->mSuccessorList.push_back(this);
+    }
+
+    GraphTaskState GraphTask::GetState() const
+    {
+        return GraphTaskState(mState.load());
+    }
+
+    bool GraphTask::IsFinished() const
+    {
+        return mState.load() >= GTS_Done;
+    }
+
+    const std::string& GraphTask::GetName() const
+    {
+        return mName;
+    }
+
+    double GraphTask::GetProgress() const
+    {
+        return mProgress.load() / 10000.0;
+    }
+
+    void GraphTask::SetProgress(double progress)
+    {
+        progress = progress < 0 ? 0 : (progress > 1 ? 1 : progress);
+        mProgress = int(progress * 10000);
+    }
+
+    bool GraphTask::IsCancelled() const
+    {
+        return mpCancelToken != NULL && mpCancelToken->IsCancelled();
+    }
+
+    const CancelToken* GraphTask::GetCancelToken() const
+    {
+        return mpCancelToken;
+    }
+
+    //Runs one node on a thread of the graph
+    class GraphNodeTask : public ITask
+    {
+    public:
+        GraphNodeTask(TaskGraph* pGraph, GraphTask* pTask) :
+            mpGraph(pGraph),
+            mpTask(pTask)
+        {
+        }
+
+        virtual void Run()
+        {
+            mpGraph->RunNode(mpTask);
+        }
+
+    private:
+        TaskGraph* mpGraph;
+        GraphTask* mpTask;
+    };
+
+    TaskGraph::TaskGraph() :
+        mTaskList(),
+        mCancelToken(),
+        mpThreadPool(NULL),
+        mGroup(),
+        mUnfinishedCount(0),
+        mIsSubmitted(false)
+    {
+    }
+
+    TaskGraph::~TaskGraph()
+    {
+        Cancel();
+        Wait();
+        delete mpThreadPool;
+        mpThreadPool = NULL;
+        for (std::vector<GraphTask*>::iterator itr = mTaskList.begin(); itr != mTaskList.end(); ++itr)
+        {
+            delete (*itr);
+        }
+        mTaskList.clear();
+    }
+
+    GraphTask* TaskGraph::AddTask(GraphTask* pTask)
+    {
+        pTask->mpCancelToken = &mCancelToken;
+        mTaskList.push_back(pTask);
+        return pTask;
+    }
+
+    void TaskGraph::Submit()
+    {
+        if (mIsSubmitted)
+        {
+            WarnLog << "TaskGraph::Submit: graph is submitted already" << std::endl;
+            return;
+        }
+        mIsSubmitted = true;
+        if (mTaskList.empty())
+        {
+            return;
+        }
+        for (std::vector<GraphTask*>::iterator itr = mTaskList.begin(); itr != mTaskList.end(); ++itr)
+        {
+            (*itr)->mWaitingCount = int((*itr)->mDependencyList.size());
+        }
+        int threadNum = GetParallelThreadNumber();
+        if (threadNum > int(mTaskList.size()))
+        {
+            threadNum = int(mTaskList.size());
+        }
+        mpThreadPool = new ThreadPool(threadNum);
+        mUnfinishedCount = int(mTaskList.size());
+        BeginParallelPoolUse();
+        for (std::vector<GraphTask*>::iterator itr = mTaskList.begin(); itr != mTaskList.end(); ++itr)
+        {
+            if ((*itr)->mDependencyList.empty())
+            {
+                InsertNode(*itr);
+            }
+        }
+    }
+
+    void TaskGraph::Cancel()
+    {
+        mCancelToken.Cancel();
+    }
+
+    bool TaskGraph::IsCancelled() const
+    {
+        return mCancelToken.IsCancelled();
+    }
+
+    bool TaskGraph::IsFinished() const
+    {
+        return mIsSubmitted && mGroup.IsDone();
+    }
+
+    bool TaskGraph::IsSucceeded() const
+    {
+        if (!IsFinished())
+        {
+            return false;
+        }
+        for (std::vector<GraphTask*>::const_iterator itr = mTaskList.begin(); itr != mTaskList.end(); ++itr)
+        {
+            if ((*itr)->GetState() != GTS_Done)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void TaskGraph::Wait()
+    {
+        mGroup.Wait();
+    }
+
+    double TaskGraph::GetProgress() const
+    {
+        if (mTaskList.empty())
+        {
+            return 1;
+        }
+        double progress = 0;
+        for (std::vector<GraphTask*>::const_iterator itr = mTaskList.begin(); itr != mTaskList.end(); ++itr)
+        {
+            progress += (*itr)->IsFinished() ? 1 : (*itr)->GetProgress();
+        }
+        return progress / mTaskList.size();
+    }
+
+    int TaskGraph::GetTaskNumber() const
+    {
+        return int(mTaskList.size());
+    }
+
+    GraphTask* TaskGraph::GetTask(int index)
+    {
+        return mTaskList.at(index);
+    }
+
+    void TaskGraph::InsertNode(GraphTask* pTask)
+    {
+        mpThreadPool->InsertTask(new GraphNodeTask(this, pTask), &mGroup);
+    }
+
+    //Successors are inserted before the group counts this node done, so the group is not done in between
+    void TaskGraph::RunNode(GraphTask* pTask)
+    {
+        bool isDependencyDone = true;
+        for (std::vector<GraphTask*>::iterator itr = pTask->mDependencyList.begin(); itr != pTask->mDependencyList.end(); ++itr)
+        {
+            if ((*itr)->GetState() != GTS_Done)
+            {
+                isDependencyDone = false;
+                break;
+            }
+        }
+        if (!isDependencyDone || mCancelToken.IsCancelled())
+        {
+            pTask->mState = GTS_Cancelled;
+        }
+        else
+        {
+            PROFILE_ZONE("TaskGraph::Execute");
+            pTask->mState = GTS_Running;
+            bool isSucceeded = pTask->Execute();
+            if (isSucceeded)
+            {
+                pTask->SetProgress(1);
+                pTask->mState = GTS_Done;
+            }
+            else if (mCancelToken.IsCancelled())
+            {
+                pTask->mState = GTS_Cancelled;
+            }
+            else
+            {
+                WarnLog << "TaskGraph: task failed: " << pTask->GetName() << std::endl;
+                pTask->mState = GTS_Failed;
+            }
+        }
+        for (std::vector<GraphTask*>::iterator itr = pTask->mSuccessorList.begin(); itr != pTask->mSuccessorList.end(); ++itr)
+        {
+            if (--((*itr)->mWaitingCount) == 0)
+            {
+                InsertNode(*itr);
+            }
+        }
+        if (--mUnfinishedCount == 0)
+        {
+            EndParallelPoolUse();
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+#include <atomic>
+
+namespace MagicCore
+{
+    class CancelToken
+    {
+    public:
+        CancelToken();
+        void Cancel();
+        bool IsCancelled() const;
+        void Reset();
+        ~CancelToken();
+
+    private:
+        std::atomic<bool> mIsCancelled;
+    };
+
+    enum GraphTaskState
+    {
+        GTS_Waiting = 0,
+        GTS_Running,
+        GTS_Done,
+        GTS_Failed,
+        GTS_Cancelled
+    };
+
+    class TaskGraph;
+
+    //Node of a TaskGraph. Execute runs on a thread of the graph after all dependencies are done.
+    //Long loops in Execute should check IsCancelled and return false, and report SetProgress.
+    class GraphTask
+    {
+    public:
+        GraphTask(const std::string& name);
+        //Before TaskGraph::Submit
+        void DependOn(GraphTask* pTask);
+        GraphTaskState GetState() const;
+        bool IsFinished() const;
+        const std::string& GetName() const;
+        //0 to 1
+        double GetProgress() const;
+        void SetProgress(double progress);
+        bool IsCancelled() const;
+        //Token of the graph, for long functions called in Execute which check it themselves
+        const CancelToken* GetCancelToken() const;
+        virtual ~GraphTask();
+
+    protected:
+        //false for failure, the tasks depending on this one are cancelled then
+        virtual bool Execute() = 0;
+
+    private:
+        std::string mName;
+        std::vector<GraphTask*> mDependencyList;
+        std::vector<GraphTask*> mSuccessorList;
+        std::atomic<int> mWaitingCount;
+        std::atomic<int> mState;
+        std::atomic<int> mProgress; //per ten thousand
+        const CancelToken* mpCancelToken;
+
+        friend class TaskGraph;
+    };
+
+    //Task with a result, read it after the task is done. A task depending on this one can read it in Execute.
+    template <class T>
+    class ResultGraphTask : public GraphTask
+    {
+    public:
+        ResultGraphTask(const std::string& name) :
+            GraphTask(name),
+            mResult()
+        {
+        }
+
+        const T& GetResult() const
+        {
+            return mResult;
+        }
+
+    protected:
+        T mResult;
+    };
+
+    //func(GraphTask& task, T& result) returns false for failure
+    template <class T, class Func>
+    class FunctionGraphTask : public ResultGraphTask<T>
+    {
+    public:
+        FunctionGraphTask(const std::string& name, const Func& func) :
+            ResultGraphTask<T>(name),
+            mFunc(func)
+        {
+        }
+
+    protected:
+        virtual bool Execute()
+        {
+            return mFunc(*this, this->mResult);
+        }
+
+    private:
+        Func mFunc;
+    };
+
+    //Tasks with dependencies, run on threads of the graph so that the submitting thread is free. The graph has its
+    //own pool of at most GetParallelThreadNumber threads: a thread which waits for a parallel loop never runs
+    //a graph task inline. Parallel loops inside a task use the shared pool, which is kept until the graph is done.
+    //It is polled with IsFinished, for example from AppBase::Update.
+    class TaskGraph
+    {
+    public:
+        TaskGraph();
+        //The graph owns and deletes its tasks
+        GraphTask* AddTask(GraphTask* pTask);
+        template <class T, class Func>
+        ResultGraphTask<T>* AddTask(const std::string& name, const Func& func)
+        {
+            FunctionGraphTask<T, Func>* pTask = new FunctionGraphTask<T, Func>(name, func);
+            AddTask(pTask);
+            return pTask;
+        }
+        //Starts the tasks, a graph is submitted once
+        void Submit();
+        //Waiting tasks are cancelled, running tasks see IsCancelled
+        void Cancel();
+        bool IsCancelled() const;
+        bool IsFinished() const;
+        //All tasks done
+        bool IsSucceeded() const;
+        //Blocks until all tasks are finished, the tasks run on the graph threads only
+        void Wait();
+        //Average progress of all tasks, a finished task counts as 1
+        double GetProgress() const;
+        int GetTaskNumber() const;
+        GraphTask* GetTask(int index);
+        //Cancels and waits for running tasks
+        ~TaskGraph();
+
+    private:
+        TaskGraph(const TaskGraph&);
+        TaskGraph& operator = (const TaskGraph&);
+
+        void InsertNode(GraphTask* pTask);
+        void RunNode(GraphTask* pTask);
+
+        friend class GraphNodeTask;
+
+    private:
+        std::vector<GraphTask*> mTaskList;
+        CancelToken mCancelToken;
+        ThreadPool* mpThreadPool;
+        WaitGroup mGroup;
+        std::atomic<int> mUnfinishedCount; //the graph ends its use of the parallel pool at zero
+        bool mIsSubmitted;
+    };
+}
@@ -1,30 +1,44 @@
 #include "ThreadPool.h"
-#include <process.h>
-#include "Tool/LogSystem.h"
+#include "AsyncLog.h"
+#include <chrono>
+
+#ifdef _MSC_VER
+#define MAGIC_THREAD_LOCAL __declspec(thread)
+#else
+#define MAGIC_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+    //Pool and index of the worker running on this thread
+    MAGIC_THREAD_LOCAL const MagicCore::ThreadPool* tlpWorkerPool = NULL;
+    MAGIC_THREAD_LOCAL int tlWorkerIndex = -1;
+
+    //Sleep of a thread in ThreadPool::Wait before it looks for tasks again
+    const int HelpWaitMicroseconds = 200;
+}
 
 namespace MagicCore
 {
     int GetNumberOfProcessors()
-    { 
-        SYSTEM_INFO sysInfo;
-        GetSystemInfo(&sysInfo);
-        return sysInfo.dwNumberOfProcessors;
+    {
+        int processorNum = std::thread::hardware_concurrency();
+        return processorNum > 0 ? processorNum : 1;
     }
 
     Mutex::Mutex() :
-        mCS()
+        mMutex()
     {
-        InitializeCriticalSection(&mCS);
     }
 
     void Mutex::Lock()
     {
-        EnterCriticalSection(&mCS);
+        mMutex.lock();
     }
 
     void Mutex::Unlock()
     {
-        LeaveCriticalSection(&mCS);
+        mMutex.unlock();
     }
 
     Mutex::~Mutex()
@@ -53,179 +67,300 @@ namespace MagicCore
 
     void ConditionVariable::Sleep(Mutex& mutex)
     {
-        SleepConditionVariableCS(&mCV, &(mutex.mCS), INFINITE);
+        //The mutex is locked by the caller and stays locked after the wait
+        std::unique_lock<std::mutex> lock(mutex.mMutex, std::adopt_lock);
+        mCV.wait(lock);
+        lock.release();
+    }
+
+    void ConditionVariable::SleepFor(Mutex& mutex, int milliseconds)
+    {
+        std::unique_lock<std::mutex> lock(mutex.mMutex, std::adopt_lock);
+        mCV.wait_for(lock, std::chrono::milliseconds(milliseconds));
+        lock.release();
     }
 
     void ConditionVariable::WakeSingle()
     {
-        WakeConditionVariable(&mCV);
+        mCV.notify_one();
     }
 
     void ConditionVariable::WakeAll()
     {
-        WakeAllConditionVariable(&mCV);
+        mCV.notify_all();
     }
 
-    ITask::ITask(TaskType tp) : 
-        mTP(tp)
+    WaitGroup::WaitGroup() :
+        mCount(0),
+        mMutex(),
+        mCV()
     {
     }
 
-    void ITask::Run()
+    WaitGroup::~WaitGroup()
     {
-        DebugLog << "ITask::Run" << std::endl;
     }
 
-    void ITask::OnComplete(void)
+    void WaitGroup::Add(int count)
     {
-        delete this;
+        mCount += count;
     }
 
-    TaskType ITask::GetType() const
+    //Under the lock, so a waiter which saw the count reach zero can destroy the group after taking the lock
+    void WaitGroup::Done()
     {
-        return mTP;
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (--mCount == 0)
+        {
+            mCV.notify_all();
+        }
     }
 
-    ITask::~ITask()
+    bool WaitGroup::IsDone() const
     {
+        return mCount.load() <= 0;
     }
 
-    static unsigned __stdcall RunThread(void *arg)
+    void WaitGroup::Wait()
     {
-        DebugLog << "RunThread" << std::endl;
-        Thread *thread = (Thread *)arg;
-        unsigned result = thread->Run();
-        _endthreadex(0);
-        return result;
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!IsDone())
+        {
+            mCV.wait(lock);
+        }
     }
 
-    Thread::Thread(ThreadPool* pTP) : 
-        mpThreadPool(pTP)
+    bool WaitGroup::WaitFor(int microseconds)
     {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!IsDone())
+        {
+            mCV.wait_for(lock, std::chrono::microseconds(microseconds));
+        }
+        return IsDone();
     }
 
-    void Thread::Start()
+    ITask::ITask(TaskType tp) :
+        mTP(tp)
     {
-        DebugLog << "Start thread...." << std::endl;
-        _beginthreadex(NULL, 0, RunThread, (void *)this, 0, NULL);
-        DebugLog << "Start thread success" << std::endl;
     }
 
-    unsigned Thread::Run()
+    void ITask::Run()
     {
-        DebugLog << "Thread::Run" << std::endl;
-        while (true)
-        {
-            if (mpThreadPool == NULL)
-            {
-                DebugLog << "mpThreadPool == NULL" << std::endl;
-            }
-            ITask* pTask = mpThreadPool->GetTask();
-            if (pTask != NULL)
-            {
-                DebugLog << "Get a valid task" << std::endl;
-                if (pTask->GetType() == TP_Exit)
-                {
-                    pTask->OnComplete();
-                    mpThreadPool->FinishATask();
-                    break;
-                }
-                else if (pTask->GetType() == TP_Normal)
-                {
-                    pTask->Run();
-                    pTask->OnComplete();
-                    mpThreadPool->FinishATask();
-                }
-            }
-            else
-            {
-                DebugLog << "Get an invalid task" << std::endl;
-            }
-        }
-        return 0;
     }
 
-    Thread::~Thread()
+    void ITask::OnComplete(void)
+    {
+        delete this;
+    }
+
+    TaskType ITask::GetType() const
+    {
+        return mTP;
+    }
+
+    ITask::~ITask()
     {
     }
 
     ThreadPool::ThreadPool(int threadCount) :
-        mThreadCount(threadCount),
+        mWorkerList(),
         mThreadList(),
-        mTaskList(),
-        mMutex(),
-        mGetTaskCV(),
-        mFinishTaskCV(),
-        mTaskLeftCount(0)
+        mQueuedCount(0),
+        mPendingCount(0),
+        mSleepingCount(0),
+        mNextWorker(0),
+        mSleepMutex(),
+        mSleepCV(),
+        mDoneMutex(),
+        mDoneCV(),
+        mIsExit(false)
     {
-        for (int tid = 0; tid < mThreadCount; tid++)
+        if (threadCount < 1)
         {
-            Thread* pThread = new Thread(this);
-            pThread->Start();
-            mThreadList.push_back(pThread);
+            threadCount = 1;
+        }
+        for (int wid = 0; wid < threadCount; wid++)
+        {
+            mWorkerList.push_back(new Worker);
+        }
+        for (int wid = 0; wid < threadCount; wid++)
+        {
+            mThreadList.push_back(std::thread(&ThreadPool::WorkerRun, this, wid));
         }
     }
 
     ThreadPool::~ThreadPool()
     {
-        for (int tid = 0; tid < mThreadCount; tid++)
+        WaitUntilAllDone();
         {
-            ITask* pExitTask = new ITask(TP_Exit);
-            InsertTask(pExitTask);
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mIsExit = true;
+            mSleepCV.notify_all();
         }
-        WaitUntilAllDone();
-        for (std::vector<Thread*>::iterator itr = mThreadList.begin(); itr != mThreadList.end(); itr++)
+        for (std::vector<std::thread>::iterator itr = mThreadList.begin(); itr != mThreadList.end(); itr++)
         {
-            if ((*itr) != NULL)
-            {
-                delete (*itr);
-                (*itr) = NULL;
-            }
+            itr->join();
         }
         mThreadList.clear();
+        for (std::vector<Worker*>::iterator itr = mWorkerList.begin(); itr != mWorkerList.end(); itr++)
+        {
+            delete (*itr);
+        }
+        mWorkerList.clear();
     }
 
-    void ThreadPool::InsertTask(ITask* pTask)
+    void ThreadPool::InsertTask(ITask* pTask, WaitGroup* pGroup)
     {
-        ScopedLock scopedLock(mMutex);
-        mTaskList.push_back(pTask);
-        mTaskLeftCount++;
-        mGetTaskCV.WakeSingle();
+        if (pGroup != NULL)
+        {
+            pGroup->Add(1);
+        }
+        TaskEntry entry = {pTask, pGroup};
+        int workerIndex = GetWorkerIndex();
+        if (workerIndex < 0)
+        {
+            workerIndex = mNextWorker++ % mWorkerList.size();
+        }
+        mPendingCount++;
+        {
+            Worker* pWorker = mWorkerList.at(workerIndex);
+            std::lock_guard<std::mutex> lock(pWorker->mMutex);
+            pWorker->mTaskDeque.push_back(entry);
+        }
+        mQueuedCount++;
+        //A worker counts itself sleeping before it checks mQueuedCount, so one of both sees the other
+        if (mSleepingCount.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mSleepCV.notify_one();
+        }
     }
 
-    ITask* ThreadPool::GetTask(void)
+    void ThreadPool::WaitUntilAllDone()
     {
-        ScopedLock scopedLock(mMutex);
-        while (mTaskList.size() == 0)
+        std::unique_lock<std::mutex> lock(mDoneMutex);
+        while (mPendingCount.load() > 0)
         {
-            mGetTaskCV.Sleep(mMutex);
+            mDoneCV.wait(lock);
         }
-        ITask* pTask = mTaskList.front();
-        DebugLog << "ThreadPool::GetTask::Get Front Task" << std::endl;
-        mTaskList.pop_front();
-        return pTask;
     }
 
-    void ThreadPool::FinishATask(void)
+    void ThreadPool::Wait(WaitGroup& group)
     {
-        ScopedLock scopedLock(mMutex);
-        mTaskLeftCount--;
-        mFinishTaskCV.WakeSingle();
+        int workerIndex = GetWorkerIndex();
+        while (!group.IsDone())
+        {
+            TaskEntry entry;
+            if (PopTask(workerIndex, entry))
+            {
+                RunTask(entry);
+            }
+            else
+            {
+                group.WaitFor(HelpWaitMicroseconds);
+            }
+        }
+        //The last Done may still hold the lock
+        std::lock_guard<std::mutex> lock(group.mMutex);
     }
 
-    void ThreadPool::WaitUntilAllDone()
+    int ThreadPool::GetThreadCount() const
     {
+        return mWorkerList.size();
+    }
+
+    int ThreadPool::GetWorkerIndex() const
+    {
+        return tlpWorkerPool == this ? tlWorkerIndex : -1;
+    }
+
+    void ThreadPool::WorkerRun(int workerIndex)
+    {
+        tlpWorkerPool = this;
+        tlWorkerIndex = workerIndex;
         while (true)
         {
-            ScopedLock scopedLock(mMutex);
-            if (mTaskLeftCount > 0)
+            TaskEntry entry;
+            if (PopTask(workerIndex, entry))
             {
-                mFinishTaskCV.Sleep(mMutex);
+                RunTask(entry);
+                continue;
             }
-            else
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleepingCount++;
+            while (mQueuedCount.load() == 0 && !mIsExit)
+            {
+                mSleepCV.wait(lock);
+            }
+            mSleepingCount--;
+            if (mIsExit && mQueuedCount.load() == 0)
             {
                 break;
             }
         }
+        tlpWorkerPool = NULL;
+        tlWorkerIndex = -1;
+        //The log ring of this thread goes to the workers of later pools
+        ReleaseAsyncLogThread();
+    }
+
+    //Own deque from the back, then the other deques from the front. workerIndex < 0 only steals.
+    bool ThreadPool::PopTask(int workerIndex, TaskEntry& entry)
+    {
+        if (mQueuedCount.load() == 0)
+        {
+            return false;
+        }
+        int workerNum = mWorkerList.size();
+        if (workerIndex >= 0)
+        {
+            Worker* pWorker = mWorkerList.at(workerIndex);
+            std::lock_guard<std::mutex> lock(pWorker->mMutex);
+            if (!pWorker->mTaskDeque.empty())
+            {
+                entry = pWorker->mTaskDeque.back();
+                pWorker->mTaskDeque.pop_back();
+                mQueuedCount--;
+                return true;
+            }
+        }
+        int startIndex = workerIndex >= 0 ? workerIndex + 1 : 0;
+        for (int offset = 0; offset < workerNum; offset++)
+        {
+            int victimIndex = (startIndex + offset) % workerNum;
+            if (victimIndex == workerIndex)
+            {
+                continue;
+            }
+            Worker* pVictim = mWorkerList.at(victimIndex);
+            std::lock_guard<std::mutex> lock(pVictim->mMutex);
+            if (!pVictim->mTaskDeque.empty())
+            {
+                entry = pVictim->mTaskDeque.front();
+                pVictim->mTaskDeque.pop_front();
+                mQueuedCount--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::RunTask(TaskEntry& entry)
+    {
+        if (entry.mpTask->GetType() == TP_Normal)
+        {
+            entry.mpTask->Run();
+        }
+        entry.mpTask->OnComplete();
+        if (entry.mpGroup != NULL)
+        {
+            entry.mpGroup->Done();
+        }
+        if (--mPendingCount == 0)
+        {
+            std::lock_guard<std::mutex> lock(mDoneMutex);
+            mDoneCV.notify_all();
+        }
     }
-}
\ No newline at end of file
+}
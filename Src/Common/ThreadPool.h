@@ -1,7 +1,10 @@
 #pragma once
-#include <Windows.h>
 #include <vector>
-#include <list>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 namespace MagicCore
 {
@@ -16,7 +19,7 @@ namespace MagicCore
         ~Mutex();
 
     private:
-        CRITICAL_SECTION mCS;
+        std::mutex mMutex;
 
         friend class ConditionVariable;
     };
@@ -36,12 +39,37 @@ namespace MagicCore
     public:
         ConditionVariable();
         void Sleep(Mutex& mutex);
+        //Sleep which also ends after the time
+        void SleepFor(Mutex& mutex, int milliseconds);
         void WakeSingle();
         void WakeAll();
         ~ ConditionVariable();
 
     private:
-        CONDITION_VARIABLE mCV;
+        std::condition_variable mCV;
+    };
+
+    //Counter of unfinished tasks. ThreadPool::InsertTask adds one for a task of the group and removes it after
+    //OnComplete, so a thread can wait for its own tasks while other tasks share the pool.
+    class WaitGroup
+    {
+    public:
+        WaitGroup();
+        void Add(int count = 1);
+        void Done();
+        bool IsDone() const;
+        void Wait();
+        ~WaitGroup();
+
+    private:
+        bool WaitFor(int microseconds);
+
+    private:
+        std::atomic<int> mCount;
+        std::mutex mMutex;
+        std::condition_variable mCV;
+
+        friend class ThreadPool;
     };
 
     enum TaskType
@@ -63,36 +91,79 @@ namespace MagicCore
         TaskType mTP;
     };
 
-    class ThreadPool;
-    class Thread
+    //Task which keeps its result. It is not deleted on complete, the inserting thread reads the result
+    //after waiting and deletes the task.
+    template <class T>
+    class ResultTask : public ITask
     {
     public:
-        Thread(ThreadPool* pTP);
-        void Start();
-        unsigned Run();
-        ~Thread();
+        ResultTask() :
+            mResult()
+        {
+        }
 
-    private:
-        ThreadPool* mpThreadPool;
+        virtual void OnComplete(void)
+        {
+        }
+
+        const T& GetResult() const
+        {
+            return mResult;
+        }
+
+    protected:
+        T mResult;
     };
 
+    //Every worker owns a task deque. A worker runs its own tasks newest first and steals the oldest task of
+    //another worker when its deque is empty. Tasks inserted by a worker go to its own deque, tasks from other
+    //threads are dealt round robin.
     class ThreadPool
     {
     public:
         ThreadPool(int threadCount);
-        void InsertTask(ITask* pTask);
-        ITask* GetTask(void);
-        void FinishATask(void);
+        //The pool calls pTask->OnComplete after Run, then pGroup->Done
+        void InsertTask(ITask* pTask, WaitGroup* pGroup = NULL);
+        //Not from a task of this pool, use Wait with a WaitGroup there
         void WaitUntilAllDone();
+        //The calling thread runs queued tasks until the group is done, so a task can wait for its sub tasks
+        void Wait(WaitGroup& group);
+        int  GetThreadCount() const;
+        //Index of the calling worker thread in this pool, -1 for other threads
+        int  GetWorkerIndex() const;
         ~ThreadPool();
 
     private:
-        int mThreadCount;
-        std::vector<Thread*> mThreadList;
-        std::list<ITask*> mTaskList;
-        Mutex mMutex;
-        ConditionVariable mGetTaskCV;
-        ConditionVariable mFinishTaskCV;
-        int mTaskLeftCount;
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator = (const ThreadPool&);
+
+        struct TaskEntry
+        {
+            ITask* mpTask;
+            WaitGroup* mpGroup;
+        };
+
+        struct Worker
+        {
+            std::mutex mMutex;
+            std::deque<TaskEntry> mTaskDeque;
+        };
+
+        void WorkerRun(int workerIndex);
+        bool PopTask(int workerIndex, TaskEntry& entry);
+        void RunTask(TaskEntry& entry);
+
+    private:
+        std::vector<Worker*> mWorkerList;
+        std::vector<std::thread> mThreadList;
+        std::atomic<int> mQueuedCount;
+        std::atomic<int> mPendingCount;
+        std::atomic<int> mSleepingCount;
+        std::atomic<unsigned int> mNextWorker;
+        std::mutex mSleepMutex;
+        std::condition_variable mSleepCV;
+        std::mutex mDoneMutex;
+        std::condition_variable mDoneCV;
+        bool mIsExit;
     };
-}
\ No newline at end of file
+}
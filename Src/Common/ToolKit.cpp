@@ -1,6 +1,9 @@
 //#include "StdAfx.h"
 #include "ToolKit.h"
+#include "Profiler.h"
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 namespace MagicCore
 {
@@ -24,23 +27,12 @@ namespace MagicCore
 
     double ToolKit::GetTime()
     {
-        static __int64 start = 0;
-        static __int64 frequency = 0;
-
-        if (start == 0)
-        {
-            QueryPerformanceCounter((LARGE_INTEGER*)&start);
-            QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
-            return 0.0f;
-        }
-
-        __int64 counter = 0;
-        QueryPerformanceCounter((LARGE_INTEGER*)&counter);
-        return (double) ((counter - start) / double(frequency));
+        return GetProfileTime() * 1.0e-9;
     }
 
     bool ToolKit::FileOpenDlg(std::string& selectFileName, char* filterName)
     {
+#ifdef _WIN32
         char szFileName[MAX_PATH] = "";
         OPENFILENAME file = { 0 };
         file.lStructSize = sizeof(file);
@@ -59,10 +51,15 @@ namespace MagicCore
         {
             return false;
         }
+#else
+        //No file dialog without Win32, the headless tools pass file names
+        return false;
+#endif
     }
 
     bool ToolKit::FileSaveDlg(std::string& selectFileName, char* filterName)
     {
+#ifdef _WIN32
         char szFileName[MAX_PATH] = "";
         OPENFILENAME file = { 0 };
         file.lStructSize = sizeof(file);
@@ -81,6 +78,9 @@ namespace MagicCore
         {
             return false;
         }
+#else
+        return false;
+#endif
     }
 
     bool ToolKit::IsAppRunning()
@@ -159,7 +159,9 @@ namespace MagicCore
 
     void ToolKit::OpenWebsite(std::string& address)
     {
+#ifdef _WIN32
         ShellExecute(NULL, "open", address.c_str(), NULL, NULL, SW_SHOW);
+#endif
     }
 
     void ToolKit::SetMousePressLocked(bool locked)
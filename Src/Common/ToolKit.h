@@ -11,7 +11,7 @@ namespace MagicCore
         ToolKit(void);
     public:
         static ToolKit* GetSingleton(void);
-        static double GetTime(void);
+        static double GetTime(void); //seconds, the clock of GetProfileTime
         static bool FileOpenDlg(std::string& selectFileName, char* filterName);
         static bool FileSaveDlg(std::string& selectFileName, char* filterName);
         static MagicMath::Vector3 ColorCoding(float f);
@@ -0,0 +1,398 @@
+#include "BufferedWriter.h"
+#include "Tool/LogSystem.h"
+#include "../Common/ThreadPool.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+    class WriteTask : public MagicCore::ITask
+    {
+    public:
+        WriteTask(FILE* pFile, const char* pData, size_t size, bool* pIsFailed) :
+            mpFile(pFile),
+            mpData(pData),
+            mSize(size),
+            mpIsFailed(pIsFailed)
+        {
+        }
+
+        virtual void Run()
+        {
+            if (fwrite(mpData, 1, mSize, mpFile) != mSize)
+            {
+                *mpIsFailed = true;
+            }
+        }
+
+    private:
+        FILE* mpFile;
+        const char* mpData;
+        size_t mSize;
+        bool* mpIsFailed;
+    };
+}
+
+namespace MagicDGP
+{
+    static const size_t WriteBufferSize = 1 << 22;
+
+    //Powers of ten which are exact in double
+    static const double ExactPowerTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    static const unsigned long long IntPowerTen[] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+        10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL};
+
+    //Scaling in double keeps float precision exact, more digits fall back to sprintf
+    static const int MaxFastDigitNum = 9;
+    //Mantissas below 2^53 compose exactly, longer round trip texts fall back to sprintf with 17 digits
+    static const int MaxRoundTripDigitNum = 15;
+
+    //value > 0, value is about mantissa * 10^exponent and mantissa has digitNum digits.
+    //Returns false if the scale is out of the exact power table.
+    static bool DecomposeReal(double value, int log10Floor, int digitNum, unsigned long long& mantissa, int& exponent)
+    {
+        for (int attempt = 0; attempt < 3; attempt++)
+        {
+            int scale = digitNum - 1 - log10Floor;
+            if (scale > 22 || scale < -22)
+            {
+                return false;
+            }
+            double scaled = (scale >= 0) ? value * ExactPowerTen[scale] : value / ExactPowerTen[-scale];
+            unsigned long long result = (unsigned long long)(scaled + 0.5);
+            if (result >= IntPowerTen[digitNum])
+            {
+                log10Floor++;
+            }
+            else if (result < IntPowerTen[digitNum - 1])
+            {
+                log10Floor--;
+            }
+            else
+            {
+                mantissa = result;
+                exponent = -scale;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //mantissa < 2^53 and |exponent| <= 22, so the result is correctly rounded
+    static double ComposeReal(unsigned long long mantissa, int exponent)
+    {
+        return (exponent >= 0) ? double(mantissa) * ExactPowerTen[exponent] : double(mantissa) / ExactPowerTen[-exponent];
+    }
+
+    BufferedWriter::BufferedWriter() :
+        mpFile(NULL),
+        mBuffer(),
+        mBufferPos(0),
+        mBackBuffer(),
+        mpThreadPool(NULL),
+        mIsFailed(false),
+        mIsBackFailed(false),
+        mPrecision(0)
+    {
+    }
+
+    BufferedWriter::~BufferedWriter()
+    {
+        Close();
+    }
+
+    bool BufferedWriter::Open(const std::string& fileName, bool isBackground)
+    {
+        Close();
+        mpFile = fopen(fileName.c_str(), "wb");
+        if (mpFile == NULL)
+        {
+            ErrorLog << "BufferedWriter::Open: can not open " << fileName.c_str() << std::endl;
+            return false;
+        }
+        mBuffer.resize(WriteBufferSize);
+        mBufferPos = 0;
+        mIsFailed = false;
+        mIsBackFailed = false;
+        if (isBackground)
+        {
+            mBackBuffer.resize(WriteBufferSize);
+            mpThreadPool = new MagicCore::ThreadPool(1);
+        }
+        return true;
+    }
+
+    bool BufferedWriter::Close()
+    {
+        if (mpFile == NULL)
+        {
+            return false;
+        }
+        Flush();
+        if (mpThreadPool != NULL)
+        {
+            mpThreadPool->WaitUntilAllDone();
+            delete mpThreadPool;
+            mpThreadPool = NULL;
+        }
+        if (fclose(mpFile) != 0 || mIsBackFailed)
+        {
+            mIsFailed = true;
+        }
+        mpFile = NULL;
+        std::vector<char>().swap(mBuffer);
+        std::vector<char>().swap(mBackBuffer);
+        mBufferPos = 0;
+        if (mIsFailed)
+        {
+            ErrorLog << "BufferedWriter::Close: write failed" << std::endl;
+        }
+        return !mIsFailed;
+    }
+
+    bool BufferedWriter::IsOpen() const
+    {
+        return mpFile != NULL;
+    }
+
+    void BufferedWriter::SetPrecision(int digitNum)
+    {
+        mPrecision = digitNum;
+    }
+
+    int BufferedWriter::GetPrecision() const
+    {
+        return mPrecision;
+    }
+
+    void BufferedWriter::WriteChar(char c)
+    {
+        if (mpFile == NULL)
+        {
+            return;
+        }
+        if (mBufferPos == mBuffer.size())
+        {
+            Flush();
+        }
+        mBuffer[mBufferPos++] = c;
+    }
+
+    void BufferedWriter::WriteString(const char* pString)
+    {
+        WriteBytes(pString, strlen(pString));
+    }
+
+    void BufferedWriter::WriteInt(int value)
+    {
+        if (mpFile == NULL)
+        {
+            return;
+        }
+        if (mBuffer.size() - mBufferPos < 32)
+        {
+            Flush();
+        }
+        mBufferPos += FormatInt(value, &(mBuffer[mBufferPos]));
+    }
+
+    void BufferedWriter::WriteReal(double value)
+    {
+        if (mpFile == NULL)
+        {
+            return;
+        }
+        if (mBuffer.size() - mBufferPos < 32)
+        {
+            Flush();
+        }
+        mBufferPos += FormatReal(value, mPrecision, &(mBuffer[mBufferPos]));
+    }
+
+    void BufferedWriter::WriteBytes(const void* pData, size_t size)
+    {
+        if (mpFile == NULL)
+        {
+            return;
+        }
+        if (mBuffer.size() - mBufferPos < size)
+        {
+            Flush();
+            if (size > mBuffer.size())
+            {
+                if (mpThreadPool != NULL)
+                {
+                    mpThreadPool->WaitUntilAllDone();
+                }
+                if (fwrite(pData, 1, size, mpFile) != size)
+                {
+                    mIsFailed = true;
+                }
+                return;
+            }
+        }
+        memcpy(&(mBuffer[mBufferPos]), pData, size);
+        mBufferPos += size;
+    }
+
+    void BufferedWriter::Flush()
+    {
+        if (mBufferPos == 0 || mpFile == NULL)
+        {
+            return;
+        }
+        if (mpThreadPool == NULL)
+        {
+            if (fwrite(&(mBuffer[0]), 1, mBufferPos, mpFile) != mBufferPos)
+            {
+                mIsFailed = true;
+            }
+        }
+        else
+        {
+            //the back buffer is free once the last write is done
+            mpThreadPool->WaitUntilAllDone();
+            mBuffer.swap(mBackBuffer);
+            mpThreadPool->InsertTask(new WriteTask(mpFile, &(mBackBuffer[0]), mBufferPos, &mIsBackFailed));
+        }
+        mBufferPos = 0;
+    }
+
+    int BufferedWriter::FormatInt(int value, char* pBuffer)
+    {
+        char digits[16];
+        int digitNum = 0;
+        unsigned int absValue = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+        do
+        {
+            digits[digitNum++] = char('0' + absValue % 10);
+            absValue /= 10;
+        } while (absValue > 0);
+        int length = 0;
+        if (value < 0)
+        {
+            pBuffer[length++] = '-';
+        }
+        while (digitNum > 0)
+        {
+            pBuffer[length++] = digits[--digitNum];
+        }
+        return length;
+    }
+
+    int BufferedWriter::FormatReal(double value, int digitNum, char* pBuffer)
+    {
+        if (value == 0)
+        {
+            pBuffer[0] = '0';
+            return 1;
+        }
+        if (value != value || value - value != 0)
+        {
+            //nan and inf
+            return sprintf(pBuffer, "%g", value);
+        }
+        if (digitNum > MaxFastDigitNum)
+        {
+            return sprintf(pBuffer, "%.*g", digitNum > 17 ? 17 : digitNum, value);
+        }
+        int length = 0;
+        if (value < 0)
+        {
+            pBuffer[length++] = '-';
+            value = -value;
+        }
+        int log10Floor = int(floor(log10(value)));
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        if (digitNum <= 0)
+        {
+            //binary search the fewest digits which read back to the same double
+            int lowDigit = 1;
+            int highDigit = MaxRoundTripDigitNum + 1;
+            while (lowDigit < highDigit)
+            {
+                int midDigit = (lowDigit + highDigit) / 2;
+                if (DecomposeReal(value, log10Floor, midDigit, mantissa, exponent) && ComposeReal(mantissa, exponent) == value)
+                {
+                    highDigit = midDigit;
+                }
+                else
+                {
+                    lowDigit = midDigit + 1;
+                }
+            }
+            if (lowDigit > MaxRoundTripDigitNum)
+            {
+                return length + sprintf(pBuffer + length, "%.17g", value);
+            }
+            digitNum = lowDigit;
+        }
+        if (!DecomposeReal(value, log10Floor, digitNum, mantissa, exponent))
+        {
+            return length + sprintf(pBuffer + length, "%.*g", digitNum, value);
+        }
+        while (mantissa % 10 == 0)
+        {
+            mantissa /= 10;
+            exponent++;
+        }
+        char digits[24];
+        int mantissaLength = 0;
+        while (mantissa > 0)
+        {
+            digits[mantissaLength++] = char('0' + mantissa % 10);
+            mantissa /= 10;
+        }
+        std::reverse(digits, digits + mantissaLength);
+        int pointExponent = exponent + mantissaLength - 1;
+        if (pointExponent >= -4 && pointExponent < MaxFastDigitNum)
+        {
+            if (pointExponent < 0)
+            {
+                pBuffer[length++] = '0';
+                pBuffer[length++] = '.';
+                for (int zid = 0; zid < -pointExponent - 1; zid++)
+                {
+                    pBuffer[length++] = '0';
+                }
+                memcpy(pBuffer + length, digits, mantissaLength);
+                length += mantissaLength;
+            }
+            else if (pointExponent >= mantissaLength - 1)
+            {
+                memcpy(pBuffer + length, digits, mantissaLength);
+                length += mantissaLength;
+                for (int zid = 0; zid < pointExponent - mantissaLength + 1; zid++)
+                {
+                    pBuffer[length++] = '0';
+                }
+            }
+            else
+            {
+                memcpy(pBuffer + length, digits, pointExponent + 1);
+                length += pointExponent + 1;
+                pBuffer[length++] = '.';
+                memcpy(pBuffer + length, digits + pointExponent + 1, mantissaLength - pointExponent - 1);
+                length += mantissaLength - pointExponent - 1;
+            }
+        }
+        else
+        {
+            pBuffer[length++] = digits[0];
+            if (mantissaLength > 1)
+            {
+                pBuffer[length++] = '.';
+                memcpy(pBuffer + length, digits + 1, mantissaLength - 1);
+                length += mantissaLength - 1;
+            }
+            pBuffer[length++] = 'e';
+            length += FormatInt(pointExponent, pBuffer + length);
+        }
+        return length;
+    }
+}
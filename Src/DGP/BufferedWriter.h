@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace MagicCore
+{
+    class ThreadPool;
+}
+
+namespace MagicDGP
+{
+    //File writer with a large user space buffer, numbers are formatted without stdio.
+    //In background mode a full buffer is written by a worker thread while the next one is filled.
+    class BufferedWriter
+    {
+    public:
+        BufferedWriter();
+        ~BufferedWriter();
+
+        bool Open(const std::string& fileName, bool isBackground = false);
+        bool Close(); //false if any write failed
+        bool IsOpen() const;
+        //Significant digits of WriteReal, 0 means the shortest text which reads back to the same double
+        void SetPrecision(int digitNum);
+        int GetPrecision() const;
+
+        void WriteChar(char c);
+        void WriteString(const char* pString);
+        void WriteInt(int value);
+        void WriteReal(double value);
+        void WriteBytes(const void* pData, size_t size);
+
+        //pBuffer should have at least 32 chars, the length is returned
+        static int FormatReal(double value, int digitNum, char* pBuffer);
+        static int FormatInt(int value, char* pBuffer);
+
+    private:
+        BufferedWriter(const BufferedWriter&);
+        BufferedWriter& operator = (const BufferedWriter&);
+        void Flush();
+
+    private:
+        FILE* mpFile;
+        std::vector<char> mBuffer;
+        size_t mBufferPos;
+        std::vector<char> mBackBuffer;
+        MagicCore::ThreadPool* mpThreadPool;
+        bool mIsFailed;
+        bool mIsBackFailed;
+        int mPrecision;
+    };
+}
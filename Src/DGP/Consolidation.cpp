@@ -1,9 +1,21 @@
 #include "Consolidation.h"
-#include "flann/flann.h"
+#include "SpatialIndex.h"
 #include "Eigen/Eigenvalues"
 #include "Eigen/Sparse"
 #include "Eigen/SparseLU"
 #include "Tool/LogSystem.h"
+#include "../Common/AsyncLog.h"
+#include "../Common/Parallel.h"
+#include "../Common/Profiler.h"
+#include <set>
+
+namespace
+{
+    //One per degenerate point neighborhood
+    MagicCore::AsyncLogSite gSmallNormalLogSite(10, 10000);
+    //One per boundary edge of the smoothed mesh
+    MagicCore::AsyncLogSite gBoundaryEdgeLogSite(10, 10000);
+}
 
 namespace MagicDGP
 {
@@ -17,77 +29,57 @@ namespace MagicDGP
 
     void Consolidation::CalPointSetNormal(Point3DSet* pPointSet)
     {
+        PROFILE_ZONE("Consolidation::CalPointSetNormal");
         int pointNum = pPointSet->GetPointNumber();
         std::vector<MagicMath::Vector3> norList(pointNum);
 
-        int dim = 3;
-        int refNum = pointNum;
-        float* dataSet = new float[refNum * dim];
-        int searchNum = pointNum;
-        float* searchSet = new float[searchNum * dim];
-        for (int pid = 0; pid < pointNum; pid++)
-        {
-            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
-            dataSet[dim * pid + 0] = pos[0];
-            dataSet[dim * pid + 1] = pos[1];
-            dataSet[dim * pid + 2] = pos[2];
-            searchSet[dim * pid + 0] = pos[0];
-            searchSet[dim * pid + 1] = pos[1];
-            searchSet[dim * pid + 2] = pos[2];
-        }
         int nn = 20;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
+        std::vector<int> indexList;
+        std::vector<float> distList;
+        pPointSet->GetSpatialIndex()->KnnSearchSelf(nn, indexList, distList);
+        const int* pIndex = indexList.empty() ? NULL : &(indexList[0]);
 
-        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> es;
-        for (int pid = 0; pid < pointNum; pid++)
+        //PCA of every point is independent, the eigen solver is per chunk
+        int smallNormalNum = MagicCore::ParallelReduce(0, pointNum, 0, [&](int startIndex, int endIndex, int smallNum) -> int
         {
-            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
-            MagicMath::Vector3 deltaPos[20]; //nn
-            int baseIndex = pid * nn;
-            for (int j = 0; j < nn; j++)
-            {
-                deltaPos[j] = pPointSet->GetPoint(pIndex[baseIndex + j])->GetPosition() - pos;
-            }
-            Eigen::Matrix3d mat;
-            for (int xx = 0; xx < 3; xx++)
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> es;
+            for (int pid = startIndex; pid < endIndex; pid++)
             {
-                for (int yy = 0; yy < 3; yy++)
+                MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+                MagicMath::Vector3 deltaPos[20]; //nn
+                int baseIndex = pid * nn;
+                for (int j = 0; j < nn; j++)
                 {
-                    double v = 0;
-                    for (int kk = 0; kk < nn; kk++)
+                    deltaPos[j] = pPointSet->GetPoint(pIndex[baseIndex + j])->GetPosition() - pos;
+                }
+                Eigen::Matrix3d mat;
+                for (int xx = 0; xx < 3; xx++)
+                {
+                    for (int yy = 0; yy < 3; yy++)
                     {
-                        v += deltaPos[kk][xx] * deltaPos[kk][yy];
+                        double v = 0;
+                        for (int kk = 0; kk < nn; kk++)
+                        {
+                            v += deltaPos[kk][xx] * deltaPos[kk][yy];
+                        }
+                        mat(xx, yy) = v;
                     }
-                    mat(xx, yy) = v;
+                }//end for xx
+                es.compute(mat);
+                Eigen::Vector3d norvec = es.eigenvectors().col(0);
+                MagicMath::Vector3 nor(norvec(0), norvec(1), norvec(2));
+                double norLen = nor.Normalise();
+                if (norLen < 1.0e-15)
+                {
+                    smallNum++;
                 }
-            }//end for xx
-            es.compute(mat);
-            Eigen::Vector3d norvec = es.eigenvectors().col(0);
-            MagicMath::Vector3 nor(norvec(0), norvec(1), norvec(2));
-            double norLen = nor.Normalise();
-            if (norLen < 1.0e-15)
-            {
-                DebugLog << "Error: small normal length" << std::endl;
+                norList.at(pid) = nor;
             }
-            norList.at(pid) = nor;
-        }
-        if (pDist != NULL)
+            return smallNum;
+        }, [](int leftNum, int rightNum) -> int { return leftNum + rightNum; });
+        if (smallNormalNum > 0)
         {
-            delete []pDist;
-            pDist = NULL;
+            DebugLog << "Error: small normal length: " << smallNormalNum << " points" << std::endl;
         }
         //Make normal consitent
         std::multimap<double, int> prioritySet;
@@ -161,16 +153,12 @@ namespace MagicDGP
             pPointSet->GetPoint(pid)->SetNormal(norList.at(pid));
         }
         //
-        if (pIndex != NULL)
-        {
-            delete []pIndex;
-            pIndex = NULL;
-        }
         pPointSet->SetHasNormal(true);
     }
 
     bool Consolidation::RedressPointSetNormal(Point3DSet* pPointSet)
     {
+        PROFILE_ZONE("Consolidation::RedressPointSetNormal");
         if (pPointSet->HasNormal() == false)
         {
             WarnLog << "Consolidation::RedressPointSetNormal need point set normal, but this one has no normal" << std::endl;
@@ -178,36 +166,11 @@ namespace MagicDGP
         }
 
         int pointNum = pPointSet->GetPointNumber();
-        int dim = 3;
-        int refNum = pointNum;
-        float* dataSet = new float[refNum * dim];
-        int searchNum = pointNum;
-        float* searchSet = new float[searchNum * dim];
-        for (int pid = 0; pid < pointNum; pid++)
-        {
-            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
-            dataSet[dim * pid + 0] = pos[0];
-            dataSet[dim * pid + 1] = pos[1];
-            dataSet[dim * pid + 2] = pos[2];
-            searchSet[dim * pid + 0] = pos[0];
-            searchSet[dim * pid + 1] = pos[1];
-            searchSet[dim * pid + 2] = pos[2];
-        }
         int nn = 20;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
+        std::vector<int> indexList;
+        std::vector<float> distList;
+        pPointSet->GetSpatialIndex()->KnnSearchSelf(nn, indexList, distList);
+        const int* pIndex = indexList.empty() ? NULL : &(indexList[0]);
 
         Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> es;
         for (int pid = 0; pid < pointNum; pid++)
@@ -239,7 +202,7 @@ namespace MagicDGP
             double norLen = nor.Normalise();
             if (norLen < 1.0e-15)
             {
-                DebugLog << "Error: small normal length" << std::endl;
+                AsyncDebugLogSite(gSmallNormalLogSite) << "Error: small normal length" << std::endl;
             }
             if (nor * (pPoint->GetNormal()) < 0)
             {
@@ -247,16 +210,6 @@ namespace MagicDGP
             }
             pPoint->SetNormal(nor);
         }
-        if (pDist != NULL)
-        {
-            delete []pDist;
-            pDist = NULL;
-        }
-        if (pIndex != NULL)
-        {
-            delete []pIndex;
-            pIndex = NULL;
-        }
         return true;
     }
 
@@ -384,6 +337,7 @@ namespace MagicDGP
 
     Mesh3D* Consolidation::RemoveSmallMeshPatch(Mesh3D* pMesh, double proportion)
     {
+        PROFILE_ZONE("Consolidation::RemoveSmallMeshPatch");
         DebugLog << "Consolidation::RemoveSmallMeshPatch" << std::endl;
         int vertNum = pMesh->GetVertexNumber();
         int smallNum = vertNum * proportion;
@@ -519,6 +473,7 @@ namespace MagicDGP
 
     LightMesh3D* Consolidation::RemoveSmallMeshPatch(LightMesh3D* pMesh, double proportion)
     {
+        PROFILE_ZONE("Consolidation::RemoveSmallMeshPatch");
         int vertNum = pMesh->GetVertexNumber();
         int smallNum = vertNum * proportion;
         if (smallNum < 10)
@@ -596,7 +551,7 @@ namespace MagicDGP
                 for (int j = 0; j < oneGroupNum; j++)
                 {
                     int vertIndex = vertGroups.at(i).at(j);
-                    pNewMesh->InsertVertex(pMesh->GetVertex(vertIndex)->GetPosition());
+                    pNewMesh->InsertVertex(pMesh->GetPosition(vertIndex));
                     vertMapOld2New[vertIndex] = newMeshVertIndex;
                     newMeshVertIndex++;
                     vertValidFlag.at(vertIndex) = 1;
@@ -631,37 +586,13 @@ namespace MagicDGP
 
     Point3DSet* Consolidation::RemovePointSetOutlier(Point3DSet* pPS, double proportion)
     {
-        int dim = 3;
+        PROFILE_ZONE("Consolidation::RemovePointSetOutlier");
         int pointNum = pPS->GetPointNumber();
-        int refNum = pointNum;
-        float* dataSet = new float[refNum * dim];
-        int searchNum = pointNum;
-        float* searchSet = new float[searchNum * dim];
-        for (int i = 0; i < pointNum; i++)
-        {
-            MagicMath::Vector3 pos = pPS->GetPoint(i)->GetPosition();
-            dataSet[dim * i + 0] = pos[0];
-            dataSet[dim * i + 1] = pos[1];
-            dataSet[dim * i + 2] = pos[2];
-            searchSet[dim * i + 0] = pos[0];
-            searchSet[dim * i + 1] = pos[1];
-            searchSet[dim * i + 2] = pos[2];
-        }
         int nn = 15;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
+        std::vector<int> indexList;
+        std::vector<float> distList;
+        pPS->GetSpatialIndex()->KnnSearchSelf(nn, indexList, distList);
+        const int* pIndex = indexList.empty() ? NULL : &(indexList[0]);
         std::map<float, int> densityMap;
         for (int i = 0; i < pointNum; i++)
         {
@@ -677,16 +608,6 @@ namespace MagicDGP
             }
             densityMap[density] = i;
         }
-        if (pIndex != NULL)
-        {
-            delete []pIndex;
-            pIndex = NULL;
-        }
-        if (pDist != NULL)
-        {
-            delete []pDist;
-            pDist = NULL;
-        }
 
         int invalidNum = pointNum * proportion;
         int invalidIndex = 0;
@@ -708,8 +629,7 @@ namespace MagicDGP
                 continue;
             }
             MagicDGP::Point3D* pPoint = pPS->GetPoint(i);
-            MagicDGP::Point3D* pNewPoint = new MagicDGP::Point3D(pPoint->GetPosition(), pPoint->GetNormal());
-            pNewPS->InsertPoint(pNewPoint);
+            pNewPS->InsertPoint(pPoint->GetPosition(), pPoint->GetNormal());
         }
 
         return pNewPS;
@@ -792,10 +712,10 @@ namespace MagicDGP
             MagicMath::Vector3 avgPos(0, 0, 0);
             for (std::set<int>::iterator nItr = neighbors.begin(); nItr != neighbors.end(); ++nItr)
             {
-                avgPos += pMesh->GetVertex(*nItr)->GetPosition();
+                avgPos += pMesh->GetPosition(*nItr);
             }
             avgPos /= neighFaceNum.at(vid);
-            smoothPos.at(vid) = avgPos * smoothWeight + pMesh->GetVertex(vid)->GetPosition() * (1 - smoothWeight);
+            smoothPos.at(vid) = avgPos * smoothWeight + pMesh->GetPosition(vid) * (1 - smoothWeight);
         }
         for (int vid = 0; vid < vertNum; vid++)
         {
@@ -803,13 +723,14 @@ namespace MagicDGP
             {
                 continue;
             }
-            pMesh->GetVertex(vid)->SetPosition(smoothPos.at(vid));
+            pMesh->SetPosition(vid, smoothPos.at(vid));
         }
         pMesh->UpdateNormal();
     }
 
     void Consolidation::MeanCurvatureFlowFairing(Mesh3D* pMesh)
     {
+        PROFILE_ZONE("Consolidation::MeanCurvatureFlowFairing");
         pMesh->UpdateBoundaryFlag();
         pMesh->CalculateFaceArea();
         int vertNum = pMesh->GetVertexNumber();
@@ -857,11 +778,11 @@ namespace MagicDGP
                     double sinV, cosV;
                     if (pEdge->GetFace() == NULL)
                     {
-                        DebugLog << "pEdge->GetFace() == NULL" << std::endl;
+                        AsyncDebugLogSite(gBoundaryEdgeLogSite) << "pEdge->GetFace() == NULL" << std::endl;
                     }
                     if (pEdge->GetPair()->GetFace() == NULL)
                     {
-                        DebugLog << "pEdge->GetPair()->GetFace() == NULL" << std::endl;
+                        AsyncDebugLogSite(gBoundaryEdgeLogSite) << "pEdge->GetPair()->GetFace() == NULL" << std::endl;
                     }
                     MagicMath::Vector3 dir0 = pEdge->GetVertex()->GetPosition() - pEdge->GetNext()->GetVertex()->GetPosition();
                     dir0.Normalise();
@@ -919,39 +840,15 @@ namespace MagicDGP
 
     void Consolidation::SimplePointsetSmooth(Point3DSet* pPS, std::vector<std::vector<int> >& RiemannianGraph, bool needConstructGraph)
     {
+        PROFILE_ZONE("Consolidation::SimplePointsetSmooth");
         int pointNum = pPS->GetPointNumber();
         if (needConstructGraph)
         {
-            int dim = 3;
-            int refNum = pointNum;
-            float* dataSet = new float[refNum * dim];
-            int searchNum = pointNum;
-            float* searchSet = new float[searchNum * dim];
-            for (int pid = 0; pid < pointNum; pid++)
-            {
-                MagicMath::Vector3 pos = pPS->GetPoint(pid)->GetPosition();
-                dataSet[dim * pid + 0] = pos[0];
-                dataSet[dim * pid + 1] = pos[1];
-                dataSet[dim * pid + 2] = pos[2];
-                searchSet[dim * pid + 0] = pos[0];
-                searchSet[dim * pid + 1] = pos[1];
-                searchSet[dim * pid + 2] = pos[2];
-            }
             int nn = 20;
-            int* pIndex = new int[searchNum * nn];
-            float* pDist = new float[searchNum * nn];
-            FLANNParameters searchPara;
-            searchPara = DEFAULT_FLANN_PARAMETERS;
-            searchPara.algorithm = FLANN_INDEX_KDTREE;
-            searchPara.trees = 8;
-            searchPara.log_level = FLANN_LOG_INFO;
-            searchPara.checks = 64;
-            float speedup;
-            flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-            flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-            flann_free_index(indexId, &searchPara);
-            delete []dataSet;
-            delete []searchSet;
+            std::vector<int> indexList;
+            std::vector<float> distList;
+            pPS->GetSpatialIndex()->KnnSearchSelf(nn, indexList, distList);
+            const int* pIndex = indexList.empty() ? NULL : &(indexList[0]);
 
             RiemannianGraph.clear();
             RiemannianGraph.resize(pointNum);
@@ -966,16 +863,6 @@ namespace MagicDGP
                 RiemannianGraph.at(pid) = neighbors;
             }
 
-            if (pDist != NULL)
-            {
-                delete []pDist;
-                pDist = NULL;
-            }
-            if (pIndex != NULL)
-            {
-                delete []pIndex;
-                pIndex = NULL;
-            }
         }
 
         double smoothWeight = 0.75;
@@ -0,0 +1,347 @@
+#include "DepthFramePipeline.h"
+#include "Parser.h"
+#include "Tool/LogSystem.h"
+#include "../Common/Parallel.h"
+#include "../Common/ToolKit.h"
+#include <math.h>
+#include <list>
+#include <map>
+#include <sstream>
+#include <algorithm>
+
+namespace
+{
+    //Neighbors further than this in depth are on the other side of a depth edge
+    const double SmoothDepthThreshold = 100;
+    const double ZeroLength = 1.0e-15;
+
+    bool IsInRange(const MagicMath::Vector3& pos, const MagicDGP::DepthRangeLimit& range)
+    {
+        return !(pos[0] < range.mLeft || pos[0] > range.mRight ||
+            pos[1] < range.mDown || pos[1] > range.mTop ||
+            pos[2] > range.mFront || pos[2] < range.mBack);
+    }
+
+    //Average with the 4 neighbors, a pixel next to a depth edge is dropped
+    MagicMath::Vector3 SmoothPixel(const std::vector<MagicMath::Vector3>& posList, int resolutionX, int index)
+    {
+        const MagicMath::Vector3& pos = posList[index];
+        int neighborIndex[4] = {index - 1, index + 1, index - resolutionX, index + resolutionX};
+        MagicMath::Vector3 avgPos(0, 0, 0);
+        int neighborNum = 0;
+        for (int nid = 0; nid < 4; nid++)
+        {
+            const MagicMath::Vector3& neighborPos = posList[neighborIndex[nid]];
+            if (neighborPos.Length() > ZeroLength)
+            {
+                if (fabs(pos[2] - neighborPos[2]) < SmoothDepthThreshold)
+                {
+                    avgPos += neighborPos;
+                    neighborNum++;
+                }
+                else
+                {
+                    return MagicMath::Vector3(0, 0, 0);
+                }
+            }
+        }
+        if (neighborNum == 0)
+        {
+            return pos;
+        }
+        avgPos /= neighborNum;
+        return (pos + avgPos) / 2;
+    }
+
+    struct FrameResult
+    {
+        int mFrameId;
+        MagicDGP::Point3DSet* mpPointSet;
+    };
+
+    //State shared by the stages, queues are bounded by mQueueSize
+    struct PipelineState
+    {
+        MagicDGP::DepthFrameSource* mpSource;
+        MagicDGP::DepthRangeLimit mRange;
+        std::string mFilePrefix;
+        std::string mExtension;
+        int mQueueSize;
+        MagicCore::Mutex mMutex;
+        MagicCore::ConditionVariable mFrameCV;
+        MagicCore::ConditionVariable mResultCV;
+        std::list<std::pair<int, MagicDGP::DepthFrame*> > mFrameQueue; //sequence index, frame
+        std::map<int, FrameResult> mResultMap; //sequence index, result
+        int mDecodeNumber;
+        bool mIsDecodeDone;
+        int mNextWrite;
+        int mExportNumber;
+    };
+
+    class DecodeTask : public MagicCore::ITask
+    {
+    public:
+        DecodeTask(PipelineState* pState) :
+            mpState(pState)
+        {
+        }
+
+        virtual void Run()
+        {
+            PipelineState& state = *mpState;
+            while (true)
+            {
+                MagicDGP::DepthFrame* pFrame = new MagicDGP::DepthFrame;
+                if (!state.mpSource->ReadFrame(*pFrame))
+                {
+                    delete pFrame;
+                    break;
+                }
+                MagicCore::ScopedLock scopedLock(state.mMutex);
+                while (int(state.mFrameQueue.size()) >= state.mQueueSize)
+                {
+                    state.mFrameCV.Sleep(state.mMutex);
+                }
+                state.mFrameQueue.push_back(std::make_pair(state.mDecodeNumber, pFrame));
+                state.mDecodeNumber++;
+                state.mFrameCV.WakeAll();
+            }
+            MagicCore::ScopedLock scopedLock(state.mMutex);
+            state.mIsDecodeDone = true;
+            state.mFrameCV.WakeAll();
+            state.mResultCV.WakeAll();
+        }
+
+    private:
+        PipelineState* mpState;
+    };
+
+    class ConvertTask : public MagicCore::ITask
+    {
+    public:
+        ConvertTask(PipelineState* pState, double xzFactor, double yzFactor) :
+            mpState(pState),
+            mXZFactor(xzFactor),
+            mYZFactor(yzFactor)
+        {
+        }
+
+        virtual void Run()
+        {
+            PipelineState& state = *mpState;
+            while (true)
+            {
+                std::pair<int, MagicDGP::DepthFrame*> frame;
+                {
+                    MagicCore::ScopedLock scopedLock(state.mMutex);
+                    while (state.mFrameQueue.empty() && !state.mIsDecodeDone)
+                    {
+                        state.mFrameCV.Sleep(state.mMutex);
+                    }
+                    if (state.mFrameQueue.empty())
+                    {
+                        break;
+                    }
+                    frame = state.mFrameQueue.front();
+                    state.mFrameQueue.pop_front();
+                    state.mFrameCV.WakeAll();
+                }
+                FrameResult result;
+                result.mFrameId = frame.second->mFrameId;
+                result.mpPointSet = MagicDGP::DepthFrameConverter::ToPointSet(*(frame.second), mXZFactor, mYZFactor, state.mRange);
+                delete frame.second;
+                MagicCore::ScopedLock scopedLock(state.mMutex);
+                //Wait for the writer, so a slow disk bounds the finished frames too
+                while (frame.first >= state.mNextWrite + state.mQueueSize)
+                {
+                    state.mResultCV.Sleep(state.mMutex);
+                }
+                state.mResultMap[frame.first] = result;
+                state.mResultCV.WakeAll();
+            }
+        }
+
+    private:
+        PipelineState* mpState;
+        double mXZFactor;
+        double mYZFactor;
+    };
+
+    class WriteTask : public MagicCore::ITask
+    {
+    public:
+        WriteTask(PipelineState* pState) :
+            mpState(pState)
+        {
+        }
+
+        virtual void Run()
+        {
+            PipelineState& state = *mpState;
+            while (true)
+            {
+                FrameResult result;
+                {
+                    MagicCore::ScopedLock scopedLock(state.mMutex);
+                    std::map<int, FrameResult>::iterator itr = state.mResultMap.find(state.mNextWrite);
+                    while (itr == state.mResultMap.end() && !(state.mIsDecodeDone && state.mNextWrite == state.mDecodeNumber))
+                    {
+                        state.mResultCV.Sleep(state.mMutex);
+                        itr = state.mResultMap.find(state.mNextWrite);
+                    }
+                    if (itr == state.mResultMap.end())
+                    {
+                        break;
+                    }
+                    result = itr->second;
+                    state.mResultMap.erase(itr);
+                }
+                if (result.mpPointSet != NULL)
+                {
+                    std::stringstream ss;
+                    ss << state.mFilePrefix << result.mFrameId << "." << state.mExtension;
+                    MagicDGP::Parser::ExportPointSet(ss.str(), result.mpPointSet);
+                    delete result.mpPointSet;
+                }
+                MagicCore::ScopedLock scopedLock(state.mMutex);
+                if (result.mpPointSet != NULL)
+                {
+                    state.mExportNumber++;
+                }
+                state.mNextWrite++;
+                state.mResultCV.WakeAll();
+            }
+        }
+
+    private:
+        PipelineState* mpState;
+    };
+}
+
+namespace MagicDGP
+{
+    DepthRangeLimit::DepthRangeLimit() :
+        mLeft(-1000.f),
+        mRight(1000.f),
+        mTop(1000.f),
+        mDown(-1000.f),
+        mFront(-200.f),
+        mBack(-2200.f)
+    {
+    }
+
+    Point3DSet* DepthFrameConverter::ToPointSet(const DepthFrame& frame, double xzFactor, double yzFactor, const DepthRangeLimit& range)
+    {
+        int resolutionX = frame.mResolutionX;
+        int resolutionY = frame.mResolutionY;
+        int pixelNum = resolutionX * resolutionY;
+        if (resolutionX < 1 || resolutionY < 1 || int(frame.mDepthList.size()) != pixelNum)
+        {
+            return NULL;
+        }
+        //Back projection as openni::CoordinateConverter::convertDepthToWorld, x and z are flipped
+        std::vector<MagicMath::Vector3> posList(pixelNum);
+        for (int y = 0; y < resolutionY; y++)
+        {
+            double normalizedY = 0.5 - double(y) / resolutionY;
+            for (int x = 0; x < resolutionX; x++)
+            {
+                double depth = frame.mDepthList[y * resolutionX + x];
+                double normalizedX = double(x) / resolutionX - 0.5;
+                posList[y * resolutionX + x] = MagicMath::Vector3(-normalizedX * depth * xzFactor, normalizedY * depth * yzFactor, -depth);
+            }
+        }
+        //Smooth
+        std::vector<MagicMath::Vector3> smoothPosList(posList);
+        for (int y = 1; y < resolutionY - 1; y++)
+        {
+            for (int x = 1; x < resolutionX - 1; x++)
+            {
+                int index = y * resolutionX + x;
+                const MagicMath::Vector3& pos = posList[index];
+                if (IsInRange(pos, range) && pos.Length() > ZeroLength)
+                {
+                    smoothPosList[index] = SmoothPixel(posList, resolutionX, index);
+                }
+            }
+        }
+        posList.swap(smoothPosList);
+        //Normal
+        std::vector<MagicMath::Vector3> norList(pixelNum, MagicMath::Vector3(0, 0, 1));
+        for (int y = 1; y < resolutionY - 1; y++)
+        {
+            for (int x = 1; x < resolutionX - 1; x++)
+            {
+                int index = y * resolutionX + x;
+                if (!IsInRange(posList[index], range))
+                {
+                    continue;
+                }
+                MagicMath::Vector3 dirX = posList[index + 1] - posList[index - 1];
+                MagicMath::Vector3 dirY = posList[index + resolutionX] - posList[index - resolutionX];
+                MagicMath::Vector3 nor = dirX.CrossProduct(dirY);
+                if (nor.Normalise() > ZeroLength)
+                {
+                    norList[index] = nor;
+                }
+            }
+        }
+        Point3DSet* pPointSet = new Point3DSet;
+        for (int pid = 0; pid < pixelNum; pid++)
+        {
+            if (IsInRange(posList[pid], range))
+            {
+                pPointSet->InsertPoint(posList[pid], norList[pid]);
+            }
+        }
+        pPointSet->SetHasNormal(true);
+        return pPointSet;
+    }
+
+    DepthFramePipeline::DepthFramePipeline(int workerNum, int queueSize) :
+        mWorkerNumber(workerNum),
+        mQueueSize(queueSize)
+    {
+        if (mWorkerNumber < 1)
+        {
+            mWorkerNumber = MagicCore::GetParallelThreadNumber();
+        }
+        if (mQueueSize < 1)
+        {
+            mQueueSize = mWorkerNumber * 2;
+        }
+    }
+
+    int DepthFramePipeline::Run(DepthFrameSource* pSource, const DepthRangeLimit& range, const std::string& filePrefix, const std::string& extension)
+    {
+        if (pSource == NULL)
+        {
+            return 0;
+        }
+        double timeStart = MagicCore::ToolKit::GetTime();
+        PipelineState state;
+        state.mpSource = pSource;
+        state.mRange = range;
+        state.mFilePrefix = filePrefix;
+        state.mExtension = extension;
+        state.mQueueSize = mQueueSize;
+        state.mDecodeNumber = 0;
+        state.mIsDecodeDone = false;
+        state.mNextWrite = 0;
+        state.mExportNumber = 0;
+        {
+            //One thread per stage task, the decode and write threads mostly wait for io
+            MagicCore::ThreadPool threadPool(mWorkerNumber + 2);
+            threadPool.InsertTask(new DecodeTask(&state));
+            for (int wid = 0; wid < mWorkerNumber; wid++)
+            {
+                threadPool.InsertTask(new ConvertTask(&state, pSource->GetXZFactor(), pSource->GetYZFactor()));
+            }
+            threadPool.InsertTask(new WriteTask(&state));
+            threadPool.WaitUntilAllDone();
+        }
+        InfoLog << "DepthFramePipeline::Run: " << state.mExportNumber << " of " << state.mDecodeNumber << " frames exported, time: "
+            << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return state.mExportNumber;
+    }
+}
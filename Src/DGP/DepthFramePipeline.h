@@ -0,0 +1,60 @@
+#pragma once
+#include "PointCloud3D.h"
+#include <vector>
+#include <string>
+
+namespace MagicDGP
+{
+    //Raw depth image in millimeters, 0 means no depth
+    struct DepthFrame
+    {
+        int mFrameId;
+        int mResolutionX;
+        int mResolutionY;
+        std::vector<unsigned short> mDepthList;
+    };
+
+    //Box in the scanner coordinate, points outside are removed
+    struct DepthRangeLimit
+    {
+        DepthRangeLimit();
+
+        float mLeft, mRight, mTop, mDown, mFront, mBack;
+    };
+
+    //Depth image to point set: back projection, depth edge aware smoothing and normals from the pixel grid.
+    //xzFactor = 2 * tan(horizontalFov / 2), yzFactor = 2 * tan(verticalFov / 2), as OpenNI world coordinates.
+    //Free of device state, so frames can be converted on any thread.
+    class DepthFrameConverter
+    {
+    public:
+        static Point3DSet* ToPointSet(const DepthFrame& frame, double xzFactor, double yzFactor, const DepthRangeLimit& range);
+    };
+
+    //Sequential frame decoder, it is called from one thread only
+    class DepthFrameSource
+    {
+    public:
+        virtual ~DepthFrameSource() {}
+        //false at the end of the frames
+        virtual bool ReadFrame(DepthFrame& frame) = 0;
+        virtual double GetXZFactor() const = 0;
+        virtual double GetYZFactor() const = 0;
+    };
+
+    //Depth frames to point set files: a decode thread, workerNum conversion threads and a writer thread which
+    //exports frames in order as filePrefix + frameId + "." + extension. Stages are connected by bounded queues,
+    //so at most about 2 * queueSize frames are in memory.
+    class DepthFramePipeline
+    {
+    public:
+        DepthFramePipeline(int workerNum = 0, int queueSize = 0); //0: by processor number
+
+        //Returns the number of exported frames, frames without a valid depth image are skipped
+        int Run(DepthFrameSource* pSource, const DepthRangeLimit& range, const std::string& filePrefix, const std::string& extension);
+
+    private:
+        int mWorkerNumber;
+        int mQueueSize;
+    };
+}
@@ -0,0 +1,439 @@
+#include "HalfEdgeMesh3D.h"
+#include "Mesh3D.h"
+#include "Tool/LogSystem.h"
+
+namespace MagicDGP
+{
+    HalfEdgeMesh3D::OneRingIterator::OneRingIterator(const HalfEdgeMesh3D* pMesh, int vertId) :
+        mpMesh(pMesh),
+        mStartEdge(pMesh->GetVertexEdge(vertId)),
+        mCurrentEdge(pMesh->GetVertexEdge(vertId))
+    {
+    }
+
+    bool HalfEdgeMesh3D::OneRingIterator::IsDone() const
+    {
+        return mCurrentEdge == -1;
+    }
+
+    void HalfEdgeMesh3D::OneRingIterator::Next()
+    {
+        int pairEdge = mpMesh->mEdgePairList[mCurrentEdge];
+        int nextEdge = (pairEdge == -1) ? -1 : mpMesh->mEdgeNextList[pairEdge];
+        mCurrentEdge = (nextEdge == mStartEdge) ? -1 : nextEdge;
+    }
+
+    int HalfEdgeMesh3D::OneRingIterator::GetEdge() const
+    {
+        return mCurrentEdge;
+    }
+
+    int HalfEdgeMesh3D::OneRingIterator::GetVertex() const
+    {
+        return mpMesh->mEdgeVertexList[mCurrentEdge];
+    }
+
+    int HalfEdgeMesh3D::OneRingIterator::GetFace() const
+    {
+        return mpMesh->mEdgeFaceList[mCurrentEdge];
+    }
+
+    HalfEdgeMesh3D::HalfEdgeMesh3D()
+    {
+    }
+
+    HalfEdgeMesh3D::~HalfEdgeMesh3D()
+    {
+        ClearData();
+    }
+
+    HalfEdgeMesh3D* HalfEdgeMesh3D::CreateFromMesh3D(const Mesh3D* pMesh)
+    {
+        HalfEdgeMesh3D* pNewMesh = new HalfEdgeMesh3D;
+        int vertNum = pMesh->GetVertexNumber();
+        int edgeNum = pMesh->GetEdgeNumber();
+        int faceNum = pMesh->GetFaceNumber();
+        pNewMesh->mPositionList.resize(vertNum);
+        pNewMesh->mNormalList.resize(vertNum);
+        pNewMesh->mVertexEdgeList.resize(vertNum, -1);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            const Vertex3D* pVert = pMesh->GetVertex(vid);
+            pNewMesh->mPositionList[vid] = pVert->GetPosition();
+            pNewMesh->mNormalList[vid] = pVert->GetNormal();
+            if (pVert->GetEdge() != NULL)
+            {
+                pNewMesh->mVertexEdgeList[vid] = pVert->GetEdge()->GetId();
+            }
+        }
+        pNewMesh->mEdgeVertexList.resize(edgeNum, -1);
+        pNewMesh->mEdgeNextList.resize(edgeNum, -1);
+        pNewMesh->mEdgePreList.resize(edgeNum, -1);
+        pNewMesh->mEdgePairList.resize(edgeNum, -1);
+        pNewMesh->mEdgeFaceList.resize(edgeNum, -1);
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            const Edge3D* pEdge = pMesh->GetEdge(eid);
+            if (pEdge->GetVertex() != NULL)
+            {
+                pNewMesh->mEdgeVertexList[eid] = pEdge->GetVertex()->GetId();
+            }
+            if (pEdge->GetNext() != NULL)
+            {
+                pNewMesh->mEdgeNextList[eid] = pEdge->GetNext()->GetId();
+            }
+            if (pEdge->GetPre() != NULL)
+            {
+                pNewMesh->mEdgePreList[eid] = pEdge->GetPre()->GetId();
+            }
+            if (pEdge->GetPair() != NULL)
+            {
+                pNewMesh->mEdgePairList[eid] = pEdge->GetPair()->GetId();
+            }
+            if (pEdge->GetFace() != NULL)
+            {
+                pNewMesh->mEdgeFaceList[eid] = pEdge->GetFace()->GetId();
+            }
+        }
+        pNewMesh->mFaceEdgeList.resize(faceNum, -1);
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            const Face3D* pFace = pMesh->GetFace(fid);
+            if (pFace->GetEdge() != NULL)
+            {
+                pNewMesh->mFaceEdgeList[fid] = pFace->GetEdge()->GetId();
+            }
+        }
+        pNewMesh->LinkBoundary();
+        pMesh->GetBBox(pNewMesh->mBBoxMin, pNewMesh->mBBoxMax);
+
+        return pNewMesh;
+    }
+
+    Mesh3D* HalfEdgeMesh3D::CreateMesh3D() const
+    {
+        Mesh3D* pMesh = new Mesh3D;
+        int vertNum = GetVertexNumber();
+        int edgeNum = GetEdgeNumber();
+        int faceNum = GetFaceNumber();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            Vertex3D* pVert = pMesh->InsertVertex(mPositionList[vid]);
+            pVert->SetNormal(mNormalList[vid]);
+        }
+        std::vector<Edge3D* >& edgeList = pMesh->GetEdgeList();
+        edgeList.resize(edgeNum);
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            Edge3D* pEdge = new Edge3D;
+            pEdge->SetId(eid);
+            edgeList[eid] = pEdge;
+        }
+        std::vector<Face3D* >& faceList = pMesh->GetFaceList();
+        faceList.resize(faceNum);
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            Face3D* pFace = new Face3D;
+            pFace->SetId(fid);
+            faceList[fid] = pFace;
+        }
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            Edge3D* pEdge = edgeList[eid];
+            if (mEdgeVertexList[eid] != -1)
+            {
+                pEdge->SetVertex(pMesh->GetVertex(mEdgeVertexList[eid]));
+            }
+            if (mEdgeNextList[eid] != -1)
+            {
+                pEdge->SetNext(edgeList[mEdgeNextList[eid]]);
+            }
+            if (mEdgePreList[eid] != -1)
+            {
+                pEdge->SetPre(edgeList[mEdgePreList[eid]]);
+            }
+            if (mEdgePairList[eid] != -1)
+            {
+                pEdge->SetPair(edgeList[mEdgePairList[eid]]);
+            }
+            if (mEdgeFaceList[eid] != -1)
+            {
+                pEdge->SetFace(faceList[mEdgeFaceList[eid]]);
+            }
+            else
+            {
+                pEdge->SetBoundaryType(BT_Boundary);
+            }
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            if (mFaceEdgeList[fid] != -1)
+            {
+                faceList[fid]->SetEdge(edgeList[mFaceEdgeList[fid]]);
+            }
+        }
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            Vertex3D* pVert = pMesh->GetVertex(vid);
+            if (mVertexEdgeList[vid] != -1)
+            {
+                pVert->SetEdge(edgeList[mVertexEdgeList[vid]]);
+            }
+            if (IsBoundaryVertex(vid))
+            {
+                pVert->SetBoundaryType(BT_Boundary);
+            }
+        }
+        if (vertNum > 0)
+        {
+            pMesh->CalculateBBox();
+        }
+
+        return pMesh;
+    }
+
+    int HalfEdgeMesh3D::GetVertexNumber() const
+    {
+        return mPositionList.size();
+    }
+
+    int HalfEdgeMesh3D::GetEdgeNumber() const
+    {
+        return mEdgeVertexList.size();
+    }
+
+    int HalfEdgeMesh3D::GetFaceNumber() const
+    {
+        return mFaceEdgeList.size();
+    }
+
+    MagicMath::Vector3 HalfEdgeMesh3D::GetPosition(int vertId) const
+    {
+        return mPositionList[vertId];
+    }
+
+    void HalfEdgeMesh3D::SetPosition(int vertId, const MagicMath::Vector3& pos)
+    {
+        mPositionList[vertId] = pos;
+    }
+
+    MagicMath::Vector3 HalfEdgeMesh3D::GetNormal(int vertId) const
+    {
+        return mNormalList[vertId];
+    }
+
+    void HalfEdgeMesh3D::SetNormal(int vertId, const MagicMath::Vector3& nor)
+    {
+        mNormalList[vertId] = nor;
+    }
+
+    const std::vector<MagicMath::Vector3>& HalfEdgeMesh3D::GetPositionList() const
+    {
+        return mPositionList;
+    }
+
+    const std::vector<MagicMath::Vector3>& HalfEdgeMesh3D::GetNormalList() const
+    {
+        return mNormalList;
+    }
+
+    int HalfEdgeMesh3D::GetVertexEdge(int vertId) const
+    {
+        return mVertexEdgeList[vertId];
+    }
+
+    int HalfEdgeMesh3D::GetEdgeVertex(int edgeId) const
+    {
+        return mEdgeVertexList[edgeId];
+    }
+
+    int HalfEdgeMesh3D::GetEdgeNext(int edgeId) const
+    {
+        return mEdgeNextList[edgeId];
+    }
+
+    int HalfEdgeMesh3D::GetEdgePre(int edgeId) const
+    {
+        return mEdgePreList[edgeId];
+    }
+
+    int HalfEdgeMesh3D::GetEdgePair(int edgeId) const
+    {
+        return mEdgePairList[edgeId];
+    }
+
+    int HalfEdgeMesh3D::GetEdgeFace(int edgeId) const
+    {
+        return mEdgeFaceList[edgeId];
+    }
+
+    int HalfEdgeMesh3D::GetFaceEdge(int faceId) const
+    {
+        return mFaceEdgeList[faceId];
+    }
+
+    bool HalfEdgeMesh3D::IsBoundaryVertex(int vertId) const
+    {
+        int edgeId = mVertexEdgeList[vertId];
+        return edgeId != -1 && mEdgeFaceList[edgeId] == -1;
+    }
+
+    bool HalfEdgeMesh3D::IsBoundaryEdge(int edgeId) const
+    {
+        return mEdgeFaceList[edgeId] == -1;
+    }
+
+    HalfEdgeMesh3D::OneRingIterator HalfEdgeMesh3D::GetOneRing(int vertId) const
+    {
+        return OneRingIterator(this, vertId);
+    }
+
+    void HalfEdgeMesh3D::UnifyPosition(double size)
+    {
+        int vertNum = mPositionList.size();
+        if (vertNum == 0)
+        {
+            return;
+        }
+        CalculateBBox();
+        MagicMath::Vector3 scale3 = mBBoxMax - mBBoxMin;
+        double scaleMax = scale3[0];
+        if (scaleMax < scale3[1])
+        {
+            scaleMax = scale3[1];
+        }
+        if (scaleMax < scale3[2])
+        {
+            scaleMax = scale3[2];
+        }
+        if (scaleMax > 1.0e-15)
+        {
+            double scaleV = size / scaleMax;
+            MagicMath::Vector3 centerPos = (mBBoxMin + mBBoxMax) / 2.0;
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                mPositionList[vid] = (mPositionList[vid] - centerPos) * scaleV;
+            }
+            CalculateBBox();
+        }
+    }
+
+    void HalfEdgeMesh3D::UpdateNormal()
+    {
+        int vertNum = mPositionList.size();
+        mNormalList.resize(vertNum);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            MagicMath::Vector3 pos = mPositionList[vid];
+            MagicMath::Vector3 nor(0, 0, 0);
+            for (OneRingIterator ring(this, vid); !ring.IsDone(); ring.Next())
+            {
+                int edgeId = ring.GetEdge();
+                if (mEdgeFaceList[edgeId] != -1)
+                {
+                    const MagicMath::Vector3& posNext = mPositionList[mEdgeVertexList[edgeId]];
+                    const MagicMath::Vector3& posPre = mPositionList[mEdgeVertexList[mEdgeNextList[edgeId]]];
+                    nor += (posNext - pos).CrossProduct(posPre - pos);
+                }
+            }
+            double norLen = nor.Normalise();
+            if (norLen < 1.0e-15)
+            {
+                nor[0] = 1.0;
+            }
+            mNormalList[vid] = nor;
+        }
+    }
+
+    void HalfEdgeMesh3D::GetBBox(MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax) const
+    {
+        bboxMin = mBBoxMin;
+        bboxMax = mBBoxMax;
+    }
+
+    void HalfEdgeMesh3D::CalculateBBox()
+    {
+        int vertNum = mPositionList.size();
+        if (vertNum == 0)
+        {
+            return;
+        }
+        mBBoxMin = mPositionList[0];
+        mBBoxMax = mPositionList[0];
+        for (int vid = 1; vid < vertNum; vid++)
+        {
+            const MagicMath::Vector3& pos = mPositionList[vid];
+            for (int k = 0; k < 3; k++)
+            {
+                if (mBBoxMin[k] > pos[k])
+                {
+                    mBBoxMin[k] = pos[k];
+                }
+                if (mBBoxMax[k] < pos[k])
+                {
+                    mBBoxMax[k] = pos[k];
+                }
+            }
+        }
+    }
+
+    void HalfEdgeMesh3D::ClearData()
+    {
+        std::vector<MagicMath::Vector3>().swap(mPositionList);
+        std::vector<MagicMath::Vector3>().swap(mNormalList);
+        std::vector<int>().swap(mVertexEdgeList);
+        std::vector<int>().swap(mEdgeVertexList);
+        std::vector<int>().swap(mEdgeNextList);
+        std::vector<int>().swap(mEdgePreList);
+        std::vector<int>().swap(mEdgePairList);
+        std::vector<int>().swap(mEdgeFaceList);
+        std::vector<int>().swap(mFaceEdgeList);
+    }
+
+    void HalfEdgeMesh3D::LinkBoundary()
+    {
+        //Same as Mesh3D::UpdateBoundaryFlag: the edge of a boundary vertex is its outgoing boundary edge,
+        //and boundary edges are chained by next/pre along the hole.
+        int vertNum = mVertexEdgeList.size();
+        int edgeNum = mEdgeVertexList.size();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            int startEdge = mVertexEdgeList[vid];
+            if (startEdge == -1)
+            {
+                continue;
+            }
+            int edgeId = startEdge;
+            int stepNum = 0;
+            while (mEdgeFaceList[edgeId] != -1 && stepNum < edgeNum)
+            {
+                edgeId = mEdgePairList[mEdgePreList[edgeId]];
+                stepNum++;
+                if (edgeId == startEdge)
+                {
+                    break;
+                }
+            }
+            if (mEdgeFaceList[edgeId] != -1)
+            {
+                continue;
+            }
+            mVertexEdgeList[vid] = edgeId;
+            int boundaryEdge = edgeId;
+            stepNum = 0;
+            while (mEdgeFaceList[mEdgePairList[edgeId]] != -1 && stepNum < edgeNum)
+            {
+                edgeId = mEdgeNextList[mEdgePairList[edgeId]];
+                stepNum++;
+            }
+            if (stepNum == edgeNum)
+            {
+                WarnLog << "HalfEdgeMesh3D::LinkBoundary: non-manifold vertex " << vid << std::endl;
+                continue;
+            }
+            int inEdge = mEdgePairList[edgeId];
+            mEdgeNextList[inEdge] = boundaryEdge;
+            mEdgePreList[boundaryEdge] = inEdge;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "Math/Vector3.h"
+#include <vector>
+
+namespace MagicDGP
+{
+    class Mesh3D;
+
+    //Index based half edge mesh. All elements are stored in contiguous arrays and
+    //refer to each other by 32-bit index, -1 means invalid. Conventions follow Mesh3D:
+    //the vertex of an edge is its end vertex, and the edge of a vertex is an outgoing edge.
+    class HalfEdgeMesh3D
+    {
+    public:
+        //Walk the outgoing edges around a vertex, the same order as pEdge->GetPair()->GetNext()
+        class OneRingIterator
+        {
+        public:
+            OneRingIterator(const HalfEdgeMesh3D* pMesh, int vertId);
+            bool IsDone() const;
+            void Next();
+            int GetEdge() const;
+            int GetVertex() const;
+            int GetFace() const;
+
+        private:
+            const HalfEdgeMesh3D* mpMesh;
+            int mStartEdge;
+            int mCurrentEdge;
+        };
+
+    public:
+        HalfEdgeMesh3D();
+        ~HalfEdgeMesh3D();
+
+        static HalfEdgeMesh3D* CreateFromMesh3D(const Mesh3D* pMesh);
+        Mesh3D* CreateMesh3D() const;
+
+        int GetVertexNumber() const;
+        int GetEdgeNumber() const;
+        int GetFaceNumber() const;
+
+        MagicMath::Vector3 GetPosition(int vertId) const;
+        void SetPosition(int vertId, const MagicMath::Vector3& pos);
+        MagicMath::Vector3 GetNormal(int vertId) const;
+        void SetNormal(int vertId, const MagicMath::Vector3& nor);
+        const std::vector<MagicMath::Vector3>& GetPositionList() const;
+        const std::vector<MagicMath::Vector3>& GetNormalList() const;
+
+        int GetVertexEdge(int vertId) const;
+        int GetEdgeVertex(int edgeId) const;
+        int GetEdgeNext(int edgeId) const;
+        int GetEdgePre(int edgeId) const;
+        int GetEdgePair(int edgeId) const;
+        int GetEdgeFace(int edgeId) const;
+        int GetFaceEdge(int faceId) const;
+        bool IsBoundaryVertex(int vertId) const;
+        bool IsBoundaryEdge(int edgeId) const;
+        OneRingIterator GetOneRing(int vertId) const;
+
+        void UnifyPosition(double size);
+        void UpdateNormal();
+        void GetBBox(MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax) const;
+        void CalculateBBox();
+        void ClearData();
+
+    private:
+        void LinkBoundary();
+
+    private:
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<int> mVertexEdgeList;
+        std::vector<int> mEdgeVertexList;
+        std::vector<int> mEdgeNextList;
+        std::vector<int> mEdgePreList;
+        std::vector<int> mEdgePairList;
+        std::vector<int> mEdgeFaceList;
+        std::vector<int> mFaceEdgeList;
+        MagicMath::Vector3 mBBoxMin, mBBoxMax;
+    };
+}
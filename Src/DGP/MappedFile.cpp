@@ -0,0 +1,156 @@
+#include "MappedFile.h"
+#include "Tool/LogSystem.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace MagicDGP
+{
+    MappedFile::MappedFile() :
+        mpData(NULL),
+        mSize(0),
+        mIsOpen(false),
+#ifdef _WIN32
+        mFileHandle(INVALID_HANDLE_VALUE),
+        mMappingHandle(NULL)
+#else
+        mFileDescriptor(-1)
+#endif
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const std::string& fileName)
+    {
+        Close();
+        mFileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (mFileHandle == INVALID_HANDLE_VALUE)
+        {
+            ErrorLog << "MappedFile::Open: can not open " << fileName.c_str() << std::endl;
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(mFileHandle, &fileSize) || (unsigned long long)fileSize.QuadPart > (size_t)(-1))
+        {
+            ErrorLog << "MappedFile::Open: invalid file size " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        mSize = (size_t)fileSize.QuadPart;
+        mIsOpen = true;
+        if (mSize == 0)
+        {
+            return true;
+        }
+        mMappingHandle = CreateFileMappingA(mFileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mMappingHandle != NULL)
+        {
+            mpData = static_cast<const char*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (mpData == NULL)
+        {
+            ErrorLog << "MappedFile::Open: can not map " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (mpData != NULL)
+        {
+            UnmapViewOfFile(mpData);
+            mpData = NULL;
+        }
+        if (mMappingHandle != NULL)
+        {
+            CloseHandle(mMappingHandle);
+            mMappingHandle = NULL;
+        }
+        if (mFileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(mFileHandle);
+            mFileHandle = INVALID_HANDLE_VALUE;
+        }
+        mSize = 0;
+        mIsOpen = false;
+    }
+#else
+    bool MappedFile::Open(const std::string& fileName)
+    {
+        Close();
+        mFileDescriptor = open(fileName.c_str(), O_RDONLY);
+        if (mFileDescriptor == -1)
+        {
+            ErrorLog << "MappedFile::Open: can not open " << fileName.c_str() << std::endl;
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(mFileDescriptor, &fileStat) != 0)
+        {
+            ErrorLog << "MappedFile::Open: invalid file size " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        mSize = fileStat.st_size;
+        mIsOpen = true;
+        if (mSize == 0)
+        {
+            return true;
+        }
+        void* pMap = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+        if (pMap == MAP_FAILED)
+        {
+            ErrorLog << "MappedFile::Open: can not map " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        madvise(pMap, mSize, MADV_SEQUENTIAL);
+        mpData = static_cast<const char*>(pMap);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (mpData != NULL)
+        {
+            munmap(const_cast<char*>(mpData), mSize);
+            mpData = NULL;
+        }
+        if (mFileDescriptor != -1)
+        {
+            close(mFileDescriptor);
+            mFileDescriptor = -1;
+        }
+        mSize = 0;
+        mIsOpen = false;
+    }
+#endif
+
+    bool MappedFile::IsOpen() const
+    {
+        return mIsOpen;
+    }
+
+    const char* MappedFile::GetData() const
+    {
+        return mpData;
+    }
+
+    size_t MappedFile::GetSize() const
+    {
+        return mSize;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+
+namespace MagicDGP
+{
+    //Read only memory mapping of a whole file
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool Open(const std::string& fileName);
+        void Close();
+        bool IsOpen() const;
+        const char* GetData() const;
+        size_t GetSize() const;
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator = (const MappedFile&);
+
+    private:
+        const char* mpData;
+        size_t mSize;
+        bool mIsOpen;
+#ifdef _WIN32
+        void* mFileHandle;
+        void* mMappingHandle;
+#else
+        int mFileDescriptor;
+#endif
+    };
+}
@@ -1,6 +1,15 @@
   //#include "StdAfx.h"
 #include "Mesh3D.h"
 #include "Tool/LogSystem.h"
+#include "../Common/AsyncLog.h"
+#include "../Common/Parallel.h"
+#include <algorithm>
+
+namespace
+{
+    //LightMesh3D::UpdateNormal, one per degenerate vertex
+    MagicCore::AsyncLogSite gSmallNormalLogSite(10, 10000);
+}
 
 namespace MagicDGP
 {
@@ -388,7 +397,7 @@ namespace MagicDGP
 
     Vertex3D* Mesh3D::InsertVertex(const MagicMath::Vector3& pos)
     {
-        Vertex3D* pVert = new Vertex3D(pos);
+        Vertex3D* pVert = mVertexPool.Create(pos);
         pVert->SetId(mVertexList.size());
         mVertexList.push_back(pVert);
         return pVert;
@@ -402,7 +411,7 @@ namespace MagicDGP
         }
         else
         {
-            Edge3D* pEdge = new Edge3D;
+            Edge3D* pEdge = mEdgePool.Create();
             pEdge->SetVertex(pVertEnd);
             pEdge->SetId(mEdgeList.size());
             pVertStart->SetEdge(pEdge);
@@ -420,7 +429,7 @@ namespace MagicDGP
         {
             return NULL;
         }
-        Face3D* pFace = new Face3D;
+        Face3D* pFace = mFacePool.Create();
         std::vector<Edge3D* > innerEdgeList(3);
         for (int i = 0; i < 3; i++)
         {
@@ -444,6 +453,359 @@ namespace MagicDGP
         return pFace;
     }
 
+    //Chunk cid of [0, indexNum) as the ranges of ParallelFor
+    static void GetEdgeKeyChunk(int indexNum, int chunkNum, int cid, int& rangeStart, int& rangeEnd)
+    {
+        rangeStart = int((long long)indexNum * cid / chunkNum);
+        rangeEnd = int((long long)indexNum * (cid + 1) / chunkNum);
+    }
+
+    static void RadixSortEdgeKey(std::vector<unsigned long long>& keyList, std::vector<int>& idList, int vertNum)
+    {
+        //LSD radix sort by 8 bit digit. Both vertex ids of a key are below vertNum, so only the low digits of
+        //each 32 bit half are sorted, and a digit which is the same for all keys is skipped.
+        //Every chunk counts its own histogram, the scatter offsets are the prefix sum over (digit, chunk),
+        //so the sort is stable and independent of the thread number.
+        int keyNum = keyList.size();
+        if (keyNum == 0)
+        {
+            return;
+        }
+        const int bucketNum = 256;
+        const int grainSize = 1 << 16;
+        int digitNum = 0;
+        while (digitNum < 4 && ((unsigned int)(vertNum - 1) >> (digitNum * 8)) != 0)
+        {
+            digitNum++;
+        }
+        std::vector<int> shiftList;
+        for (int did = 0; did < digitNum; did++)
+        {
+            shiftList.push_back(did * 8);
+        }
+        for (int did = 0; did < digitNum; did++)
+        {
+            shiftList.push_back(32 + did * 8);
+        }
+        int chunkNum = MagicCore::GetParallelChunkNumber(keyNum, grainSize);
+        std::vector<unsigned long long> keyTemp(keyNum);
+        std::vector<int> idTemp(keyNum);
+        std::vector<int> countList(chunkNum * bucketNum);
+        for (int pass = 0; pass < int(shiftList.size()); pass++)
+        {
+            int shift = shiftList.at(pass);
+            MagicCore::ParallelFor(0, chunkNum, [&](int startChunk, int endChunk)
+            {
+                for (int cid = startChunk; cid < endChunk; cid++)
+                {
+                    int* pCount = &(countList[cid * bucketNum]);
+                    std::fill(pCount, pCount + bucketNum, 0);
+                    int rangeStart, rangeEnd;
+                    GetEdgeKeyChunk(keyNum, chunkNum, cid, rangeStart, rangeEnd);
+                    for (int i = rangeStart; i < rangeEnd; i++)
+                    {
+                        pCount[(keyList[i] >> shift) & 0xFF]++;
+                    }
+                }
+            }, 1);
+            int firstBucket = (keyList[0] >> shift) & 0xFF;
+            int firstBucketNum = 0;
+            for (int cid = 0; cid < chunkNum; cid++)
+            {
+                firstBucketNum += countList[cid * bucketNum + firstBucket];
+            }
+            if (firstBucketNum == keyNum)
+            {
+                continue;
+            }
+            int offset = 0;
+            for (int bid = 0; bid < bucketNum; bid++)
+            {
+                for (int cid = 0; cid < chunkNum; cid++)
+                {
+                    int count = countList[cid * bucketNum + bid];
+                    countList[cid * bucketNum + bid] = offset;
+                    offset += count;
+                }
+            }
+            MagicCore::ParallelFor(0, chunkNum, [&](int startChunk, int endChunk)
+            {
+                for (int cid = startChunk; cid < endChunk; cid++)
+                {
+                    int* pOffset = &(countList[cid * bucketNum]);
+                    int rangeStart, rangeEnd;
+                    GetEdgeKeyChunk(keyNum, chunkNum, cid, rangeStart, rangeEnd);
+                    for (int i = rangeStart; i < rangeEnd; i++)
+                    {
+                        int pos = pOffset[(keyList[i] >> shift) & 0xFF]++;
+                        keyTemp[pos] = keyList[i];
+                        idTemp[pos] = idList[i];
+                    }
+                }
+            }, 1);
+            keyList.swap(keyTemp);
+            idList.swap(idTemp);
+        }
+    }
+
+    void Mesh3D::BuildFromIndexedTriangles(const std::vector<MagicMath::Vector3>& posList, const std::vector<int>& indexList)
+    {
+        ClearData();
+        int vertNum = posList.size();
+        mVertexList.reserve(vertNum);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            InsertVertex(posList.at(vid));
+        }
+        //Remove invalid triangles
+        int triNum = indexList.size() / 3;
+        std::vector<int> faceIndexList;
+        faceIndexList.reserve(triNum * 3);
+        int invalidNum = 0;
+        for (int tid = 0; tid < triNum; tid++)
+        {
+            int vid0 = indexList.at(tid * 3);
+            int vid1 = indexList.at(tid * 3 + 1);
+            int vid2 = indexList.at(tid * 3 + 2);
+            if (vid0 < 0 || vid0 >= vertNum || vid1 < 0 || vid1 >= vertNum || vid2 < 0 || vid2 >= vertNum ||
+                vid0 == vid1 || vid1 == vid2 || vid2 == vid0)
+            {
+                invalidNum++;
+                continue;
+            }
+            faceIndexList.push_back(vid0);
+            faceIndexList.push_back(vid1);
+            faceIndexList.push_back(vid2);
+        }
+        if (invalidNum > 0)
+        {
+            WarnLog << "BuildFromIndexedTriangles: invalid triangle number: " << invalidNum << std::endl;
+        }
+        //Inner half edges, edge fid * 3 + k goes from vertex k to vertex k + 1 of face fid
+        int faceNum = faceIndexList.size() / 3;
+        int innerEdgeNum = faceNum * 3;
+        mFaceList.resize(faceNum);
+        mEdgeList.resize(innerEdgeNum);
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            Face3D* pFace = mFacePool.Create();
+            pFace->SetId(fid);
+            mFaceList.at(fid) = pFace;
+            for (int k = 0; k < 3; k++)
+            {
+                Edge3D* pEdge = mEdgePool.Create();
+                pEdge->SetId(fid * 3 + k);
+                pEdge->SetVertex(mVertexList.at(faceIndexList.at(fid * 3 + (k + 1) % 3)));
+                pEdge->SetFace(pFace);
+                mEdgeList.at(fid * 3 + k) = pEdge;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                Edge3D* pEdge = mEdgeList.at(fid * 3 + k);
+                pEdge->SetNext(mEdgeList.at(fid * 3 + (k + 1) % 3));
+                pEdge->SetPre(mEdgeList.at(fid * 3 + (k + 2) % 3));
+                mVertexList.at(faceIndexList.at(fid * 3 + k))->SetEdge(pEdge);
+            }
+            pFace->SetEdge(mEdgeList.at(fid * 3));
+        }
+        //Sort by undirected edge key, so the two sides of an edge are adjacent
+        std::vector<unsigned long long> keyList(innerEdgeNum);
+        std::vector<int> idList(innerEdgeNum);
+        MagicCore::ParallelFor(0, innerEdgeNum, [&](int startIndex, int endIndex)
+        {
+            for (int eid = startIndex; eid < endIndex; eid++)
+            {
+                unsigned long long vidStart = faceIndexList[eid];
+                unsigned long long vidEnd = mEdgeList[eid]->GetVertex()->GetId();
+                keyList[eid] = vidStart < vidEnd ? ((vidStart << 32) | vidEnd) : ((vidEnd << 32) | vidStart);
+                idList[eid] = eid;
+            }
+        });
+        std::vector<int>().swap(faceIndexList);
+        RadixSortEdgeKey(keyList, idList, vertNum);
+        //Pair half edges in parallel over chunks of whole runs of equal keys. The unpaired ones are collected
+        //per chunk and get their boundary pair afterwards in sorted order, as the pools are not thread safe.
+        int pairChunkNum = MagicCore::GetParallelChunkNumber(innerEdgeNum, 1 << 14);
+        std::vector<int> pairChunkStart(pairChunkNum + 1, innerEdgeNum);
+        for (int cid = 0; cid < pairChunkNum; cid++)
+        {
+            int rangeStart, rangeEnd;
+            GetEdgeKeyChunk(innerEdgeNum, pairChunkNum, cid, rangeStart, rangeEnd);
+            while (rangeStart > 0 && rangeStart < innerEdgeNum && keyList[rangeStart] == keyList[rangeStart - 1])
+            {
+                rangeStart++;
+            }
+            pairChunkStart.at(cid) = rangeStart;
+        }
+        std::vector<std::vector<int> > unpairedList(pairChunkNum);
+        std::vector<int> nonManifoldList(pairChunkNum, 0);
+        MagicCore::ParallelFor(0, pairChunkNum, [&](int startChunk, int endChunk)
+        {
+            for (int cid = startChunk; cid < endChunk; cid++)
+            {
+                int chunkEnd = pairChunkStart.at(cid + 1);
+                int runStart = pairChunkStart.at(cid);
+                while (runStart < chunkEnd)
+                {
+                    int runEnd = runStart + 1;
+                    while (runEnd < innerEdgeNum && keyList[runEnd] == keyList[runStart])
+                    {
+                        runEnd++;
+                    }
+                    if (runEnd - runStart > 2)
+                    {
+                        nonManifoldList.at(cid)++;
+                    }
+                    for (int i = runStart; i < runEnd; i++)
+                    {
+                        Edge3D* pEdge = mEdgeList[idList[i]];
+                        if (pEdge->GetPair() != NULL)
+                        {
+                            continue;
+                        }
+                        Vertex3D* pVertStart = pEdge->GetPre()->GetVertex();
+                        for (int j = i + 1; j < runEnd; j++)
+                        {
+                            Edge3D* pCandEdge = mEdgeList[idList[j]];
+                            if (pCandEdge->GetPair() == NULL && pCandEdge->GetVertex() == pVertStart)
+                            {
+                                pEdge->SetPair(pCandEdge);
+                                pCandEdge->SetPair(pEdge);
+                                break;
+                            }
+                        }
+                        if (pEdge->GetPair() == NULL)
+                        {
+                            unpairedList.at(cid).push_back(idList[i]);
+                        }
+                    }
+                    runStart = runEnd;
+                }
+            }
+        }, 1);
+        std::vector<unsigned long long>().swap(keyList);
+        std::vector<int>().swap(idList);
+        int nonManifoldNum = 0;
+        for (int cid = 0; cid < pairChunkNum; cid++)
+        {
+            nonManifoldNum += nonManifoldList.at(cid);
+            for (std::vector<int>::iterator itr = unpairedList.at(cid).begin(); itr != unpairedList.at(cid).end(); ++itr)
+            {
+                Edge3D* pEdge = mEdgeList.at(*itr);
+                Vertex3D* pVertStart = pEdge->GetPre()->GetVertex();
+                Edge3D* pBoundaryEdge = mEdgePool.Create();
+                pBoundaryEdge->SetId(mEdgeList.size());
+                pBoundaryEdge->SetVertex(pVertStart);
+                pBoundaryEdge->SetPair(pEdge);
+                pBoundaryEdge->SetBoundaryType(BT_Boundary);
+                pEdge->SetPair(pBoundaryEdge);
+                pEdge->GetVertex()->SetBoundaryType(BT_Boundary);
+                pEdge->GetVertex()->SetEdge(pBoundaryEdge);
+                pVertStart->SetBoundaryType(BT_Boundary);
+                mEdgeList.push_back(pBoundaryEdge);
+            }
+        }
+        if (nonManifoldNum > 0)
+        {
+            WarnLog << "BuildFromIndexedTriangles: non-manifold edge number: " << nonManifoldNum << std::endl;
+        }
+        //Link boundary edges, the edge of a boundary vertex is its outgoing boundary edge
+        int edgeNum = mEdgeList.size();
+        for (int eid = innerEdgeNum; eid < edgeNum; eid++)
+        {
+            Edge3D* pBoundaryEdge = mEdgeList.at(eid);
+            Edge3D* pNextEdge = pBoundaryEdge->GetVertex()->GetEdge();
+            pBoundaryEdge->SetNext(pNextEdge);
+            pNextEdge->SetPre(pBoundaryEdge);
+        }
+        if (vertNum > 0)
+        {
+            CalculateBBox();
+        }
+    }
+
+    bool Mesh3D::BuildFromHalfEdges(int vertNum, const double* pPosition, const int* pVertexEdge,
+        int edgeNum, const int* pEdgeTopology, int faceNum, const int* pFaceEdge)
+    {
+        ClearData();
+        if (vertNum < 0 || edgeNum < 0 || faceNum < 0)
+        {
+            return false;
+        }
+        //Check every id before any pointer is linked
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            if (pVertexEdge[vid] < -1 || pVertexEdge[vid] >= edgeNum)
+            {
+                ErrorLog << "BuildFromHalfEdges: invalid edge of vertex " << vid << std::endl;
+                return false;
+            }
+        }
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            const int* pTopology = pEdgeTopology + eid * 5;
+            if (pTopology[0] < -1 || pTopology[0] >= vertNum || pTopology[1] < -1 || pTopology[1] >= edgeNum ||
+                pTopology[2] < -1 || pTopology[2] >= edgeNum || pTopology[3] < -1 || pTopology[3] >= edgeNum ||
+                pTopology[4] < -1 || pTopology[4] >= faceNum)
+            {
+                ErrorLog << "BuildFromHalfEdges: invalid topology of edge " << eid << std::endl;
+                return false;
+            }
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            if (pFaceEdge[fid] < -1 || pFaceEdge[fid] >= edgeNum)
+            {
+                ErrorLog << "BuildFromHalfEdges: invalid edge of face " << fid << std::endl;
+                return false;
+            }
+        }
+        mVertexList.resize(vertNum);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            Vertex3D* pVert = mVertexPool.Create(MagicMath::Vector3(pPosition[vid * 3], pPosition[vid * 3 + 1], pPosition[vid * 3 + 2]));
+            pVert->SetId(vid);
+            mVertexList.at(vid) = pVert;
+        }
+        mEdgeList.resize(edgeNum);
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            Edge3D* pEdge = mEdgePool.Create();
+            pEdge->SetId(eid);
+            mEdgeList.at(eid) = pEdge;
+        }
+        mFaceList.resize(faceNum);
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            Face3D* pFace = mFacePool.Create();
+            pFace->SetId(fid);
+            mFaceList.at(fid) = pFace;
+        }
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            mVertexList.at(vid)->SetEdge(pVertexEdge[vid] < 0 ? NULL : mEdgeList.at(pVertexEdge[vid]));
+        }
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            const int* pTopology = pEdgeTopology + eid * 5;
+            Edge3D* pEdge = mEdgeList.at(eid);
+            pEdge->SetVertex(pTopology[0] < 0 ? NULL : mVertexList.at(pTopology[0]));
+            pEdge->SetPair(pTopology[1] < 0 ? NULL : mEdgeList.at(pTopology[1]));
+            pEdge->SetNext(pTopology[2] < 0 ? NULL : mEdgeList.at(pTopology[2]));
+            pEdge->SetPre(pTopology[3] < 0 ? NULL : mEdgeList.at(pTopology[3]));
+            pEdge->SetFace(pTopology[4] < 0 ? NULL : mFaceList.at(pTopology[4]));
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            mFaceList.at(fid)->SetEdge(pFaceEdge[fid] < 0 ? NULL : mEdgeList.at(pFaceEdge[fid]));
+        }
+        if (vertNum > 0)
+        {
+            CalculateBBox();
+        }
+        return true;
+    }
+
     void Mesh3D::UnifyPosition(double size)
     {
         MagicMath::Vector3 posMin(10e10, 10e10, 10e10);
@@ -481,32 +843,41 @@ namespace MagicDGP
 
     void Mesh3D::UpdateNormal()
     {
-        for (std::vector<Vertex3D* >::iterator itr = mVertexList.begin(); itr != mVertexList.end(); ++itr)
+        //Every vertex only writes its own normal, small normals are counted and logged once after the loop
+        int smallNormalNum = MagicCore::ParallelReduce(0, int(mVertexList.size()), 0, [&](int startIndex, int endIndex, int smallNum) -> int
         {
-            Vertex3D* pVert = *itr;
-            Edge3D* pEdge = pVert->GetEdge();
-            MagicMath::Vector3 nor(0, 0, 0);
-            do
+            for (int vid = startIndex; vid < endIndex; vid++)
             {
-                if (pEdge->GetFace() != NULL)
+                Vertex3D* pVert = mVertexList.at(vid);
+                Edge3D* pEdge = pVert->GetEdge();
+                MagicMath::Vector3 nor(0, 0, 0);
+                do
+                {
+                    if (pEdge->GetFace() != NULL)
+                    {
+                        Vertex3D* pOrigin = pEdge->GetPre()->GetVertex();
+                        Vertex3D* pNext = pEdge->GetVertex();
+                        Vertex3D* pPre = pEdge->GetNext()->GetVertex();
+                        /*Vector3 faceNor = (pNext->GetPosition() - pOrigin->GetPosition()).CrossProduct(pPre->GetPosition() - pOrigin->GetPosition());
+                        faceNor.Normalise();
+                        nor += faceNor;*/
+                        nor += (pNext->GetPosition() - pOrigin->GetPosition()).CrossProduct(pPre->GetPosition() - pOrigin->GetPosition());
+                    }
+                    pEdge = pEdge->GetPair()->GetNext();
+                } while (pEdge != NULL && pEdge != pVert->GetEdge());
+                double norLen = nor.Normalise();
+                if (norLen < 1.0e-15)
                 {
-                    Vertex3D* pOrigin = pEdge->GetPre()->GetVertex();
-                    Vertex3D* pNext = pEdge->GetVertex();
-                    Vertex3D* pPre = pEdge->GetNext()->GetVertex();
-                    /*Vector3 faceNor = (pNext->GetPosition() - pOrigin->GetPosition()).CrossProduct(pPre->GetPosition() - pOrigin->GetPosition());
-                    faceNor.Normalise();
-                    nor += faceNor;*/
-                    nor += (pNext->GetPosition() - pOrigin->GetPosition()).CrossProduct(pPre->GetPosition() - pOrigin->GetPosition());
+                    smallNum++;
+                    nor[0] = 1.0;
                 }
-                pEdge = pEdge->GetPair()->GetNext();
-            } while (pEdge != NULL && pEdge != pVert->GetEdge());
-            double norLen = nor.Normalise();
-            if (norLen < 1.0e-15)
-            {
-                DebugLog << "normal lenth too small" << std::endl;
-                nor[0] = 1.0;
+                pVert->SetNormal(nor);
             }
-            pVert->SetNormal(nor);
+            return smallNum;
+        }, [](int leftNum, int rightNum) -> int { return leftNum + rightNum; });
+        if (smallNormalNum > 0)
+        {
+            DebugLog << "normal lenth too small: " << smallNormalNum << " vertices" << std::endl;
         }
     }
 
@@ -583,36 +954,44 @@ namespace MagicDGP
 
     void Mesh3D::ClearData()
     {
+        //Elements from the pools are released together, others are deleted one by one
         for (std::vector<Vertex3D* >::iterator itr = mVertexList.begin(); itr != mVertexList.end(); ++itr)
         {
-            if (*itr != NULL)
+            if (*itr != NULL && !mVertexPool.Owns(*itr))
             {
                 delete *itr;
-                *itr = NULL;
             }
+            *itr = NULL;
         }
-        mVertexList.clear();
+        std::vector<Vertex3D* >().swap(mVertexList);
         for (std::vector<Edge3D* >::iterator itr = mEdgeList.begin(); itr != mEdgeList.end(); ++itr)
         {
-            if (*itr != NULL)
+            if (*itr != NULL && !mEdgePool.Owns(*itr))
             {
                 delete *itr;
-                *itr = NULL;
             }
+            *itr = NULL;
         }
-        mEdgeList.clear();
+        std::vector<Edge3D* >().swap(mEdgeList);
         for (std::vector<Face3D* >::iterator itr = mFaceList.begin(); itr != mFaceList.end(); ++itr)
         {
-            if (*itr != NULL)
+            if (*itr != NULL && !mFacePool.Owns(*itr))
             {
                 delete *itr;
-                *itr = NULL;
             }
+            *itr = NULL;
         }
-        mFaceList.clear();
+        std::vector<Face3D* >().swap(mFaceList);
         mEdgeMap.clear();
+        mVertexPool.Clear();
+        mEdgePool.Clear();
+        mFacePool.Clear();
     }
 
+    static const MagicMath::Vector3 LightMeshDefaultNormal(0, 0, 0);
+    static const MagicMath::Vector3 LightMeshDefaultColor(0.86, 0.86, 0.86);
+    static const MagicMath::Vector3 LightMeshDefaultTexCord(0, 0, 0);
+
     LightMesh3D::LightMesh3D()
     {
     }
@@ -622,14 +1001,67 @@ namespace MagicDGP
         ClearData();
     }
 
-    Vertex3D* LightMesh3D::GetVertex(int index)
+    void LightMesh3D::BuildFromIndexedTriangles(const std::vector<MagicMath::Vector3>& posList, const std::vector<int>& indexList)
     {
-        return mVertexList.at(index);
+        ClearData();
+        mPositionList = posList;
+        int vertNum = posList.size();
+        //Remove triangles with missing (-1) or out of range indices
+        int triNum = indexList.size() / 3;
+        mFaceList.reserve(triNum);
+        int invalidNum = 0;
+        for (int tid = 0; tid < triNum; tid++)
+        {
+            FaceIndex fi;
+            bool isValid = true;
+            for (int k = 0; k < 3; k++)
+            {
+                fi.mIndex[k] = indexList.at(3 * tid + k);
+                if (fi.mIndex[k] < 0 || fi.mIndex[k] >= vertNum)
+                {
+                    isValid = false;
+                }
+            }
+            if (!isValid)
+            {
+                invalidNum++;
+                continue;
+            }
+            mFaceList.push_back(fi);
+        }
+        if (invalidNum > 0)
+        {
+            WarnLog << "LightMesh3D::BuildFromIndexedTriangles: invalid triangle number: " << invalidNum << std::endl;
+        }
     }
 
-    const Vertex3D* LightMesh3D::GetVertex(int index) const
+    void LightMesh3D::Reserve(int vertNum, int faceNum)
     {
-        return mVertexList.at(index);
+        mPositionList.reserve(vertNum);
+        mFaceList.reserve(faceNum);
+    }
+
+    int LightMesh3D::InsertVertex(const MagicMath::Vector3& pos)
+    {
+        mPositionList.push_back(pos);
+        if (!mNormalList.empty())
+        {
+            mNormalList.push_back(LightMeshDefaultNormal);
+        }
+        if (!mColorList.empty())
+        {
+            mColorList.push_back(LightMeshDefaultColor);
+        }
+        if (!mTexCordList.empty())
+        {
+            mTexCordList.push_back(LightMeshDefaultTexCord);
+        }
+        return mPositionList.size() - 1;
+    }
+
+    void LightMesh3D::InsertFace(const FaceIndex& fi)
+    {
+        mFaceList.push_back(fi);
     }
 
     const FaceIndex LightMesh3D::GetFace(int index) const
@@ -639,7 +1071,7 @@ namespace MagicDGP
 
     int LightMesh3D::GetVertexNumber() const
     {
-        return mVertexList.size();
+        return mPositionList.size();
     }
 
     int LightMesh3D::GetFaceNumber() const
@@ -647,26 +1079,110 @@ namespace MagicDGP
         return mFaceList.size();
     }
 
-    Vertex3D* LightMesh3D::InsertVertex(const MagicMath::Vector3& pos)
+    MagicMath::Vector3 LightMesh3D::GetPosition(int index) const
     {
-        Vertex3D* pVert = new Vertex3D(pos);
-        pVert->SetId(mVertexList.size());
-        mVertexList.push_back(pVert);
-        return pVert;
+        return mPositionList.at(index);
     }
 
-    void LightMesh3D::InsertFace(const FaceIndex& fi)
+    void LightMesh3D::SetPosition(int index, const MagicMath::Vector3& pos)
     {
-        mFaceList.push_back(fi);
+        mPositionList.at(index) = pos;
+    }
+
+    MagicMath::Vector3 LightMesh3D::GetNormal(int index) const
+    {
+        return mNormalList.empty() ? LightMeshDefaultNormal : mNormalList.at(index);
+    }
+
+    void LightMesh3D::SetNormal(int index, const MagicMath::Vector3& nor)
+    {
+        if (mNormalList.empty())
+        {
+            mNormalList.resize(mPositionList.size(), LightMeshDefaultNormal);
+        }
+        mNormalList.at(index) = nor;
+    }
+
+    MagicMath::Vector3 LightMesh3D::GetColor(int index) const
+    {
+        return mColorList.empty() ? LightMeshDefaultColor : mColorList.at(index);
+    }
+
+    void LightMesh3D::SetColor(int index, const MagicMath::Vector3& color)
+    {
+        if (mColorList.empty())
+        {
+            mColorList.resize(mPositionList.size(), LightMeshDefaultColor);
+        }
+        mColorList.at(index) = color;
+    }
+
+    MagicMath::Vector3 LightMesh3D::GetTexCord(int index) const
+    {
+        return mTexCordList.empty() ? LightMeshDefaultTexCord : mTexCordList.at(index);
+    }
+
+    void LightMesh3D::SetTexCord(int index, const MagicMath::Vector3& tex)
+    {
+        if (mTexCordList.empty())
+        {
+            mTexCordList.resize(mPositionList.size(), LightMeshDefaultTexCord);
+        }
+        mTexCordList.at(index) = tex;
+    }
+
+    bool LightMesh3D::HasNormal() const
+    {
+        return !mNormalList.empty();
+    }
+
+    bool LightMesh3D::HasColor() const
+    {
+        return !mColorList.empty();
+    }
+
+    bool LightMesh3D::HasTexCord() const
+    {
+        return !mTexCordList.empty();
+    }
+
+    bool LightMesh3D::SetNormalList(const std::vector<MagicMath::Vector3>& norList)
+    {
+        if (norList.size() != mPositionList.size())
+        {
+            return false;
+        }
+        mNormalList = norList;
+        return true;
+    }
+
+    bool LightMesh3D::SetColorList(const std::vector<MagicMath::Vector3>& colorList)
+    {
+        if (colorList.size() != mPositionList.size())
+        {
+            return false;
+        }
+        mColorList = colorList;
+        return true;
+    }
+
+    bool LightMesh3D::SetTexCordList(const std::vector<MagicMath::Vector3>& texList)
+    {
+        if (texList.size() != mPositionList.size())
+        {
+            return false;
+        }
+        mTexCordList = texList;
+        return true;
     }
 
     void LightMesh3D::UnifyPosition(double size)
     {
         MagicMath::Vector3 posMin(10e10, 10e10, 10e10);
         MagicMath::Vector3 posMax(-10e10, -10e10, -10e10);
-        for (std::vector<Vertex3D* >::iterator itr = mVertexList.begin(); itr != mVertexList.end(); ++itr)
+        for (std::vector<MagicMath::Vector3>::iterator itr = mPositionList.begin(); itr != mPositionList.end(); ++itr)
         {
-            MagicMath::Vector3 pos = (*itr)->GetPosition();
+            MagicMath::Vector3 pos = *itr;
             posMin[0] = posMin[0] < pos[0] ? posMin[0] : pos[0];
             posMin[1] = posMin[1] < pos[1] ? posMin[1] : pos[1];
             posMin[2] = posMin[2] < pos[2] ? posMin[2] : pos[2];
@@ -688,24 +1204,24 @@ namespace MagicDGP
         {
             double scaleV = size / scaleMax;
             MagicMath::Vector3 centerPos = (posMin + posMax) / 2.0;
-            for (std::vector<Vertex3D* >::iterator itr = mVertexList.begin(); itr != mVertexList.end(); ++itr)
+            for (std::vector<MagicMath::Vector3>::iterator itr = mPositionList.begin(); itr != mPositionList.end(); ++itr)
             {
-                (*itr)->SetPosition(((*itr)->GetPosition() - centerPos) * scaleV);
+                *itr = (*itr - centerPos) * scaleV;
             }
         }
     }
 
     void LightMesh3D::UpdateNormal()
     {
-        int vertNum = mVertexList.size();
+        int vertNum = mPositionList.size();
         std::vector<MagicMath::Vector3> normList(vertNum, MagicMath::Vector3(0, 0, 0));
         int faceNum = mFaceList.size();
         for (int fid = 0; fid < faceNum; fid++)
         {
             FaceIndex faceIdx = mFaceList.at(fid);
-            MagicMath::Vector3 pos0 = mVertexList.at(faceIdx.mIndex[0])->GetPosition();
-            MagicMath::Vector3 pos1 = mVertexList.at(faceIdx.mIndex[1])->GetPosition();
-            MagicMath::Vector3 pos2 = mVertexList.at(faceIdx.mIndex[2])->GetPosition();
+            MagicMath::Vector3 pos0 = mPositionList.at(faceIdx.mIndex[0]);
+            MagicMath::Vector3 pos1 = mPositionList.at(faceIdx.mIndex[1]);
+            MagicMath::Vector3 pos2 = mPositionList.at(faceIdx.mIndex[2]);
             MagicMath::Vector3 faceNorm = (pos1 - pos0).CrossProduct(pos2 - pos0);
             normList.at(faceIdx.mIndex[0]) += faceNorm;
             normList.at(faceIdx.mIndex[1]) += faceNorm;
@@ -716,24 +1232,19 @@ namespace MagicDGP
             double norLen = normList.at(vid).Normalise();
             if (norLen < 1.0e-15)
             {
-                DebugLog << "normal lenth too small" << std::endl;
+                AsyncDebugLogSite(gSmallNormalLogSite) << "normal lenth too small" << std::endl;
                 normList.at(vid)[0] = 1.0;
             }
-            mVertexList.at(vid)->SetNormal(normList.at(vid));
         }
+        mNormalList.swap(normList);
     }
 
     void LightMesh3D::ClearData()
     {
-        for (std::vector<Vertex3D* >::iterator itr = mVertexList.begin(); itr != mVertexList.end(); ++itr)
-        {
-            if (*itr != NULL)
-            {
-                delete *itr;
-                *itr = NULL;
-            }
-        }
-        mVertexList.clear();
-        mFaceList.clear();
+        std::vector<MagicMath::Vector3>().swap(mPositionList);
+        std::vector<MagicMath::Vector3>().swap(mNormalList);
+        std::vector<MagicMath::Vector3>().swap(mColorList);
+        std::vector<MagicMath::Vector3>().swap(mTexCordList);
+        std::vector<FaceIndex>().swap(mFaceList);
     }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Math/Vector3.h"
+#include "ObjectPool.h"
 #include <vector>
 #include <map>
 
@@ -139,6 +140,13 @@ namespace MagicDGP
         Vertex3D* InsertVertex(const MagicMath::Vector3& pos);
         Edge3D*   InsertEdge(Vertex3D* pVertStart, Vertex3D* pVertEnd);
         Face3D*   InsertFace(const std::vector<Vertex3D* >& vertList);
+        //Build the whole mesh at once, indexList holds three vertex indices per triangle.
+        //Edges are paired by sorting and boundary is linked, mEdgeMap is not filled.
+        void BuildFromIndexedTriangles(const std::vector<MagicMath::Vector3>& posList, const std::vector<int>& indexList);
+        //Build from stored half edge connectivity without pairing. pPosition holds three doubles per vertex,
+        //pEdgeTopology holds vertex, pair, next, pre and face id per edge, -1 for NULL.
+        bool BuildFromHalfEdges(int vertNum, const double* pPosition, const int* pVertexEdge,
+            int edgeNum, const int* pEdgeTopology, int faceNum, const int* pFaceEdge);
 
         void UnifyPosition(double size);
         void UpdateNormal();
@@ -153,6 +161,9 @@ namespace MagicDGP
         std::vector<Edge3D* >   mEdgeList;
         std::vector<Face3D* >   mFaceList;
         std::map<std::pair<Vertex3D*, Vertex3D*>, Edge3D* > mEdgeMap; //Only used in construct mesh
+        ObjectPool<Vertex3D> mVertexPool;
+        ObjectPool<Edge3D> mEdgePool;
+        ObjectPool<Face3D> mFacePool;
         MagicMath::Vector3 mBBoxMin, mBBoxMax;
     };
 
@@ -161,27 +172,49 @@ namespace MagicDGP
         int mIndex[3];
     };
 
-    class LightMesh3D
-    {
-    public:
-        LightMesh3D();
-        ~LightMesh3D();
-
-        Vertex3D* GetVertex(int index);
-        const Vertex3D* GetVertex(int index) const;
-        const FaceIndex GetFace(int index) const;
-        int GetVertexNumber() const;
-        int GetFaceNumber() const;
-
-        Vertex3D* InsertVertex(const MagicMath::Vector3& pos);
-        void InsertFace(const FaceIndex& fi);
-
-        void UnifyPosition(double size);
-        void UpdateNormal();
-        void ClearData();
-
-    private:
-        std::vector<Vertex3D*> mVertexList;
-        std::vector<FaceIndex> mFaceList;
-    };
+    //Indexed triangle mesh without connectivity. Vertex attributes are kept in one array per channel,
+    //normal, color and texture coordinate arrays are allocated by their first Set only.
+    class LightMesh3D
+    {
+    public:
+        LightMesh3D();
+        ~LightMesh3D();
+
+        //3 vertex indices per triangle, attribute channels are cleared
+        void BuildFromIndexedTriangles(const std::vector<MagicMath::Vector3>& posList, const std::vector<int>& indexList);
+        void Reserve(int vertNum, int faceNum);
+        int  InsertVertex(const MagicMath::Vector3& pos);
+        void InsertFace(const FaceIndex& fi);
+        const FaceIndex GetFace(int index) const;
+        int GetVertexNumber() const;
+        int GetFaceNumber() const;
+
+        MagicMath::Vector3 GetPosition(int index) const;
+        void SetPosition(int index, const MagicMath::Vector3& pos);
+        //Get of a missing channel returns the Vertex3D default
+        MagicMath::Vector3 GetNormal(int index) const;
+        void SetNormal(int index, const MagicMath::Vector3& nor);
+        MagicMath::Vector3 GetColor(int index) const;
+        void SetColor(int index, const MagicMath::Vector3& color);
+        MagicMath::Vector3 GetTexCord(int index) const;
+        void SetTexCord(int index, const MagicMath::Vector3& tex);
+        bool HasNormal() const;
+        bool HasColor() const;
+        bool HasTexCord() const;
+        //Replace a channel, lists without one entry per vertex are ignored and return false
+        bool SetNormalList(const std::vector<MagicMath::Vector3>& norList);
+        bool SetColorList(const std::vector<MagicMath::Vector3>& colorList);
+        bool SetTexCordList(const std::vector<MagicMath::Vector3>& texList);
+
+        void UnifyPosition(double size);
+        void UpdateNormal();
+        void ClearData();
+
+    private:
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mColorList;
+        std::vector<MagicMath::Vector3> mTexCordList;
+        std::vector<FaceIndex> mFaceList;
+    };
 }
\ No newline at end of file
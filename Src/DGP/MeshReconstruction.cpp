@@ -1,6 +1,16 @@
 //#include "StdAfx.h"
 #include "MeshReconstruction.h"
+#include "../Common/Profiler.h"
+#include "Tool/LogSystem.h"
+
+//Build switch, the vendored PoissonRecon is left out with MAGIC_POISSON 0
+#ifndef MAGIC_POISSON
+#define MAGIC_POISSON 1
+#endif
+
+#if MAGIC_POISSON
 #include "../Dependence/PoissonReconstruction.h"
+#endif
 
 namespace MagicDGP
 {
@@ -14,6 +24,17 @@ namespace MagicDGP
 
     LightMesh3D* MeshReconstruction::ScreenPoissonReconstruction(const Point3DSet* pPC)
     {
+        PROFILE_ZONE("Reconstruction::ScreenPoisson");
+#if MAGIC_POISSON
         return MagicDependence::PoissonReconstruction::ScreenPoissonRecon(pPC);
+#else
+        ErrorLog << "MeshReconstruction::ScreenPoissonReconstruction: built without PoissonRecon" << std::endl;
+        return NULL;
+#endif
+    }
+
+    bool MeshReconstruction::IsScreenPoissonAvailable()
+    {
+        return MAGIC_POISSON != 0;
     }
 }
\ No newline at end of file
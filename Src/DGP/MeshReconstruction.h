@@ -11,6 +11,8 @@ namespace MagicDGP
         ~MeshReconstruction();
 
         static LightMesh3D* ScreenPoissonReconstruction(const Point3DSet* pPC);
+        //False in builds without PoissonRecon, ScreenPoissonReconstruction returns NULL then
+        static bool IsScreenPoissonAvailable();
 
     private:
 
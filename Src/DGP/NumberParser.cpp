@@ -0,0 +1,167 @@
+#include "NumberParser.h"
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+
+namespace MagicDGP
+{
+    //Powers of ten which are exact in double
+    static const double ExactPowerTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    static inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    //Integers up to 15 digits are exact in double
+    static const int MaxExactDigitNum = 15;
+
+    //strtod on a null terminated copy of at most 63 characters of the token, NULL if it is not a number
+    static const char* ParseDoubleByStrtod(const char* pStart, const char* pEnd, double& value)
+    {
+        char buffer[64];
+        int length = 0;
+        while (pStart + length < pEnd && length < 63 && !IsSpace(pStart[length]) && pStart[length] != '\n')
+        {
+            buffer[length] = pStart[length];
+            length++;
+        }
+        buffer[length] = '\0';
+        char* pStop = NULL;
+        value = strtod(buffer, &pStop);
+        if (pStop == buffer)
+        {
+            return NULL;
+        }
+        return pStart + (pStop - buffer);
+    }
+
+    const char* NumberParser::SkipSpace(const char* pStart, const char* pEnd)
+    {
+        while (pStart < pEnd && IsSpace(*pStart))
+        {
+            pStart++;
+        }
+        return pStart;
+    }
+
+    const char* NumberParser::SkipToken(const char* pStart, const char* pEnd)
+    {
+        while (pStart < pEnd && !IsSpace(*pStart) && *pStart != '\n')
+        {
+            pStart++;
+        }
+        return pStart;
+    }
+
+    const char* NumberParser::ParseDouble(const char* pStart, const char* pEnd, double& value)
+    {
+        const char* pCur = pStart;
+        bool negative = false;
+        if (pCur < pEnd && (*pCur == '-' || *pCur == '+'))
+        {
+            negative = (*pCur == '-');
+            pCur++;
+        }
+        double mantissa = 0;
+        int exponent = 0;
+        int digitNum = 0;
+        int significantNum = 0; //digits from the first nonzero one
+        while (pCur < pEnd && IsDigit(*pCur))
+        {
+            mantissa = mantissa * 10 + (*pCur - '0');
+            digitNum++;
+            significantNum += (mantissa != 0);
+            pCur++;
+        }
+        if (pCur < pEnd && *pCur == '.')
+        {
+            pCur++;
+            while (pCur < pEnd && IsDigit(*pCur))
+            {
+                mantissa = mantissa * 10 + (*pCur - '0');
+                exponent--;
+                digitNum++;
+                significantNum += (mantissa != 0);
+                pCur++;
+            }
+        }
+        if (digitNum == 0)
+        {
+            //inf, nan and other rare forms
+            return ParseDoubleByStrtod(pStart, pEnd, value);
+        }
+        if (pCur < pEnd && (*pCur == 'e' || *pCur == 'E'))
+        {
+            const char* pExp = pCur + 1;
+            int expValue = 0;
+            const char* pExpEnd = ParseInt(pExp, pEnd, expValue);
+            if (pExpEnd != NULL)
+            {
+                //Beyond this the value is inf or 0 anyway, and the sum cannot overflow
+                expValue = expValue > 100000 ? 100000 : (expValue < -100000 ? -100000 : expValue);
+                exponent += expValue;
+                pCur = pExpEnd;
+            }
+        }
+        if (significantNum > MaxExactDigitNum || exponent > 22 || exponent < -22)
+        {
+            //The product below would round twice, strtod rounds once, so 17 digit text reads back to the same double
+            double strtodValue = 0;
+            const char* pStop = ParseDoubleByStrtod(pStart, pEnd, strtodValue);
+            if (pStop == pCur)
+            {
+                value = strtodValue;
+                return pCur;
+            }
+        }
+        if (exponent >= 0)
+        {
+            mantissa *= (exponent <= 22) ? ExactPowerTen[exponent] : pow(10.0, exponent);
+        }
+        else
+        {
+            mantissa /= (exponent >= -22) ? ExactPowerTen[-exponent] : pow(10.0, -exponent);
+        }
+        value = negative ? -mantissa : mantissa;
+        return pCur;
+    }
+
+    const char* NumberParser::ParseInt(const char* pStart, const char* pEnd, int& value)
+    {
+        const char* pCur = pStart;
+        bool negative = false;
+        if (pCur < pEnd && (*pCur == '-' || *pCur == '+'))
+        {
+            negative = (*pCur == '-');
+            pCur++;
+        }
+        if (pCur == pEnd || !IsDigit(*pCur))
+        {
+            return NULL;
+        }
+        //Accumulated wider than int and clamped to the int range, the digits of a long run are still consumed
+        long long limit = negative ? -(long long)INT_MIN : (long long)INT_MAX;
+        long long result = 0;
+        while (pCur < pEnd && IsDigit(*pCur))
+        {
+            if (result <= limit)
+            {
+                result = result * 10 + (*pCur - '0');
+            }
+            pCur++;
+        }
+        if (result > limit)
+        {
+            result = limit;
+        }
+        value = int(negative ? -result : result);
+        return pCur;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace MagicDGP
+{
+    //Locale free number parsing on a character range which is not null terminated.
+    //Parse functions return the position after the number, or NULL if there is no number.
+    //ParseInt clamps values out of the int range.
+    class NumberParser
+    {
+    public:
+        static const char* SkipSpace(const char* pStart, const char* pEnd);
+        static const char* SkipToken(const char* pStart, const char* pEnd);
+        static const char* ParseDouble(const char* pStart, const char* pEnd, double& value);
+        static const char* ParseInt(const char* pStart, const char* pEnd, int& value);
+    };
+}
@@ -0,0 +1,260 @@
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include "NumberParser.h"
+#include "Tool/LogSystem.h"
+#include "../Common/Parallel.h"
+#include "../Common/ToolKit.h"
+#include <string.h>
+
+namespace
+{
+    //Parse result of a range of lines
+    struct ObjChunk
+    {
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mTexcordList;
+        std::vector<int> mIndexList;
+        //Entries of mIndexList given by negative index, they are relative to the chunk start until merge
+        std::vector<int> mRelativeList;
+    };
+
+    //Missing components are 0, so that a bad line does not shift the index of following elements
+    MagicMath::Vector3 ParseVector(const char* pCur, const char* pEnd)
+    {
+        MagicMath::Vector3 vec(0, 0, 0);
+        for (int i = 0; i < 3; i++)
+        {
+            pCur = MagicDGP::NumberParser::SkipSpace(pCur, pEnd);
+            double value = 0;
+            const char* pNext = MagicDGP::NumberParser::ParseDouble(pCur, pEnd, value);
+            if (pNext == NULL)
+            {
+                break;
+            }
+            vec[i] = value;
+            pCur = pNext;
+        }
+        return vec;
+    }
+
+    void ParseFace(const char* pCur, const char* pEnd, ObjChunk& chunk, std::vector<int>& faceIndex, std::vector<bool>& faceRelative)
+    {
+        faceIndex.clear();
+        faceRelative.clear();
+        int localVertNum = chunk.mPositionList.size();
+        while (true)
+        {
+            pCur = MagicDGP::NumberParser::SkipSpace(pCur, pEnd);
+            if (pCur == pEnd)
+            {
+                break;
+            }
+            int index = 0;
+            const char* pNext = MagicDGP::NumberParser::ParseInt(pCur, pEnd, index);
+            if (pNext == NULL)
+            {
+                break;
+            }
+            if (index > 0)
+            {
+                faceIndex.push_back(index - 1);
+                faceRelative.push_back(false);
+            }
+            else if (index < 0)
+            {
+                faceIndex.push_back(localVertNum + index);
+                faceRelative.push_back(true);
+            }
+            else
+            {
+                faceIndex.push_back(-1);
+                faceRelative.push_back(false);
+            }
+            //skip texture and normal index: v/vt/vn
+            pCur = MagicDGP::NumberParser::SkipToken(pNext, pEnd);
+        }
+        //fan triangulation
+        int cornerNum = faceIndex.size();
+        for (int cid = 1; cid + 1 < cornerNum; cid++)
+        {
+            int corners[3] = {0, cid, cid + 1};
+            for (int k = 0; k < 3; k++)
+            {
+                if (faceRelative.at(corners[k]))
+                {
+                    chunk.mRelativeList.push_back(chunk.mIndexList.size());
+                }
+                chunk.mIndexList.push_back(faceIndex.at(corners[k]));
+            }
+        }
+    }
+
+    void ParseObjChunk(const char* pStart, const char* pEnd, ObjChunk& chunk)
+    {
+        std::vector<int> faceIndex;
+        std::vector<bool> faceRelative;
+        const char* pLine = pStart;
+        while (pLine < pEnd)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(pLine, '\n', pEnd - pLine));
+            if (pLineEnd == NULL)
+            {
+                pLineEnd = pEnd;
+            }
+            const char* pCur = MagicDGP::NumberParser::SkipSpace(pLine, pLineEnd);
+            if (pLineEnd - pCur > 1)
+            {
+                char tag = pCur[0];
+                char tagNext = pCur[1];
+                bool tagEnd = (tagNext == ' ' || tagNext == '\t');
+                if (tag == 'v' && tagEnd)
+                {
+                    chunk.mPositionList.push_back(ParseVector(pCur + 1, pLineEnd));
+                }
+                else if (tag == 'v' && tagNext == 'n')
+                {
+                    chunk.mNormalList.push_back(ParseVector(pCur + 2, pLineEnd));
+                }
+                else if (tag == 'v' && tagNext == 't')
+                {
+                    chunk.mTexcordList.push_back(ParseVector(pCur + 2, pLineEnd));
+                }
+                else if (tag == 'f' && tagEnd)
+                {
+                    ParseFace(pCur + 1, pLineEnd, chunk, faceIndex, faceRelative);
+                }
+            }
+            pLine = pLineEnd + 1;
+        }
+    }
+
+    template <class T>
+    void AppendList(std::vector<T>& targetList, std::vector<T>& sourceList)
+    {
+        targetList.insert(targetList.end(), sourceList.begin(), sourceList.end());
+        std::vector<T>().swap(sourceList);
+    }
+}
+
+namespace MagicDGP
+{
+    //Files smaller than this are parsed in the calling thread
+    static const size_t MinChunkSize = 1 << 20;
+
+    ObjReader::ObjReader()
+    {
+    }
+
+    ObjReader::~ObjReader()
+    {
+    }
+
+    bool ObjReader::Read(const std::string& fileName)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        ClearData();
+        MappedFile mappedFile;
+        if (!mappedFile.Open(fileName))
+        {
+            return false;
+        }
+        const char* pData = mappedFile.GetData();
+        size_t dataSize = mappedFile.GetSize();
+        int threadCount = MagicCore::GetParallelThreadNumber();
+        int chunkNum = threadCount * 4;
+        if (dataSize / MinChunkSize < (size_t)chunkNum)
+        {
+            chunkNum = int(dataSize / MinChunkSize) + 1;
+        }
+        //chunk boundaries are moved to the next line start
+        std::vector<const char*> boundaryList(chunkNum + 1);
+        boundaryList.at(0) = pData;
+        boundaryList.at(chunkNum) = pData + dataSize;
+        for (int cid = 1; cid < chunkNum; cid++)
+        {
+            const char* pBoundary = pData + dataSize / chunkNum * cid;
+            if (pBoundary < boundaryList.at(cid - 1))
+            {
+                pBoundary = boundaryList.at(cid - 1);
+            }
+            const char* pLineEnd = static_cast<const char*>(memchr(pBoundary, '\n', pData + dataSize - pBoundary));
+            boundaryList.at(cid) = (pLineEnd == NULL) ? pData + dataSize : pLineEnd + 1;
+        }
+        std::vector<ObjChunk> chunkList(chunkNum);
+        if (chunkNum == 1)
+        {
+            ParseObjChunk(boundaryList.at(0), boundaryList.at(1), chunkList.at(0));
+        }
+        else
+        {
+            MagicCore::ParallelFor(0, chunkNum, [&](int startChunk, int endChunk)
+            {
+                for (int cid = startChunk; cid < endChunk; cid++)
+                {
+                    ParseObjChunk(boundaryList.at(cid), boundaryList.at(cid + 1), chunkList.at(cid));
+                }
+            }, 1);
+        }
+        //merge in file order
+        int vertNum = 0, norNum = 0, texNum = 0, indexNum = 0;
+        for (int cid = 0; cid < chunkNum; cid++)
+        {
+            vertNum += chunkList.at(cid).mPositionList.size();
+            norNum += chunkList.at(cid).mNormalList.size();
+            texNum += chunkList.at(cid).mTexcordList.size();
+            indexNum += chunkList.at(cid).mIndexList.size();
+        }
+        mPositionList.reserve(vertNum);
+        mNormalList.reserve(norNum);
+        mTexcordList.reserve(texNum);
+        mIndexList.reserve(indexNum);
+        int vertOffset = 0;
+        for (int cid = 0; cid < chunkNum; cid++)
+        {
+            ObjChunk& chunk = chunkList.at(cid);
+            int relativeNum = chunk.mRelativeList.size();
+            for (int rid = 0; rid < relativeNum; rid++)
+            {
+                int& index = chunk.mIndexList.at(chunk.mRelativeList.at(rid));
+                index = (index + vertOffset < 0) ? -1 : index + vertOffset;
+            }
+            vertOffset += chunk.mPositionList.size();
+            AppendList(mPositionList, chunk.mPositionList);
+            AppendList(mNormalList, chunk.mNormalList);
+            AppendList(mTexcordList, chunk.mTexcordList);
+            AppendList(mIndexList, chunk.mIndexList);
+        }
+        DebugLog << "ObjReader::Read: " << dataSize / 1048576.0 << "MB in " << chunkNum << " chunks, time: "
+            << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return true;
+    }
+
+    void ObjReader::ClearData()
+    {
+        std::vector<MagicMath::Vector3>().swap(mPositionList);
+        std::vector<MagicMath::Vector3>().swap(mNormalList);
+        std::vector<MagicMath::Vector3>().swap(mTexcordList);
+        std::vector<int>().swap(mIndexList);
+    }
+
+    const std::vector<MagicMath::Vector3>& ObjReader::GetPositionList() const
+    {
+        return mPositionList;
+    }
+
+    const std::vector<MagicMath::Vector3>& ObjReader::GetNormalList() const
+    {
+        return mNormalList;
+    }
+
+    const std::vector<MagicMath::Vector3>& ObjReader::GetTexcordList() const
+    {
+        return mTexcordList;
+    }
+
+    const std::vector<int>& ObjReader::GetIndexList() const
+    {
+        return mIndexList;
+    }
+}
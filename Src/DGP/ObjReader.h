@@ -0,0 +1,31 @@
+#pragma once
+#include "Math/Vector3.h"
+#include <vector>
+#include <string>
+
+namespace MagicDGP
+{
+    //OBJ reader for large files. The file is memory mapped and split into newline aligned chunks,
+    //chunks are parsed by all processors and merged in file order.
+    class ObjReader
+    {
+    public:
+        ObjReader();
+        ~ObjReader();
+
+        bool Read(const std::string& fileName);
+        void ClearData();
+
+        const std::vector<MagicMath::Vector3>& GetPositionList() const;
+        const std::vector<MagicMath::Vector3>& GetNormalList() const;
+        const std::vector<MagicMath::Vector3>& GetTexcordList() const;
+        //3 vertex indices per triangle, polygons are fan triangulated. Invalid index is -1
+        const std::vector<int>& GetIndexList() const;
+
+    private:
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mTexcordList;
+        std::vector<int> mIndexList;
+    };
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <new>
+
+namespace MagicDGP
+{
+    //Slab allocator for small objects which are created one by one and released together.
+    //Objects are never freed separately, Clear() destroys all of them and frees the slabs.
+    template <class T>
+    class ObjectPool
+    {
+    public:
+        ObjectPool(int blockSize = 4096) :
+            mBlockSize(blockSize),
+            mCurrentCount(0)
+        {
+        }
+
+        ~ObjectPool()
+        {
+            Clear();
+        }
+
+        T* Create()
+        {
+            return new(Allocate()) T;
+        }
+
+        template <class A>
+        T* Create(const A& a)
+        {
+            return new(Allocate()) T(a);
+        }
+
+        template <class A, class B>
+        T* Create(const A& a, const B& b)
+        {
+            return new(Allocate()) T(a, b);
+        }
+
+        template <class A, class B, class C>
+        T* Create(const A& a, const B& b, const C& c)
+        {
+            return new(Allocate()) T(a, b, c);
+        }
+
+        //Whether pObj is allocated by this pool
+        bool Owns(const T* pObj) const
+        {
+            const char* pAddress = reinterpret_cast<const char*>(pObj);
+            typename std::vector<BlockRange>::const_iterator itr = std::upper_bound(mBlockRangeList.begin(), mBlockRangeList.end(), pAddress, CompareBlockRange());
+            if (itr == mBlockRangeList.begin())
+            {
+                return false;
+            }
+            --itr;
+            return pAddress < itr->mpStart + mBlockSize * sizeof(T);
+        }
+
+        int GetObjectNumber() const
+        {
+            if (mBlockList.empty())
+            {
+                return 0;
+            }
+            return (mBlockList.size() - 1) * mBlockSize + mCurrentCount;
+        }
+
+        void Clear()
+        {
+            int blockNum = mBlockList.size();
+            for (int bid = 0; bid < blockNum; bid++)
+            {
+                T* pBlock = reinterpret_cast<T*>(mBlockList.at(bid));
+                int objNum = (bid == blockNum - 1) ? mCurrentCount : mBlockSize;
+                for (int oid = 0; oid < objNum; oid++)
+                {
+                    pBlock[oid].~T();
+                }
+                ::operator delete(mBlockList.at(bid));
+            }
+            std::vector<char*>().swap(mBlockList);
+            std::vector<BlockRange>().swap(mBlockRangeList);
+            mCurrentCount = 0;
+        }
+
+    private:
+        struct BlockRange
+        {
+            const char* mpStart;
+        };
+
+        struct CompareBlockRange
+        {
+            bool operator()(const char* pAddress, const BlockRange& range) const
+            {
+                return std::less<const char*>()(pAddress, range.mpStart);
+            }
+        };
+
+        void* Allocate()
+        {
+            if (mBlockList.empty() || mCurrentCount == mBlockSize)
+            {
+                char* pBlock = static_cast<char*>(::operator new(mBlockSize * sizeof(T)));
+                mBlockList.push_back(pBlock);
+                BlockRange range;
+                range.mpStart = pBlock;
+                mBlockRangeList.insert(std::upper_bound(mBlockRangeList.begin(), mBlockRangeList.end(), pBlock, CompareBlockRange()), range);
+                mCurrentCount = 0;
+            }
+            void* pMemory = mBlockList.back() + mCurrentCount * sizeof(T);
+            mCurrentCount++;
+            return pMemory;
+        }
+
+        ObjectPool(const ObjectPool&);
+        ObjectPool& operator = (const ObjectPool&);
+
+    private:
+        int mBlockSize;
+        int mCurrentCount;
+        std::vector<char*> mBlockList;
+        std::vector<BlockRange> mBlockRangeList; //sorted by address, used by Owns
+    };
+}
@@ -0,0 +1,124 @@
+#include "OniFrameSource.h"
+#include "Tool/LogSystem.h"
+#include <math.h>
+
+namespace MagicDGP
+{
+    OniFrameSource::OniFrameSource() :
+        mDevice(),
+        mDepthStream(),
+        mIsOpen(false),
+        mFrameNumber(0),
+        mFrameCurrent(0),
+        mFrameEnd(0),
+        mXZFactor(0),
+        mYZFactor(0)
+    {
+    }
+
+    OniFrameSource::~OniFrameSource()
+    {
+        Close();
+    }
+
+    bool OniFrameSource::Open(const std::string& fileName)
+    {
+        Close();
+        openni::Status rc = openni::OpenNI::initialize();
+        if (rc != openni::STATUS_OK)
+        {
+            ErrorLog << "OniFrameSource::Open: OpenNI initialize failed: " << openni::OpenNI::getExtendedError() << std::endl;
+            return false;
+        }
+        rc = mDevice.open(fileName.c_str());
+        if (rc != openni::STATUS_OK)
+        {
+            ErrorLog << "OniFrameSource::Open failed: " << openni::OpenNI::getExtendedError() << std::endl;
+            return false;
+        }
+        rc = mDepthStream.create(mDevice, openni::SENSOR_DEPTH);
+        if (rc != openni::STATUS_OK)
+        {
+            ErrorLog << "OniFrameSource::Open: DepthStream create failed: " << openni::OpenNI::getExtendedError() << std::endl;
+            mDevice.close();
+            return false;
+        }
+        //No timing of the recording, frames come as fast as they are read
+        openni::PlaybackControl* pPC = mDevice.getPlaybackControl();
+        pPC->setSpeed(-1);
+        pPC->setRepeatEnabled(false);
+        mDepthStream.start();
+        mXZFactor = tan(mDepthStream.getHorizontalFieldOfView() / 2) * 2;
+        mYZFactor = tan(mDepthStream.getVerticalFieldOfView() / 2) * 2;
+        mFrameNumber = pPC->getNumberOfFrames(mDepthStream);
+        mFrameCurrent = 0;
+        mFrameEnd = mFrameNumber;
+        mIsOpen = true;
+        return true;
+    }
+
+    void OniFrameSource::Close()
+    {
+        if (mIsOpen)
+        {
+            mDepthStream.stop();
+            mDepthStream.destroy();
+            mDevice.close();
+            mIsOpen = false;
+        }
+    }
+
+    int OniFrameSource::GetFrameNumber() const
+    {
+        return mFrameNumber;
+    }
+
+    void OniFrameSource::SetFrameRange(int frameStart, int frameEnd)
+    {
+        if (!mIsOpen)
+        {
+            return;
+        }
+        mFrameCurrent = frameStart < 0 ? 0 : frameStart;
+        mFrameEnd = frameEnd > mFrameNumber ? mFrameNumber : frameEnd;
+        if (mFrameCurrent < mFrameEnd)
+        {
+            mDevice.getPlaybackControl()->seek(mDepthStream, mFrameCurrent);
+        }
+    }
+
+    bool OniFrameSource::ReadFrame(DepthFrame& frame)
+    {
+        if (!mIsOpen || mFrameCurrent >= mFrameEnd)
+        {
+            return false;
+        }
+        frame.mFrameId = mFrameCurrent;
+        mFrameCurrent++;
+        openni::VideoFrameRef depthFrame;
+        if (mDepthStream.readFrame(&depthFrame) != openni::STATUS_OK || !depthFrame.isValid())
+        {
+            //An empty frame is skipped by the converter
+            WarnLog << "OniFrameSource::ReadFrame: invalid frame " << frame.mFrameId << std::endl;
+            frame.mResolutionX = 0;
+            frame.mResolutionY = 0;
+            frame.mDepthList.clear();
+            return true;
+        }
+        frame.mResolutionX = depthFrame.getVideoMode().getResolutionX();
+        frame.mResolutionY = depthFrame.getVideoMode().getResolutionY();
+        const openni::DepthPixel* pDepth = static_cast<const openni::DepthPixel*>(depthFrame.getData());
+        frame.mDepthList.assign(pDepth, pDepth + frame.mResolutionX * frame.mResolutionY);
+        return true;
+    }
+
+    double OniFrameSource::GetXZFactor() const
+    {
+        return mXZFactor;
+    }
+
+    double OniFrameSource::GetYZFactor() const
+    {
+        return mYZFactor;
+    }
+}
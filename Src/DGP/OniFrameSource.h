@@ -0,0 +1,36 @@
+#pragma once
+#include "DepthFramePipeline.h"
+#include "OpenNI.h"
+#include <string>
+
+namespace MagicDGP
+{
+    //Depth frames of an ONI recording, read in order without seeking each frame.
+    //Open initializes OpenNI, which is reference counted in OpenNI2.
+    class OniFrameSource : public DepthFrameSource
+    {
+    public:
+        OniFrameSource();
+        virtual ~OniFrameSource();
+
+        bool Open(const std::string& fileName);
+        void Close();
+        int  GetFrameNumber() const;
+        //Frames in [frameStart, frameEnd) are read
+        void SetFrameRange(int frameStart, int frameEnd);
+
+        virtual bool ReadFrame(DepthFrame& frame);
+        virtual double GetXZFactor() const;
+        virtual double GetYZFactor() const;
+
+    private:
+        openni::Device mDevice;
+        openni::VideoStream mDepthStream;
+        bool mIsOpen;
+        int mFrameNumber;
+        int mFrameCurrent;
+        int mFrameEnd;
+        double mXZFactor;
+        double mYZFactor;
+    };
+}
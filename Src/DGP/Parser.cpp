@@ -4,13 +4,135 @@
 #include <istream>
 #include <ostream>
 #include <vector>
-#include <set>
 #include <stdio.h>
+#include <string.h>
+#include "ObjReader.h"
+#include "StlReader.h"
+#include "PlyFile.h"
+#include "SnapshotFile.h"
+#include "PointArchive.h"
+#include "BufferedWriter.h"
+#include "MappedFile.h"
+#include "NumberParser.h"
 #include "../Common/ToolKit.h"
 #include "Tool/LogSystem.h"
 
 namespace MagicDGP
 {
+    static int ExportPrecision = 0;
+    static bool IsBackgroundExport = false;
+    static int ArchivePositionBits = 16;
+    static int ArchiveNormalBits = 12;
+
+    static bool OpenExportWriter(BufferedWriter& writer, const std::string& fileName)
+    {
+        if (!writer.Open(fileName, IsBackgroundExport))
+        {
+            return false;
+        }
+        writer.SetPrecision(ExportPrecision);
+        return true;
+    }
+
+    static void WriteVector3(BufferedWriter& writer, const MagicMath::Vector3& vec)
+    {
+        writer.WriteReal(vec[0]);
+        writer.WriteChar(' ');
+        writer.WriteReal(vec[1]);
+        writer.WriteChar(' ');
+        writer.WriteReal(vec[2]);
+    }
+
+    //Next line which is neither empty nor a comment, false at the file end
+    static bool NextOffLine(const char*& pCur, const char* pEnd, const char*& pLine, const char*& pLineEnd)
+    {
+        while (pCur < pEnd)
+        {
+            pLineEnd = static_cast<const char*>(memchr(pCur, '\n', pEnd - pCur));
+            if (pLineEnd == NULL)
+            {
+                pLineEnd = pEnd;
+            }
+            pLine = NumberParser::SkipSpace(pCur, pLineEnd);
+            pCur = (pLineEnd < pEnd) ? pLineEnd + 1 : pEnd;
+            if (pLine < pLineEnd && *pLine != '#')
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //Positions and fan triangulated faces of a mapped OFF file, extra vertex values are ignored
+    static bool ReadOffTriangles(const std::string& fileName, std::vector<MagicMath::Vector3>& posList, std::vector<int>& indexList)
+    {
+        MappedFile file;
+        if (!file.Open(fileName))
+        {
+            return false;
+        }
+        const char* pCur = file.GetData();
+        const char* pEnd = pCur + file.GetSize();
+        const char* pLine = NULL;
+        const char* pLineEnd = NULL;
+        int vertNum = 0;
+        int faceNum = 0;
+        //counts may follow the keyword on the same line
+        bool isValid = NextOffLine(pCur, pEnd, pLine, pLineEnd);
+        const char* pNum = isValid ? NumberParser::SkipSpace(NumberParser::SkipToken(pLine, pLineEnd), pLineEnd) : NULL;
+        if (isValid && pNum == pLineEnd)
+        {
+            isValid = NextOffLine(pCur, pEnd, pLine, pLineEnd);
+            pNum = pLine;
+        }
+        pNum = isValid ? NumberParser::ParseInt(pNum, pLineEnd, vertNum) : NULL;
+        pNum = (pNum != NULL) ? NumberParser::ParseInt(NumberParser::SkipSpace(pNum, pLineEnd), pLineEnd, faceNum) : NULL;
+        if (pNum == NULL || vertNum < 0 || faceNum < 0)
+        {
+            ErrorLog << "ReadOffTriangles: invalid header " << fileName.c_str() << std::endl;
+            return false;
+        }
+        posList.resize(vertNum);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            pNum = NextOffLine(pCur, pEnd, pLine, pLineEnd) ? pLine : NULL;
+            for (int k = 0; k < 3 && pNum != NULL; k++)
+            {
+                pNum = NumberParser::ParseDouble(NumberParser::SkipSpace(pNum, pLineEnd), pLineEnd, posList[vid][k]);
+            }
+            if (pNum == NULL)
+            {
+                ErrorLog << "ReadOffTriangles: invalid vertex " << vid << std::endl;
+                return false;
+            }
+        }
+        indexList.clear();
+        indexList.reserve(faceNum * 3);
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            int polyNum = 0;
+            pNum = NextOffLine(pCur, pEnd, pLine, pLineEnd) ? NumberParser::ParseInt(pLine, pLineEnd, polyNum) : NULL;
+            int polyIndex[3] = {-1, -1, -1};
+            for (int k = 0; k < polyNum && pNum != NULL; k++)
+            {
+                pNum = NumberParser::ParseInt(NumberParser::SkipSpace(pNum, pLineEnd), pLineEnd, polyIndex[k < 2 ? k : 2]);
+                if (pNum != NULL && k >= 2)
+                {
+                    indexList.push_back(polyIndex[0]);
+                    indexList.push_back(polyIndex[1]);
+                    indexList.push_back(polyIndex[2]);
+                    polyIndex[1] = polyIndex[2];
+                }
+            }
+            if (pNum == NULL)
+            {
+                ErrorLog << "ReadOffTriangles: invalid face " << fid << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
     Parser::Parser()
     {
     }
@@ -21,6 +143,15 @@ namespace MagicDGP
 
     Point3DSet* Parser::ParsePointSet(std::string fileName)
     {
+        //Snapshots are recognised by magic bytes whatever the extension is
+        if (SnapshotFile::IsSnapshot(fileName))
+        {
+            return SnapshotFile::LoadPointSet(fileName);
+        }
+        if (PointArchive::IsArchive(fileName))
+        {
+            return PointArchive::Load(fileName);
+        }
         size_t dotPos = fileName.rfind('.');
         if (dotPos == std::string::npos)
         {
@@ -39,6 +170,10 @@ namespace MagicDGP
         {
             return ParsePointSetByOFF(fileName);
         }
+        else if (extName == std::string("ply"))
+        {
+            return ParsePointSetByPLY(fileName);
+        }
         else
         {
             return NULL;
@@ -48,48 +183,20 @@ namespace MagicDGP
 
     Point3DSet* Parser::ParsePointSetByOBJ(std::string fileName)
     {
-        std::ifstream fin(fileName);
-        std::vector<MagicMath::Vector3> posList;
-        std::vector<MagicMath::Vector3> norList;
-        const int maxSize = 512;
-        char pLine[maxSize];
-        while (fin.getline(pLine, maxSize))
+        ObjReader objReader;
+        if (!objReader.Read(fileName))
         {
-            if (pLine[0] == 'v')
-            {
-                if (pLine[1] == ' ' )
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 pos;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        pos[i] = (double)atof(tok);
-                    }
-                    posList.push_back(pos);
-                }
-                else if (pLine[1] == 'n')
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 nor;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        nor[i] = (double)atof(tok);
-                    }
-                    norList.push_back(nor);
-                }
-            }
+            return NULL;
         }
-        fin.close();
+        const std::vector<MagicMath::Vector3>& posList = objReader.GetPositionList();
+        const std::vector<MagicMath::Vector3>& norList = objReader.GetNormalList();
         Point3DSet* pPSet = new Point3DSet;
         InfoLog << "Vertex number: " << posList.size() << " normal number: " << norList.size() << std::endl;
-        if (norList.size() > 0)
+        if (norList.size() > 0 && norList.size() == posList.size())
         {
             for (int i = 0; i < posList.size(); i++)
             {
-                Point3D* point = new Point3D(posList.at(i), norList.at(i), i);
-                pPSet->InsertPoint(point);
+                pPSet->InsertPoint(posList.at(i), norList.at(i));
             }
             pPSet->SetHasNormal(true);
         }
@@ -97,8 +204,7 @@ namespace MagicDGP
         {
             for (int i = 0; i < posList.size(); i++)
             {
-                Point3D* point = new Point3D(posList.at(i), i);
-                pPSet->InsertPoint(point);
+                pPSet->InsertPoint(posList.at(i));
             }
         }
         return pPSet;
@@ -106,151 +212,19 @@ namespace MagicDGP
 
     Point3DSet* Parser::ParsePointSetBySTL(std::string fileName)
     {
-        //Judge whether it is a binary format.
-        //If it is binary there are 80 char of comment, the number fn of faces and then exactly fn*4*3 bytes.
         DebugLog << "ParsePointSetBySTL file name: " << fileName.c_str() << std::endl;
-        int stlLabelSize = 80;
-        bool isBinary=false;
-        FILE *fp = fopen(fileName.c_str(), "r");
-        //Find size of file
-        fseek(fp, 0, SEEK_END);
-        int file_size = ftell(fp);
-        int facenum;
-        /* Check for binary or ASCII file */
-        fseek(fp, stlLabelSize, SEEK_SET);
-        fread(&facenum, sizeof(int), 1, fp);
-        int expected_file_size = stlLabelSize + 4 + (sizeof(short)+sizeof(float) * 4) * facenum ;
-        if(file_size ==  expected_file_size) isBinary = true;
-        unsigned char tmpbuf[128];
-        fread(tmpbuf,sizeof(tmpbuf),1,fp);
-        for(unsigned int i = 0; i < sizeof(tmpbuf); i++)
-        {
-            if(tmpbuf[i] > 127)
-            {
-                isBinary=true;
-                break;
-            }
-        }
-        // Now we know if the stl file is ascii or binary.
-        fclose(fp);
-        //
-        Point3DSet* pPointSet = NULL;
-        if (isBinary)
+        StlReader stlReader;
+        if (!stlReader.Read(fileName))
         {
-            FILE *fp = fopen(fileName.c_str(), "rb");
-            if (fp == NULL)
-            {
-                DebugLog << "ParseMesh3dBySTL:: open failed in binary" << std::endl;
-                return NULL;
-            }
-            int faceNum;
-            fseek(fp, stlLabelSize, SEEK_SET);
-            fread(&faceNum, sizeof(int), 1, fp);
-            pPointSet = new Point3DSet;
-            std::set<MagicMath::Vector3> vertPosSet;
-            for (int fid = 0; fid < faceNum; fid++)
-            {
-                unsigned short attr;
-                float xx, yy, zz;
-                //read face normal
-                fread(&xx, sizeof(xx), 1, fp);
-                fread(&yy, sizeof(yy), 1, fp);
-                fread(&zz, sizeof(zz), 1, fp);
-                //read face position
-                std::vector<Vertex3D* > vertList(3);
-                for (int vid = 0; vid < 3; vid++)
-                {
-                    fread(&xx, sizeof(xx), 1, fp);
-                    fread(&yy, sizeof(yy), 1, fp);
-                    fread(&zz, sizeof(zz), 1, fp);
-                    MagicMath::Vector3 pos(xx, yy, zz);
-                    std::pair<std::set<MagicMath::Vector3>::iterator, bool> res = vertPosSet.insert( pos );
-                    if (res.second)
-                    {
-                        Point3D* point = new Point3D(pos);
-                        pPointSet->InsertPoint(point);
-                    }
-                }
-                fread(&attr,sizeof(unsigned short),1,fp);
-            }
-            fclose(fp);
+            return NULL;
         }
-        else
+        const std::vector<MagicMath::Vector3>& posList = stlReader.GetPositionList();
+        Point3DSet* pPointSet = new Point3DSet;
+        for (int i = 0; i < posList.size(); i++)
         {
-            FILE *fp = fopen(fileName.c_str(), "r");
-            if (fp == NULL)
-            {
-                DebugLog << "ParseMesh3dBySTL:: open failed in asic" << std::endl;
-                return NULL;
-            }
-            //skip the first line of the file
-            while (getc(fp) != '\n') 
-            {//Skip the first line of the file 
-            }
-            //read file
-            pPointSet = new Point3DSet;
-            std::set<MagicMath::Vector3> vertPosSet;
-            int currentVertId = 0;
-            while (!feof(fp))
-            {
-                MagicMath::Vector3 faceNorm;
-                float xx, yy, zz;
-                int ret = fscanf(fp, "%*s %*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    continue;
-                }
-                ret = fscanf(fp, "%*s %*s");
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pPointSet;
-                }
-                MagicMath::Vector3 pos0(xx, yy, zz);
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pPointSet;
-                }
-                MagicMath::Vector3 pos1(xx, yy, zz);
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pPointSet;
-                }
-                MagicMath::Vector3 pos2(xx, yy, zz);
-
-                std::pair<std::set<MagicMath::Vector3>::iterator, bool> res = vertPosSet.insert( pos0 );
-                if (res.second)
-                {
-                    Point3D* point = new Point3D(pos0);
-                    pPointSet->InsertPoint(point);
-                }
-                res = vertPosSet.insert( pos1 );
-                if (res.second)
-                {
-                    Point3D* point = new Point3D(pos1);
-                    pPointSet->InsertPoint(point);
-                }
-                res = vertPosSet.insert( pos2 );
-                if (res.second)
-                {
-                    Point3D* point = new Point3D(pos2);
-                    pPointSet->InsertPoint(point);
-                }
-                ret = fscanf(fp, "%*s");
-                ret = fscanf(fp, "%*s");
-                if (feof(fp))
-                {
-                    break;
-                }
-            }
-            fclose(fp);
+            pPointSet->InsertPoint(posList.at(i));
         }
-        InfoLog << "Import Point Number: " << pPointSet->GetPointNumber() << std::endl;
+        InfoLog << "Vertex number: " << pPointSet->GetPointNumber() << std::endl;
         return pPointSet;
     }
 
@@ -275,16 +249,47 @@ namespace MagicDGP
             pos[1] = (double)atof(tok);
             tok = strtok(NULL, " ");
             pos[2] = (double)atof(tok);
-            Point3D* point = new Point3D(pos);
-            pPointSet->InsertPoint(point);
+            pPointSet->InsertPoint(pos);
         }
         InfoLog << "Import Point Number: " << pPointSet->GetPointNumber() << std::endl;
 
         return pPointSet;
     }
 
+    Point3DSet* Parser::ParsePointSetByPLY(std::string fileName)
+    {
+        DebugLog << "ParsePointSetByPLY file name: " << fileName.c_str() << std::endl;
+        PlyReader plyReader;
+        if (!plyReader.Read(fileName))
+        {
+            return NULL;
+        }
+        const std::vector<MagicMath::Vector3>& posList = plyReader.GetPositionList();
+        const std::vector<MagicMath::Vector3>& norList = plyReader.GetNormalList();
+        const std::vector<MagicMath::Vector3>& colorList = plyReader.GetColorList();
+        Point3DSet* pPointSet = new Point3DSet;
+        int pointNum = posList.size();
+        bool hasNormal = (norList.size() == pointNum);
+        for (int i = 0; i < pointNum; i++)
+        {
+            Point3D* pPoint = hasNormal ? pPointSet->InsertPoint(posList.at(i), norList.at(i)) : pPointSet->InsertPoint(posList.at(i));
+            if (colorList.size() == pointNum)
+            {
+                pPoint->SetColor(colorList.at(i));
+            }
+        }
+        pPointSet->SetHasNormal(hasNormal);
+        InfoLog << "Import Point Number: " << pPointSet->GetPointNumber() << std::endl;
+        return pPointSet;
+    }
+
     Mesh3D* Parser::ParseMesh3D(std::string fileName)
     {
+        //Snapshots are recognised by magic bytes whatever the extension is
+        if (SnapshotFile::IsSnapshot(fileName))
+        {
+            return SnapshotFile::LoadMesh3D(fileName);
+        }
         size_t dotPos = fileName.rfind('.');
         if (dotPos == std::string::npos)
         {
@@ -303,6 +308,10 @@ namespace MagicDGP
         {
             return ParseMesh3dByOFF(fileName);
         }
+        else if (extName == std::string("ply"))
+        {
+            return ParseMesh3DByPLY(fileName);
+        }
         else
         {
             return NULL;
@@ -311,6 +320,11 @@ namespace MagicDGP
 
     LightMesh3D* Parser::ParseLightMesh3D(std::string fileName)
     {
+        //Snapshots are recognised by magic bytes whatever the extension is
+        if (SnapshotFile::IsSnapshot(fileName))
+        {
+            return SnapshotFile::LoadLightMesh3D(fileName);
+        }
         size_t dotPos = fileName.rfind('.');
         if (dotPos == std::string::npos)
         {
@@ -329,6 +343,10 @@ namespace MagicDGP
         {
             return ParseLightMesh3dByOFF(fileName);
         }
+        else if (extName == std::string("ply"))
+        {
+            return ParseLightMesh3DByPLY(fileName);
+        }
         else
         {
             return NULL;
@@ -339,66 +357,17 @@ namespace MagicDGP
     {
         //float timeStart = MagicCore::ToolKit::GetTime();
         DebugLog << "ParseMesh3DByOBJ file name: " << fileName.c_str() << std::endl;
-        std::ifstream fin(fileName);
-        const int maxSize = 512;
-        char pLine[maxSize];
-        Mesh3D* pMesh = new Mesh3D;
-        std::vector<MagicMath::Vector3> normalList;
-        std::vector<MagicMath::Vector3> texcordList;
-        while (fin.getline(pLine, maxSize))
+        ObjReader objReader;
+        if (!objReader.Read(fileName))
         {
-            if (pLine[0] == 'v')
-            {
-                if (pLine[1] == ' ' )
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 pos;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        pos[i] = (double)atof(tok);
-                    }
-                    pMesh->InsertVertex(pos);
-                }
-                else if (pLine[1] == 'n')
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 nor;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        nor[i] = (double)atof(tok);
-                    }
-                    normalList.push_back(nor);
-                }
-                else if (pLine[1] == 't')
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 tex;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        tex[i] = (double)atof(tok);
-                    }
-                    texcordList.push_back(tex);
-                }
-            }
-            else if (pLine[0] == 'f' && pLine[1] == ' ')
-            {
-                std::vector<Vertex3D* > vertList(3);
-                char* tok = strtok(pLine, " ");
-                for (int i = 0; i < 3; i++)
-                {
-                    tok = strtok(NULL, " ");
-                    char temp[100];
-                    strcpy(temp, tok);
-                    temp[strcspn(temp, "/")] = 0;
-                    int id = (int)strtol(temp, NULL, 10) - 1;
-                    vertList.at(i) = pMesh->GetVertex(id);
-                }
-                pMesh->InsertFace(vertList);
-            }
+            return NULL;
         }
+        const std::vector<MagicMath::Vector3>& posList = objReader.GetPositionList();
+        const std::vector<int>& indexList = objReader.GetIndexList();
+        const std::vector<MagicMath::Vector3>& normalList = objReader.GetNormalList();
+        const std::vector<MagicMath::Vector3>& texcordList = objReader.GetTexcordList();
+        Mesh3D* pMesh = new Mesh3D;
+        pMesh->BuildFromIndexedTriangles(posList, indexList);
         int vertNum = pMesh->GetVertexNumber();
         InfoLog << "Import Vertex Number: " << vertNum << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
 //        DebugLog << "Parse obj file time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
@@ -422,200 +391,14 @@ namespace MagicDGP
 
     Mesh3D* Parser::ParseMesh3dBySTL(std::string fileName)
     {
-        //Judge whether it is a binary format.
-        //If it is binary there are 80 char of comment, the number fn of faces and then exactly fn*4*3 bytes.
         DebugLog << "ParseMesh3dBySTL file name: " << fileName.c_str() << std::endl;
-        int stlLabelSize = 80;
-        bool isBinary=false;
-        FILE *fp = fopen(fileName.c_str(), "r");
-        //Find size of file
-        fseek(fp, 0, SEEK_END);
-        int file_size = ftell(fp);
-        int facenum;
-        /* Check for binary or ASCII file */
-        fseek(fp, stlLabelSize, SEEK_SET);
-        fread(&facenum, sizeof(int), 1, fp);
-        int expected_file_size = stlLabelSize + 4 + (sizeof(short)+sizeof(float) * 4) * facenum ;
-        if(file_size ==  expected_file_size) isBinary = true;
-        unsigned char tmpbuf[128];
-        fread(tmpbuf,sizeof(tmpbuf),1,fp);
-        for(unsigned int i = 0; i < sizeof(tmpbuf); i++)
-        {
-            if(tmpbuf[i] > 127)
-            {
-                isBinary=true;
-                break;
-            }
-        }
-        // Now we know if the stl file is ascii or binary.
-        fclose(fp);
-        //
-        Mesh3D* pMesh = NULL;
-        if (isBinary)
+        StlReader stlReader;
+        if (!stlReader.Read(fileName))
         {
-            FILE *fp = fopen(fileName.c_str(), "rb");
-            if (fp == NULL)
-            {
-                DebugLog << "ParseMesh3dBySTL:: open failed in binary" << std::endl;
-                return NULL;
-            }
-            int faceNum;
-            fseek(fp, stlLabelSize, SEEK_SET);
-            fread(&faceNum, sizeof(int), 1, fp);
-            pMesh = new Mesh3D;
-            std::map<MagicMath::Vector3, int> vertPosMap;
-            int currentVertId = 0;
-            for (int fid = 0; fid < faceNum; fid++)
-            {
-                unsigned short attr;
-                float xx, yy, zz;
-                //read face normal
-                fread(&xx, sizeof(xx), 1, fp);
-                fread(&yy, sizeof(yy), 1, fp);
-                fread(&zz, sizeof(zz), 1, fp);
-                //read face position
-                MagicMath::Vector3 pos[3];
-                std::set<MagicMath::Vector3> validVertex;
-                for (int vid = 0; vid < 3; vid++)
-                {
-                    fread(&xx, sizeof(xx), 1, fp);
-                    fread(&yy, sizeof(yy), 1, fp);
-                    fread(&zz, sizeof(zz), 1, fp);
-                    pos[vid] = MagicMath::Vector3(xx, yy, zz);
-                    validVertex.insert(pos[vid]);
-                }
-                if (validVertex.size() != 3)
-                {
-                    InfoLog << "Degenerate triangle detect" << std::endl;
-                }
-                else
-                {
-                    std::vector<Vertex3D* > vertList(3);
-                    for (int vid = 0; vid < 3; vid++)
-                    {
-                        /*fread(&xx, sizeof(xx), 1, fp);
-                        fread(&yy, sizeof(yy), 1, fp);
-                        fread(&zz, sizeof(zz), 1, fp);
-                        MagicMath::Vector3 pos(xx, yy, zz);*/
-                        std::pair<std::map<MagicMath::Vector3, int>::iterator, bool> mapRes 
-                            = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos[vid], currentVertId) );
-                        if (mapRes.second)
-                        {
-                            vertList.at(vid) = pMesh->InsertVertex(pos[vid]);
-                            currentVertId++;
-                        }
-                        else
-                        {
-                            vertList.at(vid) = pMesh->GetVertex(vertPosMap[pos[vid]]);
-                        }
-                    }
-                    pMesh->InsertFace(vertList);
-                }
-                
-                fread(&attr,sizeof(unsigned short),1,fp);
-            }
-            fclose(fp);
-        }
-        else
-        {
-            FILE *fp = fopen(fileName.c_str(), "r");
-            if (fp == NULL)
-            {
-                DebugLog << "ParseMesh3dBySTL:: open failed in asic" << std::endl;
-                return NULL;
-            }
-            //skip the first line of the file
-            while (getc(fp) != '\n') 
-            {//Skip the first line of the file 
-            }
-            //read file
-            pMesh = new Mesh3D;
-            std::map<MagicMath::Vector3, int> vertPosMap;
-            int currentVertId = 0;
-            while (!feof(fp))
-            {
-                MagicMath::Vector3 faceNorm;
-                float xx, yy, zz;
-                int ret = fscanf(fp, "%*s %*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    continue;
-                }
-                ret = fscanf(fp, "%*s %*s");
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pMesh;
-                }
-                MagicMath::Vector3 pos0(xx, yy, zz);
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pMesh;
-                }
-                MagicMath::Vector3 pos1(xx, yy, zz);
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pMesh;
-                }
-                MagicMath::Vector3 pos2(xx, yy, zz);
-                //judge whether it is a valid face.
-                std::set<MagicMath::Vector3> validVertex;
-                validVertex.insert(pos0);
-                validVertex.insert(pos1);
-                validVertex.insert(pos2);
-                if (validVertex.size() != 3)
-                {
-                    InfoLog << "Degenerate triangle detect" << std::endl;
-                }//
-                else
-                {
-                    std::vector<Vertex3D* > vertList(3);
-                    std::pair<std::map<MagicMath::Vector3, int>::iterator, bool> mapRes = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos0, currentVertId) );
-                    if (mapRes.second)
-                    {
-                        vertList.at(0) = pMesh->InsertVertex(pos0);
-                        currentVertId++;
-                    }
-                    else
-                    {
-                        vertList.at(0) = pMesh->GetVertex(vertPosMap[pos0]);
-                    }
-                    mapRes = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos1, currentVertId) );
-                    if (mapRes.second)
-                    {
-                        vertList.at(1) = pMesh->InsertVertex(pos1);
-                        currentVertId++;
-                    }
-                    else
-                    {
-                        vertList.at(1) = pMesh->GetVertex(vertPosMap[pos1]);
-                    }
-                    mapRes = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos2, currentVertId) );
-                    if (mapRes.second)
-                    {
-                        vertList.at(2) = pMesh->InsertVertex(pos2);
-                        currentVertId++;
-                    }
-                    else
-                    {
-                        vertList.at(2) = pMesh->GetVertex(vertPosMap[pos2]);
-                    }
-                    pMesh->InsertFace(vertList);
-                }   
-                ret = fscanf(fp, "%*s");
-                ret = fscanf(fp, "%*s");
-                if (feof(fp))
-                {
-                    break;
-                }
-            }
-            fclose(fp);
+            return NULL;
         }
+        Mesh3D* pMesh = new Mesh3D;
+        pMesh->BuildFromIndexedTriangles(stlReader.GetPositionList(), stlReader.GetIndexList());
         InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
         return pMesh;
     }
@@ -623,326 +406,76 @@ namespace MagicDGP
     Mesh3D* Parser::ParseMesh3dByOFF(std::string fileName)
     {
         DebugLog << "ParseMesh3dByOFF file name: " << fileName.c_str() << std::endl;
-        std::ifstream fin(fileName);
-        const int maxSize = 512;
-        char pLine[maxSize];
-        fin.getline(pLine, maxSize);
-        int vertNum, faceNum;
-        fin >> vertNum >> faceNum;
-        fin.getline(pLine, maxSize);
-        Mesh3D* pMesh = new Mesh3D;
-        for (int vid = 0; vid < vertNum; vid++)
-        {
-            MagicMath::Vector3 pos;
-            fin.getline(pLine, maxSize);
-            char* tok = strtok(pLine, " ");
-            pos[0] = (double)atof(tok);
-            tok = strtok(NULL, " ");
-            pos[1] = (double)atof(tok);
-            tok = strtok(NULL, " ");
-            pos[2] = (double)atof(tok);
-            pMesh->InsertVertex(pos);
-        }
-        for (int fid = 0; fid < faceNum; fid++)
+        std::vector<MagicMath::Vector3> posList;
+        std::vector<int> indexList;
+        if (!ReadOffTriangles(fileName, posList, indexList))
         {
-            std::vector<Vertex3D* > vertList(3);
-            fin.getline(pLine, maxSize);
-            int kk;
-            char* tok = strtok(pLine, " ");
-            for (int j = 0; j < 3; j++)
-            {
-                tok = strtok(NULL, " ");
-                kk = atoi(tok);
-                vertList.at(j) = pMesh->GetVertex(kk);
-            }
-            pMesh->InsertFace(vertList);
+            return NULL;
         }
-        InfoLog << "Import Vertex Number: " << vertNum << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
+        Mesh3D* pMesh = new Mesh3D;
+        pMesh->BuildFromIndexedTriangles(posList, indexList);
+        InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
 
         return pMesh;
     }
 
-    LightMesh3D* Parser::ParseLightMesh3DByOBJ(std::string fileName)
+    Mesh3D* Parser::ParseMesh3DByPLY(std::string fileName)
     {
-        //float timeStart = MagicCore::ToolKit::GetTime();
-        DebugLog << "ParseMesh3DByOBJ file name: " << fileName.c_str() << std::endl;
-        std::ifstream fin(fileName);
-        const int maxSize = 512;
-        char pLine[maxSize];
-        LightMesh3D* pMesh = new LightMesh3D;
-        std::vector<MagicMath::Vector3> normalList;
-        std::vector<MagicMath::Vector3> texcordList;
-        while (fin.getline(pLine, maxSize))
+        DebugLog << "ParseMesh3DByPLY file name: " << fileName.c_str() << std::endl;
+        PlyReader plyReader;
+        if (!plyReader.Read(fileName))
         {
-            if (pLine[0] == 'v')
-            {
-                if (pLine[1] == ' ' )
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 pos;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        pos[i] = (double)atof(tok);
-                    }
-                    pMesh->InsertVertex(pos);
-                }
-                else if (pLine[1] == 'n')
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 nor;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        nor[i] = (double)atof(tok);
-                    }
-                    normalList.push_back(nor);
-                }
-                else if (pLine[1] == 't')
-                {
-                    char* tok = strtok(pLine, " ");
-                    MagicMath::Vector3 tex;
-                    for (int i = 0; i < 3; i++)
-                    {
-                        tok = strtok(NULL, " ");
-                        tex[i] = (double)atof(tok);
-                    }
-                    texcordList.push_back(tex);
-                }
-            }
-            else if (pLine[0] == 'f' && pLine[1] == ' ')
-            {
-                FaceIndex faceIdx;
-                char* tok = strtok(pLine, " ");
-                for (int i = 0; i < 3; i++)
-                {
-                    tok = strtok(NULL, " ");
-                    char temp[100];
-                    strcpy(temp, tok);
-                    temp[strcspn(temp, "/")] = 0;
-                    faceIdx.mIndex[i] = (int)strtol(temp, NULL, 10) - 1;
-                }
-                pMesh->InsertFace(faceIdx);
-            }
+            return NULL;
         }
+        const std::vector<MagicMath::Vector3>& normalList = plyReader.GetNormalList();
+        const std::vector<MagicMath::Vector3>& colorList = plyReader.GetColorList();
+        Mesh3D* pMesh = new Mesh3D;
+        pMesh->BuildFromIndexedTriangles(plyReader.GetPositionList(), plyReader.GetIndexList());
         int vertNum = pMesh->GetVertexNumber();
         InfoLog << "Import Vertex Number: " << vertNum << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
-//        DebugLog << "Parse obj file time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
-        if (texcordList.size() == vertNum)
+        if (normalList.size() == vertNum)
         {
             for (int i = 0; i < vertNum; i++)
             {
-                pMesh->GetVertex(i)->SetTexCord(texcordList.at(i));
+                pMesh->GetVertex(i)->SetNormal(normalList.at(i));
             }
         }
-        if (normalList.size() == vertNum)
+        if (colorList.size() == vertNum)
         {
             for (int i = 0; i < vertNum; i++)
             {
-                pMesh->GetVertex(i)->SetNormal(normalList.at(i));
+                pMesh->GetVertex(i)->SetColor(colorList.at(i));
             }
         }
-        //DebugLog << "Parse total time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
         return pMesh;
     }
 
-    LightMesh3D* Parser::ParseLightMesh3dBySTL(std::string fileName)
+    LightMesh3D* Parser::ParseLightMesh3DByOBJ(std::string fileName)
     {
-        //Judge whether it is a binary format.
-        //If it is binary there are 80 char of comment, the number fn of faces and then exactly fn*4*3 bytes.
-        DebugLog << "ParseLightMesh3dBySTL file name: " << fileName.c_str() << std::endl;
-        int stlLabelSize = 80;
-        bool isBinary=false;
-        FILE *fp = fopen(fileName.c_str(), "r");
-        //Find size of file
-        fseek(fp, 0, SEEK_END);
-        int file_size = ftell(fp);
-        int facenum;
-        /* Check for binary or ASCII file */
-        fseek(fp, stlLabelSize, SEEK_SET);
-        fread(&facenum, sizeof(int), 1, fp);
-        int expected_file_size = stlLabelSize + 4 + (sizeof(short)+sizeof(float) * 4) * facenum ;
-        if(file_size ==  expected_file_size) isBinary = true;
-        unsigned char tmpbuf[128];
-        fread(tmpbuf,sizeof(tmpbuf),1,fp);
-        for(unsigned int i = 0; i < sizeof(tmpbuf); i++)
-        {
-            if(tmpbuf[i] > 127)
-            {
-                isBinary=true;
-                break;
-            }
-        }
-        // Now we know if the stl file is ascii or binary.
-        fclose(fp);
-        //
-        LightMesh3D* pMesh = NULL;
-        if (isBinary)
+        DebugLog << "ParseLightMesh3DByOBJ file name: " << fileName.c_str() << std::endl;
+        ObjReader objReader;
+        if (!objReader.Read(fileName))
         {
-            FILE *fp = fopen(fileName.c_str(), "rb");
-            if (fp == NULL)
-            {
-                DebugLog << "ParseMesh3dBySTL:: open failed in binary" << std::endl;
-                return NULL;
-            }
-            int faceNum;
-            fseek(fp, stlLabelSize, SEEK_SET);
-            fread(&faceNum, sizeof(int), 1, fp);
-            pMesh = new LightMesh3D;
-            std::map<MagicMath::Vector3, int> vertPosMap;
-            int currentVertId = 0;
-            for (int fid = 0; fid < faceNum; fid++)
-            {
-                unsigned short attr;
-                float xx, yy, zz;
-                //read face normal
-                fread(&xx, sizeof(xx), 1, fp);
-                fread(&yy, sizeof(yy), 1, fp);
-                fread(&zz, sizeof(zz), 1, fp);
-                //read face position
-                MagicMath::Vector3 pos[3];
-                std::set<MagicMath::Vector3> validVertex;
-                for (int vid = 0; vid < 3; vid++)
-                {
-                    fread(&xx, sizeof(xx), 1, fp);
-                    fread(&yy, sizeof(yy), 1, fp);
-                    fread(&zz, sizeof(zz), 1, fp);
-                    pos[vid] = MagicMath::Vector3(xx, yy, zz);
-                    validVertex.insert(pos[vid]);
-                }
-                if (validVertex.size() != 3)
-                {
-                    InfoLog << "Degenerate triangle detect" << std::endl;
-                }
-                else
-                {
-                    FaceIndex faceIdx;
-                    for (int vid = 0; vid < 3; vid++)
-                    {
-                        std::pair<std::map<MagicMath::Vector3, int>::iterator, bool> mapRes 
-                            = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos[vid], currentVertId) );
-                        if (mapRes.second)
-                        {
-                            Vertex3D* pNewVert = pMesh->InsertVertex(pos[vid]);
-                            faceIdx.mIndex[vid] = pNewVert->GetId();
-                            currentVertId++;
-                        }
-                        else
-                        {
-                            faceIdx.mIndex[vid] = vertPosMap[pos[vid]];
-                        }
-                    }
-                    pMesh->InsertFace(faceIdx);
-                }
-                
-                fread(&attr,sizeof(unsigned short),1,fp);
-            }
-            fclose(fp);
+            return NULL;
         }
-        else
+        LightMesh3D* pMesh = new LightMesh3D;
+        pMesh->BuildFromIndexedTriangles(objReader.GetPositionList(), objReader.GetIndexList());
+        pMesh->SetNormalList(objReader.GetNormalList());
+        pMesh->SetTexCordList(objReader.GetTexcordList());
+        InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
+        return pMesh;
+    }
+
+    LightMesh3D* Parser::ParseLightMesh3dBySTL(std::string fileName)
+    {
+        DebugLog << "ParseLightMesh3dBySTL file name: " << fileName.c_str() << std::endl;
+        StlReader stlReader;
+        if (!stlReader.Read(fileName))
         {
-            FILE *fp = fopen(fileName.c_str(), "r");
-            if (fp == NULL)
-            {
-                DebugLog << "ParseMesh3dBySTL:: open failed in asic" << std::endl;
-                return NULL;
-            }
-            //skip the first line of the file
-            while (getc(fp) != '\n') 
-            {//Skip the first line of the file 
-            }
-            //read file
-            pMesh = new LightMesh3D;
-            std::map<MagicMath::Vector3, int> vertPosMap;
-            int currentVertId = 0;
-            while (!feof(fp))
-            {
-                MagicMath::Vector3 faceNorm;
-                float xx, yy, zz;
-                int ret = fscanf(fp, "%*s %*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    continue;
-                }
-                ret = fscanf(fp, "%*s %*s");
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pMesh;
-                }
-                MagicMath::Vector3 pos0(xx, yy, zz);
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pMesh;
-                }
-                MagicMath::Vector3 pos1(xx, yy, zz);
-                ret = fscanf(fp, "%*s %f %f %f\n", &xx, &yy, &zz);
-                if (ret != 3)
-                {
-                    ErrorLog << "error: parse position error" << std::endl;
-                    return pMesh;
-                }
-                MagicMath::Vector3 pos2(xx, yy, zz);
-                //judge whether it is a valid face.
-                std::set<MagicMath::Vector3> validVertex;
-                validVertex.insert(pos0);
-                validVertex.insert(pos1);
-                validVertex.insert(pos2);
-                if (validVertex.size() != 3)
-                {
-                    InfoLog << "Degenerate triangle detect" << std::endl;
-                }//
-                else
-                {
-                    FaceIndex faceIdx;
-                    //std::vector<Vertex3D* > vertList(3);
-                    std::pair<std::map<MagicMath::Vector3, int>::iterator, bool> mapRes = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos0, currentVertId) );
-                    if (mapRes.second)
-                    {
-                        Vertex3D* pNewVert = pMesh->InsertVertex(pos0);
-                        faceIdx.mIndex[0] = pNewVert->GetId();
-                        currentVertId++;
-                    }
-                    else
-                    {
-                        faceIdx.mIndex[0] = vertPosMap[pos0];
-                    }
-                    mapRes = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos1, currentVertId) );
-                    if (mapRes.second)
-                    {
-                        Vertex3D* pNewVert = pMesh->InsertVertex(pos1);
-                        faceIdx.mIndex[1] = pNewVert->GetId();
-                        currentVertId++;
-                    }
-                    else
-                    {
-                        faceIdx.mIndex[1] = vertPosMap[pos1];
-                    }
-                    mapRes = vertPosMap.insert( std::pair<MagicMath::Vector3, int>(pos2, currentVertId) );
-                    if (mapRes.second)
-                    {
-                        Vertex3D* pNewVert = pMesh->InsertVertex(pos2);
-                        faceIdx.mIndex[2] = pNewVert->GetId();
-                        currentVertId++;
-                    }
-                    else
-                    {
-                        faceIdx.mIndex[2] = vertPosMap[pos2];
-                    }
-                    pMesh->InsertFace(faceIdx);
-                }   
-                ret = fscanf(fp, "%*s");
-                ret = fscanf(fp, "%*s");
-                if (feof(fp))
-                {
-                    break;
-                }
-            }
-            fclose(fp);
+            return NULL;
         }
+        LightMesh3D* pMesh = new LightMesh3D;
+        pMesh->BuildFromIndexedTriangles(stlReader.GetPositionList(), stlReader.GetIndexList());
         InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
         return pMesh;
     }
@@ -950,41 +483,32 @@ namespace MagicDGP
     LightMesh3D* Parser::ParseLightMesh3dByOFF(std::string fileName)
     {
         DebugLog << "ParseLightMesh3dByOFF file name: " << fileName.c_str() << std::endl;
-        std::ifstream fin(fileName);
-        const int maxSize = 512;
-        char pLine[maxSize];
-        fin.getline(pLine, maxSize);
-        int vertNum, faceNum;
-        fin >> vertNum >> faceNum;
-        fin.getline(pLine, maxSize);
-        LightMesh3D* pMesh = new LightMesh3D;
-        for (int vid = 0; vid < vertNum; vid++)
+        std::vector<MagicMath::Vector3> posList;
+        std::vector<int> indexList;
+        if (!ReadOffTriangles(fileName, posList, indexList))
         {
-            MagicMath::Vector3 pos;
-            fin.getline(pLine, maxSize);
-            char* tok = strtok(pLine, " ");
-            pos[0] = (double)atof(tok);
-            tok = strtok(NULL, " ");
-            pos[1] = (double)atof(tok);
-            tok = strtok(NULL, " ");
-            pos[2] = (double)atof(tok);
-            pMesh->InsertVertex(pos);
+            return NULL;
         }
-        for (int fid = 0; fid < faceNum; fid++)
+        LightMesh3D* pMesh = new LightMesh3D;
+        pMesh->BuildFromIndexedTriangles(posList, indexList);
+        InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
+
+        return pMesh;
+    }
+
+    LightMesh3D* Parser::ParseLightMesh3DByPLY(std::string fileName)
+    {
+        DebugLog << "ParseLightMesh3DByPLY file name: " << fileName.c_str() << std::endl;
+        PlyReader plyReader;
+        if (!plyReader.Read(fileName))
         {
-            FaceIndex faceIdx;
-            //std::vector<Vertex3D* > vertList(3);
-            fin.getline(pLine, maxSize);
-            char* tok = strtok(pLine, " ");
-            for (int j = 0; j < 3; j++)
-            {
-                tok = strtok(NULL, " ");
-                faceIdx.mIndex[j] = atoi(tok);
-            }
-            pMesh->InsertFace(faceIdx);
+            return NULL;
         }
-        InfoLog << "Import Vertex Number: " << vertNum << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
-
+        LightMesh3D* pMesh = new LightMesh3D;
+        pMesh->BuildFromIndexedTriangles(plyReader.GetPositionList(), plyReader.GetIndexList());
+        pMesh->SetNormalList(plyReader.GetNormalList());
+        pMesh->SetColorList(plyReader.GetColorList());
+        InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
         return pMesh;
     }
 
@@ -1006,6 +530,20 @@ namespace MagicDGP
             {
                 ExportPointSetByOFF(fileName, pPC);
             }
+            else if (extName == std::string("m3d"))
+            {
+                if (!SnapshotFile::Save(fileName, pPC))
+                {
+                    ErrorLog << "Export point set failed: cannot save snapshot " << fileName.c_str() << std::endl;
+                }
+            }
+            else if (extName == std::string("m3c"))
+            {
+                if (!PointArchive::Save(fileName, pPC, ArchivePositionBits, ArchiveNormalBits))
+                {
+                    ErrorLog << "Export point set failed: cannot save archive " << fileName.c_str() << std::endl;
+                }
+            }
             else
             {
                 DebugLog << "Export point set failed: file name extension error!" << std::endl;
@@ -1020,67 +558,70 @@ namespace MagicDGP
     void Parser::ExportPointSetByOBJ(std::string fileName, const Point3DSet* pPC)
     {
         DebugLog << "Parser::ExportPointSetByOBJ" << std::endl;
-        std::ofstream fout(fileName);
-        int pcNum = pPC->GetPointNumber();
-        if (pPC->HasNormal() == true)
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
         {
-            for (int i = 0; i < pcNum; i++)
-            {
-                const Point3D* pPoint = pPC->GetPoint(i);
-                MagicMath::Vector3 pos = pPoint->GetPosition();
-                MagicMath::Vector3 nor = pPoint->GetNormal();
-                fout << "v " << pos[0] << " " << pos[1] << " " << pos[2] << std::endl;
-                fout << "vn " << nor[0] << " " << nor[1] << " " << nor[2] << std::endl;
-            }
+            return;
         }
-        else
+        int pcNum = pPC->GetPointNumber();
+        bool hasNormal = pPC->HasNormal();
+        for (int i = 0; i < pcNum; i++)
         {
-            for (int i = 0; i < pcNum; i++)
+            const Point3D* pPoint = pPC->GetPoint(i);
+            writer.WriteString("v ");
+            WriteVector3(writer, pPoint->GetPosition());
+            if (hasNormal)
             {
-                const Point3D* pPoint = pPC->GetPoint(i);
-                MagicMath::Vector3 pos = pPoint->GetPosition();
-                fout << "v " << pos[0] << " " << pos[1] << " " << pos[2] << std::endl;
+                writer.WriteString("\nvn ");
+                WriteVector3(writer, pPoint->GetNormal());
             }
+            writer.WriteChar('\n');
         }
-        fout.close();
+        writer.Close();
     }
 
     void Parser::ExportPointSetByPLY(std::string fileName, const Point3DSet* pPC)
     {
-        DebugLog << "Parser::ExportPointSetByPLY" << "\n";
-        std::ofstream fout(fileName);
+        DebugLog << "Parser::ExportPointSetByPLY: " << fileName.c_str() << std::endl;
         int pcNum = pPC->GetPointNumber();
-        fout << "ply" << std::endl;
-        fout << "format ascii 1.0 " << "\n";
-        fout << "comment just for a test" << "\n";
-        fout << "element vertex " << pcNum << "\n";
-        fout << "property float x" << "\n";
-        fout << "property float y" << "\n";
-        fout << "property float z" << "\n";
-        fout << "element face " << 0 << "\n";
-        fout << "property list uchar int vertex_indices" << "\n";
-        fout << "end_header" << "\n";
+        std::vector<MagicMath::Vector3> posList(pcNum);
+        std::vector<MagicMath::Vector3> norList;
+        std::vector<MagicMath::Vector3> colorList(pcNum);
+        if (pPC->HasNormal())
+        {
+            norList.resize(pcNum);
+        }
         for (int i = 0; i < pcNum; i++)
         {
-            MagicMath::Vector3 pos = pPC->GetPoint(i)->GetPosition();
-            fout << pos[0] << " " << pos[1] << " " << pos[2] << "\n";
+            const Point3D* pPoint = pPC->GetPoint(i);
+            posList.at(i) = pPoint->GetPosition();
+            colorList.at(i) = pPoint->GetColor();
+            if (pPC->HasNormal())
+            {
+                norList.at(i) = pPoint->GetNormal();
+            }
         }
-        fout.close();
+        PlyWriter::Write(fileName, posList, &norList, &colorList, NULL);
     }
 
     void Parser::ExportPointSetByOFF(std::string fileName, const Point3DSet* pPC)
     {
         DebugLog << "Parser::ExportPointSetByOFF: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
-        fout << "OFF\n";
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
         int pointNum = pPC->GetPointNumber();
-        fout << pointNum << " " << 0 << " " << 0 << "\n";
+        writer.WriteString("OFF\n");
+        writer.WriteInt(pointNum);
+        writer.WriteString(" 0 0\n");
         for (int vid = 0; vid < pointNum; vid++)
         {
-            MagicMath::Vector3 pos = pPC->GetPoint(vid)->GetPosition();
-            fout << pos[0] << "  " << pos[1] << " " << pos[2] << "\n"; 
+            WriteVector3(writer, pPC->GetPoint(vid)->GetPosition());
+            writer.WriteChar('\n');
         }
-        fout.close();
+        writer.Close();
     }
 
     void Parser::ExportMesh3D(std::string fileName, const Mesh3D* pMesh)
@@ -1101,6 +642,17 @@ namespace MagicDGP
             {
                 ExportMesh3DByOFF(fileName, pMesh);
             }
+            else if (extName == std::string("ply"))
+            {
+                ExportMesh3DByPLY(fileName, pMesh);
+            }
+            else if (extName == std::string("m3d"))
+            {
+                if (!SnapshotFile::Save(fileName, pMesh))
+                {
+                    ErrorLog << "Export mesh failed: cannot save snapshot " << fileName.c_str() << std::endl;
+                }
+            }
             else
             {
                 DebugLog << "Export mesh failed: file name extension error!" << std::endl;
@@ -1130,6 +682,17 @@ namespace MagicDGP
             {
                 ExportLightMesh3DByOFF(fileName, pMesh);
             }
+            else if (extName == std::string("ply"))
+            {
+                ExportLightMesh3DByPLY(fileName, pMesh);
+            }
+            else if (extName == std::string("m3d"))
+            {
+                if (!SnapshotFile::Save(fileName, pMesh))
+                {
+                    ErrorLog << "Export mesh failed: cannot save snapshot " << fileName.c_str() << std::endl;
+                }
+            }
             else
             {
                 DebugLog << "Export mesh failed: file name extension error!" << std::endl;
@@ -1141,31 +704,61 @@ namespace MagicDGP
         }
     }
 
+    void Parser::SetExportPrecision(int digitNum)
+    {
+        ExportPrecision = digitNum;
+    }
+
+    void Parser::SetBackgroundExport(bool isBackground)
+    {
+        IsBackgroundExport = isBackground;
+    }
+
+    void Parser::SetArchiveBits(int positionBits, int normalBits)
+    {
+        ArchivePositionBits = positionBits;
+        ArchiveNormalBits = normalBits;
+    }
+
     void Parser::ExportMesh3DByOBJ(std::string fileName, const Mesh3D* pMesh)
     {
         DebugLog << "Parser::ExportMesh3DByOBJ: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
         int vertNum = pMesh->GetVertexNumber();
         for (int i = 0; i < vertNum; i++)
         {
-            MagicMath::Vector3 pos = pMesh->GetVertex(i)->GetPosition();
-            fout << "v " << pos[0] << " " << pos[1] << " " << pos[2] << "\n";
+            writer.WriteString("v ");
+            WriteVector3(writer, pMesh->GetVertex(i)->GetPosition());
+            writer.WriteChar('\n');
         }
         int faceNum = pMesh->GetFaceNumber();
         for (int i = 0; i < faceNum; i++)
         {
             const Edge3D* pEdge = pMesh->GetFace(i)->GetEdge();
-            fout << "f " << pEdge->GetVertex()->GetId() + 1 << " " << pEdge->GetNext()->GetVertex()->GetId() + 1 
-                << " " << pEdge->GetPre()->GetVertex()->GetId() + 1 << "\n"; 
-        }
-        fout.close();
+            writer.WriteString("f ");
+            writer.WriteInt(pEdge->GetVertex()->GetId() + 1);
+            writer.WriteChar(' ');
+            writer.WriteInt(pEdge->GetNext()->GetVertex()->GetId() + 1);
+            writer.WriteChar(' ');
+            writer.WriteInt(pEdge->GetPre()->GetVertex()->GetId() + 1);
+            writer.WriteChar('\n');
+        }
+        writer.Close();
     }
 
     void Parser::ExportMesh3DBySTL(std::string fileName, const Mesh3D* pMesh)
     {
         DebugLog << "Parser::ExportMesh3DBySTL: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
-        fout << "solid magic3d" << std::endl;
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
+        writer.WriteString("solid magic3d\n");
         int faceNum = pMesh->GetFaceNumber();
         for (int fid = 0; fid < faceNum; fid++)
         {
@@ -1175,105 +768,207 @@ namespace MagicDGP
             MagicMath::Vector3 pos2 = pEdge->GetPre()->GetVertex()->GetPosition();
             MagicMath::Vector3 nor = (pos1 - pos0).CrossProduct(pos2 - pos0);
             nor.Normalise();
-            fout << "  facet normal " << nor[0] << " " << nor[1] << " " << nor[2] << "\n";
-            fout << "    outer loop" << "\n";
-            fout << "      vertex " << pos0[0] << " " << pos0[1] << " " << pos0[2] << "\n";
-            fout << "      vertex " << pos1[0] << " " << pos1[1] << " " << pos1[2] << "\n"; 
-            fout << "      vertex " << pos2[0] << " " << pos2[1] << " " << pos2[2] << "\n";
-            fout << "    endloop" << "\n";
-            fout << "  endfacet" << "\n";
-        }
-        fout << "endsolid magic3d" << std::endl;
-        fout.close();
+            writer.WriteString("  facet normal ");
+            WriteVector3(writer, nor);
+            writer.WriteString("\n    outer loop\n      vertex ");
+            WriteVector3(writer, pos0);
+            writer.WriteString("\n      vertex ");
+            WriteVector3(writer, pos1);
+            writer.WriteString("\n      vertex ");
+            WriteVector3(writer, pos2);
+            writer.WriteString("\n    endloop\n  endfacet\n");
+        }
+        writer.WriteString("endsolid magic3d\n");
+        writer.Close();
     }
 
     void Parser::ExportMesh3DByOFF(std::string fileName, const Mesh3D* pMesh)
     {
         DebugLog << "Parser::ExportMesh3DByOFF: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
-        fout << "OFF\n";
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
         int vertNum = pMesh->GetVertexNumber();
         int faceNum = pMesh->GetFaceNumber();
-        fout << vertNum << " " << faceNum << " " << 0 << "\n";
+        writer.WriteString("OFF\n");
+        writer.WriteInt(vertNum);
+        writer.WriteChar(' ');
+        writer.WriteInt(faceNum);
+        writer.WriteString(" 0\n");
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            WriteVector3(writer, pMesh->GetVertex(vid)->GetPosition());
+            writer.WriteChar('\n');
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            const Edge3D* pEdge = pMesh->GetFace(fid)->GetEdge();
+            int vertIndex[3] = {pEdge->GetVertex()->GetId(), pEdge->GetNext()->GetVertex()->GetId(), pEdge->GetPre()->GetVertex()->GetId()};
+            writer.WriteString("3 ");
+            writer.WriteInt(vertIndex[0]);
+            writer.WriteChar(' ');
+            writer.WriteInt(vertIndex[1]);
+            writer.WriteChar(' ');
+            writer.WriteInt(vertIndex[2]);
+            writer.WriteChar('\n');
+        }
+        writer.Close();
+    }
+
+    void Parser::ExportMesh3DByPLY(std::string fileName, const Mesh3D* pMesh)
+    {
+        DebugLog << "Parser::ExportMesh3DByPLY: " << fileName.c_str() << std::endl;
+        int vertNum = pMesh->GetVertexNumber();
+        std::vector<MagicMath::Vector3> posList(vertNum);
+        std::vector<MagicMath::Vector3> norList(vertNum);
+        std::vector<MagicMath::Vector3> colorList(vertNum);
         for (int vid = 0; vid < vertNum; vid++)
         {
-            MagicMath::Vector3 pos = pMesh->GetVertex(vid)->GetPosition();
-            fout << pos[0] << "  " << pos[1] << " " << pos[2] << "\n"; 
+            const Vertex3D* pVert = pMesh->GetVertex(vid);
+            posList.at(vid) = pVert->GetPosition();
+            norList.at(vid) = pVert->GetNormal();
+            colorList.at(vid) = pVert->GetColor();
         }
+        int faceNum = pMesh->GetFaceNumber();
+        std::vector<int> indexList(faceNum * 3);
         for (int fid = 0; fid < faceNum; fid++)
         {
             const Edge3D* pEdge = pMesh->GetFace(fid)->GetEdge();
-            fout << 3 << " " << pEdge->GetVertex()->GetId() << " " << pEdge->GetNext()->GetVertex()->GetId() 
-                << " " << pEdge->GetPre()->GetVertex()->GetId() << "\n";
+            indexList.at(fid * 3) = pEdge->GetVertex()->GetId();
+            indexList.at(fid * 3 + 1) = pEdge->GetNext()->GetVertex()->GetId();
+            indexList.at(fid * 3 + 2) = pEdge->GetPre()->GetVertex()->GetId();
         }
-        fout.close();
+        PlyWriter::Write(fileName, posList, &norList, &colorList, &indexList);
     }
 
     void Parser::ExportLightMesh3DByOBJ(std::string fileName, const LightMesh3D* pMesh)
     {
         DebugLog << "Parser::ExportLightMesh3DByOBJ: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
         int vertNum = pMesh->GetVertexNumber();
         for (int i = 0; i < vertNum; i++)
         {
-            MagicMath::Vector3 pos = pMesh->GetVertex(i)->GetPosition();
-            fout << "v " << pos[0] << " " << pos[1] << " " << pos[2] << "\n";
+            writer.WriteString("v ");
+            WriteVector3(writer, pMesh->GetPosition(i));
+            writer.WriteChar('\n');
         }
         int faceNum = pMesh->GetFaceNumber();
         for (int i = 0; i < faceNum; i++)
         {
             FaceIndex faceIdx = pMesh->GetFace(i);
-            fout << "f " << faceIdx.mIndex[0] + 1 << " " << faceIdx.mIndex[1] + 1 
-                << " " << faceIdx.mIndex[2] + 1 << "\n"; 
-        }
-        fout.close();
+            writer.WriteString("f ");
+            writer.WriteInt(faceIdx.mIndex[0] + 1);
+            writer.WriteChar(' ');
+            writer.WriteInt(faceIdx.mIndex[1] + 1);
+            writer.WriteChar(' ');
+            writer.WriteInt(faceIdx.mIndex[2] + 1);
+            writer.WriteChar('\n');
+        }
+        writer.Close();
     }
 
     void Parser::ExportLightMesh3DBySTL(std::string fileName, const LightMesh3D* pMesh)
     {
         DebugLog << "Parser::ExportLightMesh3DBySTL: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
-        fout << "solid magic3d" << std::endl;
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
+        writer.WriteString("solid magic3d\n");
         int faceNum = pMesh->GetFaceNumber();
         for (int fid = 0; fid < faceNum; fid++)
         {
             FaceIndex faceIdx = pMesh->GetFace(fid);
-            MagicMath::Vector3 pos0 = pMesh->GetVertex(faceIdx.mIndex[0])->GetPosition();
-            MagicMath::Vector3 pos1 = pMesh->GetVertex(faceIdx.mIndex[1])->GetPosition();
-            MagicMath::Vector3 pos2 = pMesh->GetVertex(faceIdx.mIndex[2])->GetPosition();
+            MagicMath::Vector3 pos0 = pMesh->GetPosition(faceIdx.mIndex[0]);
+            MagicMath::Vector3 pos1 = pMesh->GetPosition(faceIdx.mIndex[1]);
+            MagicMath::Vector3 pos2 = pMesh->GetPosition(faceIdx.mIndex[2]);
             MagicMath::Vector3 nor = (pos1 - pos0).CrossProduct(pos2 - pos0);
             nor.Normalise();
-            fout << "  facet normal " << nor[0] << " " << nor[1] << " " << nor[2] << "\n";
-            fout << "    outer loop" << "\n";
-            fout << "      vertex " << pos0[0] << " " << pos0[1] << " " << pos0[2] << "\n";
-            fout << "      vertex " << pos1[0] << " " << pos1[1] << " " << pos1[2] << "\n"; 
-            fout << "      vertex " << pos2[0] << " " << pos2[1] << " " << pos2[2] << "\n";
-            fout << "    endloop" << "\n";
-            fout << "  endfacet" << "\n";
-        }
-        fout << "endsolid magic3d" << std::endl;
-        fout.close();
+            writer.WriteString("  facet normal ");
+            WriteVector3(writer, nor);
+            writer.WriteString("\n    outer loop\n      vertex ");
+            WriteVector3(writer, pos0);
+            writer.WriteString("\n      vertex ");
+            WriteVector3(writer, pos1);
+            writer.WriteString("\n      vertex ");
+            WriteVector3(writer, pos2);
+            writer.WriteString("\n    endloop\n  endfacet\n");
+        }
+        writer.WriteString("endsolid magic3d\n");
+        writer.Close();
     }
 
     void Parser::ExportLightMesh3DByOFF(std::string fileName, const LightMesh3D* pMesh)
     {
         DebugLog << "Parser::ExportLightMesh3DByOFF: " << fileName.c_str() << std::endl;
-        std::ofstream fout(fileName);
-        fout << "OFF\n";
+        BufferedWriter writer;
+        if (!OpenExportWriter(writer, fileName))
+        {
+            return;
+        }
         int vertNum = pMesh->GetVertexNumber();
         int faceNum = pMesh->GetFaceNumber();
-        fout << vertNum << " " << faceNum << " " << 0 << "\n";
+        writer.WriteString("OFF\n");
+        writer.WriteInt(vertNum);
+        writer.WriteChar(' ');
+        writer.WriteInt(faceNum);
+        writer.WriteString(" 0\n");
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            WriteVector3(writer, pMesh->GetPosition(vid));
+            writer.WriteChar('\n');
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            FaceIndex faceIdx = pMesh->GetFace(fid);
+            const int* vertIndex = faceIdx.mIndex;
+            writer.WriteString("3 ");
+            writer.WriteInt(vertIndex[0]);
+            writer.WriteChar(' ');
+            writer.WriteInt(vertIndex[1]);
+            writer.WriteChar(' ');
+            writer.WriteInt(vertIndex[2]);
+            writer.WriteChar('\n');
+        }
+        writer.Close();
+    }
+
+    void Parser::ExportLightMesh3DByPLY(std::string fileName, const LightMesh3D* pMesh)
+    {
+        DebugLog << "Parser::ExportLightMesh3DByPLY: " << fileName.c_str() << std::endl;
+        int vertNum = pMesh->GetVertexNumber();
+        std::vector<MagicMath::Vector3> posList(vertNum);
+        std::vector<MagicMath::Vector3> norList(pMesh->HasNormal() ? vertNum : 0);
+        std::vector<MagicMath::Vector3> colorList(pMesh->HasColor() ? vertNum : 0);
         for (int vid = 0; vid < vertNum; vid++)
         {
-            MagicMath::Vector3 pos = pMesh->GetVertex(vid)->GetPosition();
-            fout << pos[0] << "  " << pos[1] << " " << pos[2] << "\n"; 
+            posList.at(vid) = pMesh->GetPosition(vid);
+            if (pMesh->HasNormal())
+            {
+                norList.at(vid) = pMesh->GetNormal(vid);
+            }
+            if (pMesh->HasColor())
+            {
+                colorList.at(vid) = pMesh->GetColor(vid);
+            }
         }
+        int faceNum = pMesh->GetFaceNumber();
+        std::vector<int> indexList(faceNum * 3);
         for (int fid = 0; fid < faceNum; fid++)
         {
             FaceIndex faceIdx = pMesh->GetFace(fid);
-            fout << 3 << " " << faceIdx.mIndex[0] << " " << faceIdx.mIndex[1] 
-                << " " << faceIdx.mIndex[2] << "\n";
+            indexList.at(fid * 3) = faceIdx.mIndex[0];
+            indexList.at(fid * 3 + 1) = faceIdx.mIndex[1];
+            indexList.at(fid * 3 + 2) = faceIdx.mIndex[2];
         }
-        fout.close();
+        //Channels which the mesh does not have are not written
+        PlyWriter::Write(fileName, posList, pMesh->HasNormal() ? &norList : NULL, pMesh->HasColor() ? &colorList : NULL, &indexList);
     }
 }
\ No newline at end of file
@@ -17,19 +17,28 @@ namespace MagicDGP
         static void ExportPointSet(std::string fileName, const Point3DSet* pPC);
         static void ExportMesh3D(std::string fileName, const Mesh3D* pMesh);
         static void ExportLightMesh3D(std::string fileName, const LightMesh3D* pMesh);
+        //Significant digits of exported text, 0 writes the shortest text which reads back to the same double
+        static void SetExportPrecision(int digitNum);
+        //Exported files are written by a background thread while the text is formatted
+        static void SetBackgroundExport(bool isBackground);
+        //Quantization bits of exported m3c archives, see PointArchive::Save
+        static void SetArchiveBits(int positionBits, int normalBits);
 
     private:
         static Point3DSet* ParsePointSetByOBJ(std::string fileName);
         static Point3DSet* ParsePointSetBySTL(std::string fileName);
         static Point3DSet* ParsePointSetByOFF(std::string fileName);
+        static Point3DSet* ParsePointSetByPLY(std::string fileName);
 
         static Mesh3D* ParseMesh3DByOBJ(std::string fileName);
         static Mesh3D* ParseMesh3dBySTL(std::string fileName);
         static Mesh3D* ParseMesh3dByOFF(std::string fileName);
+        static Mesh3D* ParseMesh3DByPLY(std::string fileName);
 
         static LightMesh3D* ParseLightMesh3DByOBJ(std::string fileName);
         static LightMesh3D* ParseLightMesh3dBySTL(std::string fileName);
         static LightMesh3D* ParseLightMesh3dByOFF(std::string fileName);
+        static LightMesh3D* ParseLightMesh3DByPLY(std::string fileName);
 
         static void ExportPointSetByOBJ(std::string fileName, const Point3DSet* pPC);
         static void ExportPointSetByPLY(std::string fileName, const Point3DSet* pPC);
@@ -38,9 +47,11 @@ namespace MagicDGP
         static void ExportMesh3DByOBJ(std::string fileName, const Mesh3D* pMesh);
         static void ExportMesh3DBySTL(std::string fileName, const Mesh3D* pMesh);
         static void ExportMesh3DByOFF(std::string fileName, const Mesh3D* pMesh);
+        static void ExportMesh3DByPLY(std::string fileName, const Mesh3D* pMesh);
 
         static void ExportLightMesh3DByOBJ(std::string fileName, const LightMesh3D* pMesh);
         static void ExportLightMesh3DBySTL(std::string fileName, const LightMesh3D* pMesh);
         static void ExportLightMesh3DByOFF(std::string fileName, const LightMesh3D* pMesh);
+        static void ExportLightMesh3DByPLY(std::string fileName, const LightMesh3D* pMesh);
     };
 }
\ No newline at end of file
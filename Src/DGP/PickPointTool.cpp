@@ -97,12 +97,12 @@ namespace MagicDGP
         {
             for (int vid = 0; vid < vertNum; vid++)
             {
-                MagicMath::Vector3 vNor = pMesh->GetVertex(vid)->GetNormal();
+                MagicMath::Vector3 vNor = pMesh->GetNormal(vid);
                 Ogre::Vector4 ogreVNor(vNor[0], vNor[1], vNor[2], 0);
                 ogreVNor = worldM * ogreVNor;
                 if (ogreVNor.z > 0)
                 {
-                    MagicMath::Vector3 vPos = pMesh->GetVertex(vid)->GetPosition();
+                    MagicMath::Vector3 vPos = pMesh->GetPosition(vid);
                     Ogre::Vector3 ogreVPos(vPos[0], vPos[1], vPos[2]);
                     ogreVPos = wvpM * ogreVPos;
                     MagicMath::Vector2 screenPos(ogreVPos.x, ogreVPos.y);
@@ -121,7 +121,7 @@ namespace MagicDGP
         {
             for (int vid = 0; vid < vertNum; vid++)
             {
-                MagicMath::Vector3 vPos = pMesh->GetVertex(vid)->GetPosition();
+                MagicMath::Vector3 vPos = pMesh->GetPosition(vid);
                 Ogre::Vector3 ogreVPos(vPos[0], vPos[1], vPos[2]);
                 ogreVPos = wvpM * ogreVPos;
                 MagicMath::Vector2 screenPos(ogreVPos.x, ogreVPos.y);
@@ -207,12 +207,12 @@ namespace MagicDGP
         {
             for (int vid = 0; vid < vertNum; vid++)
             {
-                MagicMath::Vector3 vNor = pMesh->GetVertex(vid)->GetNormal();
+                MagicMath::Vector3 vNor = pMesh->GetNormal(vid);
                 Ogre::Vector4 ogreVNor(vNor[0], vNor[1], vNor[2], 0);
                 ogreVNor = worldM * ogreVNor;
                 if (ogreVNor.z > 0)
                 {
-                    MagicMath::Vector3 vPos = pMesh->GetVertex(vid)->GetPosition();
+                    MagicMath::Vector3 vPos = pMesh->GetPosition(vid);
                     Ogre::Vector3 ogreVPos(vPos[0], vPos[1], vPos[2]);
                     ogreVPos = wvpM * ogreVPos;
                     if (ogreVPos.x > minX && ogreVPos.x < maxX && ogreVPos.y > minY && ogreVPos.y < maxY)
@@ -226,7 +226,7 @@ namespace MagicDGP
         {
             for (int vid = 0; vid < vertNum; vid++)
             {
-                MagicMath::Vector3 vPos = pMesh->GetVertex(vid)->GetPosition();
+                MagicMath::Vector3 vPos = pMesh->GetPosition(vid);
                 Ogre::Vector3 ogreVPos(vPos[0], vPos[1], vPos[2]);
                 ogreVPos = wvpM * ogreVPos;
                 if (ogreVPos.x > minX && ogreVPos.x < maxX && ogreVPos.y > minY && ogreVPos.y < maxY)
@@ -293,12 +293,12 @@ namespace MagicDGP
         {
             for (int vid = 0; vid < vertNum; vid++)
             {
-                MagicMath::Vector3 vNor = pMesh->GetVertex(vid)->GetNormal();
+                MagicMath::Vector3 vNor = pMesh->GetNormal(vid);
                 Ogre::Vector4 ogreVNor(vNor[0], vNor[1], vNor[2], 0);
                 ogreVNor = worldM * ogreVNor;
                 if (ogreVNor.z > 0)
                 {
-                    MagicMath::Vector3 vPos = pMesh->GetVertex(vid)->GetPosition();
+                    MagicMath::Vector3 vPos = pMesh->GetPosition(vid);
                     Ogre::Vector3 ogreVPos(vPos[0], vPos[1], vPos[2]);
                     ogreVPos = wvpM * ogreVPos;
                     MagicMath::Vector2 screenPos(ogreVPos.x, ogreVPos.y);
@@ -313,7 +313,7 @@ namespace MagicDGP
         {
             for (int vid = 0; vid < vertNum; vid++)
             {
-                MagicMath::Vector3 vPos = pMesh->GetVertex(vid)->GetPosition();
+                MagicMath::Vector3 vPos = pMesh->GetPosition(vid);
                 Ogre::Vector3 ogreVPos(vPos[0], vPos[1], vPos[2]);
                 ogreVPos = wvpM * ogreVPos;
                 MagicMath::Vector2 screenPos(ogreVPos.x, ogreVPos.y);
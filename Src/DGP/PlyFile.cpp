@@ -0,0 +1,906 @@
+#include "PlyFile.h"
+#include "MappedFile.h"
+#include "NumberParser.h"
+#include "BufferedWriter.h"
+#include "Tool/LogSystem.h"
+#include "../Common/ToolKit.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace
+{
+    enum PlyType
+    {
+        PlyChar = 0,
+        PlyUChar,
+        PlyShort,
+        PlyUShort,
+        PlyInt,
+        PlyUInt,
+        PlyFloat,
+        PlyDouble,
+        PlyInvalid
+    };
+
+    const int PlyTypeSize[] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+    //Where a vertex property is stored, SlotIndex is the face index list
+    enum PlySlot
+    {
+        SlotNone = -1,
+        SlotPosX = 0,
+        SlotNorX = 3,
+        SlotColorX = 6,
+        SlotNumber = 9,
+        SlotIndex = 100
+    };
+
+    struct PlyProperty
+    {
+        std::string mName;
+        PlyType mType;
+        bool mIsList;
+        PlyType mCountType;
+        int mSlot;
+        double mScale;
+    };
+
+    struct PlyElement
+    {
+        std::string mName;
+        int mCount;
+        std::vector<PlyProperty> mPropertyList;
+    };
+
+    struct PlyData
+    {
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mColorList;
+        std::vector<int> mIndexList;
+        bool mHasNormal;
+        bool mHasColor;
+    };
+
+    PlyType ParseType(const std::string& name)
+    {
+        if (name == "char" || name == "int8") return PlyChar;
+        if (name == "uchar" || name == "uint8") return PlyUChar;
+        if (name == "short" || name == "int16") return PlyShort;
+        if (name == "ushort" || name == "uint16") return PlyUShort;
+        if (name == "int" || name == "int32") return PlyInt;
+        if (name == "uint" || name == "uint32") return PlyUInt;
+        if (name == "float" || name == "float32") return PlyFloat;
+        if (name == "double" || name == "float64") return PlyDouble;
+        return PlyInvalid;
+    }
+
+    double DecodeBinary(const char* pData, PlyType type, bool swapBytes)
+    {
+        char bytes[8];
+        int size = PlyTypeSize[type];
+        memcpy(bytes, pData, size);
+        if (swapBytes)
+        {
+            std::reverse(bytes, bytes + size);
+        }
+        switch (type)
+        {
+        case PlyChar:   { signed char v;    memcpy(&v, bytes, 1); return v; }
+        case PlyUChar:  { unsigned char v;  memcpy(&v, bytes, 1); return v; }
+        case PlyShort:  { short v;          memcpy(&v, bytes, 2); return v; }
+        case PlyUShort: { unsigned short v; memcpy(&v, bytes, 2); return v; }
+        case PlyInt:    { int v;            memcpy(&v, bytes, 4); return v; }
+        case PlyUInt:   { unsigned int v;   memcpy(&v, bytes, 4); return v; }
+        case PlyFloat:  { float v;          memcpy(&v, bytes, 4); return v; }
+        default:        { double v;         memcpy(&v, bytes, 8); return v; }
+        }
+    }
+
+    class BinaryCursor
+    {
+    public:
+        BinaryCursor(const char* pCur, const char* pEnd, bool swapBytes) :
+            mpCur(pCur),
+            mpEnd(pEnd),
+            mSwapBytes(swapBytes)
+        {
+        }
+
+        bool Next(PlyType type, double& value)
+        {
+            int size = PlyTypeSize[type];
+            if (mpEnd - mpCur < size)
+            {
+                return false;
+            }
+            value = DecodeBinary(mpCur, type, mSwapBytes);
+            mpCur += size;
+            return true;
+        }
+
+        const char* GetPosition() const
+        {
+            return mpCur;
+        }
+
+        size_t GetRemainSize() const
+        {
+            return mpEnd - mpCur;
+        }
+
+        void Advance(size_t size)
+        {
+            mpCur += size;
+        }
+
+        bool IsSwapBytes() const
+        {
+            return mSwapBytes;
+        }
+
+    private:
+        const char* mpCur;
+        const char* mpEnd;
+        bool mSwapBytes;
+    };
+
+    class AsciiCursor
+    {
+    public:
+        AsciiCursor(const char* pCur, const char* pEnd) :
+            mpCur(pCur),
+            mpEnd(pEnd)
+        {
+        }
+
+        bool Next(PlyType type, double& value)
+        {
+            while (mpCur < mpEnd && (*mpCur == ' ' || *mpCur == '\t' || *mpCur == '\r' || *mpCur == '\n'))
+            {
+                mpCur++;
+            }
+            const char* pNext = MagicDGP::NumberParser::ParseDouble(mpCur, mpEnd, value);
+            if (pNext == NULL)
+            {
+                return false;
+            }
+            mpCur = pNext;
+            return true;
+        }
+
+    private:
+        const char* mpCur;
+        const char* mpEnd;
+    };
+
+    template <class Cursor>
+    bool ReadElement(Cursor& cursor, const PlyElement& element, PlyData& data)
+    {
+        bool isVertex = (element.mName == "vertex");
+        bool isFace = (element.mName == "face");
+        if (isVertex)
+        {
+            data.mPositionList.reserve(element.mCount);
+            if (data.mHasNormal)
+            {
+                data.mNormalList.reserve(element.mCount);
+            }
+            if (data.mHasColor)
+            {
+                data.mColorList.reserve(element.mCount);
+            }
+        }
+        else if (isFace)
+        {
+            data.mIndexList.reserve(element.mCount * 3);
+        }
+        int propertyNum = element.mPropertyList.size();
+        double values[SlotNumber] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+        std::vector<int> polygon;
+        for (int rid = 0; rid < element.mCount; rid++)
+        {
+            for (int pid = 0; pid < propertyNum; pid++)
+            {
+                const PlyProperty& property = element.mPropertyList.at(pid);
+                double value;
+                if (!property.mIsList)
+                {
+                    if (!cursor.Next(property.mType, value))
+                    {
+                        return false;
+                    }
+                    if (property.mSlot != SlotNone)
+                    {
+                        values[property.mSlot] = value * property.mScale;
+                    }
+                    continue;
+                }
+                if (!cursor.Next(property.mCountType, value) || value < 0)
+                {
+                    return false;
+                }
+                int itemNum = int(value);
+                polygon.clear();
+                for (int iid = 0; iid < itemNum; iid++)
+                {
+                    if (!cursor.Next(property.mType, value))
+                    {
+                        return false;
+                    }
+                    polygon.push_back(int(value));
+                }
+                if (property.mSlot == SlotIndex)
+                {
+                    for (int iid = 2; iid < itemNum; iid++)
+                    {
+                        data.mIndexList.push_back(polygon.at(0));
+                        data.mIndexList.push_back(polygon.at(iid - 1));
+                        data.mIndexList.push_back(polygon.at(iid));
+                    }
+                }
+            }
+            if (isVertex)
+            {
+                data.mPositionList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+                if (data.mHasNormal)
+                {
+                    data.mNormalList.push_back(MagicMath::Vector3(values[3], values[4], values[5]));
+                }
+                if (data.mHasColor)
+                {
+                    data.mColorList.push_back(MagicMath::Vector3(values[6], values[7], values[8]));
+                }
+            }
+        }
+        return true;
+    }
+
+    //Fast path of binary elements. Vertex records without list property have a fixed size and only the used
+    //properties are decoded, face records of a single "list uchar int" property are copied directly.
+    //Returns false if the element has another layout, it is then read by ReadElement.
+    bool ReadFixedElement(BinaryCursor& cursor, const PlyElement& element, PlyData& data)
+    {
+        int propertyNum = element.mPropertyList.size();
+        if (element.mName == "vertex")
+        {
+            std::vector<PlyProperty> usedList;
+            std::vector<int> offsetList;
+            size_t recordSize = 0;
+            for (int pid = 0; pid < propertyNum; pid++)
+            {
+                const PlyProperty& property = element.mPropertyList.at(pid);
+                if (property.mIsList)
+                {
+                    return false;
+                }
+                if (property.mSlot != SlotNone)
+                {
+                    usedList.push_back(property);
+                    offsetList.push_back(recordSize);
+                }
+                recordSize += PlyTypeSize[property.mType];
+            }
+            if (recordSize == 0 || cursor.GetRemainSize() / recordSize < size_t(element.mCount))
+            {
+                return false;
+            }
+            int usedNum = usedList.size();
+            bool swapBytes = cursor.IsSwapBytes();
+            const char* pRecord = cursor.GetPosition();
+            double values[SlotNumber] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+            data.mPositionList.resize(element.mCount);
+            data.mNormalList.resize(data.mHasNormal ? element.mCount : 0);
+            data.mColorList.resize(data.mHasColor ? element.mCount : 0);
+            for (int rid = 0; rid < element.mCount; rid++)
+            {
+                for (int uid = 0; uid < usedNum; uid++)
+                {
+                    values[usedList[uid].mSlot] = DecodeBinary(pRecord + offsetList[uid], usedList[uid].mType, swapBytes) * usedList[uid].mScale;
+                }
+                data.mPositionList[rid] = MagicMath::Vector3(values[0], values[1], values[2]);
+                if (data.mHasNormal)
+                {
+                    data.mNormalList[rid] = MagicMath::Vector3(values[3], values[4], values[5]);
+                }
+                if (data.mHasColor)
+                {
+                    data.mColorList[rid] = MagicMath::Vector3(values[6], values[7], values[8]);
+                }
+                pRecord += recordSize;
+            }
+            cursor.Advance(recordSize * element.mCount);
+            return true;
+        }
+        if (element.mName == "face")
+        {
+            if (propertyNum != 1 || cursor.IsSwapBytes())
+            {
+                return false;
+            }
+            const PlyProperty& property = element.mPropertyList.at(0);
+            if (property.mSlot != SlotIndex || PlyTypeSize[property.mCountType] != 1 || PlyTypeSize[property.mType] != 4)
+            {
+                return false;
+            }
+            const char* pCur = cursor.GetPosition();
+            const char* pEnd = pCur + cursor.GetRemainSize();
+            std::vector<int>& indexList = data.mIndexList;
+            indexList.reserve(indexList.size() + size_t(element.mCount) * 3);
+            int polygon[3];
+            for (int rid = 0; rid < element.mCount; rid++)
+            {
+                if (pCur == pEnd)
+                {
+                    return false;
+                }
+                int itemNum = int(DecodeBinary(pCur, property.mCountType, false));
+                if (itemNum < 0 || (pEnd - pCur - 1) / 4 < itemNum)
+                {
+                    return false;
+                }
+                pCur++;
+                for (int iid = 2; iid < itemNum; iid++)
+                {
+                    memcpy(polygon, pCur, 4);
+                    memcpy(polygon + 1, pCur + (iid - 1) * 4, 8);
+                    indexList.push_back(polygon[0]);
+                    indexList.push_back(polygon[1]);
+                    indexList.push_back(polygon[2]);
+                }
+                pCur += itemNum * 4;
+            }
+            cursor.Advance(pCur - cursor.GetPosition());
+            return true;
+        }
+        return false;
+    }
+
+    void AssignSlot(PlyElement& element, PlyData& data)
+    {
+        const char* slotName[SlotNumber] = {"x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"};
+        int foundMask = 0;
+        for (int pid = 0; pid < element.mPropertyList.size(); pid++)
+        {
+            PlyProperty& property = element.mPropertyList.at(pid);
+            property.mSlot = SlotNone;
+            property.mScale = 1;
+            if (element.mName == "face")
+            {
+                if (property.mIsList && (property.mName == "vertex_indices" || property.mName == "vertex_index"))
+                {
+                    property.mSlot = SlotIndex;
+                }
+                continue;
+            }
+            if (element.mName != "vertex" || property.mIsList)
+            {
+                continue;
+            }
+            for (int sid = 0; sid < SlotNumber; sid++)
+            {
+                if (property.mName == slotName[sid])
+                {
+                    property.mSlot = sid;
+                    foundMask |= (1 << sid);
+                    if (sid >= SlotColorX && (property.mType == PlyUChar || property.mType == PlyChar))
+                    {
+                        property.mScale = 1.0 / 255.0;
+                    }
+                    else if (sid >= SlotColorX && (property.mType == PlyUShort || property.mType == PlyShort))
+                    {
+                        property.mScale = 1.0 / 65535.0;
+                    }
+                    break;
+                }
+            }
+        }
+        if (element.mName == "vertex")
+        {
+            data.mHasNormal = ((foundMask >> SlotNorX) & 7) == 7;
+            data.mHasColor = ((foundMask >> SlotColorX) & 7) == 7;
+        }
+    }
+
+    //Returns the start of data, NULL if the header is invalid
+    const char* ParseHeader(const char* pData, const char* pEnd, std::string& format, std::vector<PlyElement>& elementList)
+    {
+        const char* pLine = pData;
+        bool isFirstLine = true;
+        while (pLine < pEnd)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(pLine, '\n', pEnd - pLine));
+            if (pLineEnd == NULL)
+            {
+                return NULL;
+            }
+            std::vector<std::string> tokenList;
+            const char* pCur = pLine;
+            while (true)
+            {
+                pCur = MagicDGP::NumberParser::SkipSpace(pCur, pLineEnd);
+                if (pCur == pLineEnd)
+                {
+                    break;
+                }
+                const char* pTokenEnd = MagicDGP::NumberParser::SkipToken(pCur, pLineEnd);
+                tokenList.push_back(std::string(pCur, pTokenEnd));
+                pCur = pTokenEnd;
+            }
+            pLine = pLineEnd + 1;
+            if (isFirstLine)
+            {
+                if (tokenList.size() != 1 || tokenList.at(0) != "ply")
+                {
+                    return NULL;
+                }
+                isFirstLine = false;
+                continue;
+            }
+            if (tokenList.empty() || tokenList.at(0) == "comment" || tokenList.at(0) == "obj_info")
+            {
+                continue;
+            }
+            if (tokenList.at(0) == "end_header")
+            {
+                return pLine;
+            }
+            if (tokenList.at(0) == "format" && tokenList.size() >= 2)
+            {
+                format = tokenList.at(1);
+            }
+            else if (tokenList.at(0) == "element" && tokenList.size() == 3)
+            {
+                PlyElement element;
+                element.mName = tokenList.at(1);
+                element.mCount = atoi(tokenList.at(2).c_str());
+                if (element.mCount < 0)
+                {
+                    return NULL;
+                }
+                elementList.push_back(element);
+            }
+            else if (tokenList.at(0) == "property" && !elementList.empty())
+            {
+                PlyProperty property;
+                if (tokenList.size() == 5 && tokenList.at(1) == "list")
+                {
+                    property.mIsList = true;
+                    property.mCountType = ParseType(tokenList.at(2));
+                    property.mType = ParseType(tokenList.at(3));
+                    property.mName = tokenList.at(4);
+                }
+                else if (tokenList.size() == 3)
+                {
+                    property.mIsList = false;
+                    property.mCountType = PlyInvalid;
+                    property.mType = ParseType(tokenList.at(1));
+                    property.mName = tokenList.at(2);
+                }
+                else
+                {
+                    return NULL;
+                }
+                if (property.mType == PlyInvalid || (property.mIsList && property.mCountType == PlyInvalid))
+                {
+                    return NULL;
+                }
+                elementList.back().mPropertyList.push_back(property);
+            }
+            else
+            {
+                return NULL;
+            }
+        }
+        return NULL;
+    }
+
+    unsigned char ColorToByte(double value)
+    {
+        value = value < 0 ? 0 : (value > 1 ? 1 : value);
+        return (unsigned char)(value * 255.0 + 0.5);
+    }
+}
+
+namespace MagicDGP
+{
+    PlyReader::PlyReader()
+    {
+    }
+
+    PlyReader::~PlyReader()
+    {
+    }
+
+    bool PlyReader::Read(const std::string& fileName)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        ClearData();
+        MappedFile mappedFile;
+        if (!mappedFile.Open(fileName))
+        {
+            return false;
+        }
+        const char* pData = mappedFile.GetData();
+        const char* pEnd = pData + mappedFile.GetSize();
+        std::string format;
+        std::vector<PlyElement> elementList;
+        const char* pBody = (pData == NULL) ? NULL : ParseHeader(pData, pEnd, format, elementList);
+        if (pBody == NULL)
+        {
+            ErrorLog << "PlyReader::Read: invalid header " << fileName.c_str() << std::endl;
+            return false;
+        }
+        if (format != "ascii" && format != "binary_little_endian" && format != "binary_big_endian")
+        {
+            ErrorLog << "PlyReader::Read: unsupported format " << format.c_str() << std::endl;
+            return false;
+        }
+        PlyData data;
+        data.mHasNormal = false;
+        data.mHasColor = false;
+        for (int eid = 0; eid < elementList.size(); eid++)
+        {
+            AssignSlot(elementList.at(eid), data);
+        }
+        //binary files are written by little endian machines in practice
+        BinaryCursor binaryCursor(pBody, pEnd, format == "binary_big_endian");
+        AsciiCursor asciiCursor(pBody, pEnd);
+        for (int eid = 0; eid < elementList.size(); eid++)
+        {
+            bool isValid = (format == "ascii") ? ReadElement(asciiCursor, elementList.at(eid), data) :
+                (ReadFixedElement(binaryCursor, elementList.at(eid), data) || ReadElement(binaryCursor, elementList.at(eid), data));
+            if (!isValid)
+            {
+                ErrorLog << "PlyReader::Read: element " << elementList.at(eid).mName.c_str() << " is truncated" << std::endl;
+                return false;
+            }
+        }
+        //drop triangles with invalid index
+        int vertNum = data.mPositionList.size();
+        int validNum = 0;
+        int triangleNum = data.mIndexList.size() / 3;
+        for (int fid = 0; fid < triangleNum; fid++)
+        {
+            int* pIndex = &(data.mIndexList[fid * 3]);
+            if (pIndex[0] < 0 || pIndex[0] >= vertNum || pIndex[1] < 0 || pIndex[1] >= vertNum || pIndex[2] < 0 || pIndex[2] >= vertNum)
+            {
+                continue;
+            }
+            data.mIndexList[validNum * 3] = pIndex[0];
+            data.mIndexList[validNum * 3 + 1] = pIndex[1];
+            data.mIndexList[validNum * 3 + 2] = pIndex[2];
+            validNum++;
+        }
+        if (validNum < triangleNum)
+        {
+            WarnLog << "PlyReader::Read: " << triangleNum - validNum << " faces with invalid index are skipped" << std::endl;
+            data.mIndexList.resize(validNum * 3);
+        }
+        mPositionList.swap(data.mPositionList);
+        mNormalList.swap(data.mNormalList);
+        mColorList.swap(data.mColorList);
+        mIndexList.swap(data.mIndexList);
+        DebugLog << "PlyReader::Read: " << format.c_str() << " " << vertNum << " vertices, " << validNum << " triangles, time: "
+            << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return true;
+    }
+
+    void PlyReader::ClearData()
+    {
+        std::vector<MagicMath::Vector3>().swap(mPositionList);
+        std::vector<MagicMath::Vector3>().swap(mNormalList);
+        std::vector<MagicMath::Vector3>().swap(mColorList);
+        std::vector<int>().swap(mIndexList);
+    }
+
+    const std::vector<MagicMath::Vector3>& PlyReader::GetPositionList() const
+    {
+        return mPositionList;
+    }
+
+    const std::vector<MagicMath::Vector3>& PlyReader::GetNormalList() const
+    {
+        return mNormalList;
+    }
+
+    const std::vector<MagicMath::Vector3>& PlyReader::GetColorList() const
+    {
+        return mColorList;
+    }
+
+    const std::vector<int>& PlyReader::GetIndexList() const
+    {
+        return mIndexList;
+    }
+
+    //Binary output is little endian, which is the byte order of all platforms we build for
+    bool PlyWriter::Write(const std::string& fileName, const std::vector<MagicMath::Vector3>& posList,
+        const std::vector<MagicMath::Vector3>* pNormalList, const std::vector<MagicMath::Vector3>* pColorList,
+        const std::vector<int>* pIndexList, bool isBinary)
+    {
+        BufferedWriter writer;
+        if (!writer.Open(fileName))
+        {
+            return false;
+        }
+        int vertNum = posList.size();
+        bool hasNormal = (pNormalList != NULL && pNormalList->size() == vertNum);
+        bool hasColor = (pColorList != NULL && pColorList->size() == vertNum);
+        int faceNum = (pIndexList == NULL) ? 0 : pIndexList->size() / 3;
+        writer.WriteString(isBinary ? "ply\nformat binary_little_endian 1.0\n" : "ply\nformat ascii 1.0\n");
+        writer.WriteString("comment magic3d\nelement vertex ");
+        writer.WriteInt(vertNum);
+        writer.WriteString("\nproperty float x\nproperty float y\nproperty float z\n");
+        if (hasNormal)
+        {
+            writer.WriteString("property float nx\nproperty float ny\nproperty float nz\n");
+        }
+        if (hasColor)
+        {
+            writer.WriteString("property uchar red\nproperty uchar green\nproperty uchar blue\n");
+        }
+        if (pIndexList != NULL)
+        {
+            writer.WriteString("element face ");
+            writer.WriteInt(faceNum);
+            writer.WriteString("\nproperty list uchar int vertex_indices\n");
+        }
+        writer.WriteString("end_header\n");
+        if (isBinary)
+        {
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                float record[6];
+                int floatNum = 3;
+                const MagicMath::Vector3& pos = posList.at(vid);
+                record[0] = float(pos[0]);
+                record[1] = float(pos[1]);
+                record[2] = float(pos[2]);
+                if (hasNormal)
+                {
+                    const MagicMath::Vector3& nor = pNormalList->at(vid);
+                    record[3] = float(nor[0]);
+                    record[4] = float(nor[1]);
+                    record[5] = float(nor[2]);
+                    floatNum = 6;
+                }
+                writer.WriteBytes(record, floatNum * sizeof(float));
+                if (hasColor)
+                {
+                    const MagicMath::Vector3& color = pColorList->at(vid);
+                    unsigned char colorRecord[3] = {ColorToByte(color[0]), ColorToByte(color[1]), ColorToByte(color[2])};
+                    writer.WriteBytes(colorRecord, 3);
+                }
+            }
+            for (int fid = 0; fid < faceNum; fid++)
+            {
+                char record[13];
+                record[0] = 3;
+                memcpy(record + 1, &(pIndexList->at(fid * 3)), sizeof(int) * 3);
+                writer.WriteBytes(record, 13);
+            }
+        }
+        else
+        {
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                const MagicMath::Vector3& pos = posList.at(vid);
+                writer.WriteReal(float(pos[0]));
+                writer.WriteChar(' ');
+                writer.WriteReal(float(pos[1]));
+                writer.WriteChar(' ');
+                writer.WriteReal(float(pos[2]));
+                if (hasNormal)
+                {
+                    const MagicMath::Vector3& nor = pNormalList->at(vid);
+                    writer.WriteChar(' ');
+                    writer.WriteReal(float(nor[0]));
+                    writer.WriteChar(' ');
+                    writer.WriteReal(float(nor[1]));
+                    writer.WriteChar(' ');
+                    writer.WriteReal(float(nor[2]));
+                }
+                if (hasColor)
+                {
+                    const MagicMath::Vector3& color = pColorList->at(vid);
+                    writer.WriteChar(' ');
+                    writer.WriteInt(ColorToByte(color[0]));
+                    writer.WriteChar(' ');
+                    writer.WriteInt(ColorToByte(color[1]));
+                    writer.WriteChar(' ');
+                    writer.WriteInt(ColorToByte(color[2]));
+                }
+                writer.WriteChar('\n');
+            }
+            for (int fid = 0; fid < faceNum; fid++)
+            {
+                writer.WriteString("3 ");
+                writer.WriteInt(pIndexList->at(fid * 3));
+                writer.WriteChar(' ');
+                writer.WriteInt(pIndexList->at(fid * 3 + 1));
+                writer.WriteChar(' ');
+                writer.WriteInt(pIndexList->at(fid * 3 + 2));
+                writer.WriteChar('\n');
+            }
+        }
+        return writer.Close();
+    }
+}
+
+namespace MagicDGP
+{
+    PlyVertexDecoder::PlyVertexDecoder() :
+        mIsAscii(false),
+        mSwapBytes(false),
+        mVertexNum(0),
+        mHasNormal(false),
+        mHasColor(false),
+        mRecordSize(0),
+        mTypeList(),
+        mSlotList(),
+        mScaleList(),
+        mOffsetList()
+    {
+    }
+
+    size_t PlyVertexDecoder::ParseHeader(const char* pData, size_t size)
+    {
+        std::string format;
+        std::vector<PlyElement> elementList;
+        const char* pBody = (pData == NULL) ? NULL : ::ParseHeader(pData, pData + size, format, elementList);
+        if (pBody == NULL)
+        {
+            ErrorLog << "PlyVertexDecoder::ParseHeader: invalid header" << std::endl;
+            return 0;
+        }
+        if (format != "ascii" && format != "binary_little_endian" && format != "binary_big_endian")
+        {
+            ErrorLog << "PlyVertexDecoder::ParseHeader: unsupported format " << format.c_str() << std::endl;
+            return 0;
+        }
+        if (elementList.empty() || elementList.at(0).mName != "vertex")
+        {
+            ErrorLog << "PlyVertexDecoder::ParseHeader: vertex is not the first element" << std::endl;
+            return 0;
+        }
+        PlyData data;
+        data.mHasNormal = false;
+        data.mHasColor = false;
+        PlyElement& vertex = elementList.at(0);
+        AssignSlot(vertex, data);
+        mIsAscii = (format == "ascii");
+        mSwapBytes = (format == "binary_big_endian");
+        mVertexNum = vertex.mCount;
+        mHasNormal = data.mHasNormal;
+        mHasColor = data.mHasColor;
+        mTypeList.clear();
+        mSlotList.clear();
+        mScaleList.clear();
+        mOffsetList.clear();
+        mRecordSize = 0;
+        for (int pid = 0; pid < vertex.mPropertyList.size(); pid++)
+        {
+            const PlyProperty& property = vertex.mPropertyList.at(pid);
+            if (property.mIsList)
+            {
+                ErrorLog << "PlyVertexDecoder::ParseHeader: list property of vertex is not supported" << std::endl;
+                return 0;
+            }
+            mTypeList.push_back(property.mType);
+            mSlotList.push_back(property.mSlot);
+            mScaleList.push_back(property.mScale);
+            mOffsetList.push_back(mRecordSize);
+            mRecordSize += PlyTypeSize[property.mType];
+        }
+        return pBody - pData;
+    }
+
+    int PlyVertexDecoder::GetVertexNumber() const
+    {
+        return mVertexNum;
+    }
+
+    bool PlyVertexDecoder::HasNormal() const
+    {
+        return mHasNormal;
+    }
+
+    bool PlyVertexDecoder::HasColor() const
+    {
+        return mHasColor;
+    }
+
+    size_t PlyVertexDecoder::Decode(const char* pData, size_t size, int maxNum, std::vector<MagicMath::Vector3>& posList,
+        std::vector<MagicMath::Vector3>& norList, std::vector<MagicMath::Vector3>& colorList) const
+    {
+        return mIsAscii ? DecodeAsciiLines(pData, size, maxNum, posList, norList, colorList) :
+            DecodeBinaryRecords(pData, size, maxNum, posList, norList, colorList);
+    }
+
+    size_t PlyVertexDecoder::DecodeBinaryRecords(const char* pData, size_t size, int maxNum, std::vector<MagicMath::Vector3>& posList,
+        std::vector<MagicMath::Vector3>& norList, std::vector<MagicMath::Vector3>& colorList) const
+    {
+        if (mRecordSize == 0)
+        {
+            return 0;
+        }
+        int recordNum = int(size / mRecordSize < size_t(maxNum) ? size / mRecordSize : maxNum);
+        int propertyNum = mTypeList.size();
+        double values[SlotNumber] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+        const char* pRecord = pData;
+        for (int rid = 0; rid < recordNum; rid++)
+        {
+            for (int pid = 0; pid < propertyNum; pid++)
+            {
+                if (mSlotList[pid] != SlotNone)
+                {
+                    values[mSlotList[pid]] = ::DecodeBinary(pRecord + mOffsetList[pid], PlyType(mTypeList[pid]), mSwapBytes) * mScaleList[pid];
+                }
+            }
+            posList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+            if (mHasNormal)
+            {
+                norList.push_back(MagicMath::Vector3(values[3], values[4], values[5]));
+            }
+            if (mHasColor)
+            {
+                colorList.push_back(MagicMath::Vector3(values[6], values[7], values[8]));
+            }
+            pRecord += mRecordSize;
+        }
+        return pRecord - pData;
+    }
+
+    size_t PlyVertexDecoder::DecodeAsciiLines(const char* pData, size_t size, int maxNum, std::vector<MagicMath::Vector3>& posList,
+        std::vector<MagicMath::Vector3>& norList, std::vector<MagicMath::Vector3>& colorList) const
+    {
+        int propertyNum = mTypeList.size();
+        const char* pLine = pData;
+        const char* pEnd = pData + size;
+        int decodeNum = 0;
+        while (decodeNum < maxNum && pLine < pEnd)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(pLine, '\n', pEnd - pLine));
+            if (pLineEnd == NULL)
+            {
+                break;
+            }
+            const char* pCur = NumberParser::SkipSpace(pLine, pLineEnd);
+            if (pCur == pLineEnd)
+            {
+                pLine = pLineEnd + 1;
+                continue;
+            }
+            double values[SlotNumber] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+            for (int pid = 0; pid < propertyNum; pid++)
+            {
+                pCur = NumberParser::SkipSpace(pCur, pLineEnd);
+                double value = 0;
+                const char* pNext = NumberParser::ParseDouble(pCur, pLineEnd, value);
+                if (pNext == NULL)
+                {
+                    break;
+                }
+                if (mSlotList[pid] != SlotNone)
+                {
+                    values[mSlotList[pid]] = value * mScaleList[pid];
+                }
+                pCur = pNext;
+            }
+            posList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+            if (mHasNormal)
+            {
+                norList.push_back(MagicMath::Vector3(values[3], values[4], values[5]));
+            }
+            if (mHasColor)
+            {
+                colorList.push_back(MagicMath::Vector3(values[6], values[7], values[8]));
+            }
+            decodeNum++;
+            pLine = pLineEnd + 1;
+        }
+        return pLine - pData;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Math/Vector3.h"
+#include <vector>
+#include <string>
+
+namespace MagicDGP
+{
+    //PLY reader for ascii, binary_little_endian and binary_big_endian files.
+    //The header is parsed once into a record layout, binary data is read from the memory mapped file in place.
+    class PlyReader
+    {
+    public:
+        PlyReader();
+        ~PlyReader();
+
+        bool Read(const std::string& fileName);
+        void ClearData();
+
+        const std::vector<MagicMath::Vector3>& GetPositionList() const;
+        const std::vector<MagicMath::Vector3>& GetNormalList() const; //empty if the file has no normal
+        const std::vector<MagicMath::Vector3>& GetColorList() const; //in [0, 1], empty if the file has no color
+        //3 vertex indices per triangle, polygons are fan triangulated
+        const std::vector<int>& GetIndexList() const;
+
+    private:
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mColorList;
+        std::vector<int> mIndexList;
+    };
+
+    //PLY writer, positions and normals are written as float, colors as uchar.
+    class PlyWriter
+    {
+    public:
+        //pNormalList, pColorList and pIndexList can be NULL
+        static bool Write(const std::string& fileName, const std::vector<MagicMath::Vector3>& posList,
+            const std::vector<MagicMath::Vector3>* pNormalList, const std::vector<MagicMath::Vector3>* pColorList,
+            const std::vector<int>* pIndexList, bool isBinary = true);
+    };
+
+    //Incremental decoder of the PLY vertex element for streaming reads, the vertex element has to be the first element.
+    class PlyVertexDecoder
+    {
+    public:
+        PlyVertexDecoder();
+
+        //[pData, pData + size) starts at the file start, returns the header size or 0 if no valid header is found
+        size_t ParseHeader(const char* pData, size_t size);
+        int  GetVertexNumber() const;
+        bool HasNormal() const;
+        bool HasColor() const;
+        //Appends at most maxNum vertices of [pData, pData + size) to the lists and returns the consumed size.
+        //Only complete records are consumed, a partial record is left for the next call.
+        size_t Decode(const char* pData, size_t size, int maxNum, std::vector<MagicMath::Vector3>& posList,
+            std::vector<MagicMath::Vector3>& norList, std::vector<MagicMath::Vector3>& colorList) const;
+
+    private:
+        size_t DecodeBinaryRecords(const char* pData, size_t size, int maxNum, std::vector<MagicMath::Vector3>& posList,
+            std::vector<MagicMath::Vector3>& norList, std::vector<MagicMath::Vector3>& colorList) const;
+        size_t DecodeAsciiLines(const char* pData, size_t size, int maxNum, std::vector<MagicMath::Vector3>& posList,
+            std::vector<MagicMath::Vector3>& norList, std::vector<MagicMath::Vector3>& colorList) const;
+
+    private:
+        bool mIsAscii;
+        bool mSwapBytes;
+        int  mVertexNum;
+        bool mHasNormal;
+        bool mHasColor;
+        size_t mRecordSize; //binary only
+        std::vector<int> mTypeList;
+        std::vector<int> mSlotList;
+        std::vector<double> mScaleList;
+        std::vector<size_t> mOffsetList;
+    };
+}
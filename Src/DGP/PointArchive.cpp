@@ -0,0 +1,826 @@
+#include "PointArchive.h"
+#include "BufferedWriter.h"
+#include "Tool/LogSystem.h"
+#include "../Common/Parallel.h"
+#include "../Common/ToolKit.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+    const char ArchiveMagic[8] = {'M', '3', 'D', 'P', 'A', 'C', 'K', '\0'};
+    const unsigned int ArchiveVersion = 1;
+    const int BlockPointNumber = 1 << 16;
+
+    enum ArchiveFlag
+    {
+        AF_HasNormal = 1,
+        AF_HasColor = 2
+    };
+
+    struct ArchiveHeader
+    {
+        char mMagic[8];
+        unsigned int mVersion;
+        unsigned int mFlags;
+        int mPointNumber;
+        int mBlockNumber;
+        int mPositionBits;
+        int mNormalBits;
+        double mBBoxMin[3];
+        double mCellSize[3];
+    };
+
+    struct ArchiveBlock
+    {
+        unsigned long long mOffset;
+        unsigned int mSize;
+        int mPointNumber;
+    };
+
+    //rANS with 32 bit state and byte renormalization, symbols are bit lengths of 64 bit values
+    const int SymbolNumber = 65;
+    const int ScaleBits = 12;
+    const unsigned int ScaleSize = 1 << ScaleBits;
+    const unsigned int RansLow = 1u << 23;
+
+    int GetBitLength(unsigned long long value)
+    {
+        int length = 0;
+        while (value != 0)
+        {
+            value >>= 1;
+            length++;
+        }
+        return length;
+    }
+
+    unsigned long long ZigZag(int value)
+    {
+        return (value < 0) ? ((unsigned long long)(-(long long)value) << 1) - 1 : (unsigned long long)value << 1;
+    }
+
+    int UnZigZag(unsigned long long value)
+    {
+        return (value & 1) ? -int((value + 1) >> 1) : int(value >> 1);
+    }
+
+    unsigned long long ExpandMortonBits(unsigned long long v)
+    {
+        v &= 0x1fffffULL;
+        v = (v | (v << 32)) & 0x1f00000000ffffULL;
+        v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+        v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+        v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+        v = (v | (v << 2)) & 0x1249249249249249ULL;
+        return v;
+    }
+
+    unsigned int CompactMortonBits(unsigned long long v)
+    {
+        v &= 0x1249249249249249ULL;
+        v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ULL;
+        v = (v ^ (v >> 4)) & 0x100f00f00f00f00fULL;
+        v = (v ^ (v >> 8)) & 0x1f0000ff0000ffULL;
+        v = (v ^ (v >> 16)) & 0x1f00000000ffffULL;
+        v = (v ^ (v >> 32)) & 0x1fffffULL;
+        return (unsigned int)v;
+    }
+
+    double GetSign(double value)
+    {
+        return value >= 0 ? 1.0 : -1.0;
+    }
+
+    void EncodeOctahedral(const MagicMath::Vector3& nor, int bits, int& u, int& v)
+    {
+        double length = fabs(nor[0]) + fabs(nor[1]) + fabs(nor[2]);
+        double x = (length > 0) ? nor[0] / length : 0;
+        double y = (length > 0) ? nor[1] / length : 0;
+        if (nor[2] < 0)
+        {
+            double foldX = (1 - fabs(y)) * GetSign(x);
+            y = (1 - fabs(x)) * GetSign(y);
+            x = foldX;
+        }
+        int maxValue = (1 << bits) - 1;
+        u = int(floor((x * 0.5 + 0.5) * maxValue + 0.5));
+        v = int(floor((y * 0.5 + 0.5) * maxValue + 0.5));
+    }
+
+    MagicMath::Vector3 DecodeOctahedral(int u, int v, int bits)
+    {
+        double maxValue = (1 << bits) - 1;
+        double x = u / maxValue * 2 - 1;
+        double y = v / maxValue * 2 - 1;
+        double z = 1 - fabs(x) - fabs(y);
+        if (z < 0)
+        {
+            double foldX = (1 - fabs(y)) * GetSign(x);
+            y = (1 - fabs(x)) * GetSign(y);
+            x = foldX;
+        }
+        MagicMath::Vector3 nor(x, y, z);
+        nor.Normalise();
+        return nor;
+    }
+
+    unsigned char ColorToByte(double value)
+    {
+        value = value < 0 ? 0 : (value > 1 ? 1 : value);
+        return (unsigned char)(value * 255.0 + 0.5);
+    }
+
+    void AppendBytes(std::vector<unsigned char>& output, const void* pData, size_t size)
+    {
+        const unsigned char* pByte = static_cast<const unsigned char*>(pData);
+        output.insert(output.end(), pByte, pByte + size);
+    }
+
+    class BitWriter
+    {
+    public:
+        BitWriter(std::vector<unsigned char>& output) :
+            mOutput(output),
+            mBuffer(0),
+            mBitNum(0)
+        {
+        }
+
+        void Write(unsigned long long value, int bitNum)
+        {
+            if (bitNum > 32)
+            {
+                WriteSmall(value & 0xffffffffULL, 32);
+                value >>= 32;
+                bitNum -= 32;
+            }
+            WriteSmall(value, bitNum);
+        }
+
+        void Flush()
+        {
+            if (mBitNum > 0)
+            {
+                mOutput.push_back((unsigned char)(mBuffer & 0xff));
+            }
+            mBuffer = 0;
+            mBitNum = 0;
+        }
+
+    private:
+        void WriteSmall(unsigned long long value, int bitNum)
+        {
+            mBuffer |= (value & ((1ULL << bitNum) - 1)) << mBitNum;
+            mBitNum += bitNum;
+            while (mBitNum >= 8)
+            {
+                mOutput.push_back((unsigned char)(mBuffer & 0xff));
+                mBuffer >>= 8;
+                mBitNum -= 8;
+            }
+        }
+
+    private:
+        std::vector<unsigned char>& mOutput;
+        unsigned long long mBuffer;
+        int mBitNum;
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader(const unsigned char* pData, const unsigned char* pEnd) :
+            mpData(pData),
+            mpEnd(pEnd),
+            mBuffer(0),
+            mBitNum(0),
+            mIsOverrun(false)
+        {
+        }
+
+        unsigned long long Read(int bitNum)
+        {
+            if (bitNum > 32)
+            {
+                unsigned long long low = ReadSmall(32);
+                return low | (ReadSmall(bitNum - 32) << 32);
+            }
+            return ReadSmall(bitNum);
+        }
+
+        bool IsOverrun() const
+        {
+            return mIsOverrun;
+        }
+
+    private:
+        unsigned long long ReadSmall(int bitNum)
+        {
+            while (mBitNum < bitNum)
+            {
+                unsigned long long byte = 0;
+                if (mpData < mpEnd)
+                {
+                    byte = *mpData++;
+                }
+                else
+                {
+                    mIsOverrun = true;
+                }
+                mBuffer |= byte << mBitNum;
+                mBitNum += 8;
+            }
+            unsigned long long value = mBuffer & ((1ULL << bitNum) - 1);
+            mBuffer >>= bitNum;
+            mBitNum -= bitNum;
+            return value;
+        }
+
+    private:
+        const unsigned char* mpData;
+        const unsigned char* mpEnd;
+        unsigned long long mBuffer;
+        int mBitNum;
+        bool mIsOverrun;
+    };
+
+    //Frequencies sum to ScaleSize and every used symbol keeps at least 1
+    void NormalizeFrequency(const std::vector<unsigned int>& countList, size_t valueNum, std::vector<unsigned int>& freqList)
+    {
+        freqList.assign(SymbolNumber, 0);
+        unsigned int freqSum = 0;
+        int maxSymbol = 0;
+        for (int sid = 0; sid < SymbolNumber; sid++)
+        {
+            if (countList[sid] == 0)
+            {
+                continue;
+            }
+            freqList[sid] = std::max(1u, (unsigned int)((unsigned long long)countList[sid] * ScaleSize / valueNum));
+            freqSum += freqList[sid];
+            if (freqList[sid] > freqList[maxSymbol])
+            {
+                maxSymbol = sid;
+            }
+        }
+        if (freqSum <= ScaleSize)
+        {
+            freqList[maxSymbol] += ScaleSize - freqSum;
+            return;
+        }
+        while (freqSum > ScaleSize)
+        {
+            int largest = int(std::max_element(freqList.begin(), freqList.end()) - freqList.begin());
+            unsigned int reduce = std::min(freqSum - ScaleSize, freqList[largest] / 2);
+            freqList[largest] -= reduce;
+            freqSum -= reduce;
+        }
+    }
+
+    //Stream layout: used symbol number, (symbol, frequency) pairs, rANS size and bytes, raw bit size and bytes
+    void EncodeValues(const std::vector<unsigned long long>& valueList, std::vector<unsigned char>& output)
+    {
+        size_t valueNum = valueList.size();
+        std::vector<unsigned char> symbolList(valueNum);
+        std::vector<unsigned int> countList(SymbolNumber, 0);
+        for (size_t vid = 0; vid < valueNum; vid++)
+        {
+            symbolList[vid] = (unsigned char)GetBitLength(valueList[vid]);
+            countList[symbolList[vid]]++;
+        }
+        std::vector<unsigned int> freqList;
+        std::vector<unsigned int> startList(SymbolNumber, 0);
+        if (valueNum > 0)
+        {
+            NormalizeFrequency(countList, valueNum, freqList);
+            for (int sid = 1; sid < SymbolNumber; sid++)
+            {
+                startList[sid] = startList[sid - 1] + freqList[sid - 1];
+            }
+        }
+        unsigned char usedNum = 0;
+        for (int sid = 0; sid < SymbolNumber && valueNum > 0; sid++)
+        {
+            usedNum += (freqList[sid] > 0) ? 1 : 0;
+        }
+        output.push_back(usedNum);
+        for (int sid = 0; sid < SymbolNumber && valueNum > 0; sid++)
+        {
+            if (freqList[sid] > 0)
+            {
+                unsigned short freq = (unsigned short)freqList[sid];
+                output.push_back((unsigned char)sid);
+                AppendBytes(output, &freq, sizeof(freq));
+            }
+        }
+        //symbols are encoded backwards, renormalization bytes are reversed behind the final state
+        std::vector<unsigned char> ransList;
+        if (valueNum > 0)
+        {
+            unsigned int state = RansLow;
+            for (size_t vid = valueNum; vid > 0; vid--)
+            {
+                int symbol = symbolList[vid - 1];
+                unsigned int freq = freqList[symbol];
+                unsigned int stateMax = ((RansLow >> ScaleBits) << 8) * freq;
+                while (state >= stateMax)
+                {
+                    ransList.push_back((unsigned char)(state & 0xff));
+                    state >>= 8;
+                }
+                state = ((state / freq) << ScaleBits) + (state % freq) + startList[symbol];
+            }
+            for (int k = 0; k < 4; k++)
+            {
+                ransList.push_back((unsigned char)(state >> (k * 8)));
+            }
+            std::reverse(ransList.begin(), ransList.end());
+        }
+        unsigned int ransSize = ransList.size();
+        AppendBytes(output, &ransSize, sizeof(ransSize));
+        output.insert(output.end(), ransList.begin(), ransList.end());
+        std::vector<unsigned char> rawList;
+        BitWriter bitWriter(rawList);
+        for (size_t vid = 0; vid < valueNum; vid++)
+        {
+            if (symbolList[vid] > 1)
+            {
+                bitWriter.Write(valueList[vid], symbolList[vid] - 1);
+            }
+        }
+        bitWriter.Flush();
+        unsigned int rawSize = rawList.size();
+        AppendBytes(output, &rawSize, sizeof(rawSize));
+        output.insert(output.end(), rawList.begin(), rawList.end());
+    }
+
+    bool DecodeValues(const unsigned char*& pData, const unsigned char* pEnd, size_t valueNum, unsigned long long* pValue)
+    {
+        if (pData >= pEnd)
+        {
+            return false;
+        }
+        int usedNum = *pData++;
+        if (pEnd - pData < usedNum * 3)
+        {
+            return false;
+        }
+        unsigned int freqList[SymbolNumber];
+        unsigned int startList[SymbolNumber];
+        memset(freqList, 0, sizeof(freqList));
+        for (int uid = 0; uid < usedNum; uid++)
+        {
+            int symbol = pData[0];
+            unsigned short freq;
+            memcpy(&freq, pData + 1, sizeof(freq));
+            pData += 3;
+            if (symbol >= SymbolNumber)
+            {
+                return false;
+            }
+            freqList[symbol] = freq;
+        }
+        unsigned int freqSum = 0;
+        for (int sid = 0; sid < SymbolNumber; sid++)
+        {
+            startList[sid] = freqSum;
+            freqSum += freqList[sid];
+        }
+        if (valueNum > 0 && freqSum != ScaleSize)
+        {
+            return false;
+        }
+        unsigned int ransSize, rawSize;
+        if (pEnd - pData < 4)
+        {
+            return false;
+        }
+        memcpy(&ransSize, pData, sizeof(ransSize));
+        pData += 4;
+        if ((size_t)(pEnd - pData) < ransSize)
+        {
+            return false;
+        }
+        const unsigned char* pRans = pData;
+        const unsigned char* pRansEnd = pData + ransSize;
+        pData = pRansEnd;
+        if (pEnd - pData < 4)
+        {
+            return false;
+        }
+        memcpy(&rawSize, pData, sizeof(rawSize));
+        pData += 4;
+        if ((size_t)(pEnd - pData) < rawSize)
+        {
+            return false;
+        }
+        BitReader bitReader(pData, pData + rawSize);
+        pData += rawSize;
+        if (valueNum == 0)
+        {
+            return true;
+        }
+        if (ransSize < 4)
+        {
+            return false;
+        }
+        unsigned char slotList[ScaleSize];
+        for (int sid = 0; sid < SymbolNumber; sid++)
+        {
+            memset(slotList + startList[sid], sid, freqList[sid]);
+        }
+        unsigned int state = (unsigned int)pRans[0] << 24 | (unsigned int)pRans[1] << 16 | (unsigned int)pRans[2] << 8 | pRans[3];
+        pRans += 4;
+        for (size_t vid = 0; vid < valueNum; vid++)
+        {
+            unsigned int slot = state & (ScaleSize - 1);
+            int symbol = slotList[slot];
+            state = freqList[symbol] * (state >> ScaleBits) + slot - startList[symbol];
+            while (state < RansLow && pRans < pRansEnd)
+            {
+                state = (state << 8) | *pRans++;
+            }
+            if (symbol == 0)
+            {
+                pValue[vid] = 0;
+            }
+            else
+            {
+                pValue[vid] = (1ULL << (symbol - 1)) | (symbol > 1 ? bitReader.Read(symbol - 1) : 0);
+            }
+        }
+        return !bitReader.IsOverrun();
+    }
+
+    struct ArchiveSource
+    {
+        const MagicDGP::Point3DSet* mpPointSet;
+        std::vector<std::pair<unsigned long long, int> > mCodeList; //Morton code and point index, sorted
+        bool mHasNormal;
+        int mNormalBits;
+    };
+
+    void EncodeBlock(const ArchiveSource& source, int pointStart, int pointEnd, std::vector<unsigned char>& output)
+    {
+        int pointNum = pointEnd - pointStart;
+        std::vector<unsigned long long> valueList(pointNum);
+        unsigned long long preCode = 0;
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            unsigned long long code = source.mCodeList[pointStart + pid].first;
+            valueList[pid] = code - preCode;
+            preCode = code;
+        }
+        EncodeValues(valueList, output);
+        if (source.mHasNormal)
+        {
+            valueList.resize(pointNum * 2);
+            int preU = 0, preV = 0;
+            for (int pid = 0; pid < pointNum; pid++)
+            {
+                int u, v;
+                EncodeOctahedral(source.mpPointSet->GetPoint(source.mCodeList[pointStart + pid].second)->GetNormal(), source.mNormalBits, u, v);
+                valueList[pid * 2] = ZigZag(u - preU);
+                valueList[pid * 2 + 1] = ZigZag(v - preV);
+                preU = u;
+                preV = v;
+            }
+            EncodeValues(valueList, output);
+        }
+        valueList.resize(pointNum * 3);
+        int preColor[3] = {0, 0, 0};
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 color = source.mpPointSet->GetPoint(source.mCodeList[pointStart + pid].second)->GetColor();
+            for (int k = 0; k < 3; k++)
+            {
+                int value = ColorToByte(color[k]);
+                valueList[pid * 3 + k] = ZigZag(value - preColor[k]);
+                preColor[k] = value;
+            }
+        }
+        EncodeValues(valueList, output);
+    }
+}
+
+namespace MagicDGP
+{
+    bool PointArchive::Save(const std::string& fileName, const Point3DSet* pPointSet, int positionBits, int normalBits)
+    {
+        DebugLog << "PointArchive::Save: " << fileName.c_str() << std::endl;
+        double timeStart = MagicCore::ToolKit::GetTime();
+        if (positionBits < 1 || positionBits > 21 || normalBits < 4 || normalBits > 16)
+        {
+            ErrorLog << "PointArchive::Save: invalid bits " << positionBits << " " << normalBits << std::endl;
+            return false;
+        }
+        int pointNum = pPointSet->GetPointNumber();
+        ArchiveHeader header;
+        memset(&header, 0, sizeof(ArchiveHeader));
+        memcpy(header.mMagic, ArchiveMagic, sizeof(ArchiveMagic));
+        header.mVersion = ArchiveVersion;
+        header.mFlags = AF_HasColor | (pPointSet->HasNormal() ? AF_HasNormal : 0);
+        header.mPointNumber = pointNum;
+        header.mBlockNumber = (pointNum + BlockPointNumber - 1) / BlockPointNumber;
+        header.mPositionBits = positionBits;
+        header.mNormalBits = normalBits;
+        MagicMath::Vector3 bboxMin(0, 0, 0), bboxMax(0, 0, 0);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+            for (int k = 0; k < 3; k++)
+            {
+                bboxMin[k] = (pid == 0 || pos[k] < bboxMin[k]) ? pos[k] : bboxMin[k];
+                bboxMax[k] = (pid == 0 || pos[k] > bboxMax[k]) ? pos[k] : bboxMax[k];
+            }
+        }
+        double maxCell = double((1 << positionBits) - 1);
+        for (int k = 0; k < 3; k++)
+        {
+            header.mBBoxMin[k] = bboxMin[k];
+            header.mCellSize[k] = (bboxMax[k] > bboxMin[k]) ? (bboxMax[k] - bboxMin[k]) / maxCell : 1.0;
+        }
+        ArchiveSource source;
+        source.mpPointSet = pPointSet;
+        source.mHasNormal = pPointSet->HasNormal();
+        source.mNormalBits = normalBits;
+        source.mCodeList.resize(pointNum);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+            unsigned long long code = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                double cell = floor((pos[k] - header.mBBoxMin[k]) / header.mCellSize[k] + 0.5);
+                cell = cell < 0 ? 0 : (cell > maxCell ? maxCell : cell);
+                code |= ExpandMortonBits((unsigned long long)cell) << k;
+            }
+            source.mCodeList[pid] = std::make_pair(code, pid);
+        }
+        std::sort(source.mCodeList.begin(), source.mCodeList.end());
+        std::vector<std::vector<unsigned char> > blockDataList(header.mBlockNumber);
+        MagicCore::ParallelFor(0, header.mBlockNumber, [&](int startBlock, int endBlock)
+        {
+            for (int bid = startBlock; bid < endBlock; bid++)
+            {
+                EncodeBlock(source, bid * BlockPointNumber, std::min(pointNum, (bid + 1) * BlockPointNumber), blockDataList.at(bid));
+            }
+        }, 1);
+        std::vector<ArchiveBlock> blockList(header.mBlockNumber);
+        unsigned long long offset = sizeof(ArchiveHeader) + sizeof(ArchiveBlock) * blockList.size();
+        for (int bid = 0; bid < header.mBlockNumber; bid++)
+        {
+            blockList.at(bid).mOffset = offset;
+            blockList.at(bid).mSize = blockDataList.at(bid).size();
+            blockList.at(bid).mPointNumber = std::min(pointNum, (bid + 1) * BlockPointNumber) - bid * BlockPointNumber;
+            offset += blockDataList.at(bid).size();
+        }
+        BufferedWriter writer;
+        if (!writer.Open(fileName))
+        {
+            return false;
+        }
+        writer.WriteBytes(&header, sizeof(ArchiveHeader));
+        if (!blockList.empty())
+        {
+            writer.WriteBytes(&(blockList[0]), sizeof(ArchiveBlock) * blockList.size());
+        }
+        for (int bid = 0; bid < header.mBlockNumber; bid++)
+        {
+            if (!blockDataList.at(bid).empty())
+            {
+                writer.WriteBytes(&(blockDataList.at(bid)[0]), blockDataList.at(bid).size());
+            }
+        }
+        DebugLog << "PointArchive::Save: " << pointNum << " points in " << offset << " bytes, time: "
+            << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return writer.Close();
+    }
+
+    Point3DSet* PointArchive::Load(const std::string& fileName)
+    {
+        DebugLog << "PointArchive::Load: " << fileName.c_str() << std::endl;
+        double timeStart = MagicCore::ToolKit::GetTime();
+        PointArchiveReader reader;
+        if (!reader.Open(fileName))
+        {
+            return NULL;
+        }
+        int pointNum = reader.GetPointNumber();
+        int blockNum = reader.GetBlockNumber();
+        std::vector<MagicMath::Vector3> posList(pointNum);
+        std::vector<MagicMath::Vector3> norList(reader.HasNormal() ? pointNum : 0);
+        std::vector<MagicMath::Vector3> colorList(reader.HasColor() ? pointNum : 0);
+        std::vector<int> blockStartList(blockNum + 1, 0);
+        for (int bid = 0; bid < blockNum; bid++)
+        {
+            blockStartList.at(bid + 1) = blockStartList.at(bid) + reader.GetBlockPointNumber(bid);
+        }
+        bool isValid = MagicCore::ParallelReduce(0, blockNum, true, [&](int startBlock, int endBlock, bool blockValid)
+        {
+            for (int bid = startBlock; bid < endBlock; bid++)
+            {
+                int start = blockStartList.at(bid);
+                MagicMath::Vector3* pNormal = reader.HasNormal() ? &(norList[start]) : NULL;
+                MagicMath::Vector3* pColor = reader.HasColor() ? &(colorList[start]) : NULL;
+                blockValid = reader.DecodeBlock(bid, &(posList[start]), pNormal, pColor) && blockValid;
+            }
+            return blockValid;
+        }, [](bool leftValid, bool rightValid) { return leftValid && rightValid; }, 1);
+        if (!isValid)
+        {
+            ErrorLog << "PointArchive::Load: corrupted block in " << fileName.c_str() << std::endl;
+            return NULL;
+        }
+        Point3DSet* pPointSet = new Point3DSet;
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            Point3D* pPoint = reader.HasNormal() ? pPointSet->InsertPoint(posList[pid], norList[pid]) : pPointSet->InsertPoint(posList[pid]);
+            if (reader.HasColor())
+            {
+                pPoint->SetColor(colorList[pid]);
+            }
+        }
+        pPointSet->SetHasNormal(reader.HasNormal());
+        InfoLog << "Import Point Number: " << pointNum << " time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return pPointSet;
+    }
+
+    bool PointArchive::IsArchive(const std::string& fileName)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            return false;
+        }
+        char magic[sizeof(ArchiveMagic)];
+        bool isArchive = (fread(magic, 1, sizeof(magic), pFile) == sizeof(magic) && memcmp(magic, ArchiveMagic, sizeof(magic)) == 0);
+        fclose(pFile);
+        return isArchive;
+    }
+
+    PointArchiveReader::PointArchiveReader() :
+        mFile(),
+        mPointNumber(0),
+        mHasNormal(false),
+        mHasColor(false),
+        mNormalBits(0),
+        mBBoxMin(0, 0, 0),
+        mCellSize(0, 0, 0),
+        mBlockOffsetList(),
+        mBlockSizeList(),
+        mBlockPointNumberList()
+    {
+    }
+
+    PointArchiveReader::~PointArchiveReader()
+    {
+    }
+
+    bool PointArchiveReader::Open(const std::string& fileName)
+    {
+        Close();
+        if (!mFile.Open(fileName))
+        {
+            return false;
+        }
+        const char* pData = mFile.GetData();
+        size_t fileSize = mFile.GetSize();
+        ArchiveHeader header;
+        if (fileSize < sizeof(ArchiveHeader) || memcmp(pData, ArchiveMagic, sizeof(ArchiveMagic)) != 0)
+        {
+            ErrorLog << "PointArchiveReader::Open: not an archive " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        memcpy(&header, pData, sizeof(ArchiveHeader));
+        if (header.mVersion != ArchiveVersion || header.mPointNumber < 0 || header.mBlockNumber < 0 ||
+            header.mNormalBits < 4 || header.mNormalBits > 16 || header.mPositionBits < 1 || header.mPositionBits > 21 ||
+            (size_t)header.mBlockNumber > (fileSize - sizeof(ArchiveHeader)) / sizeof(ArchiveBlock))
+        {
+            ErrorLog << "PointArchiveReader::Open: corrupted header " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        long long pointSum = 0;
+        for (int bid = 0; bid < header.mBlockNumber; bid++)
+        {
+            ArchiveBlock block;
+            memcpy(&block, pData + sizeof(ArchiveHeader) + sizeof(ArchiveBlock) * bid, sizeof(ArchiveBlock));
+            if (block.mOffset > fileSize || block.mSize > fileSize - block.mOffset || block.mPointNumber < 0 ||
+                block.mPointNumber > BlockPointNumber)
+            {
+                ErrorLog << "PointArchiveReader::Open: corrupted block " << bid << " in " << fileName.c_str() << std::endl;
+                Close();
+                return false;
+            }
+            mBlockOffsetList.push_back(block.mOffset);
+            mBlockSizeList.push_back(block.mSize);
+            mBlockPointNumberList.push_back(block.mPointNumber);
+            pointSum += block.mPointNumber;
+        }
+        if (pointSum != header.mPointNumber)
+        {
+            ErrorLog << "PointArchiveReader::Open: point number mismatch in " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        mPointNumber = header.mPointNumber;
+        mHasNormal = (header.mFlags & AF_HasNormal) != 0;
+        mHasColor = (header.mFlags & AF_HasColor) != 0;
+        mNormalBits = header.mNormalBits;
+        mBBoxMin = MagicMath::Vector3(header.mBBoxMin[0], header.mBBoxMin[1], header.mBBoxMin[2]);
+        mCellSize = MagicMath::Vector3(header.mCellSize[0], header.mCellSize[1], header.mCellSize[2]);
+        return true;
+    }
+
+    void PointArchiveReader::Close()
+    {
+        mFile.Close();
+        mPointNumber = 0;
+        mBlockOffsetList.clear();
+        mBlockSizeList.clear();
+        mBlockPointNumberList.clear();
+    }
+
+    int PointArchiveReader::GetPointNumber() const
+    {
+        return mPointNumber;
+    }
+
+    int PointArchiveReader::GetBlockNumber() const
+    {
+        return mBlockPointNumberList.size();
+    }
+
+    int PointArchiveReader::GetBlockPointNumber(int blockIndex) const
+    {
+        return mBlockPointNumberList.at(blockIndex);
+    }
+
+    bool PointArchiveReader::HasNormal() const
+    {
+        return mHasNormal;
+    }
+
+    bool PointArchiveReader::HasColor() const
+    {
+        return mHasColor;
+    }
+
+    bool PointArchiveReader::DecodeBlock(int blockIndex, MagicMath::Vector3* pPosition, MagicMath::Vector3* pNormal, MagicMath::Vector3* pColor) const
+    {
+        int pointNum = mBlockPointNumberList.at(blockIndex);
+        const unsigned char* pData = reinterpret_cast<const unsigned char*>(mFile.GetData()) + mBlockOffsetList.at(blockIndex);
+        const unsigned char* pEnd = pData + mBlockSizeList.at(blockIndex);
+        std::vector<unsigned long long> valueList(pointNum * 3 + 1);
+        if (!DecodeValues(pData, pEnd, pointNum, &(valueList[0])))
+        {
+            return false;
+        }
+        unsigned long long code = 0;
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            code += valueList[pid];
+            MagicMath::Vector3& pos = pPosition[pid];
+            for (int k = 0; k < 3; k++)
+            {
+                pos[k] = mBBoxMin[k] + CompactMortonBits(code >> k) * mCellSize[k];
+            }
+        }
+        if (mHasNormal)
+        {
+            if (!DecodeValues(pData, pEnd, pointNum * 2, &(valueList[0])))
+            {
+                return false;
+            }
+            int u = 0, v = 0;
+            for (int pid = 0; pid < pointNum && pNormal != NULL; pid++)
+            {
+                u += UnZigZag(valueList[pid * 2]);
+                v += UnZigZag(valueList[pid * 2 + 1]);
+                pNormal[pid] = DecodeOctahedral(u, v, mNormalBits);
+            }
+        }
+        if (mHasColor)
+        {
+            if (!DecodeValues(pData, pEnd, pointNum * 3, &(valueList[0])))
+            {
+                return false;
+            }
+            int color[3] = {0, 0, 0};
+            for (int pid = 0; pid < pointNum && pColor != NULL; pid++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    color[k] += UnZigZag(valueList[pid * 3 + k]);
+                }
+                pColor[pid] = MagicMath::Vector3(color[0] / 255.0, color[1] / 255.0, color[2] / 255.0);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "PointCloud3D.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+namespace MagicDGP
+{
+    //Compressed point set archive (.m3c). Positions are quantized in the bbox, sorted in Morton order and cut into
+    //blocks of fixed point number. In a block, Morton code deltas, octahedral normal deltas and color deltas are
+    //coded by rANS on their bit length, blocks are encoded and decoded by all processors.
+    //Loaded points are in Morton order, not in the saved order.
+    class PointArchive
+    {
+    public:
+        //positionBits per axis in [1, 21], normalBits per octahedral coordinate in [4, 16]
+        static bool Save(const std::string& fileName, const Point3DSet* pPointSet, int positionBits = 16, int normalBits = 12);
+        static Point3DSet* Load(const std::string& fileName);
+        //Checks the magic bytes, the file extension is not used
+        static bool IsArchive(const std::string& fileName);
+    };
+
+    //Block wise decoder of a mapped archive
+    class PointArchiveReader
+    {
+    public:
+        PointArchiveReader();
+        ~PointArchiveReader();
+
+        bool Open(const std::string& fileName);
+        void Close();
+        int  GetPointNumber() const;
+        int  GetBlockNumber() const;
+        int  GetBlockPointNumber(int blockIndex) const;
+        bool HasNormal() const;
+        bool HasColor() const;
+        //Writes GetBlockPointNumber values to each list, pNormal and pColor can be NULL.
+        //Different blocks can be decoded at the same time. False if the block is corrupted.
+        bool DecodeBlock(int blockIndex, MagicMath::Vector3* pPosition, MagicMath::Vector3* pNormal, MagicMath::Vector3* pColor) const;
+
+    private:
+        MappedFile mFile;
+        int mPointNumber;
+        bool mHasNormal;
+        bool mHasColor;
+        int mNormalBits;
+        MagicMath::Vector3 mBBoxMin;
+        MagicMath::Vector3 mCellSize;
+        std::vector<unsigned long long> mBlockOffsetList;
+        std::vector<unsigned int> mBlockSizeList;
+        std::vector<int> mBlockPointNumberList;
+    };
+}
@@ -1,6 +1,6 @@
 //#include "StdAfx.h"
 #include "PointCloud3D.h"
-#include "flann/flann.h"
+#include "SpatialIndex.h"
 
 namespace MagicDGP
 {
@@ -104,21 +104,20 @@ namespace MagicDGP
     }
 
     Point3DSet::Point3DSet() : 
+        mpSpatialIndex(NULL),
+        mDensity(0),
         mHasNormal(false)
     {
     }
 
     Point3DSet::~Point3DSet()
     {
-        for (std::vector<Point3D* >::iterator itr = mPointSet.begin(); itr != mPointSet.end(); itr++)
+        ClearData();
+        if (mpSpatialIndex != NULL)
         {
-            if (*itr != NULL)
-            {
-                delete *itr;
-                *itr = NULL;
-            }
+            delete mpSpatialIndex;
+            mpSpatialIndex = NULL;
         }
-        mPointSet.clear();
     }
 
     std::vector<Point3D* >& Point3DSet::GetPointSet()
@@ -140,11 +139,12 @@ namespace MagicDGP
     {
         if (index >=0 && index < mPointSet.size())
         {
-            if (mPointSet.at(index) != NULL)
+            if (mPointSet.at(index) != NULL && !mPointPool.Owns(mPointSet[index]))
             {
                 delete mPointSet[index];
             }
             mPointSet[index] = pPoint;
+            InvalidateSpatialIndex();
             return true;
         }
         else
@@ -185,6 +185,7 @@ namespace MagicDGP
             {
                 (*itr)->SetPosition(((*itr)->GetPosition() - centerPos) * scaleV);
             }
+            InvalidateSpatialIndex();
         }
         mBBoxMin = MagicMath::Vector3(-size, -size, -size);
         mBBoxMax = MagicMath::Vector3(size, size, size);
@@ -194,6 +195,21 @@ namespace MagicDGP
     {
         pPoint->SetId(mPointSet.size());
         mPointSet.push_back(pPoint);
+        InvalidateSpatialIndex();
+    }
+
+    Point3D* Point3DSet::InsertPoint(const MagicMath::Vector3& pos)
+    {
+        Point3D* pPoint = mPointPool.Create(pos);
+        InsertPoint(pPoint);
+        return pPoint;
+    }
+
+    Point3D* Point3DSet::InsertPoint(const MagicMath::Vector3& pos, const MagicMath::Vector3& nor)
+    {
+        Point3D* pPoint = mPointPool.Create(pos, nor);
+        InsertPoint(pPoint);
+        return pPoint;
     }
 
     int Point3DSet::GetPointNumber() const
@@ -246,37 +262,12 @@ namespace MagicDGP
 
     void Point3DSet::CalculateDensity()
     {
-        int dim = 3;
         int pointNum = mPointSet.size();
-        int refNum = pointNum;
-        float* dataSet = new float[refNum * dim];
-        int searchNum = pointNum;
-        float* searchSet = new float[searchNum * dim];
-        for (int i = 0; i < pointNum; i++)
-        {
-            MagicMath::Vector3 pos = mPointSet.at(i)->GetPosition();
-            dataSet[dim * i + 0] = pos[0];
-            dataSet[dim * i + 1] = pos[1];
-            dataSet[dim * i + 2] = pos[2];
-            searchSet[dim * i + 0] = pos[0];
-            searchSet[dim * i + 1] = pos[1];
-            searchSet[dim * i + 2] = pos[2];
-        }
         int nn = 9;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
+        std::vector<int> indexList;
+        std::vector<float> distList;
+        GetSpatialIndex()->KnnSearchSelf(nn, indexList, distList);
+        const float* pDist = distList.empty() ? NULL : &(distList[0]);
 
         mDensity = 0;
         for (int i = 0; i < pointNum; i++)
@@ -288,25 +279,471 @@ namespace MagicDGP
             }
         }
         mDensity /= (pointNum * nn);
-        if (pIndex != NULL)
+    }
+
+    bool Point3DSet::HasNormal() const
+    {
+        return mHasNormal;
+    }
+
+    void Point3DSet::SetHasNormal(bool has)
+    {
+        mHasNormal = has;
+    }
+
+    void Point3DSet::ClearData()
+    {
+        //Pool points are released together
+        for (std::vector<Point3D* >::iterator itr = mPointSet.begin(); itr != mPointSet.end(); itr++)
         {
-            delete []pIndex;
-            pIndex = NULL;
+            if (*itr != NULL && !mPointPool.Owns(*itr))
+            {
+                delete *itr;
+            }
+            *itr = NULL;
         }
-        if (pDist != NULL)
+        std::vector<Point3D* >().swap(mPointSet);
+        mPointPool.Clear();
+        InvalidateSpatialIndex();
+    }
+
+    const SpatialIndex* Point3DSet::GetSpatialIndex() const
+    {
+        std::lock_guard<std::mutex> lock(mSpatialIndexMutex);
+        if (mpSpatialIndex == NULL)
+        {
+            mpSpatialIndex = new SpatialIndex;
+        }
+        //Points can be moved through GetPoint or GetPointSet. Checking every position costs much less than
+        //the whole set searches the index is used for
+        if (!mpSpatialIndex->IsBuiltFrom(this))
         {
-            delete []pDist;
-            pDist = NULL;
+            mpSpatialIndex->Build(this);
         }
+        return mpSpatialIndex;
     }
 
-    bool Point3DSet::HasNormal() const
+    void Point3DSet::InvalidateSpatialIndex()
+    {
+        std::lock_guard<std::mutex> lock(mSpatialIndexMutex);
+        if (mpSpatialIndex != NULL)
+        {
+            mpSpatialIndex->Clear();
+        }
+    }
+
+    LightPoint3DSet::LightPoint3DSet() : 
+        mpSpatialIndex(NULL),
+        mDensity(0),
+        mHasNormal(false),
+        mHasColor(false)
+    {
+    }
+
+    LightPoint3DSet::~LightPoint3DSet()
+    {
+        ClearData();
+        if (mpSpatialIndex != NULL)
+        {
+            delete mpSpatialIndex;
+            mpSpatialIndex = NULL;
+        }
+    }
+
+    LightPoint3DSet* LightPoint3DSet::CreateFromPoint3DSet(const Point3DSet* pPointSet)
+    {
+        LightPoint3DSet* pLightSet = new LightPoint3DSet;
+        int pointNum = pPointSet->GetPointNumber();
+        pLightSet->Reserve(pointNum);
+        //Only keep color channel when some point is not in default color
+        MagicMath::Vector3 defaultColor = Point3D().GetColor();
+        bool hasColor = false;
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            const Point3D* pPoint = pPointSet->GetPoint(pid);
+            if (pPointSet->HasNormal())
+            {
+                pLightSet->InsertPoint(pPoint->GetPosition(), pPoint->GetNormal());
+            }
+            else
+            {
+                pLightSet->InsertPoint(pPoint->GetPosition());
+            }
+            if (!hasColor && (pPoint->GetColor() - defaultColor).LengthSquared() > 1.0e-15)
+            {
+                hasColor = true;
+            }
+        }
+        if (hasColor)
+        {
+            pLightSet->SetHasColor(true);
+            for (int pid = 0; pid < pointNum; pid++)
+            {
+                pLightSet->SetColor(pid, pPointSet->GetPoint(pid)->GetColor());
+            }
+        }
+        pPointSet->GetBBox(pLightSet->mBBoxMin, pLightSet->mBBoxMax);
+        pLightSet->mDensity = pPointSet->GetDensity();
+
+        return pLightSet;
+    }
+
+    Point3DSet* LightPoint3DSet::CreatePoint3DSet() const
+    {
+        Point3DSet* pPointSet = new Point3DSet;
+        int pointNum = GetPointNumber();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            Point3D* pPoint = mHasNormal ? pPointSet->InsertPoint(GetPosition(pid), GetNormal(pid)) : pPointSet->InsertPoint(GetPosition(pid));
+            if (mHasColor)
+            {
+                pPoint->SetColor(GetColor(pid));
+            }
+        }
+        pPointSet->SetHasNormal(mHasNormal);
+        if (pointNum > 0)
+        {
+            pPointSet->CalculateBBox();
+        }
+
+        return pPointSet;
+    }
+
+    void LightPoint3DSet::Reserve(int pointNum)
+    {
+        InvalidateSpatialIndex();
+        mPositionList.reserve(pointNum * 3);
+        if (mHasNormal)
+        {
+            mNormalList.reserve(pointNum * 3);
+        }
+        if (mHasColor)
+        {
+            mColorList.reserve(pointNum * 3);
+        }
+    }
+
+    int LightPoint3DSet::InsertPoint(const MagicMath::Vector3& pos)
+    {
+        InvalidateSpatialIndex();
+        int index = GetPointNumber();
+        mPositionList.push_back(pos[0]);
+        mPositionList.push_back(pos[1]);
+        mPositionList.push_back(pos[2]);
+        if (mHasNormal)
+        {
+            mNormalList.resize(mPositionList.size(), 0);
+        }
+        if (mHasColor)
+        {
+            MagicMath::Vector3 defaultColor = Point3D().GetColor();
+            mColorList.push_back(defaultColor[0]);
+            mColorList.push_back(defaultColor[1]);
+            mColorList.push_back(defaultColor[2]);
+        }
+        return index;
+    }
+
+    int LightPoint3DSet::InsertPoint(const MagicMath::Vector3& pos, const MagicMath::Vector3& nor)
+    {
+        if (!mHasNormal)
+        {
+            SetHasNormal(true);
+        }
+        int index = InsertPoint(pos);
+        SetNormal(index, nor);
+        return index;
+    }
+
+    int LightPoint3DSet::GetPointNumber() const
+    {
+        return mPositionList.size() / 3;
+    }
+
+    Point3D LightPoint3DSet::GetPoint(int index) const
+    {
+        Point3D point(GetPosition(index), GetNormal(index), index);
+        if (mHasColor)
+        {
+            point.SetColor(GetColor(index));
+        }
+        return point;
+    }
+
+    MagicMath::Vector3 LightPoint3DSet::GetPosition(int index) const
+    {
+        return MagicMath::Vector3(mPositionList[index * 3], mPositionList[index * 3 + 1], mPositionList[index * 3 + 2]);
+    }
+
+    void LightPoint3DSet::SetPosition(int index, const MagicMath::Vector3& pos)
+    {
+        InvalidateSpatialIndex();
+        mPositionList[index * 3] = pos[0];
+        mPositionList[index * 3 + 1] = pos[1];
+        mPositionList[index * 3 + 2] = pos[2];
+    }
+
+    MagicMath::Vector3 LightPoint3DSet::GetNormal(int index) const
+    {
+        if (!mHasNormal)
+        {
+            return MagicMath::Vector3(0, 0, 0);
+        }
+        return MagicMath::Vector3(mNormalList[index * 3], mNormalList[index * 3 + 1], mNormalList[index * 3 + 2]);
+    }
+
+    void LightPoint3DSet::SetNormal(int index, const MagicMath::Vector3& nor)
+    {
+        mNormalList[index * 3] = nor[0];
+        mNormalList[index * 3 + 1] = nor[1];
+        mNormalList[index * 3 + 2] = nor[2];
+    }
+
+    MagicMath::Vector3 LightPoint3DSet::GetColor(int index) const
+    {
+        if (!mHasColor)
+        {
+            return Point3D().GetColor();
+        }
+        return MagicMath::Vector3(mColorList[index * 3], mColorList[index * 3 + 1], mColorList[index * 3 + 2]);
+    }
+
+    void LightPoint3DSet::SetColor(int index, const MagicMath::Vector3& color)
+    {
+        mColorList[index * 3] = color[0];
+        mColorList[index * 3 + 1] = color[1];
+        mColorList[index * 3 + 2] = color[2];
+    }
+
+    void LightPoint3DSet::SetColor(MagicMath::Vector3 color)
+    {
+        SetHasColor(true);
+        int pointNum = GetPointNumber();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            SetColor(pid, color);
+        }
+    }
+
+    bool LightPoint3DSet::HasNormal() const
     {
         return mHasNormal;
     }
 
-    void Point3DSet::SetHasNormal(bool has)
+    void LightPoint3DSet::SetHasNormal(bool has)
     {
         mHasNormal = has;
+        if (has)
+        {
+            mNormalList.resize(mPositionList.size(), 0);
+        }
+        else
+        {
+            std::vector<float>().swap(mNormalList);
+        }
+    }
+
+    bool LightPoint3DSet::HasColor() const
+    {
+        return mHasColor;
+    }
+
+    void LightPoint3DSet::SetHasColor(bool has)
+    {
+        if (has && !mHasColor)
+        {
+            MagicMath::Vector3 defaultColor = Point3D().GetColor();
+            int pointNum = GetPointNumber();
+            mColorList.resize(pointNum * 3);
+            for (int pid = 0; pid < pointNum; pid++)
+            {
+                mColorList[pid * 3] = defaultColor[0];
+                mColorList[pid * 3 + 1] = defaultColor[1];
+                mColorList[pid * 3 + 2] = defaultColor[2];
+            }
+        }
+        else if (!has)
+        {
+            std::vector<float>().swap(mColorList);
+        }
+        mHasColor = has;
+    }
+
+    FloatView3 LightPoint3DSet::GetPositionView() const
+    {
+        FloatView3 view;
+        view.mpData = mPositionList.empty() ? NULL : &(mPositionList[0]);
+        view.mStride = 3;
+        view.mCount = GetPointNumber();
+        return view;
+    }
+
+    FloatView3 LightPoint3DSet::GetNormalView() const
+    {
+        FloatView3 view;
+        view.mpData = mNormalList.empty() ? NULL : &(mNormalList[0]);
+        view.mStride = 3;
+        view.mCount = mNormalList.size() / 3;
+        return view;
+    }
+
+    FloatView3 LightPoint3DSet::GetColorView() const
+    {
+        FloatView3 view;
+        view.mpData = mColorList.empty() ? NULL : &(mColorList[0]);
+        view.mStride = 3;
+        view.mCount = mColorList.size() / 3;
+        return view;
+    }
+
+    float* LightPoint3DSet::GetPositionData()
+    {
+        InvalidateSpatialIndex();
+        return mPositionList.empty() ? NULL : &(mPositionList[0]);
+    }
+
+    float* LightPoint3DSet::GetNormalData()
+    {
+        return mNormalList.empty() ? NULL : &(mNormalList[0]);
+    }
+
+    float* LightPoint3DSet::GetColorData()
+    {
+        return mColorList.empty() ? NULL : &(mColorList[0]);
+    }
+
+    void LightPoint3DSet::UnifyPosition(double size)
+    {
+        int pointNum = GetPointNumber();
+        if (pointNum == 0)
+        {
+            return;
+        }
+        CalculateBBox();
+        MagicMath::Vector3 scale3 = mBBoxMax - mBBoxMin;
+        double scaleMax = scale3[0];
+        if (scaleMax < scale3[1])
+        {
+            scaleMax = scale3[1];
+        }
+        if (scaleMax < scale3[2])
+        {
+            scaleMax = scale3[2];
+        }
+        if (scaleMax > 1.0e-15)
+        {
+            InvalidateSpatialIndex();
+            double scaleV = size / scaleMax;
+            MagicMath::Vector3 centerPos = (mBBoxMin + mBBoxMax) / 2.0;
+            for (int pid = 0; pid < pointNum; pid++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    mPositionList[pid * 3 + k] = (mPositionList[pid * 3 + k] - centerPos[k]) * scaleV;
+                }
+            }
+        }
+        mBBoxMin = MagicMath::Vector3(-size, -size, -size);
+        mBBoxMax = MagicMath::Vector3(size, size, size);
+    }
+
+    void LightPoint3DSet::GetBBox(MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax) const
+    {
+        bboxMin = mBBoxMin;
+        bboxMax = mBBoxMax;
+    }
+
+    void LightPoint3DSet::CalculateBBox()
+    {
+        int pointNum = GetPointNumber();
+        if (pointNum == 0)
+        {
+            return;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            mBBoxMin[k] = mBBoxMax[k] = mPositionList[k];
+        }
+        for (int pid = 1; pid < pointNum; pid++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                float v = mPositionList[pid * 3 + k];
+                if (mBBoxMin[k] > v)
+                {
+                    mBBoxMin[k] = v;
+                }
+                if (mBBoxMax[k] < v)
+                {
+                    mBBoxMax[k] = v;
+                }
+            }
+        }
+    }
+
+    double LightPoint3DSet::GetDensity() const
+    {
+        return mDensity;
+    }
+
+    void LightPoint3DSet::CalculateDensity()
+    {
+        //Same as Point3DSet::CalculateDensity, but the index reads positions in place
+        int pointNum = GetPointNumber();
+        if (pointNum == 0)
+        {
+            mDensity = 0;
+            return;
+        }
+        int nn = 9;
+        if (nn > pointNum)
+        {
+            nn = pointNum;
+        }
+        std::vector<int> indexList;
+        std::vector<float> distList;
+        GetSpatialIndex()->KnnSearchSelf(nn, indexList, distList);
+        const float* pDist = &(distList[0]);
+
+        mDensity = 0;
+        for (int i = 0; i < pointNum * nn; i++)
+        {
+            mDensity += pDist[i];
+        }
+        mDensity /= (pointNum * nn);
+    }
+
+    void LightPoint3DSet::ClearData()
+    {
+        InvalidateSpatialIndex();
+        std::vector<float>().swap(mPositionList);
+        std::vector<float>().swap(mNormalList);
+        std::vector<float>().swap(mColorList);
+        mHasNormal = false;
+        mHasColor = false;
+        mDensity = 0;
+    }
+
+    const SpatialIndex* LightPoint3DSet::GetSpatialIndex() const
+    {
+        std::lock_guard<std::mutex> lock(mSpatialIndexMutex);
+        if (mpSpatialIndex == NULL)
+        {
+            mpSpatialIndex = new SpatialIndex;
+        }
+        if (!mpSpatialIndex->IsBuilt())
+        {
+            mpSpatialIndex->Build(GetPositionView());
+        }
+        return mpSpatialIndex;
+    }
+
+    void LightPoint3DSet::InvalidateSpatialIndex()
+    {
+        std::lock_guard<std::mutex> lock(mSpatialIndexMutex);
+        if (mpSpatialIndex != NULL)
+        {
+            mpSpatialIndex->Clear();
+        }
     }
 }
\ No newline at end of file
@@ -1,9 +1,13 @@
 #pragma once
 #include "Math/Vector3.h"
+#include "ObjectPool.h"
 #include <vector>
+#include <mutex>
 
 namespace MagicDGP
 {
+    class SpatialIndex;
+
     class Point3D
     {
     public:
@@ -45,6 +49,8 @@ namespace MagicDGP
         bool SetPoint(int index, Point3D* pPoint);
         void UnifyPosition(double size);
         void InsertPoint(Point3D* pPoint);
+        Point3D* InsertPoint(const MagicMath::Vector3& pos);
+        Point3D* InsertPoint(const MagicMath::Vector3& pos, const MagicMath::Vector3& nor);
         int  GetPointNumber() const;
         void SetColor(MagicMath::Vector3 color);
         void GetBBox(MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax) const;
@@ -53,12 +59,89 @@ namespace MagicDGP
         void CalculateDensity();
         bool HasNormal() const;
         void SetHasNormal(bool has);
+        void ClearData();
+        //Built on first use, several threads can get it and search with result vectors of their own.
+        //It is rebuilt when the positions differ from the indexed ones, however the points were moved.
+        const SpatialIndex* GetSpatialIndex() const;
+        void InvalidateSpatialIndex(); //Releases the index
 
     protected:
         std::vector<Point3D* > mPointSet;
+        ObjectPool<Point3D> mPointPool; //points created by InsertPoint(pos)
+        mutable SpatialIndex* mpSpatialIndex;
+        mutable std::mutex mSpatialIndexMutex;
+        MagicMath::Vector3 mBBoxMin, mBBoxMax;
+        double mDensity;
+        bool mHasNormal;
+    };
+
+    //Non-owning view of float triples, element i starts at mpData + i * mStride
+    struct FloatView3
+    {
+        const float* mpData;
+        int mStride;
+        int mCount;
+    };
+
+    //Point set stored in contiguous float arrays, normal and color are optional channels.
+    //Positions can be handed to kNN libraries without copy.
+    class LightPoint3DSet
+    {
+    public:
+        LightPoint3DSet();
+        ~LightPoint3DSet();
+
+        static LightPoint3DSet* CreateFromPoint3DSet(const Point3DSet* pPointSet);
+        Point3DSet* CreatePoint3DSet() const;
+
+        void Reserve(int pointNum);
+        int  InsertPoint(const MagicMath::Vector3& pos);
+        int  InsertPoint(const MagicMath::Vector3& pos, const MagicMath::Vector3& nor);
+        int  GetPointNumber() const;
+        Point3D GetPoint(int index) const; //Compatible with Point3DSet::GetPoint
+        MagicMath::Vector3 GetPosition(int index) const;
+        void SetPosition(int index, const MagicMath::Vector3& pos);
+        MagicMath::Vector3 GetNormal(int index) const;
+        void SetNormal(int index, const MagicMath::Vector3& nor);
+        MagicMath::Vector3 GetColor(int index) const;
+        void SetColor(int index, const MagicMath::Vector3& color);
+        void SetColor(MagicMath::Vector3 color);
+        bool HasNormal() const;
+        void SetHasNormal(bool has);
+        bool HasColor() const;
+        void SetHasColor(bool has);
+
+        FloatView3 GetPositionView() const;
+        FloatView3 GetNormalView() const;
+        FloatView3 GetColorView() const;
+        float* GetPositionData(); //Drops the spatial index, the caller may move points
+        float* GetNormalData();
+        float* GetColorData();
+
+        void UnifyPosition(double size);
+        void GetBBox(MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax) const;
+        void CalculateBBox();
+        double GetDensity() const;
+        void CalculateDensity();
+        void ClearData();
+        //Built on first use on the positions in place, the functions which move or insert points drop it
+        const SpatialIndex* GetSpatialIndex() const;
+
+    private:
+        LightPoint3DSet(const LightPoint3DSet&);
+        LightPoint3DSet& operator = (const LightPoint3DSet&);
+        void InvalidateSpatialIndex();
+
+    private:
+        std::vector<float> mPositionList;
+        std::vector<float> mNormalList;
+        std::vector<float> mColorList;
+        mutable SpatialIndex* mpSpatialIndex;
+        mutable std::mutex mSpatialIndexMutex;
         MagicMath::Vector3 mBBoxMin, mBBoxMax;
         double mDensity;
         bool mHasNormal;
+        bool mHasColor;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,960 @@
+#include "PointStream.h"
+#include "PlyFile.h"
+#include "SnapshotFile.h"
+#include "PointArchive.h"
+#include "NumberParser.h"
+#include "Tool/LogSystem.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    //Read buffer of the text and PLY sources, lines and records are consumed from its front
+    const size_t StreamBufferSize = 1 << 22;
+
+    bool SeekFile(FILE* pFile, unsigned long long offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(pFile, (__int64)offset, SEEK_SET) == 0;
+#else
+        return fseeko(pFile, (off_t)offset, SEEK_SET) == 0;
+#endif
+    }
+
+    std::string GetExtension(const std::string& fileName)
+    {
+        size_t dotPos = fileName.rfind('.');
+        return (dotPos == std::string::npos) ? std::string() : fileName.substr(dotPos + 1);
+    }
+
+    class StreamBuffer
+    {
+    public:
+        StreamBuffer() :
+            mpFile(NULL),
+            mBuffer(),
+            mStart(0),
+            mEnd(0),
+            mIsFileEnd(false)
+        {
+        }
+
+        ~StreamBuffer()
+        {
+            Close();
+        }
+
+        bool Open(const std::string& fileName)
+        {
+            Close();
+            mpFile = fopen(fileName.c_str(), "rb");
+            if (mpFile == NULL)
+            {
+                ErrorLog << "PointStreamReader: can not open " << fileName.c_str() << std::endl;
+                return false;
+            }
+            mBuffer.resize(StreamBufferSize);
+            mStart = 0;
+            mEnd = 0;
+            mIsFileEnd = false;
+            return true;
+        }
+
+        void Close()
+        {
+            if (mpFile != NULL)
+            {
+                fclose(mpFile);
+                mpFile = NULL;
+            }
+            std::vector<char>().swap(mBuffer);
+        }
+
+        const char* GetData() const
+        {
+            return &(mBuffer[0]) + mStart;
+        }
+
+        size_t GetSize() const
+        {
+            return mEnd - mStart;
+        }
+
+        void Consume(size_t size)
+        {
+            mStart += size;
+        }
+
+        //Moves the unconsumed data to the front and reads behind it, the buffer grows only for a line longer than it.
+        //A newline is appended at the file end so that the last line is complete. Returns false if nothing is added.
+        bool Fill()
+        {
+            if (mIsFileEnd)
+            {
+                return false;
+            }
+            if (mStart > 0)
+            {
+                memmove(&(mBuffer[0]), &(mBuffer[0]) + mStart, mEnd - mStart);
+                mEnd -= mStart;
+                mStart = 0;
+            }
+            if (mEnd == mBuffer.size())
+            {
+                mBuffer.resize(mBuffer.size() * 2);
+            }
+            size_t readSize = fread(&(mBuffer[0]) + mEnd, 1, mBuffer.size() - mEnd, mpFile);
+            mEnd += readSize;
+            if (readSize == 0)
+            {
+                mIsFileEnd = true;
+                if (mEnd == mBuffer.size())
+                {
+                    mBuffer.push_back('\n');
+                }
+                else
+                {
+                    mBuffer[mEnd] = '\n';
+                }
+                mEnd++;
+            }
+            return true;
+        }
+
+        //The line excludes '\n', false at the file end
+        bool NextLine(const char*& pLine, const char*& pLineEnd)
+        {
+            while (true)
+            {
+                const char* pData = GetData();
+                const char* pNewLine = static_cast<const char*>(memchr(pData, '\n', GetSize()));
+                if (pNewLine != NULL)
+                {
+                    pLine = pData;
+                    pLineEnd = pNewLine;
+                    Consume(pNewLine + 1 - pData);
+                    return true;
+                }
+                if (!Fill())
+                {
+                    return false;
+                }
+            }
+        }
+
+    private:
+        FILE* mpFile;
+        std::vector<char> mBuffer;
+        size_t mStart;
+        size_t mEnd;
+        bool mIsFileEnd;
+    };
+
+    int ParseNumbers(const char* pCur, const char* pEnd, double* pValue, int maxNum)
+    {
+        int valueNum = 0;
+        while (valueNum < maxNum)
+        {
+            pCur = MagicDGP::NumberParser::SkipSpace(pCur, pEnd);
+            const char* pNext = MagicDGP::NumberParser::ParseDouble(pCur, pEnd, pValue[valueNum]);
+            if (pNext == NULL)
+            {
+                break;
+            }
+            valueNum++;
+            pCur = pNext;
+        }
+        return valueNum;
+    }
+
+    template <class T>
+    void MoveFront(std::vector<T>& sourceList, int num, std::vector<T>& targetList)
+    {
+        targetList.insert(targetList.end(), sourceList.begin(), sourceList.begin() + num);
+        sourceList.erase(sourceList.begin(), sourceList.begin() + num);
+    }
+}
+
+namespace MagicDGP
+{
+    //Format specific part of PointStreamReader
+    class PointChunkSource
+    {
+    public:
+        PointChunkSource() :
+            mHasNormal(false),
+            mHasColor(false),
+            mPointNumber(-1)
+        {
+        }
+
+        virtual ~PointChunkSource()
+        {
+        }
+
+        virtual bool Open(const std::string& fileName) = 0;
+        //Appends at most maxNum points to the chunk lists, nothing is appended at the end. False on error.
+        virtual bool Read(int maxNum, PointChunk& chunk) = 0;
+
+        bool HasNormal() const
+        {
+            return mHasNormal;
+        }
+
+        bool HasColor() const
+        {
+            return mHasColor;
+        }
+
+        long long GetPointNumber() const
+        {
+            return mPointNumber;
+        }
+
+    protected:
+        bool mHasNormal;
+        bool mHasColor;
+        long long mPointNumber;
+    };
+
+    //"v x y z [r g b]" and "vn x y z" lines, normals are paired with positions in file order.
+    //If normals and positions drift more than a chunk apart, e.g. in separate blocks,
+    //normals are read by a second cursor over the same file.
+    class ObjChunkSource : public PointChunkSource
+    {
+    public:
+        ObjChunkSource() :
+            mIsNormalSeparate(false),
+            mNormalLineNumber(0)
+        {
+        }
+
+        virtual bool Open(const std::string& fileName)
+        {
+            if (!mBuffer.Open(fileName))
+            {
+                return false;
+            }
+            mFileName = fileName;
+            //channels are decided by the first lines
+            mBuffer.Fill();
+            const char* pCur = mBuffer.GetData();
+            const char* pEnd = pCur + mBuffer.GetSize();
+            bool isPositionFound = false;
+            while (pCur < pEnd)
+            {
+                const char* pLineEnd = static_cast<const char*>(memchr(pCur, '\n', pEnd - pCur));
+                if (pLineEnd == NULL)
+                {
+                    break;
+                }
+                pCur = NumberParser::SkipSpace(pCur, pLineEnd);
+                if (pLineEnd - pCur > 1 && pCur[0] == 'v')
+                {
+                    if (pCur[1] == 'n')
+                    {
+                        mHasNormal = true;
+                    }
+                    else if ((pCur[1] == ' ' || pCur[1] == '\t') && !isPositionFound)
+                    {
+                        double values[6];
+                        mHasColor = (ParseNumbers(pCur + 1, pLineEnd, values, 6) == 6);
+                        isPositionFound = true;
+                    }
+                }
+                pCur = pLineEnd + 1;
+            }
+            return true;
+        }
+
+        virtual bool Read(int maxNum, PointChunk& chunk)
+        {
+            const char* pLine = NULL;
+            const char* pLineEnd = NULL;
+            while (!IsChunkReady(maxNum) && mBuffer.NextLine(pLine, pLineEnd))
+            {
+                const char* pCur = NumberParser::SkipSpace(pLine, pLineEnd);
+                if (pLineEnd - pCur < 2 || pCur[0] != 'v')
+                {
+                    continue;
+                }
+                double values[6] = {0, 0, 0, 0.09, 0.48627, 0.69};
+                if (pCur[1] == ' ' || pCur[1] == '\t')
+                {
+                    ParseNumbers(pCur + 1, pLineEnd, values, mHasColor ? 6 : 3);
+                    mPositionList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+                    if (mHasColor)
+                    {
+                        mColorList.push_back(MagicMath::Vector3(values[3], values[4], values[5]));
+                    }
+                }
+                else if (pCur[1] == 'n' && mHasNormal && !mIsNormalSeparate)
+                {
+                    ParseNumbers(pCur + 2, pLineEnd, values, 3);
+                    mNormalList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+                    mNormalLineNumber++;
+                }
+                if (mHasNormal && !mIsNormalSeparate && (mPositionList.size() > mNormalList.size() + size_t(maxNum)
+                    || mNormalList.size() > mPositionList.size() + size_t(maxNum)))
+                {
+                    if (!OpenNormalCursor())
+                    {
+                        return false;
+                    }
+                }
+            }
+            if (mIsNormalSeparate)
+            {
+                ReadSeparateNormals();
+            }
+            int readNum = GetReadyNumber() < maxNum ? GetReadyNumber() : maxNum;
+            if (mHasNormal && readNum < maxNum && mNormalList.size() < mPositionList.size())
+            {
+                //file end with missing normals
+                WarnLog << "PointStreamReader: " << mPositionList.size() - mNormalList.size() << " points have no normal" << std::endl;
+                mNormalList.resize(mPositionList.size(), MagicMath::Vector3(0, 0, 0));
+                readNum = (mPositionList.size() < size_t(maxNum)) ? int(mPositionList.size()) : maxNum;
+            }
+            MoveFront(mPositionList, readNum, chunk.mPositionList);
+            if (mHasNormal)
+            {
+                MoveFront(mNormalList, readNum, chunk.mNormalList);
+            }
+            if (mHasColor)
+            {
+                MoveFront(mColorList, readNum, chunk.mColorList);
+            }
+            return true;
+        }
+
+    private:
+        int GetReadyNumber() const
+        {
+            size_t readyNum = mPositionList.size();
+            if (mHasNormal && mNormalList.size() < readyNum)
+            {
+                readyNum = mNormalList.size();
+            }
+            return int(readyNum);
+        }
+
+        //With a separate normal cursor the main cursor only has to provide the positions
+        bool IsChunkReady(int maxNum) const
+        {
+            return mIsNormalSeparate ? (mPositionList.size() >= size_t(maxNum)) : (GetReadyNumber() >= maxNum);
+        }
+
+        static bool IsNormalLine(const char* pLine, const char* pLineEnd)
+        {
+            const char* pCur = NumberParser::SkipSpace(pLine, pLineEnd);
+            return (pLineEnd - pCur > 1 && pCur[0] == 'v' && pCur[1] == 'n');
+        }
+
+        //The second cursor starts behind the normal lines which the main cursor has parsed
+        bool OpenNormalCursor()
+        {
+            DebugLog << "PointStreamReader: normals are not interleaved with positions, read them separately" << std::endl;
+            if (!mNormalBuffer.Open(mFileName))
+            {
+                return false;
+            }
+            const char* pLine = NULL;
+            const char* pLineEnd = NULL;
+            long long skipNum = 0;
+            while (skipNum < mNormalLineNumber && mNormalBuffer.NextLine(pLine, pLineEnd))
+            {
+                if (IsNormalLine(pLine, pLineEnd))
+                {
+                    skipNum++;
+                }
+            }
+            mIsNormalSeparate = true;
+            return true;
+        }
+
+        void ReadSeparateNormals()
+        {
+            const char* pLine = NULL;
+            const char* pLineEnd = NULL;
+            while (mNormalList.size() < mPositionList.size() && mNormalBuffer.NextLine(pLine, pLineEnd))
+            {
+                if (IsNormalLine(pLine, pLineEnd))
+                {
+                    double values[3] = {0, 0, 0};
+                    ParseNumbers(NumberParser::SkipSpace(pLine, pLineEnd) + 2, pLineEnd, values, 3);
+                    mNormalList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+                }
+            }
+        }
+
+    private:
+        StreamBuffer mBuffer;
+        StreamBuffer mNormalBuffer;
+        std::string mFileName;
+        bool mIsNormalSeparate;
+        long long mNormalLineNumber; //normal lines parsed by the main cursor
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mColorList;
+    };
+
+    //[C][N]OFF header, vertex lines are "x y z [nx ny nz] [r g b [a]]". Integer colors are scaled from [0, 255].
+    class OffChunkSource : public PointChunkSource
+    {
+    public:
+        OffChunkSource() :
+            mRemainNumber(0)
+        {
+        }
+
+        virtual bool Open(const std::string& fileName)
+        {
+            if (!mBuffer.Open(fileName))
+            {
+                return false;
+            }
+            const char* pLine = NULL;
+            const char* pLineEnd = NULL;
+            bool isKeywordFound = false;
+            while (mBuffer.NextLine(pLine, pLineEnd))
+            {
+                const char* pCur = NumberParser::SkipSpace(pLine, pLineEnd);
+                if (pCur == pLineEnd || *pCur == '#')
+                {
+                    continue;
+                }
+                if (!isKeywordFound)
+                {
+                    const char* pKeyEnd = NumberParser::SkipToken(pCur, pLineEnd);
+                    std::string keyword(pCur, pKeyEnd);
+                    if (keyword.size() < 3 || keyword.compare(keyword.size() - 3, 3, "OFF") != 0)
+                    {
+                        break;
+                    }
+                    mHasColor = (keyword.find('C') != std::string::npos);
+                    mHasNormal = (keyword.find('N') != std::string::npos);
+                    isKeywordFound = true;
+                    pCur = NumberParser::SkipSpace(pKeyEnd, pLineEnd);
+                    if (pCur == pLineEnd)
+                    {
+                        continue;
+                    }
+                }
+                int vertNum = 0;
+                if (NumberParser::ParseInt(pCur, pLineEnd, vertNum) == NULL || vertNum < 0)
+                {
+                    break;
+                }
+                mPointNumber = vertNum;
+                mRemainNumber = vertNum;
+                return true;
+            }
+            ErrorLog << "PointStreamReader: invalid OFF header " << fileName.c_str() << std::endl;
+            return false;
+        }
+
+        virtual bool Read(int maxNum, PointChunk& chunk)
+        {
+            const char* pLine = NULL;
+            const char* pLineEnd = NULL;
+            int valueNum = 3 + (mHasNormal ? 3 : 0) + (mHasColor ? 3 : 0);
+            int readNum = 0;
+            while (readNum < maxNum && mRemainNumber > 0)
+            {
+                if (!mBuffer.NextLine(pLine, pLineEnd))
+                {
+                    ErrorLog << "PointStreamReader: OFF file is truncated" << std::endl;
+                    return false;
+                }
+                const char* pCur = NumberParser::SkipSpace(pLine, pLineEnd);
+                if (pCur == pLineEnd || *pCur == '#')
+                {
+                    continue;
+                }
+                double values[9] = {0, 0, 0, 0, 0, 0, 0.09, 0.48627, 0.69};
+                double* pColor = mHasNormal ? values + 6 : values + 3;
+                if (!mHasNormal)
+                {
+                    values[3] = values[6];
+                    values[4] = values[7];
+                    values[5] = values[8];
+                }
+                ParseNumbers(pCur, pLineEnd, values, valueNum);
+                chunk.mPositionList.push_back(MagicMath::Vector3(values[0], values[1], values[2]));
+                if (mHasNormal)
+                {
+                    chunk.mNormalList.push_back(MagicMath::Vector3(values[3], values[4], values[5]));
+                }
+                if (mHasColor)
+                {
+                    double scale = (pColor[0] > 1 || pColor[1] > 1 || pColor[2] > 1) ? 1.0 / 255.0 : 1.0;
+                    chunk.mColorList.push_back(MagicMath::Vector3(pColor[0], pColor[1], pColor[2]) * scale);
+                }
+                readNum++;
+                mRemainNumber--;
+            }
+            return true;
+        }
+
+    private:
+        StreamBuffer mBuffer;
+        long long mRemainNumber;
+    };
+
+    class PlyChunkSource : public PointChunkSource
+    {
+    public:
+        PlyChunkSource() :
+            mRemainNumber(0)
+        {
+        }
+
+        virtual bool Open(const std::string& fileName)
+        {
+            if (!mBuffer.Open(fileName))
+            {
+                return false;
+            }
+            mBuffer.Fill();
+            size_t headerSize = mDecoder.ParseHeader(mBuffer.GetData(), mBuffer.GetSize());
+            if (headerSize == 0)
+            {
+                ErrorLog << "PointStreamReader: can not stream " << fileName.c_str() << std::endl;
+                return false;
+            }
+            mBuffer.Consume(headerSize);
+            mHasNormal = mDecoder.HasNormal();
+            mHasColor = mDecoder.HasColor();
+            mPointNumber = mDecoder.GetVertexNumber();
+            mRemainNumber = mDecoder.GetVertexNumber();
+            return true;
+        }
+
+        virtual bool Read(int maxNum, PointChunk& chunk)
+        {
+            int readNum = 0;
+            while (readNum < maxNum && mRemainNumber > 0)
+            {
+                int decodeNum = (maxNum - readNum < mRemainNumber) ? maxNum - readNum : int(mRemainNumber);
+                size_t pointNum = chunk.mPositionList.size();
+                size_t usedSize = mDecoder.Decode(mBuffer.GetData(), mBuffer.GetSize(), decodeNum,
+                    chunk.mPositionList, chunk.mNormalList, chunk.mColorList);
+                mBuffer.Consume(usedSize);
+                int newNum = int(chunk.mPositionList.size() - pointNum);
+                readNum += newNum;
+                mRemainNumber -= newNum;
+                if (newNum < decodeNum && !mBuffer.Fill())
+                {
+                    ErrorLog << "PointStreamReader: PLY file is truncated" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        StreamBuffer mBuffer;
+        PlyVertexDecoder mDecoder;
+        long long mRemainNumber;
+    };
+
+    //Vertex blocks are read at their offsets, the file is not mapped
+    class SnapshotChunkSource : public PointChunkSource
+    {
+    public:
+        SnapshotChunkSource() :
+            mpFile(NULL),
+            mReadNumber(0)
+        {
+        }
+
+        virtual ~SnapshotChunkSource()
+        {
+            if (mpFile != NULL)
+            {
+                fclose(mpFile);
+            }
+        }
+
+        virtual bool Open(const std::string& fileName)
+        {
+            if (!SnapshotFile::ReadPointLayout(fileName, mLayout))
+            {
+                return false;
+            }
+            mpFile = fopen(fileName.c_str(), "rb");
+            if (mpFile == NULL)
+            {
+                ErrorLog << "PointStreamReader: can not open " << fileName.c_str() << std::endl;
+                return false;
+            }
+            mHasNormal = (mLayout.mNormalOffset != 0);
+            mHasColor = (mLayout.mColorOffset != 0);
+            mPointNumber = mLayout.mPointNumber;
+            return true;
+        }
+
+        virtual bool Read(int maxNum, PointChunk& chunk)
+        {
+            long long remainNum = mPointNumber - mReadNumber;
+            int readNum = (remainNum < maxNum) ? int(remainNum) : maxNum;
+            if (readNum == 0)
+            {
+                return true;
+            }
+            if (!ReadBlock(mLayout.mPositionOffset, readNum, chunk.mPositionList) ||
+                (mHasNormal && !ReadBlock(mLayout.mNormalOffset, readNum, chunk.mNormalList)) ||
+                (mHasColor && !ReadBlock(mLayout.mColorOffset, readNum, chunk.mColorList)))
+            {
+                ErrorLog << "PointStreamReader: snapshot file is truncated" << std::endl;
+                return false;
+            }
+            mReadNumber += readNum;
+            return true;
+        }
+
+    private:
+        bool ReadBlock(unsigned long long blockOffset, int readNum, std::vector<MagicMath::Vector3>& vecList)
+        {
+            mReadBuffer.resize(readNum * 3);
+            if (!SeekFile(mpFile, blockOffset + mReadNumber * sizeof(double) * 3) ||
+                fread(&(mReadBuffer[0]), sizeof(double) * 3, readNum, mpFile) != size_t(readNum))
+            {
+                return false;
+            }
+            for (int pid = 0; pid < readNum; pid++)
+            {
+                vecList.push_back(MagicMath::Vector3(mReadBuffer[pid * 3], mReadBuffer[pid * 3 + 1], mReadBuffer[pid * 3 + 2]));
+            }
+            return true;
+        }
+
+    private:
+        FILE* mpFile;
+        SnapshotPointLayout mLayout;
+        long long mReadNumber;
+        std::vector<double> mReadBuffer;
+    };
+
+    //Archive blocks are decoded one by one, the rest of a block waits for the next chunk
+    class ArchiveChunkSource : public PointChunkSource
+    {
+    public:
+        ArchiveChunkSource() :
+            mBlockIndex(0)
+        {
+        }
+
+        virtual bool Open(const std::string& fileName)
+        {
+            if (!mReader.Open(fileName))
+            {
+                return false;
+            }
+            mHasNormal = mReader.HasNormal();
+            mHasColor = mReader.HasColor();
+            mPointNumber = mReader.GetPointNumber();
+            return true;
+        }
+
+        virtual bool Read(int maxNum, PointChunk& chunk)
+        {
+            while (int(mPositionList.size()) < maxNum && mBlockIndex < mReader.GetBlockNumber())
+            {
+                int pointNum = mReader.GetBlockPointNumber(mBlockIndex);
+                size_t start = mPositionList.size();
+                mPositionList.resize(start + pointNum);
+                mNormalList.resize(mHasNormal ? start + pointNum : 0);
+                mColorList.resize(mHasColor ? start + pointNum : 0);
+                if (pointNum > 0 && !mReader.DecodeBlock(mBlockIndex, &(mPositionList[start]),
+                    mHasNormal ? &(mNormalList[start]) : NULL, mHasColor ? &(mColorList[start]) : NULL))
+                {
+                    ErrorLog << "PointStreamReader: archive block " << mBlockIndex << " is corrupted" << std::endl;
+                    return false;
+                }
+                mBlockIndex++;
+            }
+            int readNum = (int(mPositionList.size()) < maxNum) ? int(mPositionList.size()) : maxNum;
+            MoveFront(mPositionList, readNum, chunk.mPositionList);
+            if (mHasNormal)
+            {
+                MoveFront(mNormalList, readNum, chunk.mNormalList);
+            }
+            if (mHasColor)
+            {
+                MoveFront(mColorList, readNum, chunk.mColorList);
+            }
+            return true;
+        }
+
+    private:
+        PointArchiveReader mReader;
+        int mBlockIndex;
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mColorList;
+    };
+
+    PointStreamReader::PointStreamReader() :
+        mpSource(NULL),
+        mChunkSize(0),
+        mReadNumber(0),
+        mIsFailed(false)
+    {
+    }
+
+    PointStreamReader::~PointStreamReader()
+    {
+        Close();
+    }
+
+    bool PointStreamReader::Open(const std::string& fileName, int chunkSize)
+    {
+        Close();
+        if (chunkSize <= 0)
+        {
+            ErrorLog << "PointStreamReader::Open: invalid chunk size " << chunkSize << std::endl;
+            return false;
+        }
+        std::string extName = GetExtension(fileName);
+        if (SnapshotFile::IsSnapshot(fileName))
+        {
+            mpSource = new SnapshotChunkSource;
+        }
+        else if (PointArchive::IsArchive(fileName))
+        {
+            mpSource = new ArchiveChunkSource;
+        }
+        else if (extName == "obj")
+        {
+            mpSource = new ObjChunkSource;
+        }
+        else if (extName == "off")
+        {
+            mpSource = new OffChunkSource;
+        }
+        else if (extName == "ply")
+        {
+            mpSource = new PlyChunkSource;
+        }
+        else
+        {
+            ErrorLog << "PointStreamReader::Open: unsupported file " << fileName.c_str() << std::endl;
+            return false;
+        }
+        if (!mpSource->Open(fileName))
+        {
+            Close();
+            return false;
+        }
+        mChunkSize = chunkSize;
+        DebugLog << "PointStreamReader::Open: " << fileName.c_str() << " point number: " << mpSource->GetPointNumber()
+            << " normal: " << mpSource->HasNormal() << " color: " << mpSource->HasColor() << std::endl;
+        return true;
+    }
+
+    void PointStreamReader::Close()
+    {
+        if (mpSource != NULL)
+        {
+            delete mpSource;
+            mpSource = NULL;
+        }
+        mReadNumber = 0;
+        mIsFailed = false;
+    }
+
+    bool PointStreamReader::ReadChunk(PointChunk& chunk)
+    {
+        chunk.mPositionList.clear();
+        chunk.mNormalList.clear();
+        chunk.mColorList.clear();
+        chunk.mStartIndex = mReadNumber;
+        if (mpSource == NULL || mIsFailed)
+        {
+            return false;
+        }
+        if (!mpSource->Read(mChunkSize, chunk))
+        {
+            mIsFailed = true;
+            return false;
+        }
+        mReadNumber += chunk.mPositionList.size();
+        return !chunk.mPositionList.empty();
+    }
+
+    bool PointStreamReader::IsFailed() const
+    {
+        return mIsFailed;
+    }
+
+    bool PointStreamReader::HasNormal() const
+    {
+        return mpSource != NULL && mpSource->HasNormal();
+    }
+
+    bool PointStreamReader::HasColor() const
+    {
+        return mpSource != NULL && mpSource->HasColor();
+    }
+
+    long long PointStreamReader::GetPointNumber() const
+    {
+        return (mpSource == NULL) ? 0 : mpSource->GetPointNumber();
+    }
+
+    long long PointStreamReader::GetReadNumber() const
+    {
+        return mReadNumber;
+    }
+
+    int PointStreamReader::GetChunkSize() const
+    {
+        return mChunkSize;
+    }
+
+    //Wide enough for any int vertex count
+    static const int PlyCountWidth = 12;
+
+    PointStreamWriter::PointStreamWriter() :
+        mWriter(),
+        mFileName(),
+        mIsPly(false),
+        mHasNormal(false),
+        mHasColor(false),
+        mPointNumber(0),
+        mCountOffset(0)
+    {
+    }
+
+    PointStreamWriter::~PointStreamWriter()
+    {
+        if (mWriter.IsOpen())
+        {
+            Close();
+        }
+    }
+
+    bool PointStreamWriter::Open(const std::string& fileName, bool hasNormal, bool hasColor)
+    {
+        std::string extName = GetExtension(fileName);
+        if (extName != "obj" && extName != "ply")
+        {
+            ErrorLog << "PointStreamWriter::Open: unsupported file " << fileName.c_str() << std::endl;
+            return false;
+        }
+        if (!mWriter.Open(fileName))
+        {
+            return false;
+        }
+        mFileName = fileName;
+        mIsPly = (extName == "ply");
+        mHasNormal = hasNormal;
+        mHasColor = hasColor;
+        mPointNumber = 0;
+        if (mIsPly)
+        {
+            const char* pHead = "ply\nformat binary_little_endian 1.0\ncomment magic3d\nelement vertex ";
+            mCountOffset = strlen(pHead);
+            mWriter.WriteString(pHead);
+            mWriter.WriteString(std::string(PlyCountWidth, ' ').c_str());
+            mWriter.WriteString("\nproperty float x\nproperty float y\nproperty float z\n");
+            if (mHasNormal)
+            {
+                mWriter.WriteString("property float nx\nproperty float ny\nproperty float nz\n");
+            }
+            if (mHasColor)
+            {
+                mWriter.WriteString("property uchar red\nproperty uchar green\nproperty uchar blue\n");
+            }
+            mWriter.WriteString("end_header\n");
+        }
+        return true;
+    }
+
+    void PointStreamWriter::WritePoint(const MagicMath::Vector3& pos, const MagicMath::Vector3& nor, const MagicMath::Vector3& color)
+    {
+        mPointNumber++;
+        if (mIsPly)
+        {
+            float record[6] = {float(pos[0]), float(pos[1]), float(pos[2]), float(nor[0]), float(nor[1]), float(nor[2])};
+            mWriter.WriteBytes(record, (mHasNormal ? 6 : 3) * sizeof(float));
+            if (mHasColor)
+            {
+                unsigned char colorRecord[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    double value = color[k] < 0 ? 0 : (color[k] > 1 ? 1 : color[k]);
+                    colorRecord[k] = (unsigned char)(value * 255.0 + 0.5);
+                }
+                mWriter.WriteBytes(colorRecord, 3);
+            }
+            return;
+        }
+        mWriter.WriteString("v ");
+        WriteVector3(pos);
+        if (mHasColor)
+        {
+            //colors follow the position on the same line
+            mWriter.WriteChar(' ');
+            WriteVector3(color);
+        }
+        if (mHasNormal)
+        {
+            mWriter.WriteString("\nvn ");
+            WriteVector3(nor);
+        }
+        mWriter.WriteChar('\n');
+    }
+
+    void PointStreamWriter::WriteVector3(const MagicMath::Vector3& vec)
+    {
+        mWriter.WriteReal(vec[0]);
+        mWriter.WriteChar(' ');
+        mWriter.WriteReal(vec[1]);
+        mWriter.WriteChar(' ');
+        mWriter.WriteReal(vec[2]);
+    }
+
+    void PointStreamWriter::WriteChunk(const PointChunk& chunk)
+    {
+        MagicMath::Vector3 zero(0, 0, 0);
+        int pointNum = chunk.mPositionList.size();
+        bool hasNormal = (chunk.mNormalList.size() == pointNum);
+        bool hasColor = (chunk.mColorList.size() == pointNum);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            WritePoint(chunk.mPositionList[pid], hasNormal ? chunk.mNormalList[pid] : zero, hasColor ? chunk.mColorList[pid] : zero);
+        }
+    }
+
+    bool PointStreamWriter::Close()
+    {
+        bool isWritten = mWriter.Close();
+        if (!isWritten || !mIsPly)
+        {
+            return isWritten;
+        }
+        if (mPointNumber > 2147483647LL)
+        {
+            ErrorLog << "PointStreamWriter::Close: too many points for PLY " << mPointNumber << std::endl;
+            return false;
+        }
+        char countString[32];
+        int countLength = BufferedWriter::FormatInt(int(mPointNumber), countString);
+        FILE* pFile = fopen(mFileName.c_str(), "r+b");
+        if (pFile == NULL)
+        {
+            ErrorLog << "PointStreamWriter::Close: can not patch " << mFileName.c_str() << std::endl;
+            return false;
+        }
+        isWritten = (fseek(pFile, long(mCountOffset), SEEK_SET) == 0 && fwrite(countString, 1, countLength, pFile) == size_t(countLength));
+        fclose(pFile);
+        return isWritten;
+    }
+
+    long long PointStreamWriter::GetPointNumber() const
+    {
+        return mPointNumber;
+    }
+}
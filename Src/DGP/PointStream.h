@@ -0,0 +1,78 @@
+#pragma once
+#include "Math/Vector3.h"
+#include "BufferedWriter.h"
+#include <vector>
+#include <string>
+
+namespace MagicDGP
+{
+    //Points of one chunk. Normal and color lists are empty if the stream has no normal or color.
+    struct PointChunk
+    {
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<MagicMath::Vector3> mNormalList;
+        std::vector<MagicMath::Vector3> mColorList;
+        long long mStartIndex; //file index of the first point
+    };
+
+    class PointChunkSource;
+
+    //Pull reader which yields a point file in chunks of a fixed point number, for files larger than memory.
+    //OBJ, OFF, PLY, snapshot (.m3d) and archive (.m3c) files are read through a fixed size buffer, faces are ignored.
+    //    PointChunk chunk;
+    //    while (reader.ReadChunk(chunk)) { ... }
+    class PointStreamReader
+    {
+    public:
+        PointStreamReader();
+        ~PointStreamReader();
+
+        bool Open(const std::string& fileName, int chunkSize = 1 << 20);
+        void Close();
+        //false at the end of the stream or on a read error, see IsFailed
+        bool ReadChunk(PointChunk& chunk);
+        bool IsFailed() const;
+        bool HasNormal() const;
+        bool HasColor() const;
+        long long GetPointNumber() const; //-1 if the file does not store it (OBJ)
+        long long GetReadNumber() const;
+        int GetChunkSize() const;
+
+    private:
+        PointStreamReader(const PointStreamReader&);
+        PointStreamReader& operator = (const PointStreamReader&);
+
+    private:
+        PointChunkSource* mpSource;
+        int mChunkSize;
+        long long mReadNumber;
+        bool mIsFailed;
+    };
+
+    //Streaming writer of points as OBJ or binary PLY, chosen by extension.
+    //The PLY vertex count is known at Close only, it is patched into a fixed width header field.
+    class PointStreamWriter
+    {
+    public:
+        PointStreamWriter();
+        ~PointStreamWriter();
+
+        bool Open(const std::string& fileName, bool hasNormal, bool hasColor);
+        void WritePoint(const MagicMath::Vector3& pos, const MagicMath::Vector3& nor, const MagicMath::Vector3& color);
+        void WriteChunk(const PointChunk& chunk);
+        bool Close(); //false if any write failed
+        long long GetPointNumber() const;
+
+    private:
+        void WriteVector3(const MagicMath::Vector3& vec);
+
+    private:
+        BufferedWriter mWriter;
+        std::string mFileName;
+        bool mIsPly;
+        bool mHasNormal;
+        bool mHasColor;
+        long long mPointNumber;
+        size_t mCountOffset; //position of the PLY vertex count
+    };
+}
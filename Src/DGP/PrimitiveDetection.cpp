@@ -2,32 +2,120 @@
 #include "Eigen/Dense"
 #include "../Common/ToolKit.h"
 #include "Tool/LogSystem.h"
+#include "../Common/Parallel.h"
+#include "../Common/Profiler.h"
+#include "../Common/TaskGraph.h"
+#include <limits.h>
+
+namespace
+{
+    //PrimitiveDetectionContext::mVertexSelectionMode, the selection function which filled the per mesh data
+    enum VertexSelectionMode
+    {
+        VSM_None = 0,
+        VSM_Vertex,
+        VSM_Sampling,
+        VSM_Patch
+    };
+}
 
 namespace MagicDGP
 {
-    static int minInitSupportNum = 10;
-    static int minSupportNum = 100;
-    static double minSupportArea = 1;
-    static double acceptableAreaScale = 0.17;
-    static double acceptableArea = 1;
-    static double acceptableAreaDelta = 1;
-    static double acceptableScore = 0;
-    static double maxAngleDeviation = 0.866;
-    static double maxDistDeviation = 0.01;
-    static double maxCylinderRadiusScale = 0.1;
-    static double maxSphereRadiusScale = 0.01;
-    static double maxSphereRadius = 1;
-    static double maxCylinderRadius = 1;
-    static double minConeAngle = 0.1745329251994329; //10 degree
-    static double maxConeAngle = 1.3962; //80 degree
-    static double maxConeAngleDeviation = 0.1745; //10 degree
-    //static double baseScore = 0.93969262;
-    static double baseScore = 0.2618;
-    static std::vector<int> gSampleIndex;
-    static double minScoreProportion = 10;
-    static double scoreDeviation = 1;
-
-    ShapeCandidate::ShapeCandidate() :
+    VertexVisitBuffer::VertexVisitBuffer() :
+        mVisitMark(),
+        mCurrentMark(0)
+    {
+    }
+
+    void VertexVisitBuffer::Reset(int vertNum)
+    {
+        if (int(mVisitMark.size()) != vertNum || mCurrentMark == INT_MAX)
+        {
+            mVisitMark.assign(vertNum, 0);
+            mCurrentMark = 0;
+        }
+        mCurrentMark++;
+    }
+
+    PrimitiveParameter::PrimitiveParameter() :
+        mMaxAngleDeviation(0.866),
+        mMaxDistDeviation(0.01),
+        mMaxCylinderRadiusScale(0.1),
+        mMaxSphereRadiusScale(0.01),
+        mMaxSphereRadius(1),
+        mMaxCylinderRadius(1),
+        mMinConeAngle(0.1745329251994329), //10 degree
+        mMaxConeAngle(1.3962), //80 degree
+        mMaxConeAngleDeviation(0.1745), //10 degree
+        //mBaseScore(0.93969262),
+        mBaseScore(0.2618),
+        mScoreDeviation(1)
+    {
+    }
+
+    PrimitiveDetectionContext::PrimitiveDetectionContext() :
+        mVisitBufferList(),
+        mVisitBufferMutex(),
+        mParameter(),
+        mMinInitSupportNum(10),
+        mMinSupportNum(100),
+        mMinSupportArea(1),
+        mAcceptableAreaScale(0.17),
+        mAcceptableArea(1),
+        mAcceptableAreaDelta(1),
+        mAcceptableScore(0),
+        mMinScoreProportion(10),
+        mSampleIndex(),
+        mpCancelToken(NULL),
+        mpSelectionMesh(NULL),
+        mSelectionRes(),
+        mCandidateMap(),
+        mCandidateList(),
+        mpVertexSelectionMesh(NULL),
+        mVertexSelectionMode(0),
+        mSampleFlag(),
+        mVertWeightList()
+    {
+    }
+
+    VertexVisitBuffer* PrimitiveDetectionContext::AcquireVisitBuffer()
+    {
+        std::lock_guard<std::mutex> lock(mVisitBufferMutex);
+        if (mVisitBufferList.empty())
+        {
+            return new VertexVisitBuffer;
+        }
+        VertexVisitBuffer* pVisitBuffer = mVisitBufferList.back();
+        mVisitBufferList.pop_back();
+        return pVisitBuffer;
+    }
+
+    void PrimitiveDetectionContext::ReleaseVisitBuffer(VertexVisitBuffer* pVisitBuffer)
+    {
+        std::lock_guard<std::mutex> lock(mVisitBufferMutex);
+        mVisitBufferList.push_back(pVisitBuffer);
+    }
+
+    PrimitiveDetectionContext::~PrimitiveDetectionContext()
+    {
+        for (std::vector<ShapeCandidate* >::iterator itr = mCandidateList.begin(); itr != mCandidateList.end(); ++itr)
+        {
+            if (*itr != NULL)
+            {
+                delete (*itr);
+            }
+        }
+        mCandidateList.clear();
+        mCandidateMap.clear();
+        for (std::vector<VertexVisitBuffer* >::iterator itr = mVisitBufferList.begin(); itr != mVisitBufferList.end(); ++itr)
+        {
+            delete (*itr);
+        }
+        mVisitBufferList.clear();
+    }
+
+    ShapeCandidate::ShapeCandidate(const PrimitiveParameter& para) :
+        mParameter(para),
         mScore(0),
         mRemoved(false),
         mSupportArea(0),
@@ -66,7 +154,7 @@ namespace MagicDGP
 
     void ShapeCandidate::UpdateSupportArea(const Mesh3D* pMesh, std::vector<double>& vertWeightList)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         mSupportArea = 0;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
@@ -91,7 +179,8 @@ namespace MagicDGP
         return mHasRefit;
     }
 
-    PlaneCandidate::PlaneCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2) :
+    PlaneCandidate::PlaneCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2, const PrimitiveParameter& para) :
+        ShapeCandidate(para),
         mpVert0(pVert0),
         mpVert1(pVert1),
         mpVert2(pVert2)
@@ -121,9 +210,9 @@ namespace MagicDGP
 
         //Judge whether valid
         //double MaxAngleDeviation = 0.9848;
-        if (fabs(mNormal * (mpVert0->GetNormal()) ) < maxAngleDeviation || 
-            fabs(mNormal * (mpVert1->GetNormal()) ) < maxAngleDeviation ||
-            fabs(mNormal * (mpVert2->GetNormal()) ) < maxAngleDeviation)
+        if (fabs(mNormal * (mpVert0->GetNormal()) ) < mParameter.mMaxAngleDeviation || 
+            fabs(mNormal * (mpVert1->GetNormal()) ) < mParameter.mMaxAngleDeviation ||
+            fabs(mNormal * (mpVert2->GetNormal()) ) < mParameter.mMaxAngleDeviation)
         {
             //DebugLog << "Angle Deviation: " << mNormal * (mpVert0->GetNormal()) << " " << mNormal * (mpVert1->GetNormal()) 
             //    << " " << mNormal * (mpVert2->GetNormal()) << std::endl;
@@ -146,9 +235,9 @@ namespace MagicDGP
         return true;
     }
 
-    int PlaneCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int PlaneCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         //double MaxAngleDeviation = 0.9848;
         //double MaxAngleDeviation = 0.94;
         //double MaxDistDeviation = 0.001;
@@ -160,10 +249,15 @@ namespace MagicDGP
         mSupportVertex.push_back(id1);
         mSupportVertex.push_back(id2);
         //std::map<int, int> visitFlag;
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
-        visitFlag[id0] = 1;
-        visitFlag[id1] = 1;
-        visitFlag[id2] = 1;
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
+        pVisitBuffer->Visit(id0);
+        pVisitBuffer->Visit(id1);
+        pVisitBuffer->Visit(id2);
         std::vector<int> searchStack[2];
         searchStack[0].push_back(id0);
         searchStack[0].push_back(id1);
@@ -188,18 +282,18 @@ namespace MagicDGP
                 {
                     const Vertex3D* pNewVert = pEdge->GetVertex();
                     int newId = pNewVert->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             MagicMath::Vector3 pos = pNewVert->GetPosition();
                             double distDev = fabs( (pos - mCenter) * mNormal );
-                            if (distDev < maxDistDeviation)
+                            if (distDev < mParameter.mMaxDistDeviation)
                             {
                                 MagicMath::Vector3 nor = pNewVert->GetNormal();
                                 double angleDev = fabs( nor * mNormal );
-                                if (angleDev > maxAngleDeviation)
+                                if (angleDev > mParameter.mMaxAngleDeviation)
                                 {
                                     //searchIndexNext.push_back(newId);
                                     searchStack[stackNext].push_back(newId);
@@ -227,14 +321,19 @@ namespace MagicDGP
         return mSupportVertex.size();
     }
 
-    int PlaneCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int PlaneCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
         mHasRefit = true;
         //refit supprot vertex
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
-            visitFlag[*itr] = 1;
+            pVisitBuffer->Visit(*itr);
         }
         std::vector<int> searchIndex;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
@@ -244,9 +343,9 @@ namespace MagicDGP
             do
             {
                 int newId = pEdge->GetVertex()->GetId();
-                if (visitFlag[newId] != 1)
+                if (!pVisitBuffer->IsVisited(newId))
                 {
-                    visitFlag[newId] = 1;
+                    pVisitBuffer->Visit(newId);
                     if (resFlag.at(newId) == PrimitiveType::None)
                     {
                         searchIndex.push_back(newId);
@@ -265,26 +364,26 @@ namespace MagicDGP
                 const Vertex3D* pVert = pMesh->GetVertex(*itr);
                 MagicMath::Vector3 pos = pVert->GetPosition();
                 double distDev = fabs( (pos - mCenter) * mNormal );
-                if (distDev > maxDistDeviation)
+                if (distDev > mParameter.mMaxDistDeviation)
                 {
                     continue;
                 }
                 MagicMath::Vector3 nor = pVert->GetNormal();
                 double angleDev = fabs( nor * mNormal );
-                if (angleDev < maxAngleDeviation)
+                if (angleDev < mParameter.mMaxAngleDeviation)
                 {
                     continue;
                 }
-                //mScore += angleDev - baseScore;
+                //mScore += angleDev - mParameter.mBaseScore;
                 mSupportVertex.push_back(*itr);
                 //if current vertex pass, push its neighbors into searchIndexNext
                 const Edge3D* pEdge = pVert->GetEdge();
                 do
                 {
                     int newId = pEdge->GetVertex()->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             searchIndexNext.push_back(newId);
@@ -327,17 +426,17 @@ namespace MagicDGP
     //            const Vertex3D* pVert = pMesh->GetVertex(*itr);
     //            MagicMath::Vector3 pos = pVert->GetPosition();
     //            double distDev = fabs( (pos - mCenter) * mNormal );
-    //            if (distDev > maxDistDeviation)
+    //            if (distDev > mParameter.mMaxDistDeviation)
     //            {
     //                continue;
     //            }
     //            MagicMath::Vector3 nor = pVert->GetNormal();
     //            double angleDev = fabs( nor * mNormal );
-    //            if (angleDev < maxAngleDeviation)
+    //            if (angleDev < mParameter.mMaxAngleDeviation)
     //            {
     //                continue;
     //            }
-    //            //mScore += angleDev - baseScore;
+    //            //mScore += angleDev - mParameter.mBaseScore;
     //            mSupportVertex.push_back(*itr);
     //            //if current vertex pass, push its neighbors into searchIndexNext
     //            const Edge3D* pEdge = pVert->GetEdge();
@@ -396,26 +495,27 @@ namespace MagicDGP
 
     void PlaneCandidate::UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         mScore = 0;
         int supportNum = mSupportVertex.size();
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
             /*MagicMath::Vector3 pos = pMesh->GetVertex(*itr)->GetPosition();
             double distDev = fabs( (pos - mCenter) * mNormal );
-            distDev = scoreDeviation - distDev;
+            distDev = mParameter.mScoreDeviation - distDev;
             distDev = distDev > 0 ? distDev : 0;
             mScore += distDev * vertWeightList.at(*itr);*/
-            //mScore += (scoreDeviation - distDev) * vertWeightList.at(*itr);
+            //mScore += (mParameter.mScoreDeviation - distDev) * vertWeightList.at(*itr);
             MagicMath::Vector3 nor = pMesh->GetVertex(*itr)->GetNormal();
             double cosA = fabs(nor * mNormal);
             cosA = cosA > 1 ? 1 : cosA;
-            mScore += (baseScore - acos(cosA)) * vertWeightList.at(*itr);
+            mScore += (mParameter.mBaseScore - acos(cosA)) * vertWeightList.at(*itr);
         }
         //DebugLog << "Plane Update Score: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
     }
 
-    SphereCandidate::SphereCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1) :
+    SphereCandidate::SphereCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const PrimitiveParameter& para) :
+        ShapeCandidate(para),
         mpVert0(pVert0),
         mpVert1(pVert1)
     {
@@ -447,24 +547,24 @@ namespace MagicDGP
         MagicMath::Vector3 interPos1 = pos1 + nor1 * t1;
         mCenter = (interPos0 + interPos1) / 2;
         mRadius = ( (pos0 - mCenter).Length() + (pos1 - mCenter).Length() ) / 2;
-        if (mRadius > maxSphereRadius)
+        if (mRadius > mParameter.mMaxSphereRadius)
         {
             //DebugLog << "Sphere radius is too large: " << mRadius << std::endl;
             return false;
         }
         //Judge
         //double MaxAngleDeviation = 0.94;
-        double MaxDistDeviation = mRadius * maxSphereRadiusScale;
+        double MaxDistDeviation = mRadius * mParameter.mMaxSphereRadiusScale;
         MagicMath::Vector3 dir0 = pos0 - mCenter;
         double dist0 = dir0.Normalise();
-        if (fabs(dist0 - mRadius) > MaxDistDeviation || fabs(dir0 * nor0) < maxAngleDeviation)
+        if (fabs(dist0 - mRadius) > MaxDistDeviation || fabs(dir0 * nor0) < mParameter.mMaxAngleDeviation)
         {
             //DebugLog << "Sphere is valid reject vertex0: " << fabs(dist0 - mRadius) << " " << fabs(dir0 * nor0) << std::endl;
             return false;
         }
         MagicMath::Vector3 dir1 = pos1 - mCenter;
         double dist1 = dir1.Normalise();
-        if (fabs(dist1 - mRadius) > MaxDistDeviation || fabs(dir1 * nor1) < maxAngleDeviation)
+        if (fabs(dist1 - mRadius) > MaxDistDeviation || fabs(dir1 * nor1) < mParameter.mMaxAngleDeviation)
         {
             //DebugLog << "Sphere is valid reject vertex1: " << fabs(dist1 - mRadius) << " " << fabs(dir1 * nor1) << std::endl;
             return false;
@@ -484,19 +584,24 @@ namespace MagicDGP
         return true;
     }
 
-    int SphereCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int SphereCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
-        double MaxDistDeviation = mRadius * maxSphereRadiusScale;
+        double timeStart = MagicCore::ToolKit::GetTime();
+        double MaxDistDeviation = mRadius * mParameter.mMaxSphereRadiusScale;
         int id0 = mpVert0->GetId();
         int id1 = mpVert1->GetId();
         mSupportVertex.clear();
         mSupportVertex.push_back(id0);
         mSupportVertex.push_back(id1);
         //std::map<int, int> visitFlag;
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
-        visitFlag[id0] = 1;
-        visitFlag[id1] = 1;
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
+        pVisitBuffer->Visit(id0);
+        pVisitBuffer->Visit(id1);
         std::vector<int> searchIndex;
         searchIndex.push_back(id0);
         searchIndex.push_back(id1);
@@ -512,16 +617,16 @@ namespace MagicDGP
                 {
                     const Vertex3D* pNewVert = pEdge->GetVertex();
                     int newId = pNewVert->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             MagicMath::Vector3 pos = pNewVert->GetPosition();
                             MagicMath::Vector3 nor = pNewVert->GetNormal();
                             MagicMath::Vector3 dir = pos - mCenter;
                             double length = dir.Normalise();
-                            if (fabs(length - mRadius) < MaxDistDeviation && fabs(dir * nor) > maxAngleDeviation)
+                            if (fabs(length - mRadius) < MaxDistDeviation && fabs(dir * nor) > mParameter.mMaxAngleDeviation)
                             {
                                 searchIndexNext.push_back(newId);
                                 mSupportVertex.push_back(newId);
@@ -544,16 +649,21 @@ namespace MagicDGP
         return mSupportVertex.size();
     }
 
-    int SphereCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int SphereCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
         mHasRefit = true;
         //Refit support vertex
-        double MaxDistDeviation = mRadius * maxSphereRadiusScale;
+        double MaxDistDeviation = mRadius * mParameter.mMaxSphereRadiusScale;
         //std::map<int, int> visitFlag;
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
-            visitFlag[*itr] = 1;
+            pVisitBuffer->Visit(*itr);
         }
         std::vector<int> searchIndex;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
@@ -563,9 +673,9 @@ namespace MagicDGP
             do
             {
                 int newId = pEdge->GetVertex()->GetId();
-                if (visitFlag[newId] != 1)
+                if (!pVisitBuffer->IsVisited(newId))
                 {
-                    visitFlag[newId] = 1;
+                    pVisitBuffer->Visit(newId);
                     if (resFlag.at(newId) == PrimitiveType::None)
                     {
                         searchIndex.push_back(newId);
@@ -587,20 +697,20 @@ namespace MagicDGP
                 MagicMath::Vector3 dir = pos - mCenter;
                 double length = dir.Normalise();
                 double angleDev = fabs(dir * nor);
-                if (fabs(length - mRadius) > MaxDistDeviation || angleDev < maxAngleDeviation)
+                if (fabs(length - mRadius) > MaxDistDeviation || angleDev < mParameter.mMaxAngleDeviation)
                 {
                     continue;
                 }
-               // mScore += (angleDev - baseScore);
+               // mScore += (angleDev - mParameter.mBaseScore);
                 mSupportVertex.push_back(*itr);
                 //if current vertex pass, push its neighbors into searchIndexNext
                 const Edge3D* pEdge = pVert->GetEdge();
                 do
                 {
                     int newId = pEdge->GetVertex()->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             searchIndexNext.push_back(newId);
@@ -627,7 +737,7 @@ namespace MagicDGP
     //    mHasRefit = true;
     //    //DebugLog << "Refit sphere: " << mCenter[0] << " " << mCenter[1] << " " << mCenter[2] << " " << mRadius << std::endl;
     //    //Refit support vertex
-    //    double MaxDistDeviation = mRadius * maxSphereRadiusScale;
+    //    double MaxDistDeviation = mRadius * mParameter.mMaxSphereRadiusScale;
     //    //std::map<int, int> visitFlag;
     //    std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
     //    std::vector<int> searchIndex = mSupportVertex;
@@ -649,11 +759,11 @@ namespace MagicDGP
     //            MagicMath::Vector3 dir = pos - mCenter;
     //            double length = dir.Normalise();
     //            double angleDev = fabs(dir * nor);
-    //            if (fabs(length - mRadius) > MaxDistDeviation || angleDev < maxAngleDeviation)
+    //            if (fabs(length - mRadius) > MaxDistDeviation || angleDev < mParameter.mMaxAngleDeviation)
     //            {
     //                continue;
     //            }
-    //           // mScore += (angleDev - baseScore);
+    //           // mScore += (angleDev - mParameter.mBaseScore);
     //            mSupportVertex.push_back(*itr);
     //            //if current vertex pass, push its neighbors into searchIndexNext
     //            const Edge3D* pEdge = pVert->GetEdge();
@@ -711,7 +821,7 @@ namespace MagicDGP
         Eigen::VectorXd res = matCoefA.ldlt().solve(vecCoefB);
         mCenter = MagicMath::Vector3(res(0), res(1), res(2));
         mRadius = fabs(res(3));
-        if (mRadius > maxSphereRadius)
+        if (mRadius > mParameter.mMaxSphereRadius)
         {
             return false;
         }
@@ -726,26 +836,27 @@ namespace MagicDGP
 
     void SphereCandidate::UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         mScore = 0;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
             /*double dev = fabs( (pMesh->GetVertex(*itr)->GetPosition() - mCenter).Length() - mRadius );
-            dev = scoreDeviation - dev;
+            dev = mParameter.mScoreDeviation - dev;
             dev = dev > 0 ? dev : 0;
             mScore += dev * vertWeightList.at(*itr);*/
-            //mScore += (scoreDeviation - dev) * vertWeightList.at(*itr);
+            //mScore += (mParameter.mScoreDeviation - dev) * vertWeightList.at(*itr);
             MagicMath::Vector3 nor = pMesh->GetVertex(*itr)->GetNormal();
             MagicMath::Vector3 dir = pMesh->GetVertex(*itr)->GetPosition() - mCenter;
             dir.Normalise();
             double cosA = fabs(nor * dir);
             cosA = cosA > 1 ? 1 : cosA;
-            mScore += (baseScore - acos(cosA)) * vertWeightList.at(*itr);
+            mScore += (mParameter.mBaseScore - acos(cosA)) * vertWeightList.at(*itr);
         }
         //DebugLog << "Sphere Update Score time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
     }
 
-    CylinderCandidate::CylinderCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1) :
+    CylinderCandidate::CylinderCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const PrimitiveParameter& para) :
+        ShapeCandidate(para),
         mpVert0(pVert0),
         mpVert1(pVert1)
     {
@@ -793,7 +904,7 @@ namespace MagicDGP
         //    return false;
         //}
         mRadius = (mRadius + radius2) / 2;
-        if (mRadius > maxCylinderRadius)
+        if (mRadius > mParameter.mMaxCylinderRadius)
         {
             //DebugLog << "Cylinder radius is too large: " << mRadius << std::endl;
             return false;
@@ -816,19 +927,24 @@ namespace MagicDGP
         return true;
     }
 
-    int CylinderCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int CylinderCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
-        double MaxDistDeviation = mRadius * maxCylinderRadiusScale;
+        double timeStart = MagicCore::ToolKit::GetTime();
+        double MaxDistDeviation = mRadius * mParameter.mMaxCylinderRadiusScale;
         int id0 = mpVert0->GetId();
         int id1 = mpVert1->GetId();
         mSupportVertex.clear();
         mSupportVertex.push_back(id0);
         mSupportVertex.push_back(id1);
         //std::map<int, int> visitFlag;
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
-        visitFlag[id0] = 1;
-        visitFlag[id1] = 1;
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
+        pVisitBuffer->Visit(id0);
+        pVisitBuffer->Visit(id1);
         std::vector<int> searchIndex;
         searchIndex.push_back(id0);
         searchIndex.push_back(id1);
@@ -844,9 +960,9 @@ namespace MagicDGP
                 {
                     const Vertex3D* pNewVert = pEdge->GetVertex();
                     int newId = pNewVert->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             MagicMath::Vector3 pos = pNewVert->GetPosition();
@@ -854,7 +970,7 @@ namespace MagicDGP
                             MagicMath::Vector3 nor = pNewVert->GetNormal();
                             MagicMath::Vector3 dir = projectPos - mCenter;
                             double length = dir.Normalise();
-                            if (fabs(length - mRadius) < MaxDistDeviation && fabs(dir * nor) > maxAngleDeviation)
+                            if (fabs(length - mRadius) < MaxDistDeviation && fabs(dir * nor) > mParameter.mMaxAngleDeviation)
                             {
                                 searchIndexNext.push_back(newId);
                                 mSupportVertex.push_back(newId);
@@ -879,19 +995,24 @@ namespace MagicDGP
         return mSupportVertex.size();
     }
 
-    int CylinderCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int CylinderCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
         mHasRefit = true;
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         //DebugLog << "Refit Cylinder: " << mDir[0] << " " << mDir[1] << " " << mDir[2] << " " << mRadius << " " 
         //    << mCenter[0] << " " << mCenter[1] << " " << mCenter[2] << std::endl;
         //Refit support vertex
-        double MaxDistDeviation = mRadius * maxCylinderRadiusScale;
+        double MaxDistDeviation = mRadius * mParameter.mMaxCylinderRadiusScale;
         //std::map<int, int> visitFlag;
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
-            visitFlag[*itr] = 1;
+            pVisitBuffer->Visit(*itr);
         }
         std::vector<int> searchIndex;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
@@ -901,9 +1022,9 @@ namespace MagicDGP
             do
             {
                 int newId = pEdge->GetVertex()->GetId();
-                if (visitFlag[newId] != 1)
+                if (!pVisitBuffer->IsVisited(newId))
                 {
-                    visitFlag[newId] = 1;
+                    pVisitBuffer->Visit(newId);
                     if (resFlag.at(newId) == PrimitiveType::None)
                     {
                         searchIndex.push_back(newId);
@@ -926,20 +1047,20 @@ namespace MagicDGP
                 MagicMath::Vector3 dir = projectPos - mCenter;
                 double length = dir.Normalise();
                 double angleDev = fabs(dir * nor);
-                if (fabs(length - mRadius) > MaxDistDeviation || angleDev < maxAngleDeviation)
+                if (fabs(length - mRadius) > MaxDistDeviation || angleDev < mParameter.mMaxAngleDeviation)
                 {
                     continue;
                 }
-                //mScore += (angleDev - baseScore);
+                //mScore += (angleDev - mParameter.mBaseScore);
                 mSupportVertex.push_back(*itr);
                 //if current vertex pass, push its neighbors into searchIndexNext
                 const Edge3D* pEdge = pVert->GetEdge();
                 do
                 {
                     int newId = pEdge->GetVertex()->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             searchIndexNext.push_back(newId);
@@ -969,7 +1090,7 @@ namespace MagicDGP
     //    //DebugLog << "Refit Cylinder: " << mDir[0] << " " << mDir[1] << " " << mDir[2] << " " << mRadius << " " 
     //    //    << mCenter[0] << " " << mCenter[1] << " " << mCenter[2] << std::endl;
     //    //Refit support vertex
-    //    double MaxDistDeviation = mRadius * maxCylinderRadiusScale;
+    //    double MaxDistDeviation = mRadius * mParameter.mMaxCylinderRadiusScale;
     //    //std::map<int, int> visitFlag;
     //    std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
     //    std::vector<int> searchIndex = mSupportVertex;
@@ -992,11 +1113,11 @@ namespace MagicDGP
     //            MagicMath::Vector3 dir = projectPos - mCenter;
     //            double length = dir.Normalise();
     //            double angleDev = fabs(dir * nor);
-    //            if (fabs(length - mRadius) > MaxDistDeviation || angleDev < maxAngleDeviation)
+    //            if (fabs(length - mRadius) > MaxDistDeviation || angleDev < mParameter.mMaxAngleDeviation)
     //            {
     //                continue;
     //            }
-    //            //mScore += (angleDev - baseScore);
+    //            //mScore += (angleDev - mParameter.mBaseScore);
     //            mSupportVertex.push_back(*itr);
     //            //if current vertex pass, push its neighbors into searchIndexNext
     //            const Edge3D* pEdge = pVert->GetEdge();
@@ -1029,7 +1150,7 @@ namespace MagicDGP
 
     bool CylinderCandidate::FitParameter(const Mesh3D* pMesh)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
 
         if (mSupportVertex.size() < 4)
         {
@@ -1133,7 +1254,7 @@ namespace MagicDGP
         double centerY = res(1) / -2;
         mRadius = sqrt( centerX * centerX + centerY * centerY - res(2) );
         mCenter = planePos + dirX * centerX + dirY * centerY;
-        if (mRadius > maxCylinderRadius)
+        if (mRadius > mParameter.mMaxCylinderRadius)
         {
             return false;
         }
@@ -1229,7 +1350,7 @@ namespace MagicDGP
 
     void CylinderCandidate::UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         mScore = 0;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
@@ -1237,10 +1358,10 @@ namespace MagicDGP
             MagicMath::Vector3 projectPos = pos + mDir * ((mCenter - pos) * mDir); 
             MagicMath::Vector3 dir = projectPos - mCenter;
             double dev = fabs( dir.Length() - mRadius );
-            dev = scoreDeviation - dev;
+            dev = mParameter.mScoreDeviation - dev;
             dev = dev > 0 ? dev : 0;
             mScore += dev * vertWeightList.at(*itr);*/
-            //mScore += (scoreDeviation - dev) * vertWeightList.at(*itr);
+            //mScore += (mParameter.mScoreDeviation - dev) * vertWeightList.at(*itr);
             MagicMath::Vector3 pos = pMesh->GetVertex(*itr)->GetPosition();
             MagicMath::Vector3 projectPos = pos + mDir * ((mCenter - pos) * mDir);
             MagicMath::Vector3 nor = pMesh->GetVertex(*itr)->GetNormal();
@@ -1248,12 +1369,13 @@ namespace MagicDGP
             dir.Normalise();
             double cosA = fabs(nor * dir);
             cosA = cosA > 1 ? 1 : cosA;
-            mScore += (baseScore - acos(cosA)) * vertWeightList.at(*itr);
+            mScore += (mParameter.mBaseScore - acos(cosA)) * vertWeightList.at(*itr);
         }
         //DebugLog << "Cylinder Update Score time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
     }
 
-    ConeCandidate::ConeCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2) :
+    ConeCandidate::ConeCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2, const PrimitiveParameter& para) :
+        ShapeCandidate(para),
         mpVert0(pVert0),
         mpVert1(pVert1),
         mpVert2(pVert2)
@@ -1329,7 +1451,7 @@ namespace MagicDGP
         double cos2 = mDir * dir2;
         cos2 = cos2 > 1 ? 1 : (cos2 < -1 ? -1 : cos2);
         mAngle = (acos(cos0) + acos(cos1) + acos(cos2)) / 3;
-        if (mAngle > maxConeAngle || mAngle < minConeAngle)
+        if (mAngle > mParameter.mMaxConeAngle || mAngle < mParameter.mMinConeAngle)
         {
             //DebugLog << "cone: Cone angle is too large: " << mAngle << std::endl;
             return false;
@@ -1350,9 +1472,9 @@ namespace MagicDGP
         return true;
     }
 
-    int ConeCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int ConeCandidate::CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         //double MaxAngleDeviation = 0.1745329251994329; //10 degree
         //double MaxCosAngleDeviation = 0.94;
         int id0 = mpVert0->GetId();
@@ -1363,10 +1485,15 @@ namespace MagicDGP
         mSupportVertex.push_back(id1);
         mSupportVertex.push_back(id2);
         //std::map<int, int> visitFlag;
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
-        visitFlag[id0] = 1;
-        visitFlag[id1] = 1;
-        visitFlag[id2] = 1;
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
+        pVisitBuffer->Visit(id0);
+        pVisitBuffer->Visit(id1);
+        pVisitBuffer->Visit(id2);
         std::vector<int> searchIndex;
         searchIndex.push_back(id0);
         searchIndex.push_back(id1);
@@ -1383,9 +1510,9 @@ namespace MagicDGP
                     const Vertex3D* pNewVert = pEdge->GetVertex();
                     pEdge = pEdge->GetPair()->GetNext();
                     int newId = pNewVert->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             MagicMath::Vector3 pos = pNewVert->GetPosition();
@@ -1397,7 +1524,7 @@ namespace MagicDGP
                             double cosAngle = posDir * mDir;
                             cosAngle = cosAngle > 1 ? 1 : (cosAngle < -1 ? -1 : cosAngle);
                             double angle = acos(cosAngle);
-                            if (fabs(angle - mAngle) > maxConeAngleDeviation)
+                            if (fabs(angle - mAngle) > mParameter.mMaxConeAngleDeviation)
                             {
                                 continue;
                             }
@@ -1409,7 +1536,7 @@ namespace MagicDGP
                             MagicMath::Vector3 ideaNor = dirTemp.CrossProduct(posDir);
                             ideaNor.Normalise();
                             MagicMath::Vector3 nor = pNewVert->GetNormal();
-                            if (fabs(nor * ideaNor) < maxAngleDeviation)
+                            if (fabs(nor * ideaNor) < mParameter.mMaxAngleDeviation)
                             {
                                 continue;
                             }
@@ -1433,14 +1560,19 @@ namespace MagicDGP
         return mSupportVertex.size();
     }
 
-    int ConeCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag)
+    int ConeCandidate::Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer)
     {
         mHasRefit = true;
         //Refit support vertex
-        std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
+        VertexVisitBuffer localVisitBuffer;
+        if (pVisitBuffer == NULL)
+        {
+            pVisitBuffer = &localVisitBuffer;
+        }
+        pVisitBuffer->Reset(pMesh->GetVertexNumber());
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
-            visitFlag[*itr] = 1;
+            pVisitBuffer->Visit(*itr);
         }
         std::vector<int> searchIndex;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
@@ -1450,9 +1582,9 @@ namespace MagicDGP
             do
             {
                 int newId = pEdge->GetVertex()->GetId();
-                if (visitFlag[newId] != 1)
+                if (!pVisitBuffer->IsVisited(newId))
                 {
-                    visitFlag[newId] = 1;
+                    pVisitBuffer->Visit(newId);
                     if (resFlag.at(newId) == PrimitiveType::None)
                     {
                         searchIndex.push_back(newId);
@@ -1478,7 +1610,7 @@ namespace MagicDGP
                 double cosAngle = posDir * mDir;
                 cosAngle = cosAngle > 1 ? 1 : (cosAngle < -1 ? -1 : cosAngle);
                 double angle = acos(cosAngle);
-                if (fabs(angle - mAngle) > maxConeAngleDeviation)
+                if (fabs(angle - mAngle) > mParameter.mMaxConeAngleDeviation)
                 {
                     continue;
                 }
@@ -1491,20 +1623,20 @@ namespace MagicDGP
                 ideaNor.Normalise();
                 MagicMath::Vector3 nor = pVert->GetNormal();
                 double angleDev = fabs(nor * ideaNor);
-                if (angleDev < maxAngleDeviation)
+                if (angleDev < mParameter.mMaxAngleDeviation)
                 {
                     continue;
                 }
-                //mScore += (angleDev - baseScore);
+                //mScore += (angleDev - mParameter.mBaseScore);
                 mSupportVertex.push_back(*itr);
                 //if current vertex pass, push its neighbors into searchIndexNext
                 const Edge3D* pEdge = pVert->GetEdge();
                 do
                 {
                     int newId = pEdge->GetVertex()->GetId();
-                    if (visitFlag[newId] != 1)
+                    if (!pVisitBuffer->IsVisited(newId))
                     {
-                        visitFlag[newId] = 1;
+                        pVisitBuffer->Visit(newId);
                         if (resFlag.at(newId) == PrimitiveType::None)
                         {
                             searchIndexNext.push_back(newId);
@@ -1553,7 +1685,7 @@ namespace MagicDGP
     //            double cosAngle = posDir * mDir;
     //            cosAngle = cosAngle > 1 ? 1 : (cosAngle < -1 ? -1 : cosAngle);
     //            double angle = acos(cosAngle);
-    //            if (fabs(angle - mAngle) > maxConeAngleDeviation)
+    //            if (fabs(angle - mAngle) > mParameter.mMaxConeAngleDeviation)
     //            {
     //                continue;
     //            }
@@ -1566,11 +1698,11 @@ namespace MagicDGP
     //            ideaNor.Normalise();
     //            MagicMath::Vector3 nor = pVert->GetNormal();
     //            double angleDev = fabs(nor * ideaNor);
-    //            if (angleDev < maxAngleDeviation)
+    //            if (angleDev < mParameter.mMaxAngleDeviation)
     //            {
     //                continue;
     //            }
-    //            //mScore += (angleDev - baseScore);
+    //            //mScore += (angleDev - mParameter.mBaseScore);
     //            mSupportVertex.push_back(*itr);
     //            //if current vertex pass, push its neighbors into searchIndexNext
     //            const Edge3D* pEdge = pVert->GetEdge();
@@ -1690,7 +1822,7 @@ namespace MagicDGP
             angle += acos(cos);
         }
         mAngle = angle / crossSize;
-        if (mAngle > maxConeAngle || mAngle < minConeAngle)
+        if (mAngle > mParameter.mMaxConeAngle || mAngle < mParameter.mMinConeAngle)
         {
             //mSupportVertex.clear();
             DebugLog << "Cone refit angle is too large: " << mAngle << std::endl;
@@ -1707,7 +1839,7 @@ namespace MagicDGP
 
     void ConeCandidate::UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        double timeStart = MagicCore::ToolKit::GetTime();
         mScore = 0;
         for (std::vector<int>::iterator itr = mSupportVertex.begin(); itr != mSupportVertex.end(); ++itr)
         {
@@ -1722,13 +1854,13 @@ namespace MagicDGP
             cosAngle = cosAngle > 1 ? 1 : (cosAngle < -1 ? -1 : cosAngle);
             double angle = acos(cosAngle);
             double dev = fabs( apexDist * (sin(mAngle) - sin(angle)) );
-            dev = scoreDeviation - dev;
+            dev = mParameter.mScoreDeviation - dev;
             dev = dev > 0 ? dev : 0;
             mScore += dev * vertWeightList.at(*itr);*/
-            //mScore += (scoreDeviation - dev) * vertWeightList.at(*itr);
+            //mScore += (mParameter.mScoreDeviation - dev) * vertWeightList.at(*itr);
            // double deltaAngle = fabs(angle - mAngle);
            // double dev = apexDist * sin(deltaAngle);
-           // mScore += (scoreDeviation - dev) * vertWeightList.at(*itr);
+           // mScore += (mParameter.mScoreDeviation - dev) * vertWeightList.at(*itr);
 
             MagicMath::Vector3 pos = pMesh->GetVertex(*itr)->GetPosition();
             MagicMath::Vector3 posDir = pos - mApex;
@@ -1749,11 +1881,154 @@ namespace MagicDGP
             MagicMath::Vector3 nor = pMesh->GetVertex(*itr)->GetNormal();
             double cosA = fabs(nor * ideaNor);
             cosA = cosA > 1 ? 1 : cosA;
-            mScore += (baseScore - acos(cosA)) * vertWeightList.at(*itr);
+            mScore += (mParameter.mBaseScore - acos(cosA)) * vertWeightList.at(*itr);
         }
         //DebugLog << "Cone Update Score time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl; 
     }
 
+    namespace
+    {
+        //Candidate types tried on every vertex triple of a seed, in this order
+        const int CandidateTypeNumber = 4;
+        //Hypotheses per thread in a wave, so that uneven support traversals even out between the barriers
+        const int WaveHypothesisPerThread = 8;
+
+        //What a candidate has to pass before it competes for the best candidate of its seed
+        enum CandidateCheck
+        {
+            CC_Support = 0,         //enough support vertices
+            CC_Refit,               //enough support vertices before and after Refitting
+            CC_RefitScoreProportion //and a support area below mMinScoreProportion times the score
+        };
+
+        //One RANSAC hypothesis, plane and cone use the three vertices, sphere and cylinder the first two
+        struct CandidateHypothesis
+        {
+            PrimitiveType mType;
+            const Vertex3D* mpVert0;
+            const Vertex3D* mpVert1;
+            const Vertex3D* mpVert2;
+        };
+
+        void AddTripleHypotheses(std::vector<CandidateHypothesis>& hypothesisList, 
+            const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2)
+        {
+            PrimitiveType typeList[CandidateTypeNumber] = {PrimitiveType::Plane, PrimitiveType::Sphere, PrimitiveType::Cylinder, PrimitiveType::Cone};
+            for (int tid = 0; tid < CandidateTypeNumber; tid++)
+            {
+                CandidateHypothesis hypothesis;
+                hypothesis.mType = typeList[tid];
+                hypothesis.mpVert0 = pVert0;
+                hypothesis.mpVert1 = pVert1;
+                hypothesis.mpVert2 = pVert2;
+                hypothesisList.push_back(hypothesis);
+            }
+        }
+
+        ShapeCandidate* CreateCandidate(const CandidateHypothesis& hypothesis, const PrimitiveParameter& para)
+        {
+            switch (hypothesis.mType)
+            {
+            case PrimitiveType::Plane:
+                return new PlaneCandidate(hypothesis.mpVert0, hypothesis.mpVert1, hypothesis.mpVert2, para);
+            case PrimitiveType::Sphere:
+                return new SphereCandidate(hypothesis.mpVert0, hypothesis.mpVert1, para);
+            case PrimitiveType::Cylinder:
+                return new CylinderCandidate(hypothesis.mpVert0, hypothesis.mpVert1, para);
+            case PrimitiveType::Cone:
+                return new ConeCandidate(hypothesis.mpVert0, hypothesis.mpVert1, hypothesis.mpVert2, para);
+            default:
+                return NULL;
+            }
+        }
+
+        //Vertex triples evaluated together between two lucky break checks, WaveHypothesisPerThread hypotheses per thread.
+        //A lucky break wastes the evaluated triples behind it in its wave, at most waveNum - 1 triples, which is
+        //WaveHypothesisPerThread - 1 hypotheses per thread at the worst. One thread gets one triple, as the serial code.
+        int GetTripleWaveNumber()
+        {
+            int threadNum = MagicCore::GetParallelThreadNumber();
+            if (threadNum < 2)
+            {
+                return 1;
+            }
+            return (threadNum * WaveHypothesisPerThread + CandidateTypeNumber - 1) / CandidateTypeNumber;
+        }
+
+        //candidateList.at(i) for i in [startIndex, endIndex) is the candidate of hypothesisList.at(i) if it passed the check,
+        //NULL otherwise. The hypotheses only read the mesh, so they are evaluated in parallel, each chunk with a visit
+        //buffer of the context.
+        void EvaluateHypotheses(const std::vector<CandidateHypothesis>& hypothesisList, int startIndex, int endIndex, 
+            const Mesh3D* pMesh, std::vector<int>& res, std::vector<double>& vertWeightList, CandidateCheck check, 
+            PrimitiveDetectionContext* pContext, std::vector<ShapeCandidate* >& candidateList)
+        {
+            candidateList.resize(hypothesisList.size(), NULL);
+            MagicCore::ParallelFor(startIndex, endIndex, [&](int rangeStart, int rangeEnd)
+            {
+                VertexVisitBuffer* pVisitBuffer = pContext->AcquireVisitBuffer();
+                for (int hid = rangeStart; hid < rangeEnd; hid++)
+                {
+                    ShapeCandidate* pCand = CreateCandidate(hypothesisList.at(hid), pContext->mParameter);
+                    bool isPassed = pCand->IsValid() && pCand->CalSupportVertex(pMesh, res, pVisitBuffer) > pContext->mMinInitSupportNum;
+                    if (isPassed && check != CC_Support)
+                    {
+                        isPassed = pCand->Refitting(pMesh, res, pVisitBuffer) > pContext->mMinInitSupportNum;
+                    }
+                    if (isPassed)
+                    {
+                        pCand->UpdateScore(pMesh, vertWeightList);
+                        pCand->UpdateSupportArea(pMesh, vertWeightList);
+                        if (check == CC_RefitScoreProportion)
+                        {
+                            isPassed = pCand->GetSupportArea() < (pCand->GetScore() * pContext->mMinScoreProportion);
+                        }
+                    }
+                    if (isPassed)
+                    {
+                        candidateList.at(hid) = pCand;
+                    }
+                    else
+                    {
+                        delete pCand;
+                    }
+                }
+                pContext->ReleaseVisitBuffer(pVisitBuffer);
+            }, 1);
+        }
+
+        //Merges in hypothesis order: a later candidate only replaces the best with a higher score, as in the serial loop
+        ShapeCandidate* KeepBetterCandidate(ShapeCandidate* pBestCand, ShapeCandidate* pCand)
+        {
+            if (pCand == NULL)
+            {
+                return pBestCand;
+            }
+            if (pBestCand == NULL)
+            {
+                return pCand;
+            }
+            if (pBestCand->GetScore() < pCand->GetScore())
+            {
+                delete pBestCand;
+                return pCand;
+            }
+            delete pCand;
+            return pBestCand;
+        }
+
+        void DeleteCandidates(std::vector<ShapeCandidate* >& candidateList, int startIndex)
+        {
+            for (int cid = startIndex; cid < int(candidateList.size()); cid++)
+            {
+                if (candidateList.at(cid) != NULL)
+                {
+                    delete candidateList.at(cid);
+                    candidateList.at(cid) = NULL;
+                }
+            }
+        }
+    }
+
     PrimitiveDetection::PrimitiveDetection()
     {
     }
@@ -1762,12 +2037,18 @@ namespace MagicDGP
     {
     }
 
-    void PrimitiveDetection::Primitive2DSelection(Mesh3D* pMesh, std::vector<int>& res)
+    void PrimitiveDetection::Primitive2DSelection(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
-        static std::vector<int> localRes;
-        static Mesh3D* localMesh = NULL;
-        static std::map<double, ShapeCandidate* > candidateMap; 
-        static std::vector<ShapeCandidate* > candidates;
+        PROFILE_ZONE("PrimitiveDetection::Selection");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
+        std::vector<int>& localRes = pContext->mSelectionRes;
+        Mesh3D*& localMesh = pContext->mpSelectionMesh;
+        std::map<double, ShapeCandidate* >& candidateMap = pContext->mCandidateMap; 
+        std::vector<ShapeCandidate* >& candidates = pContext->mCandidateList;
         //Intialize flags
         /*int vertNum = pMesh->GetVertexNumber();
         res = std::vector<int>(vertNum, PrimitiveType::None);
@@ -1794,9 +2075,9 @@ namespace MagicDGP
             MagicMath::Vector3 bboxMin, bboxMax;
             pMesh->GetBBox(bboxMin, bboxMax);
             double bboxSize = (bboxMax - bboxMin).Length();
-            maxDistDeviation = bboxSize * 0.004;
-            maxSphereRadius = bboxSize / 2;
-            maxCylinderRadius = bboxSize / 2;
+            pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+            pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+            pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
         }
         res = localRes;
         std::vector<int> featureMarks(vertNum, 0);
@@ -1925,12 +2206,12 @@ namespace MagicDGP
                 //res.at(neighborList.at(neighborSize - 1 - neighborSampleIndex)) = PrimitiveType::Blend;
                 //res.at(neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex)) = PrimitiveType::Blend;
                 //Add Plane Candidate
-                ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
+                ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
                 if (planeCand->IsValid())
                 {
-                    if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    if (planeCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                     {
-                        if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
+                        if (planeCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                         {
                             planeCand->UpdateScore(pMesh, vertWeightList);
                             planeCand->UpdateSupportArea(pMesh, vertWeightList);
@@ -1964,12 +2245,12 @@ namespace MagicDGP
                     delete planeCand;
                 }
                 //Add Sphere Candidate
-                ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
+                ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1, pContext->mParameter);
                 if (sphereCand->IsValid())
                 {
-                    if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    if (sphereCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                     {
-                        if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
+                        if (sphereCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                         {
                             sphereCand->UpdateScore(pMesh, vertWeightList);
                             sphereCand->UpdateSupportArea(pMesh, vertWeightList);
@@ -2003,12 +2284,12 @@ namespace MagicDGP
                     delete sphereCand;
                 }
                 //Add Cylinder Candidate
-                ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
+                ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1, pContext->mParameter);
                 if (cylinderCand->IsValid())
                 {
-                    if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    if (cylinderCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                     {
-                        if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
+                        if (cylinderCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                         {
                             cylinderCand->UpdateScore(pMesh, vertWeightList);
                             cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
@@ -2042,12 +2323,12 @@ namespace MagicDGP
                     delete cylinderCand;
                 }
                 //Add Cone Candidate
-                ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
+                ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
                 if (coneCand->IsValid())
                 {
-                    if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    if (coneCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                     {
-                        if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
+                        if (coneCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                         {
                             coneCand->UpdateScore(pMesh, vertWeightList);
                             coneCand->UpdateSupportArea(pMesh, vertWeightList);
@@ -2109,7 +2390,7 @@ namespace MagicDGP
                 res.at(*supportItr) = candType;
             }
             candItr->second->SetRemoved(true);
-            RemoveAcceptableCandidate(candidates, res);
+            RemoveAcceptableCandidate(candidates, res, pContext);
             for (int candId = 0; candId < candidates.size(); candId++)
             {
                 if (candidates.at(candId)->IsRemoved())
@@ -2129,9 +2410,15 @@ namespace MagicDGP
         localRes = res;
     }
 
-    void PrimitiveDetection::Primitive2DDetectionEnhance(Mesh3D* pMesh, std::vector<int>& res)
+    void PrimitiveDetection::Primitive2DDetectionEnhance(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("PrimitiveDetection::DetectionEnhance");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
+        double timeStart = MagicCore::ToolKit::GetTime();
 
         //Intialize flags
         int vertNum = pMesh->GetVertexNumber();
@@ -2149,13 +2436,13 @@ namespace MagicDGP
         MagicMath::Vector3 bboxMin, bboxMax;
         pMesh->GetBBox(bboxMin, bboxMax);
         double bboxSize = (bboxMax - bboxMin).Length();
-        scoreDeviation = bboxSize * 0.00001;
-        maxDistDeviation = bboxSize * 0.004;
-        maxSphereRadius = bboxSize / 2;
-        maxCylinderRadius = bboxSize / 2;
-        minSupportArea = 0;
-        UpdateAcceptableAreaEnhance(pMesh, res, 0.5); //need change to new
-        gSampleIndex.clear();
+        pContext->mParameter.mScoreDeviation = bboxSize * 0.00001;
+        pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+        pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+        pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
+        pContext->mMinSupportArea = 0;
+        UpdateAcceptableAreaEnhance(pMesh, res, 0.5, pContext); //need change to new
+        pContext->mSampleIndex.clear();
 
         //Initialize candidates   
         std::vector<ShapeCandidate* > candidates;
@@ -2165,7 +2452,8 @@ namespace MagicDGP
         DebugLog << "prepare time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
         //Find init best candidates
         int scanNum = 3;
-        for (int scanId = 0; scanId < scanNum; scanId++)
+        bool isCancelled = false;
+        for (int scanId = 0; scanId < scanNum && !isCancelled; scanId++)
         {
             int maxIterCount = 15;
             int lastBestIndex = -2;
@@ -2179,14 +2467,14 @@ namespace MagicDGP
             }
             else if (scanId == 1)
             {
-                UpdateAcceptableAreaEnhance(pMesh, res, 0.1);
+                UpdateAcceptableAreaEnhance(pMesh, res, 0.1, pContext);
                 //SampleVertex(pMesh, res, sampleFlag, featureScores, sampleIndex, 200, 0.5);
                 SampleVertex(pMesh, res, sampleFlag, featureScores, sampleIndex, 200, 1); //change
                 maxIterCount = 20;
             }
             else
             {
-                UpdateAcceptableAreaEnhance(pMesh, res, 0.05);
+                UpdateAcceptableAreaEnhance(pMesh, res, 0.05, pContext);
                 SampleVertex(pMesh, res, sampleFlag, featureScores, sampleIndex, 500, 0.7);
                 maxIterCount = 50;
                 accpetableTimes = 1;
@@ -2194,7 +2482,13 @@ namespace MagicDGP
 
             for (int iterIndex = 0; iterIndex < maxIterCount; ++iterIndex)
             {
-                if (AddNewCandidatesEnhance(candidates, pMesh, res, sampleFlag, vertWeightList, featureScores, sampleIndex) == false)
+                if (pContext->mpCancelToken != NULL && pContext->mpCancelToken->IsCancelled())
+                {
+                    DebugLog << "Break: detection cancelled" << std::endl;
+                    isCancelled = true;
+                    break;
+                }
+                if (AddNewCandidatesEnhance(candidates, pMesh, res, sampleFlag, vertWeightList, featureScores, sampleIndex, pContext) == false)
                 {
                     DebugLog << "Break: No New Candidates Found" << std::endl;
                     continue;
@@ -2209,13 +2503,13 @@ namespace MagicDGP
                     }
                     DebugLog << "scan" << scanId << " best index: " << bestIndex << " " << candidates.at(bestIndex)->GetScore() 
                         << " " << candidates.at(bestIndex)->GetSupportArea() << 
-                        " " << acceptableArea << "                                " << candidates.at(bestIndex)->GetSupportArea() / candidates.at(bestIndex)->GetScore() 
+                        " " << pContext->mAcceptableArea << "                                " << candidates.at(bestIndex)->GetSupportArea() / candidates.at(bestIndex)->GetScore() 
                         << " type: " << candidates.at(bestIndex)->GetType() << std::endl;
                     if (bestIndex == lastBestIndex)
                     {
                         lastBestTimes++;
                     }
-                    if (candidates.at(bestIndex)->GetSupportArea() > acceptableArea || lastBestTimes == accpetableTimes)
+                    if (candidates.at(bestIndex)->GetSupportArea() > pContext->mAcceptableArea || lastBestTimes == accpetableTimes)
                     {
                         int candType = candidates.at(bestIndex)->GetType();
                         std::vector<int> supportVert = candidates.at(bestIndex)->GetSupportVertex();
@@ -2224,7 +2518,7 @@ namespace MagicDGP
                             res.at(*supportItr) = candType;
                         }
                         candidates.at(bestIndex)->SetRemoved(true);
-                        RemoveAcceptableCandidate(candidates, res);
+                        RemoveAcceptableCandidate(candidates, res, pContext);
                         for (int candId = 0; candId < candidates.size(); candId++)
                         {
                             if (candidates.at(candId)->IsRemoved())
@@ -2236,15 +2530,15 @@ namespace MagicDGP
                         }
                         if (scanId == 0)
                         {
-                            UpdateAcceptableAreaEnhance(pMesh, res, 0.2);
+                            UpdateAcceptableAreaEnhance(pMesh, res, 0.2, pContext);
                         }
                         else if (scanId == 1)
                         {
-                            UpdateAcceptableAreaEnhance(pMesh, res, 0.1);
+                            UpdateAcceptableAreaEnhance(pMesh, res, 0.1, pContext);
                         }
                         else
                         {
-                            UpdateAcceptableAreaEnhance(pMesh, res, 0.05);
+                            UpdateAcceptableAreaEnhance(pMesh, res, 0.05, pContext);
                         }
                         
                         lastBestIndex = -2;
@@ -2263,7 +2557,7 @@ namespace MagicDGP
                 }
                 if (scanId == 0 && iterIndex == 0)
                 {
-                    UpdateAcceptableAreaEnhance(pMesh, res, 0.2);
+                    UpdateAcceptableAreaEnhance(pMesh, res, 0.2, pContext);
                 }
             }
             DebugLog << "large time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
@@ -2276,7 +2570,7 @@ namespace MagicDGP
         for (int smallIndex = 0; smallIndex < maxSmallCount; smallIndex++)
         {
             DebugLog << "small index: " << smallIndex << " -------------------" << std::endl; 
-            AddNewCandidatesEnhance(candidates, pMesh, res, sampleFlag, vertWeightList, featureScores, sampleIndex);
+            AddNewCandidatesEnhance(candidates, pMesh, res, sampleFlag, vertWeightList, featureScores, sampleIndex, pContext);
             for (int acceptIndex = 0; acceptIndex < acceptSize; acceptIndex++)
             {
                 int bestIndex = ChoseBestCandidate(candidates);
@@ -2286,17 +2580,17 @@ namespace MagicDGP
                     break;
                 }
                 if (candidates.at(bestIndex)->GetScore() < 0 || 
-                    candidates.at(bestIndex)->GetSupportArea() / candidates.at(bestIndex)->GetScore() > minScoreProportion)
+                    candidates.at(bestIndex)->GetSupportArea() / candidates.at(bestIndex)->GetScore() > pContext->mMinScoreProportion)
                 {
                     DebugLog << "low score: " << candidates.at(bestIndex)->GetSupportArea() / candidates.at(bestIndex)->GetScore() << std::endl;
                     candidates.at(bestIndex)->SetRemoved(true);
                     break;
                 }
                 DebugLog << "best index: " << bestIndex << " " << candidates.at(bestIndex)->GetSupportArea() << 
-                        " " << acceptableArea << "                                " 
+                        " " << pContext->mAcceptableArea << "                                " 
                         << candidates.at(bestIndex)->GetSupportArea() / candidates.at(bestIndex)->GetScore() 
                         << " type: " << candidates.at(bestIndex)->GetType() << std::endl;
-                if (candidates.at(bestIndex)->GetSupportArea() > minSupportArea)
+                if (candidates.at(bestIndex)->GetSupportArea() > pContext->mMinSupportArea)
                 {
                     int candType = candidates.at(bestIndex)->GetType();
                     std::vector<int> supportVert = candidates.at(bestIndex)->GetSupportVertex();
@@ -2305,7 +2599,7 @@ namespace MagicDGP
                         res.at(*supportItr) = candType;
                     }
                     candidates.at(bestIndex)->SetRemoved(true);
-                    RemoveAcceptableCandidate(candidates, res);
+                    RemoveAcceptableCandidate(candidates, res, pContext);
                     for (int candId = 0; candId < candidates.size(); candId++)
                     {
                         if (candidates.at(candId)->IsRemoved())
@@ -2315,7 +2609,7 @@ namespace MagicDGP
                         candidates.at(candId)->UpdateScore(pMesh, vertWeightList);
                         candidates.at(candId)->UpdateSupportArea(pMesh, vertWeightList);
                     }
-                    UpdateAcceptableAreaEnhance(pMesh, res, 0.01);
+                    UpdateAcceptableAreaEnhance(pMesh, res, 0.01, pContext);
                 }
                 else
                 {
@@ -2326,9 +2620,9 @@ namespace MagicDGP
             }
             
         }
-        for (int sid = 0; sid < gSampleIndex.size(); sid++)
+        for (int sid = 0; sid < pContext->mSampleIndex.size(); sid++)
         {
-            res.at(gSampleIndex.at(sid)) = PrimitiveType::Blend;
+            res.at(pContext->mSampleIndex.at(sid)) = PrimitiveType::Blend;
         }
         //Clear
         for (std::vector<ShapeCandidate* >::iterator itr = candidates.begin(); itr != candidates.end(); ++itr)
@@ -2343,9 +2637,15 @@ namespace MagicDGP
         DebugLog << "total time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
     }
 
-    void PrimitiveDetection::Primitive2DDetectionByScore(Mesh3D* pMesh, std::vector<int>& res)
+    void PrimitiveDetection::Primitive2DDetectionByScore(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("PrimitiveDetection::DetectionByScore");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
+        double timeStart = MagicCore::ToolKit::GetTime();
 
         //Intialize flags
         int vertNum = pMesh->GetVertexNumber();
@@ -2362,13 +2662,13 @@ namespace MagicDGP
         MagicMath::Vector3 bboxMin, bboxMax;
         pMesh->GetBBox(bboxMin, bboxMax);
         double bboxSize = (bboxMax - bboxMin).Length();
-        scoreDeviation = bboxSize * 0.00001;
-        maxDistDeviation = bboxSize * 0.004;
-        maxSphereRadius = bboxSize / 2;
-        maxCylinderRadius = bboxSize / 2;
-        minSupportArea = 0;
-        UpdateAcceptableAreaEnhance(pMesh, res, true); //need change to new
-        gSampleIndex.clear();
+        pContext->mParameter.mScoreDeviation = bboxSize * 0.00001;
+        pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+        pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+        pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
+        pContext->mMinSupportArea = 0;
+        UpdateAcceptableAreaEnhance(pMesh, res, true, pContext); //need change to new
+        pContext->mSampleIndex.clear();
 
         //Initialize candidates        
         DebugLog << "Mesh vertex number: " << pMesh->GetVertexNumber() << " face number: " << pMesh->GetFaceNumber() << std::endl;
@@ -2381,7 +2681,7 @@ namespace MagicDGP
         {
             if (iterId == 3)
             {
-                UpdateAcceptableScore(pMesh, res, 0.1);
+                UpdateAcceptableScore(pMesh, res, 0.1, pContext);
                 for (int vid = 0; vid < vertNum; vid++)
                 {
                     if (res.at(vid) == PrimitiveType::None)
@@ -2396,7 +2696,7 @@ namespace MagicDGP
                                 bestType = tid;
                             }
                         }
-                        if (bestScore > acceptableScore)
+                        if (bestScore > pContext->mAcceptableScore)
                         {
                             res.at(vid) = bestType + 1;
                         }
@@ -2423,7 +2723,7 @@ namespace MagicDGP
                     continue;
                 }
                 sampleFlag.at(validSampleId) = 1;
-                gSampleIndex.push_back(validSampleId);
+                pContext->mSampleIndex.push_back(validSampleId);
                 //Get vertex n neigbors
                 int neighborRadius = 10;
                 int minNeigborNum = 6;
@@ -2472,18 +2772,18 @@ namespace MagicDGP
                     const Vertex3D* pVertCand1 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleIndex) );
                     const Vertex3D* pVertCand2 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex) );
                     //Add Plane Candidate
-                    ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
+                    ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
                     if (planeCand->IsValid())
                     {
-                        if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                        if (planeCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                         {
-                            if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
+                            if (planeCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                             {
                                 planeCand->UpdateScore(pMesh, vertWeightList);
                                 planeCand->UpdateSupportArea(pMesh, vertWeightList);
                                 //DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
                                 //<< " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
-                                if (planeCand->GetSupportArea() < (planeCand->GetScore() * minScoreProportion))
+                                if (planeCand->GetSupportArea() < (planeCand->GetScore() * pContext->mMinScoreProportion))
                                 {
                                     if (bestCand == NULL)
                                     {
@@ -2519,18 +2819,18 @@ namespace MagicDGP
                         delete planeCand;
                     }
                     //Add Sphere Candidate
-                    ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
+                    ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1, pContext->mParameter);
                     if (sphereCand->IsValid())
                     {
-                        if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                        if (sphereCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                         {
-                            if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
+                            if (sphereCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                             {
                                 sphereCand->UpdateScore(pMesh, vertWeightList);
                                 sphereCand->UpdateSupportArea(pMesh, vertWeightList);
                                 //DebugLog << "sphere score: " << sphereCand->GetScore() << " area: " << sphereCand->GetSupportArea() 
                                 //<< " score proportion: " << sphereCand->GetSupportArea() / sphereCand->GetScore() << std::endl;
-                                if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * minScoreProportion))
+                                if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * pContext->mMinScoreProportion))
                                 {
                                     if (bestCand == NULL)
                                     {
@@ -2566,18 +2866,18 @@ namespace MagicDGP
                         delete sphereCand;
                     }
                     //Add Cylinder Candidate
-                    ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
+                    ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1, pContext->mParameter);
                     if (cylinderCand->IsValid())
                     {
-                        if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                        if (cylinderCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                         {
-                            if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
+                            if (cylinderCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                             {
                                 cylinderCand->UpdateScore(pMesh, vertWeightList);
                                 cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
                                 //DebugLog << "cylinder score: " << cylinderCand->GetScore() << " area: " << cylinderCand->GetSupportArea() 
                                 //<< " score proportion: " << cylinderCand->GetSupportArea() / cylinderCand->GetScore() << std::endl;
-                                if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * minScoreProportion))
+                                if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * pContext->mMinScoreProportion))
                                 {
                                     if (bestCand == NULL)
                                     {
@@ -2613,18 +2913,18 @@ namespace MagicDGP
                         delete cylinderCand;
                     }
                     //Add Cone Candidate
-                    ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
+                    ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
                     if (coneCand->IsValid())
                     {
-                        if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                        if (coneCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                         {
-                            if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
+                            if (coneCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                             {
                                 coneCand->UpdateScore(pMesh, vertWeightList);
                                 coneCand->UpdateSupportArea(pMesh, vertWeightList);
                                 //DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
                                 //<< " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
-                                if (coneCand->GetSupportArea() < (coneCand->GetScore() * minScoreProportion))
+                                if (coneCand->GetSupportArea() < (coneCand->GetScore() * pContext->mMinScoreProportion))
                                 {
                                     if (bestCand == NULL)
                                     {
@@ -2671,7 +2971,7 @@ namespace MagicDGP
                     for (std::vector<int>::iterator supItr = supportVert.begin(); supItr != supportVert.end(); supItr++)
                     {
                         primScore.at(*supItr).mScore[candType] += score;
-                        if (primScore.at(*supItr).mScore[candType] > acceptableScore)
+                        if (primScore.at(*supItr).mScore[candType] > pContext->mAcceptableScore)
                         {
                             res.at(*supItr) = candType + 1;
                             needUpdateScore = true;
@@ -2679,15 +2979,15 @@ namespace MagicDGP
                     }
                     if (iterId == 0)
                     {
-                        UpdateAcceptableScore(pMesh, res, 1);
+                        UpdateAcceptableScore(pMesh, res, 1, pContext);
                     }
                     else if (iterId == 1)
                     {
-                        UpdateAcceptableScore(pMesh, res, 0.5);
+                        UpdateAcceptableScore(pMesh, res, 0.5, pContext);
                     }
                     else if (iterId == 4)
                     {
-                        UpdateAcceptableScore(pMesh, res, 0.1);
+                        UpdateAcceptableScore(pMesh, res, 0.1, pContext);
                     }
 
                     delete bestCand;
@@ -2698,7 +2998,7 @@ namespace MagicDGP
         }
 
         //Update res
-        UpdateAcceptableScore(pMesh, res, 0.05);
+        UpdateAcceptableScore(pMesh, res, 0.05, pContext);
         for (int vid = 0; vid < vertNum; vid++)
         {
             //if (res.at(vid) == PrimitiveType::None)
@@ -2713,42 +3013,47 @@ namespace MagicDGP
                         bestType = tid;
                     }
                 }
-                if (bestScore > acceptableScore)
+                if (bestScore > pContext->mAcceptableScore)
                 {
                     res.at(vid) = bestType + 1;
                 }
             }
         }
 
-        for (int sid = 0; sid < gSampleIndex.size(); sid++)
+        for (int sid = 0; sid < pContext->mSampleIndex.size(); sid++)
         {
-            res.at(gSampleIndex.at(sid)) = PrimitiveType::Other;
+            res.at(pContext->mSampleIndex.at(sid)) = PrimitiveType::Other;
         }
         DebugLog << "Primitive2DDetectionByScore total time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
     }
 
     bool PrimitiveDetection::AddNewCandidatesByScore(std::vector<ShapeCandidate* >& candidates, const Mesh3D* pMesh, 
             std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList, 
-            std::vector<double>& featureScores, std::vector<int>& sampleIndex)
+            std::vector<double>& featureScores, std::vector<int>& sampleIndex, PrimitiveDetectionContext* pContext)
     {
+        PROFILE_ZONE("PrimitiveDetection::AddNewCandidatesByScore");
         int vertNum = pMesh->GetVertexNumber();
         int sampleNum = sampleIndex.size();
-        //
-        bool isNewAdded = false;
+        //Neighbors exclude the earlier samples, so they are collected in sample order. The hypotheses of all
+        //samples are evaluated together then.
+        std::vector<CandidateHypothesis> hypothesisList;
+        std::vector<int> hypothesisStart(sampleNum + 1, 0);
+        VertexVisitBuffer visitBuffer;
         for (int sid = 0; sid < sampleNum; sid++)
         {
+            hypothesisStart.at(sid) = hypothesisList.size();
             int validSampleId = sampleIndex.at(sid);
             sampleFlag.at(validSampleId) = 1;
-            gSampleIndex.push_back(validSampleId);
+            pContext->mSampleIndex.push_back(validSampleId);
             //Get vertex n neigbors
             int neighborRadius = 10;
             int minNeigborNum = 6;
             int neigborSampleNum = 5;
             std::vector<int> neighborList;
-            std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
+            visitBuffer.Reset(vertNum);
             std::vector<int> tranStack;
             tranStack.push_back(validSampleId);
-            visitFlag[validSampleId] = 1;
+            visitBuffer.Visit(validSampleId);
             for (int k = 0; k < neighborRadius; k++)
             {
                 std::vector<int> tranStackNext;
@@ -2763,9 +3068,9 @@ namespace MagicDGP
                             break;
                         }
                         int newId = pEdgeNeig->GetVertex()->GetId();
-                        if (visitFlag[newId] != 1)
+                        if (!visitBuffer.IsVisited(newId))
                         {
-                            visitFlag[newId] = 1;
+                            visitBuffer.Visit(newId);
                             if (sampleFlag.at(newId) == 0 && res.at(newId) == PrimitiveType::None)
                             {
                                 tranStackNext.push_back(newId);
@@ -2783,325 +3088,144 @@ namespace MagicDGP
             const Vertex3D* pVertCand0 = pMesh->GetVertex(validSampleId);
             int neighborSampleSize = neighborSize / 3;
             int neighborSampleIterSize = (neighborSampleSize > neigborSampleNum ? neigborSampleNum : neighborSampleSize);
-            ShapeCandidate* bestCand = NULL;
             for (int neighborSampleIndex = 0; neighborSampleIndex < neighborSampleIterSize; neighborSampleIndex++)
             {
                 const Vertex3D* pVertCand1 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleIndex) );
                 const Vertex3D* pVertCand2 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex) );
-                //res.at(neighborList.at(neighborSize - 1 - neighborSampleIndex)) = PrimitiveType::Blend;
-                //res.at(neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex)) = PrimitiveType::Blend;
-                //Add Plane Candidate
-                ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
-                if (planeCand->IsValid())
+                AddTripleHypotheses(hypothesisList, pVertCand0, pVertCand1, pVertCand2);
+            }
+        }
+        hypothesisStart.at(sampleNum) = hypothesisList.size();
+        std::vector<ShapeCandidate* > candidateList;
+        EvaluateHypotheses(hypothesisList, 0, hypothesisList.size(), pMesh, res, vertWeightList, CC_RefitScoreProportion, pContext, candidateList);
+        bool isNewAdded = false;
+        for (int sid = 0; sid < sampleNum; sid++)
+        {
+            ShapeCandidate* bestCand = NULL;
+            for (int hid = hypothesisStart.at(sid); hid < hypothesisStart.at(sid + 1); hid++)
+            {
+                bestCand = KeepBetterCandidate(bestCand, candidateList.at(hid));
+            }
+            if (bestCand != NULL)
+            {
+                //DebugLog << "best score: " << bestCand->GetScore() << " area: " << bestCand->GetSupportArea() << std::endl;
+                candidates.push_back(bestCand);
+                isNewAdded = true;
+            }
+        }
+        return isNewAdded;
+    }
+
+    ShapeCandidate* PrimitiveDetection::Primitive2DSelectionByVertex(Mesh3D* pMesh, int selectIndex, std::vector<int>& res, PrimitiveDetectionContext* pContext)
+    {
+        PROFILE_ZONE("PrimitiveDetection::SelectionByVertex");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
+        int vertNum = pMesh->GetVertexNumber();
+        res = std::vector<int>(vertNum, PrimitiveType::None);
+        std::vector<double> featureScores;
+        CalFeatureScoreByGradient(pMesh, res, featureScores);
+        Mesh3D*& pLastMesh = pContext->mpVertexSelectionMesh;
+        std::vector<int>& sampleFlag = pContext->mSampleFlag;
+        std::vector<double>& vertWeightList = pContext->mVertWeightList;
+        if (pMesh != pLastMesh || pContext->mVertexSelectionMode != VSM_Vertex)
+        {
+            pLastMesh = pMesh;
+            pContext->mVertexSelectionMode = VSM_Vertex;
+            sampleFlag = std::vector<int>(vertNum, 0);
+            //std::vector<double> featureScores;
+            //CalFeatureScore(pMesh, sampleFlag, featureScores);
+            pMesh->CalculateFaceArea();
+            CalVertexWeight(pMesh, vertWeightList);
+            pMesh->CalculateBBox();
+            MagicMath::Vector3 bboxMin, bboxMax;
+            pMesh->GetBBox(bboxMin, bboxMax);
+            double bboxSize = (bboxMax - bboxMin).Length();
+            pContext->mParameter.mScoreDeviation = bboxSize * 0.0001;
+            pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+            pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+            pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
+            pContext->mMinSupportArea = 0;
+            UpdateAcceptableAreaEnhance(pMesh, res, true, pContext); //need change to new
+        }
+        //Find the best candidate
+        //selectIndex = 4738;
+        DebugLog << "select index: " << selectIndex << std::endl;
+        int neighborRadius = 15;
+        int minNeigborNum = 6;
+        int neigborSampleNum = 1;
+        std::vector<int> neighborList;
+        std::vector<bool> visitFlag(vertNum, 0);
+        std::vector<int> tranStack;
+        tranStack.push_back(selectIndex);
+        visitFlag[selectIndex] = 1;
+        for (int k = 0; k < neighborRadius; k++)
+        {
+            std::vector<int> tranStackNext;
+            for (std::vector<int>::iterator itr = tranStack.begin(); itr != tranStack.end(); ++itr)
+            {
+                const Vertex3D* pVertNeig = pMesh->GetVertex(*itr);
+                const Edge3D* pEdgeNeig = pVertNeig->GetEdge();
+                do
+                {
+                    if (pEdgeNeig == NULL)
+                    {
+                        break;
+                    }
+                    int newId = pEdgeNeig->GetVertex()->GetId();
+                    if (visitFlag[newId] != 1)
+                    {
+                        visitFlag[newId] = 1;
+                        if (sampleFlag.at(newId) == 0 && res.at(newId) == PrimitiveType::None)
+                        {
+                            tranStackNext.push_back(newId);
+                            neighborList.push_back(newId);
+                        }
+                    }
+                    pEdgeNeig = pEdgeNeig->GetPair()->GetNext();
+                } while (pEdgeNeig != pVertNeig->GetEdge());
+            }
+            tranStack = tranStackNext;
+        }
+        int neighborSize = neighborList.size();
+        if (neighborSize < 10)
+        {
+            DebugLog << "neighbor size small: " << neighborSize << std::endl;
+            return NULL;
+        }
+        const Vertex3D* pVertCand0 = pMesh->GetVertex(selectIndex);
+        int neighborSampleSize = neighborSize / 3;
+        int neighborSampleIterSize = (neighborSampleSize > neigborSampleNum ? neigborSampleNum : neighborSampleSize);
+        ShapeCandidate* bestCand = NULL;
+        for (int neighborSampleIndex = 0; neighborSampleIndex < neighborSampleIterSize; neighborSampleIndex++)
+        {
+            const Vertex3D* pVertCand1 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleIndex) );
+            const Vertex3D* pVertCand2 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex) );
+            //Add Plane Candidate
+            ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
+            if (planeCand->IsValid())
+            {
+                if (planeCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
-                    if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    if (planeCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
-                        if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
+                        planeCand->UpdateScore(pMesh, vertWeightList);
+                        planeCand->UpdateSupportArea(pMesh, vertWeightList);
+                        DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
+                            << " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
+                        if (planeCand->GetSupportArea() < (planeCand->GetScore() * pContext->mMinScoreProportion))
                         {
-                            planeCand->UpdateScore(pMesh, vertWeightList);
-                            planeCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
-                            //<< " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
-                            if (planeCand->GetSupportArea() < (planeCand->GetScore() * minScoreProportion))
+                            if (bestCand == NULL)
                             {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = planeCand;
-                                }
-                                else if (bestCand->GetScore() < planeCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = planeCand;
-                                }
-                                else
-                                {
-                                    delete planeCand;
-                                }
-                            }
-                            else
-                            {
-                                delete planeCand;
-                            }
-                        }
-                        else
-                        {
-                            delete planeCand;
-                        }
-                    }
-                    else
-                    {
-                        delete planeCand;
-                    }
-                }
-                else
-                {
-                    delete planeCand;
-                }
-                //Add Sphere Candidate
-                ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
-                if (sphereCand->IsValid())
-                {
-                    if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
-                        {
-                            sphereCand->UpdateScore(pMesh, vertWeightList);
-                            sphereCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "sphere score: " << sphereCand->GetScore() << " area: " << sphereCand->GetSupportArea() 
-                            //<< " score proportion: " << sphereCand->GetSupportArea() / sphereCand->GetScore() << std::endl;
-                            if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * minScoreProportion))
-                            {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = sphereCand;
-                                }
-                                else if (bestCand->GetScore() < sphereCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = sphereCand;
-                                }
-                                else
-                                {
-                                    delete sphereCand;
-                                }
-                            }
-                            else
-                            {
-                                delete sphereCand;
-                            }
-                        }
-                        else
-                        {
-                            delete sphereCand;
-                        }
-                    }
-                    else
-                    {
-                        delete sphereCand;
-                    }
-                }
-                else
-                {
-                    delete sphereCand;
-                }
-                //Add Cylinder Candidate
-                ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
-                if (cylinderCand->IsValid())
-                {
-                    if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
-                        {
-                            cylinderCand->UpdateScore(pMesh, vertWeightList);
-                            cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "cylinder score: " << cylinderCand->GetScore() << " area: " << cylinderCand->GetSupportArea() 
-                            //<< " score proportion: " << cylinderCand->GetSupportArea() / cylinderCand->GetScore() << std::endl;
-                            if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * minScoreProportion))
-                            {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = cylinderCand;
-                                }
-                                else if (bestCand->GetScore() < cylinderCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = cylinderCand;
-                                }
-                                else
-                                {
-                                    delete cylinderCand;
-                                }
-                            }
-                            else
-                            {
-                                delete cylinderCand;
-                            }
-                        }
-                        else
-                        {
-                            delete cylinderCand;
-                        }
-                    }
-                    else
-                    {
-                        delete cylinderCand;
-                    }
-                }
-                else
-                {
-                    delete cylinderCand;
-                }
-                //Add Cone Candidate
-                ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
-                if (coneCand->IsValid())
-                {
-                    if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
-                        {
-                            coneCand->UpdateScore(pMesh, vertWeightList);
-                            coneCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
-                            //<< " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
-                            if (coneCand->GetSupportArea() < (coneCand->GetScore() * minScoreProportion))
-                            {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = coneCand;
-                                }
-                                else if (bestCand->GetScore() < coneCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = coneCand;
-                                }
-                                else
-                                {
-                                    delete coneCand;
-                                }
-                            }
-                            else
-                            {
-                                delete coneCand;
-                            }
-                        }
-                        else
-                        {
-                            delete coneCand;
-                        }
-                    }
-                    else
-                    {
-                        delete coneCand;
-                    }
-                }
-                else
-                {
-                    delete coneCand;
-                }
-                //if (bestCand != NULL)
-                //{
-                //    //check lucky break
-                //    if (bestCand->GetSupportArea() > acceptableArea)
-                //    {
-                //        DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << acceptableArea << std::endl;
-                //        candidates.push_back(bestCand);
-                //        return true;
-                //    }
-                //}
-            }
-            if (bestCand != NULL)
-            {
-                //DebugLog << "best score: " << bestCand->GetScore() << " area: " << bestCand->GetSupportArea() << std::endl;
-                candidates.push_back(bestCand);
-                isNewAdded = true;
-            }
-        }
-        return isNewAdded;
-    }
-
-    ShapeCandidate* PrimitiveDetection::Primitive2DSelectionByVertex(Mesh3D* pMesh, int selectIndex, std::vector<int>& res)
-    {
-        int vertNum = pMesh->GetVertexNumber();
-        res = std::vector<int>(vertNum, PrimitiveType::None);
-        std::vector<double> featureScores;
-        CalFeatureScoreByGradient(pMesh, res, featureScores);
-        static Mesh3D* pLastMesh = NULL;
-        static std::vector<int> sampleFlag;
-        static std::vector<double> vertWeightList;
-        if (pMesh != pLastMesh)
-        {
-            pLastMesh = pMesh;
-            sampleFlag = std::vector<int>(vertNum, 0);
-            //std::vector<double> featureScores;
-            //CalFeatureScore(pMesh, sampleFlag, featureScores);
-            pMesh->CalculateFaceArea();
-            CalVertexWeight(pMesh, vertWeightList);
-            pMesh->CalculateBBox();
-            MagicMath::Vector3 bboxMin, bboxMax;
-            pMesh->GetBBox(bboxMin, bboxMax);
-            double bboxSize = (bboxMax - bboxMin).Length();
-            scoreDeviation = bboxSize * 0.0001;
-            maxDistDeviation = bboxSize * 0.004;
-            maxSphereRadius = bboxSize / 2;
-            maxCylinderRadius = bboxSize / 2;
-            minSupportArea = 0;
-            UpdateAcceptableAreaEnhance(pMesh, res, true); //need change to new
-        }
-        //Find the best candidate
-        //selectIndex = 4738;
-        DebugLog << "select index: " << selectIndex << std::endl;
-        int neighborRadius = 15;
-        int minNeigborNum = 6;
-        int neigborSampleNum = 1;
-        std::vector<int> neighborList;
-        std::vector<bool> visitFlag(vertNum, 0);
-        std::vector<int> tranStack;
-        tranStack.push_back(selectIndex);
-        visitFlag[selectIndex] = 1;
-        for (int k = 0; k < neighborRadius; k++)
-        {
-            std::vector<int> tranStackNext;
-            for (std::vector<int>::iterator itr = tranStack.begin(); itr != tranStack.end(); ++itr)
-            {
-                const Vertex3D* pVertNeig = pMesh->GetVertex(*itr);
-                const Edge3D* pEdgeNeig = pVertNeig->GetEdge();
-                do
-                {
-                    if (pEdgeNeig == NULL)
-                    {
-                        break;
-                    }
-                    int newId = pEdgeNeig->GetVertex()->GetId();
-                    if (visitFlag[newId] != 1)
-                    {
-                        visitFlag[newId] = 1;
-                        if (sampleFlag.at(newId) == 0 && res.at(newId) == PrimitiveType::None)
-                        {
-                            tranStackNext.push_back(newId);
-                            neighborList.push_back(newId);
-                        }
-                    }
-                    pEdgeNeig = pEdgeNeig->GetPair()->GetNext();
-                } while (pEdgeNeig != pVertNeig->GetEdge());
-            }
-            tranStack = tranStackNext;
-        }
-        int neighborSize = neighborList.size();
-        if (neighborSize < 10)
-        {
-            DebugLog << "neighbor size small: " << neighborSize << std::endl;
-            return NULL;
-        }
-        const Vertex3D* pVertCand0 = pMesh->GetVertex(selectIndex);
-        int neighborSampleSize = neighborSize / 3;
-        int neighborSampleIterSize = (neighborSampleSize > neigborSampleNum ? neigborSampleNum : neighborSampleSize);
-        ShapeCandidate* bestCand = NULL;
-        for (int neighborSampleIndex = 0; neighborSampleIndex < neighborSampleIterSize; neighborSampleIndex++)
-        {
-            const Vertex3D* pVertCand1 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleIndex) );
-            const Vertex3D* pVertCand2 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex) );
-            //Add Plane Candidate
-            ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
-            if (planeCand->IsValid())
-            {
-                if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                {
-                    if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
-                    {
-                        planeCand->UpdateScore(pMesh, vertWeightList);
-                        planeCand->UpdateSupportArea(pMesh, vertWeightList);
-                        DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
-                            << " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
-                        if (planeCand->GetSupportArea() < (planeCand->GetScore() * minScoreProportion))
-                        {
-                            if (bestCand == NULL)
-                            {
-                                bestCand = planeCand;
-                            }
-                            else if (bestCand->GetScore() < planeCand->GetScore())
-                            {
-                                delete bestCand;
-                                bestCand = planeCand;
+                                bestCand = planeCand;
+                            }
+                            else if (bestCand->GetScore() < planeCand->GetScore())
+                            {
+                                delete bestCand;
+                                bestCand = planeCand;
                             }
                             else
                             {
@@ -3128,18 +3252,18 @@ namespace MagicDGP
                 delete planeCand;
             }
             //Add Sphere Candidate
-            ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
+            ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1, pContext->mParameter);
             if (sphereCand->IsValid())
             {
-                if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (sphereCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
-                    if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
+                    if (sphereCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         sphereCand->UpdateScore(pMesh, vertWeightList);
                         sphereCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "sphere score: " << sphereCand->GetScore() << " area: " << sphereCand->GetSupportArea() 
                             << " score proportion: " << sphereCand->GetSupportArea() / sphereCand->GetScore() << std::endl;
-                        if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * minScoreProportion))
+                        if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             if (bestCand == NULL)
                             {
@@ -3175,18 +3299,18 @@ namespace MagicDGP
                 delete sphereCand;
             }
             //Add Cylinder Candidate
-            ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
+            ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1, pContext->mParameter);
             if (cylinderCand->IsValid())
             {
-                if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (cylinderCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
-                    if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
+                    if (cylinderCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         cylinderCand->UpdateScore(pMesh, vertWeightList);
                         cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "cylinder score: " << cylinderCand->GetScore() << " area: " << cylinderCand->GetSupportArea() 
                             << " score proportion: " << cylinderCand->GetSupportArea() / cylinderCand->GetScore() << std::endl;
-                        if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * minScoreProportion))
+                        if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             if (bestCand == NULL)
                             {
@@ -3222,20 +3346,20 @@ namespace MagicDGP
                 delete cylinderCand;
             }
             //Add Cone Candidate
-            ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
+            ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
             if (coneCand->IsValid())
             {
-                if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (coneCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
                     //coneCand->Refitting(pMesh, res);
-                    if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
+                    if (coneCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         coneCand->UpdateScore(pMesh, vertWeightList);
                         coneCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
                             << " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
                         //if (coneCand->GetScore() > 0)
-                        if (coneCand->GetSupportArea() < (coneCand->GetScore() * minScoreProportion))
+                        if (coneCand->GetSupportArea() < (coneCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             //DebugLog << "score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
                             if (bestCand == NULL)
@@ -3274,9 +3398,9 @@ namespace MagicDGP
             if (bestCand != NULL)
             {
                 //check lucky break
-                if (bestCand->GetSupportArea() > acceptableArea)
+                if (bestCand->GetSupportArea() > pContext->mAcceptableArea)
                 {
-                    DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << acceptableArea << std::endl;
+                    DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << pContext->mAcceptableArea << std::endl;
                     break;
                 }
             }
@@ -3303,18 +3427,25 @@ namespace MagicDGP
         return bestCand;
     }
 
-    ShapeCandidate* PrimitiveDetection::Primitive2DSelectionByVertexSampling(Mesh3D* pMesh, int selectIndex, std::vector<int>& res)
+    ShapeCandidate* PrimitiveDetection::Primitive2DSelectionByVertexSampling(Mesh3D* pMesh, int selectIndex, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
+        PROFILE_ZONE("PrimitiveDetection::SelectionByVertexSampling");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
         int vertNum = pMesh->GetVertexNumber();
         res = std::vector<int>(vertNum, PrimitiveType::None);
         //std::vector<double> featureScores;
         //CalFeatureScoreByGradient(pMesh, res, featureScores);
-        static Mesh3D* pLastMesh = NULL;
-        static std::vector<int> sampleFlag;
-        static std::vector<double> vertWeightList;
-        if (pMesh != pLastMesh)
+        Mesh3D*& pLastMesh = pContext->mpVertexSelectionMesh;
+        std::vector<int>& sampleFlag = pContext->mSampleFlag;
+        std::vector<double>& vertWeightList = pContext->mVertWeightList;
+        if (pMesh != pLastMesh || pContext->mVertexSelectionMode != VSM_Sampling)
         {
             pLastMesh = pMesh;
+            pContext->mVertexSelectionMode = VSM_Sampling;
             sampleFlag = std::vector<int>(vertNum, 0);
             std::vector<double> featureScores;
             CalFeatureScoreByGradient(pMesh, sampleFlag, featureScores);
@@ -3326,12 +3457,12 @@ namespace MagicDGP
             MagicMath::Vector3 bboxMin, bboxMax;
             pMesh->GetBBox(bboxMin, bboxMax);
             double bboxSize = (bboxMax - bboxMin).Length();
-            scoreDeviation = bboxSize * 0.0001;
-            maxDistDeviation = bboxSize * 0.004;
-            maxSphereRadius = bboxSize / 2;
-            maxCylinderRadius = bboxSize / 2;
-            minSupportArea = 0;
-            UpdateAcceptableAreaEnhance(pMesh, res, true); //need change to new
+            pContext->mParameter.mScoreDeviation = bboxSize * 0.0001;
+            pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+            pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+            pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
+            pContext->mMinSupportArea = 0;
+            UpdateAcceptableAreaEnhance(pMesh, res, true, pContext); //need change to new
         }
         //Find the best candidate
         //selectIndex = 4738;
@@ -3388,18 +3519,18 @@ namespace MagicDGP
             const Vertex3D* pVertCand1 = pMesh->GetVertex( sampleNeigbors.at(groupIndex * 3 + 1) );
             const Vertex3D* pVertCand2 = pMesh->GetVertex( sampleNeigbors.at(groupIndex * 3 + 2) );
             //Add Plane Candidate
-            ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
+            ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
             if (planeCand->IsValid())
             {
-                if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (planeCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
-                    //if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
+                    //if (planeCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         planeCand->UpdateScore(pMesh, vertWeightList);
                         planeCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
                             << " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
-                        if (planeCand->GetSupportArea() < (planeCand->GetScore() * minScoreProportion))
+                        if (planeCand->GetSupportArea() < (planeCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             if (bestCand == NULL)
                             {
@@ -3435,18 +3566,18 @@ namespace MagicDGP
                 delete planeCand;
             }
             //Add Sphere Candidate
-            ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
+            ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1, pContext->mParameter);
             if (sphereCand->IsValid())
             {
-                if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (sphereCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
-                    //if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
+                    //if (sphereCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         sphereCand->UpdateScore(pMesh, vertWeightList);
                         sphereCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "sphere score: " << sphereCand->GetScore() << " area: " << sphereCand->GetSupportArea() 
                             << " score proportion: " << sphereCand->GetSupportArea() / sphereCand->GetScore() << std::endl;
-                        if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * minScoreProportion))
+                        if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             if (bestCand == NULL)
                             {
@@ -3482,18 +3613,18 @@ namespace MagicDGP
                 delete sphereCand;
             }
             //Add Cylinder Candidate
-            ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
+            ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1, pContext->mParameter);
             if (cylinderCand->IsValid())
             {
-                if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (cylinderCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
-                    //if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
+                    //if (cylinderCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         cylinderCand->UpdateScore(pMesh, vertWeightList);
                         cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "cylinder score: " << cylinderCand->GetScore() << " area: " << cylinderCand->GetSupportArea() 
                             << " score proportion: " << cylinderCand->GetSupportArea() / cylinderCand->GetScore() << std::endl;
-                        if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * minScoreProportion))
+                        if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             if (bestCand == NULL)
                             {
@@ -3529,20 +3660,20 @@ namespace MagicDGP
                 delete cylinderCand;
             }
             //Add Cone Candidate
-            ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
+            ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2, pContext->mParameter);
             if (coneCand->IsValid())
             {
-                if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                if (coneCand->CalSupportVertex(pMesh, res) > pContext->mMinInitSupportNum)
                 {
                     //coneCand->Refitting(pMesh, res);
-                    //if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
+                    //if (coneCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
                     {
                         coneCand->UpdateScore(pMesh, vertWeightList);
                         coneCand->UpdateSupportArea(pMesh, vertWeightList);
                         DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
                             << " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
                         //if (coneCand->GetScore() > 0)
-                        if (coneCand->GetSupportArea() < (coneCand->GetScore() * minScoreProportion))
+                        if (coneCand->GetSupportArea() < (coneCand->GetScore() * pContext->mMinScoreProportion))
                         {
                             //DebugLog << "score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
                             if (bestCand == NULL)
@@ -3581,9 +3712,9 @@ namespace MagicDGP
             if (bestCand != NULL)
             {
                 //check lucky break
-                if (bestCand->GetSupportArea() > acceptableArea)
+                if (bestCand->GetSupportArea() > pContext->mAcceptableArea)
                 {
-                    DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << acceptableArea << std::endl;
+                    DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << pContext->mAcceptableArea << std::endl;
                     break;
                 }
             }
@@ -3611,17 +3742,24 @@ namespace MagicDGP
         return bestCand;
     }
 
-    ShapeCandidate* PrimitiveDetection::Primitive2DSelectionByVertexPatch(Mesh3D* pMesh, int selectIndex, std::vector<int>& res)
+    ShapeCandidate* PrimitiveDetection::Primitive2DSelectionByVertexPatch(Mesh3D* pMesh, int selectIndex, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
+        PROFILE_ZONE("PrimitiveDetection::SelectionByVertexPatch");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
         int vertNum = pMesh->GetVertexNumber();
         res = std::vector<int>(vertNum, PrimitiveType::None);
 
-        static Mesh3D* pLastMesh = NULL;
-        static std::vector<int> sampleFlag;
-        static std::vector<double> vertWeightList;
-        if (pMesh != pLastMesh)
+        Mesh3D*& pLastMesh = pContext->mpVertexSelectionMesh;
+        std::vector<int>& sampleFlag = pContext->mSampleFlag;
+        std::vector<double>& vertWeightList = pContext->mVertWeightList;
+        if (pMesh != pLastMesh || pContext->mVertexSelectionMode != VSM_Patch)
         {
             pLastMesh = pMesh;
+            pContext->mVertexSelectionMode = VSM_Patch;
             sampleFlag = std::vector<int>(vertNum, 0);
             std::vector<double> featureScores;
             CalFeatureScore(pMesh, sampleFlag, featureScores);
@@ -3631,12 +3769,12 @@ namespace MagicDGP
             MagicMath::Vector3 bboxMin, bboxMax;
             pMesh->GetBBox(bboxMin, bboxMax);
             double bboxSize = (bboxMax - bboxMin).Length();
-            scoreDeviation = bboxSize * 0.0001;
-            maxDistDeviation = bboxSize * 0.004;
-            maxSphereRadius = bboxSize / 2;
-            maxCylinderRadius = bboxSize / 2;
-            minSupportArea = 0;
-            UpdateAcceptableAreaEnhance(pMesh, res, true); //need change to new
+            pContext->mParameter.mScoreDeviation = bboxSize * 0.0001;
+            pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+            pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+            pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
+            pContext->mMinSupportArea = 0;
+            UpdateAcceptableAreaEnhance(pMesh, res, true, pContext); //need change to new
         }
         //Find the best candidate
         int neighborRadius = 10;
@@ -3682,14 +3820,14 @@ namespace MagicDGP
         //if (planeCand->IsValidFromPatch(pMesh, neighborList))
         //{
         //    //planeCand->Refitting(pMesh, res);
-        //    if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
+        //    if (planeCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
         //    {
         //        planeCand->UpdateScore(pMesh, vertWeightList);
         //        planeCand->UpdateSupportArea(pMesh, vertWeightList);
         //        supportCand = planeCand->GetSupportVertex();
         //        DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
         //            << " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
-        //        //if (planeCand->GetSupportArea() < (planeCand->GetScore() * minScoreProportion))
+        //        //if (planeCand->GetSupportArea() < (planeCand->GetScore() * pContext->mMinScoreProportion))
         //        if (0)
         //        {
         //            if (bestCand == NULL)
@@ -3725,13 +3863,13 @@ namespace MagicDGP
         if (sphereCand->IsValidFromPatch(pMesh, neighborList))
         {
             sphereCand->Refitting(pMesh, res);
-            if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
+            if (sphereCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
             {
                 sphereCand->UpdateScore(pMesh, vertWeightList);
                 sphereCand->UpdateSupportArea(pMesh, vertWeightList);
                 DebugLog << "sphere score: " << sphereCand->GetScore() << " area: " << sphereCand->GetSupportArea() 
                     << " score proportion: " << sphereCand->GetSupportArea() / sphereCand->GetScore() << std::endl;
-                if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * minScoreProportion))
+                if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * pContext->mMinScoreProportion))
                 {
                     if (bestCand == NULL)
                     {
@@ -3767,13 +3905,13 @@ namespace MagicDGP
         //if (cylinderCand->IsValidFromPatch(pMesh, supportCand))
         //{
         //    cylinderCand->Refitting(pMesh, res);
-        //    if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
+        //    if (cylinderCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
         //    {
         //        cylinderCand->UpdateScore(pMesh, vertWeightList);
         //        cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
         //        DebugLog << "cylinder score: " << cylinderCand->GetScore() << " area: " << cylinderCand->GetSupportArea() 
         //            << " score proportion: " << cylinderCand->GetSupportArea() / cylinderCand->GetScore() << std::endl;
-        //        if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * minScoreProportion))
+        //        if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * pContext->mMinScoreProportion))
         //        {
         //            if (bestCand == NULL)
         //            {
@@ -3804,18 +3942,18 @@ namespace MagicDGP
         //    delete cylinderCand;
         //}
         //Add Cone Candidate
-        ShapeCandidate* coneCand = new ConeCandidate(NULL, NULL, NULL);
+        ShapeCandidate* coneCand = new ConeCandidate(NULL, NULL, NULL, pContext->mParameter);
         if (coneCand->IsValidFromPatch(pMesh, neighborList))
         {
             //coneCand->Refitting(pMesh, res);
-            //if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
+            //if (coneCand->Refitting(pMesh, res) > pContext->mMinInitSupportNum)
             {
                 coneCand->UpdateScore(pMesh, vertWeightList);
                 coneCand->UpdateSupportArea(pMesh, vertWeightList);
                 DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
                     << " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
                 //if (coneCand->GetScore() > 0)
-                //if (coneCand->GetSupportArea() < (coneCand->GetScore() * minScoreProportion))
+                //if (coneCand->GetSupportArea() < (coneCand->GetScore() * pContext->mMinScoreProportion))
                 {
                     DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
                     << " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
@@ -3873,301 +4011,164 @@ namespace MagicDGP
 
     bool PrimitiveDetection::AddNewCandidatesEnhance(std::vector<ShapeCandidate* >& candidates, const Mesh3D* pMesh, 
             std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList, 
-            std::vector<double>& featureScores, std::vector<int>& sampleIndex)
+            std::vector<double>& featureScores, std::vector<int>& sampleIndex, PrimitiveDetectionContext* pContext)
     {
+        PROFILE_ZONE("PrimitiveDetection::AddNewCandidatesEnhance");
         int vertNum = pMesh->GetVertexNumber();
         int sampleId = 0;
         int sampleSetSize = sampleIndex.size();
         int sampleNum = 10;
+        int neighborRadius = 15; //change
+        int minNeigborNum = 10;
         //
+        //Seeds are prepared ahead of the merge, so that a wave of triples runs into the following seeds when a seed
+        //has less triples than the threads. A lucky break undoes the sample flags of the seeds after it.
+        VertexVisitBuffer visitBuffer;
+        std::vector<CandidateHypothesis> hypothesisList;
+        std::vector<int> seedVertexList;
+        std::vector<int> seedTripleEnd;
+        int contextSampleNum = pContext->mSampleIndex.size();
+        bool hasMoreSeed = true;
+        std::vector<ShapeCandidate* > candidateList;
+        int waveNum = GetTripleWaveNumber();
+        int evaluatedEnd = 0;
+        int seedIndex = 0;
+        int tripleIndex = 0;
+        ShapeCandidate* bestCand = NULL;
         bool isNewAdded = false;
-        for (int sid = 0; sid < sampleNum; sid++)
+        while (true)
         {
-            int validSampleId = -1;
-            for (int k = sampleId; k < sampleSetSize; k++)
+            //Prepare the merged seed, and enough seeds for a full wave
+            while (hasMoreSeed && (int(seedTripleEnd.size()) == seedIndex || 
+                (tripleIndex == evaluatedEnd && seedTripleEnd.back() < tripleIndex + waveNum)))
             {
-                int curSampleId = sampleIndex.at(k);
-                if (res.at(curSampleId) == PrimitiveType::None && sampleFlag.at(curSampleId) == 0)
+                if (int(seedTripleEnd.size()) == sampleNum)
                 {
-                    validSampleId = curSampleId;
-                    sampleId = k + 1;
+                    hasMoreSeed = false;
                     break;
                 }
-            }
-            if (validSampleId == -1)
-            {
-                return isNewAdded;
-                /*if (SampleVertex(pMesh, res, sampleFlag, featureScores, sampleIndex, 200, 0.5))
+                int validSampleId = -1;
+                for (int k = sampleId; k < sampleSetSize; k++)
                 {
-                    validSampleId = sampleIndex.at(0);
-                    sampleId = 1;
-                    sampleSetSize = sampleIndex.size();
+                    int curSampleId = sampleIndex.at(k);
+                    if (res.at(curSampleId) == PrimitiveType::None && sampleFlag.at(curSampleId) == 0)
+                    {
+                        validSampleId = curSampleId;
+                        sampleId = k + 1;
+                        break;
+                    }
                 }
-                else
-                {
-                    return isNewAdded;
-                }*/
-            }
-
-            sampleFlag.at(validSampleId) = 1;
-            gSampleIndex.push_back(validSampleId);
-            //Get vertex n neigbors
-            int neighborRadius = 15; //change
-            int minNeigborNum = 10;
-            //int neigborSampleNum = 1;
-            std::vector<int> neighborList;
-            std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
-            std::vector<int> tranStack;
-            tranStack.push_back(validSampleId);
-            visitFlag[validSampleId] = 1;
-            for (int k = 0; k < neighborRadius; k++)
-            {
-                std::vector<int> tranStackNext;
-                for (std::vector<int>::iterator itr = tranStack.begin(); itr != tranStack.end(); ++itr)
+                if (validSampleId == -1)
                 {
-                    const Vertex3D* pVertNeig = pMesh->GetVertex(*itr);
-                    const Edge3D* pEdgeNeig = pVertNeig->GetEdge();
-                    do
+                    hasMoreSeed = false;
+                    break;
+                    /*if (SampleVertex(pMesh, res, sampleFlag, featureScores, sampleIndex, 200, 0.5))
                     {
-                        if (pEdgeNeig == NULL)
-                        {
-                            break;
-                        }
-                        int newId = pEdgeNeig->GetVertex()->GetId();
-                        if (visitFlag[newId] != 1)
-                        {
-                            visitFlag[newId] = 1;
-                            if (sampleFlag.at(newId) == 0 && res.at(newId) == PrimitiveType::None)
-                            {
-                                tranStackNext.push_back(newId);
-                                neighborList.push_back(newId);
-                            }
-                        }
-                        pEdgeNeig = pEdgeNeig->GetPair()->GetNext();
-                    } while (pEdgeNeig != pVertNeig->GetEdge());
-                }
-                tranStack = tranStackNext;
-            }
-            int neighborSize = neighborList.size();
-            if (neighborSize < minNeigborNum)
-            {
-                continue;
-            }
-            std::vector<int> sampleNeighbors;
-            SampleNeighborVertex(pMesh, neighborList, sampleNeighbors);
-            int groupSize = sampleNeighbors.size() / 3;
-            ShapeCandidate* bestCand = NULL;
-            for (int groupIndex = 0; groupIndex < groupSize; groupIndex++)
-            {
-                const Vertex3D* pVertCand0 = pMesh->GetVertex( sampleNeighbors.at(groupIndex * 3) );
-                const Vertex3D* pVertCand1 = pMesh->GetVertex( sampleNeighbors.at(groupIndex * 3 + 1) );
-                const Vertex3D* pVertCand2 = pMesh->GetVertex( sampleNeighbors.at(groupIndex * 3 + 2) );
-
-                //Add Plane Candidate
-                ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
-                if (planeCand->IsValid())
-                {
-                    if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        if (planeCand->Refitting(pMesh, res) > minInitSupportNum)
-                        {
-                            planeCand->UpdateScore(pMesh, vertWeightList);
-                            planeCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "plane score: " << planeCand->GetScore() << " area: " << planeCand->GetSupportArea() 
-                            //<< " score proportion: " << planeCand->GetSupportArea() / planeCand->GetScore() << std::endl;
-                            if (planeCand->GetSupportArea() < (planeCand->GetScore() * minScoreProportion))
-                            {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = planeCand;
-                                }
-                                else if (bestCand->GetScore() < planeCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = planeCand;
-                                }
-                                else
-                                {
-                                    delete planeCand;
-                                }
-                            }
-                            else
-                            {
-                                delete planeCand;
-                            }
-                        }
-                        else
-                        {
-                            delete planeCand;
-                        }
+                        validSampleId = sampleIndex.at(0);
+                        sampleId = 1;
+                        sampleSetSize = sampleIndex.size();
                     }
                     else
                     {
-                        delete planeCand;
-                    }
-                }
-                else
-                {
-                    delete planeCand;
+                        return isNewAdded;
+                    }*/
                 }
-                //Add Sphere Candidate
-                ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
-                if (sphereCand->IsValid())
+
+                sampleFlag.at(validSampleId) = 1;
+                pContext->mSampleIndex.push_back(validSampleId);
+                seedVertexList.push_back(validSampleId);
+                //Get vertex n neigbors
+                //int neigborSampleNum = 1;
+                std::vector<int> neighborList;
+                visitBuffer.Reset(pMesh->GetVertexNumber());
+                std::vector<int> tranStack;
+                tranStack.push_back(validSampleId);
+                visitBuffer.Visit(validSampleId);
+                for (int k = 0; k < neighborRadius; k++)
                 {
-                    if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    std::vector<int> tranStackNext;
+                    for (std::vector<int>::iterator itr = tranStack.begin(); itr != tranStack.end(); ++itr)
                     {
-                        if (sphereCand->Refitting(pMesh, res) > minInitSupportNum)
+                        const Vertex3D* pVertNeig = pMesh->GetVertex(*itr);
+                        const Edge3D* pEdgeNeig = pVertNeig->GetEdge();
+                        do
                         {
-                            sphereCand->UpdateScore(pMesh, vertWeightList);
-                            sphereCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "sphere score: " << sphereCand->GetScore() << " area: " << sphereCand->GetSupportArea() 
-                            //<< " score proportion: " << sphereCand->GetSupportArea() / sphereCand->GetScore() << std::endl;
-                            if (sphereCand->GetSupportArea() < (sphereCand->GetScore() * minScoreProportion))
-                            {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = sphereCand;
-                                }
-                                else if (bestCand->GetScore() < sphereCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = sphereCand;
-                                }
-                                else
-                                {
-                                    delete sphereCand;
-                                }
-                            }
-                            else
+                            if (pEdgeNeig == NULL)
                             {
-                                delete sphereCand;
+                                break;
                             }
-                        }
-                        else
-                        {
-                            delete sphereCand;
-                        }
-                    }
-                    else
-                    {
-                        delete sphereCand;
-                    }
-                }
-                else
-                {
-                    delete sphereCand;
-                }
-                //Add Cylinder Candidate
-                ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
-                if (cylinderCand->IsValid())
-                {
-                    if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        if (cylinderCand->Refitting(pMesh, res) > minInitSupportNum)
-                        {
-                            cylinderCand->UpdateScore(pMesh, vertWeightList);
-                            cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "cylinder score: " << cylinderCand->GetScore() << " area: " << cylinderCand->GetSupportArea() 
-                            //<< " score proportion: " << cylinderCand->GetSupportArea() / cylinderCand->GetScore() << std::endl;
-                            if (cylinderCand->GetSupportArea() < (cylinderCand->GetScore() * minScoreProportion))
+                            int newId = pEdgeNeig->GetVertex()->GetId();
+                            if (!visitBuffer.IsVisited(newId))
                             {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = cylinderCand;
-                                }
-                                else if (bestCand->GetScore() < cylinderCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = cylinderCand;
-                                }
-                                else
+                                visitBuffer.Visit(newId);
+                                if (sampleFlag.at(newId) == 0 && res.at(newId) == PrimitiveType::None)
                                 {
-                                    delete cylinderCand;
+                                    tranStackNext.push_back(newId);
+                                    neighborList.push_back(newId);
                                 }
                             }
-                            else
-                            {
-                                delete cylinderCand;
-                            }
-                        }
-                        else
-                        {
-                            delete cylinderCand;
-                        }
-                    }
-                    else
-                    {
-                        delete cylinderCand;
+                            pEdgeNeig = pEdgeNeig->GetPair()->GetNext();
+                        } while (pEdgeNeig != pVertNeig->GetEdge());
                     }
+                    tranStack = tranStackNext;
                 }
-                else
-                {
-                    delete cylinderCand;
-                }
-                //Add Cone Candidate
-                ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
-                if (coneCand->IsValid())
+                int neighborSize = neighborList.size();
+                if (neighborSize >= minNeigborNum)
                 {
-                    if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        if (coneCand->Refitting(pMesh, res) > minInitSupportNum)
-                        {
-                            coneCand->UpdateScore(pMesh, vertWeightList);
-                            coneCand->UpdateSupportArea(pMesh, vertWeightList);
-                            //DebugLog << "cone score: " << coneCand->GetScore() << " area: " << coneCand->GetSupportArea() 
-                            //<< " score proportion: " << coneCand->GetSupportArea() / coneCand->GetScore() << std::endl;
-                            if (coneCand->GetSupportArea() < (coneCand->GetScore() * minScoreProportion))
-                            {
-                                if (bestCand == NULL)
-                                {
-                                    bestCand = coneCand;
-                                }
-                                else if (bestCand->GetScore() < coneCand->GetScore())
-                                {
-                                    delete bestCand;
-                                    bestCand = coneCand;
-                                }
-                                else
-                                {
-                                    delete coneCand;
-                                }
-                            }
-                            else
-                            {
-                                delete coneCand;
-                            }
-                        }
-                        else
-                        {
-                            delete coneCand;
-                        }
-                    }
-                    else
+                    std::vector<int> sampleNeighbors;
+                    SampleNeighborVertex(pMesh, neighborList, sampleNeighbors);
+                    int groupSize = sampleNeighbors.size() / 3;
+                    for (int groupIndex = 0; groupIndex < groupSize; groupIndex++)
                     {
-                        delete coneCand;
+                        AddTripleHypotheses(hypothesisList, pMesh->GetVertex( sampleNeighbors.at(groupIndex * 3) ), 
+                            pMesh->GetVertex( sampleNeighbors.at(groupIndex * 3 + 1) ), pMesh->GetVertex( sampleNeighbors.at(groupIndex * 3 + 2) ));
                     }
                 }
-                else
-                {
-                    delete coneCand;
-                }
+                seedTripleEnd.push_back(hypothesisList.size() / CandidateTypeNumber);
+            }
+            if (seedIndex == int(seedTripleEnd.size()))
+            {
+                break;
+            }
+            if (tripleIndex == seedTripleEnd.at(seedIndex))
+            {
                 if (bestCand != NULL)
                 {
-                    //check lucky break
-                    if (bestCand->GetSupportArea() > acceptableArea)
-                    {
-                        DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << acceptableArea << std::endl;
-                        candidates.push_back(bestCand);
-                        return true;
-                    }
+                    //DebugLog << "best score: " << bestCand->GetScore() << " area: " << bestCand->GetSupportArea() << std::endl;
+                    candidates.push_back(bestCand);
+                    isNewAdded = true;
+                    bestCand = NULL;
                 }
+                seedIndex++;
+                continue;
+            }
+            if (tripleIndex == evaluatedEnd)
+            {
+                evaluatedEnd = (tripleIndex + waveNum < seedTripleEnd.back()) ? (tripleIndex + waveNum) : seedTripleEnd.back();
+                EvaluateHypotheses(hypothesisList, tripleIndex * CandidateTypeNumber, evaluatedEnd * CandidateTypeNumber, 
+                    pMesh, res, vertWeightList, CC_RefitScoreProportion, pContext, candidateList);
+            }
+            for (int tid = 0; tid < CandidateTypeNumber; tid++)
+            {
+                bestCand = KeepBetterCandidate(bestCand, candidateList.at(tripleIndex * CandidateTypeNumber + tid));
             }
             if (bestCand != NULL)
             {
-                //DebugLog << "best score: " << bestCand->GetScore() << " area: " << bestCand->GetSupportArea() << std::endl;
-                candidates.push_back(bestCand);
-                isNewAdded = true;
+                //check lucky break
+                if (bestCand->GetSupportArea() > pContext->mAcceptableArea)
+                {
+                    DebugLog << "Lucky break: " << bestCand->GetSupportArea() << " " << pContext->mAcceptableArea << std::endl;
+                    DeleteCandidates(candidateList, (tripleIndex + 1) * CandidateTypeNumber);
+                    for (int sid = seedIndex + 1; sid < int(seedVertexList.size()); sid++)
+                    {
+                        sampleFlag.at(seedVertexList.at(sid)) = 0;
+                    }
+                    pContext->mSampleIndex.resize(contextSampleNum + seedIndex + 1);
+                    candidates.push_back(bestCand);
+                    return true;
+                }
             }
+            tripleIndex++;
         }
         return isNewAdded;
     }
@@ -4191,9 +4192,15 @@ namespace MagicDGP
         return bestIndex;
     }
 
-    void PrimitiveDetection::Primitive2DDetection(Mesh3D* pMesh, std::vector<int>& res)
+    void PrimitiveDetection::Primitive2DDetection(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("PrimitiveDetection::Detection");
+        PrimitiveDetectionContext localContext;
+        if (pContext == NULL)
+        {
+            pContext = &localContext;
+        }
+        double timeStart = MagicCore::ToolKit::GetTime();
 
         //Intialize flags
         int vertNum = pMesh->GetVertexNumber();
@@ -4209,11 +4216,11 @@ namespace MagicDGP
         MagicMath::Vector3 bboxMin, bboxMax;
         pMesh->GetBBox(bboxMin, bboxMax);
         double bboxSize = (bboxMax - bboxMin).Length();
-        maxDistDeviation = bboxSize * 0.004;
-        maxSphereRadius = bboxSize / 2;
-        maxCylinderRadius = bboxSize / 2;
-        minSupportArea = 0;
-        UpdateAcceptableArea(pMesh, res);
+        pContext->mParameter.mMaxDistDeviation = bboxSize * 0.004;
+        pContext->mParameter.mMaxSphereRadius = bboxSize / 2;
+        pContext->mParameter.mMaxCylinderRadius = bboxSize / 2;
+        pContext->mMinSupportArea = 0;
+        UpdateAcceptableArea(pMesh, res, pContext);
 
         //Initialize candidates   
         std::vector<ShapeCandidate* > candidates;
@@ -4227,7 +4234,7 @@ namespace MagicDGP
 
         for (int iterIndex = 0; iterIndex < maxIterCount; ++iterIndex)
         {
-            if (AddNewCandidates(candidates, pMesh, res, sampleFlag, vertWeightList) == false)
+            if (AddNewCandidates(candidates, pMesh, res, sampleFlag, vertWeightList, pContext) == false)
             {
                 DebugLog << "Stop: No New Candidates Found" << std::endl;
                 break;
@@ -4237,7 +4244,7 @@ namespace MagicDGP
             ChosePotentials(candidates, potentials);
             //std::map<double, int> bestSet;
             std::map<double, int> refitedPotentials;
-            int refitedNum = RefitPotentials(candidates, potentials, refitedPotentials, pMesh, res, vertWeightList);
+            int refitedNum = RefitPotentials(candidates, potentials, refitedPotentials, pMesh, res, vertWeightList, pContext);
             DebugLog << "Refited Potential number: " << refitedPotentials.size() << std::endl;
             if (refitedNum == 0)
             {
@@ -4256,9 +4263,9 @@ namespace MagicDGP
             for (std::map<double, int>::reverse_iterator itr = refitedPotentials.rbegin(); itr != refitedPotentials.rend(); ++itr)
             {
                 DebugLog << "Candidate" << itr->second << " : " << candidates.at(itr->second)->GetSupportArea()
-                         << "  mAcceptableArea: " << acceptableArea
-                         << " mMinSupportArea: " << minSupportArea << std::endl;
-                if (IsCandidateAcceptable(itr->second, candidates) || itr->second == lastBestPotential)
+                         << "  mAcceptableArea: " << pContext->mAcceptableArea
+                         << " mMinSupportArea: " << pContext->mMinSupportArea << std::endl;
+                if (IsCandidateAcceptable(itr->second, candidates, pContext) || itr->second == lastBestPotential)
                 {
                     //Mark Primitive Type
                     std::vector<int> supportVert = candidates.at(itr->second)->GetSupportVertex();
@@ -4270,8 +4277,8 @@ namespace MagicDGP
 
                     //Remove acceptable from candidates
                     candidates.at(itr->second)->SetRemoved(true);
-                    RemoveAcceptableCandidate(candidates, res);
-                    if (UpdateAcceptableArea(pMesh, res) == false)
+                    RemoveAcceptableCandidate(candidates, res, pContext);
+                    if (UpdateAcceptableArea(pMesh, res, pContext) == false)
                     {
                         stopIteration = true;
                         break;
@@ -4315,6 +4322,25 @@ namespace MagicDGP
         DebugLog << "PrimitiveDetection::Primitive2DDetection total time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
     }
 
+    void PrimitiveDetection::Primitive2DDetectionBatch(const std::vector<Mesh3D*>& meshList, std::vector<std::vector<int> >& resList)
+    {
+        PROFILE_ZONE("PrimitiveDetection::DetectionBatch");
+        double timeStart = MagicCore::ToolKit::GetTime();
+        int meshNum = meshList.size();
+        resList.clear();
+        resList.resize(meshNum);
+        //One mesh per chunk
+        MagicCore::ParallelFor(0, meshNum, [&](int startIndex, int endIndex)
+        {
+            for (int mid = startIndex; mid < endIndex; mid++)
+            {
+                PrimitiveDetectionContext context;
+                Primitive2DDetectionEnhance(meshList.at(mid), resList.at(mid), &context);
+            }
+        }, 1);
+        DebugLog << "PrimitiveDetection::Primitive2DDetectionBatch: " << meshNum << " meshes, total time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+    }
+
     void PrimitiveDetection::CalVertexWeight(Mesh3D* pMesh, std::vector<double>& vertWeightList)
     {
         //DebugLog << "PrimitiveDetection::CalVertexWeight" << std::endl;
@@ -4467,9 +4493,10 @@ namespace MagicDGP
     }
 
     bool PrimitiveDetection::AddNewCandidates(std::vector<ShapeCandidate* >& candidates, const Mesh3D* pMesh, 
-            std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList)
+            std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList, PrimitiveDetectionContext* pContext)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("PrimitiveDetection::AddNewCandidates");
+        double timeStart = MagicCore::ToolKit::GetTime();
         std::vector<int> validVert;
         for (int i = 0; i < res.size(); i++)
         {
@@ -4490,232 +4517,166 @@ namespace MagicDGP
         int neighborRadius = 10;
         int minNeigborNum = 6;
         int neigborSampleNum = 5;
-        bool isNewAdded = false;
         int sampledNumber = 0;
         int skipNumber = 0;
         int sampleIndex = 0;
+        //Seeds are prepared ahead of the merge, so that a wave of triples runs into the following seeds when a seed
+        //has less triples than the threads. A lucky break undoes the sample flags and the acceptable area of the
+        //seeds after it.
+        VertexVisitBuffer visitBuffer;
+        std::vector<CandidateHypothesis> hypothesisList;
+        std::vector<int> flagList;
+        std::vector<int> seedFlagEnd;
+        std::vector<int> seedTripleEnd;
+        std::vector<double> seedAcceptableArea;
+        bool hasMoreSeed = true;
+        bool isAreaStop = false;
+        std::vector<ShapeCandidate* > candidateList;
+        int waveNum = GetTripleWaveNumber();
+        int evaluatedEnd = 0;
+        int seedIndex = 0;
+        int tripleIndex = 0;
+        ShapeCandidate* bestCand = NULL;
+        bool isNewAdded = false;
         //for (int sampleIndex = 0; sampleIndex < validVertNum; sampleIndex += sampleDelta)
-        while (sampledNumber < sampleNum && skipNumber < sampleNum)
+        while (true)
         {
-            sampleIndex = (sampleIndex + sampleDelta) % validVertNum;
-            float iterTime = MagicCore::ToolKit::GetTime();
-            acceptableArea -= acceptableAreaDelta;
-            if (acceptableArea < minSupportArea)
-            {
-                acceptableArea = minSupportArea;
-                DebugLog << "Stop: acceptableArea < minSupportArea" << std::endl;
-                return false;
-            }
-            int currentIndex = validVert.at(sampleIndex);
-            if (sampleFlag.at(currentIndex) == 1)
-            {
-                skipNumber++;
-                continue;
-            }
-            sampleFlag.at(currentIndex) = 1;
-            const Vertex3D* pVert = pMesh->GetVertex(currentIndex);
-            //Get vertex n neigbors
-            std::vector<int> neighborList;
-            std::vector<bool> visitFlag(pMesh->GetVertexNumber(), 0);
-            std::vector<int> tranStack;
-            tranStack.push_back(currentIndex);
-            visitFlag[currentIndex] = 1;
-            for (int k = 0; k < neighborRadius; k++)
+            //Prepare the merged seed, and enough seeds for a full wave
+            while (hasMoreSeed && (int(seedTripleEnd.size()) == seedIndex || 
+                (tripleIndex == evaluatedEnd && seedTripleEnd.back() < tripleIndex + waveNum)))
             {
-                std::vector<int> tranStackNext;
-                for (std::vector<int>::iterator itr = tranStack.begin(); itr != tranStack.end(); ++itr)
+                if (sampledNumber >= sampleNum || skipNumber >= sampleNum)
                 {
-                    const Vertex3D* pVertNeig = pMesh->GetVertex(*itr);
-                    const Edge3D* pEdgeNeig = pVertNeig->GetEdge();
-                    do
-                    {
-                        if (pEdgeNeig == NULL)
-                        {
-                            break;
-                        }
-                        int newId = pEdgeNeig->GetVertex()->GetId();
-                        if (visitFlag[newId] != 1)
-                        {
-                            visitFlag[newId] = 1;
-                            if (res.at(newId) == PrimitiveType::None && sampleFlag.at(newId) == 0)
-                            {
-                                tranStackNext.push_back(newId);
-                                //if (k > 0)
-                                {
-                                    neighborList.push_back(newId);
-                                }
-                            }
-                        }
-                        pEdgeNeig = pEdgeNeig->GetPair()->GetNext();
-                    } while (pEdgeNeig != pVertNeig->GetEdge());
+                    hasMoreSeed = false;
+                    break;
                 }
-                tranStack = tranStackNext;
-            }
-            int neighborSize = neighborList.size();
-            if (neighborSize < minNeigborNum)
-            {
-                DebugLog << "unluck: neighborSize too small: " << neighborSize << std::endl;
-                skipNumber++;
-                continue;
-            }
-            else
-            {
-                skipNumber = 0;
-                sampledNumber++;
-            }
-            const Vertex3D* pVertCand0 = pVert;
-            int neighborSampleSize = neighborSize / 3;
-            int neighborSampleIterSize = (neighborSampleSize > neigborSampleNum ? neigborSampleNum : neighborSampleSize);
-            ShapeCandidate* bestCand = NULL;
-            for (int neighborSampleIndex = 0; neighborSampleIndex < neighborSampleIterSize; neighborSampleIndex++)
-            {
-                const Vertex3D* pVertCand1 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleIndex) );
-                const Vertex3D* pVertCand2 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex) );
-                //Add Plane Candidate
-                ShapeCandidate* planeCand = new PlaneCandidate(pVertCand0, pVertCand1, pVertCand2);
-                if (planeCand->IsValid())
+                sampleIndex = (sampleIndex + sampleDelta) % validVertNum;
+                pContext->mAcceptableArea -= pContext->mAcceptableAreaDelta;
+                if (pContext->mAcceptableArea < pContext->mMinSupportArea)
                 {
-                    if (planeCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        planeCand->UpdateScore(pMesh, vertWeightList);
-                        planeCand->UpdateSupportArea(pMesh, vertWeightList);
-                        if (bestCand == NULL)
-                        {
-                            bestCand = planeCand;
-                        }
-                        else if (bestCand->GetScore() < planeCand->GetScore())
-                        {
-                            delete bestCand;
-                            bestCand = planeCand;
-                        }
-                        else
-                        {
-                            delete planeCand;
-                        }
-                    }
-                    else
-                    {
-                        delete planeCand;
-                    }
+                    pContext->mAcceptableArea = pContext->mMinSupportArea;
+                    isAreaStop = true;
+                    hasMoreSeed = false;
+                    break;
                 }
-                else
+                int currentIndex = validVert.at(sampleIndex);
+                if (sampleFlag.at(currentIndex) == 1)
                 {
-                    delete planeCand;
+                    skipNumber++;
+                    continue;
                 }
-                //Add Sphere Candidate
-                ShapeCandidate* sphereCand = new SphereCandidate(pVertCand0, pVertCand1);
-                if (sphereCand->IsValid())
+                sampleFlag.at(currentIndex) = 1;
+                flagList.push_back(currentIndex);
+                const Vertex3D* pVert = pMesh->GetVertex(currentIndex);
+                //Get vertex n neigbors
+                std::vector<int> neighborList;
+                visitBuffer.Reset(pMesh->GetVertexNumber());
+                std::vector<int> tranStack;
+                tranStack.push_back(currentIndex);
+                visitBuffer.Visit(currentIndex);
+                for (int k = 0; k < neighborRadius; k++)
                 {
-                    if (sphereCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
+                    std::vector<int> tranStackNext;
+                    for (std::vector<int>::iterator itr = tranStack.begin(); itr != tranStack.end(); ++itr)
                     {
-                        sphereCand->UpdateScore(pMesh, vertWeightList);
-                        sphereCand->UpdateSupportArea(pMesh, vertWeightList);
-                        if (bestCand == NULL)
-                        {
-                            bestCand = sphereCand;
-                        }
-                        else if (bestCand->GetScore() < sphereCand->GetScore())
-                        {
-                            delete bestCand;
-                            bestCand = sphereCand;
-                        }
-                        else
+                        const Vertex3D* pVertNeig = pMesh->GetVertex(*itr);
+                        const Edge3D* pEdgeNeig = pVertNeig->GetEdge();
+                        do
                         {
-                            delete sphereCand;
-                        }
-                    }
-                    else
-                    {
-                        delete sphereCand;
+                            if (pEdgeNeig == NULL)
+                            {
+                                break;
+                            }
+                            int newId = pEdgeNeig->GetVertex()->GetId();
+                            if (!visitBuffer.IsVisited(newId))
+                            {
+                                visitBuffer.Visit(newId);
+                                if (res.at(newId) == PrimitiveType::None && sampleFlag.at(newId) == 0)
+                                {
+                                    tranStackNext.push_back(newId);
+                                    //if (k > 0)
+                                    {
+                                        neighborList.push_back(newId);
+                                    }
+                                }
+                            }
+                            pEdgeNeig = pEdgeNeig->GetPair()->GetNext();
+                        } while (pEdgeNeig != pVertNeig->GetEdge());
                     }
+                    tranStack = tranStackNext;
                 }
-                else
-                {
-                    delete sphereCand;
-                }
-                //Add Cylinder Candidate
-                ShapeCandidate* cylinderCand = new CylinderCandidate(pVertCand0, pVertCand1);
-                if (cylinderCand->IsValid())
+                int neighborSize = neighborList.size();
+                if (neighborSize < minNeigborNum)
                 {
-                    if (cylinderCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        cylinderCand->UpdateScore(pMesh, vertWeightList);
-                        cylinderCand->UpdateSupportArea(pMesh, vertWeightList);
-                        if (bestCand == NULL)
-                        {
-                            bestCand = cylinderCand;
-                        }
-                        else if (bestCand->GetScore() < cylinderCand->GetScore())
-                        {
-                            delete bestCand;
-                            bestCand = cylinderCand;
-                        }
-                        else
-                        {
-                            delete cylinderCand;
-                        }
-                    }
-                    else
-                    {
-                        delete cylinderCand;
-                    }
+                    DebugLog << "unluck: neighborSize too small: " << neighborSize << std::endl;
+                    skipNumber++;
+                    continue;
                 }
                 else
                 {
-                    delete cylinderCand;
+                    skipNumber = 0;
+                    sampledNumber++;
                 }
-                //Add Cone Candidate
-                ShapeCandidate* coneCand = new ConeCandidate(pVertCand0, pVertCand1, pVertCand2);
-                if (coneCand->IsValid())
-                {
-                    if (coneCand->CalSupportVertex(pMesh, res) > minInitSupportNum)
-                    {
-                        coneCand->UpdateScore(pMesh, vertWeightList);
-                        coneCand->UpdateSupportArea(pMesh, vertWeightList);
-                        if (bestCand == NULL)
-                        {
-                            bestCand = coneCand;
-                        }
-                        else if (bestCand->GetScore() < coneCand->GetScore())
-                        {
-                            delete bestCand;
-                            bestCand = coneCand;
-                        }
-                        else
-                        {
-                            delete coneCand;
-                        }
-                    }
-                    else
-                    {
-                        delete coneCand;
-                    }
-                }
-                else
+                const Vertex3D* pVertCand0 = pVert;
+                int neighborSampleSize = neighborSize / 3;
+                int neighborSampleIterSize = (neighborSampleSize > neigborSampleNum ? neigborSampleNum : neighborSampleSize);
+                for (int neighborSampleIndex = 0; neighborSampleIndex < neighborSampleIterSize; neighborSampleIndex++)
                 {
-                    delete coneCand;
+                    const Vertex3D* pVertCand1 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleIndex) );
+                    const Vertex3D* pVertCand2 = pMesh->GetVertex( neighborList.at(neighborSize - 1 - neighborSampleSize - neighborSampleIndex) );
+                    AddTripleHypotheses(hypothesisList, pVertCand0, pVertCand1, pVertCand2);
                 }
-                //check luck break;
+                seedTripleEnd.push_back(hypothesisList.size() / CandidateTypeNumber);
+                seedFlagEnd.push_back(flagList.size());
+                seedAcceptableArea.push_back(pContext->mAcceptableArea);
+            }
+            if (seedIndex == int(seedTripleEnd.size()))
+            {
+                break;
+            }
+            if (tripleIndex == seedTripleEnd.at(seedIndex))
+            {
                 if (bestCand != NULL)
                 {
-                    if (bestCand->GetSupportArea() > acceptableArea)
-                    {
-                        DebugLog << "Super Luck break in FindNewCandidates" << std::endl;
-                        candidates.push_back(bestCand);
-                        return true;
-                    }
+                    candidates.push_back(bestCand);
+                    isNewAdded = true;
+                    bestCand = NULL;
                 }
+                seedIndex++;
+                continue;
             }
+            if (tripleIndex == evaluatedEnd)
+            {
+                evaluatedEnd = (tripleIndex + waveNum < seedTripleEnd.back()) ? (tripleIndex + waveNum) : seedTripleEnd.back();
+                EvaluateHypotheses(hypothesisList, tripleIndex * CandidateTypeNumber, evaluatedEnd * CandidateTypeNumber, 
+                    pMesh, res, vertWeightList, CC_Support, pContext, candidateList);
+            }
+            for (int tid = 0; tid < CandidateTypeNumber; tid++)
+            {
+                bestCand = KeepBetterCandidate(bestCand, candidateList.at(tripleIndex * CandidateTypeNumber + tid));
+            }
+            //check luck break;
             if (bestCand != NULL)
             {
-                candidates.push_back(bestCand);
-                isNewAdded = true;
-                if (bestCand->GetSupportArea() > acceptableArea)
+                if (bestCand->GetSupportArea() > seedAcceptableArea.at(seedIndex))
                 {
-                    DebugLog << "Luck break in FindNewCandidates" << std::endl;
-                    break;
+                    DebugLog << "Super Luck break in FindNewCandidates" << std::endl;
+                    DeleteCandidates(candidateList, (tripleIndex + 1) * CandidateTypeNumber);
+                    for (int fid = seedFlagEnd.at(seedIndex); fid < int(flagList.size()); fid++)
+                    {
+                        sampleFlag.at(flagList.at(fid)) = 0;
+                    }
+                    pContext->mAcceptableArea = seedAcceptableArea.at(seedIndex);
+                    candidates.push_back(bestCand);
+                    return true;
                 }
             }
+            tripleIndex++;
+        }
+        if (isAreaStop)
+        {
+            DebugLog << "Stop: pContext->mAcceptableArea < pContext->mMinSupportArea" << std::endl;
+            return false;
         }
 
         if (isNewAdded == false)
@@ -4727,9 +4688,9 @@ namespace MagicDGP
         return isNewAdded;
     }
 
-    bool PrimitiveDetection::IsCandidateAcceptable(int index, std::vector<ShapeCandidate* >& candidates)
+    bool PrimitiveDetection::IsCandidateAcceptable(int index, std::vector<ShapeCandidate* >& candidates, PrimitiveDetectionContext* pContext)
     {
-        if (candidates.at(index)->GetSupportArea() > acceptableArea)
+        if (candidates.at(index)->GetSupportArea() > pContext->mAcceptableArea)
         {
             return true;
         }
@@ -4739,7 +4700,7 @@ namespace MagicDGP
         }
     }
 
-    void PrimitiveDetection::RemoveAcceptableCandidate(std::vector<ShapeCandidate* >& candidates, const std::vector<int>& res)
+    void PrimitiveDetection::RemoveAcceptableCandidate(std::vector<ShapeCandidate* >& candidates, const std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
         int candNum = candidates.size();
         for (int i = 0; i < candNum; i++)
@@ -4759,7 +4720,7 @@ namespace MagicDGP
                     newSupportVertex.push_back(oldSupportVertex.at(j));
                 }
             }
-            if (newSupportVertex.size() < minSupportNum)
+            if (newSupportVertex.size() < pContext->mMinSupportNum)
             {
                 newSupportVertex.clear();
                 pCand->SetRemoved(true);
@@ -4804,7 +4765,7 @@ namespace MagicDGP
         DebugLog << "validCandNum: " << validCandNum << " potentialNum: " << bestNum << std::endl;
     }
 
-    bool PrimitiveDetection::UpdateAcceptableArea(Mesh3D* pMesh, std::vector<int>& res)
+    bool PrimitiveDetection::UpdateAcceptableArea(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext)
     {
         double validArea = 0;
         int faceNum = pMesh->GetFaceNumber();
@@ -4827,14 +4788,14 @@ namespace MagicDGP
                 continue;
             }
         }
-        acceptableArea = validArea * acceptableAreaScale;
-        acceptableAreaDelta = acceptableArea / 500;
-        minSupportArea = validArea / 100;
-        DebugLog << "UpdateAcceptableArea: valid: " << validArea << " Acceptable: " << acceptableArea << std::endl;
+        pContext->mAcceptableArea = validArea * pContext->mAcceptableAreaScale;
+        pContext->mAcceptableAreaDelta = pContext->mAcceptableArea / 500;
+        pContext->mMinSupportArea = validArea / 100;
+        DebugLog << "UpdateAcceptableArea: valid: " << validArea << " Acceptable: " << pContext->mAcceptableArea << std::endl;
         return true;
     }
 
-    bool PrimitiveDetection::UpdateAcceptableAreaEnhance(Mesh3D* pMesh, std::vector<int>& res, double acceptScale)
+    bool PrimitiveDetection::UpdateAcceptableAreaEnhance(Mesh3D* pMesh, std::vector<int>& res, double acceptScale, PrimitiveDetectionContext* pContext)
     {
         double validArea = 0;
         int faceNum = pMesh->GetFaceNumber();
@@ -4857,14 +4818,14 @@ namespace MagicDGP
                 continue;
             }
         }
-        acceptableArea = validArea * acceptScale;
+        pContext->mAcceptableArea = validArea * acceptScale;
         
-        minSupportArea = validArea / 100;
-        DebugLog << "UpdateAcceptableArea: valid: " << validArea << " Acceptable: " << acceptableArea << std::endl;
+        pContext->mMinSupportArea = validArea / 100;
+        DebugLog << "UpdateAcceptableArea: valid: " << validArea << " Acceptable: " << pContext->mAcceptableArea << std::endl;
         return true;
     }
 
-    bool PrimitiveDetection::UpdateAcceptableScore(Mesh3D* pMesh, std::vector<int>& res, double scoreScale)
+    bool PrimitiveDetection::UpdateAcceptableScore(Mesh3D* pMesh, std::vector<int>& res, double scoreScale, PrimitiveDetectionContext* pContext)
     {
         double validArea = 0;
         int faceNum = pMesh->GetFaceNumber();
@@ -4887,10 +4848,10 @@ namespace MagicDGP
                 continue;
             }
         }
-        acceptableArea = validArea * acceptableAreaScale;
-        acceptableAreaDelta = acceptableArea / 500;
-        minSupportArea = validArea / 100;
-        acceptableScore = acceptableArea * scoreScale;
+        pContext->mAcceptableArea = validArea * pContext->mAcceptableAreaScale;
+        pContext->mAcceptableAreaDelta = pContext->mAcceptableArea / 500;
+        pContext->mMinSupportArea = validArea / 100;
+        pContext->mAcceptableScore = pContext->mAcceptableArea * scoreScale;
 
         return true;
     }
@@ -5013,6 +4974,7 @@ namespace MagicDGP
 
     void PrimitiveDetection::CalFeatureScoreByGradient(Mesh3D* pMesh, std::vector<int>& features, std::vector<double>& scores)
     {
+        PROFILE_ZONE("PrimitiveDetection::CalFeatureScoreByGradient");
         int vertNum = pMesh->GetVertexNumber();
         std::vector<double> norDev(vertNum);
         for (int vid = 0; vid < vertNum; vid++)
@@ -5095,6 +5057,7 @@ namespace MagicDGP
 
     void PrimitiveDetection::CalFeatureScore(Mesh3D* pMesh, std::vector<int>& features, std::vector<double>& scores)
     {
+        PROFILE_ZONE("PrimitiveDetection::CalFeatureScore");
         int vertNum = pMesh->GetVertexNumber();
         double scale = 5;
         //if (vertNum > 100000)
@@ -5173,17 +5136,18 @@ namespace MagicDGP
     }
 
     int PrimitiveDetection::RefitPotentials(std::vector<ShapeCandidate* >& candidates, std::vector<int>& potentials, std::map<double, int>& refitedPotentials,
-            Mesh3D* pMesh, std::vector<int>& resFlag, std::vector<double>& vertWeightList)
+            Mesh3D* pMesh, std::vector<int>& resFlag, std::vector<double>& vertWeightList, PrimitiveDetectionContext* pContext)
     {
         refitedPotentials.clear();
+        VertexVisitBuffer visitBuffer;
         for (std::vector<int>::iterator itr = potentials.begin(); itr != potentials.end(); ++itr)
         {
             if (candidates.at(*itr)->HasRefit())
             {
-                if (candidates.at(*itr)->GetSupportArea() > minSupportArea)
+                if (candidates.at(*itr)->GetSupportArea() > pContext->mMinSupportArea)
                 {
                     refitedPotentials[candidates.at(*itr)->GetScore()] = *itr;
-                    if (candidates.at(*itr)->GetSupportArea() > acceptableArea)
+                    if (candidates.at(*itr)->GetSupportArea() > pContext->mAcceptableArea)
                     {
                         DebugLog << "Luck break" << std::endl;
                         return refitedPotentials.size();
@@ -5192,14 +5156,14 @@ namespace MagicDGP
             }
             else
             {
-                if (candidates.at(*itr)->Refitting(pMesh, resFlag) > minSupportNum)
+                if (candidates.at(*itr)->Refitting(pMesh, resFlag, &visitBuffer) > pContext->mMinSupportNum)
                 {
                     candidates.at(*itr)->UpdateSupportArea(pMesh, vertWeightList);
-                    if (candidates.at(*itr)->GetSupportArea() > minSupportArea)
+                    if (candidates.at(*itr)->GetSupportArea() > pContext->mMinSupportArea)
                     {
                         candidates.at(*itr)->UpdateScore(pMesh, vertWeightList);
                         refitedPotentials[candidates.at(*itr)->GetScore()] = *itr;
-                        if (candidates.at(*itr)->GetSupportArea() > acceptableArea)
+                        if (candidates.at(*itr)->GetSupportArea() > pContext->mAcceptableArea)
                         {
                             DebugLog << "Luck break" << std::endl;
                             return refitedPotentials.size();
@@ -1,5 +1,11 @@
 #pragma once 
 #include "Mesh3D.h"
+#include <mutex>
+
+namespace MagicCore
+{
+    class CancelToken;
+}
 
 namespace MagicDGP
 {
@@ -27,15 +33,100 @@ namespace MagicDGP
         }
     };
 
+    //Visit flags of a mesh traversal. Reset is constant time, so one buffer serves many traversals.
+    class VertexVisitBuffer
+    {
+    public:
+        VertexVisitBuffer();
+        //Starts a new traversal, no vertex is visited
+        void Reset(int vertNum);
+        bool IsVisited(int vid) const
+        {
+            return mVisitMark[vid] == mCurrentMark;
+        }
+        void Visit(int vid)
+        {
+            mVisitMark[vid] = mCurrentMark;
+        }
+
+    private:
+        std::vector<int> mVisitMark;
+        int mCurrentMark;
+    };
+
+    //Thresholds of the shape candidates. A candidate keeps a copy, so it stays valid after the detection.
+    struct PrimitiveParameter
+    {
+        double mMaxAngleDeviation;
+        double mMaxDistDeviation;
+        double mMaxCylinderRadiusScale;
+        double mMaxSphereRadiusScale;
+        double mMaxSphereRadius;
+        double mMaxCylinderRadius;
+        double mMinConeAngle;
+        double mMaxConeAngle;
+        double mMaxConeAngleDeviation;
+        double mBaseScore;
+        double mScoreDeviation;
+
+        PrimitiveParameter();
+    };
+
+    class ShapeCandidate;
+
+    //Parameters and state of one detection. Detections with different contexts can run at the same time.
+    //The selection functions keep their per mesh data here between calls.
+    class PrimitiveDetectionContext
+    {
+    public:
+        PrimitiveDetectionContext();
+        //Visit buffers kept over the traversals of the detection, about one per thread. Thread safe.
+        VertexVisitBuffer* AcquireVisitBuffer();
+        void ReleaseVisitBuffer(VertexVisitBuffer* pVisitBuffer);
+        ~PrimitiveDetectionContext();
+
+    private:
+        PrimitiveDetectionContext(const PrimitiveDetectionContext&);
+        PrimitiveDetectionContext& operator = (const PrimitiveDetectionContext&);
+
+        std::vector<VertexVisitBuffer* > mVisitBufferList;
+        std::mutex mVisitBufferMutex;
+
+    public:
+        PrimitiveParameter mParameter;
+        int mMinInitSupportNum;
+        int mMinSupportNum;
+        double mMinSupportArea;
+        double mAcceptableAreaScale;
+        double mAcceptableArea;
+        double mAcceptableAreaDelta;
+        double mAcceptableScore;
+        double mMinScoreProportion;
+        std::vector<int> mSampleIndex;
+        //Primitive2DDetectionEnhance stops between iterations when it is cancelled, NULL never cancels
+        const MagicCore::CancelToken* mpCancelToken;
+        //Primitive2DSelection
+        Mesh3D* mpSelectionMesh;
+        std::vector<int> mSelectionRes;
+        std::map<double, ShapeCandidate* > mCandidateMap;
+        std::vector<ShapeCandidate* > mCandidateList;
+        //Primitive2DSelectionByVertex, ByVertexSampling and ByVertexPatch
+        Mesh3D* mpVertexSelectionMesh;
+        int mVertexSelectionMode;
+        std::vector<int> mSampleFlag;
+        std::vector<double> mVertWeightList;
+    };
+
     class ShapeCandidate
     {
     public:
-        ShapeCandidate();
+        ShapeCandidate(const PrimitiveParameter& para);
         virtual ~ShapeCandidate();
         virtual bool IsValidFromPatch(const Mesh3D* pMesh, std::vector<int>& supportVertex) = 0;
         virtual bool IsValid() = 0;
-        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag) = 0;
-        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag) = 0;
+        //pVisitBuffer NULL uses a buffer of the call only
+        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL) = 0;
+        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL) = 0;
         virtual bool FitParameter(const Mesh3D* pMesh) = 0;
         virtual PrimitiveType GetType() = 0;
         bool IsRemoved();
@@ -49,6 +140,7 @@ namespace MagicDGP
         virtual void UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList) = 0;
         bool HasRefit() const;
     protected:
+        PrimitiveParameter mParameter;
         std::vector<int> mSupportVertex;
         PrimitiveType mType;
         double mScore;
@@ -60,12 +152,12 @@ namespace MagicDGP
     class PlaneCandidate : public ShapeCandidate
     {
     public:
-        PlaneCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2);
+        PlaneCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2, const PrimitiveParameter& para);
         virtual ~PlaneCandidate();
         virtual bool IsValid();
         virtual bool IsValidFromPatch(const Mesh3D* pMesh, std::vector<int>& supportVertex);
-        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag);
-        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag);
+        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
+        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
         virtual bool FitParameter(const Mesh3D* pMesh);
         virtual PrimitiveType GetType();
         virtual void UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList);
@@ -80,12 +172,12 @@ namespace MagicDGP
     class SphereCandidate : public ShapeCandidate
     {
     public:
-        SphereCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1);
+        SphereCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const PrimitiveParameter& para);
         virtual ~SphereCandidate();
         virtual bool IsValid();
         virtual bool IsValidFromPatch(const Mesh3D* pMesh, std::vector<int>& supportVertex);
-        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag);
-        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag);
+        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
+        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
         virtual bool FitParameter(const Mesh3D* pMesh);
         virtual PrimitiveType GetType();
         virtual void UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList);
@@ -99,12 +191,12 @@ namespace MagicDGP
     class CylinderCandidate : public ShapeCandidate
     {
     public:
-        CylinderCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1);
+        CylinderCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const PrimitiveParameter& para);
         virtual ~CylinderCandidate();
         virtual bool IsValid();
         virtual bool IsValidFromPatch(const Mesh3D* pMesh, std::vector<int>& supportVertex);
-        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag);
-        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag);
+        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
+        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
         virtual bool FitParameter(const Mesh3D* pMesh);
         virtual PrimitiveType GetType();
         virtual void UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList);
@@ -120,12 +212,12 @@ namespace MagicDGP
     class ConeCandidate : public ShapeCandidate
     {
     public:
-        ConeCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2);
+        ConeCandidate(const Vertex3D* pVert0, const Vertex3D* pVert1, const Vertex3D* pVert2, const PrimitiveParameter& para);
         virtual ~ConeCandidate();
         virtual bool IsValid();
         virtual bool IsValidFromPatch(const Mesh3D* pMesh, std::vector<int>& supportVertex);
-        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag);
-        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag);
+        virtual int CalSupportVertex(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
+        virtual int Refitting(const Mesh3D* pMesh, std::vector<int>& resFlag, VertexVisitBuffer* pVisitBuffer = NULL);
         virtual bool FitParameter(const Mesh3D* pMesh);
         virtual PrimitiveType GetType();
         virtual void UpdateScore(const Mesh3D* pMesh, std::vector<double>& vertWeightList);
@@ -144,13 +236,17 @@ namespace MagicDGP
         PrimitiveDetection();
         ~PrimitiveDetection();
 
-        static void Primitive2DDetection(Mesh3D* pMesh, std::vector<int>& res);
-        static void Primitive2DSelection(Mesh3D* pMesh, std::vector<int>& res);
-        static void Primitive2DDetectionEnhance(Mesh3D* pMesh, std::vector<int>& res);
-        static void Primitive2DDetectionByScore(Mesh3D* pMesh, std::vector<int>& res);
-        static ShapeCandidate* Primitive2DSelectionByVertex(Mesh3D* pMesh, int selectIndex, std::vector<int>& res);
-        static ShapeCandidate* Primitive2DSelectionByVertexPatch(Mesh3D* pMesh, int selectIndex, std::vector<int>& res);
-        static ShapeCandidate* Primitive2DSelectionByVertexSampling(Mesh3D* pMesh, int selectIndex, std::vector<int>& res);
+        //pContext NULL uses a context of the call only. The selection functions need the same context over calls
+        //to keep their per mesh data.
+        static void Primitive2DDetection(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        static void Primitive2DSelection(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        static void Primitive2DDetectionEnhance(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        static void Primitive2DDetectionByScore(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        static ShapeCandidate* Primitive2DSelectionByVertex(Mesh3D* pMesh, int selectIndex, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        static ShapeCandidate* Primitive2DSelectionByVertexPatch(Mesh3D* pMesh, int selectIndex, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        static ShapeCandidate* Primitive2DSelectionByVertexSampling(Mesh3D* pMesh, int selectIndex, std::vector<int>& res, PrimitiveDetectionContext* pContext = NULL);
+        //Primitive2DDetectionEnhance of every mesh with an own context, the meshes are processed in parallel
+        static void Primitive2DDetectionBatch(const std::vector<Mesh3D*>& meshList, std::vector<std::vector<int> >& resList);
     
     private:
         static void CalVertexWeight(Mesh3D* pMesh, std::vector<double>& vertWeightList);
@@ -158,27 +254,27 @@ namespace MagicDGP
             std::vector<int>& sampleIndex, int sampleNum, double validProportion);
         static void SampleNeighborVertex(const Mesh3D* pMesh, std::vector<int>& neighborList, std::vector<int>& sampleNeigbors);
         static bool AddNewCandidates(std::vector<ShapeCandidate* >& candidates, const Mesh3D* pMesh, 
-            std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList);
+            std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList, PrimitiveDetectionContext* pContext);
         static bool AddNewCandidatesEnhance(std::vector<ShapeCandidate* >& candidates, const Mesh3D* pMesh, 
             std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList, 
-            std::vector<double>& featureScores, std::vector<int>& sampleIndex);
+            std::vector<double>& featureScores, std::vector<int>& sampleIndex, PrimitiveDetectionContext* pContext);
         static bool AddNewCandidatesByScore(std::vector<ShapeCandidate* >& candidates, const Mesh3D* pMesh, 
             std::vector<int>& res, std::vector<int>& sampleFlag, std::vector<double>& vertWeightList, 
-            std::vector<double>& featureScores, std::vector<int>& sampleIndex);
-        static bool IsCandidateAcceptable(int index, std::vector<ShapeCandidate* >& candidates);
-        static void RemoveAcceptableCandidate(std::vector<ShapeCandidate* >& candidates, const std::vector<int>& res);
+            std::vector<double>& featureScores, std::vector<int>& sampleIndex, PrimitiveDetectionContext* pContext);
+        static bool IsCandidateAcceptable(int index, std::vector<ShapeCandidate* >& candidates, PrimitiveDetectionContext* pContext);
+        static void RemoveAcceptableCandidate(std::vector<ShapeCandidate* >& candidates, const std::vector<int>& res, PrimitiveDetectionContext* pContext);
         static void ChosePotentials(std::vector<ShapeCandidate* >& candidates, std::vector<int>& potentials);
         static int ChoseBestCandidate(std::vector<ShapeCandidate* >& candidates);
-        static bool UpdateAcceptableArea(Mesh3D* pMesh, std::vector<int>& res);
-        static bool UpdateAcceptableAreaEnhance(Mesh3D* pMesh, std::vector<int>& res, double acceptScale);
-        static bool UpdateAcceptableScore(Mesh3D* pMesh, std::vector<int>& res, double scoreScale);
+        static bool UpdateAcceptableArea(Mesh3D* pMesh, std::vector<int>& res, PrimitiveDetectionContext* pContext);
+        static bool UpdateAcceptableAreaEnhance(Mesh3D* pMesh, std::vector<int>& res, double acceptScale, PrimitiveDetectionContext* pContext);
+        static bool UpdateAcceptableScore(Mesh3D* pMesh, std::vector<int>& res, double scoreScale, PrimitiveDetectionContext* pContext);
         static void CalFeatureBoundary(Mesh3D* pMesh, std::vector<int>& features);
         static void CalFeatureScore(Mesh3D* pMesh, std::vector<int>& features, std::vector<double>& scores);
         static void CalScaleGradient(std::vector<double>& scaleField, std::vector<MagicMath::Vector3>& gradientField, 
             const MagicDGP::Mesh3D* pMesh);
         static void CalFeatureScoreByGradient(Mesh3D* pMesh, std::vector<int>& features, std::vector<double>& scores);
         static int RefitPotentials(std::vector<ShapeCandidate* >& candidates, std::vector<int>& potentials, std::map<double, int>& refitedPotentials,
-            Mesh3D* pMesh, std::vector<int>& resFlag, std::vector<double>& vertWeightList);
+            Mesh3D* pMesh, std::vector<int>& resFlag, std::vector<double>& vertWeightList, PrimitiveDetectionContext* pContext);
     };
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "Eigen/Dense"
 //#include "../Common/RenderSystem.h"
 #include "../Common/ToolKit.h"
+#include "../Common/Profiler.h"
 #include "Tool/LogSystem.h"
 
 namespace MagicDGP
@@ -29,6 +30,7 @@ namespace MagicDGP
 
     void Registration::ICPRegistrate(const Point3DSet* pRef, Point3DSet* pOrigin, const MagicMath::HomoMatrix4* pTransInit, MagicMath::HomoMatrix4* pTransRes)
     {
+        PROFILE_ZONE("ICP::Registrate");
         int iterNum = 10;
         *pTransRes = *pTransInit;
         //MagicCore::RenderSystem::GetSingleton()->RenderPoint3DSet("newPC", "SimplePoint_Green", pOrigin, *pTransRes);
@@ -38,11 +40,11 @@ namespace MagicDGP
         ICPSamplePoint(pOrigin, sampleIndex);
         for (int k = 0; k < iterNum; k++)
         {
-            float timeCorres = MagicCore::ToolKit::GetTime();
+            double timeCorres = MagicCore::ToolKit::GetTime();
             std::vector<int> correspondIndex;
             ICPFindCorrespondance(pRef, pOrigin, pTransRes, sampleIndex, correspondIndex);
             DebugLog << "        ICPCorres: " << MagicCore::ToolKit::GetTime() - timeCorres << std::endl;
-            float timeMinimize = MagicCore::ToolKit::GetTime();
+            double timeMinimize = MagicCore::ToolKit::GetTime();
             MagicMath::HomoMatrix4 transDelta;
             ICPEnergyMinimization(pRef, pOrigin, pTransRes, sampleIndex, correspondIndex, &transDelta);
             DebugLog << "        ICPMinimize: " << MagicCore::ToolKit::GetTime() - timeMinimize << std::endl;
@@ -71,6 +73,7 @@ namespace MagicDGP
 
     void Registration::ICPSamplePoint(const Point3DSet* pPC, std::vector<int>& sampleIndex)
     {
+        PROFILE_ZONE("ICP::SamplePoint");
         //DebugLog << "Registration::ICPSamplePoint" << std::endl;
         int pcNum = pPC->GetPointNumber();
         static int startIndex = 0;
@@ -129,7 +132,8 @@ namespace MagicDGP
 
     void Registration::ICPInitRefData(const Point3DSet* pRef)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("ICP::InitRefData");
+        double timeStart = MagicCore::ToolKit::GetTime();
         int dim = 3;
         int refNum = pRef->GetPointNumber();
         mDataSet = new float[refNum * dim];
@@ -153,6 +157,7 @@ namespace MagicDGP
     void Registration::ICPFindCorrespondance(const Point3DSet* pRef, const Point3DSet* pOrigin, const MagicMath::HomoMatrix4* pTransInit,
             std::vector<int>& sampleIndex,  std::vector<int>& correspondIndex)
     {
+        PROFILE_ZONE("ICP::Correspondence");
         //DebugLog << "Registration::ICPFindCorrespondance" << std::endl;
         //float timeStart = MagicCore::ToolKit::GetTime();
         /*int dim = 3;
@@ -224,6 +229,7 @@ namespace MagicDGP
     void Registration::ICPEnergyMinimization(const Point3DSet* pRef, const Point3DSet* pOrigin, const MagicMath::HomoMatrix4* pTransInit, 
             std::vector<int>& sampleIndex, std::vector<int>& correspondIndex, MagicMath::HomoMatrix4* pTransDelta)
     {
+        PROFILE_ZONE("ICP::EnergyMinimization");
         //DebugLog << "Registration::ICPEnergyMinimization" << std::endl;
         int pcNum = sampleIndex.size();
         Eigen::MatrixXd matA(pcNum, 6);
@@ -262,187 +268,4 @@ namespace MagicDGP
         DebugLog << res(2) << " " << 1 << " " << -res(0) << " " << res(4) << std::endl;
         DebugLog << -res(1) << " " << res(0) << " " << 1 << " " << res(5) << std::endl;*/
     }
-
-    void Registration::ICPRegistrateEnhance(const Point3DSet* pRefPC, Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit, MagicMath::HomoMatrix4* pTransRes, openni::VideoStream& depthStream)
-    {
-        int iterNum = 10;
-        *pTransRes = *pTransInit;
-        for (int k = 0; k < iterNum; k++)
-        {
-            std::vector<int> sampleIndex;
-            ICPSamplePointEnhance(pRefPC, sampleIndex, pTransRes, depthStream);
-            DebugLog << "        ICPSamplePointEnhance" << std::endl;
-            float timeCorres = MagicCore::ToolKit::GetTime();
-            std::vector<int> correspondIndex;
-            ICPFindCorrespondanceEnhance(pRefPC, pNewPC, pTransRes, sampleIndex, correspondIndex, depthStream);
-            DebugLog << "        ICPCorres: " << MagicCore::ToolKit::GetTime() - timeCorres << std::endl;
-            float timeMinimize = MagicCore::ToolKit::GetTime();
-            MagicMath::HomoMatrix4 transDelta;
-            ICPEnergyMinimizationEnhance(pRefPC, pNewPC, pTransRes, sampleIndex, correspondIndex, &transDelta);
-            DebugLog << "        ICPMinimize: " << MagicCore::ToolKit::GetTime() - timeMinimize << std::endl;
-            *pTransRes = transDelta * (*pTransRes);
-            //MagicCore::RenderSystem::GetSingleton()->RenderPoint3DSet("newPC", "SimplePoint_Green", pOrigin, *pTransRes);
-            //MagicCore::RenderSystem::GetSingleton()->Update();
-            if (fabs(transDelta.GetValue(0, 3)) < 0.01f && 
-                fabs(transDelta.GetValue(1, 3)) < 0.01f && 
-                fabs(transDelta.GetValue(2, 3)) < 0.01f)
-            {
-                DebugLog << "ICP iterator number: " << k + 1 << std::endl;
-                break;
-            }
-        }
-    }
-
-    void Registration::ICPSamplePointEnhance(const Point3DSet* pPC, std::vector<int>& sampleIndex, const MagicMath::HomoMatrix4* pTransform, openni::VideoStream& depthStream)
-    {
-        std::vector<openni::DepthPixel> depthCache((mDepthResolutionX + 1) * (mDepthResolutionY + 1), 0);
-        int pcNum = pPC->GetPointNumber();
-        for (int i = 0; i < pcNum; i++)
-        {
-            MagicMath::Vector3 pos = pTransform->TransformPoint( pPC->GetPoint(i)->GetPosition() );
-            int depthX, depthY;
-            openni::DepthPixel depthZ;
-            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
-            if (res != openni::STATUS_OK)
-            {
-                DebugLog << "        res != openni::STATUS_OK: " << res << std::endl;
-                continue;
-            }
-            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
-            {
-                continue;
-            }
-            //DebugLog << "depth: " << depthX << " " << depthY << " " << depthZ << std::endl;
-            if (depthCache.at(depthX * mDepthResolutionY + depthY) == 0)
-            {
-                depthCache.at(depthX * mDepthResolutionY + depthY) = depthZ;
-            }
-            else if (depthCache.at(depthX * mDepthResolutionY + depthY) > depthZ)
-            {
-                depthCache.at(depthX * mDepthResolutionY + depthY) = depthZ;
-            }
-        }
-        for (int i = 0; i < pcNum; i++)
-        {
-            MagicMath::Vector3 pos = pTransform->TransformPoint( pPC->GetPoint(i)->GetPosition() );
-            int depthX, depthY;
-            openni::DepthPixel depthZ;
-            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
-            if (res != openni::STATUS_OK)
-            {
-                DebugLog << "        res != openni::STATUS_OK: " << res << std::endl;
-                continue;
-            }
-            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
-            {
-                continue;
-            }
-            if (depthCache.at(depthX * mDepthResolutionY + depthY) == depthZ)
-            {
-                sampleIndex.push_back(i);
-            }
-        }
-    }
-
-    void Registration::ICPFindCorrespondanceEnhance(const Point3DSet* pRefPC, const Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit,
-            std::vector<int>& sampleIndex,  std::vector<int>& correspondIndex, openni::VideoStream& depthStream)
-    {
-        std::map<int, int> depthMap;
-        for (int i = 0; i < sampleIndex.size(); i++)
-        {
-            MagicMath::Vector3 pos = pTransInit->TransformPoint( pRefPC->GetPoint(sampleIndex.at(i))->GetPosition() );
-            int depthX, depthY;
-            openni::DepthPixel depthZ;
-            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
-            if (res != openni::STATUS_OK)
-            {
-                continue;
-            }
-            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
-            {
-                continue;
-            }
-            depthMap[depthX * mDepthResolutionY + depthY] = sampleIndex.at(i);
-        }
-        std::vector<int> newSampleIndex;
-        correspondIndex.clear();
-        float distThre = 500.f;
-        float norThre = 0.1f; //cos(85);
-        for (int i = 0; i < pNewPC->GetPointNumber(); i++)
-        {
-            MagicMath::Vector3 pos = pNewPC->GetPoint(i)->GetPosition();
-            MagicMath::Vector3 nor = pNewPC->GetPoint(i)->GetNormal();
-            int depthX, depthY;
-            openni::DepthPixel depthZ;
-            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
-            if (res != openni::STATUS_OK)
-            {
-                continue;
-            }
-            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
-            {
-                continue;
-            }
-            if (depthMap[depthX * mDepthResolutionY + depthY] != 0)
-            {
-                //reject too long correspond 
-                MagicMath::Vector3 posCorres = pTransInit->TransformPoint( pRefPC->GetPoint(depthMap[depthX * mDepthResolutionY + depthY])->GetPosition() );            
-                if ( (posCorres - pos).Length() > distThre )
-                {
-                    continue;
-                }
-                MagicMath::Vector3 norCorres = pTransInit->RotateVector( pRefPC->GetPoint(depthMap[depthX * mDepthResolutionY + depthY])->GetNormal() );
-                float norDist = nor * norCorres;
-                if (norDist < norThre || norDist > 1.0)
-                {
-                    continue;
-                }
-                newSampleIndex.push_back(depthMap[depthX * mDepthResolutionY + depthY]);
-                correspondIndex.push_back(i);
-            }
-        }
-        sampleIndex = newSampleIndex;
-        DebugLog << "    sample number: " << sampleIndex.size() << std::endl;
-    }
-
-    void Registration::ICPEnergyMinimizationEnhance(const Point3DSet* pRefPC, const Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit,
-            std::vector<int>& sampleIndex, std::vector<int>& correspondIndex, MagicMath::HomoMatrix4* pTransDelta)
-    {
-        int pcNum = sampleIndex.size();
-        Eigen::MatrixXd matA(pcNum, 6);
-        Eigen::VectorXd vecB(pcNum, 1);
-        for (int i = 0; i < pcNum; i++)
-        {
-            /*MagicMath::Vector3 norRef = pRef->GetPoint(correspondIndex.at(i))->GetNormal();
-            MagicMath::Vector3 posRef = pRef->GetPoint(correspondIndex.at(i))->GetPosition();
-            MagicMath::Vector3 posPC  = pTransInit->TransformPoint( pOrigin->GetPoint(sampleIndex.at(i))->GetPosition() );
-            vecB(i) = (posRef - posPC) * norRef;
-            MagicMath::Vector3 coffTemp = posPC.CrossProduct(norRef);*/
-            MagicMath::Vector3 norRef = pNewPC->GetPoint(correspondIndex.at(i))->GetNormal();
-            MagicMath::Vector3 posRef = pNewPC->GetPoint(correspondIndex.at(i))->GetPosition();
-            MagicMath::Vector3 posPC  = pTransInit->TransformPoint( pRefPC->GetPoint(sampleIndex.at(i))->GetPosition() );
-            vecB(i) = (posRef - posPC) * norRef;
-            MagicMath::Vector3 coffTemp = posPC.CrossProduct(norRef);
-            matA(i, 0) = coffTemp[0];
-            matA(i, 1) = coffTemp[1];
-            matA(i, 2) = coffTemp[2];
-            matA(i, 3) = norRef[0];
-            matA(i, 4) = norRef[1];
-            matA(i, 5) = norRef[2];
-        }
-        Eigen::MatrixXd matAT = matA.transpose();
-        Eigen::MatrixXd matCoefA = matAT * matA;
-        Eigen::MatrixXd vecCoefB = matAT * vecB;
-        Eigen::VectorXd res = matCoefA.ldlt().solve(vecCoefB);
-        pTransDelta->Unit();
-        pTransDelta->SetValue(0, 1, -res(2));
-        pTransDelta->SetValue(0, 2, res(1));
-        pTransDelta->SetValue(0, 3, res(3));
-        pTransDelta->SetValue(1, 0, res(2));
-        pTransDelta->SetValue(1, 2, -res(0));
-        pTransDelta->SetValue(1, 3, res(4));
-        pTransDelta->SetValue(2, 0, -res(1));
-        pTransDelta->SetValue(2, 1, res(0));
-        pTransDelta->SetValue(2, 3, res(5));
-    }
 }
@@ -3,7 +3,11 @@
 #include <vector>
 #include "Math/HomoMatrix4.h"
 #include "flann/flann.h"
-#include "OpenNI.h"
+
+namespace openni
+{
+    class VideoStream;
+}
 
 namespace MagicDGP
 {
@@ -15,6 +19,7 @@ namespace MagicDGP
 
     public:
         void ICPRegistrate(const Point3DSet* pRef, Point3DSet* pOrigin, const MagicMath::HomoMatrix4* pTransInit, MagicMath::HomoMatrix4* pTransRes);
+        //In RegistrationEnhance.cpp, which needs OpenNI
         void ICPRegistrateEnhance(const Point3DSet* pRefPC, Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit, MagicMath::HomoMatrix4* pTransRes, openni::VideoStream& depthStream);
 
     private:
@@ -0,0 +1,198 @@
+#include "Registration.h"
+#include "Eigen/Dense"
+#include "OpenNI.h"
+#include "../Common/ToolKit.h"
+#include "../Common/Profiler.h"
+#include "Tool/LogSystem.h"
+#include <map>
+
+//ICP of the scanner frames, the correspondences are found by projection to the depth image of OpenNI
+namespace MagicDGP
+{
+    void Registration::ICPRegistrateEnhance(const Point3DSet* pRefPC, Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit, MagicMath::HomoMatrix4* pTransRes, openni::VideoStream& depthStream)
+    {
+        PROFILE_ZONE("ICP::RegistrateEnhance");
+        int iterNum = 10;
+        *pTransRes = *pTransInit;
+        for (int k = 0; k < iterNum; k++)
+        {
+            std::vector<int> sampleIndex;
+            ICPSamplePointEnhance(pRefPC, sampleIndex, pTransRes, depthStream);
+            DebugLog << "        ICPSamplePointEnhance" << std::endl;
+            double timeCorres = MagicCore::ToolKit::GetTime();
+            std::vector<int> correspondIndex;
+            ICPFindCorrespondanceEnhance(pRefPC, pNewPC, pTransRes, sampleIndex, correspondIndex, depthStream);
+            DebugLog << "        ICPCorres: " << MagicCore::ToolKit::GetTime() - timeCorres << std::endl;
+            double timeMinimize = MagicCore::ToolKit::GetTime();
+            MagicMath::HomoMatrix4 transDelta;
+            ICPEnergyMinimizationEnhance(pRefPC, pNewPC, pTransRes, sampleIndex, correspondIndex, &transDelta);
+            DebugLog << "        ICPMinimize: " << MagicCore::ToolKit::GetTime() - timeMinimize << std::endl;
+            *pTransRes = transDelta * (*pTransRes);
+            //MagicCore::RenderSystem::GetSingleton()->RenderPoint3DSet("newPC", "SimplePoint_Green", pOrigin, *pTransRes);
+            //MagicCore::RenderSystem::GetSingleton()->Update();
+            if (fabs(transDelta.GetValue(0, 3)) < 0.01f && 
+                fabs(transDelta.GetValue(1, 3)) < 0.01f && 
+                fabs(transDelta.GetValue(2, 3)) < 0.01f)
+            {
+                DebugLog << "ICP iterator number: " << k + 1 << std::endl;
+                break;
+            }
+        }
+    }
+
+    void Registration::ICPSamplePointEnhance(const Point3DSet* pPC, std::vector<int>& sampleIndex, const MagicMath::HomoMatrix4* pTransform, openni::VideoStream& depthStream)
+    {
+        PROFILE_ZONE("ICP::SamplePointEnhance");
+        std::vector<openni::DepthPixel> depthCache((mDepthResolutionX + 1) * (mDepthResolutionY + 1), 0);
+        int pcNum = pPC->GetPointNumber();
+        for (int i = 0; i < pcNum; i++)
+        {
+            MagicMath::Vector3 pos = pTransform->TransformPoint( pPC->GetPoint(i)->GetPosition() );
+            int depthX, depthY;
+            openni::DepthPixel depthZ;
+            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
+            if (res != openni::STATUS_OK)
+            {
+                DebugLog << "        res != openni::STATUS_OK: " << res << std::endl;
+                continue;
+            }
+            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
+            {
+                continue;
+            }
+            //DebugLog << "depth: " << depthX << " " << depthY << " " << depthZ << std::endl;
+            if (depthCache.at(depthX * mDepthResolutionY + depthY) == 0)
+            {
+                depthCache.at(depthX * mDepthResolutionY + depthY) = depthZ;
+            }
+            else if (depthCache.at(depthX * mDepthResolutionY + depthY) > depthZ)
+            {
+                depthCache.at(depthX * mDepthResolutionY + depthY) = depthZ;
+            }
+        }
+        for (int i = 0; i < pcNum; i++)
+        {
+            MagicMath::Vector3 pos = pTransform->TransformPoint( pPC->GetPoint(i)->GetPosition() );
+            int depthX, depthY;
+            openni::DepthPixel depthZ;
+            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
+            if (res != openni::STATUS_OK)
+            {
+                DebugLog << "        res != openni::STATUS_OK: " << res << std::endl;
+                continue;
+            }
+            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
+            {
+                continue;
+            }
+            if (depthCache.at(depthX * mDepthResolutionY + depthY) == depthZ)
+            {
+                sampleIndex.push_back(i);
+            }
+        }
+    }
+
+    void Registration::ICPFindCorrespondanceEnhance(const Point3DSet* pRefPC, const Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit,
+            std::vector<int>& sampleIndex,  std::vector<int>& correspondIndex, openni::VideoStream& depthStream)
+    {
+        PROFILE_ZONE("ICP::CorrespondenceEnhance");
+        std::map<int, int> depthMap;
+        for (int i = 0; i < sampleIndex.size(); i++)
+        {
+            MagicMath::Vector3 pos = pTransInit->TransformPoint( pRefPC->GetPoint(sampleIndex.at(i))->GetPosition() );
+            int depthX, depthY;
+            openni::DepthPixel depthZ;
+            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
+            if (res != openni::STATUS_OK)
+            {
+                continue;
+            }
+            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
+            {
+                continue;
+            }
+            depthMap[depthX * mDepthResolutionY + depthY] = sampleIndex.at(i);
+        }
+        std::vector<int> newSampleIndex;
+        correspondIndex.clear();
+        float distThre = 500.f;
+        float norThre = 0.1f; //cos(85);
+        for (int i = 0; i < pNewPC->GetPointNumber(); i++)
+        {
+            MagicMath::Vector3 pos = pNewPC->GetPoint(i)->GetPosition();
+            MagicMath::Vector3 nor = pNewPC->GetPoint(i)->GetNormal();
+            int depthX, depthY;
+            openni::DepthPixel depthZ;
+            openni::Status res = openni::CoordinateConverter::convertWorldToDepth(depthStream, pos[0], pos[1], pos[2], &depthX, &depthY, &depthZ);
+            if (res != openni::STATUS_OK)
+            {
+                continue;
+            }
+            if (depthX > mDepthResolutionX || depthX < 0 || depthY > mDepthResolutionY || depthY < 0)
+            {
+                continue;
+            }
+            if (depthMap[depthX * mDepthResolutionY + depthY] != 0)
+            {
+                //reject too long correspond 
+                MagicMath::Vector3 posCorres = pTransInit->TransformPoint( pRefPC->GetPoint(depthMap[depthX * mDepthResolutionY + depthY])->GetPosition() );            
+                if ( (posCorres - pos).Length() > distThre )
+                {
+                    continue;
+                }
+                MagicMath::Vector3 norCorres = pTransInit->RotateVector( pRefPC->GetPoint(depthMap[depthX * mDepthResolutionY + depthY])->GetNormal() );
+                float norDist = nor * norCorres;
+                if (norDist < norThre || norDist > 1.0)
+                {
+                    continue;
+                }
+                newSampleIndex.push_back(depthMap[depthX * mDepthResolutionY + depthY]);
+                correspondIndex.push_back(i);
+            }
+        }
+        sampleIndex = newSampleIndex;
+        DebugLog << "    sample number: " << sampleIndex.size() << std::endl;
+    }
+
+    void Registration::ICPEnergyMinimizationEnhance(const Point3DSet* pRefPC, const Point3DSet* pNewPC, const MagicMath::HomoMatrix4* pTransInit,
+            std::vector<int>& sampleIndex, std::vector<int>& correspondIndex, MagicMath::HomoMatrix4* pTransDelta)
+    {
+        PROFILE_ZONE("ICP::EnergyMinimizationEnhance");
+        int pcNum = sampleIndex.size();
+        Eigen::MatrixXd matA(pcNum, 6);
+        Eigen::VectorXd vecB(pcNum, 1);
+        for (int i = 0; i < pcNum; i++)
+        {
+            /*MagicMath::Vector3 norRef = pRef->GetPoint(correspondIndex.at(i))->GetNormal();
+            MagicMath::Vector3 posRef = pRef->GetPoint(correspondIndex.at(i))->GetPosition();
+            MagicMath::Vector3 posPC  = pTransInit->TransformPoint( pOrigin->GetPoint(sampleIndex.at(i))->GetPosition() );
+            vecB(i) = (posRef - posPC) * norRef;
+            MagicMath::Vector3 coffTemp = posPC.CrossProduct(norRef);*/
+            MagicMath::Vector3 norRef = pNewPC->GetPoint(correspondIndex.at(i))->GetNormal();
+            MagicMath::Vector3 posRef = pNewPC->GetPoint(correspondIndex.at(i))->GetPosition();
+            MagicMath::Vector3 posPC  = pTransInit->TransformPoint( pRefPC->GetPoint(sampleIndex.at(i))->GetPosition() );
+            vecB(i) = (posRef - posPC) * norRef;
+            MagicMath::Vector3 coffTemp = posPC.CrossProduct(norRef);
+            matA(i, 0) = coffTemp[0];
+            matA(i, 1) = coffTemp[1];
+            matA(i, 2) = coffTemp[2];
+            matA(i, 3) = norRef[0];
+            matA(i, 4) = norRef[1];
+            matA(i, 5) = norRef[2];
+        }
+        Eigen::MatrixXd matAT = matA.transpose();
+        Eigen::MatrixXd matCoefA = matAT * matA;
+        Eigen::MatrixXd vecCoefB = matAT * vecB;
+        Eigen::VectorXd res = matCoefA.ldlt().solve(vecCoefB);
+        pTransDelta->Unit();
+        pTransDelta->SetValue(0, 1, -res(2));
+        pTransDelta->SetValue(0, 2, res(1));
+        pTransDelta->SetValue(0, 3, res(3));
+        pTransDelta->SetValue(1, 0, res(2));
+        pTransDelta->SetValue(1, 2, -res(0));
+        pTransDelta->SetValue(1, 3, res(4));
+        pTransDelta->SetValue(2, 0, -res(1));
+        pTransDelta->SetValue(2, 1, res(0));
+        pTransDelta->SetValue(2, 3, res(5));
+    }
+}
@@ -3,6 +3,7 @@
 #include "Eigen/Sparse"
 #include "Eigen/SparseLU"
 #include "../Common/ToolKit.h"
+#include "../Common/Profiler.h"
 #include "Tool/LogSystem.h"
 
 namespace MagicDGP
@@ -17,6 +18,7 @@ namespace MagicDGP
 
     LightMesh3D* ReliefGeneration::PlaneReliefFromHeightField(std::vector<double>& heightField, int resX, int resY)
     {
+        PROFILE_ZONE("Relief::PlaneFromHeightField");
         CompressHeightField(heightField, resX, resY);
         //Generate relief mesh
         double minX = -1.0;
@@ -158,6 +160,7 @@ namespace MagicDGP
 
     LightMesh3D* ReliefGeneration::CylinderReliefFromHeightField(std::vector<double>& heightField, int resX, int resY)
     {
+        PROFILE_ZONE("Relief::CylinderFromHeightField");
         CompressHeightField(heightField, resX, resY);
         //Generate relief mesh
         double minX = -1.0;
@@ -212,6 +215,7 @@ namespace MagicDGP
 
     void ReliefGeneration::CompressHeightField(std::vector<double>& heightField, int resX, int resY)
     {
+        PROFILE_ZONE("Relief::CompressHeightField");
         double bbScale = 2;
         double alpha = bbScale * 300.0;
         double threthold = bbScale * 0.05;
@@ -1,11 +1,20 @@
 #include "Sampling.h"
 #include "Tool/LogSystem.h"
+#include "../Common/AsyncLog.h"
 #include "../Common/ToolKit.h"
-#include "flann/flann.h"
+#include "../Common/Parallel.h"
+#include "../Common/Profiler.h"
+#include "SpatialIndex.h"
+#include "UniformGrid.h"
 #include "Eigen/Eigenvalues"
-#include <map>
 #include <vector>
 
+namespace
+{
+    //One per degenerate point neighborhood
+    MagicCore::AsyncLogSite gSmallNormalLogSite(10, 10000);
+}
+
 namespace MagicDGP
 {
     Sampling::Sampling()
@@ -18,6 +27,7 @@ namespace MagicDGP
 
     Point3DSet* Sampling::PointSetWLOPSampling(const Point3DSet* pPS, int sampleNum)
     {
+        PROFILE_ZONE("Sampling::WLOP");
         DebugLog << "Begin Sampling::PointSetWLOPSampling" << std::endl;
         std::vector<MagicMath::Vector3> samplePosList;
         InitialSampling(pPS, sampleNum, samplePosList);
@@ -34,8 +44,7 @@ namespace MagicDGP
         Point3DSet* pNewPS = new Point3DSet;
         for (int i = 0; i < sampleNum; i++)
         {
-            Point3D* pPoint = new Point3D(samplePosList.at(i), norList.at(i));
-            pNewPS->InsertPoint(pPoint);
+            pNewPS->InsertPoint(samplePosList.at(i), norList.at(i));
         }
         return pNewPS;
     }
@@ -61,7 +70,8 @@ namespace MagicDGP
 
     void Sampling::WLOPIteration(const Point3DSet* pPS, std::vector<MagicMath::Vector3> & samplePosList)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("Sampling::WLOPIteration");
+        double timeStart = MagicCore::ToolKit::GetTime();
         DebugLog << "Begin Sampling::WLOPIteration" << std::endl;
         int iNum = samplePosList.size();
         int jNum = pPS->GetPointNumber();
@@ -83,108 +93,93 @@ namespace MagicDGP
         double supportSize = pPS->GetDensity() * 500;
         double thetaScale = 100 / supportSize / supportSize;
         DebugLog << "Density: " << pPS->GetDensity() << " supportSize: " << supportSize << " thetaScale: " << thetaScale << std::endl; 
-        MagicMath::Vector3 deltaBBox = bboxMax - bboxMin;
-        int resolutionX = int(deltaBBox[0] / supportSize) + 1;
-        int resolutionY = int(deltaBBox[1] / supportSize) + 1;
-        int resolutionZ = int(deltaBBox[2] / supportSize) + 1;
-        int resolutionYZ = resolutionY * resolutionZ;
-        std::map<int, std::vector<int> > pcIndexMap;
-
-        //construct pcIndexMap
-        for (int pcIndex = 0; pcIndex < jNum; pcIndex++)
-        {
-            MagicMath::Vector3 deltaPos = pPS->GetPoint(pcIndex)->GetPosition() - bboxMin;
-            int index = int(deltaPos[0] / supportSize) * resolutionYZ + int(deltaPos[1] / supportSize) * resolutionZ + int(deltaPos[2] / supportSize);
-            pcIndexMap[index].push_back(pcIndex);
-        }
+        UniformGrid pcGrid;
+        pcGrid.Build(pPS, supportSize);
+        UniformGrid sampleGrid;
         DebugLog << "Iteration prepare time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
         for (int kk = 0; kk < iterNum; kk++)
         {
-            float iterateTimeStart = MagicCore::ToolKit::GetTime();
-            //construct sampleIndexMap
-            std::map<int, std::vector<int> > sampleIndexMap;
-            for (int sampleIndex = 0; sampleIndex < iNum; sampleIndex++)
-            {
-                MagicMath::Vector3 deltaPos = samplePosList.at(sampleIndex) - bboxMin;
-                int index = int(deltaPos[0] / supportSize) * resolutionYZ + int(deltaPos[1] / supportSize) * resolutionZ + int(deltaPos[2] / supportSize);
-                sampleIndexMap[index].push_back(sampleIndex);
-            }
+            double iterateTimeStart = MagicCore::ToolKit::GetTime();
+            sampleGrid.Build(samplePosList, bboxMin, bboxMax, pcGrid.GetCellSize());
             
             std::vector<MagicMath::Vector3> samplePosBak = samplePosList;
-            for (int i = 0; i < iNum; i++)
+            //Every sample reads the positions of the last iteration and writes its own position
+            MagicCore::ParallelFor(0, iNum, [&](int startIndex, int endIndex)
             {
-                MagicMath::Vector3 samplePosI = samplePosBak.at(i); 
-                MagicMath::Vector3 sampleDeltaPos = samplePosI - bboxMin;
-                int xIndex = sampleDeltaPos[0] / supportSize;
-                int yIndex = sampleDeltaPos[1] / supportSize;
-                int zIndex = sampleDeltaPos[2] / supportSize;
-                MagicMath::Vector3 posRes1(0, 0, 0);
-                double alphaSum = 0;
-                MagicMath::Vector3 posRes2(0, 0, 0);
-                double betaSum = 0;
-                for (int xx = -1; xx <= 1; xx++)
+                for (int i = startIndex; i < endIndex; i++)
                 {
-                    for (int yy = -1; yy <= 1; yy++)
+                    MagicMath::Vector3 samplePosI = samplePosBak.at(i); 
+                    int xIndex, yIndex, zIndex;
+                    pcGrid.GetCellCoord(samplePosI, xIndex, yIndex, zIndex);
+                    MagicMath::Vector3 posRes1(0, 0, 0);
+                    double alphaSum = 0;
+                    MagicMath::Vector3 posRes2(0, 0, 0);
+                    double betaSum = 0;
+                    for (int xx = -1; xx <= 1; xx++)
                     {
-                        for (int zz = -1; zz <= 1; zz++)
+                        for (int yy = -1; yy <= 1; yy++)
                         {
-                            int blockIndex = (xIndex + xx) * resolutionYZ + (yIndex + yy) * resolutionZ + zIndex + zz;
-
-                            int blockSize = pcIndexMap[blockIndex].size();
-                            for (int mapIndex = 0; mapIndex < blockSize; mapIndex++)
+                            for (int zz = -1; zz <= 1; zz++)
                             {
-                                int pointIndex = pcIndexMap[blockIndex].at(mapIndex);
-                                MagicMath::Vector3 psPos = pPS->GetPoint(pointIndex)->GetPosition();
-                                MagicMath::Vector3 deltaPos = samplePosI - psPos;
-                                double deltaLen = deltaPos.Length();
-                                if (deltaLen < smallValue)
+                                int blockIndex = pcGrid.GetCellIndex(xIndex + xx, yIndex + yy, zIndex + zz);
+                                if (blockIndex == -1)
                                 {
-                                    deltaLen = smallValue;
+                                    continue;
                                 }
-                                //double alpha = exp(-thetaScale * deltaLen * deltaLen) / deltaLen;
-                                double rTemp = thetaScale * deltaLen * deltaLen;
-                                double alpha = 1 / deltaLen / (1 + rTemp + rTemp * rTemp);
-                                posRes1 += psPos * alpha;
-                                alphaSum += alpha;
-                            }
 
-                            blockSize = sampleIndexMap[blockIndex].size();
-                            for (int mapIndex = 0; mapIndex < blockSize; mapIndex++)
-                            {
-                                int pointIndex = sampleIndexMap[blockIndex].at(mapIndex);
-                                if (pointIndex == i)
+                                int blockEnd = pcGrid.GetCellStart(blockIndex + 1);
+                                for (int sortedIndex = pcGrid.GetCellStart(blockIndex); sortedIndex < blockEnd; sortedIndex++)
                                 {
-                                    continue;
+                                    const MagicMath::Vector3& psPos = pcGrid.GetSortedPosition(sortedIndex);
+                                    MagicMath::Vector3 deltaPos = samplePosI - psPos;
+                                    double deltaLen = deltaPos.Length();
+                                    if (deltaLen < smallValue)
+                                    {
+                                        deltaLen = smallValue;
+                                    }
+                                    //double alpha = exp(-thetaScale * deltaLen * deltaLen) / deltaLen;
+                                    double rTemp = thetaScale * deltaLen * deltaLen;
+                                    double alpha = 1 / deltaLen / (1 + rTemp + rTemp * rTemp);
+                                    posRes1 += psPos * alpha;
+                                    alphaSum += alpha;
                                 }
-                                MagicMath::Vector3 psPos = samplePosBak.at(pointIndex);
-                                MagicMath::Vector3 deltaPos = samplePosI - psPos;
-                                double deltaLen = deltaPos.Length();
-                                if (deltaLen < smallValue)
+
+                                blockEnd = sampleGrid.GetCellStart(blockIndex + 1);
+                                for (int sortedIndex = sampleGrid.GetCellStart(blockIndex); sortedIndex < blockEnd; sortedIndex++)
                                 {
-                                    deltaLen = smallValue;
+                                    if (sampleGrid.GetSortedIndex(sortedIndex) == i)
+                                    {
+                                        continue;
+                                    }
+                                    const MagicMath::Vector3& psPos = sampleGrid.GetSortedPosition(sortedIndex);
+                                    MagicMath::Vector3 deltaPos = samplePosI - psPos;
+                                    double deltaLen = deltaPos.Length();
+                                    if (deltaLen < smallValue)
+                                    {
+                                        deltaLen = smallValue;
+                                    }
+                                    //double beta = -exp(-thetaScale * deltaLen * deltaLen) / deltaLen;
+                                    double rTemp = thetaScale * deltaLen * deltaLen;
+                                    double beta = -1 / deltaLen / (1 + rTemp + rTemp * rTemp);
+                                    posRes2 += (samplePosI - psPos) * beta;
+                                    betaSum += beta;
                                 }
-                                //double beta = -exp(-thetaScale * deltaLen * deltaLen) / deltaLen;
-                                double rTemp = thetaScale * deltaLen * deltaLen;
-                                double beta = -1 / deltaLen / (1 + rTemp + rTemp * rTemp);
-                                posRes2 += (samplePosI - psPos) * beta;
-                                betaSum += beta;
                             }
                         }
+                    }//end for xx
+                    if (alphaSum < smallValue)
+                    {
+                        alphaSum = smallValue;
                     }
-                }//end for xx
-                if (alphaSum < smallValue)
-                {
-                    alphaSum = smallValue;
-                }
-                posRes1 /= alphaSum;
-                if (betaSum > -smallValue)
-                {
-                    betaSum = -smallValue;
-                }
-                posRes2 /= betaSum;
-                samplePosList.at(i) = posRes1 + posRes2 * mu;
-
-            } //end for i
+                    posRes1 /= alphaSum;
+                    if (betaSum > -smallValue)
+                    {
+                        betaSum = -smallValue;
+                    }
+                    posRes2 /= betaSum;
+                    samplePosList.at(i) = posRes1 + posRes2 * mu;
+                } //end for i
+            });
 
             DebugLog << "WLOPIteration: " << kk << " time: " << MagicCore::ToolKit::GetTime() - iterateTimeStart << std::endl;
         }//end for k
@@ -194,42 +189,18 @@ namespace MagicDGP
 
     void Sampling::LocalPCANormalEstimate(const std::vector<MagicMath::Vector3>& samplePosList, std::vector<MagicMath::Vector3>& norList)
     {
-        float startTime = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("Sampling::LocalPCANormalEstimate");
+        double startTime = MagicCore::ToolKit::GetTime();
 
         int pointNum = samplePosList.size();
         norList.clear();
         norList.reserve(pointNum);
 
-        int dim = 3;
-        int refNum = pointNum;
-        float* dataSet = new float[refNum * dim];
-        int searchNum = pointNum;
-        float* searchSet = new float[searchNum * dim];
-        for (int i = 0; i < pointNum; i++)
-        {
-            MagicMath::Vector3 pos = samplePosList.at(i);
-            dataSet[dim * i + 0] = pos[0];
-            dataSet[dim * i + 1] = pos[1];
-            dataSet[dim * i + 2] = pos[2];
-            searchSet[dim * i + 0] = pos[0];
-            searchSet[dim * i + 1] = pos[1];
-            searchSet[dim * i + 2] = pos[2];
-        }
         int nn = 20;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
+        SpatialIndex spatialIndex;
+        spatialIndex.Build(samplePosList);
+        spatialIndex.KnnSearchSelf(nn);
+        const int* pIndex = spatialIndex.GetIndexResult();
 
         DebugLog << "Sampling::LocalPCANormalEstimate, prepare time: " << MagicCore::ToolKit::GetTime() - startTime << std::endl;
 
@@ -262,7 +233,7 @@ namespace MagicDGP
             double norLen = nor.Normalise();
             if (norLen < 1.0e-15)
             {
-                DebugLog << "Error: small normal length" << std::endl;
+                AsyncDebugLogSite(gSmallNormalLogSite) << "Error: small normal length" << std::endl;
             }
             norList.push_back(nor);
         }
@@ -295,57 +266,20 @@ namespace MagicDGP
         //    }// end for spreadSet
         //    spreadSet = spreadSetNext;
         //}
-        if (pIndex != NULL)
-        {
-            delete []pIndex;
-            pIndex = NULL;
-        }
-        if (pDist != NULL)
-        {
-            delete []pDist;
-            pDist = NULL;
-        }
         DebugLog << "Sampling::LocalPCANormalEstimate, total time: " << MagicCore::ToolKit::GetTime() - startTime << std::endl;
     }
 
     void Sampling::NormalConsistent(const Point3DSet* pPS, std::vector<MagicMath::Vector3>& samplePosList, std::vector<MagicMath::Vector3>& norList)
     {
-        float startTime = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("Sampling::NormalConsistent");
+        double startTime = MagicCore::ToolKit::GetTime();
 
-        int dim = 3;
-        int refNum = pPS->GetPointNumber();
-        float* dataSet = new float[refNum * dim];
-        for (int i = 0; i < refNum; i++)
-        {
-            MagicMath::Vector3 pos = pPS->GetPoint(i)->GetPosition();
-            dataSet[dim * i + 0] = pos[0];
-            dataSet[dim * i + 1] = pos[1];
-            dataSet[dim * i + 2] = pos[2];
-        }
         int searchNum = samplePosList.size();
-        float* searchSet = new float[searchNum * dim];
-        for (int i = 0; i < searchNum; i++)
-        {
-            MagicMath::Vector3 pos = samplePosList.at(i);
-            searchSet[dim * i + 0] = pos[0];
-            searchSet[dim * i + 1] = pos[1];
-            searchSet[dim * i + 2] = pos[2];
-        }
         int nn = 9;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
+        std::vector<int> indexList;
+        std::vector<float> distList;
+        pPS->GetSpatialIndex()->KnnSearch(samplePosList, nn, indexList, distList);
+        const int* pIndex = indexList.empty() ? NULL : &(indexList[0]);
 
         std::vector<MagicMath::Vector3> newPosList, newNorList;
         for (int i = 0; i < searchNum; i++)
@@ -373,67 +307,50 @@ namespace MagicDGP
         samplePosList = newPosList;
         norList = newNorList;
 
-        if (pIndex != NULL)
-        {
-            delete []pIndex;
-            pIndex = NULL;
-        }
-        if (pDist != NULL)
-        {
-            delete []pDist;
-            pDist = NULL;
-        }
         DebugLog << "Sampling::NormalConsistent, total time: " << MagicCore::ToolKit::GetTime() - startTime << std::endl;
     }
 
     void Sampling::NormalSmooth(std::vector<MagicMath::Vector3>& samplePosList, std::vector<MagicMath::Vector3>& norList)
     {
-        float startTime = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("Sampling::NormalSmooth");
+        double startTime = MagicCore::ToolKit::GetTime();
 
         int pointNum = samplePosList.size();
-        int dim = 3;
-        int refNum = pointNum;
-        float* dataSet = new float[refNum * dim];
-        int searchNum = pointNum;
-        float* searchSet = new float[searchNum * dim];
-        for (int i = 0; i < pointNum; i++)
+        int densityNN = 9;
+        if (pointNum <= densityNN)
         {
-            MagicMath::Vector3 pos = samplePosList.at(i);
-            dataSet[dim * i + 0] = pos[0];
-            dataSet[dim * i + 1] = pos[1];
-            dataSet[dim * i + 2] = pos[2];
-            searchSet[dim * i + 0] = pos[0];
-            searchSet[dim * i + 1] = pos[1];
-            searchSet[dim * i + 2] = pos[2];
+            return;
+        }
+        SpatialIndex spatialIndex;
+        spatialIndex.Build(samplePosList);
+        spatialIndex.KnnSearchSelf(densityNN);
+        const float* pDist = spatialIndex.GetDistResult();
+        double avgSpacing = 0;
+        for (int i = 0; i < pointNum * densityNN; i++)
+        {
+            avgSpacing += sqrt(pDist[i]);
         }
-        int nn = pointNum / 100;
-        int* pIndex = new int[searchNum * nn];
-        float* pDist = new float[searchNum * nn];
-        FLANNParameters searchPara;
-        searchPara = DEFAULT_FLANN_PARAMETERS;
-        searchPara.algorithm = FLANN_INDEX_KDTREE;
-        searchPara.trees = 8;
-        searchPara.log_level = FLANN_LOG_INFO;
-        searchPara.checks = 64;
-        float speedup;
-        flann_index_t indexId = flann_build_index(dataSet, refNum, dim, &speedup, &searchPara);
-        flann_find_nearest_neighbors_index(indexId, searchSet, searchNum, pIndex, pDist, nn, &searchPara);
-        flann_free_index(indexId, &searchPara);
-        delete []dataSet;
-        delete []searchSet;
-
-        int smoothNum = nn / 2;
+        avgSpacing /= (pointNum * densityNN);
+        //Neighborhood is a ball of several point spacings, capped to bound memory on large point sets
+        int maxNN = 64;
+        spatialIndex.RadiusSearchSelf(avgSpacing * 4, maxNN);
+        const int* pIndex = spatialIndex.GetIndexResult();
+        const int* pOffset = spatialIndex.GetOffsetResult();
+
+        //Voting rounds as before the radius neighborhood (half of pointNum / 100 neighbors). A round without
+        //flips is a fixed point, the rounds after it would not change any normal
+        int smoothNum = pointNum / 200;
         for (int k = 0; k < smoothNum; k++)
         {
             std::vector<MagicMath::Vector3> newNorList(pointNum);
+            int flipNum = 0;
             for (int i = 0; i < pointNum; i++)
             {
                 int avgFlag = 0;
                 MagicMath::Vector3 nor = norList.at(i);
-                int baseIndex = nn * i;
-                for (int j = 0; j < nn; j++)
+                for (int j = pOffset[i]; j < pOffset[i + 1]; j++)
                 {
-                    MagicMath::Vector3 norNeighbor = norList.at(pIndex[baseIndex + j]);
+                    MagicMath::Vector3 norNeighbor = norList.at(pIndex[j]);
                     if (norNeighbor * nor > 0)
                     {
                         avgFlag++;
@@ -446,6 +363,7 @@ namespace MagicDGP
                 if (avgFlag < 0)
                 {
                     newNorList.at(i) = norList.at(i) * (-1.f);
+                    flipNum++;
                 }
                 else
                 {
@@ -453,24 +371,19 @@ namespace MagicDGP
                 }
             }
             norList = newNorList;
+            if (flipNum == 0)
+            {
+                break;
+            }
         }
 
-        if (pIndex != NULL)
-        {
-            delete []pIndex;
-            pIndex = NULL;
-        }
-        if (pDist != NULL)
-        {
-            delete []pDist;
-            pDist = NULL;
-        }
         DebugLog << "Sampling::NormalSmooth: " << MagicCore::ToolKit::GetTime() - startTime << std::endl;
     }
 
     Point3DSet* Sampling::PointSetUniformSampling(Point3DSet* pPS, int sampleNum)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("Sampling::PointSetUniformSampling");
+        double timeStart = MagicCore::ToolKit::GetTime();
         int psNum = pPS->GetPointNumber();
         if (sampleNum > psNum)
         {
@@ -514,8 +427,7 @@ namespace MagicDGP
         for (int sid = 0; sid < sampleNum; ++sid)
         {
             MagicDGP::Point3D* pPoint = pPS->GetPoint(sampleIndex.at(sid));
-            MagicDGP::Point3D* pNewPoint = new MagicDGP::Point3D(pPoint->GetPosition(), pPoint->GetNormal());
-            pNewPS->InsertPoint(pNewPoint);
+            pNewPS->InsertPoint(pPoint->GetPosition(), pPoint->GetNormal());
         }
 
         return pNewPS;
@@ -523,7 +435,8 @@ namespace MagicDGP
 
     int Sampling::MeshVertexUniformSampling(const Mesh3D* pMesh, int sampleNum, std::vector<int>& sampleIndex)
     {
-        float timeStart = MagicCore::ToolKit::GetTime();
+        PROFILE_ZONE("Sampling::MeshVertexUniformSampling");
+        double timeStart = MagicCore::ToolKit::GetTime();
         int vertNum = pMesh->GetVertexNumber();
         if (sampleNum > vertNum)
         {
@@ -567,6 +480,7 @@ namespace MagicDGP
 
     bool Sampling::SimplifyMesh(Mesh3D* pMesh, int targetNum)
     {
+        PROFILE_ZONE("Sampling::SimplifyMesh");
         int vertNum = pMesh->GetVertexNumber();
         if (targetNum >= vertNum)
         {
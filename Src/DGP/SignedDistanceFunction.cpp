@@ -1,8 +1,16 @@
 //#include "StdAfx.h"
 #include "SignedDistanceFunction.h"
 #include "Tool/LogSystem.h"
+#include "../Common/AsyncLog.h"
+#include "../Common/Profiler.h"
 #include "Parser.h"
 
+namespace
+{
+    //Degenerate gradients of the point cloud extraction, one per grid edge at worst
+    MagicCore::AsyncLogSite gZeroNormalLogSite(10, 10000);
+}
+
 namespace MagicDGP
 {
     SignedDistanceFunction::SignedDistanceFunction(int resX, int resY, int resZ, float minX, float maxX, float minY, float maxY, float minZ, float maxZ) :
@@ -27,6 +35,7 @@ namespace MagicDGP
 
     void SignedDistanceFunction::UpdateSDF(const Point3DSet* pPC, const MagicMath::HomoMatrix4* pTransform)
     {
+        PROFILE_ZONE("SDF::Update");
         //DebugLog << "SignedDistanceFunction::UpdateSDF" << std::endl;
         int pcNum = pPC->GetPointNumber();
         float deltaX = (mMaxX - mMinX) / mResolutionX;
@@ -125,6 +134,7 @@ namespace MagicDGP
 
     void SignedDistanceFunction::UpdateFineSDF(const Point3DSet* pPC, const MagicMath::HomoMatrix4* pTransform)
     {
+        PROFILE_ZONE("SDF::UpdateFine");
         DebugLog << "SignedDistanceFunction::UpdateFineSDF" << std::endl;
         int pcNum = pPC->GetPointNumber();
         float deltaX = (mMaxX - mMinX) / mResolutionX;
@@ -227,6 +237,7 @@ namespace MagicDGP
 
     Point3DSet* SignedDistanceFunction::ExtractPointCloud()
     {
+        PROFILE_ZONE("SDF::ExtractPointCloud");
         DebugLog << "SignedDistanceFunction::PointCloudPrediction" << std::endl;
         float deltaX = (mMaxX - mMinX) / mResolutionX;
         float deltaY = (mMaxY - mMinY) / mResolutionY;
@@ -320,7 +331,7 @@ namespace MagicDGP
                     }
                     else
                     {
-                        DebugLog << "Normal Zero: X Direction" << std::endl;
+                        AsyncDebugLogSite(gZeroNormalLogSite) << "Normal Zero: X Direction" << std::endl;
                     }
                 }
             }
@@ -365,7 +376,7 @@ namespace MagicDGP
                     }
                     else
                     {
-                        DebugLog << "Normal Zero: Y direction" << std::endl;
+                        AsyncDebugLogSite(gZeroNormalLogSite) << "Normal Zero: Y direction" << std::endl;
                     }
                 }
             }
@@ -411,7 +422,7 @@ namespace MagicDGP
                     }
                     else
                     {
-                        DebugLog << "Normal Zero: Z Direction" << std::endl;
+                        AsyncDebugLogSite(gZeroNormalLogSite) << "Normal Zero: Z Direction" << std::endl;
                     }
                 }
             }
@@ -424,8 +435,7 @@ namespace MagicDGP
             Point3DSet* pPC = new Point3DSet;
             for (int i = 0; i < posNum; i++)
             {
-                Point3D* point = new Point3D(posList.at(i), norList.at(i));
-                pPC->InsertPoint(point);
+                pPC->InsertPoint(posList.at(i), norList.at(i));
             }
             //MagicDGP::Parser::ExportPointSet("interPointset.obj", pPC);//
             return pPC;
@@ -438,6 +448,7 @@ namespace MagicDGP
 
     Point3DSet* SignedDistanceFunction::ExtractFinePointCloud()
     {
+        PROFILE_ZONE("SDF::ExtractFinePointCloud");
         //DebugLog << "SignedDistanceFunction::ExtractFinePointCloud" << std::endl;
         float deltaX = (mMaxX - mMinX) / mResolutionX;
         float deltaY = (mMaxY - mMinY) / mResolutionY;
@@ -532,7 +543,7 @@ namespace MagicDGP
                     }
                     else
                     {
-                        DebugLog << "Normal Zero: X Direction" << std::endl;
+                        AsyncDebugLogSite(gZeroNormalLogSite) << "Normal Zero: X Direction" << std::endl;
                     }
                 }
             }
@@ -578,7 +589,7 @@ namespace MagicDGP
                     }
                     else
                     {
-                        DebugLog << "Normal Zero: Y direction" << std::endl;
+                        AsyncDebugLogSite(gZeroNormalLogSite) << "Normal Zero: Y direction" << std::endl;
                     }
                 }
             }
@@ -625,7 +636,7 @@ namespace MagicDGP
                     }
                     else
                     {
-                        DebugLog << "Normal Zero: Z Direction" << std::endl;
+                        AsyncDebugLogSite(gZeroNormalLogSite) << "Normal Zero: Z Direction" << std::endl;
                     }
                 }
             }
@@ -638,8 +649,7 @@ namespace MagicDGP
             Point3DSet* pPC = new Point3DSet;
             for (int i = 0; i < posNum; i++)
             {
-                Point3D* point = new Point3D(posList.at(i), norList.at(i));
-                pPC->InsertPoint(point);
+                pPC->InsertPoint(posList.at(i), norList.at(i));
             }
             //MagicDGP::Parser::ExportPointSet("interPointset.obj", pPC);//
             return pPC;
@@ -0,0 +1,964 @@
+#include "SnapshotFile.h"
+#include "MappedFile.h"
+#include "BufferedWriter.h"
+#include "Tool/LogSystem.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+    const char SnapshotMagic[8] = {'M', '3', 'D', 'S', 'N', 'A', 'P', '\0'};
+    const unsigned int SnapshotVersion = 1;
+    //Block data starts on cache line boundaries, doubles and ints can be read from the mapping directly
+    const unsigned long long BlockAlignment = 64;
+
+    enum SnapshotObjectType
+    {
+        SOT_PointSet = 1,
+        SOT_LightMesh,
+        SOT_Mesh
+    };
+
+    enum SnapshotBlockType
+    {
+        SBT_Position = 1,   //double3 per vertex
+        SBT_Normal,         //double3 per vertex
+        SBT_Color,          //double3 per vertex
+        SBT_TexCord,        //double3 per vertex
+        SBT_VertexEdge,     //int per vertex
+        SBT_VertexFlag,     //uchar per vertex
+        SBT_EdgeTopology,   //int5 per edge: vertex, pair, next, pre, face
+        SBT_EdgeFlag,       //uchar per edge
+        SBT_FaceEdge,       //int per face
+        SBT_FaceNormal,     //double3 per face
+        SBT_FaceFlag,       //uchar per face
+        SBT_FaceIndex       //int3 per face
+    };
+
+    enum SnapshotFlag
+    {
+        SF_HasNormal = 1
+    };
+
+    enum ElementFlag
+    {
+        EF_Valid = 1,
+        EF_Boundary = 2
+    };
+
+    struct SnapshotHeader
+    {
+        char mMagic[8];
+        unsigned int mVersion;
+        unsigned int mObjectType;
+        unsigned int mFlags;
+        unsigned int mBlockNum;
+        int mVertexNum;
+        int mEdgeNum;
+        int mFaceNum;
+        unsigned int mReserved;
+    };
+
+    struct SnapshotBlock
+    {
+        unsigned int mType;
+        unsigned int mElementSize;
+        unsigned long long mOffset;
+        unsigned long long mElementNum;
+    };
+
+    unsigned long long AlignOffset(unsigned long long offset)
+    {
+        return (offset + BlockAlignment - 1) / BlockAlignment * BlockAlignment;
+    }
+
+    //Blocks are declared first so that the block table can be written before the data
+    class SnapshotWriter
+    {
+    public:
+        SnapshotWriter(unsigned int objectType, unsigned int flags, int vertNum, int edgeNum, int faceNum) :
+            mWriter(),
+            mBlockList(),
+            mBlockIndex(0),
+            mOffset(0),
+            mIsFailed(false)
+        {
+            memset(&mHeader, 0, sizeof(SnapshotHeader));
+            memcpy(mHeader.mMagic, SnapshotMagic, sizeof(SnapshotMagic));
+            mHeader.mVersion = SnapshotVersion;
+            mHeader.mObjectType = objectType;
+            mHeader.mFlags = flags;
+            mHeader.mVertexNum = vertNum;
+            mHeader.mEdgeNum = edgeNum;
+            mHeader.mFaceNum = faceNum;
+        }
+
+        void AddBlock(unsigned int type, unsigned int elementSize, int elementNum)
+        {
+            SnapshotBlock block;
+            block.mType = type;
+            block.mElementSize = elementSize;
+            block.mOffset = 0;
+            block.mElementNum = elementNum;
+            mBlockList.push_back(block);
+        }
+
+        bool Open(const std::string& fileName)
+        {
+            mHeader.mBlockNum = mBlockList.size();
+            unsigned long long offset = AlignOffset(sizeof(SnapshotHeader) + sizeof(SnapshotBlock) * mBlockList.size());
+            for (std::vector<SnapshotBlock>::iterator itr = mBlockList.begin(); itr != mBlockList.end(); itr++)
+            {
+                itr->mOffset = offset;
+                offset = AlignOffset(offset + itr->mElementSize * itr->mElementNum);
+            }
+            if (!mWriter.Open(fileName))
+            {
+                return false;
+            }
+            mWriter.WriteBytes(&mHeader, sizeof(SnapshotHeader));
+            if (!mBlockList.empty())
+            {
+                mWriter.WriteBytes(&(mBlockList[0]), sizeof(SnapshotBlock) * mBlockList.size());
+            }
+            mOffset = sizeof(SnapshotHeader) + sizeof(SnapshotBlock) * mBlockList.size();
+            mBlockIndex = 0;
+            return true;
+        }
+
+        void WriteVector3(const MagicMath::Vector3& vec)
+        {
+            double data[3] = {vec[0], vec[1], vec[2]};
+            WriteBytes(data, sizeof(data));
+        }
+
+        void WriteInt(int value)
+        {
+            WriteBytes(&value, sizeof(int));
+        }
+
+        void WriteFlag(unsigned char flag)
+        {
+            WriteBytes(&flag, 1);
+        }
+
+        void WriteBytes(const void* pData, size_t size)
+        {
+            if (mBlockIndex < mBlockList.size() && mOffset < mBlockList.at(mBlockIndex).mOffset)
+            {
+                Pad(mBlockList.at(mBlockIndex).mOffset);
+            }
+            mWriter.WriteBytes(pData, size);
+            mOffset += size;
+        }
+
+        //Called after the data of each block in declaration order
+        void EndBlock()
+        {
+            const SnapshotBlock& block = mBlockList.at(mBlockIndex);
+            Pad(block.mOffset);
+            if (mOffset != block.mOffset + block.mElementSize * block.mElementNum)
+            {
+                ErrorLog << "SnapshotWriter::EndBlock: size mismatch of block " << block.mType << std::endl;
+                mIsFailed = true;
+            }
+            mBlockIndex++;
+        }
+
+        bool Close()
+        {
+            if (mBlockIndex != mBlockList.size())
+            {
+                mIsFailed = true;
+            }
+            return mWriter.Close() && !mIsFailed;
+        }
+
+    private:
+        void Pad(unsigned long long offset)
+        {
+            static const char zeros[BlockAlignment] = {0};
+            while (mOffset < offset)
+            {
+                size_t padSize = (offset - mOffset) < BlockAlignment ? size_t(offset - mOffset) : size_t(BlockAlignment);
+                mWriter.WriteBytes(zeros, padSize);
+                mOffset += padSize;
+            }
+        }
+
+    private:
+        MagicDGP::BufferedWriter mWriter;
+        SnapshotHeader mHeader;
+        std::vector<SnapshotBlock> mBlockList;
+        size_t mBlockIndex;
+        unsigned long long mOffset;
+        bool mIsFailed;
+    };
+
+    //Block data of a validated block table, NULL if the block is missing or its layout is not the expected one
+    const void* FindBlock(const char* pData, const SnapshotHeader* pHeader, unsigned int type, unsigned int elementSize, int elementNum)
+    {
+        const SnapshotBlock* pBlockList = reinterpret_cast<const SnapshotBlock*>(pData + sizeof(SnapshotHeader));
+        for (unsigned int bid = 0; bid < pHeader->mBlockNum; bid++)
+        {
+            const SnapshotBlock& block = pBlockList[bid];
+            if (block.mType == type)
+            {
+                if (block.mElementSize != elementSize || block.mElementNum != (unsigned long long)elementNum)
+                {
+                    ErrorLog << "SnapshotFile: unexpected layout of block " << type << std::endl;
+                    return NULL;
+                }
+                return pData + block.mOffset;
+            }
+        }
+        return NULL;
+    }
+
+    MagicMath::Vector3 GetVector3(const double* pData, int index)
+    {
+        return MagicMath::Vector3(pData[index * 3], pData[index * 3 + 1], pData[index * 3 + 2]);
+    }
+
+    unsigned char GetElementFlag(bool valid, MagicDGP::BoundaryType bt)
+    {
+        return (unsigned char)((valid ? EF_Valid : 0) | (bt == MagicDGP::BT_Boundary ? EF_Boundary : 0));
+    }
+}
+
+namespace MagicDGP
+{
+    MappedSnapshot::MappedSnapshot() :
+        mFile(),
+        mObjectType(0),
+        mVertexNum(0),
+        mEdgeNum(0),
+        mFaceNum(0),
+        mpPosition(NULL),
+        mpNormal(NULL),
+        mpColor(NULL),
+        mpTexCord(NULL),
+        mpVertexEdge(NULL),
+        mpVertexFlag(NULL),
+        mpEdgeTopology(NULL),
+        mpEdgeFlag(NULL),
+        mpFaceEdge(NULL),
+        mpFaceNormal(NULL),
+        mpFaceFlag(NULL),
+        mpFaceIndex(NULL)
+    {
+    }
+
+    MappedSnapshot::~MappedSnapshot()
+    {
+    }
+
+    bool MappedSnapshot::Open(const std::string& fileName)
+    {
+        Close();
+        if (!mFile.Open(fileName))
+        {
+            return false;
+        }
+        const char* pData = mFile.GetData();
+        size_t fileSize = mFile.GetSize();
+        if (fileSize < sizeof(SnapshotHeader) || memcmp(pData, SnapshotMagic, sizeof(SnapshotMagic)) != 0)
+        {
+            ErrorLog << "SnapshotFile: not a snapshot " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        const SnapshotHeader* pHeader = reinterpret_cast<const SnapshotHeader*>(pData);
+        if (pHeader->mVersion != SnapshotVersion)
+        {
+            ErrorLog << "SnapshotFile: unsupported version " << pHeader->mVersion << std::endl;
+            Close();
+            return false;
+        }
+        if (pHeader->mVertexNum < 0 || pHeader->mEdgeNum < 0 || pHeader->mFaceNum < 0 ||
+            pHeader->mBlockNum > (fileSize - sizeof(SnapshotHeader)) / sizeof(SnapshotBlock))
+        {
+            ErrorLog << "SnapshotFile: corrupted header " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        const SnapshotBlock* pBlockList = reinterpret_cast<const SnapshotBlock*>(pData + sizeof(SnapshotHeader));
+        for (unsigned int bid = 0; bid < pHeader->mBlockNum; bid++)
+        {
+            const SnapshotBlock& block = pBlockList[bid];
+            if (block.mOffset % BlockAlignment != 0 || block.mOffset > fileSize || block.mElementSize == 0 ||
+                block.mElementNum > (fileSize - block.mOffset) / block.mElementSize)
+            {
+                ErrorLog << "SnapshotFile: corrupted block " << block.mType << " in " << fileName.c_str() << std::endl;
+                Close();
+                return false;
+            }
+        }
+        int vertNum = pHeader->mVertexNum;
+        int edgeNum = pHeader->mEdgeNum;
+        int faceNum = pHeader->mFaceNum;
+        mpPosition = static_cast<const double*>(FindBlock(pData, pHeader, SBT_Position, sizeof(double) * 3, vertNum));
+        if (mpPosition == NULL)
+        {
+            ErrorLog << "SnapshotFile: no position in " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        if (pHeader->mFlags & SF_HasNormal)
+        {
+            mpNormal = static_cast<const double*>(FindBlock(pData, pHeader, SBT_Normal, sizeof(double) * 3, vertNum));
+        }
+        mpColor = static_cast<const double*>(FindBlock(pData, pHeader, SBT_Color, sizeof(double) * 3, vertNum));
+        mpTexCord = static_cast<const double*>(FindBlock(pData, pHeader, SBT_TexCord, sizeof(double) * 3, vertNum));
+        mpVertexEdge = static_cast<const int*>(FindBlock(pData, pHeader, SBT_VertexEdge, sizeof(int), vertNum));
+        mpVertexFlag = static_cast<const unsigned char*>(FindBlock(pData, pHeader, SBT_VertexFlag, 1, vertNum));
+        mpEdgeTopology = static_cast<const int*>(FindBlock(pData, pHeader, SBT_EdgeTopology, sizeof(int) * 5, edgeNum));
+        mpEdgeFlag = static_cast<const unsigned char*>(FindBlock(pData, pHeader, SBT_EdgeFlag, 1, edgeNum));
+        mpFaceEdge = static_cast<const int*>(FindBlock(pData, pHeader, SBT_FaceEdge, sizeof(int), faceNum));
+        mpFaceNormal = static_cast<const double*>(FindBlock(pData, pHeader, SBT_FaceNormal, sizeof(double) * 3, faceNum));
+        mpFaceFlag = static_cast<const unsigned char*>(FindBlock(pData, pHeader, SBT_FaceFlag, 1, faceNum));
+        mpFaceIndex = static_cast<const int*>(FindBlock(pData, pHeader, SBT_FaceIndex, sizeof(int) * 3, faceNum));
+        bool hasFace = (mpFaceIndex != NULL || (mpFaceEdge != NULL && mpEdgeTopology != NULL));
+        if (pHeader->mObjectType != SOT_PointSet && !hasFace)
+        {
+            ErrorLog << "SnapshotFile: no face in " << fileName.c_str() << std::endl;
+            Close();
+            return false;
+        }
+        mObjectType = pHeader->mObjectType;
+        mVertexNum = vertNum;
+        mEdgeNum = edgeNum;
+        mFaceNum = pHeader->mObjectType == SOT_PointSet ? 0 : faceNum;
+        return true;
+    }
+
+    void MappedSnapshot::Close()
+    {
+        mFile.Close();
+        mObjectType = 0;
+        mVertexNum = 0;
+        mEdgeNum = 0;
+        mFaceNum = 0;
+        mpPosition = NULL;
+        mpNormal = NULL;
+        mpColor = NULL;
+        mpTexCord = NULL;
+        mpVertexEdge = NULL;
+        mpVertexFlag = NULL;
+        mpEdgeTopology = NULL;
+        mpEdgeFlag = NULL;
+        mpFaceEdge = NULL;
+        mpFaceNormal = NULL;
+        mpFaceFlag = NULL;
+        mpFaceIndex = NULL;
+    }
+
+    bool MappedSnapshot::IsOpen() const
+    {
+        return mpPosition != NULL;
+    }
+
+    int MappedSnapshot::GetVertexNumber() const
+    {
+        return mVertexNum;
+    }
+
+    int MappedSnapshot::GetFaceNumber() const
+    {
+        return mFaceNum;
+    }
+
+    const FaceIndex MappedSnapshot::GetFace(int index) const
+    {
+        FaceIndex faceIdx;
+        if (mpFaceIndex != NULL)
+        {
+            faceIdx.mIndex[0] = mpFaceIndex[index * 3];
+            faceIdx.mIndex[1] = mpFaceIndex[index * 3 + 1];
+            faceIdx.mIndex[2] = mpFaceIndex[index * 3 + 2];
+            return faceIdx;
+        }
+        //Mesh3D snapshot without the index block: the face edge goes from its first vertex to the second one
+        faceIdx.mIndex[0] = faceIdx.mIndex[1] = faceIdx.mIndex[2] = -1;
+        int eid = mpFaceEdge[index];
+        if (eid < 0 || eid >= mEdgeNum)
+        {
+            return faceIdx;
+        }
+        int preId = mpEdgeTopology[eid * 5 + 3];
+        int nextId = mpEdgeTopology[eid * 5 + 2];
+        if (preId < 0 || preId >= mEdgeNum || nextId < 0 || nextId >= mEdgeNum)
+        {
+            return faceIdx;
+        }
+        faceIdx.mIndex[0] = mpEdgeTopology[preId * 5];
+        faceIdx.mIndex[1] = mpEdgeTopology[eid * 5];
+        faceIdx.mIndex[2] = mpEdgeTopology[nextId * 5];
+        return faceIdx;
+    }
+
+    MagicMath::Vector3 MappedSnapshot::GetPosition(int index) const
+    {
+        return GetVector3(mpPosition, index);
+    }
+
+    MagicMath::Vector3 MappedSnapshot::GetNormal(int index) const
+    {
+        return mpNormal == NULL ? MagicMath::Vector3(0, 0, 0) : GetVector3(mpNormal, index);
+    }
+
+    MagicMath::Vector3 MappedSnapshot::GetColor(int index) const
+    {
+        return mpColor == NULL ? MagicMath::Vector3(0.86, 0.86, 0.86) : GetVector3(mpColor, index);
+    }
+
+    MagicMath::Vector3 MappedSnapshot::GetTexCord(int index) const
+    {
+        return mpTexCord == NULL ? MagicMath::Vector3(0, 0, 0) : GetVector3(mpTexCord, index);
+    }
+
+    bool MappedSnapshot::HasNormal() const
+    {
+        return mpNormal != NULL;
+    }
+
+    bool MappedSnapshot::HasColor() const
+    {
+        return mpColor != NULL;
+    }
+
+    bool MappedSnapshot::HasTexCord() const
+    {
+        return mpTexCord != NULL;
+    }
+
+    const double* MappedSnapshot::GetPositionData() const
+    {
+        return mpPosition;
+    }
+
+    const double* MappedSnapshot::GetNormalData() const
+    {
+        return mpNormal;
+    }
+
+    const double* MappedSnapshot::GetColorData() const
+    {
+        return mpColor;
+    }
+
+    const double* MappedSnapshot::GetTexCordData() const
+    {
+        return mpTexCord;
+    }
+
+    const int* MappedSnapshot::GetFaceIndexData() const
+    {
+        return mpFaceIndex;
+    }
+
+    bool MappedSnapshot::GetFaceIndexList(std::vector<int>& indexList) const
+    {
+        indexList.resize(mFaceNum * 3);
+        for (int fid = 0; fid < mFaceNum; fid++)
+        {
+            FaceIndex faceIdx = GetFace(fid);
+            for (int k = 0; k < 3; k++)
+            {
+                if (faceIdx.mIndex[k] < 0 || faceIdx.mIndex[k] >= mVertexNum)
+                {
+                    ErrorLog << "MappedSnapshot: invalid face " << fid << std::endl;
+                    return false;
+                }
+                indexList.at(fid * 3 + k) = faceIdx.mIndex[k];
+            }
+        }
+        return true;
+    }
+
+    Point3DSet* MappedSnapshot::CreatePointSet() const
+    {
+        if (!IsOpen())
+        {
+            return NULL;
+        }
+        //Vertex flags of mesh snapshots carry the boundary type, only point set flags are used
+        const unsigned char* pFlag = (mObjectType == SOT_PointSet) ? mpVertexFlag : NULL;
+        Point3DSet* pPointSet = new Point3DSet;
+        for (int pid = 0; pid < mVertexNum; pid++)
+        {
+            Point3D* pPoint = (mpNormal != NULL) ? pPointSet->InsertPoint(GetVector3(mpPosition, pid), GetVector3(mpNormal, pid)) :
+                pPointSet->InsertPoint(GetVector3(mpPosition, pid));
+            if (mpColor != NULL)
+            {
+                pPoint->SetColor(GetVector3(mpColor, pid));
+            }
+            if (pFlag != NULL)
+            {
+                pPoint->SetValid((pFlag[pid] & EF_Valid) != 0);
+            }
+        }
+        pPointSet->SetHasNormal(mpNormal != NULL);
+        InfoLog << "Import Point Number: " << pPointSet->GetPointNumber() << std::endl;
+        return pPointSet;
+    }
+
+    LightMesh3D* MappedSnapshot::CreateLightMesh3D() const
+    {
+        std::vector<int> indexList;
+        if (!IsOpen() || mObjectType == SOT_PointSet || !GetFaceIndexList(indexList))
+        {
+            ErrorLog << "MappedSnapshot::CreateLightMesh3D: no mesh" << std::endl;
+            return NULL;
+        }
+        std::vector<MagicMath::Vector3> vecList(mVertexNum);
+        for (int vid = 0; vid < mVertexNum; vid++)
+        {
+            vecList.at(vid) = GetVector3(mpPosition, vid);
+        }
+        LightMesh3D* pMesh = new LightMesh3D;
+        pMesh->BuildFromIndexedTriangles(vecList, indexList);
+        //Channels which are not in the snapshot stay unallocated
+        for (int vid = 0; vid < mVertexNum && mpNormal != NULL; vid++)
+        {
+            pMesh->SetNormal(vid, GetVector3(mpNormal, vid));
+        }
+        for (int vid = 0; vid < mVertexNum && mpColor != NULL; vid++)
+        {
+            pMesh->SetColor(vid, GetVector3(mpColor, vid));
+        }
+        for (int vid = 0; vid < mVertexNum && mpTexCord != NULL; vid++)
+        {
+            pMesh->SetTexCord(vid, GetVector3(mpTexCord, vid));
+        }
+        InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
+        return pMesh;
+    }
+
+    Mesh3D* MappedSnapshot::CreateMesh3D() const
+    {
+        if (!IsOpen() || mObjectType == SOT_PointSet)
+        {
+            ErrorLog << "MappedSnapshot::CreateMesh3D: not a mesh snapshot" << std::endl;
+            return NULL;
+        }
+        int vertNum = mVertexNum;
+        int edgeNum = mEdgeNum;
+        int faceNum = mFaceNum;
+        Mesh3D* pMesh = new Mesh3D;
+        if (mObjectType == SOT_Mesh)
+        {
+            if (mpVertexEdge == NULL || mpEdgeTopology == NULL || mpFaceEdge == NULL ||
+                !pMesh->BuildFromHalfEdges(vertNum, mpPosition, mpVertexEdge, edgeNum, mpEdgeTopology, faceNum, mpFaceEdge))
+            {
+                ErrorLog << "MappedSnapshot::CreateMesh3D: invalid connectivity" << std::endl;
+                delete pMesh;
+                return NULL;
+            }
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                Vertex3D* pVert = pMesh->GetVertex(vid);
+                if (mpTexCord != NULL)
+                {
+                    pVert->SetTexCord(GetVector3(mpTexCord, vid));
+                }
+                if (mpVertexFlag != NULL)
+                {
+                    pVert->SetValid((mpVertexFlag[vid] & EF_Valid) != 0);
+                    pVert->SetBoundaryType((mpVertexFlag[vid] & EF_Boundary) ? BT_Boundary : BT_Inner);
+                }
+            }
+            if (mpEdgeFlag != NULL)
+            {
+                for (int eid = 0; eid < edgeNum; eid++)
+                {
+                    Edge3D* pEdge = pMesh->GetEdge(eid);
+                    pEdge->SetValid((mpEdgeFlag[eid] & EF_Valid) != 0);
+                    pEdge->SetBoundaryType((mpEdgeFlag[eid] & EF_Boundary) ? BT_Boundary : BT_Inner);
+                }
+            }
+            for (int fid = 0; fid < faceNum; fid++)
+            {
+                Face3D* pFace = pMesh->GetFace(fid);
+                if (mpFaceNormal != NULL)
+                {
+                    pFace->SetNormal(GetVector3(mpFaceNormal, fid));
+                }
+                if (mpFaceFlag != NULL)
+                {
+                    pFace->SetValid((mpFaceFlag[fid] & EF_Valid) != 0);
+                }
+            }
+        }
+        else
+        {
+            std::vector<int> indexList;
+            if (!GetFaceIndexList(indexList))
+            {
+                delete pMesh;
+                return NULL;
+            }
+            std::vector<MagicMath::Vector3> posList(vertNum);
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                posList.at(vid) = GetVector3(mpPosition, vid);
+            }
+            pMesh->BuildFromIndexedTriangles(posList, indexList);
+            pMesh->UpdateNormal();
+        }
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            Vertex3D* pVert = pMesh->GetVertex(vid);
+            if (mpNormal != NULL)
+            {
+                pVert->SetNormal(GetVector3(mpNormal, vid));
+            }
+            if (mpColor != NULL)
+            {
+                pVert->SetColor(GetVector3(mpColor, vid));
+            }
+        }
+        InfoLog << "Import Vertex Number: " << pMesh->GetVertexNumber() << " Face Number: " << pMesh->GetFaceNumber() << std::endl;
+        return pMesh;
+    }
+
+    bool SnapshotFile::IsSnapshot(const std::string& fileName)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            return false;
+        }
+        char magic[sizeof(SnapshotMagic)];
+        bool isSnapshot = (fread(magic, 1, sizeof(magic), pFile) == sizeof(magic) && memcmp(magic, SnapshotMagic, sizeof(magic)) == 0);
+        fclose(pFile);
+        return isSnapshot;
+    }
+
+    bool SnapshotFile::Save(const std::string& fileName, const Point3DSet* pPointSet)
+    {
+        DebugLog << "SnapshotFile::Save point set: " << fileName.c_str() << std::endl;
+        int pointNum = pPointSet->GetPointNumber();
+        bool hasNormal = pPointSet->HasNormal();
+        SnapshotWriter writer(SOT_PointSet, hasNormal ? SF_HasNormal : 0, pointNum, 0, 0);
+        writer.AddBlock(SBT_Position, sizeof(double) * 3, pointNum);
+        if (hasNormal)
+        {
+            writer.AddBlock(SBT_Normal, sizeof(double) * 3, pointNum);
+        }
+        writer.AddBlock(SBT_Color, sizeof(double) * 3, pointNum);
+        writer.AddBlock(SBT_VertexFlag, 1, pointNum);
+        if (!writer.Open(fileName))
+        {
+            return false;
+        }
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            writer.WriteVector3(pPointSet->GetPoint(pid)->GetPosition());
+        }
+        writer.EndBlock();
+        if (hasNormal)
+        {
+            for (int pid = 0; pid < pointNum; pid++)
+            {
+                writer.WriteVector3(pPointSet->GetPoint(pid)->GetNormal());
+            }
+            writer.EndBlock();
+        }
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            writer.WriteVector3(pPointSet->GetPoint(pid)->GetColor());
+        }
+        writer.EndBlock();
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            writer.WriteFlag(GetElementFlag(pPointSet->GetPoint(pid)->IsValid(), BT_Inner));
+        }
+        writer.EndBlock();
+        return writer.Close();
+    }
+
+    bool SnapshotFile::Save(const std::string& fileName, const LightMesh3D* pMesh)
+    {
+        DebugLog << "SnapshotFile::Save light mesh: " << fileName.c_str() << std::endl;
+        int vertNum = pMesh->GetVertexNumber();
+        int faceNum = pMesh->GetFaceNumber();
+        //Only the channels of the mesh are stored
+        SnapshotWriter writer(SOT_LightMesh, pMesh->HasNormal() ? SF_HasNormal : 0, vertNum, 0, faceNum);
+        writer.AddBlock(SBT_Position, sizeof(double) * 3, vertNum);
+        if (pMesh->HasNormal())
+        {
+            writer.AddBlock(SBT_Normal, sizeof(double) * 3, vertNum);
+        }
+        if (pMesh->HasColor())
+        {
+            writer.AddBlock(SBT_Color, sizeof(double) * 3, vertNum);
+        }
+        if (pMesh->HasTexCord())
+        {
+            writer.AddBlock(SBT_TexCord, sizeof(double) * 3, vertNum);
+        }
+        writer.AddBlock(SBT_FaceIndex, sizeof(int) * 3, faceNum);
+        if (!writer.Open(fileName))
+        {
+            return false;
+        }
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            writer.WriteVector3(pMesh->GetPosition(vid));
+        }
+        writer.EndBlock();
+        if (pMesh->HasNormal())
+        {
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                writer.WriteVector3(pMesh->GetNormal(vid));
+            }
+            writer.EndBlock();
+        }
+        if (pMesh->HasColor())
+        {
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                writer.WriteVector3(pMesh->GetColor(vid));
+            }
+            writer.EndBlock();
+        }
+        if (pMesh->HasTexCord())
+        {
+            for (int vid = 0; vid < vertNum; vid++)
+            {
+                writer.WriteVector3(pMesh->GetTexCord(vid));
+            }
+            writer.EndBlock();
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            FaceIndex faceIdx = pMesh->GetFace(fid);
+            writer.WriteBytes(faceIdx.mIndex, sizeof(int) * 3);
+        }
+        writer.EndBlock();
+        return writer.Close();
+    }
+
+    bool SnapshotFile::Save(const std::string& fileName, const Mesh3D* pMesh)
+    {
+        DebugLog << "SnapshotFile::Save mesh: " << fileName.c_str() << std::endl;
+        int vertNum = pMesh->GetVertexNumber();
+        int edgeNum = pMesh->GetEdgeNumber();
+        int faceNum = pMesh->GetFaceNumber();
+        //Connectivity is stored by id, so ids have to be the list indices
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            if (pMesh->GetVertex(vid)->GetId() != vid)
+            {
+                ErrorLog << "SnapshotFile::Save: vertex id is not its index " << vid << std::endl;
+                return false;
+            }
+        }
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            if (pMesh->GetEdge(eid)->GetId() != eid)
+            {
+                ErrorLog << "SnapshotFile::Save: edge id is not its index " << eid << std::endl;
+                return false;
+            }
+        }
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            if (pMesh->GetFace(fid)->GetId() != fid)
+            {
+                ErrorLog << "SnapshotFile::Save: face id is not its index " << fid << std::endl;
+                return false;
+            }
+        }
+        SnapshotWriter writer(SOT_Mesh, SF_HasNormal, vertNum, edgeNum, faceNum);
+        writer.AddBlock(SBT_Position, sizeof(double) * 3, vertNum);
+        writer.AddBlock(SBT_Normal, sizeof(double) * 3, vertNum);
+        writer.AddBlock(SBT_Color, sizeof(double) * 3, vertNum);
+        writer.AddBlock(SBT_TexCord, sizeof(double) * 3, vertNum);
+        writer.AddBlock(SBT_VertexEdge, sizeof(int), vertNum);
+        writer.AddBlock(SBT_VertexFlag, 1, vertNum);
+        writer.AddBlock(SBT_EdgeTopology, sizeof(int) * 5, edgeNum);
+        writer.AddBlock(SBT_EdgeFlag, 1, edgeNum);
+        writer.AddBlock(SBT_FaceEdge, sizeof(int), faceNum);
+        writer.AddBlock(SBT_FaceNormal, sizeof(double) * 3, faceNum);
+        writer.AddBlock(SBT_FaceFlag, 1, faceNum);
+        writer.AddBlock(SBT_FaceIndex, sizeof(int) * 3, faceNum);
+        if (!writer.Open(fileName))
+        {
+            return false;
+        }
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            writer.WriteVector3(pMesh->GetVertex(vid)->GetPosition());
+        }
+        writer.EndBlock();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            writer.WriteVector3(pMesh->GetVertex(vid)->GetNormal());
+        }
+        writer.EndBlock();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            writer.WriteVector3(pMesh->GetVertex(vid)->GetColor());
+        }
+        writer.EndBlock();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            writer.WriteVector3(pMesh->GetVertex(vid)->GetTexCord());
+        }
+        writer.EndBlock();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            const Edge3D* pEdge = pMesh->GetVertex(vid)->GetEdge();
+            writer.WriteInt(pEdge == NULL ? -1 : pEdge->GetId());
+        }
+        writer.EndBlock();
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            const Vertex3D* pVert = pMesh->GetVertex(vid);
+            writer.WriteFlag(GetElementFlag(pVert->IsValid(), pVert->GetBoundaryType()));
+        }
+        writer.EndBlock();
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            const Edge3D* pEdge = pMesh->GetEdge(eid);
+            int topology[5];
+            topology[0] = pEdge->GetVertex() == NULL ? -1 : pEdge->GetVertex()->GetId();
+            topology[1] = pEdge->GetPair() == NULL ? -1 : pEdge->GetPair()->GetId();
+            topology[2] = pEdge->GetNext() == NULL ? -1 : pEdge->GetNext()->GetId();
+            topology[3] = pEdge->GetPre() == NULL ? -1 : pEdge->GetPre()->GetId();
+            topology[4] = pEdge->GetFace() == NULL ? -1 : pEdge->GetFace()->GetId();
+            writer.WriteBytes(topology, sizeof(topology));
+        }
+        writer.EndBlock();
+        for (int eid = 0; eid < edgeNum; eid++)
+        {
+            const Edge3D* pEdge = pMesh->GetEdge(eid);
+            writer.WriteFlag(GetElementFlag(pEdge->IsValid(), pEdge->GetBoundaryType()));
+        }
+        writer.EndBlock();
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            const Edge3D* pEdge = pMesh->GetFace(fid)->GetEdge();
+            writer.WriteInt(pEdge == NULL ? -1 : pEdge->GetId());
+        }
+        writer.EndBlock();
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            writer.WriteVector3(pMesh->GetFace(fid)->GetNormal());
+        }
+        writer.EndBlock();
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            writer.WriteFlag(GetElementFlag(pMesh->GetFace(fid)->IsValid(), BT_Inner));
+        }
+        writer.EndBlock();
+        //Triangles for mapped views, the face edge goes from the first vertex to the second one
+        for (int fid = 0; fid < faceNum; fid++)
+        {
+            const Edge3D* pEdge = pMesh->GetFace(fid)->GetEdge();
+            int faceIdx[3] = {-1, -1, -1};
+            if (pEdge != NULL && pEdge->GetPre() != NULL && pEdge->GetNext() != NULL)
+            {
+                faceIdx[0] = pEdge->GetPre()->GetVertex()->GetId();
+                faceIdx[1] = pEdge->GetVertex()->GetId();
+                faceIdx[2] = pEdge->GetNext()->GetVertex()->GetId();
+            }
+            writer.WriteBytes(faceIdx, sizeof(faceIdx));
+        }
+        writer.EndBlock();
+        return writer.Close();
+    }
+
+    Point3DSet* SnapshotFile::LoadPointSet(const std::string& fileName)
+    {
+        DebugLog << "SnapshotFile::LoadPointSet: " << fileName.c_str() << std::endl;
+        MappedSnapshot snapshot;
+        if (!snapshot.Open(fileName))
+        {
+            return NULL;
+        }
+        return snapshot.CreatePointSet();
+    }
+
+    LightMesh3D* SnapshotFile::LoadLightMesh3D(const std::string& fileName)
+    {
+        DebugLog << "SnapshotFile::LoadLightMesh3D: " << fileName.c_str() << std::endl;
+        MappedSnapshot snapshot;
+        if (!snapshot.Open(fileName))
+        {
+            return NULL;
+        }
+        return snapshot.CreateLightMesh3D();
+    }
+
+    Mesh3D* SnapshotFile::LoadMesh3D(const std::string& fileName)
+    {
+        DebugLog << "SnapshotFile::LoadMesh3D: " << fileName.c_str() << std::endl;
+        MappedSnapshot snapshot;
+        if (!snapshot.Open(fileName))
+        {
+            return NULL;
+        }
+        return snapshot.CreateMesh3D();
+    }
+
+    bool SnapshotFile::ReadPointLayout(const std::string& fileName, SnapshotPointLayout& layout)
+    {
+        FILE* pFile = fopen(fileName.c_str(), "rb");
+        if (pFile == NULL)
+        {
+            ErrorLog << "SnapshotFile::ReadPointLayout: can not open " << fileName.c_str() << std::endl;
+            return false;
+        }
+        SnapshotHeader header;
+        std::vector<SnapshotBlock> blockList;
+        bool isValid = (fread(&header, sizeof(SnapshotHeader), 1, pFile) == 1 &&
+            memcmp(header.mMagic, SnapshotMagic, sizeof(SnapshotMagic)) == 0 && header.mVersion == SnapshotVersion &&
+            header.mVertexNum >= 0 && header.mBlockNum < 256);
+        if (isValid && header.mBlockNum > 0)
+        {
+            blockList.resize(header.mBlockNum);
+            isValid = (fread(&(blockList[0]), sizeof(SnapshotBlock), blockList.size(), pFile) == blockList.size());
+        }
+        fclose(pFile);
+        if (!isValid)
+        {
+            ErrorLog << "SnapshotFile::ReadPointLayout: invalid snapshot " << fileName.c_str() << std::endl;
+            return false;
+        }
+        layout.mPointNumber = header.mVertexNum;
+        layout.mPositionOffset = 0;
+        layout.mNormalOffset = 0;
+        layout.mColorOffset = 0;
+        for (std::vector<SnapshotBlock>::iterator itr = blockList.begin(); itr != blockList.end(); itr++)
+        {
+            if (itr->mElementSize != sizeof(double) * 3 || itr->mElementNum != (unsigned long long)header.mVertexNum ||
+                itr->mOffset % BlockAlignment != 0)
+            {
+                continue;
+            }
+            if (itr->mType == SBT_Position)
+            {
+                layout.mPositionOffset = itr->mOffset;
+            }
+            else if (itr->mType == SBT_Normal && (header.mFlags & SF_HasNormal))
+            {
+                layout.mNormalOffset = itr->mOffset;
+            }
+            else if (itr->mType == SBT_Color)
+            {
+                layout.mColorOffset = itr->mOffset;
+            }
+        }
+        if (layout.mPositionOffset == 0)
+        {
+            ErrorLog << "SnapshotFile::ReadPointLayout: no position in " << fileName.c_str() << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
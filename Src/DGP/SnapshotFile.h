@@ -0,0 +1,99 @@
+#pragma once
+#include "PointCloud3D.h"
+#include "Mesh3D.h"
+#include "MappedFile.h"
+#include <string>
+
+namespace MagicDGP
+{
+    //Native little endian snapshot (.m3d) of Point3DSet, LightMesh3D and Mesh3D.
+    //Attribute arrays are stored as aligned blocks behind a block table, so loading maps the file and
+    //consumes the arrays in place. Mesh3D keeps its half edge connectivity, no edge pairing on load.
+    //File offsets of the double3 vertex blocks, 0 if the block is missing
+    struct SnapshotPointLayout
+    {
+        int mPointNumber;
+        unsigned long long mPositionOffset;
+        unsigned long long mNormalOffset;
+        unsigned long long mColorOffset;
+    };
+
+    //Read only view of a mapped snapshot with the LightMesh3D accessors. Open checks the header and the block
+    //table only, channel pages are read on first access. Pool objects are built by the Create functions only.
+    class MappedSnapshot
+    {
+    public:
+        MappedSnapshot();
+        ~MappedSnapshot();
+
+        bool Open(const std::string& fileName);
+        void Close();
+        bool IsOpen() const;
+
+        int GetVertexNumber() const;
+        int GetFaceNumber() const; //0 for point set snapshots
+        //Indices are returned as stored, they are checked by CreateLightMesh3D and CreateMesh3D
+        const FaceIndex GetFace(int index) const;
+        MagicMath::Vector3 GetPosition(int index) const;
+        //Get of a missing channel returns the LightMesh3D default
+        MagicMath::Vector3 GetNormal(int index) const;
+        MagicMath::Vector3 GetColor(int index) const;
+        MagicMath::Vector3 GetTexCord(int index) const;
+        bool HasNormal() const;
+        bool HasColor() const;
+        bool HasTexCord() const;
+        //Mapped arrays valid until Close, NULL if the block is missing. 3 doubles per vertex, 3 ints per face
+        const double* GetPositionData() const;
+        const double* GetNormalData() const;
+        const double* GetColorData() const;
+        const double* GetTexCordData() const;
+        const int* GetFaceIndexData() const;
+
+        Point3DSet*  CreatePointSet() const;
+        LightMesh3D* CreateLightMesh3D() const;
+        Mesh3D*      CreateMesh3D() const;
+
+    private:
+        MappedSnapshot(const MappedSnapshot&);
+        MappedSnapshot& operator = (const MappedSnapshot&);
+        bool GetFaceIndexList(std::vector<int>& indexList) const;
+
+    private:
+        MappedFile mFile;
+        unsigned int mObjectType;
+        int mVertexNum;
+        int mEdgeNum;
+        int mFaceNum;
+        const double* mpPosition;
+        const double* mpNormal;
+        const double* mpColor;
+        const double* mpTexCord;
+        const int* mpVertexEdge;
+        const unsigned char* mpVertexFlag;
+        const int* mpEdgeTopology;
+        const unsigned char* mpEdgeFlag;
+        const int* mpFaceEdge;
+        const double* mpFaceNormal;
+        const unsigned char* mpFaceFlag;
+        const int* mpFaceIndex;
+    };
+
+    class SnapshotFile
+    {
+    public:
+        //Checks the magic bytes, the file extension is not used
+        static bool IsSnapshot(const std::string& fileName);
+
+        static bool Save(const std::string& fileName, const Point3DSet* pPointSet);
+        static bool Save(const std::string& fileName, const LightMesh3D* pMesh);
+        static bool Save(const std::string& fileName, const Mesh3D* pMesh);
+
+        //Mesh snapshots load as point sets of their vertices, LightMesh3D and Mesh3D snapshots load as each other.
+        //Same as MappedSnapshot::Open followed by Create, use MappedSnapshot to read the channels without building objects
+        static Point3DSet*  LoadPointSet(const std::string& fileName);
+        static LightMesh3D* LoadLightMesh3D(const std::string& fileName);
+        static Mesh3D*      LoadMesh3D(const std::string& fileName);
+        //Reads the header and block table only, for streaming the vertex blocks without mapping the file
+        static bool ReadPointLayout(const std::string& fileName, SnapshotPointLayout& layout);
+    };
+}
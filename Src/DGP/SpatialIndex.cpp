@@ -0,0 +1,414 @@
+#include "SpatialIndex.h"
+#include "Tool/LogSystem.h"
+#include "../Common/Parallel.h"
+#include <algorithm>
+#include <string.h>
+
+namespace MagicDGP
+{
+    //Initial neighbor buffer size of one radius query, it is doubled until all neighbors fit
+    static const int InitRadiusBufferSize = 64;
+    //Smaller kNN query sets are searched in the calling thread
+    static const int ParallelQueryNumber = 10000;
+
+    //Insert two zero bits between every bit of the low 10 bits
+    static unsigned int ExpandMortonBits(unsigned int v)
+    {
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    SpatialIndex::SpatialIndex() :
+        mFlannIndex(NULL),
+        mpData(NULL),
+        mPointNum(0),
+        mResultStride(0)
+    {
+        mSearchPara = DEFAULT_FLANN_PARAMETERS;
+        mSearchPara.algorithm = FLANN_INDEX_KDTREE;
+        mSearchPara.trees = 8;
+        mSearchPara.log_level = FLANN_LOG_INFO;
+        mSearchPara.checks = 64;
+    }
+
+    SpatialIndex::~SpatialIndex()
+    {
+        Clear();
+    }
+
+    void SpatialIndex::Build(const Point3DSet* pPointSet)
+    {
+        Clear();
+        int pointNum = pPointSet->GetPointNumber();
+        mDataSet.resize(pointNum * 3);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+            mDataSet[pid * 3 + 0] = pos[0];
+            mDataSet[pid * 3 + 1] = pos[1];
+            mDataSet[pid * 3 + 2] = pos[2];
+        }
+        BuildIndex(pointNum > 0 ? &(mDataSet[0]) : NULL, pointNum);
+    }
+
+    void SpatialIndex::Build(const std::vector<MagicMath::Vector3>& posList)
+    {
+        Clear();
+        ToFloatList(posList, mDataSet);
+        BuildIndex(mDataSet.empty() ? NULL : &(mDataSet[0]), posList.size());
+    }
+
+    void SpatialIndex::Build(const FloatView3& posView)
+    {
+        Clear();
+        if (posView.mStride == 3)
+        {
+            BuildIndex(posView.mpData, posView.mCount);
+            return;
+        }
+        mDataSet.resize(posView.mCount * 3);
+        for (int pid = 0; pid < posView.mCount; pid++)
+        {
+            const float* pPos = posView.mpData + pid * posView.mStride;
+            mDataSet[pid * 3 + 0] = pPos[0];
+            mDataSet[pid * 3 + 1] = pPos[1];
+            mDataSet[pid * 3 + 2] = pPos[2];
+        }
+        BuildIndex(mDataSet.empty() ? NULL : &(mDataSet[0]), posView.mCount);
+    }
+
+    void SpatialIndex::BuildIndex(const float* pData, int pointNum)
+    {
+        mpData = pData;
+        mPointNum = pointNum;
+        if (pointNum == 0)
+        {
+            return;
+        }
+        float speedup;
+        //FLANN does not modify the data set, it just takes a non-const pointer
+        mFlannIndex = flann_build_index(const_cast<float*>(pData), pointNum, 3, &speedup, &mSearchPara);
+    }
+
+    void SpatialIndex::Clear()
+    {
+        if (mFlannIndex != NULL)
+        {
+            flann_free_index(mFlannIndex, &mSearchPara);
+            mFlannIndex = NULL;
+        }
+        std::vector<float>().swap(mDataSet);
+        mpData = NULL;
+        mPointNum = 0;
+    }
+
+    bool SpatialIndex::IsBuilt() const
+    {
+        return mFlannIndex != NULL;
+    }
+
+    bool SpatialIndex::IsBuiltFrom(const Point3DSet* pPointSet) const
+    {
+        int pointNum = pPointSet->GetPointNumber();
+        if (!IsBuilt() || mPointNum != pointNum || mDataSet.size() != pointNum * 3)
+        {
+            return false;
+        }
+        //Compared as indexed, moves below float precision do not change the index
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            MagicMath::Vector3 pos = pPointSet->GetPoint(pid)->GetPosition();
+            float floatPos[3] = {float(pos[0]), float(pos[1]), float(pos[2])};
+            if (memcmp(floatPos, &(mDataSet[pid * 3]), sizeof(floatPos)) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int SpatialIndex::GetPointNumber() const
+    {
+        return mPointNum;
+    }
+
+    void SpatialIndex::KnnSearch(const float* pQuery, int queryNum, int nn)
+    {
+        mResultStride = nn;
+        mOffsetResult.clear();
+        KnnSearch(pQuery, queryNum, nn, mIndexResult, mDistResult);
+    }
+
+    void SpatialIndex::KnnSearch(const float* pQuery, int queryNum, int nn, std::vector<int>& indexList, std::vector<float>& distList) const
+    {
+        indexList.resize(queryNum * nn);
+        distList.resize(queryNum * nn);
+        if (mFlannIndex == NULL || queryNum == 0 || nn == 0)
+        {
+            ErrorLog << "SpatialIndex::KnnSearch: empty index or query" << std::endl;
+            std::fill(indexList.begin(), indexList.end(), -1);
+            return;
+        }
+        //FLANN takes the parameters as non-const, every search has its own copy
+        if (queryNum < ParallelQueryNumber || MagicCore::GetParallelThreadNumber() < 2)
+        {
+            FLANNParameters searchPara = mSearchPara;
+            flann_find_nearest_neighbors_index(mFlannIndex, const_cast<float*>(pQuery), queryNum, &(indexList[0]), &(distList[0]), nn, &searchPara);
+            return;
+        }
+        std::vector<int> queryOrder;
+        SortQueryByMorton(pQuery, queryNum, queryOrder);
+        //A chunk copies its queries in Morton order to a contiguous batch, searches the batch with one FLANN call
+        //and writes the neighbors to the rows of the queries
+        MagicCore::ParallelFor(0, queryNum, [&](int startIndex, int endIndex)
+        {
+            int batchNum = endIndex - startIndex;
+            std::vector<float> batchQuery(batchNum * 3);
+            for (int oid = startIndex; oid < endIndex; oid++)
+            {
+                const float* pPos = pQuery + queryOrder[oid] * 3;
+                float* pBatchPos = &(batchQuery[(oid - startIndex) * 3]);
+                pBatchPos[0] = pPos[0];
+                pBatchPos[1] = pPos[1];
+                pBatchPos[2] = pPos[2];
+            }
+            std::vector<int> batchIndex(batchNum * nn);
+            std::vector<float> batchDist(batchNum * nn);
+            FLANNParameters searchPara = mSearchPara;
+            flann_find_nearest_neighbors_index(mFlannIndex, &(batchQuery[0]), batchNum, &(batchIndex[0]), &(batchDist[0]), nn, &searchPara);
+            for (int oid = startIndex; oid < endIndex; oid++)
+            {
+                int qid = queryOrder[oid];
+                int batchBase = (oid - startIndex) * nn;
+                std::copy(batchIndex.begin() + batchBase, batchIndex.begin() + batchBase + nn, indexList.begin() + qid * nn);
+                std::copy(batchDist.begin() + batchBase, batchDist.begin() + batchBase + nn, distList.begin() + qid * nn);
+            }
+        });
+    }
+
+    void SpatialIndex::SortQueryByMorton(const float* pQuery, int queryNum, std::vector<int>& queryOrder) const
+    {
+        float bboxMin[3] = {pQuery[0], pQuery[1], pQuery[2]};
+        float bboxMax[3] = {pQuery[0], pQuery[1], pQuery[2]};
+        for (int qid = 1; qid < queryNum; qid++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                float v = pQuery[qid * 3 + k];
+                bboxMin[k] = v < bboxMin[k] ? v : bboxMin[k];
+                bboxMax[k] = v > bboxMax[k] ? v : bboxMax[k];
+            }
+        }
+        float scale[3];
+        for (int k = 0; k < 3; k++)
+        {
+            float range = bboxMax[k] - bboxMin[k];
+            scale[k] = range > 0 ? 1023.f / range : 0;
+        }
+        std::vector<unsigned int> codeList(queryNum);
+        queryOrder.resize(queryNum);
+        for (int qid = 0; qid < queryNum; qid++)
+        {
+            const float* pPos = pQuery + qid * 3;
+            unsigned int x = (unsigned int)((pPos[0] - bboxMin[0]) * scale[0]);
+            unsigned int y = (unsigned int)((pPos[1] - bboxMin[1]) * scale[1]);
+            unsigned int z = (unsigned int)((pPos[2] - bboxMin[2]) * scale[2]);
+            codeList[qid] = (ExpandMortonBits(x) << 2) | (ExpandMortonBits(y) << 1) | ExpandMortonBits(z);
+            queryOrder[qid] = qid;
+        }
+        //LSD radix sort of the 30 bit codes, two passes of 15 bits
+        std::vector<unsigned int> codeTemp(queryNum);
+        std::vector<int> orderTemp(queryNum);
+        std::vector<int> bucketList(1 << 15);
+        for (int shift = 0; shift < 30; shift += 15)
+        {
+            std::fill(bucketList.begin(), bucketList.end(), 0);
+            for (int qid = 0; qid < queryNum; qid++)
+            {
+                bucketList[(codeList[qid] >> shift) & 0x7FFF]++;
+            }
+            int offset = 0;
+            for (int bid = 0; bid < (1 << 15); bid++)
+            {
+                int count = bucketList[bid];
+                bucketList[bid] = offset;
+                offset += count;
+            }
+            for (int qid = 0; qid < queryNum; qid++)
+            {
+                int sortedIndex = bucketList[(codeList[qid] >> shift) & 0x7FFF]++;
+                codeTemp[sortedIndex] = codeList[qid];
+                orderTemp[sortedIndex] = queryOrder[qid];
+            }
+            codeList.swap(codeTemp);
+            queryOrder.swap(orderTemp);
+        }
+    }
+
+    void SpatialIndex::KnnSearch(const std::vector<MagicMath::Vector3>& queryList, int nn)
+    {
+        ToFloatList(queryList, mQueryBuffer);
+        KnnSearch(mQueryBuffer.empty() ? NULL : &(mQueryBuffer[0]), queryList.size(), nn);
+    }
+
+    void SpatialIndex::KnnSearchSelf(int nn)
+    {
+        KnnSearch(mpData, mPointNum, nn);
+    }
+
+    void SpatialIndex::KnnSearch(const std::vector<MagicMath::Vector3>& queryList, int nn, std::vector<int>& indexList, std::vector<float>& distList) const
+    {
+        std::vector<float> queryData;
+        ToFloatList(queryList, queryData);
+        KnnSearch(queryData.empty() ? NULL : &(queryData[0]), queryList.size(), nn, indexList, distList);
+    }
+
+    void SpatialIndex::KnnSearchSelf(int nn, std::vector<int>& indexList, std::vector<float>& distList) const
+    {
+        KnnSearch(mpData, mPointNum, nn, indexList, distList);
+    }
+
+    void SpatialIndex::RadiusSearch(const float* pQuery, int queryNum, double radius)
+    {
+        RadiusSearch(pQuery, queryNum, radius, 0);
+    }
+
+    void SpatialIndex::RadiusSearch(const std::vector<MagicMath::Vector3>& queryList, double radius)
+    {
+        RadiusSearch(queryList, radius, 0);
+    }
+
+    void SpatialIndex::RadiusSearchSelf(double radius)
+    {
+        RadiusSearch(mpData, mPointNum, radius, 0);
+    }
+
+    void SpatialIndex::RadiusSearch(const float* pQuery, int queryNum, double radius, int maxNN)
+    {
+        mResultStride = 0;
+        RadiusSearch(pQuery, queryNum, radius, maxNN, mIndexResult, mDistResult, mOffsetResult);
+    }
+
+    void SpatialIndex::RadiusSearch(const float* pQuery, int queryNum, double radius, int maxNN, std::vector<int>& indexList, 
+        std::vector<float>& distList, std::vector<int>& offsetList) const
+    {
+        //maxNN <= 0 means no limit
+        indexList.clear();
+        distList.clear();
+        offsetList.assign(queryNum + 1, 0);
+        if (mFlannIndex == NULL || queryNum == 0)
+        {
+            return;
+        }
+        //Unlimited checks make the kd-tree search exact
+        FLANNParameters radiusPara = mSearchPara;
+        radiusPara.checks = FLANN_CHECKS_UNLIMITED;
+        float squaredRadius = radius * radius;
+        int bufferSize = (maxNN > 0 && maxNN < InitRadiusBufferSize) ? maxNN : InitRadiusBufferSize;
+        std::vector<int> radiusIndexBuffer(bufferSize);
+        std::vector<float> radiusDistBuffer(bufferSize);
+        for (int qid = 0; qid < queryNum; qid++)
+        {
+            float* pCurQuery = const_cast<float*>(pQuery + qid * 3);
+            int resNum = flann_radius_search(mFlannIndex, pCurQuery, &(radiusIndexBuffer[0]), &(radiusDistBuffer[0]), 
+                bufferSize, squaredRadius, &radiusPara);
+            //A full buffer may have dropped neighbors, search again with a larger one
+            while (resNum >= bufferSize && bufferSize != maxNN)
+            {
+                bufferSize *= 2;
+                if (maxNN > 0 && bufferSize > maxNN)
+                {
+                    bufferSize = maxNN;
+                }
+                if (int(radiusIndexBuffer.size()) < bufferSize)
+                {
+                    radiusIndexBuffer.resize(bufferSize);
+                    radiusDistBuffer.resize(bufferSize);
+                }
+                resNum = flann_radius_search(mFlannIndex, pCurQuery, &(radiusIndexBuffer[0]), &(radiusDistBuffer[0]), 
+                    bufferSize, squaredRadius, &radiusPara);
+            }
+            if (resNum > bufferSize)
+            {
+                resNum = bufferSize;
+            }
+            indexList.insert(indexList.end(), radiusIndexBuffer.begin(), radiusIndexBuffer.begin() + resNum);
+            distList.insert(distList.end(), radiusDistBuffer.begin(), radiusDistBuffer.begin() + resNum);
+            offsetList[qid + 1] = indexList.size();
+        }
+    }
+
+    void SpatialIndex::RadiusSearch(const std::vector<MagicMath::Vector3>& queryList, double radius, int maxNN)
+    {
+        ToFloatList(queryList, mQueryBuffer);
+        RadiusSearch(mQueryBuffer.empty() ? NULL : &(mQueryBuffer[0]), queryList.size(), radius, maxNN);
+    }
+
+    void SpatialIndex::RadiusSearchSelf(double radius, int maxNN)
+    {
+        RadiusSearch(mpData, mPointNum, radius, maxNN);
+    }
+
+    void SpatialIndex::RadiusSearch(const std::vector<MagicMath::Vector3>& queryList, double radius, int maxNN, std::vector<int>& indexList, 
+        std::vector<float>& distList, std::vector<int>& offsetList) const
+    {
+        std::vector<float> queryData;
+        ToFloatList(queryList, queryData);
+        RadiusSearch(queryData.empty() ? NULL : &(queryData[0]), queryList.size(), radius, maxNN, indexList, distList, offsetList);
+    }
+
+    void SpatialIndex::RadiusSearchSelf(double radius, int maxNN, std::vector<int>& indexList, std::vector<float>& distList, 
+        std::vector<int>& offsetList) const
+    {
+        RadiusSearch(mpData, mPointNum, radius, maxNN, indexList, distList, offsetList);
+    }
+
+    const int* SpatialIndex::GetIndexResult() const
+    {
+        return mIndexResult.empty() ? NULL : &(mIndexResult[0]);
+    }
+
+    const float* SpatialIndex::GetDistResult() const
+    {
+        return mDistResult.empty() ? NULL : &(mDistResult[0]);
+    }
+
+    const int* SpatialIndex::GetOffsetResult() const
+    {
+        return mOffsetResult.empty() ? NULL : &(mOffsetResult[0]);
+    }
+
+    int SpatialIndex::GetNeighborStart(int queryId) const
+    {
+        if (mResultStride > 0)
+        {
+            return queryId * mResultStride;
+        }
+        return mOffsetResult.at(queryId);
+    }
+
+    int SpatialIndex::GetNeighborNumber(int queryId) const
+    {
+        if (mResultStride > 0)
+        {
+            return mResultStride;
+        }
+        return mOffsetResult.at(queryId + 1) - mOffsetResult.at(queryId);
+    }
+
+    void SpatialIndex::ToFloatList(const std::vector<MagicMath::Vector3>& posList, std::vector<float>& floatList) const
+    {
+        int posNum = posList.size();
+        floatList.resize(posNum * 3);
+        for (int pid = 0; pid < posNum; pid++)
+        {
+            const MagicMath::Vector3& pos = posList.at(pid);
+            floatList[pid * 3 + 0] = pos[0];
+            floatList[pid * 3 + 1] = pos[1];
+            floatList[pid * 3 + 2] = pos[2];
+        }
+    }
+}
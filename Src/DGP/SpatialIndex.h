@@ -0,0 +1,74 @@
+#pragma once
+#include "PointCloud3D.h"
+#include "flann/flann.h"
+#include <vector>
+
+namespace MagicDGP
+{
+    //kNN and radius search on a fixed 3D point set, it wraps FLANN kd-tree forest.
+    //The search functions with result vectors only read the index, they can be called from several threads.
+    //The others keep the results of the last query in buffers which are reused by the next query.
+    //Large kNN query sets are sorted in Morton order and searched in contiguous batches on the parallel pool.
+    class SpatialIndex
+    {
+    public:
+        SpatialIndex();
+        ~SpatialIndex();
+
+        void Build(const Point3DSet* pPointSet);
+        void Build(const std::vector<MagicMath::Vector3>& posList);
+        //Packed data (stride 3) is used in place and must be alive until Clear
+        void Build(const FloatView3& posView);
+        void Clear();
+        bool IsBuilt() const;
+        //True if the index was built from pPointSet and its positions have not changed since
+        bool IsBuiltFrom(const Point3DSet* pPointSet) const;
+        int  GetPointNumber() const;
+
+        //Neighbors of query qid are [qid * nn, qid * nn + nn) of the result buffers
+        void KnnSearch(const float* pQuery, int queryNum, int nn);
+        void KnnSearch(const std::vector<MagicMath::Vector3>& queryList, int nn);
+        void KnnSearchSelf(int nn); //every indexed point is a query
+        //Exact search of all neighbors within radius, sorted by distance. Results are in CSR layout:
+        //neighbors of query qid are [offset[qid], offset[qid + 1]) of the result buffers
+        void RadiusSearch(const float* pQuery, int queryNum, double radius);
+        void RadiusSearch(const std::vector<MagicMath::Vector3>& queryList, double radius);
+        void RadiusSearchSelf(double radius);
+        //Same as above, but only the maxNN nearest neighbors are kept for each query
+        void RadiusSearch(const float* pQuery, int queryNum, double radius, int maxNN);
+        void RadiusSearch(const std::vector<MagicMath::Vector3>& queryList, double radius, int maxNN);
+        void RadiusSearchSelf(double radius, int maxNN);
+        //Same searches with the results in the vectors of the caller, maxNN <= 0 means no limit
+        void KnnSearch(const float* pQuery, int queryNum, int nn, std::vector<int>& indexList, std::vector<float>& distList) const;
+        void KnnSearch(const std::vector<MagicMath::Vector3>& queryList, int nn, std::vector<int>& indexList, std::vector<float>& distList) const;
+        void KnnSearchSelf(int nn, std::vector<int>& indexList, std::vector<float>& distList) const;
+        void RadiusSearch(const float* pQuery, int queryNum, double radius, int maxNN, std::vector<int>& indexList, 
+            std::vector<float>& distList, std::vector<int>& offsetList) const;
+        void RadiusSearch(const std::vector<MagicMath::Vector3>& queryList, double radius, int maxNN, std::vector<int>& indexList, 
+            std::vector<float>& distList, std::vector<int>& offsetList) const;
+        void RadiusSearchSelf(double radius, int maxNN, std::vector<int>& indexList, std::vector<float>& distList, std::vector<int>& offsetList) const;
+
+        const int* GetIndexResult() const;
+        const float* GetDistResult() const; //Squared distance
+        const int* GetOffsetResult() const; //queryNum + 1 offsets, radius search only
+        int GetNeighborStart(int queryId) const;
+        int GetNeighborNumber(int queryId) const;
+
+    private:
+        void BuildIndex(const float* pData, int pointNum);
+        void SortQueryByMorton(const float* pQuery, int queryNum, std::vector<int>& queryOrder) const;
+        void ToFloatList(const std::vector<MagicMath::Vector3>& posList, std::vector<float>& floatList) const;
+
+    private:
+        flann_index_t mFlannIndex;
+        FLANNParameters mSearchPara;
+        std::vector<float> mDataSet; //Copy of positions, empty when data is used in place
+        const float* mpData;
+        int mPointNum;
+        std::vector<int> mIndexResult;
+        std::vector<float> mDistResult;
+        std::vector<int> mOffsetResult;
+        std::vector<float> mQueryBuffer;
+        int mResultStride; //nn of kNN search, 0 for radius search
+    };
+}
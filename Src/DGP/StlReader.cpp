@@ -0,0 +1,325 @@
+#include "StlReader.h"
+#include "MappedFile.h"
+#include "NumberParser.h"
+#include "Tool/LogSystem.h"
+#include "../Common/Parallel.h"
+#include "../Common/ToolKit.h"
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+    //Vertex vid of a triangle soup is the 3 floats at mpData + (vid / 3) * mTriangleStride + (vid % 3) * 12
+    struct TriangleSoup
+    {
+        const char* mpData;
+        int mTriangleStride;
+        double mWeldEpsilon;
+
+        void GetVertex(int vid, float* pPos) const
+        {
+            memcpy(pPos, mpData + size_t(vid / 3) * mTriangleStride + (vid % 3) * 12, sizeof(float) * 3);
+        }
+
+        //Float bits in exact mode, grid cell in epsilon mode
+        void GetKey(int vid, unsigned int* pKey) const
+        {
+            float pos[3];
+            GetVertex(vid, pos);
+            for (int k = 0; k < 3; k++)
+            {
+                if (mWeldEpsilon > 0)
+                {
+                    double cell = floor(pos[k] / mWeldEpsilon);
+                    cell = cell < -2147483647.0 ? -2147483647.0 : (cell > 2147483647.0 ? 2147483647.0 : cell);
+                    pKey[k] = (unsigned int)(int)cell;
+                }
+                else
+                {
+                    float value = (pos[k] == 0) ? 0.f : pos[k]; //-0 and 0 are the same vertex
+                    memcpy(pKey + k, &value, sizeof(float));
+                }
+            }
+        }
+    };
+
+    unsigned int HashKey(const unsigned int* pKey)
+    {
+        unsigned int hash = pKey[0] * 73856093u ^ pKey[1] * 19349663u ^ pKey[2] * 83492791u;
+        //murmur3 finalizer, so that both high bits (partition) and low bits (slot) are mixed
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6Bu;
+        hash ^= hash >> 13;
+        hash *= 0xC2B2AE35u;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    //Open addressing weld of one hash partition. Vertices are inserted in increasing index order,
+    //so the representative of a vertex is its first occurrence.
+    void WeldPartition(const TriangleSoup& soup, const int* pVertexList, int vertNum, const unsigned int* pHashList, int* pRepresentList)
+    {
+        int tableSize = 1;
+        while (tableSize < vertNum * 2)
+        {
+            tableSize *= 2;
+        }
+        unsigned int mask = tableSize - 1;
+        std::vector<int> table(tableSize, -1);
+        unsigned int key[3], otherKey[3];
+        for (int lid = 0; lid < vertNum; lid++)
+        {
+            int vid = pVertexList[lid];
+            unsigned int hash = pHashList[vid];
+            soup.GetKey(vid, key);
+            unsigned int slot = hash & mask;
+            while (true)
+            {
+                int otherId = table[slot];
+                if (otherId == -1)
+                {
+                    table[slot] = vid;
+                    pRepresentList[vid] = vid;
+                    break;
+                }
+                if (pHashList[otherId] == hash)
+                {
+                    soup.GetKey(otherId, otherKey);
+                    if (key[0] == otherKey[0] && key[1] == otherKey[1] && key[2] == otherKey[2])
+                    {
+                        pRepresentList[vid] = otherId;
+                        break;
+                    }
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    }
+
+    bool IsBinaryStl(const char* pData, size_t dataSize)
+    {
+        if (dataSize < 84)
+        {
+            return false;
+        }
+        unsigned int faceNum;
+        memcpy(&faceNum, pData + 80, sizeof(unsigned int));
+        if (84 + size_t(faceNum) * 50 == dataSize)
+        {
+            return true;
+        }
+        if (strncmp(pData, "solid", 5) != 0)
+        {
+            return true;
+        }
+        size_t checkEnd = dataSize < 84 + 128 ? dataSize : 84 + 128;
+        for (size_t cid = 84; cid < checkEnd; cid++)
+        {
+            if ((unsigned char)pData[cid] > 127)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //Collect the "vertex x y z" lines, 9 floats per facet
+    void ParseAsciiStl(const char* pData, size_t dataSize, std::vector<float>& posList)
+    {
+        const char* pEnd = pData + dataSize;
+        const char* pLine = pData;
+        while (pLine < pEnd)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(pLine, '\n', pEnd - pLine));
+            if (pLineEnd == NULL)
+            {
+                pLineEnd = pEnd;
+            }
+            const char* pCur = MagicDGP::NumberParser::SkipSpace(pLine, pLineEnd);
+            if (pLineEnd - pCur > 6 && strncmp(pCur, "vertex", 6) == 0)
+            {
+                pCur += 6;
+                for (int k = 0; k < 3; k++)
+                {
+                    double value = 0;
+                    pCur = MagicDGP::NumberParser::SkipSpace(pCur, pLineEnd);
+                    const char* pNext = MagicDGP::NumberParser::ParseDouble(pCur, pLineEnd, value);
+                    if (pNext != NULL)
+                    {
+                        pCur = pNext;
+                    }
+                    posList.push_back(float(value));
+                }
+            }
+            pLine = pLineEnd + 1;
+        }
+        if (posList.size() % 9 != 0)
+        {
+            WarnLog << "StlReader: incomplete facet at the end of file" << std::endl;
+            posList.resize(posList.size() / 9 * 9);
+        }
+    }
+}
+
+namespace MagicDGP
+{
+    //Smaller soups are welded in the calling thread
+    static const int ParallelVertexNumber = 100000;
+
+    StlReader::StlReader() :
+        mDegenerateNum(0)
+    {
+    }
+
+    StlReader::~StlReader()
+    {
+    }
+
+    bool StlReader::Read(const std::string& fileName, double weldEpsilon)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        ClearData();
+        MappedFile mappedFile;
+        if (!mappedFile.Open(fileName))
+        {
+            return false;
+        }
+        const char* pData = mappedFile.GetData();
+        size_t dataSize = mappedFile.GetSize();
+        TriangleSoup soup;
+        soup.mWeldEpsilon = weldEpsilon;
+        std::vector<float> asciiPosList;
+        int triangleNum = 0;
+        if (IsBinaryStl(pData, dataSize))
+        {
+            unsigned int faceNum;
+            memcpy(&faceNum, pData + 80, sizeof(unsigned int));
+            if (84 + size_t(faceNum) * 50 > dataSize)
+            {
+                WarnLog << "StlReader: file is shorter than " << faceNum << " triangles" << std::endl;
+                faceNum = (unsigned int)((dataSize - 84) / 50);
+            }
+            triangleNum = faceNum;
+            //each 50 byte record: normal, 3 vertices, attribute
+            soup.mpData = pData + 84 + 12;
+            soup.mTriangleStride = 50;
+        }
+        else if (dataSize > 0)
+        {
+            ParseAsciiStl(pData, dataSize, asciiPosList);
+            triangleNum = asciiPosList.size() / 9;
+            soup.mpData = triangleNum > 0 ? reinterpret_cast<const char*>(&(asciiPosList[0])) : NULL;
+            soup.mTriangleStride = sizeof(float) * 9;
+        }
+        int vertNum = triangleNum * 3;
+        if (vertNum == 0)
+        {
+            return true;
+        }
+
+        int taskNum = vertNum < ParallelVertexNumber ? 1 : MagicCore::GetParallelThreadNumber() * 4;
+        //hash all vertices
+        std::vector<unsigned int> hashList(vertNum);
+        MagicCore::ParallelFor(0, vertNum, [&](int startIndex, int endIndex)
+        {
+            unsigned int key[3];
+            for (int vid = startIndex; vid < endIndex; vid++)
+            {
+                soup.GetKey(vid, key);
+                hashList[vid] = HashKey(key);
+            }
+        }, ParallelVertexNumber / 4);
+        //counting sort vertices by the high bits of hash, vertex order is kept in every partition
+        int partitionBits = 0;
+        while ((1 << partitionBits) < taskNum)
+        {
+            partitionBits++;
+        }
+        int partitionNum = 1 << partitionBits;
+        std::vector<int> partitionStart(partitionNum + 1, 0);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            int partitionId = partitionBits == 0 ? 0 : int(hashList[vid] >> (32 - partitionBits));
+            partitionStart[partitionId + 1]++;
+        }
+        for (int pid = 0; pid < partitionNum; pid++)
+        {
+            partitionStart[pid + 1] += partitionStart[pid];
+        }
+        std::vector<int> vertexOrder(vertNum);
+        std::vector<int> cursorList(partitionStart.begin(), partitionStart.end() - 1);
+        for (int vid = 0; vid < vertNum; vid++)
+        {
+            int partitionId = partitionBits == 0 ? 0 : int(hashList[vid] >> (32 - partitionBits));
+            vertexOrder[cursorList[partitionId]++] = vid;
+        }
+        //weld every partition
+        std::vector<int> representList(vertNum);
+        MagicCore::ParallelFor(0, partitionNum, [&](int startPartition, int endPartition)
+        {
+            for (int pid = startPartition; pid < endPartition; pid++)
+            {
+                int partitionSize = partitionStart[pid + 1] - partitionStart[pid];
+                if (partitionSize > 0)
+                {
+                    WeldPartition(soup, &(vertexOrder[partitionStart[pid]]), partitionSize, &(hashList[0]), &(representList[0]));
+                }
+            }
+        }, 1);
+        std::vector<unsigned int>().swap(hashList);
+        std::vector<int>().swap(vertexOrder);
+        //number welded vertices by first occurrence
+        std::vector<int> newIdList(vertNum, -1);
+        mIndexList.reserve(vertNum);
+        for (int fid = 0; fid < triangleNum; fid++)
+        {
+            int represent[3] = {representList[fid * 3], representList[fid * 3 + 1], representList[fid * 3 + 2]};
+            if (represent[0] == represent[1] || represent[1] == represent[2] || represent[0] == represent[2])
+            {
+                mDegenerateNum++;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                int& newId = newIdList[represent[k]];
+                if (newId == -1)
+                {
+                    newId = mPositionList.size();
+                    float pos[3];
+                    soup.GetVertex(represent[k], pos);
+                    mPositionList.push_back(MagicMath::Vector3(pos[0], pos[1], pos[2]));
+                }
+                mIndexList.push_back(newId);
+            }
+        }
+        if (mDegenerateNum > 0)
+        {
+            InfoLog << "StlReader: " << mDegenerateNum << " degenerate triangles are skipped" << std::endl;
+        }
+        DebugLog << "StlReader::Read: " << triangleNum << " triangles, " << mPositionList.size() << " vertices, time: "
+            << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return true;
+    }
+
+    void StlReader::ClearData()
+    {
+        std::vector<MagicMath::Vector3>().swap(mPositionList);
+        std::vector<int>().swap(mIndexList);
+        mDegenerateNum = 0;
+    }
+
+    const std::vector<MagicMath::Vector3>& StlReader::GetPositionList() const
+    {
+        return mPositionList;
+    }
+
+    const std::vector<int>& StlReader::GetIndexList() const
+    {
+        return mIndexList;
+    }
+
+    int StlReader::GetDegenerateNumber() const
+    {
+        return mDegenerateNum;
+    }
+}
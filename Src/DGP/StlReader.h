@@ -0,0 +1,31 @@
+#pragma once
+#include "Math/Vector3.h"
+#include <vector>
+#include <string>
+
+namespace MagicDGP
+{
+    //STL reader for large files. Binary records are read from the memory mapped file in place,
+    //and the triangle soup is welded by a parallel hash on the vertex coordinates.
+    class StlReader
+    {
+    public:
+        StlReader();
+        ~StlReader();
+
+        //weldEpsilon <= 0: vertices with exactly the same coordinates are welded.
+        //weldEpsilon > 0: vertices in the same weldEpsilon sized grid cell are welded.
+        //Vertex order is the order of first occurrence, triangles which become degenerate are skipped.
+        bool Read(const std::string& fileName, double weldEpsilon = 0);
+        void ClearData();
+
+        const std::vector<MagicMath::Vector3>& GetPositionList() const;
+        const std::vector<int>& GetIndexList() const; //3 vertex indices per triangle
+        int GetDegenerateNumber() const;
+
+    private:
+        std::vector<MagicMath::Vector3> mPositionList;
+        std::vector<int> mIndexList;
+        int mDegenerateNum;
+    };
+}
@@ -0,0 +1,934 @@
+#include "StreamConsolidation.h"
+#include "PointStream.h"
+#include "SpatialIndex.h"
+#include "Tool/LogSystem.h"
+#include "../Common/ToolKit.h"
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <map>
+#include <algorithm>
+
+namespace
+{
+    //Bins of the point histogram along the slab axis
+    const int SlabHistogramSize = 4096;
+    //Slab files open at the same time, more slabs are written in several passes
+    const int MaxOpenSlabNumber = 64;
+    //Levels of histogram refinement for bins with more points than a slab
+    const int MaxHistogramRefineLevel = 2;
+    //Points of the first chunk used to estimate the halo width
+    const int HaloSampleNumber = 1 << 16;
+
+    struct SlabData
+    {
+        std::vector<float> mPositionList; //core points first, then halo points
+        std::vector<MagicMath::Vector3> mNormalList; //core points only
+        std::vector<MagicMath::Vector3> mColorList; //core points only
+        std::vector<MagicMath::Vector3> mCorePositionList;
+        int mCoreNumber;
+    };
+
+    //Points spilled into slab files, records are doubles: halo flag, position, [normal], [color]
+    class SlabPartition
+    {
+    public:
+        SlabPartition() :
+            mFileName(),
+            mAxis(0),
+            mHaloWidth(0),
+            mBoundaryList(),
+            mHasNormal(false),
+            mHasColor(false),
+            mPointNumber(0)
+        {
+        }
+
+        ~SlabPartition()
+        {
+            RemoveFiles();
+        }
+
+        //Reads the file three times: bbox, histogram, spill
+        bool Build(const std::string& fileName, int slabPointNum, int nn)
+        {
+            mFileName = fileName;
+            MagicMath::Vector3 bboxMin, bboxMax;
+            if (!MagicDGP::StreamConsolidation::CalculateBBox(fileName, bboxMin, bboxMax, mPointNumber) || mPointNumber == 0)
+            {
+                return false;
+            }
+            MagicMath::Vector3 bboxSize = bboxMax - bboxMin;
+            mAxis = (bboxSize[0] >= bboxSize[1] && bboxSize[0] >= bboxSize[2]) ? 0 : (bboxSize[1] >= bboxSize[2] ? 1 : 2);
+            if (!BuildBoundary(bboxMin[mAxis], bboxMax[mAxis], slabPointNum, nn))
+            {
+                return false;
+            }
+            for (int groupStart = 0; groupStart < GetSlabNumber(); groupStart += MaxOpenSlabNumber)
+            {
+                if (!WriteSlabs(groupStart, std::min(groupStart + MaxOpenSlabNumber, GetSlabNumber())))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        int GetSlabNumber() const
+        {
+            return int(mBoundaryList.size()) - 1;
+        }
+
+        bool HasNormal() const
+        {
+            return mHasNormal;
+        }
+
+        bool HasColor() const
+        {
+            return mHasColor;
+        }
+
+        long long GetPointNumber() const
+        {
+            return mPointNumber;
+        }
+
+        int GetAxis() const
+        {
+            return mAxis;
+        }
+
+        double GetHaloWidth() const
+        {
+            return mHaloWidth;
+        }
+
+        //Axis range of the core points of a slab, the first and the last slab are open to the outside
+        double GetSlabMin(int slabIndex) const
+        {
+            return slabIndex == 0 ? -DBL_MAX : mBoundaryList.at(slabIndex);
+        }
+
+        double GetSlabMax(int slabIndex) const
+        {
+            return slabIndex + 1 == GetSlabNumber() ? DBL_MAX : mBoundaryList.at(slabIndex + 1);
+        }
+
+        //Halo points are skipped if needHalo is false
+        bool LoadSlab(int slabIndex, bool needHalo, SlabData& data) const
+        {
+            data.mPositionList.clear();
+            data.mNormalList.clear();
+            data.mColorList.clear();
+            data.mCorePositionList.clear();
+            FILE* pFile = fopen(GetSlabFileName(slabIndex).c_str(), "rb");
+            if (pFile == NULL)
+            {
+                ErrorLog << "StreamConsolidation: can not open slab " << slabIndex << std::endl;
+                return false;
+            }
+            int recordSize = GetRecordSize();
+            std::vector<double> recordList(recordSize * 4096);
+            std::vector<float> haloList;
+            while (true)
+            {
+                size_t recordNum = fread(&(recordList[0]), sizeof(double) * recordSize, 4096, pFile);
+                if (recordNum == 0)
+                {
+                    break;
+                }
+                for (size_t rid = 0; rid < recordNum; rid++)
+                {
+                    const double* pRecord = &(recordList[rid * recordSize]);
+                    if (pRecord[0] != 0)
+                    {
+                        if (needHalo)
+                        {
+                            haloList.push_back(float(pRecord[1]));
+                            haloList.push_back(float(pRecord[2]));
+                            haloList.push_back(float(pRecord[3]));
+                        }
+                        continue;
+                    }
+                    MagicMath::Vector3 pos(pRecord[1], pRecord[2], pRecord[3]);
+                    data.mCorePositionList.push_back(pos);
+                    data.mPositionList.push_back(float(pos[0]));
+                    data.mPositionList.push_back(float(pos[1]));
+                    data.mPositionList.push_back(float(pos[2]));
+                    const double* pAttribute = pRecord + 4;
+                    if (mHasNormal)
+                    {
+                        data.mNormalList.push_back(MagicMath::Vector3(pAttribute[0], pAttribute[1], pAttribute[2]));
+                        pAttribute += 3;
+                    }
+                    if (mHasColor)
+                    {
+                        data.mColorList.push_back(MagicMath::Vector3(pAttribute[0], pAttribute[1], pAttribute[2]));
+                    }
+                }
+            }
+            fclose(pFile);
+            data.mCoreNumber = data.mCorePositionList.size();
+            data.mPositionList.insert(data.mPositionList.end(), haloList.begin(), haloList.end());
+            return true;
+        }
+
+        std::string GetSlabFileName(int slabIndex) const
+        {
+            char postfix[32];
+            sprintf(postfix, ".slab%d.tmp", slabIndex);
+            return mFileName + postfix;
+        }
+
+        void RemoveFiles()
+        {
+            for (int sid = 0; sid < GetSlabNumber(); sid++)
+            {
+                remove(GetSlabFileName(sid).c_str());
+                remove((GetSlabFileName(sid) + ".dist").c_str());
+            }
+        }
+
+    private:
+        int GetRecordSize() const
+        {
+            return 4 + (mHasNormal ? 3 : 0) + (mHasColor ? 3 : 0);
+        }
+
+        //Slabs are unions of histogram bins with at most slabPointNum points. Denser bins are split by reading
+        //the file again, a bin which can not be split fails the partition.
+        bool BuildBoundary(double axisMin, double axisMax, int slabPointNum, int nn)
+        {
+            MagicDGP::PointStreamReader reader;
+            if (!reader.Open(mFileName))
+            {
+                return false;
+            }
+            mHasNormal = reader.HasNormal();
+            mHasColor = reader.HasColor();
+            std::vector<long long> histogram(SlabHistogramSize, 0);
+            double binSize = (axisMax - axisMin) / SlabHistogramSize;
+            if (binSize <= 0)
+            {
+                binSize = 1;
+            }
+            MagicDGP::PointChunk chunk;
+            bool isFirstChunk = true;
+            while (reader.ReadChunk(chunk))
+            {
+                if (isFirstChunk)
+                {
+                    EstimateHaloWidth(chunk, nn);
+                    isFirstChunk = false;
+                }
+                for (std::vector<MagicMath::Vector3>::iterator itr = chunk.mPositionList.begin(); itr != chunk.mPositionList.end(); itr++)
+                {
+                    int bin = int(((*itr)[mAxis] - axisMin) / binSize);
+                    histogram.at(std::max(0, std::min(SlabHistogramSize - 1, bin)))++;
+                }
+            }
+            if (reader.IsFailed())
+            {
+                return false;
+            }
+            std::vector<double> binStartList(SlabHistogramSize);
+            for (int bid = 0; bid < SlabHistogramSize; bid++)
+            {
+                binStartList.at(bid) = axisMin + binSize * bid;
+            }
+            for (int level = 0; level < MaxHistogramRefineLevel; level++)
+            {
+                if (!RefineHistogram(binStartList, histogram, axisMax, slabPointNum))
+                {
+                    return false;
+                }
+            }
+            mBoundaryList.clear();
+            mBoundaryList.push_back(axisMin);
+            long long slabCount = 0;
+            for (int bid = 0; bid < int(histogram.size()); bid++)
+            {
+                if (histogram.at(bid) > slabPointNum)
+                {
+                    ErrorLog << "StreamConsolidation: " << histogram.at(bid) << " points share one slab coordinate, slab limit: "
+                        << slabPointNum << std::endl;
+                    return false;
+                }
+                if (slabCount > 0 && slabCount + histogram.at(bid) > slabPointNum)
+                {
+                    mBoundaryList.push_back(binStartList.at(bid));
+                    slabCount = 0;
+                }
+                slabCount += histogram.at(bid);
+            }
+            mBoundaryList.push_back(axisMax);
+            DebugLog << "StreamConsolidation: " << GetSlabNumber() << " slabs on axis " << mAxis << ", halo width: " << mHaloWidth << std::endl;
+            return true;
+        }
+
+        //Bins with more than slabPointNum points are replaced by SlabHistogramSize sub bins. Points are binned by
+        //the bin starts as in WriteSlabs.
+        bool RefineHistogram(std::vector<double>& binStartList, std::vector<long long>& histogram, double axisMax, int slabPointNum)
+        {
+            int binNum = histogram.size();
+            std::vector<int> denseIndexList(binNum, -1);
+            int denseNum = 0;
+            for (int bid = 0; bid < binNum; bid++)
+            {
+                if (histogram.at(bid) > slabPointNum)
+                {
+                    denseIndexList.at(bid) = denseNum++;
+                }
+            }
+            if (denseNum == 0)
+            {
+                return true;
+            }
+            std::vector<long long> subHistogram(denseNum * SlabHistogramSize, 0);
+            MagicDGP::PointStreamReader reader;
+            if (!reader.Open(mFileName))
+            {
+                return false;
+            }
+            MagicDGP::PointChunk chunk;
+            while (reader.ReadChunk(chunk))
+            {
+                for (std::vector<MagicMath::Vector3>::iterator itr = chunk.mPositionList.begin(); itr != chunk.mPositionList.end(); itr++)
+                {
+                    double coord = (*itr)[mAxis];
+                    int bid = std::max(0, int(std::upper_bound(binStartList.begin(), binStartList.end(), coord) - binStartList.begin()) - 1);
+                    int denseIndex = denseIndexList.at(bid);
+                    if (denseIndex == -1)
+                    {
+                        continue;
+                    }
+                    double binStart = binStartList.at(bid);
+                    double binEnd = (bid + 1 < binNum) ? binStartList.at(bid + 1) : axisMax;
+                    int subBin = int((coord - binStart) / (binEnd - binStart) * SlabHistogramSize);
+                    subHistogram.at(denseIndex * SlabHistogramSize + std::max(0, std::min(SlabHistogramSize - 1, subBin)))++;
+                }
+            }
+            if (reader.IsFailed())
+            {
+                return false;
+            }
+            std::vector<double> newStartList;
+            std::vector<long long> newHistogram;
+            for (int bid = 0; bid < binNum; bid++)
+            {
+                int denseIndex = denseIndexList.at(bid);
+                if (denseIndex == -1)
+                {
+                    newStartList.push_back(binStartList.at(bid));
+                    newHistogram.push_back(histogram.at(bid));
+                    continue;
+                }
+                double binStart = binStartList.at(bid);
+                double binEnd = (bid + 1 < binNum) ? binStartList.at(bid + 1) : axisMax;
+                for (int sid = 0; sid < SlabHistogramSize; sid++)
+                {
+                    double subStart = binStart + (binEnd - binStart) * sid / SlabHistogramSize;
+                    //sub bins below the coordinate resolution are merged into the previous one
+                    if (sid > 0 && subStart <= newStartList.back())
+                    {
+                        newHistogram.back() += subHistogram.at(denseIndex * SlabHistogramSize + sid);
+                        continue;
+                    }
+                    newStartList.push_back(subStart);
+                    newHistogram.push_back(subHistogram.at(denseIndex * SlabHistogramSize + sid));
+                }
+            }
+            binStartList.swap(newStartList);
+            histogram.swap(newHistogram);
+            return true;
+        }
+
+        //Twice the mean distance to the nn-th neighbor in a sample of the first chunk. It is only a guess of the
+        //neighborhood size, points whose neighbors may lie beyond the halo are searched again by NeighborRequery.
+        void EstimateHaloWidth(const MagicDGP::PointChunk& chunk, int nn)
+        {
+            int sampleNum = std::min(int(chunk.mPositionList.size()), HaloSampleNumber);
+            std::vector<MagicMath::Vector3> sampleList(chunk.mPositionList.begin(), chunk.mPositionList.begin() + sampleNum);
+            int knn = std::min(nn + 1, sampleNum);
+            mHaloWidth = 0;
+            if (knn < 2)
+            {
+                return;
+            }
+            MagicDGP::SpatialIndex index;
+            index.Build(sampleList);
+            index.KnnSearchSelf(knn);
+            const float* pDist = index.GetDistResult();
+            for (int sid = 0; sid < sampleNum; sid++)
+            {
+                mHaloWidth += sqrt(pDist[sid * knn + knn - 1]);
+            }
+            mHaloWidth = mHaloWidth / sampleNum * 2;
+        }
+
+        bool WriteSlabs(int slabStart, int slabEnd)
+        {
+            MagicDGP::PointStreamReader reader;
+            if (!reader.Open(mFileName))
+            {
+                return false;
+            }
+            int recordSize = GetRecordSize();
+            std::vector<FILE*> fileList(slabEnd - slabStart, (FILE*)NULL);
+            bool isValid = true;
+            for (int sid = slabStart; sid < slabEnd && isValid; sid++)
+            {
+                fileList.at(sid - slabStart) = fopen(GetSlabFileName(sid).c_str(), "wb");
+                isValid = (fileList.at(sid - slabStart) != NULL);
+            }
+            std::vector<double> record(recordSize);
+            MagicDGP::PointChunk chunk;
+            while (isValid && reader.ReadChunk(chunk))
+            {
+                int pointNum = chunk.mPositionList.size();
+                //an OBJ stream can drop its normals on the way
+                bool isNormalMissing = (chunk.mNormalList.size() != pointNum);
+                MagicMath::Vector3 zero(0, 0, 0);
+                for (int pid = 0; pid < pointNum; pid++)
+                {
+                    const MagicMath::Vector3& pos = chunk.mPositionList[pid];
+                    double* pAttribute = &(record[4]);
+                    if (mHasNormal)
+                    {
+                        const MagicMath::Vector3& nor = isNormalMissing ? zero : chunk.mNormalList[pid];
+                        pAttribute[0] = nor[0];
+                        pAttribute[1] = nor[1];
+                        pAttribute[2] = nor[2];
+                        pAttribute += 3;
+                    }
+                    if (mHasColor)
+                    {
+                        const MagicMath::Vector3& color = chunk.mColorList[pid];
+                        pAttribute[0] = color[0];
+                        pAttribute[1] = color[1];
+                        pAttribute[2] = color[2];
+                    }
+                    record[1] = pos[0];
+                    record[2] = pos[1];
+                    record[3] = pos[2];
+                    double coord = pos[mAxis];
+                    int coreSlab = int(std::upper_bound(mBoundaryList.begin() + 1, mBoundaryList.end() - 1, coord) - mBoundaryList.begin()) - 1;
+                    int haloStart = coreSlab;
+                    while (haloStart > 0 && coord - mBoundaryList.at(haloStart) < mHaloWidth)
+                    {
+                        haloStart--;
+                    }
+                    int haloEnd = coreSlab;
+                    while (haloEnd + 1 < GetSlabNumber() && mBoundaryList.at(haloEnd + 1) - coord < mHaloWidth)
+                    {
+                        haloEnd++;
+                    }
+                    for (int sid = std::max(haloStart, slabStart); sid <= haloEnd && sid < slabEnd; sid++)
+                    {
+                        record[0] = (sid == coreSlab) ? 0 : 1;
+                        if (fwrite(&(record[0]), sizeof(double) * recordSize, 1, fileList.at(sid - slabStart)) != 1)
+                        {
+                            isValid = false;
+                        }
+                    }
+                }
+            }
+            for (std::vector<FILE*>::iterator itr = fileList.begin(); itr != fileList.end(); itr++)
+            {
+                if (*itr != NULL && fclose(*itr) != 0)
+                {
+                    isValid = false;
+                }
+            }
+            if (!isValid || reader.IsFailed())
+            {
+                ErrorLog << "StreamConsolidation: can not write slab files of " << mFileName.c_str() << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        std::string mFileName;
+        int mAxis;
+        double mHaloWidth;
+        std::vector<double> mBoundaryList; //slab number + 1
+        bool mHasNormal;
+        bool mHasColor;
+        long long mPointNumber;
+    };
+
+    //Squared distances of the knn nearest neighbors of the core points, every point is its own nearest neighbor
+    const float* SearchSlabNeighbor(const SlabData& data, int knn, MagicDGP::SpatialIndex& index)
+    {
+        MagicDGP::FloatView3 posView;
+        posView.mpData = &(data.mPositionList[0]);
+        posView.mStride = 3;
+        posView.mCount = data.mPositionList.size() / 3;
+        index.Build(posView);
+        index.KnnSearch(&(data.mPositionList[0]), data.mCoreNumber, knn);
+        return index.GetDistResult();
+    }
+
+    //Core points whose neighbors may lie beyond the halo of their slab. They are searched again against the core
+    //points of every slab in reach and the results are merged. Core point sets are disjoint, so the merged
+    //neighbors are the ones of the in-core search.
+    class NeighborRequery
+    {
+    public:
+        explicit NeighborRequery(int knn) :
+            mKnn(knn),
+            mSlabIndexList(),
+            mPointIndexList(),
+            mQueryList(),
+            mCoordList(),
+            mReachList(),
+            mDistList()
+        {
+        }
+
+        //pDist holds slabKnn squared distances per core point. Returns true if the slab result of the point is
+        //exact, otherwise the point is queued for Search.
+        bool Check(const SlabPartition& partition, int slabIndex, const SlabData& data, int pointIndex, const float* pDist, int slabKnn)
+        {
+            //The found neighbors are points of the set, so the true neighbors are not farther than the last one.
+            //The margin covers the float distances of the index against the double slab boundaries.
+            double reach = DBL_MAX;
+            if (slabKnn >= mKnn)
+            {
+                reach = sqrt(double(pDist[pointIndex * slabKnn + slabKnn - 1])) * (1 + 1.0e-4);
+            }
+            double coord = data.mCorePositionList.at(pointIndex)[partition.GetAxis()];
+            double haloWidth = partition.GetHaloWidth();
+            if (coord - reach > partition.GetSlabMin(slabIndex) - haloWidth && coord + reach < partition.GetSlabMax(slabIndex) + haloWidth)
+            {
+                return true;
+            }
+            mSlabIndexList.push_back(slabIndex);
+            mPointIndexList.push_back(pointIndex);
+            mQueryList.insert(mQueryList.end(), data.mPositionList.begin() + pointIndex * 3, data.mPositionList.begin() + pointIndex * 3 + 3);
+            mCoordList.push_back(coord);
+            mReachList.push_back(reach);
+            return false;
+        }
+
+        //Queued points are in slab order, the slabs are read once without halo
+        bool Search(const SlabPartition& partition)
+        {
+            int queryNum = mSlabIndexList.size();
+            mDistList.assign(queryNum * mKnn, FLT_MAX);
+            if (queryNum == 0)
+            {
+                return true;
+            }
+            DebugLog << "StreamConsolidation: " << queryNum << " points searched beyond the halo" << std::endl;
+            SlabData data;
+            MagicDGP::SpatialIndex index;
+            std::vector<int> queryIdList;
+            std::vector<float> queryList;
+            std::vector<int> indexList;
+            std::vector<float> distList;
+            std::vector<float> mergeList;
+            for (int sid = 0; sid < partition.GetSlabNumber(); sid++)
+            {
+                double slabMin = partition.GetSlabMin(sid);
+                double slabMax = partition.GetSlabMax(sid);
+                queryIdList.clear();
+                queryList.clear();
+                for (int qid = 0; qid < queryNum; qid++)
+                {
+                    if (mCoordList.at(qid) + mReachList.at(qid) >= slabMin && mCoordList.at(qid) - mReachList.at(qid) <= slabMax)
+                    {
+                        queryIdList.push_back(qid);
+                        queryList.insert(queryList.end(), mQueryList.begin() + qid * 3, mQueryList.begin() + qid * 3 + 3);
+                    }
+                }
+                if (queryIdList.empty())
+                {
+                    continue;
+                }
+                if (!partition.LoadSlab(sid, false, data))
+                {
+                    return false;
+                }
+                if (data.mCoreNumber == 0)
+                {
+                    continue;
+                }
+                int knn = std::min(mKnn, data.mCoreNumber);
+                MagicDGP::FloatView3 posView;
+                posView.mpData = &(data.mPositionList[0]);
+                posView.mStride = 3;
+                posView.mCount = data.mCoreNumber;
+                index.Build(posView);
+                index.KnnSearch(&(queryList[0]), queryIdList.size(), knn, indexList, distList);
+                for (int lid = 0; lid < int(queryIdList.size()); lid++)
+                {
+                    std::vector<float>::iterator distItr = mDistList.begin() + queryIdList.at(lid) * mKnn;
+                    mergeList.assign(distItr, distItr + mKnn);
+                    mergeList.insert(mergeList.end(), distList.begin() + lid * knn, distList.begin() + (lid + 1) * knn);
+                    std::partial_sort(mergeList.begin(), mergeList.begin() + mKnn, mergeList.end());
+                    std::copy(mergeList.begin(), mergeList.begin() + mKnn, distItr);
+                }
+            }
+            return true;
+        }
+
+        int GetQueryNumber() const
+        {
+            return mSlabIndexList.size();
+        }
+
+        int GetSlabIndex(int queryId) const
+        {
+            return mSlabIndexList.at(queryId);
+        }
+
+        int GetPointIndex(int queryId) const
+        {
+            return mPointIndexList.at(queryId);
+        }
+
+        //mKnn sorted squared distances of a queued point, valid after Search
+        const float* GetDist(int queryId) const
+        {
+            return &(mDistList[queryId * mKnn]);
+        }
+
+    private:
+        int mKnn;
+        std::vector<int> mSlabIndexList;
+        std::vector<int> mPointIndexList;
+        std::vector<float> mQueryList;
+        std::vector<double> mCoordList;
+        std::vector<double> mReachList;
+        std::vector<float> mDistList;
+    };
+
+    struct VoxelCell
+    {
+        MagicMath::Vector3 mPosition;
+        MagicMath::Vector3 mNormal;
+        MagicMath::Vector3 mColor;
+        int mCount;
+    };
+
+    //21 bits per axis, the voxel coordinate is clamped
+    long long GetVoxelKey(const MagicMath::Vector3& pos, double voxelSize)
+    {
+        const long long coordRange = 1 << 20;
+        long long key = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            long long coord = (long long)floor(pos[k] / voxelSize);
+            coord = std::max(-coordRange, std::min(coordRange - 1, coord));
+            key = (key << 21) | (coord + coordRange);
+        }
+        return key;
+    }
+}
+
+namespace MagicDGP
+{
+    bool StreamConsolidation::CalculateBBox(const std::string& fileName, MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax, long long& pointNum)
+    {
+        PointStreamReader reader;
+        if (!reader.Open(fileName))
+        {
+            return false;
+        }
+        double maxValue = 1.0e300;
+        bboxMin = MagicMath::Vector3(maxValue, maxValue, maxValue);
+        bboxMax = MagicMath::Vector3(-maxValue, -maxValue, -maxValue);
+        pointNum = 0;
+        PointChunk chunk;
+        while (reader.ReadChunk(chunk))
+        {
+            for (std::vector<MagicMath::Vector3>::iterator itr = chunk.mPositionList.begin(); itr != chunk.mPositionList.end(); itr++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    bboxMin[k] = std::min(bboxMin[k], (*itr)[k]);
+                    bboxMax[k] = std::max(bboxMax[k], (*itr)[k]);
+                }
+            }
+            pointNum += chunk.mPositionList.size();
+        }
+        return !reader.IsFailed();
+    }
+
+    double StreamConsolidation::CalculateDensity(const std::string& fileName, int slabPointNum)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        const int nn = 9;
+        SlabPartition partition;
+        if (!partition.Build(fileName, slabPointNum, nn))
+        {
+            return -1;
+        }
+        double density = 0;
+        SlabData data;
+        SpatialIndex index;
+        int pointKnn = int(std::min((long long)nn, partition.GetPointNumber()));
+        NeighborRequery requery(pointKnn);
+        for (int sid = 0; sid < partition.GetSlabNumber(); sid++)
+        {
+            if (!partition.LoadSlab(sid, true, data))
+            {
+                return -1;
+            }
+            if (data.mCoreNumber == 0)
+            {
+                continue;
+            }
+            int knn = std::min(pointKnn, int(data.mPositionList.size() / 3));
+            const float* pDist = SearchSlabNeighbor(data, knn, index);
+            for (int pid = 0; pid < data.mCoreNumber; pid++)
+            {
+                if (requery.Check(partition, sid, data, pid, pDist, knn))
+                {
+                    for (int k = 0; k < knn; k++)
+                    {
+                        density += pDist[pid * knn + k];
+                    }
+                }
+            }
+        }
+        if (!requery.Search(partition))
+        {
+            return -1;
+        }
+        for (int qid = 0; qid < requery.GetQueryNumber(); qid++)
+        {
+            const float* pDist = requery.GetDist(qid);
+            for (int k = 0; k < pointKnn; k++)
+            {
+                density += pDist[k];
+            }
+        }
+        density /= (partition.GetPointNumber() * nn);
+        DebugLog << "StreamConsolidation::CalculateDensity: " << density << " time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return density;
+    }
+
+    Point3DSet* StreamConsolidation::VoxelDownsample(const std::string& fileName, double voxelSize)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        PointStreamReader reader;
+        if (voxelSize <= 0 || !reader.Open(fileName))
+        {
+            return NULL;
+        }
+        bool hasNormal = reader.HasNormal();
+        bool hasColor = reader.HasColor();
+        std::map<long long, VoxelCell> cellMap;
+        std::map<long long, VoxelCell>::iterator lastItr = cellMap.end();
+        long long lastKey = 0;
+        PointChunk chunk;
+        while (reader.ReadChunk(chunk))
+        {
+            int pointNum = chunk.mPositionList.size();
+            bool hasChunkNormal = hasNormal && chunk.mNormalList.size() == pointNum;
+            for (int pid = 0; pid < pointNum; pid++)
+            {
+                //consecutive scan points often share a voxel
+                long long key = GetVoxelKey(chunk.mPositionList[pid], voxelSize);
+                if (lastItr == cellMap.end() || key != lastKey)
+                {
+                    lastItr = cellMap.find(key);
+                    if (lastItr == cellMap.end())
+                    {
+                        VoxelCell cell;
+                        cell.mPosition = MagicMath::Vector3(0, 0, 0);
+                        cell.mNormal = MagicMath::Vector3(0, 0, 0);
+                        cell.mColor = MagicMath::Vector3(0, 0, 0);
+                        cell.mCount = 0;
+                        lastItr = cellMap.insert(std::make_pair(key, cell)).first;
+                    }
+                    lastKey = key;
+                }
+                VoxelCell& cell = lastItr->second;
+                cell.mPosition += chunk.mPositionList[pid];
+                if (hasChunkNormal)
+                {
+                    cell.mNormal += chunk.mNormalList[pid];
+                }
+                if (hasColor)
+                {
+                    cell.mColor += chunk.mColorList[pid];
+                }
+                cell.mCount++;
+            }
+        }
+        if (reader.IsFailed())
+        {
+            return NULL;
+        }
+        Point3DSet* pPointSet = new Point3DSet;
+        for (std::map<long long, VoxelCell>::iterator itr = cellMap.begin(); itr != cellMap.end(); itr++)
+        {
+            VoxelCell& cell = itr->second;
+            Point3D* pPoint = NULL;
+            if (hasNormal)
+            {
+                cell.mNormal.Normalise();
+                pPoint = pPointSet->InsertPoint(cell.mPosition / cell.mCount, cell.mNormal);
+            }
+            else
+            {
+                pPoint = pPointSet->InsertPoint(cell.mPosition / cell.mCount);
+            }
+            if (hasColor)
+            {
+                pPoint->SetColor(cell.mColor / cell.mCount);
+            }
+        }
+        pPointSet->SetHasNormal(hasNormal);
+        InfoLog << "StreamConsolidation::VoxelDownsample: " << reader.GetReadNumber() << " to " << pPointSet->GetPointNumber()
+            << " points, time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return pPointSet;
+    }
+
+    bool StreamConsolidation::RemoveOutlier(const std::string& fileName, const std::string& exportFileName, int nn, double stdRatio,
+        int slabPointNum)
+    {
+        double timeStart = MagicCore::ToolKit::GetTime();
+        SlabPartition partition;
+        if (nn < 1 || !partition.Build(fileName, slabPointNum, nn))
+        {
+            return false;
+        }
+        //mean neighbor distances are kept in a file per slab between the statistics and the export pass
+        int slabNum = partition.GetSlabNumber();
+        double distSum = 0;
+        double distSquareSum = 0;
+        SlabData data;
+        SpatialIndex index;
+        std::vector<float> meanDistList;
+        int pointKnn = int(std::min((long long)nn + 1, partition.GetPointNumber()));
+        NeighborRequery requery(pointKnn);
+        for (int sid = 0; sid < slabNum; sid++)
+        {
+            if (!partition.LoadSlab(sid, true, data))
+            {
+                return false;
+            }
+            meanDistList.assign(data.mCoreNumber, 0);
+            int knn = std::min(pointKnn, int(data.mPositionList.size() / 3));
+            if (data.mCoreNumber > 0 && pointKnn > 1)
+            {
+                const float* pDist = SearchSlabNeighbor(data, knn, index);
+                for (int pid = 0; pid < data.mCoreNumber; pid++)
+                {
+                    if (!requery.Check(partition, sid, data, pid, pDist, knn))
+                    {
+                        continue;
+                    }
+                    double meanDist = 0;
+                    for (int k = 1; k < knn; k++)
+                    {
+                        meanDist += sqrt(pDist[pid * knn + k]);
+                    }
+                    meanDist /= (knn - 1);
+                    meanDistList.at(pid) = float(meanDist);
+                    distSum += meanDist;
+                    distSquareSum += meanDist * meanDist;
+                }
+            }
+            std::string distFileName = partition.GetSlabFileName(sid) + ".dist";
+            FILE* pFile = fopen(distFileName.c_str(), "wb");
+            bool isWritten = (pFile != NULL && (meanDistList.empty() ||
+                fwrite(&(meanDistList[0]), sizeof(float), meanDistList.size(), pFile) == meanDistList.size()));
+            if (pFile != NULL && fclose(pFile) != 0)
+            {
+                isWritten = false;
+            }
+            if (!isWritten)
+            {
+                ErrorLog << "StreamConsolidation::RemoveOutlier: can not write " << distFileName.c_str() << std::endl;
+                return false;
+            }
+        }
+        //mean distances of the points searched beyond the halo are patched into the slab distance files
+        if (!requery.Search(partition))
+        {
+            return false;
+        }
+        FILE* pDistFile = NULL;
+        int distFileSlab = -1;
+        bool isPatched = true;
+        for (int qid = 0; qid < requery.GetQueryNumber() && isPatched; qid++)
+        {
+            const float* pDist = requery.GetDist(qid);
+            double meanDist = 0;
+            for (int k = 1; k < pointKnn; k++)
+            {
+                meanDist += sqrt(pDist[k]);
+            }
+            meanDist /= (pointKnn - 1);
+            distSum += meanDist;
+            distSquareSum += meanDist * meanDist;
+            if (requery.GetSlabIndex(qid) != distFileSlab)
+            {
+                if (pDistFile != NULL && fclose(pDistFile) != 0)
+                {
+                    isPatched = false;
+                }
+                distFileSlab = requery.GetSlabIndex(qid);
+                pDistFile = fopen((partition.GetSlabFileName(distFileSlab) + ".dist").c_str(), "r+b");
+                isPatched = isPatched && (pDistFile != NULL);
+            }
+            float distValue = float(meanDist);
+            isPatched = isPatched && fseek(pDistFile, long(requery.GetPointIndex(qid) * sizeof(float)), SEEK_SET) == 0 &&
+                fwrite(&distValue, sizeof(float), 1, pDistFile) == 1;
+        }
+        if (pDistFile != NULL && fclose(pDistFile) != 0)
+        {
+            isPatched = false;
+        }
+        if (!isPatched)
+        {
+            ErrorLog << "StreamConsolidation::RemoveOutlier: can not update the distance files" << std::endl;
+            return false;
+        }
+        double pointNum = double(partition.GetPointNumber());
+        double distMean = distSum / pointNum;
+        double distDeviation = sqrt(std::max(0.0, distSquareSum / pointNum - distMean * distMean));
+        double distThreshold = distMean + stdRatio * distDeviation;
+        DebugLog << "StreamConsolidation::RemoveOutlier: mean distance " << distMean << " deviation " << distDeviation << std::endl;
+        PointStreamWriter writer;
+        if (!writer.Open(exportFileName, partition.HasNormal(), partition.HasColor()))
+        {
+            return false;
+        }
+        MagicMath::Vector3 zero(0, 0, 0);
+        bool isValid = true;
+        for (int sid = 0; sid < slabNum && isValid; sid++)
+        {
+            std::string distFileName = partition.GetSlabFileName(sid) + ".dist";
+            isValid = partition.LoadSlab(sid, false, data);
+            FILE* pFile = fopen(distFileName.c_str(), "rb");
+            meanDistList.resize(data.mCoreNumber);
+            isValid = isValid && pFile != NULL && (meanDistList.empty() ||
+                fread(&(meanDistList[0]), sizeof(float), meanDistList.size(), pFile) == meanDistList.size());
+            if (pFile != NULL)
+            {
+                fclose(pFile);
+            }
+            remove(distFileName.c_str());
+            for (int pid = 0; pid < data.mCoreNumber && isValid; pid++)
+            {
+                if (meanDistList.at(pid) <= distThreshold)
+                {
+                    writer.WritePoint(data.mCorePositionList.at(pid), partition.HasNormal() ? data.mNormalList.at(pid) : zero,
+                        partition.HasColor() ? data.mColorList.at(pid) : zero);
+                }
+            }
+        }
+        isValid = writer.Close() && isValid;
+        InfoLog << "StreamConsolidation::RemoveOutlier: " << partition.GetPointNumber() - writer.GetPointNumber() << " of "
+            << partition.GetPointNumber() << " points removed, time: " << MagicCore::ToolKit::GetTime() - timeStart << std::endl;
+        return isValid;
+    }
+}
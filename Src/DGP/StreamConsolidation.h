@@ -0,0 +1,28 @@
+#pragma once
+#include "PointCloud3D.h"
+#include <string>
+
+namespace MagicDGP
+{
+    //Consolidation passes over point files which do not fit into memory, points are read by PointStreamReader.
+    //Neighborhood passes split the points into slabs along the longest bbox axis. Slabs are spilled to
+    //temporary files beside the input and processed one by one, together with a halo of the neighbor slabs.
+    //Points whose neighbors may lie beyond the halo are searched again against the slabs in reach, so the
+    //neighborhood results equal the in-core ones.
+    //Memory depends on the chunk and slab size and on the result, not on the file size.
+    class StreamConsolidation
+    {
+    public:
+        static bool CalculateBBox(const std::string& fileName, MagicMath::Vector3& bboxMin, MagicMath::Vector3& bboxMax, long long& pointNum);
+        //Mean squared distance of the 9 nearest neighbors as Point3DSet::CalculateDensity, negative on failure
+        static double CalculateDensity(const std::string& fileName, int slabPointNum = DefaultSlabPointNumber);
+        //Points of one voxel are averaged, memory is proportional to the occupied voxel number
+        static Point3DSet* VoxelDownsample(const std::string& fileName, double voxelSize);
+        //Statistical outlier removal: a point is removed if the mean distance to its nn neighbors is larger than
+        //mean + stdRatio * deviation of all points. Kept points are written slab by slab to exportFileName (obj or ply).
+        static bool RemoveOutlier(const std::string& fileName, const std::string& exportFileName, int nn, double stdRatio,
+            int slabPointNum = DefaultSlabPointNumber);
+
+        static const int DefaultSlabPointNumber = 1 << 23;
+    };
+}
@@ -0,0 +1,193 @@
+#include "UniformGrid.h"
+#include "Tool/LogSystem.h"
+
+namespace MagicDGP
+{
+    //Upper limit of cell number, cell size is enlarged if the grid would be larger
+    static const double MaxCellNumber = 64.0 * 1024.0 * 1024.0;
+
+    UniformGrid::UniformGrid() :
+        mBBoxMin(0, 0, 0),
+        mCellSize(1),
+        mResolutionX(0),
+        mResolutionY(0),
+        mResolutionZ(0)
+    {
+    }
+
+    UniformGrid::~UniformGrid()
+    {
+    }
+
+    void UniformGrid::Build(const std::vector<MagicMath::Vector3>& posList, const MagicMath::Vector3& bboxMin,
+        const MagicMath::Vector3& bboxMax, double cellSize)
+    {
+        if (cellSize <= 0)
+        {
+            ErrorLog << "UniformGrid::Build: invalid cell size " << cellSize << std::endl;
+            ClearData();
+            return;
+        }
+        MagicMath::Vector3 deltaBBox = bboxMax - bboxMin;
+        double inputCellSize = cellSize;
+        double cellNum = (deltaBBox[0] / cellSize + 1) * (deltaBBox[1] / cellSize + 1) * (deltaBBox[2] / cellSize + 1);
+        while (cellNum > MaxCellNumber)
+        {
+            cellSize *= 2;
+            cellNum = (deltaBBox[0] / cellSize + 1) * (deltaBBox[1] / cellSize + 1) * (deltaBBox[2] / cellSize + 1);
+        }
+        if (cellSize != inputCellSize)
+        {
+            DebugLog << "UniformGrid::Build: cell size enlarged to " << cellSize << std::endl;
+        }
+        mBBoxMin = bboxMin;
+        mCellSize = cellSize;
+        mResolutionX = int(deltaBBox[0] / cellSize) + 1;
+        mResolutionY = int(deltaBBox[1] / cellSize) + 1;
+        mResolutionZ = int(deltaBBox[2] / cellSize) + 1;
+        SortPoints(posList);
+    }
+
+    void UniformGrid::Build(const Point3DSet* pPointSet, double cellSize)
+    {
+        int pointNum = pPointSet->GetPointNumber();
+        std::vector<MagicMath::Vector3> posList(pointNum);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            posList.at(pid) = pPointSet->GetPoint(pid)->GetPosition();
+        }
+        MagicMath::Vector3 bboxMin, bboxMax;
+        pPointSet->GetBBox(bboxMin, bboxMax);
+        Build(posList, bboxMin, bboxMax, cellSize);
+    }
+
+    void UniformGrid::SortPoints(const std::vector<MagicMath::Vector3>& posList)
+    {
+        int pointNum = posList.size();
+        int cellNum = mResolutionX * mResolutionY * mResolutionZ;
+        //count points of every cell
+        mCellStartList.assign(cellNum + 1, 0);
+        mPointCellList.resize(pointNum);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            int xIndex, yIndex, zIndex;
+            GetCellCoord(posList.at(pid), xIndex, yIndex, zIndex);
+            int cellIndex = (xIndex * mResolutionY + yIndex) * mResolutionZ + zIndex;
+            mPointCellList.at(pid) = cellIndex;
+            mCellStartList.at(cellIndex + 1)++;
+        }
+        //prefix sum
+        for (int cid = 0; cid < cellNum; cid++)
+        {
+            mCellStartList.at(cid + 1) += mCellStartList.at(cid);
+        }
+        //scatter points into their cell ranges
+        mSortedIndexList.resize(pointNum);
+        mSortedPosList.resize(pointNum);
+        std::vector<int> cursorList(mCellStartList.begin(), mCellStartList.end() - 1);
+        for (int pid = 0; pid < pointNum; pid++)
+        {
+            int sortedIndex = cursorList.at(mPointCellList.at(pid))++;
+            mSortedIndexList.at(sortedIndex) = pid;
+            mSortedPosList.at(sortedIndex) = posList.at(pid);
+        }
+    }
+
+    void UniformGrid::ClearData()
+    {
+        std::vector<int>().swap(mCellStartList);
+        std::vector<int>().swap(mSortedIndexList);
+        std::vector<MagicMath::Vector3>().swap(mSortedPosList);
+        std::vector<int>().swap(mPointCellList);
+        mResolutionX = 0;
+        mResolutionY = 0;
+        mResolutionZ = 0;
+    }
+
+    int UniformGrid::GetPointNumber() const
+    {
+        return mSortedIndexList.size();
+    }
+
+    double UniformGrid::GetCellSize() const
+    {
+        return mCellSize;
+    }
+
+    void UniformGrid::GetResolution(int& resX, int& resY, int& resZ) const
+    {
+        resX = mResolutionX;
+        resY = mResolutionY;
+        resZ = mResolutionZ;
+    }
+
+    void UniformGrid::GetCellCoord(const MagicMath::Vector3& pos, int& xIndex, int& yIndex, int& zIndex) const
+    {
+        MagicMath::Vector3 deltaPos = pos - mBBoxMin;
+        xIndex = deltaPos[0] < 0 ? 0 : int(deltaPos[0] / mCellSize);
+        yIndex = deltaPos[1] < 0 ? 0 : int(deltaPos[1] / mCellSize);
+        zIndex = deltaPos[2] < 0 ? 0 : int(deltaPos[2] / mCellSize);
+        xIndex = xIndex < mResolutionX ? xIndex : mResolutionX - 1;
+        yIndex = yIndex < mResolutionY ? yIndex : mResolutionY - 1;
+        zIndex = zIndex < mResolutionZ ? zIndex : mResolutionZ - 1;
+    }
+
+    int UniformGrid::GetCellIndex(int xIndex, int yIndex, int zIndex) const
+    {
+        if (xIndex < 0 || xIndex >= mResolutionX || yIndex < 0 || yIndex >= mResolutionY || zIndex < 0 || zIndex >= mResolutionZ)
+        {
+            return -1;
+        }
+        return (xIndex * mResolutionY + yIndex) * mResolutionZ + zIndex;
+    }
+
+    int UniformGrid::GetCellStart(int cellIndex) const
+    {
+        return mCellStartList[cellIndex];
+    }
+
+    const MagicMath::Vector3& UniformGrid::GetSortedPosition(int sortedIndex) const
+    {
+        return mSortedPosList[sortedIndex];
+    }
+
+    int UniformGrid::GetSortedIndex(int sortedIndex) const
+    {
+        return mSortedIndexList[sortedIndex];
+    }
+
+    void UniformGrid::FindNeighbors(const MagicMath::Vector3& pos, double radius, std::vector<int>& neighborList) const
+    {
+        neighborList.clear();
+        if (mSortedIndexList.empty())
+        {
+            return;
+        }
+        int xIndex, yIndex, zIndex;
+        GetCellCoord(pos, xIndex, yIndex, zIndex);
+        int cellRange = int(radius / mCellSize) + 1;
+        double squaredRadius = radius * radius;
+        for (int xx = xIndex - cellRange; xx <= xIndex + cellRange; xx++)
+        {
+            for (int yy = yIndex - cellRange; yy <= yIndex + cellRange; yy++)
+            {
+                for (int zz = zIndex - cellRange; zz <= zIndex + cellRange; zz++)
+                {
+                    int cellIndex = GetCellIndex(xx, yy, zz);
+                    if (cellIndex == -1)
+                    {
+                        continue;
+                    }
+                    int endIndex = mCellStartList[cellIndex + 1];
+                    for (int sid = mCellStartList[cellIndex]; sid < endIndex; sid++)
+                    {
+                        if ((mSortedPosList[sid] - pos).LengthSquared() <= squaredRadius)
+                        {
+                            neighborList.push_back(mSortedIndexList[sid]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
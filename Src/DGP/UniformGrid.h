@@ -0,0 +1,45 @@
+#pragma once
+#include "PointCloud3D.h"
+#include <vector>
+
+namespace MagicDGP
+{
+    //Uniform grid for fixed radius neighborhood queries.
+    //Points are counting sorted by cell, so the points of one cell are contiguous:
+    //cell c holds sorted points [GetCellStart(c), GetCellStart(c + 1)).
+    class UniformGrid
+    {
+    public:
+        UniformGrid();
+        ~UniformGrid();
+
+        //Points outside [bboxMin, bboxMax] are put into the nearest boundary cell
+        void Build(const std::vector<MagicMath::Vector3>& posList, const MagicMath::Vector3& bboxMin,
+            const MagicMath::Vector3& bboxMax, double cellSize);
+        void Build(const Point3DSet* pPointSet, double cellSize); //PointSet need CalculateBBox
+        void ClearData();
+
+        int GetPointNumber() const;
+        double GetCellSize() const;
+        void GetResolution(int& resX, int& resY, int& resZ) const;
+        void GetCellCoord(const MagicMath::Vector3& pos, int& xIndex, int& yIndex, int& zIndex) const;
+        int  GetCellIndex(int xIndex, int yIndex, int zIndex) const; //-1 if out of grid
+        int  GetCellStart(int cellIndex) const;
+        const MagicMath::Vector3& GetSortedPosition(int sortedIndex) const;
+        int  GetSortedIndex(int sortedIndex) const; //original index of a sorted point
+        //Original indices of points within radius of pos
+        void FindNeighbors(const MagicMath::Vector3& pos, double radius, std::vector<int>& neighborList) const;
+
+    private:
+        void SortPoints(const std::vector<MagicMath::Vector3>& posList);
+
+    private:
+        MagicMath::Vector3 mBBoxMin;
+        double mCellSize;
+        int mResolutionX, mResolutionY, mResolutionZ;
+        std::vector<int> mCellStartList; //cell number + 1 offsets
+        std::vector<int> mSortedIndexList;
+        std::vector<MagicMath::Vector3> mSortedPosList;
+        std::vector<int> mPointCellList;
+    };
+}